@@ -56,6 +56,7 @@ namespace kc = kyotocabinet;
 const int32_t THREADMAX = 64;            // maximum number of threads
 const size_t RECBUFSIZ = 64;             // buffer size for a record
 const size_t RECBUFSIZL = 1024;          // buffer size for a long record
+const int64_t IMPBULKNUM = 1000;         // number of records in an import batch
 
 
 // global variables
@@ -80,6 +81,8 @@ std::string unitnumstrbyte(int64_t num);
 kc::BasicDB::ProgressChecker* stdchecker(const char* prefix, std::ostream* strm);
 kc::BasicDB::Logger* stdlogger(const char* progname, std::ostream* strm);
 void printdb(kc::BasicDB* db, bool px = false);
+bool importtsv(kc::BasicDB* db, std::istream* is, bool sx, int32_t thnum, int64_t bulk,
+               const char** fnp);
 
 
 // checker to show progress by printing dots
@@ -115,6 +118,82 @@ class DotChecker : public kc::BasicDB::ProgressChecker {
 };
 
 
+// queue to store batches of TSV lines into a database
+class ImportQueue : public kc::TaskQueue {
+ public:
+  class BatchTask : public Task {
+   public:
+    explicit BatchTask() : lines() {}
+    std::vector<std::string> lines;
+  };
+  explicit ImportQueue(kc::BasicDB* db, bool sx, kc::Mutex* lock,
+                       bool* err, kc::BasicDB::Error* error, const char** fnp) :
+      db_(db), sx_(sx), lock_(lock), err_(err), error_(error), fnp_(fnp) {}
+  bool failed() {
+    kc::ScopedMutex lock(lock_);
+    return *err_;
+  }
+ private:
+  void do_task(Task* task) {
+    BatchTask* btask = (BatchTask*)task;
+    std::map<std::string, std::string> recs;
+    std::set<std::string> rkeys;
+    std::vector<std::string> fields;
+    std::vector<std::string>::iterator lit = btask->lines.begin();
+    std::vector<std::string>::iterator litend = btask->lines.end();
+    while (lit != litend) {
+      kc::strsplit(*lit, '\t', &fields);
+      if (sx_) {
+        std::vector<std::string>::iterator it = fields.begin();
+        std::vector<std::string>::iterator itend = fields.end();
+        while (it != itend) {
+          size_t esiz;
+          char* ebuf = kc::hexdecode(it->c_str(), &esiz);
+          it->clear();
+          it->append(ebuf, esiz);
+          delete[] ebuf;
+          ++it;
+        }
+      }
+      switch (fields.size()) {
+        case 2: {
+          rkeys.erase(fields[0]);
+          recs[fields[0]] = fields[1];
+          break;
+        }
+        case 1: {
+          recs.erase(fields[0]);
+          rkeys.insert(fields[0]);
+          break;
+        }
+      }
+      ++lit;
+    }
+    const char* fname = NULL;
+    if (!recs.empty() && db_->set_bulk(recs, false) < 0) fname = "DB::set_bulk failed";
+    if (!fname && !rkeys.empty()) {
+      std::vector<std::string> keys(rkeys.begin(), rkeys.end());
+      if (db_->remove_bulk(keys, false) < 0) fname = "DB::remove_bulk failed";
+    }
+    if (fname) {
+      kc::ScopedMutex lock(lock_);
+      if (!*err_) {
+        *err_ = true;
+        *error_ = db_->error();
+        *fnp_ = fname;
+      }
+    }
+    delete btask;
+  }
+  kc::BasicDB* db_;
+  bool sx_;
+  kc::Mutex* lock_;
+  bool* err_;
+  kc::BasicDB::Error* error_;
+  const char** fnp_;
+};
+
+
 // get the random seed
 inline void mysrand(int64_t seed) {
   g_rnd_x = seed;
@@ -318,6 +397,77 @@ inline void printdb(kc::BasicDB* db, bool px) {
 }
 
 
+// import records from a TSV stream with a pipeline of worker threads
+inline bool importtsv(kc::BasicDB* db, std::istream* is, bool sx, int32_t thnum, int64_t bulk,
+                      const char** fnp) {
+  if (thnum < 1) thnum = 1;
+  if (bulk < 1) bulk = 1;
+  kc::Mutex lock;
+  bool err = false;
+  kc::BasicDB::Error error;
+  const char* fname = NULL;
+  ImportQueue** queues = new ImportQueue*[thnum];
+  ImportQueue::BatchTask** tasks = new ImportQueue::BatchTask*[thnum];
+  for (int32_t i = 0; i < thnum; i++) {
+    queues[i] = new ImportQueue(db, sx, &lock, &err, &error, &fname);
+    queues[i]->start(1);
+    tasks[i] = new ImportQueue::BatchTask;
+  }
+  int64_t cnt = 0;
+  std::string line;
+  while (mygetline(is, &line)) {
+    size_t ksiz = line.find('\t');
+    if (ksiz == std::string::npos) ksiz = line.size();
+    int32_t idx = 0;
+    if (thnum > 1) {
+      if (sx) {
+        std::string kstr(line, 0, ksiz);
+        size_t esiz;
+        char* ebuf = kc::hexdecode(kstr.c_str(), &esiz);
+        idx = kc::hashmurmur(ebuf, esiz) % thnum;
+        delete[] ebuf;
+      } else {
+        idx = kc::hashmurmur(line.data(), ksiz) % thnum;
+      }
+    }
+    std::vector<std::string>& lines = tasks[idx]->lines;
+    lines.push_back(std::string());
+    lines.back().swap(line);
+    if ((int64_t)lines.size() >= bulk) {
+      while (queues[idx]->count() > 1) {
+        kc::Thread::sleep(0.001);
+      }
+      queues[idx]->add_task(tasks[idx]);
+      tasks[idx] = new ImportQueue::BatchTask;
+      if (queues[idx]->failed()) break;
+    }
+    cnt++;
+    if (cnt % bulk == 0) {
+      oputchar('.');
+      if (cnt % (bulk * 50) == 0) oprintf(" (%lld)\n", (long long)cnt);
+    }
+  }
+  if (cnt % (bulk * 50) > 0) oprintf(" (%lld)\n", (long long)cnt);
+  for (int32_t i = 0; i < thnum; i++) {
+    if (tasks[i]->lines.empty()) {
+      delete tasks[i];
+    } else {
+      queues[i]->add_task(tasks[i]);
+    }
+    queues[i]->finish();
+    delete queues[i];
+  }
+  delete[] tasks;
+  delete[] queues;
+  if (err) {
+    db->set_error(_KCCODELINE_, error.code(), error.message());
+    *fnp = fname;
+    return false;
+  }
+  return true;
+}
+
+
 #endif                                   // duplication check
 
 // END OF FILE
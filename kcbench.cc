@@ -0,0 +1,908 @@
+/*************************************************************************************************
+ * The workload benchmark of the polymorphic database
+ *                                                               Copyright (C) 2009-2011 FAL Labs
+ * This file is part of Kyoto Cabinet.
+ * This program is free software: you can redistribute it and/or modify it under the terms of
+ * the GNU General Public License as published by the Free Software Foundation, either version
+ * 3 of the License, or any later version.
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ *************************************************************************************************/
+
+
+#include <kcpolydb.h>
+#include "cmdcommon.h"
+
+
+// constants
+enum {                                   // enumeration for operations
+  OPLOAD,                                // loading
+  OPGET,                                 // getting
+  OPSET,                                 // setting
+  OPREMOVE,                              // removing
+  OPSCAN,                                // scanning
+  OPCAS,                                 // compare and swap
+  OPNUM                                  // number of operations
+};
+enum {                                   // enumeration for key distributions
+  KDUNIFORM,                             // uniform
+  KDZIPF,                                // Zipfian
+  KDLATEST                               // Zipfian to the latest
+};
+enum {                                   // enumeration for value size distributions
+  VDFIXED,                               // fixed
+  VDUNIFORM,                             // uniform
+  VDEXP                                  // exponential
+};
+const char* OPNAMES[] = { "load", "get", "set", "remove", "scan", "cas" };
+const int32_t TRKINDNUM = kc::PolyDB::TRCLEAR + 1;  // number of kinds of traced operations
+const char* TRNAMES[] = {                // names of traced operations
+  "", "get", "miss", "set", "add", "remove", "iterate",
+  "sync", "begin", "commit", "abort", "clear"
+};
+const int32_t HISTSUBBITS = 6;           // bits of sub-buckets of histograms
+const int32_t HISTSUBNUM = 1 << HISTSUBBITS;  // number of sub-buckets of histograms
+const int32_t HISTNUM = (64 - HISTSUBBITS + 1) * HISTSUBNUM;  // number of buckets
+const int32_t VALBUFMUL = 16;            // multiplier of the value buffer size
+
+
+// global variables
+const char* g_progname;                  // program name
+uint32_t g_randseed;                     // random seed
+
+
+// random number generator of each thread
+class Randomizer {
+ public:
+  explicit Randomizer(uint64_t seed = 0) : x_(0), y_(362436069), z_(521288629), w_(88675123) {
+    reset(seed);
+  }
+  void reset(uint64_t seed) {
+    x_ = seed * 1812433253ULL + 1;
+    for (int32_t i = 0; i < 16; i++) {
+      next();
+    }
+  }
+  uint64_t next() {
+    uint64_t t = x_ ^ (x_ << 11);
+    x_ = y_;
+    y_ = z_;
+    z_ = w_;
+    w_ = (w_ ^ (w_ >> 19)) ^ (t ^ (t >> 8));
+    return w_;
+  }
+  int64_t range(int64_t num) {
+    return (int64_t)((next() & kc::INT64MAX) % num);
+  }
+  double real() {
+    return (next() >> 11) / 9007199254740992.0;
+  }
+ private:
+  uint64_t x_;
+  uint64_t y_;
+  uint64_t z_;
+  uint64_t w_;
+};
+
+
+// generator of Zipfian distribution
+class ZipfGenerator {
+ public:
+  explicit ZipfGenerator(int64_t num, double theta) :
+      num_(num), theta_(theta), alpha_(0), zetan_(0), eta_(0), half_(0) {
+    double zeta2 = 1 + std::pow(0.5, theta);
+    for (int64_t i = 1; i <= num; i++) {
+      zetan_ += 1 / std::pow((double)i, theta);
+    }
+    alpha_ = 1 / (1 - theta);
+    eta_ = (1 - std::pow(2.0 / num, 1 - theta)) / (1 - zeta2 / zetan_);
+    half_ = 1 + std::pow(0.5, theta);
+  }
+  int64_t rank(Randomizer* rnd) const {
+    double u = rnd->real();
+    double uz = u * zetan_;
+    if (uz < 1) return 0;
+    if (uz < half_) return num_ > 1 ? 1 : 0;
+    int64_t rv = (int64_t)(num_ * std::pow(eta_ * u - eta_ + 1, alpha_));
+    return rv < num_ ? rv : num_ - 1;
+  }
+ private:
+  int64_t num_;
+  double theta_;
+  double alpha_;
+  double zetan_;
+  double eta_;
+  double half_;
+};
+
+
+// latency histogram with logarithmic buckets of linear sub-buckets
+class Histogram {
+ public:
+  explicit Histogram() : counts_(HISTNUM, 0), count_(0), sum_(0), max_(0) {}
+  void add(int64_t nsec) {
+    if (nsec < 0) nsec = 0;
+    counts_[index(nsec)]++;
+    count_++;
+    sum_ += nsec;
+    if (nsec > max_) max_ = nsec;
+  }
+  void merge(const Histogram& hist) {
+    for (int32_t i = 0; i < HISTNUM; i++) {
+      counts_[i] += hist.counts_[i];
+    }
+    count_ += hist.count_;
+    sum_ += hist.sum_;
+    if (hist.max_ > max_) max_ = hist.max_;
+  }
+  int64_t count() const {
+    return count_;
+  }
+  double mean() const {
+    return count_ > 0 ? (double)sum_ / count_ : 0.0;
+  }
+  int64_t max() const {
+    return max_;
+  }
+  int64_t percentile(double ratio) const {
+    if (count_ < 1) return 0;
+    int64_t goal = (int64_t)std::ceil(count_ * ratio);
+    if (goal < 1) goal = 1;
+    int64_t sum = 0;
+    for (int32_t i = 0; i < HISTNUM; i++) {
+      sum += counts_[i];
+      if (sum >= goal) {
+        int64_t hval = lower(i + 1) - 1;
+        return hval < max_ ? hval : max_;
+      }
+    }
+    return max_;
+  }
+ private:
+  static int32_t index(int64_t num) {
+    if (num < HISTSUBNUM * 2) return num;
+    int32_t shift = 0;
+    while ((num >> shift) >= HISTSUBNUM * 2) {
+      shift++;
+    }
+    return shift * HISTSUBNUM + (int32_t)(num >> shift);
+  }
+  static int64_t lower(int32_t idx) {
+    if (idx < HISTSUBNUM * 2) return idx;
+    int32_t shift = idx / HISTSUBNUM - 1;
+    return (int64_t)(idx % HISTSUBNUM + HISTSUBNUM) << shift;
+  }
+  std::vector<int64_t> counts_;
+  int64_t count_;
+  int64_t sum_;
+  int64_t max_;
+};
+
+
+// statistics of an operation
+struct OpStat {
+  Histogram hist;                        ///< latency histogram
+  int64_t miss;                          ///< number of missing records
+  int64_t error;                         ///< number of errors
+  explicit OpStat() : hist(), miss(0), error(0) {}
+};
+
+
+// parameters of a workload
+struct Workload {
+  int64_t rnum;                          ///< number of records
+  int64_t opnum;                         ///< number of operations of each thread
+  int32_t thnum;                         ///< number of threads
+  int32_t weights[OPNUM];                ///< weights of operations
+  int32_t wsum;                          ///< sum of weights
+  int32_t kdist;                         ///< key distribution
+  double theta;                          ///< skewness of the Zipfian distribution
+  int64_t vsiz;                          ///< size of each value
+  int32_t vdist;                         ///< value size distribution
+  int64_t slen;                          ///< number of records of each scan
+};
+
+
+// function prototypes
+int main(int argc, char** argv);
+static void usage();
+static void dberrprint(kc::BasicDB* db, int32_t line, const char* func);
+static int64_t nanotime();
+static void printstathead();
+static void printstat(const char* name, const OpStat& stat, double etime);
+static int32_t runrun(int argc, char** argv);
+static int32_t runreplay(int argc, char** argv);
+static int32_t procrun(const char* path, const Workload& wl, bool load, int32_t oflags, bool lv);
+static int32_t procreplay(const char* path, const char* tpath, int32_t thnum, bool fast,
+                          double speed, int32_t oflags, bool lv);
+
+
+// main routine
+int main(int argc, char** argv) {
+  g_progname = argv[0];
+  const char* ebuf = kc::getenv("KCRNDSEED");
+  g_randseed = ebuf ? (uint32_t)kc::atoi(ebuf) : (uint32_t)(kc::time() * 1000);
+  mysrand(g_randseed);
+  kc::setstdiobin();
+  if (argc < 2) usage();
+  int32_t rv = 0;
+  if (!std::strcmp(argv[1], "run")) {
+    rv = runrun(argc, argv);
+  } else if (!std::strcmp(argv[1], "replay")) {
+    rv = runreplay(argc, argv);
+  } else if (!std::strcmp(argv[1], "--version")) {
+    printversion();
+  } else {
+    usage();
+  }
+  if (rv != 0) {
+    eprintf("FAILED: KCRNDSEED=%u PID=%ld", g_randseed, (long)kc::getpid());
+    for (int32_t i = 0; i < argc; i++) {
+      eprintf(" %s", argv[i]);
+    }
+    eprintf("\n\n");
+  }
+  return rv;
+}
+
+
+// print the usage and exit
+static void usage() {
+  eprintf("%s: workload benchmark of the polymorphic database of Kyoto Cabinet\n", g_progname);
+  eprintf("\n");
+  eprintf("usage:\n");
+  eprintf("  %s run [-th num] [-ops num] [-load] [-get num] [-set num] [-rem num] [-scan num]"
+          " [-cas num] [-slen num] [-uni|-zipf|-latest] [-theta num] [-vsiz num]"
+          " [-vfix|-vuni|-vexp] [-oat|-oas|-onl|-otl|-onr] [-lv] path rnum\n", g_progname);
+  eprintf("  %s replay [-th num] [-fast] [-speed num] [-oat|-oas|-onl|-otl|-onr] [-lv]"
+          " path file\n", g_progname);
+  eprintf("\n");
+  std::exit(1);
+}
+
+
+// print the error message of a database
+static void dberrprint(kc::BasicDB* db, int32_t line, const char* func) {
+  const kc::BasicDB::Error& err = db->error();
+  eprintf("%s: %d: %s: %s: %d: %s: %s\n",
+          g_progname, line, func, db->path().c_str(), err.code(), err.name(), err.message());
+}
+
+
+// get the time of a monotonic clock in nanoseconds
+static int64_t nanotime() {
+#if defined(_SYS_MSVC_) || defined(_SYS_MINGW_) || defined(_SYS_MACOSX_)
+  return (int64_t)(kc::time() * 1000000000.0);
+#else
+  struct ::timespec ts;
+  if (::clock_gettime(CLOCK_MONOTONIC, &ts) != 0) return (int64_t)(kc::time() * 1000000000.0);
+  return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+#endif
+}
+
+
+// print the header of the statistics
+static void printstathead() {
+  oprintf("op\tcount\tmiss\terror\ttime\tqps\tmean\tp50\tp99\tp999\tmax\n");
+}
+
+
+// print the statistics of an operation
+static void printstat(const char* name, const OpStat& stat, double etime) {
+  const Histogram& hist = stat.hist;
+  oprintf("%s\t%lld\t%lld\t%lld\t%.6f\t%.1f\t%.3f\t%.3f\t%.3f\t%.3f\t%.3f\n",
+          name, (long long)hist.count(), (long long)stat.miss, (long long)stat.error,
+          etime, etime > 0 ? hist.count() / etime : 0.0, hist.mean() / 1000.0,
+          hist.percentile(0.5) / 1000.0, hist.percentile(0.99) / 1000.0,
+          hist.percentile(0.999) / 1000.0, hist.max() / 1000.0);
+}
+
+
+// parse arguments of run command
+static int32_t runrun(int argc, char** argv) {
+  bool argbrk = false;
+  const char* path = NULL;
+  const char* rstr = NULL;
+  Workload wl;
+  wl.rnum = 0;
+  wl.opnum = -1;
+  wl.thnum = 1;
+  for (int32_t i = 0; i < OPNUM; i++) {
+    wl.weights[i] = -1;
+  }
+  wl.wsum = 0;
+  wl.kdist = KDUNIFORM;
+  wl.theta = 0.99;
+  wl.vsiz = 100;
+  wl.vdist = VDFIXED;
+  wl.slen = 10;
+  bool load = false;
+  int32_t oflags = 0;
+  bool lv = false;
+  for (int32_t i = 2; i < argc; i++) {
+    if (!argbrk && argv[i][0] == '-') {
+      if (!std::strcmp(argv[i], "--")) {
+        argbrk = true;
+      } else if (!std::strcmp(argv[i], "-th")) {
+        if (++i >= argc) usage();
+        wl.thnum = kc::atoix(argv[i]);
+      } else if (!std::strcmp(argv[i], "-ops")) {
+        if (++i >= argc) usage();
+        wl.opnum = kc::atoix(argv[i]);
+      } else if (!std::strcmp(argv[i], "-load")) {
+        load = true;
+      } else if (!std::strcmp(argv[i], "-get")) {
+        if (++i >= argc) usage();
+        wl.weights[OPGET] = kc::atoix(argv[i]);
+      } else if (!std::strcmp(argv[i], "-set")) {
+        if (++i >= argc) usage();
+        wl.weights[OPSET] = kc::atoix(argv[i]);
+      } else if (!std::strcmp(argv[i], "-rem")) {
+        if (++i >= argc) usage();
+        wl.weights[OPREMOVE] = kc::atoix(argv[i]);
+      } else if (!std::strcmp(argv[i], "-scan")) {
+        if (++i >= argc) usage();
+        wl.weights[OPSCAN] = kc::atoix(argv[i]);
+      } else if (!std::strcmp(argv[i], "-cas")) {
+        if (++i >= argc) usage();
+        wl.weights[OPCAS] = kc::atoix(argv[i]);
+      } else if (!std::strcmp(argv[i], "-slen")) {
+        if (++i >= argc) usage();
+        wl.slen = kc::atoix(argv[i]);
+      } else if (!std::strcmp(argv[i], "-uni")) {
+        wl.kdist = KDUNIFORM;
+      } else if (!std::strcmp(argv[i], "-zipf")) {
+        wl.kdist = KDZIPF;
+      } else if (!std::strcmp(argv[i], "-latest")) {
+        wl.kdist = KDLATEST;
+      } else if (!std::strcmp(argv[i], "-theta")) {
+        if (++i >= argc) usage();
+        wl.theta = kc::atof(argv[i]);
+      } else if (!std::strcmp(argv[i], "-vsiz")) {
+        if (++i >= argc) usage();
+        wl.vsiz = kc::atoix(argv[i]);
+      } else if (!std::strcmp(argv[i], "-vfix")) {
+        wl.vdist = VDFIXED;
+      } else if (!std::strcmp(argv[i], "-vuni")) {
+        wl.vdist = VDUNIFORM;
+      } else if (!std::strcmp(argv[i], "-vexp")) {
+        wl.vdist = VDEXP;
+      } else if (!std::strcmp(argv[i], "-oat")) {
+        oflags |= kc::PolyDB::OAUTOTRAN;
+      } else if (!std::strcmp(argv[i], "-oas")) {
+        oflags |= kc::PolyDB::OAUTOSYNC;
+      } else if (!std::strcmp(argv[i], "-onl")) {
+        oflags |= kc::PolyDB::ONOLOCK;
+      } else if (!std::strcmp(argv[i], "-otl")) {
+        oflags |= kc::PolyDB::OTRYLOCK;
+      } else if (!std::strcmp(argv[i], "-onr")) {
+        oflags |= kc::PolyDB::ONOREPAIR;
+      } else if (!std::strcmp(argv[i], "-lv")) {
+        lv = true;
+      } else {
+        usage();
+      }
+    } else if (!path) {
+      argbrk = true;
+      path = argv[i];
+    } else if (!rstr) {
+      rstr = argv[i];
+    } else {
+      usage();
+    }
+  }
+  if (!path || !rstr) usage();
+  wl.rnum = kc::atoix(rstr);
+  if (wl.rnum < 1 || wl.thnum < 1 || wl.vsiz < 0 || wl.slen < 1) usage();
+  if (wl.theta <= 0 || wl.theta >= 1) usage();
+  if (wl.thnum > THREADMAX) wl.thnum = THREADMAX;
+  if (wl.opnum < 0) wl.opnum = wl.rnum;
+  bool mixed = false;
+  for (int32_t i = OPGET; i < OPNUM; i++) {
+    if (wl.weights[i] >= 0) mixed = true;
+  }
+  for (int32_t i = OPGET; i < OPNUM; i++) {
+    if (wl.weights[i] < 0) wl.weights[i] = mixed ? 0 : (i == OPGET || i == OPSET) ? 50 : 0;
+    wl.wsum += wl.weights[i];
+  }
+  wl.weights[OPLOAD] = 0;
+  if (wl.wsum < 1 && wl.opnum > 0) usage();
+  int32_t rv = procrun(path, wl, load, oflags, lv);
+  return rv;
+}
+
+
+// parse arguments of replay command
+static int32_t runreplay(int argc, char** argv) {
+  bool argbrk = false;
+  const char* path = NULL;
+  const char* tpath = NULL;
+  int32_t thnum = 0;
+  bool fast = false;
+  double speed = 1.0;
+  int32_t oflags = 0;
+  bool lv = false;
+  for (int32_t i = 2; i < argc; i++) {
+    if (!argbrk && argv[i][0] == '-') {
+      if (!std::strcmp(argv[i], "--")) {
+        argbrk = true;
+      } else if (!std::strcmp(argv[i], "-th")) {
+        if (++i >= argc) usage();
+        thnum = kc::atoix(argv[i]);
+      } else if (!std::strcmp(argv[i], "-fast")) {
+        fast = true;
+      } else if (!std::strcmp(argv[i], "-speed")) {
+        if (++i >= argc) usage();
+        speed = kc::atof(argv[i]);
+      } else if (!std::strcmp(argv[i], "-oat")) {
+        oflags |= kc::PolyDB::OAUTOTRAN;
+      } else if (!std::strcmp(argv[i], "-oas")) {
+        oflags |= kc::PolyDB::OAUTOSYNC;
+      } else if (!std::strcmp(argv[i], "-onl")) {
+        oflags |= kc::PolyDB::ONOLOCK;
+      } else if (!std::strcmp(argv[i], "-otl")) {
+        oflags |= kc::PolyDB::OTRYLOCK;
+      } else if (!std::strcmp(argv[i], "-onr")) {
+        oflags |= kc::PolyDB::ONOREPAIR;
+      } else if (!std::strcmp(argv[i], "-lv")) {
+        lv = true;
+      } else {
+        usage();
+      }
+    } else if (!path) {
+      argbrk = true;
+      path = argv[i];
+    } else if (!tpath) {
+      tpath = argv[i];
+    } else {
+      usage();
+    }
+  }
+  if (!path || !tpath) usage();
+  if (thnum < 0 || speed <= 0) usage();
+  if (thnum > THREADMAX) thnum = THREADMAX;
+  int32_t rv = procreplay(path, tpath, thnum, fast, speed, oflags, lv);
+  return rv;
+}
+
+
+// perform run command
+static int32_t procrun(const char* path, const Workload& wl, bool load, int32_t oflags, bool lv) {
+  const char* kdnames[] = { "uniform", "zipf", "latest" };
+  const char* vdnames[] = { "fixed", "uniform", "exp" };
+  oprintf("#seed=%u\tpath=%s\trnum=%lld\tops=%lld\tthnum=%d\tload=%d\tdist=%s\ttheta=%.3f"
+          "\tvsiz=%lld\tvdist=%s\tslen=%lld\tmix=",
+          g_randseed, path, (long long)wl.rnum, (long long)wl.opnum, wl.thnum, load,
+          kdnames[wl.kdist], wl.theta, (long long)wl.vsiz, vdnames[wl.vdist],
+          (long long)wl.slen);
+  for (int32_t i = OPGET; i < OPNUM; i++) {
+    oprintf("%s%s:%d", i > OPGET ? "," : "", OPNAMES[i], wl.weights[i]);
+  }
+  oprintf("\n");
+  bool err = false;
+  kc::PolyDB db;
+  db.tune_logger(stdlogger(g_progname, &std::cerr),
+                 lv ? kc::UINT32MAX : kc::BasicDB::Logger::WARN | kc::BasicDB::Logger::ERROR);
+  uint32_t omode = kc::PolyDB::OWRITER | kc::PolyDB::OCREATE;
+  if (load) omode |= kc::PolyDB::OTRUNCATE;
+  if (!db.open(path, omode | oflags)) {
+    dberrprint(&db, __LINE__, "DB::open");
+    return 1;
+  }
+  int64_t vbsiz = wl.vsiz * VALBUFMUL + 1;
+  char* vbuf = new char[vbsiz];
+  for (int64_t i = 0; i < vbsiz; i++) {
+    vbuf[i] = 'a' + myrand(26);
+  }
+  ZipfGenerator zipf(wl.kdist == KDUNIFORM ? 1 : wl.rnum, wl.theta);
+  kc::AtomicInt64 keynum;
+  keynum = wl.rnum;
+  class ThreadBench : public kc::Thread {
+   public:
+    void setparams(int32_t id, kc::BasicDB* db, const Workload* wl, const ZipfGenerator* zipf,
+                   kc::AtomicInt64* keynum, const char* vbuf, int64_t vbsiz, bool load) {
+      id_ = id;
+      db_ = db;
+      wl_ = wl;
+      zipf_ = zipf;
+      keynum_ = keynum;
+      vbuf_ = vbuf;
+      vbsiz_ = vbsiz;
+      load_ = load;
+      rnd_.reset(g_randseed + id * 7919ULL);
+    }
+    const OpStat& stat(int32_t op) {
+      return stats_[op];
+    }
+    void run() {
+      if (load_) {
+        doload();
+      } else {
+        dorun();
+      }
+    }
+   private:
+    void doload() {
+      int64_t knum = wl_->rnum;
+      int64_t range = knum / wl_->thnum + 1;
+      int64_t beg = id_ * range;
+      int64_t end = beg + range < knum ? beg + range : knum;
+      for (int64_t i = beg; i < end; i++) {
+        char kbuf[RECBUFSIZ];
+        size_t ksiz = std::sprintf(kbuf, "%010lld", (long long)i);
+        size_t vsiz = valsize();
+        int64_t stime = nanotime();
+        bool ok = db_->set(kbuf, ksiz, vbuf_ + rnd_.range(vbsiz_ - vsiz), vsiz);
+        stats_[OPLOAD].hist.add(nanotime() - stime);
+        if (!ok) {
+          dberrprint(db_, __LINE__, "DB::set");
+          stats_[OPLOAD].error++;
+        }
+      }
+    }
+    void dorun() {
+      kc::DB::Cursor* cur = db_->cursor();
+      std::string value;
+      for (int64_t i = 0; i < wl_->opnum; i++) {
+        int32_t op = selop();
+        char kbuf[RECBUFSIZ];
+        size_t ksiz = std::sprintf(kbuf, "%010lld", (long long)selkey(op));
+        size_t vsiz = valsize();
+        const char* vptr = vbuf_ + rnd_.range(vbsiz_ - vsiz);
+        OpStat* stat = stats_ + op;
+        int64_t stime = nanotime();
+        bool ok = true;
+        bool hit = true;
+        switch (op) {
+          case OPGET: {
+            ok = db_->get(std::string(kbuf, ksiz), &value);
+            break;
+          }
+          case OPSET: {
+            ok = db_->set(kbuf, ksiz, vptr, vsiz);
+            break;
+          }
+          case OPREMOVE: {
+            ok = db_->remove(kbuf, ksiz);
+            break;
+          }
+          case OPSCAN: {
+            ok = cur->jump(kbuf, ksiz);
+            std::string rkey;
+            for (int64_t j = 0; ok && j < wl_->slen; j++) {
+              if (!cur->get(&rkey, &value, true)) ok = j > 0;
+            }
+            break;
+          }
+          case OPCAS: {
+            std::string key(kbuf, ksiz);
+            if (db_->get(key, &value)) {
+              ok = db_->cas(kbuf, ksiz, value.data(), value.size(), vptr, vsiz);
+            } else if (db_->error() == kc::BasicDB::Error::NOREC) {
+              ok = db_->cas(kbuf, ksiz, NULL, 0, vptr, vsiz);
+            } else {
+              ok = false;
+            }
+            break;
+          }
+        }
+        int64_t etime = nanotime();
+        if (!ok) {
+          kc::BasicDB::Error::Code code = db_->error().code();
+          if (code == kc::BasicDB::Error::NOREC || code == kc::BasicDB::Error::LOGIC) {
+            hit = false;
+          } else {
+            dberrprint(db_, __LINE__, OPNAMES[op]);
+            stat->error++;
+          }
+        }
+        if (!hit) stat->miss++;
+        stat->hist.add(etime - stime);
+      }
+      delete cur;
+    }
+    int32_t selop() {
+      int32_t num = rnd_.range(wl_->wsum);
+      for (int32_t i = OPGET; i < OPNUM; i++) {
+        if (num < wl_->weights[i]) return i;
+        num -= wl_->weights[i];
+      }
+      return OPGET;
+    }
+    int64_t selkey(int32_t op) {
+      switch (wl_->kdist) {
+        case KDZIPF: {
+          uint64_t rank = zipf_->rank(&rnd_);
+          return kc::hashmurmur(&rank, sizeof(rank)) % wl_->rnum;
+        }
+        case KDLATEST: {
+          if (op == OPSET) return (*keynum_ += 1) - 1;
+          int64_t knum = keynum_->get();
+          return knum - 1 - zipf_->rank(&rnd_) % knum;
+        }
+      }
+      return rnd_.range(wl_->rnum);
+    }
+    size_t valsize() {
+      int64_t vsiz = wl_->vsiz;
+      switch (wl_->vdist) {
+        case VDUNIFORM: {
+          vsiz = rnd_.range(vsiz * 2 + 1);
+          break;
+        }
+        case VDEXP: {
+          vsiz = (int64_t)(-std::log(1 - rnd_.real()) * vsiz);
+          break;
+        }
+      }
+      int64_t max = vbsiz_ - 1;
+      return vsiz < max ? vsiz : max;
+    }
+    int32_t id_;
+    kc::BasicDB* db_;
+    const Workload* wl_;
+    const ZipfGenerator* zipf_;
+    kc::AtomicInt64* keynum_;
+    const char* vbuf_;
+    int64_t vbsiz_;
+    bool load_;
+    Randomizer rnd_;
+    OpStat stats_[OPNUM];
+  };
+  ThreadBench* threads = new ThreadBench[wl.thnum];
+  OpStat totals[OPNUM];
+  double times[OPNUM];
+  for (int32_t i = 0; i < OPNUM; i++) {
+    times[i] = 0;
+  }
+  double rtime = 0;
+  for (int32_t phase = load ? 0 : 1; phase < 2; phase++) {
+    for (int32_t i = 0; i < wl.thnum; i++) {
+      threads[i].setparams(i, &db, &wl, &zipf, &keynum, vbuf, vbsiz, phase == 0);
+    }
+    double stime = kc::time();
+    if (wl.thnum < 2) {
+      threads[0].run();
+    } else {
+      for (int32_t i = 0; i < wl.thnum; i++) {
+        threads[i].start();
+      }
+      for (int32_t i = 0; i < wl.thnum; i++) {
+        threads[i].join();
+      }
+    }
+    double etime = kc::time() - stime;
+    if (phase > 0) rtime = etime;
+    for (int32_t i = 0; i < OPNUM; i++) {
+      if ((phase == 0) != (i == OPLOAD)) continue;
+      times[i] = etime;
+      for (int32_t j = 0; j < wl.thnum; j++) {
+        const OpStat& stat = threads[j].stat(i);
+        totals[i].hist.merge(stat.hist);
+        totals[i].miss += stat.miss;
+        totals[i].error += stat.error;
+      }
+    }
+  }
+  printstathead();
+  OpStat all;
+  for (int32_t i = 0; i < OPNUM; i++) {
+    const OpStat& stat = totals[i];
+    if (stat.hist.count() < 1) continue;
+    printstat(OPNAMES[i], stat, times[i]);
+    if (i != OPLOAD) {
+      all.hist.merge(stat.hist);
+      all.miss += stat.miss;
+      all.error += stat.error;
+    }
+    if (stat.error > 0) err = true;
+  }
+  if (all.hist.count() > 0) printstat("total", all, rtime);
+  delete[] threads;
+  delete[] vbuf;
+  if (!db.close()) {
+    dberrprint(&db, __LINE__, "DB::close");
+    err = true;
+  }
+  return err ? 1 : 0;
+}
+
+
+// perform replay command
+static int32_t procreplay(const char* path, const char* tpath, int32_t thnum, bool fast,
+                          double speed, int32_t oflags, bool lv) {
+  oprintf("#seed=%u\tpath=%s\ttrace=%s\tthnum=%d\tfast=%d\tspeed=%.3f\n",
+          g_randseed, path, tpath, thnum, fast, speed);
+  kc::PolyDB::TraceReader reader;
+  if (!reader.open(tpath)) {
+    eprintf("%s: %s: opening the trace failed\n", g_progname, tpath);
+    return 1;
+  }
+  typedef std::vector<kc::PolyDB::TraceRecord> RecordList;
+  std::vector<RecordList> lists;
+  int64_t rnum = 0;
+  int64_t vsmax = 0;
+  kc::PolyDB::TraceRecord rec;
+  while (reader.read(&rec)) {
+    if (rec.kind < kc::PolyDB::TRGET || rec.kind >= TRKINDNUM) {
+      eprintf("%s: %s: unknown operation kind: %d\n", g_progname, tpath, rec.kind);
+      reader.close();
+      return 1;
+    }
+    if (rec.thid >= lists.size()) {
+      if (rec.thid >= (uint32_t)THREADMAX) {
+        eprintf("%s: %s: too many threads\n", g_progname, tpath);
+        reader.close();
+        return 1;
+      }
+      lists.resize(rec.thid + 1);
+    }
+    lists[rec.thid].push_back(rec);
+    if (rec.vsiz > vsmax) vsmax = rec.vsiz;
+    rnum++;
+  }
+  reader.close();
+  if (thnum > 0 && thnum < (int32_t)lists.size()) {
+    eprintf("%s: %s: the trace has %d threads, more than the workers\n",
+            g_progname, tpath, (int)lists.size());
+    return 1;
+  }
+  if ((int32_t)lists.size() < thnum) lists.resize(thnum);
+  if (lists.empty()) lists.resize(1);
+  thnum = lists.size();
+  oprintf("#rnum=%lld\tthreads=%d\thashed=%d\n", (long long)rnum, thnum, reader.hashed());
+  bool err = false;
+  kc::PolyDB db;
+  db.tune_logger(stdlogger(g_progname, &std::cerr),
+                 lv ? kc::UINT32MAX : kc::BasicDB::Logger::WARN | kc::BasicDB::Logger::ERROR);
+  if (!db.open(path, kc::PolyDB::OWRITER | kc::PolyDB::OCREATE | oflags)) {
+    dberrprint(&db, __LINE__, "DB::open");
+    return 1;
+  }
+  char* vbuf = new char[vsmax+1];
+  for (int64_t i = 0; i <= vsmax; i++) {
+    vbuf[i] = 'a' + myrand(26);
+  }
+  class ThreadReplay : public kc::Thread {
+   public:
+    void setparams(kc::BasicDB* db, const RecordList* recs, bool fast, double speed,
+                   const char* vbuf, double stime) {
+      db_ = db;
+      recs_ = recs;
+      fast_ = fast;
+      speed_ = speed;
+      vbuf_ = vbuf;
+      stime_ = stime;
+    }
+    const OpStat& stat(int32_t kind) {
+      return stats_[kind];
+    }
+    void run() {
+      class VisitorImpl : public kc::DB::Visitor {
+      };
+      VisitorImpl visitor;
+      std::string value;
+      RecordList::const_iterator it = recs_->begin();
+      RecordList::const_iterator itend = recs_->end();
+      while (it != itend) {
+        const kc::PolyDB::TraceRecord& rec = *it;
+        if (!fast_) {
+          double wtime = stime_ + rec.time / 1000000.0 / speed_ - kc::time();
+          if (wtime > 0) kc::Thread::sleep(wtime);
+        }
+        const std::string& key = rec.key;
+        OpStat* stat = stats_ + rec.kind;
+        int64_t stime = nanotime();
+        bool ok = true;
+        switch (rec.kind) {
+          case kc::PolyDB::TRGET:
+          case kc::PolyDB::TRMISS: {
+            ok = db_->get(key, &value);
+            break;
+          }
+          case kc::PolyDB::TRSET:
+          case kc::PolyDB::TRADD: {
+            ok = db_->set(key.data(), key.size(), vbuf_, rec.vsiz);
+            break;
+          }
+          case kc::PolyDB::TRREMOVE: {
+            ok = db_->remove(key);
+            break;
+          }
+          case kc::PolyDB::TRITERATE: {
+            ok = db_->iterate(&visitor, false);
+            break;
+          }
+          case kc::PolyDB::TRSYNC: {
+            ok = db_->synchronize();
+            break;
+          }
+          case kc::PolyDB::TRBEGIN: {
+            ok = db_->begin_transaction();
+            break;
+          }
+          case kc::PolyDB::TRCOMMIT: {
+            ok = db_->end_transaction(true);
+            break;
+          }
+          case kc::PolyDB::TRABORT: {
+            ok = db_->end_transaction(false);
+            break;
+          }
+          case kc::PolyDB::TRCLEAR: {
+            ok = db_->clear();
+            break;
+          }
+        }
+        int64_t etime = nanotime();
+        if (!ok) {
+          kc::BasicDB::Error::Code code = db_->error().code();
+          if (code == kc::BasicDB::Error::NOREC || code == kc::BasicDB::Error::DUPREC) {
+            stat->miss++;
+          } else {
+            dberrprint(db_, __LINE__, TRNAMES[rec.kind]);
+            stat->error++;
+          }
+        }
+        stat->hist.add(etime - stime);
+        ++it;
+      }
+    }
+   private:
+    kc::BasicDB* db_;
+    const RecordList* recs_;
+    bool fast_;
+    double speed_;
+    const char* vbuf_;
+    double stime_;
+    OpStat stats_[TRKINDNUM];
+  };
+  ThreadReplay* threads = new ThreadReplay[thnum];
+  double stime = kc::time();
+  for (int32_t i = 0; i < thnum; i++) {
+    threads[i].setparams(&db, &lists[i], fast, speed, vbuf, stime);
+  }
+  if (thnum < 2) {
+    threads[0].run();
+  } else {
+    for (int32_t i = 0; i < thnum; i++) {
+      threads[i].start();
+    }
+    for (int32_t i = 0; i < thnum; i++) {
+      threads[i].join();
+    }
+  }
+  double etime = kc::time() - stime;
+  printstathead();
+  OpStat all;
+  for (int32_t i = kc::PolyDB::TRGET; i < TRKINDNUM; i++) {
+    OpStat total;
+    for (int32_t j = 0; j < thnum; j++) {
+      const OpStat& stat = threads[j].stat(i);
+      total.hist.merge(stat.hist);
+      total.miss += stat.miss;
+      total.error += stat.error;
+    }
+    if (total.hist.count() < 1) continue;
+    printstat(TRNAMES[i], total, etime);
+    all.hist.merge(total.hist);
+    all.miss += total.miss;
+    all.error += total.error;
+    if (total.error > 0) err = true;
+  }
+  if (all.hist.count() > 0) printstat("total", all, etime);
+  delete[] threads;
+  delete[] vbuf;
+  if (!db.close()) {
+    dberrprint(&db, __LINE__, "DB::close");
+    err = true;
+  }
+  return err ? 1 : 0;
+}
+
+
+
+// END OF FILE
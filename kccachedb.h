@@ -70,6 +70,14 @@ class CacheDB : public BasicDB {
   static const size_t OPAQUESIZ = 16;
   /** The threshold of busy loop and sleep for locking. */
   static const uint32_t LOCKBUSYLOOP = 8192;
+  /** Indices of the counters of the metrics. */
+  enum MetricsCounter {
+    MCHIT,                               ///< records found
+    MCMISS,                              ///< records not found
+    MCCHAIN,                             ///< records walked in collision chains
+    MCEVICT,                             ///< records evicted by the capacity limit
+    MCNUM                                ///< number of counters
+  };
  public:
   /**
    * Cursor to indicate a record.
@@ -374,7 +382,7 @@ class CacheDB : public BasicDB {
    */
   explicit CacheDB() :
       mlock_(), flock_(), error_(), logger_(NULL), logkinds_(0), mtrigger_(NULL),
-      omode_(0), curs_(), path_(""), type_(TYPECACHE),
+      mtrc_(NULL), cmgr_(NULL), cmslot_(NULL), omode_(0), curs_(), path_(""), type_(TYPECACHE),
       opts_(0), bnum_(DEFBNUM), capcnt_(-1), capsiz_(-1),
       opaque_(), embcomp_(ZLIBRAWCOMP), comp_(NULL), slots_(), tran_(false) {
     _assert_(true);
@@ -395,6 +403,7 @@ class CacheDB : public BasicDB {
         ++cit;
       }
     }
+    delete mtrc_;
   }
   /**
    * Accept a visitor to a record.
@@ -409,6 +418,7 @@ class CacheDB : public BasicDB {
    */
   bool accept(const char* kbuf, size_t ksiz, Visitor* visitor, bool writable = true) {
     _assert_(kbuf && ksiz <= MEMMAXSIZ && visitor);
+    Metrics::ScopedTimer mtimer(mtrc_, Metrics::ACCEPT);
     ScopedSpinRWLock lock(&mlock_, false);
     if (omode_ == 0) {
       set_error(_KCCODELINE_, Error::INVALID, "not opened");
@@ -441,6 +451,7 @@ class CacheDB : public BasicDB {
   bool accept_bulk(const std::vector<std::string>& keys, Visitor* visitor,
                    bool writable = true) {
     _assert_(visitor);
+    Metrics::ScopedTimer mtimer(mtrc_, Metrics::ACCEPT);
     ScopedSpinRWLock lock(&mlock_, false);
     if (omode_ == 0) {
       set_error(_KCCODELINE_, Error::INVALID, "not opened");
@@ -505,6 +516,7 @@ class CacheDB : public BasicDB {
    */
   bool iterate(Visitor *visitor, bool writable = true, ProgressChecker* checker = NULL) {
     _assert_(visitor);
+    Metrics::ScopedTimer mtimer(mtrc_, Metrics::ITERATE);
     ScopedSpinRWLock lock(&mlock_, true);
     if (omode_ == 0) {
       set_error(_KCCODELINE_, Error::INVALID, "not opened");
@@ -630,6 +642,7 @@ class CacheDB : public BasicDB {
     for (int32_t i = 0; i < SLOTNUM; i++) {
       initialize_slot(slots_ + i, bnum, capcnt, capsiz);
     }
+    if (cmgr_) cmslot_ = cmgr_->attach(path);
     comp_ = (opts_ & TCOMPRESS) ? embcomp_ : NULL;
     std::memset(opaque_, 0, sizeof(opaque_));
     trigger_meta(MetaTrigger::OPEN, "open");
@@ -651,6 +664,10 @@ class CacheDB : public BasicDB {
     for (int32_t i = SLOTNUM - 1; i >= 0; i--) {
       destroy_slot(slots_ + i);
     }
+    if (cmslot_) {
+      cmgr_->detach(cmslot_);
+      cmslot_ = NULL;
+    }
     path_.clear();
     omode_ = 0;
     trigger_meta(MetaTrigger::CLOSE, "close");
@@ -670,6 +687,7 @@ class CacheDB : public BasicDB {
   bool synchronize(bool hard = false, FileProcessor* proc = NULL,
                    ProgressChecker* checker = NULL) {
     _assert_(true);
+    Metrics::ScopedTimer mtimer(mtrc_, Metrics::SYNCHRONIZE);
     ScopedSpinRWLock lock(&mlock_, false);
     if (omode_ == 0) {
       set_error(_KCCODELINE_, Error::INVALID, "not opened");
@@ -785,6 +803,7 @@ class CacheDB : public BasicDB {
    */
   bool end_transaction(bool commit = true) {
     _assert_(true);
+    Metrics::ScopedTimer mtimer(commit ? mtrc_ : NULL, Metrics::COMMITTRAN);
     ScopedSpinRWLock lock(&mlock_, true);
     if (omode_ == 0) {
       set_error(_KCCODELINE_, Error::INVALID, "not opened");
@@ -904,6 +923,22 @@ class CacheDB : public BasicDB {
     }
     (*strmap)["count"] = strprintf("%lld", (long long)count_impl());
     (*strmap)["size"] = strprintf("%lld", (long long)size_impl());
+    if (mtrc_) {
+      mtrc_->status(strmap);
+      int64_t hit = mtrc_->get(MCHIT);
+      int64_t miss = mtrc_->get(MCMISS);
+      (*strmap)["mt_hitrate"] =
+          strprintf("%.6f", hit + miss > 0 ? (double)hit / (hit + miss) : 0.0);
+      (*strmap)["mt_chainavg"] =
+          strprintf("%.3f", hit + miss > 0 ? (double)mtrc_->get(MCCHAIN) / (hit + miss) : 0.0);
+    }
+    if (cmslot_) {
+      (*strmap)["cm_budget"] = strprintf("%lld", (long long)cmgr_->budget());
+      (*strmap)["cm_quota"] = strprintf("%lld", (long long)cmslot_->quota());
+      (*strmap)["cm_usage"] = strprintf("%lld", (long long)cmslot_->usage());
+      (*strmap)["cm_hits"] = strprintf("%lld", (long long)cmslot_->hits());
+      (*strmap)["cm_misses"] = strprintf("%lld", (long long)cmslot_->misses());
+    }
     return true;
   }
   /**
@@ -950,6 +985,44 @@ class CacheDB : public BasicDB {
     mtrigger_ = trigger;
     return true;
   }
+  /**
+   * Enable or disable the collection of runtime metrics.
+   * @param enabled true to collect metrics, or false not to.
+   * @return true on success, or false on failure.
+   * @note The collected metrics are reported by the status method with the prefix "mt_".
+   */
+  bool tune_metrics(bool enabled = true) {
+    _assert_(true);
+    ScopedSpinRWLock lock(&mlock_, true);
+    if (omode_ != 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "already opened");
+      return false;
+    }
+    static const char* const names[] = { "hit", "miss", "chain", "evict" };
+    delete mtrc_;
+    mtrc_ = enabled ? new Metrics(names, MCNUM) : NULL;
+    return true;
+  }
+  /**
+   * Set the shared cache manager.
+   * @param cmgr the cache manager object.  If it is NULL, the memory is not shared.
+   * @return true on success, or false on failure.
+   * @note The database registers itself with the manager when it is opened and unregisters
+   * itself when it is closed.  While registered, the least recently used records are removed
+   * when the total size of records exceeds the quota assigned by the manager, in addition to
+   * the capacity set by cap_size.  The assignment is reported by the status method with the
+   * prefix "cm_".
+   */
+  bool tune_cache_manager(CacheManager* cmgr) {
+    _assert_(true);
+    ScopedSpinRWLock lock(&mlock_, true);
+    if (omode_ != 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "already opened");
+      return false;
+    }
+    cmgr_ = cmgr;
+    return true;
+  }
   /**
    * Set the optional features.
    * @param opts the optional features by bitwise-or: DirDB::TCOMPRESS to compress each record.
@@ -1474,6 +1547,7 @@ class CacheDB : public BasicDB {
     Record** entp = slot->buckets + bidx;
     uint32_t fhash = fold_hash(hash) & ~KSIZMAX;
     while (rec) {
+      if (mtrc_ && !isiter) mtrc_->add(MCCHAIN);
       uint32_t rhash = rec->ksiz & ~KSIZMAX;
       uint32_t rksiz = rec->ksiz & KSIZMAX;
       if (fhash > rhash) {
@@ -1492,6 +1566,8 @@ class CacheDB : public BasicDB {
           entp = &rec->right;
           rec = rec->right;
         } else {
+          if (mtrc_ && !isiter) mtrc_->add(MCHIT);
+          if (cmslot_ && !isiter) cmslot_->hit();
           const char* rvbuf = dbuf + rksiz;
           size_t rvsiz = rec->vsiz;
           char* zbuf = NULL;
@@ -1542,6 +1618,7 @@ class CacheDB : public BasicDB {
             }
             slot->count--;
             slot->size -= sizeof(Record) + rksiz + rec->vsiz;
+            if (cmslot_) cmslot_->add_usage(-(int64_t)(sizeof(Record) + rksiz + rec->vsiz));
             xfree(rec);
           } else {
             bool adj = false;
@@ -1563,6 +1640,7 @@ class CacheDB : public BasicDB {
               }
               slot->size -= rec->vsiz;
               slot->size += vsiz;
+              if (cmslot_) cmslot_->add_usage((int64_t)vsiz - (int64_t)rec->vsiz);
               if (vsiz > rec->vsiz) {
                 Record* old = rec;
                 rec = (Record*)xrealloc(rec, sizeof(*rec) + ksiz + vsiz);
@@ -1596,6 +1674,8 @@ class CacheDB : public BasicDB {
         }
       }
     }
+    if (mtrc_ && !isiter) mtrc_->add(MCMISS);
+    if (cmslot_ && !isiter) cmslot_->miss();
     size_t vsiz;
     const char* vbuf = visitor->visit_empty(kbuf, ksiz, &vsiz);
     if (vbuf != Visitor::NOP && vbuf != Visitor::REMOVE) {
@@ -1613,6 +1693,7 @@ class CacheDB : public BasicDB {
         slot->trlogs.push_back(log);
       }
       slot->size += sizeof(Record) + ksiz + vsiz;
+      if (cmslot_) cmslot_->add_usage(sizeof(Record) + ksiz + vsiz);
       rec = (Record*)xmalloc(sizeof(*rec) + ksiz + vsiz);
       char* dbuf = (char*)rec + sizeof(*rec);
       std::memcpy(dbuf, kbuf, ksiz);
@@ -1733,6 +1814,7 @@ class CacheDB : public BasicDB {
     slot->first = NULL;
     slot->last = NULL;
     slot->count = 0;
+    if (cmslot_) cmslot_->add_usage(-(int64_t)slot->size);
     slot->size = 0;
   }
   /**
@@ -1766,7 +1848,12 @@ class CacheDB : public BasicDB {
    */
   void adjust_slot_capacity(Slot* slot) {
     _assert_(slot);
-    if ((slot->count > slot->capcnt || slot->size > slot->capsiz) && slot->first) {
+    size_t capsiz = slot->capsiz;
+    if (cmslot_) {
+      int64_t quota = cmslot_->quota() / SLOTNUM;
+      if (quota < (int64_t)capsiz) capsiz = quota;
+    }
+    if ((slot->count > slot->capcnt || slot->size > capsiz) && slot->first) {
       Record* rec = slot->first;
       uint32_t rksiz = rec->ksiz & KSIZMAX;
       char* dbuf = (char*)rec + sizeof(*rec);
@@ -1776,6 +1863,7 @@ class CacheDB : public BasicDB {
       uint64_t hash = hash_record(kbuf, rksiz) / SLOTNUM;
       Remover remover;
       accept_impl(slot, hash, dbuf, rksiz, &remover, NULL, true);
+      if (mtrc_) mtrc_->add(MCEVICT);
       if (kbuf != stack) delete[] kbuf;
     }
   }
@@ -1877,6 +1965,12 @@ class CacheDB : public BasicDB {
   uint32_t logkinds_;
   /** The internal meta operation trigger. */
   MetaTrigger* mtrigger_;
+  /** The collector of runtime metrics. */
+  Metrics* mtrc_;
+  /** The shared cache manager. */
+  CacheManager* cmgr_;
+  /** The slot of the shared cache manager. */
+  CacheManager::Slot* cmslot_;
   /** The open mode. */
   uint32_t omode_;
   /** The cursor objects. */
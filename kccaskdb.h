@@ -0,0 +1,2345 @@
+/*************************************************************************************************
+ * Log-structured hash database
+ *                                                               Copyright (C) 2009-2011 FAL Labs
+ * This file is part of Kyoto Cabinet.
+ * This program is free software: you can redistribute it and/or modify it under the terms of
+ * the GNU General Public License as published by the Free Software Foundation, either version
+ * 3 of the License, or any later version.
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ *************************************************************************************************/
+
+
+#ifndef _KCCASKDB_H                      // duplication check
+#define _KCCASKDB_H
+
+#include <kccommon.h>
+#include <kcutil.h>
+#include <kcthread.h>
+#include <kcfile.h>
+#include <kccompress.h>
+#include <kccompare.h>
+#include <kcmap.h>
+#include <kcregex.h>
+#include <kcdb.h>
+
+#define KCCDBMAGICDATA  "KCCM\n"         ///< magic data of the meta data file
+#define KCCDBSEGMAGICDATA  "KCCS\n"      ///< magic data of the segment files
+#define KCCDBHINTMAGICDATA  "KCCH\n"     ///< magic data of the hint files
+#define KCCDBMETAFILE  "__meta__"        ///< meta data file of the directory
+#define KCCDBLOCKFILE  "__lock__"        ///< lock file of the directory
+#define KCCDBTMPPATHEXT  "tmp"           ///< extension of the temporary file
+#define KCCDBSEGPATHEXT  "data"          ///< extension of the segment files
+#define KCCDBHINTPATHEXT  "hint"         ///< extension of the hint files
+
+namespace kyotocabinet {                 // common namespace
+
+
+/**
+ * Log-structured hash database.
+ * @note This class is a concrete class to operate a write-optimized hash database in a
+ * directory.  Every update is appended to the active segment file and the location of the
+ * newest value of each key is kept in a hash table in memory.  When the active segment exceeds
+ * its capacity, it becomes immutable with a hint file which lists the locations of its records
+ * so that the table can be rebuilt without reading values.  A background thread merges the
+ * immutable segments into new ones holding only live records.  This class can be inherited but
+ * overwriting methods is forbidden.  Before every database operation, it is necessary to call
+ * the CaskDB::open method in order to open a database directory and connect the database
+ * object to it.  To avoid data missing or corruption, it is important to close every database
+ * by the CaskDB::close method when the database is no longer in use.  It is forbidden for
+ * multible database objects in a process to open the same database at the same time.  It is
+ * forbidden to share a database object with child processes.
+ */
+class CaskDB : public BasicDB {
+ public:
+  class Cursor;
+ private:
+  struct Segment;
+  struct Entry;
+  struct Location;
+  struct Move;
+  class ScopedVisitor;
+  class Merger;
+  /** An alias of vector of segments. */
+  typedef std::vector<Segment*> SegmentVector;
+  /** An alias of the table of locations before transaction. */
+  typedef std::map<std::string, Location> UndoMap;
+  /** An alias of vector of moved records. */
+  typedef std::vector<Move> MoveVector;
+  /** The default bucket number of the table in memory. */
+  static const int64_t DEFBNUM = 1048583LL;
+  /** The default capacity of each segment. */
+  static const int64_t DEFSEGCAP = 64LL << 20;
+  /** The default percentage of garbage to trigger merging. */
+  static const int32_t DEFMGPERC = 50;
+  /** The threshold of the bucket number to use memory mapping. */
+  static const int64_t MAPZMAPBNUM = 32768;
+  /** The size of the header of the meta data file. */
+  static const int32_t METAHEADSIZ = 32;
+  /** The size of the header of a segment file. */
+  static const int32_t SEGHEADSIZ = 16;
+  /** The size of the header of a hint file. */
+  static const int32_t HINTHEADSIZ = 16;
+  /** The size of the checksum of a record. */
+  static const int32_t RECCHKSIZ = 4;
+  /** The size of the stack buffer of a record. */
+  static const size_t RECBUFSIZ = 1024;
+  /** The operation code to set a record. */
+  static const uint8_t OPSET = 0xc1;
+  /** The operation code to remove a record. */
+  static const uint8_t OPREMOVE = 0xc2;
+  /** The operation code to begin transaction. */
+  static const uint8_t OPBEGIN = 0xd1;
+  /** The operation code to commit transaction. */
+  static const uint8_t OPCOMMIT = 0xd2;
+  /** The frequency of checking cancellation of merging. */
+  static const int64_t MGCHECKFREQ = 1024;
+  /** The threshold of busy loop and sleep for locking. */
+  static const uint32_t LOCKBUSYLOOP = 8192;
+ public:
+  /**
+   * Cursor to indicate a record.
+   * @note The cursor holds the bucket index and the key of the current record and resolves the
+   * neighboring record in the table in memory at each operation.
+   */
+  class Cursor : public BasicDB::Cursor {
+    friend class CaskDB;
+   public:
+    /**
+     * Constructor.
+     * @param db the container database object.
+     */
+    explicit Cursor(CaskDB* db) : db_(db), bidx_(0), key_(""), alive_(false) {
+      _assert_(db);
+    }
+    /**
+     * Destructor.
+     */
+    virtual ~Cursor() {
+      _assert_(true);
+    }
+    /**
+     * Accept a visitor to the current record.
+     * @param visitor a visitor object.
+     * @param writable true for writable operation, or false for read-only operation.
+     * @param step true to move the cursor to the next record, or false for no move.
+     * @return true on success, or false on failure.
+     * @note The operation for each record is performed atomically and other threads accessing
+     * the same record are blocked.  To avoid deadlock, any explicit database operation must not
+     * be performed in this function.
+     */
+    bool accept(Visitor* visitor, bool writable = true, bool step = false) {
+      _assert_(visitor);
+      ScopedRWLock lock(&db_->mlock_, writable);
+      if (db_->omode_ == 0) {
+        db_->set_error(_KCCODELINE_, Error::INVALID, "not opened");
+        return false;
+      }
+      if (writable && !db_->writer_) {
+        db_->set_error(_KCCODELINE_, Error::NOPERM, "permission denied");
+        return false;
+      }
+      if (!alive_) {
+        db_->set_error(_KCCODELINE_, Error::NOREC, "no record");
+        return false;
+      }
+      Entry* ent = db_->find_entry(key_.data(), key_.size());
+      if (!ent) {
+        alive_ = false;
+        db_->set_error(_KCCODELINE_, Error::NOREC, "no record");
+        return false;
+      }
+      std::string value;
+      if (!db_->read_value(ent, &value)) return false;
+      size_t nbidx = 0;
+      std::string nkey;
+      bool nhit = db_->seek_entry(bidx_, &key_, &nbidx, &nkey);
+      bool err = false;
+      if (!db_->visit_record(key_.data(), key_.size(), &value, visitor, writable)) err = true;
+      if (!err && (step || (writable && !db_->find_entry(key_.data(), key_.size())))) {
+        if (nhit) {
+          bidx_ = nbidx;
+          key_ = nkey;
+        } else {
+          alive_ = false;
+        }
+      }
+      if (writable && !db_->flush_auto()) err = true;
+      return !err;
+    }
+    /**
+     * Jump the cursor to the first record for forward scan.
+     * @return true on success, or false on failure.
+     */
+    bool jump() {
+      _assert_(true);
+      ScopedRWLock lock(&db_->mlock_, false);
+      if (db_->omode_ == 0) {
+        db_->set_error(_KCCODELINE_, Error::INVALID, "not opened");
+        return false;
+      }
+      alive_ = false;
+      if (!db_->seek_entry(0, NULL, &bidx_, &key_)) {
+        db_->set_error(_KCCODELINE_, Error::NOREC, "no record");
+        return false;
+      }
+      alive_ = true;
+      return true;
+    }
+    /**
+     * Jump the cursor to a record for forward scan.
+     * @param kbuf the pointer to the key region.
+     * @param ksiz the size of the key region.
+     * @return true on success, or false on failure.
+     */
+    bool jump(const char* kbuf, size_t ksiz) {
+      _assert_(kbuf && ksiz <= MEMMAXSIZ);
+      ScopedRWLock lock(&db_->mlock_, false);
+      if (db_->omode_ == 0) {
+        db_->set_error(_KCCODELINE_, Error::INVALID, "not opened");
+        return false;
+      }
+      alive_ = false;
+      if (!db_->find_entry(kbuf, ksiz)) {
+        db_->set_error(_KCCODELINE_, Error::NOREC, "no record");
+        return false;
+      }
+      bidx_ = db_->bucket_index(kbuf, ksiz);
+      key_.assign(kbuf, ksiz);
+      alive_ = true;
+      return true;
+    }
+    /**
+     * Jump the cursor to a record for forward scan.
+     * @note Equal to the original Cursor::jump method except that the parameter is std::string.
+     */
+    bool jump(const std::string& key) {
+      _assert_(true);
+      return jump(key.c_str(), key.size());
+    }
+    /**
+     * Jump the cursor to the last record for backward scan.
+     * @note This is a dummy implementation for compatibility.
+     */
+    bool jump_back() {
+      _assert_(true);
+      ScopedRWLock lock(&db_->mlock_, false);
+      if (db_->omode_ == 0) {
+        db_->set_error(_KCCODELINE_, Error::INVALID, "not opened");
+        return false;
+      }
+      db_->set_error(_KCCODELINE_, Error::NOIMPL, "not implemented");
+      return false;
+    }
+    /**
+     * Jump the cursor to a record for backward scan.
+     * @note This is a dummy implementation for compatibility.
+     */
+    bool jump_back(const char* kbuf, size_t ksiz) {
+      _assert_(kbuf && ksiz <= MEMMAXSIZ);
+      ScopedRWLock lock(&db_->mlock_, false);
+      if (db_->omode_ == 0) {
+        db_->set_error(_KCCODELINE_, Error::INVALID, "not opened");
+        return false;
+      }
+      db_->set_error(_KCCODELINE_, Error::NOIMPL, "not implemented");
+      return false;
+    }
+    /**
+     * Jump the cursor to a record for backward scan.
+     * @note This is a dummy implementation for compatibility.
+     */
+    bool jump_back(const std::string& key) {
+      _assert_(true);
+      return jump_back(key.c_str(), key.size());
+    }
+    /**
+     * Step the cursor to the next record.
+     * @return true on success, or false on failure.
+     */
+    bool step() {
+      _assert_(true);
+      ScopedRWLock lock(&db_->mlock_, false);
+      if (db_->omode_ == 0) {
+        db_->set_error(_KCCODELINE_, Error::INVALID, "not opened");
+        return false;
+      }
+      if (!alive_) {
+        db_->set_error(_KCCODELINE_, Error::NOREC, "no record");
+        return false;
+      }
+      std::string key = key_;
+      alive_ = false;
+      if (!db_->seek_entry(bidx_, &key, &bidx_, &key_)) {
+        db_->set_error(_KCCODELINE_, Error::NOREC, "no record");
+        return false;
+      }
+      alive_ = true;
+      return true;
+    }
+    /**
+     * Step the cursor to the previous record.
+     * @note This is a dummy implementation for compatibility.
+     */
+    bool step_back() {
+      _assert_(true);
+      ScopedRWLock lock(&db_->mlock_, false);
+      if (db_->omode_ == 0) {
+        db_->set_error(_KCCODELINE_, Error::INVALID, "not opened");
+        return false;
+      }
+      db_->set_error(_KCCODELINE_, Error::NOIMPL, "not implemented");
+      return false;
+    }
+    /**
+     * Get the database object.
+     * @return the database object.
+     */
+    CaskDB* db() {
+      _assert_(true);
+      return db_;
+    }
+   private:
+    /** Dummy constructor to forbid the use. */
+    Cursor(const Cursor&);
+    /** Dummy Operator to forbid the use. */
+    Cursor& operator =(const Cursor&);
+    /** The inner database. */
+    CaskDB* db_;
+    /** The index of the bucket of the current record. */
+    size_t bidx_;
+    /** The key of the current record. */
+    std::string key_;
+    /** The flag of availability. */
+    bool alive_;
+  };
+  /**
+   * Default constructor.
+   */
+  explicit CaskDB() :
+      mlock_(), mglock_(), mgmutex_(), mgcond_(), error_(),
+      logger_(NULL), logkinds_(0), mtrigger_(NULL),
+      omode_(0), writer_(false), autosync_(false), recov_(false),
+      lock_(), path_(""), bnum_(DEFBNUM), segcap_(DEFSEGCAP), mgratio_(DEFMGPERC / 100.0),
+      buckets_(NULL), segs_(), hint_(), count_(0), nextid_(0),
+      tran_(false), trhard_(false), trundo_(), trsegsiz_(0), trhintsiz_(0),
+      merger_(NULL), mgreq_(false), mgstop_(false), rotcnt_(0), mgcnt_(0) {
+    _assert_(true);
+  }
+  /**
+   * Destructor.
+   * @note If the database is not closed, it is closed implicitly.
+   */
+  virtual ~CaskDB() {
+    _assert_(true);
+    if (omode_ != 0) close();
+  }
+  /**
+   * Accept a visitor to a record.
+   * @param kbuf the pointer to the key region.
+   * @param ksiz the size of the key region.
+   * @param visitor a visitor object.
+   * @param writable true for writable operation, or false for read-only operation.
+   * @return true on success, or false on failure.
+   * @note The operation for each record is performed atomically and other threads accessing the
+   * same record are blocked.  To avoid deadlock, any explicit database operation must not be
+   * performed in this function.
+   */
+  bool accept(const char* kbuf, size_t ksiz, Visitor* visitor, bool writable = true) {
+    _assert_(kbuf && ksiz <= MEMMAXSIZ && visitor);
+    ScopedRWLock lock(&mlock_, writable);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
+    }
+    if (writable && !writer_) {
+      set_error(_KCCODELINE_, Error::NOPERM, "permission denied");
+      return false;
+    }
+    bool err = false;
+    if (!accept_impl(kbuf, ksiz, visitor, writable)) err = true;
+    if (writable && !flush_auto()) err = true;
+    return !err;
+  }
+  /**
+   * Accept a visitor to multiple records at once.
+   * @param keys specifies a string vector of the keys.
+   * @param visitor a visitor object.
+   * @param writable true for writable operation, or false for read-only operation.
+   * @return true on success, or false on failure.
+   * @note The operations for specified records are performed atomically and other threads
+   * accessing the same records are blocked.  To avoid deadlock, any explicit database operation
+   * must not be performed in this function.
+   */
+  bool accept_bulk(const std::vector<std::string>& keys, Visitor* visitor,
+                   bool writable = true) {
+    _assert_(visitor);
+    ScopedRWLock lock(&mlock_, writable);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
+    }
+    if (writable && !writer_) {
+      set_error(_KCCODELINE_, Error::NOPERM, "permission denied");
+      return false;
+    }
+    ScopedVisitor svis(visitor);
+    bool err = false;
+    std::vector<std::string>::const_iterator kit = keys.begin();
+    std::vector<std::string>::const_iterator kitend = keys.end();
+    while (kit != kitend) {
+      if (!accept_impl(kit->data(), kit->size(), visitor, writable)) {
+        err = true;
+        break;
+      }
+      ++kit;
+    }
+    if (writable && !flush_auto()) err = true;
+    return !err;
+  }
+  /**
+   * Iterate to accept a visitor for each record.
+   * @param visitor a visitor object.
+   * @param writable true for writable operation, or false for read-only operation.
+   * @param checker a progress checker object.  If it is NULL, no checking is performed.
+   * @return true on success, or false on failure.
+   * @note The whole iteration is performed atomically and other threads are blocked.  To avoid
+   * deadlock, any explicit database operation must not be performed in this function.
+   */
+  bool iterate(Visitor *visitor, bool writable = true, ProgressChecker* checker = NULL) {
+    _assert_(visitor);
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
+    }
+    if (writable && !writer_) {
+      set_error(_KCCODELINE_, Error::NOPERM, "permission denied");
+      return false;
+    }
+    ScopedVisitor svis(visitor);
+    bool err = false;
+    if (!iterate_impl(visitor, writable, checker)) err = true;
+    if (writable && !flush_auto()) err = true;
+    trigger_meta(MetaTrigger::ITERATE, "iterate");
+    return !err;
+  }
+  /**
+   * Get the last happened error.
+   * @return the last happened error.
+   */
+  Error error() const {
+    _assert_(true);
+    return error_;
+  }
+  /**
+   * Set the error information.
+   * @param file the file name of the program source code.
+   * @param line the line number of the program source code.
+   * @param func the function name of the program source code.
+   * @param code an error code.
+   * @param message a supplement message.
+   */
+  void set_error(const char* file, int32_t line, const char* func,
+                 Error::Code code, const char* message) {
+    _assert_(file && line > 0 && func && message);
+    error_->set(code, message);
+    if (logger_) {
+      Logger::Kind kind = code == Error::BROKEN || code == Error::SYSTEM ?
+          Logger::ERROR : Logger::INFO;
+      if (kind & logkinds_)
+        report(file, line, func, kind, "%d: %s: %s", code, Error::codename(code), message);
+    }
+  }
+  /**
+   * Open a database directory.
+   * @param path the path of a database directory.
+   * @param mode the connection mode.  CaskDB::OWRITER as a writer, CaskDB::OREADER as a
+   * reader.  The following may be added to the writer mode by bitwise-or: CaskDB::OCREATE,
+   * which means it creates a new database if the directory does not exist, CaskDB::OTRUNCATE,
+   * which means it creates a new database regardless if the directory exists,
+   * CaskDB::OAUTOTRAN, which means each updating operation is performed in implicit
+   * transaction, CaskDB::OAUTOSYNC, which means each updating operation is followed by
+   * implicit synchronization with the file system.  The following may be added to both of the
+   * reader mode and the writer mode by bitwise-or: CaskDB::ONOLOCK, which means it opens the
+   * database directory without file locking, CaskDB::OTRYLOCK, which means locking is
+   * performed without blocking, CaskDB::ONOREPAIR, which means the database directory is not
+   * repaired implicitly even if file destruction is detected.
+   * @return true on success, or false on failure.
+   * @note Every opened database must be closed by the CaskDB::close method when it is no
+   * longer in use.  It is not allowed for two or more database objects in the same process to
+   * keep their connections to the same database directory at the same time.  Because every
+   * record in the segment files has a checksum, the auto transaction mode is always achieved
+   * implicitly.
+   */
+  bool open(const std::string& path, uint32_t mode = OWRITER | OCREATE) {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ != 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "already opened");
+      return false;
+    }
+    report(_KCCODELINE_, Logger::DEBUG, "opening the database (path=%s)", path.c_str());
+    writer_ = false;
+    autosync_ = false;
+    recov_ = false;
+    uint32_t fmode = File::OREADER;
+    if (mode & OWRITER) {
+      writer_ = true;
+      fmode = File::OWRITER | File::OCREATE;
+      if (mode & OAUTOSYNC) autosync_ = true;
+    }
+    if (mode & ONOLOCK) fmode |= File::ONOLOCK;
+    if (mode & OTRYLOCK) fmode |= File::OTRYLOCK;
+    size_t psiz = path.size();
+    while (psiz > 0 && path[psiz-1] == File::PATHCHR) {
+      psiz--;
+    }
+    const std::string& cpath = path.substr(0, psiz);
+    const std::string& metapath = cpath + File::PATHCHR + KCCDBMETAFILE;
+    const std::string& lockpath = cpath + File::PATHCHR + KCCDBLOCKFILE;
+    bool hot = false;
+    File::Status sbuf;
+    if (File::status(cpath, &sbuf)) {
+      if (!sbuf.isdir) {
+        set_error(_KCCODELINE_, Error::NOPERM, "invalid path (not directory)");
+        return false;
+      }
+      if (!File::status(metapath)) {
+        if (!writer_ || !(mode & OCREATE)) {
+          set_error(_KCCODELINE_, Error::BROKEN, "missing meta data");
+          return false;
+        }
+        hot = true;
+      }
+    } else if (writer_ && (mode & OCREATE)) {
+      if (!File::make_directory(cpath)) {
+        set_error(_KCCODELINE_, Error::SYSTEM, "making a directory failed");
+        return false;
+      }
+      hot = true;
+    } else {
+      set_error(_KCCODELINE_, Error::NOREPOS, "open failed (file not found)");
+      return false;
+    }
+    if (writer_ && (mode & OTRUNCATE)) hot = true;
+    if (!lock_.open(lockpath, fmode)) {
+      set_error(_KCCODELINE_, Error::SYSTEM, lock_.error());
+      return false;
+    }
+    path_ = cpath;
+    tran_ = false;
+    hint_.clear();
+    count_ = 0;
+    rotcnt_ = 0;
+    mgcnt_ = 0;
+    create_keydir();
+    bool err = false;
+    if (hot) {
+      nextid_ = 1;
+      Segment* seg = NULL;
+      if (!remove_files(NULL) || !(seg = create_segment(nextid_++))) {
+        err = true;
+      } else {
+        segs_.push_back(seg);
+        if (!dump_meta()) err = true;
+      }
+    } else {
+      if (!load_meta() || !open_segments() || (writer_ && !remove_files(&segs_)) ||
+          !load_segments()) err = true;
+    }
+    if (err) {
+      close_segments(false);
+      destroy_keydir();
+      lock_.close();
+      return false;
+    }
+    omode_ = mode;
+    if (writer_) {
+      mgreq_ = true;
+      mgstop_ = false;
+      merger_ = new Merger(this);
+      merger_->start();
+    }
+    trigger_meta(MetaTrigger::OPEN, "open");
+    return true;
+  }
+  /**
+   * Close the database directory.
+   * @return true on success, or false on failure.
+   */
+  bool close() {
+    _assert_(true);
+    stop_merger();
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
+    }
+    report(_KCCODELINE_, Logger::DEBUG, "closing the database (path=%s)", path_.c_str());
+    bool err = false;
+    if (tran_ && !abort_transaction()) err = true;
+    tran_ = false;
+    if (!close_segments(false)) err = true;
+    destroy_keydir();
+    if (!lock_.close()) {
+      set_error(_KCCODELINE_, Error::SYSTEM, lock_.error());
+      err = true;
+    }
+    hint_.clear();
+    omode_ = 0;
+    trigger_meta(MetaTrigger::CLOSE, "close");
+    return !err;
+  }
+  /**
+   * Synchronize updated contents with the file and the device.
+   * @param hard true for physical synchronization with the device, or false for logical
+   * synchronization with the file system.
+   * @param proc a postprocessor object.  If it is NULL, no postprocessing is performed.
+   * @param checker a progress checker object.  If it is NULL, no checking is performed.
+   * @return true on success, or false on failure.
+   * @note The operation of the postprocessor is performed atomically and other threads accessing
+   * the same record are blocked.  To avoid deadlock, any explicit database operation must not
+   * be performed in this function.
+   */
+  bool synchronize(bool hard = false, FileProcessor* proc = NULL,
+                   ProgressChecker* checker = NULL) {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
+    }
+    bool err = false;
+    if (checker && !checker->check("synchronize", "synchronizing the active segment", -1, -1)) {
+      set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
+      return false;
+    }
+    File* file = segs_.back()->file;
+    if (writer_ && !file->synchronize(hard)) {
+      set_error(_KCCODELINE_, Error::SYSTEM, file->error());
+      err = true;
+    }
+    if (proc) {
+      if (checker && !checker->check("synchronize", "running the post processor", -1, -1)) {
+        set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
+        return false;
+      }
+      if (!proc->process(path_, count_, size_impl())) {
+        set_error(_KCCODELINE_, Error::LOGIC, "postprocessing failed");
+        err = true;
+      }
+    }
+    trigger_meta(MetaTrigger::SYNCHRONIZE, "synchronize");
+    return !err;
+  }
+  /**
+   * Occupy database by locking and do something meanwhile.
+   * @param writable true to use writer lock, or false to use reader lock.
+   * @param proc a processor object.  If it is NULL, no processing is performed.
+   * @return true on success, or false on failure.
+   * @note The operation of the processor is performed atomically and other threads accessing
+   * the same record are blocked.  To avoid deadlock, any explicit database operation must not
+   * be performed in this function.
+   */
+  bool occupy(bool writable = true, FileProcessor* proc = NULL) {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, writable);
+    bool err = false;
+    if (proc && !proc->process(path_, count_, size_impl())) {
+      set_error(_KCCODELINE_, Error::LOGIC, "processing failed");
+      err = true;
+    }
+    trigger_meta(MetaTrigger::OCCUPY, "occupy");
+    return !err;
+  }
+  /**
+   * Begin transaction.
+   * @param hard true for physical synchronization with the device, or false for logical
+   * synchronization with the file system.
+   * @return true on success, or false on failure.
+   */
+  bool begin_transaction(bool hard = false) {
+    _assert_(true);
+    uint32_t wcnt = 0;
+    while (true) {
+      mlock_.lock_writer();
+      if (omode_ == 0) {
+        set_error(_KCCODELINE_, Error::INVALID, "not opened");
+        mlock_.unlock();
+        return false;
+      }
+      if (!writer_) {
+        set_error(_KCCODELINE_, Error::NOPERM, "permission denied");
+        mlock_.unlock();
+        return false;
+      }
+      if (!tran_) break;
+      mlock_.unlock();
+      if (wcnt >= LOCKBUSYLOOP) {
+        Thread::chill();
+      } else {
+        Thread::yield();
+        wcnt++;
+      }
+    }
+    trhard_ = hard;
+    if (!begin_transaction_impl()) {
+      mlock_.unlock();
+      return false;
+    }
+    tran_ = true;
+    trigger_meta(MetaTrigger::BEGINTRAN, "begin_transaction");
+    mlock_.unlock();
+    return true;
+  }
+  /**
+   * Try to begin transaction.
+   * @param hard true for physical synchronization with the device, or false for logical
+   * synchronization with the file system.
+   * @return true on success, or false on failure.
+   */
+  bool begin_transaction_try(bool hard = false) {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
+    }
+    if (!writer_) {
+      set_error(_KCCODELINE_, Error::NOPERM, "permission denied");
+      return false;
+    }
+    if (tran_) {
+      set_error(_KCCODELINE_, Error::LOGIC, "competition avoided");
+      return false;
+    }
+    trhard_ = hard;
+    if (!begin_transaction_impl()) return false;
+    tran_ = true;
+    trigger_meta(MetaTrigger::BEGINTRAN, "begin_transaction_try");
+    return true;
+  }
+  /**
+   * End transaction.
+   * @param commit true to commit the transaction, or false to abort the transaction.
+   * @return true on success, or false on failure.
+   */
+  bool end_transaction(bool commit = true) {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
+    }
+    if (!tran_) {
+      set_error(_KCCODELINE_, Error::INVALID, "not in transaction");
+      return false;
+    }
+    bool err = false;
+    if (commit) {
+      if (!commit_transaction()) err = true;
+    } else {
+      if (!abort_transaction()) err = true;
+    }
+    tran_ = false;
+    if (!err && !flush_auto()) err = true;
+    trigger_meta(commit ? MetaTrigger::COMMITTRAN : MetaTrigger::ABORTTRAN, "end_transaction");
+    return !err;
+  }
+  /**
+   * Remove all records.
+   * @return true on success, or false on failure.
+   * @note In a transaction, every record is overwritten by a removal mark so that it can be
+   * restored by aborting the transaction.
+   */
+  bool clear() {
+    _assert_(true);
+    ScopedMutex glock(&mglock_);
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
+    }
+    if (!writer_) {
+      set_error(_KCCODELINE_, Error::NOPERM, "permission denied");
+      return false;
+    }
+    bool err = false;
+    if (tran_) {
+      for (int64_t i = 0; !err && i < bnum_; i++) {
+        Entry* ent = buckets_[i];
+        while (ent) {
+          Entry* next = ent->next;
+          if (!write_record(entry_key(ent), ent->ksiz, NULL, 0, OPREMOVE)) {
+            err = true;
+            break;
+          }
+          ent = next;
+        }
+      }
+    } else {
+      if (!close_segments(true)) err = true;
+      destroy_keydir();
+      create_keydir();
+      hint_.clear();
+      Segment* seg = create_segment(nextid_++);
+      if (seg) {
+        segs_.push_back(seg);
+      } else {
+        err = true;
+      }
+      if (!dump_meta()) err = true;
+    }
+    trigger_meta(MetaTrigger::CLEAR, "clear");
+    return !err;
+  }
+  /**
+   * Get the number of records.
+   * @return the number of records, or -1 on failure.
+   */
+  int64_t count() {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, false);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return -1;
+    }
+    return count_;
+  }
+  /**
+   * Get the size of the database directory.
+   * @return the total size of the segment files in bytes, or -1 on failure.
+   */
+  int64_t size() {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, false);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return -1;
+    }
+    return size_impl();
+  }
+  /**
+   * Get the path of the database directory.
+   * @return the path of the database directory, or an empty string on failure.
+   */
+  std::string path() {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, false);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return "";
+    }
+    return path_;
+  }
+  /**
+   * Get the miscellaneous status information.
+   * @param strmap a string map to contain the result.
+   * @return true on success, or false on failure.
+   */
+  bool status(std::map<std::string, std::string>* strmap) {
+    _assert_(strmap);
+    ScopedRWLock lock(&mlock_, false);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
+    }
+    (*strmap)["type"] = strprintf("%u", (unsigned)TYPECASK);
+    (*strmap)["path"] = path_;
+    (*strmap)["recovered"] = strprintf("%d", recov_);
+    (*strmap)["bnum"] = strprintf("%lld", (long long)bnum_);
+    (*strmap)["segcap"] = strprintf("%lld", (long long)segcap_);
+    (*strmap)["mgratio"] = strprintf("%.3f", mgratio_);
+    (*strmap)["segnum"] = strprintf("%lld", (long long)segs_.size());
+    int64_t live = 0;
+    SegmentVector::const_iterator it = segs_.begin();
+    SegmentVector::const_iterator itend = segs_.end();
+    while (it != itend) {
+      live += (*it)->live;
+      ++it;
+    }
+    (*strmap)["live"] = strprintf("%lld", (long long)live);
+    (*strmap)["rotcnt"] = strprintf("%lld", (long long)rotcnt_.get());
+    (*strmap)["mgcnt"] = strprintf("%lld", (long long)mgcnt_.get());
+    (*strmap)["count"] = strprintf("%lld", (long long)count_);
+    (*strmap)["size"] = strprintf("%lld", (long long)size_impl());
+    return true;
+  }
+  /**
+   * Create a cursor object.
+   * @return the return value is the created cursor object.
+   * @note Because the object of the return value is allocated by the constructor, it should be
+   * released with the delete operator when it is no longer in use.
+   */
+  Cursor* cursor() {
+    _assert_(true);
+    return new Cursor(this);
+  }
+  /**
+   * Set the internal logger.
+   * @param logger the logger object.
+   * @param kinds kinds of logged messages by bitwise-or: Logger::DEBUG for debugging,
+   * Logger::INFO for normal information, Logger::WARN for warning, and Logger::ERROR for fatal
+   * error.
+   * @return true on success, or false on failure.
+   */
+  bool tune_logger(Logger* logger, uint32_t kinds = Logger::WARN | Logger::ERROR) {
+    _assert_(logger);
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ != 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "already opened");
+      return false;
+    }
+    logger_ = logger;
+    logkinds_ = kinds;
+    return true;
+  }
+  /**
+   * Set the internal meta operation trigger.
+   * @param trigger the trigger object.
+   * @return true on success, or false on failure.
+   */
+  bool tune_meta_trigger(MetaTrigger* trigger) {
+    _assert_(trigger);
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ != 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "already opened");
+      return false;
+    }
+    mtrigger_ = trigger;
+    return true;
+  }
+  /**
+   * Set the number of buckets of the table in memory.
+   * @param bnum the number of buckets of the table in memory.
+   * @return true on success, or false on failure.
+   * @note The table is rebuilt whenever the database is opened, so the number can be changed
+   * at every opening.
+   */
+  bool tune_buckets(int64_t bnum) {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ != 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "already opened");
+      return false;
+    }
+    bnum_ = bnum > 0 ? nearbyprime(bnum) : DEFBNUM;
+    return true;
+  }
+  /**
+   * Set the capacity of each segment.
+   * @param segcap the capacity in bytes of each segment.  When the active segment exceeds it,
+   * the segment becomes immutable and a new one is created.
+   * @return true on success, or false on failure.
+   */
+  bool tune_segment(int64_t segcap) {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ != 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "already opened");
+      return false;
+    }
+    segcap_ = segcap > 0 ? segcap : DEFSEGCAP;
+    return true;
+  }
+  /**
+   * Set the ratio of garbage to trigger merging.
+   * @param mgratio the ratio of the size of dead records to the total size of the immutable
+   * segments.  When the ratio reaches it, the immutable segments are merged in the background.
+   * @return true on success, or false on failure.
+   */
+  bool tune_merge(double mgratio) {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ != 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "already opened");
+      return false;
+    }
+    mgratio_ = mgratio > 0 ? mgratio : DEFMGPERC / 100.0;
+    return true;
+  }
+  /**
+   * Merge the immutable segments into new ones holding only live records.
+   * @return true on success, or false on failure.
+   * @note The merging is performed regardless of the ratio of garbage.  Other threads are not
+   * blocked while the records are copied.
+   */
+  bool merge() {
+    _assert_(true);
+    mlock_.lock_reader();
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      mlock_.unlock();
+      return false;
+    }
+    if (!writer_) {
+      set_error(_KCCODELINE_, Error::NOPERM, "permission denied");
+      mlock_.unlock();
+      return false;
+    }
+    mlock_.unlock();
+    bool done;
+    return merge_segments(true, &done);
+  }
+ protected:
+  /**
+   * Report a message for debugging.
+   * @param file the file name of the program source code.
+   * @param line the line number of the program source code.
+   * @param func the function name of the program source code.
+   * @param kind the kind of the event.  Logger::DEBUG for debugging, Logger::INFO for normal
+   * information, Logger::WARN for warning, and Logger::ERROR for fatal error.
+   * @param format the printf-like format string.
+   * @param ... used according to the format string.
+   */
+  void report(const char* file, int32_t line, const char* func, Logger::Kind kind,
+              const char* format, ...) {
+    _assert_(file && line > 0 && func && format);
+    if (!logger_ || !(kind & logkinds_)) return;
+    std::string message;
+    strprintf(&message, "%s: ", path_.empty() ? "-" : path_.c_str());
+    va_list ap;
+    va_start(ap, format);
+    vstrprintf(&message, format, ap);
+    va_end(ap);
+    logger_->log(file, line, func, kind, message.c_str());
+  }
+  /**
+   * Trigger a meta database operation.
+   * @param kind the kind of the event.  MetaTrigger::OPEN for opening, MetaTrigger::CLOSE for
+   * closing, MetaTrigger::CLEAR for clearing, MetaTrigger::ITERATE for iteration,
+   * MetaTrigger::SYNCHRONIZE for synchronization, MetaTrigger::BEGINTRAN for beginning
+   * transaction, MetaTrigger::COMMITTRAN for committing transaction, MetaTrigger::ABORTTRAN
+   * for aborting transaction, and MetaTrigger::MISC for miscellaneous operations.
+   * @param message the supplement message.
+   */
+  void trigger_meta(MetaTrigger::Kind kind, const char* message) {
+    _assert_(message);
+    if (mtrigger_) mtrigger_->trigger(kind, message);
+  }
+ private:
+  /**
+   * Segment file.
+   */
+  struct Segment {
+    int64_t id;                          ///< identifier
+    File* file;                          ///< data file
+    int64_t live;                        ///< total size of live records
+  };
+  /**
+   * Entry of the table in memory.
+   * @note The key region follows the structure in the same allocation.
+   */
+  struct Entry {
+    Entry* next;                         ///< next entry in the same bucket
+    Segment* seg;                        ///< segment of the record
+    int64_t off;                         ///< offset of the value
+    uint32_t vsiz;                       ///< size of the value
+    uint32_t ksiz;                       ///< size of the key
+  };
+  /**
+   * Location of a record before transaction.
+   */
+  struct Location {
+    Segment* seg;                        ///< segment, or NULL for no record
+    int64_t off;                         ///< offset of the value
+    uint32_t vsiz;                       ///< size of the value
+  };
+  /**
+   * Record copied by merging.
+   */
+  struct Move {
+    std::string key;                     ///< key
+    Segment* src;                        ///< source segment
+    int64_t off;                         ///< offset of the value in the source
+    Segment* dest;                       ///< destination segment
+    int64_t noff;                        ///< offset of the value in the destination
+  };
+  /**
+   * Scoped visitor.
+   */
+  class ScopedVisitor {
+   public:
+    /** constructor */
+    explicit ScopedVisitor(Visitor* visitor) : visitor_(visitor) {
+      _assert_(visitor);
+      visitor_->visit_before();
+    }
+    /** destructor */
+    ~ScopedVisitor() {
+      _assert_(true);
+      visitor_->visit_after();
+    }
+   private:
+    Visitor* visitor_;                   ///< visitor
+  };
+  /**
+   * Background thread to merge segments.
+   */
+  class Merger : public Thread {
+   public:
+    /** constructor */
+    explicit Merger(CaskDB* db) : db_(db) {}
+    /** perform the concrete process */
+    void run() {
+      _assert_(true);
+      db_->merge_loop();
+    }
+   private:
+    CaskDB* db_;                         ///< database
+  };
+  /**
+   * Accept a visitor to a record.
+   * @param kbuf the pointer to the key region.
+   * @param ksiz the size of the key region.
+   * @param visitor a visitor object.
+   * @param writable true for writable operation, or false for read-only operation.
+   * @return true on success, or false on failure.
+   */
+  bool accept_impl(const char* kbuf, size_t ksiz, Visitor* visitor, bool writable) {
+    _assert_(kbuf && ksiz <= MEMMAXSIZ && visitor);
+    Entry* ent = find_entry(kbuf, ksiz);
+    if (!ent) return visit_record(kbuf, ksiz, NULL, visitor, writable);
+    std::string value;
+    if (!read_value(ent, &value)) return false;
+    return visit_record(kbuf, ksiz, &value, visitor, writable);
+  }
+  /**
+   * Call a visitor for a record and apply the result.
+   * @param kbuf the pointer to the key region.
+   * @param ksiz the size of the key region.
+   * @param value the current value, or NULL if the record does not exist.
+   * @param visitor a visitor object.
+   * @param writable true for writable operation, or false for read-only operation.
+   * @return true on success, or false on failure.
+   */
+  bool visit_record(const char* kbuf, size_t ksiz, const std::string* value,
+                    Visitor* visitor, bool writable) {
+    _assert_(kbuf && ksiz <= MEMMAXSIZ && visitor);
+    size_t rsiz;
+    const char* rbuf = value ?
+        visitor->visit_full(kbuf, ksiz, value->data(), value->size(), &rsiz) :
+        visitor->visit_empty(kbuf, ksiz, &rsiz);
+    if (!writable) return true;
+    if (rbuf == Visitor::REMOVE) {
+      if (value && !write_record(kbuf, ksiz, NULL, 0, OPREMOVE)) return false;
+    } else if (rbuf != Visitor::NOP) {
+      if (!write_record(kbuf, ksiz, rbuf, rsiz, OPSET)) return false;
+    }
+    return true;
+  }
+  /**
+   * Read the value of a record from its segment.
+   * @param ent the entry of the record.
+   * @param value the string to contain the value.
+   * @return true on success, or false on failure.
+   */
+  bool read_value(Entry* ent, std::string* value) {
+    _assert_(ent && value);
+    value->resize(ent->vsiz);
+    if (ent->vsiz < 1) return true;
+    File* file = ent->seg->file;
+    if (!file->read(ent->off, (char*)value->data(), ent->vsiz)) {
+      set_error(_KCCODELINE_, Error::SYSTEM, file->error());
+      return false;
+    }
+    return true;
+  }
+  /**
+   * Iterate to accept a visitor for each record.
+   * @param visitor a visitor object.
+   * @param writable true for writable operation, or false for read-only operation.
+   * @param checker a progress checker object.
+   * @return true on success, or false on failure.
+   */
+  bool iterate_impl(Visitor* visitor, bool writable, ProgressChecker* checker) {
+    _assert_(visitor);
+    int64_t allcnt = count_;
+    if (checker && !checker->check("iterate", "beginning", 0, allcnt)) {
+      set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
+      return false;
+    }
+    std::string key, value;
+    int64_t curcnt = 0;
+    for (int64_t i = 0; i < bnum_; i++) {
+      Entry* ent = buckets_[i];
+      while (ent) {
+        Entry* next = ent->next;
+        key.assign(entry_key(ent), ent->ksiz);
+        if (!read_value(ent, &value)) return false;
+        if (!visit_record(key.data(), key.size(), &value, visitor, writable)) return false;
+        curcnt++;
+        if (checker && !checker->check("iterate", "processing", curcnt, allcnt)) {
+          set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
+          return false;
+        }
+        ent = next;
+      }
+    }
+    if (checker && !checker->check("iterate", "ending", -1, allcnt)) {
+      set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
+      return false;
+    }
+    return true;
+  }
+  /**
+   * Append a record to the active segment and apply it to the table in memory.
+   * @param kbuf the pointer to the key region.
+   * @param ksiz the size of the key region.
+   * @param vbuf the pointer to the value region.
+   * @param vsiz the size of the value region.
+   * @param op the operation code.
+   * @return true on success, or false on failure.
+   */
+  bool write_record(const char* kbuf, size_t ksiz, const char* vbuf, size_t vsiz, uint8_t op) {
+    _assert_(kbuf && ksiz <= MEMMAXSIZ && vsiz <= MEMMAXSIZ);
+    Segment* seg = segs_.back();
+    size_t hsiz = 1 + sizevarnum(ksiz) + sizevarnum(vsiz);
+    size_t rsiz = hsiz + ksiz + vsiz + RECCHKSIZ;
+    char stack[RECBUFSIZ];
+    char* rbuf = rsiz > sizeof(stack) ? new char[rsiz] : stack;
+    char* wp = rbuf;
+    *(wp++) = op;
+    wp += writevarnum(wp, ksiz);
+    wp += writevarnum(wp, vsiz);
+    std::memcpy(wp, kbuf, ksiz);
+    wp += ksiz;
+    if (vsiz > 0) std::memcpy(wp, vbuf, vsiz);
+    wp += vsiz;
+    writefixnum(wp, calc_checksum(rbuf, wp - rbuf), RECCHKSIZ);
+    int64_t off = seg->file->size();
+    bool err = false;
+    if (!seg->file->append(rbuf, rsiz)) {
+      set_error(_KCCODELINE_, Error::SYSTEM, seg->file->error());
+      err = true;
+    }
+    if (rbuf != stack) delete[] rbuf;
+    if (err) return false;
+    int64_t voff = off + hsiz + ksiz;
+    add_hint(&hint_, op, kbuf, ksiz, vsiz, voff);
+    if (op == OPREMOVE) {
+      remove_entry(kbuf, ksiz);
+    } else {
+      set_entry(kbuf, ksiz, seg, voff, vsiz);
+    }
+    if (autosync_ && !tran_ && !seg->file->synchronize(true)) {
+      set_error(_KCCODELINE_, Error::SYSTEM, seg->file->error());
+      return false;
+    }
+    return true;
+  }
+  /**
+   * Make the active segment immutable if the capacity is exceeded.
+   * @return true on success, or false on failure.
+   */
+  bool flush_auto() {
+    _assert_(true);
+    if (tran_ || segs_.back()->file->size() < segcap_) return true;
+    return rotate_segment();
+  }
+  /**
+   * Make the active segment immutable and create a new one.
+   * @return true on success, or false on failure.
+   */
+  bool rotate_segment() {
+    _assert_(true);
+    Segment* seg = segs_.back();
+    report(_KCCODELINE_, Logger::INFO, "rotating the active segment (id=%lld size=%lld)",
+           (long long)seg->id, (long long)seg->file->size());
+    if (!dump_hint(seg, hint_)) return false;
+    Segment* nseg = create_segment(nextid_++);
+    if (!nseg) return false;
+    segs_.push_back(nseg);
+    hint_.clear();
+    if (!dump_meta()) return false;
+    rotcnt_ += 1;
+    request_merge();
+    return true;
+  }
+  /**
+   * Begin transaction.
+   * @return true on success, or false on failure.
+   */
+  bool begin_transaction_impl() {
+    _assert_(true);
+    File* file = segs_.back()->file;
+    trsegsiz_ = file->size();
+    char op = OPBEGIN;
+    if (!file->append(&op, sizeof(op))) {
+      set_error(_KCCODELINE_, Error::SYSTEM, file->error());
+      return false;
+    }
+    trundo_.clear();
+    trhintsiz_ = hint_.size();
+    return true;
+  }
+  /**
+   * Commit transaction.
+   * @return true on success, or false on failure.
+   */
+  bool commit_transaction() {
+    _assert_(true);
+    File* file = segs_.back()->file;
+    bool err = false;
+    char op = OPCOMMIT;
+    if (!file->append(&op, sizeof(op))) {
+      set_error(_KCCODELINE_, Error::SYSTEM, file->error());
+      err = true;
+    }
+    if ((trhard_ || autosync_) && !file->synchronize(trhard_)) {
+      set_error(_KCCODELINE_, Error::SYSTEM, file->error());
+      err = true;
+    }
+    trundo_.clear();
+    return !err;
+  }
+  /**
+   * Abort transaction.
+   * @return true on success, or false on failure.
+   */
+  bool abort_transaction() {
+    _assert_(true);
+    bool err = false;
+    UndoMap undo;
+    undo.swap(trundo_);
+    UndoMap::const_iterator it = undo.begin();
+    UndoMap::const_iterator itend = undo.end();
+    while (it != itend) {
+      const std::string& key = it->first;
+      const Location& loc = it->second;
+      if (loc.seg) {
+        set_entry(key.data(), key.size(), loc.seg, loc.off, loc.vsiz);
+      } else {
+        remove_entry(key.data(), key.size());
+      }
+      ++it;
+    }
+    trundo_.clear();
+    hint_.resize(trhintsiz_);
+    File* file = segs_.back()->file;
+    if (!file->truncate(trsegsiz_)) {
+      set_error(_KCCODELINE_, Error::SYSTEM, file->error());
+      err = true;
+    }
+    return !err;
+  }
+  /**
+   * Get the size of the database directory.
+   * @return the size of the database directory in bytes.
+   */
+  int64_t size_impl() {
+    _assert_(true);
+    int64_t size = 0;
+    SegmentVector::const_iterator it = segs_.begin();
+    SegmentVector::const_iterator itend = segs_.end();
+    while (it != itend) {
+      size += (*it)->file->size();
+      ++it;
+    }
+    return size;
+  }
+  /**
+   * Allocate the buckets of the table in memory.
+   */
+  void create_keydir() {
+    _assert_(true);
+    if (bnum_ >= MAPZMAPBNUM) {
+      buckets_ = (Entry**)mapalloc(sizeof(*buckets_) * bnum_);
+    } else {
+      buckets_ = new Entry*[bnum_];
+      for (int64_t i = 0; i < bnum_; i++) {
+        buckets_[i] = NULL;
+      }
+    }
+    count_ = 0;
+  }
+  /**
+   * Release the table in memory.
+   */
+  void destroy_keydir() {
+    _assert_(true);
+    if (!buckets_) return;
+    for (int64_t i = 0; i < bnum_; i++) {
+      Entry* ent = buckets_[i];
+      while (ent) {
+        Entry* next = ent->next;
+        delete[] (char*)ent;
+        ent = next;
+      }
+    }
+    if (bnum_ >= MAPZMAPBNUM) {
+      mapfree(buckets_);
+    } else {
+      delete[] buckets_;
+    }
+    buckets_ = NULL;
+    count_ = 0;
+  }
+  /**
+   * Get the index of the bucket of a key.
+   * @param kbuf the pointer to the key region.
+   * @param ksiz the size of the key region.
+   * @return the index of the bucket.
+   */
+  size_t bucket_index(const char* kbuf, size_t ksiz) {
+    _assert_(kbuf && ksiz <= MEMMAXSIZ);
+    return hashmurmur(kbuf, ksiz) % bnum_;
+  }
+  /**
+   * Get the key region of an entry.
+   * @param ent the entry.
+   * @return the pointer to the key region.
+   */
+  static char* entry_key(Entry* ent) {
+    _assert_(ent);
+    return (char*)ent + sizeof(*ent);
+  }
+  /**
+   * Find the entry of a key.
+   * @param kbuf the pointer to the key region.
+   * @param ksiz the size of the key region.
+   * @return the entry, or NULL if the key does not exist.
+   */
+  Entry* find_entry(const char* kbuf, size_t ksiz) {
+    _assert_(kbuf && ksiz <= MEMMAXSIZ);
+    Entry* ent = buckets_[bucket_index(kbuf, ksiz)];
+    while (ent) {
+      if (ent->ksiz == ksiz && !std::memcmp(entry_key(ent), kbuf, ksiz)) return ent;
+      ent = ent->next;
+    }
+    return NULL;
+  }
+  /**
+   * Find the next entry in the order of the buckets.
+   * @param bidx the index of the bucket to start with.
+   * @param key the key of the pivot in the bucket, or NULL to start with the head of the bucket.
+   * @param rbidx the pointer to the variable to contain the index of the found bucket.
+   * @param rkey the string to contain the key of the found entry.
+   * @return true if an entry is found, or false if not.
+   * @note If the pivot does not exist, the search starts with the next bucket.
+   */
+  bool seek_entry(size_t bidx, const std::string* key, size_t* rbidx, std::string* rkey) {
+    _assert_(rbidx && rkey);
+    if (key) {
+      Entry* ent = buckets_[bidx];
+      while (ent) {
+        if (ent->ksiz == key->size() && !std::memcmp(entry_key(ent), key->data(), ent->ksiz))
+          break;
+        ent = ent->next;
+      }
+      if (ent && ent->next) {
+        ent = ent->next;
+        *rbidx = bidx;
+        rkey->assign(entry_key(ent), ent->ksiz);
+        return true;
+      }
+      bidx++;
+    }
+    while (bidx < (size_t)bnum_) {
+      Entry* ent = buckets_[bidx];
+      if (ent) {
+        *rbidx = bidx;
+        rkey->assign(entry_key(ent), ent->ksiz);
+        return true;
+      }
+      bidx++;
+    }
+    return false;
+  }
+  /**
+   * Set the location of the newest value of a key.
+   * @param kbuf the pointer to the key region.
+   * @param ksiz the size of the key region.
+   * @param seg the segment of the record.
+   * @param off the offset of the value.
+   * @param vsiz the size of the value.
+   */
+  void set_entry(const char* kbuf, size_t ksiz, Segment* seg, int64_t off, size_t vsiz) {
+    _assert_(kbuf && ksiz <= MEMMAXSIZ && seg && off >= 0 && vsiz <= MEMMAXSIZ);
+    size_t bidx = bucket_index(kbuf, ksiz);
+    Entry* ent = buckets_[bidx];
+    while (ent) {
+      if (ent->ksiz == ksiz && !std::memcmp(entry_key(ent), kbuf, ksiz)) break;
+      ent = ent->next;
+    }
+    if (tran_) record_undo(kbuf, ksiz, ent);
+    if (ent) {
+      ent->seg->live -= record_size(ksiz, ent->vsiz);
+    } else {
+      ent = (Entry*)new char[sizeof(*ent) + ksiz];
+      ent->ksiz = ksiz;
+      std::memcpy(entry_key(ent), kbuf, ksiz);
+      ent->next = buckets_[bidx];
+      buckets_[bidx] = ent;
+      count_++;
+    }
+    ent->seg = seg;
+    ent->off = off;
+    ent->vsiz = vsiz;
+    seg->live += record_size(ksiz, vsiz);
+  }
+  /**
+   * Remove the entry of a key.
+   * @param kbuf the pointer to the key region.
+   * @param ksiz the size of the key region.
+   */
+  void remove_entry(const char* kbuf, size_t ksiz) {
+    _assert_(kbuf && ksiz <= MEMMAXSIZ);
+    Entry** entp = buckets_ + bucket_index(kbuf, ksiz);
+    while (*entp) {
+      Entry* ent = *entp;
+      if (ent->ksiz == ksiz && !std::memcmp(entry_key(ent), kbuf, ksiz)) {
+        if (tran_) record_undo(kbuf, ksiz, ent);
+        ent->seg->live -= record_size(ksiz, ent->vsiz);
+        *entp = ent->next;
+        delete[] (char*)ent;
+        count_--;
+        return;
+      }
+      entp = &ent->next;
+    }
+  }
+  /**
+   * Record the location of a key before transaction.
+   * @param kbuf the pointer to the key region.
+   * @param ksiz the size of the key region.
+   * @param ent the current entry, or NULL if the key does not exist.
+   */
+  void record_undo(const char* kbuf, size_t ksiz, Entry* ent) {
+    _assert_(kbuf && ksiz <= MEMMAXSIZ);
+    std::string key(kbuf, ksiz);
+    if (trundo_.find(key) != trundo_.end()) return;
+    Location loc;
+    if (ent) {
+      loc.seg = ent->seg;
+      loc.off = ent->off;
+      loc.vsiz = ent->vsiz;
+    } else {
+      loc.seg = NULL;
+      loc.off = 0;
+      loc.vsiz = 0;
+    }
+    trundo_[key] = loc;
+  }
+  /**
+   * Get the path of a segment file.
+   * @param id the identifier of the segment.
+   * @param ext the extension of the file.
+   * @return the path of the file.
+   */
+  std::string segment_path(int64_t id, const char* ext) {
+    _assert_(ext);
+    return path_ + File::PATHCHR + strprintf("%010lld", (long long)id) + File::EXTCHR + ext;
+  }
+  /**
+   * Create a new segment to be written.
+   * @param id the identifier of the segment.
+   * @return the new segment object, or NULL on failure.
+   */
+  Segment* create_segment(int64_t id) {
+    _assert_(id > 0);
+    File* file = new File;
+    if (!file->open(segment_path(id, KCCDBSEGPATHEXT),
+                    File::OWRITER | File::OCREATE | File::OTRUNCATE | File::ONOLOCK)) {
+      set_error(_KCCODELINE_, Error::SYSTEM, file->error());
+      delete file;
+      return NULL;
+    }
+    char head[SEGHEADSIZ];
+    std::memset(head, 0, sizeof(head));
+    std::memcpy(head, KCCDBSEGMAGICDATA, sizeof(KCCDBSEGMAGICDATA) - 1);
+    writefixnum(head + sizeof(uint64_t), id, sizeof(uint64_t));
+    if (!file->append(head, sizeof(head))) {
+      set_error(_KCCODELINE_, Error::SYSTEM, file->error());
+      file->close();
+      delete file;
+      File::remove(segment_path(id, KCCDBSEGPATHEXT));
+      return NULL;
+    }
+    Segment* seg = new Segment;
+    seg->id = id;
+    seg->file = file;
+    seg->live = 0;
+    return seg;
+  }
+  /**
+   * Close a segment and remove its files.
+   * @param seg the segment.
+   */
+  void discard_segment(Segment* seg) {
+    _assert_(seg);
+    seg->file->close();
+    delete seg->file;
+    File::remove(segment_path(seg->id, KCCDBSEGPATHEXT));
+    File::remove(segment_path(seg->id, KCCDBHINTPATHEXT));
+    delete seg;
+  }
+  /**
+   * Open the segments listed in the meta data.
+   * @return true on success, or false on failure.
+   * @note Only the last segment is opened as writable.
+   */
+  bool open_segments() {
+    _assert_(true);
+    if (segs_.empty()) {
+      set_error(_KCCODELINE_, Error::BROKEN, "no segment");
+      return false;
+    }
+    for (size_t i = 0; i < segs_.size(); i++) {
+      Segment* seg = segs_[i];
+      uint32_t fmode = writer_ && i == segs_.size() - 1 ?
+          File::OWRITER : File::OREADER;
+      seg->file = new File;
+      if (!seg->file->open(segment_path(seg->id, KCCDBSEGPATHEXT), fmode | File::ONOLOCK)) {
+        set_error(_KCCODELINE_, Error::SYSTEM, seg->file->error());
+        delete seg->file;
+        seg->file = NULL;
+        return false;
+      }
+    }
+    return true;
+  }
+  /**
+   * Close all segments.
+   * @param remove true to remove the files of the segments, or false to keep them.
+   * @return true on success, or false on failure.
+   */
+  bool close_segments(bool remove) {
+    _assert_(true);
+    bool err = false;
+    SegmentVector::iterator it = segs_.begin();
+    SegmentVector::iterator itend = segs_.end();
+    while (it != itend) {
+      Segment* seg = *it;
+      if (seg->file) {
+        if (!seg->file->close()) {
+          set_error(_KCCODELINE_, Error::SYSTEM, seg->file->error());
+          err = true;
+        }
+        delete seg->file;
+      }
+      if (remove) {
+        File::remove(segment_path(seg->id, KCCDBSEGPATHEXT));
+        File::remove(segment_path(seg->id, KCCDBHINTPATHEXT));
+      }
+      delete seg;
+      ++it;
+    }
+    segs_.clear();
+    return !err;
+  }
+  /**
+   * Remove files which do not belong to the database.
+   * @param segs the segments to be kept, or NULL to remove every file except for the lock file.
+   * @return true on success, or false on failure.
+   */
+  bool remove_files(const SegmentVector* segs) {
+    _assert_(true);
+    std::set<std::string> names;
+    names.insert(KCCDBLOCKFILE);
+    if (segs) {
+      names.insert(KCCDBMETAFILE);
+      SegmentVector::const_iterator it = segs->begin();
+      SegmentVector::const_iterator itend = segs->end();
+      while (it != itend) {
+        const std::string& base = strprintf("%010lld", (long long)(*it)->id) + File::EXTCHR;
+        names.insert(base + KCCDBSEGPATHEXT);
+        names.insert(base + KCCDBHINTPATHEXT);
+        ++it;
+      }
+    }
+    std::vector<std::string> files;
+    if (!File::read_directory(path_, &files)) {
+      set_error(_KCCODELINE_, Error::SYSTEM, "reading a directory failed");
+      return false;
+    }
+    bool err = false;
+    std::vector<std::string>::iterator it = files.begin();
+    std::vector<std::string>::iterator itend = files.end();
+    while (it != itend) {
+      if (names.find(*it) == names.end()) {
+        const std::string& fpath = path_ + File::PATHCHR + *it;
+        if (segs) report(_KCCODELINE_, Logger::WARN, "removing a garbage file: %s", it->c_str());
+        if (!File::remove(fpath)) {
+          set_error(_KCCODELINE_, Error::SYSTEM, "removing a file failed");
+          err = true;
+        }
+      }
+      ++it;
+    }
+    return !err;
+  }
+  /**
+   * Dump the meta data into the file.
+   * @return true on success, or false on failure.
+   */
+  bool dump_meta() {
+    _assert_(true);
+    size_t msiz = METAHEADSIZ + segs_.size() * sizeof(uint64_t);
+    char* mbuf = new char[msiz];
+    std::memset(mbuf, 0, METAHEADSIZ);
+    std::memcpy(mbuf, KCCDBMAGICDATA, sizeof(KCCDBMAGICDATA) - 1);
+    char* wp = mbuf + sizeof(uint64_t);
+    writefixnum(wp, nextid_, sizeof(uint64_t));
+    wp += sizeof(uint64_t);
+    writefixnum(wp, segs_.size(), sizeof(uint64_t));
+    wp = mbuf + METAHEADSIZ;
+    SegmentVector::const_iterator it = segs_.begin();
+    SegmentVector::const_iterator itend = segs_.end();
+    while (it != itend) {
+      writefixnum(wp, (*it)->id, sizeof(uint64_t));
+      wp += sizeof(uint64_t);
+      ++it;
+    }
+    const std::string& mpath = path_ + File::PATHCHR + KCCDBMETAFILE;
+    const std::string& tpath = mpath + File::EXTCHR + KCCDBTMPPATHEXT;
+    bool err = false;
+    if (!File::write_file(tpath, mbuf, msiz)) {
+      set_error(_KCCODELINE_, Error::SYSTEM, "writing a file failed");
+      err = true;
+    } else if (!File::rename(tpath, mpath)) {
+      set_error(_KCCODELINE_, Error::SYSTEM, "renaming a file failed");
+      err = true;
+    }
+    delete[] mbuf;
+    return !err;
+  }
+  /**
+   * Load the meta data from the file.
+   * @return true on success, or false on failure.
+   */
+  bool load_meta() {
+    _assert_(true);
+    int64_t msiz;
+    char* mbuf = File::read_file(path_ + File::PATHCHR + KCCDBMETAFILE, &msiz);
+    if (!mbuf) {
+      set_error(_KCCODELINE_, Error::SYSTEM, "reading a file failed");
+      return false;
+    }
+    if (msiz < METAHEADSIZ ||
+        std::memcmp(mbuf, KCCDBMAGICDATA, sizeof(KCCDBMAGICDATA) - 1)) {
+      set_error(_KCCODELINE_, Error::BROKEN, "invalid meta data");
+      delete[] mbuf;
+      return false;
+    }
+    const char* rp = mbuf + sizeof(uint64_t);
+    nextid_ = readfixnum(rp, sizeof(uint64_t));
+    rp += sizeof(uint64_t);
+    int64_t snum = readfixnum(rp, sizeof(uint64_t));
+    rp = mbuf + METAHEADSIZ;
+    if (snum < 0 || msiz != METAHEADSIZ + snum * (int64_t)sizeof(uint64_t)) {
+      set_error(_KCCODELINE_, Error::BROKEN, "invalid meta data");
+      delete[] mbuf;
+      return false;
+    }
+    for (int64_t i = 0; i < snum; i++) {
+      Segment* seg = new Segment;
+      seg->id = readfixnum(rp, sizeof(uint64_t));
+      seg->file = NULL;
+      seg->live = 0;
+      segs_.push_back(seg);
+      rp += sizeof(uint64_t);
+    }
+    delete[] mbuf;
+    return true;
+  }
+  /**
+   * Rebuild the table in memory from the segments.
+   * @return true on success, or false on failure.
+   * @note The hint file of each immutable segment is read if it is valid.  The active segment
+   * is always scanned and its broken tail is discarded.
+   */
+  bool load_segments() {
+    _assert_(true);
+    size_t snum = segs_.size();
+    for (size_t i = 0; i < snum - 1; i++) {
+      Segment* seg = segs_[i];
+      if (load_hint(seg)) continue;
+      report(_KCCODELINE_, Logger::INFO, "scanning a segment without hint (id=%lld)",
+             (long long)seg->id);
+      if (!scan_segment(seg, false)) return false;
+    }
+    return scan_segment(segs_.back(), true);
+  }
+  /**
+   * Read every record in a segment file into the table in memory.
+   * @param seg the segment.
+   * @param active true if the segment is the active one, or false if not.
+   * @return true on success, or false on failure.
+   * @note Records of an unfinished transaction and a broken tail are discarded.
+   */
+  bool scan_segment(Segment* seg, bool active) {
+    _assert_(seg);
+    File* file = seg->file;
+    int64_t fsiz = file->size();
+    char head[SEGHEADSIZ];
+    if (fsiz < (int64_t)sizeof(head) || !file->read(0, head, sizeof(head)) ||
+        std::memcmp(head, KCCDBSEGMAGICDATA, sizeof(KCCDBSEGMAGICDATA) - 1) ||
+        (int64_t)readfixnum(head + sizeof(uint64_t), sizeof(uint64_t)) != seg->id) {
+      set_error(_KCCODELINE_, Error::BROKEN, "invalid segment header");
+      return false;
+    }
+    int64_t bsiz = fsiz - sizeof(head);
+    char* buf = new char[bsiz+1];
+    if (!file->read(sizeof(head), buf, bsiz)) {
+      set_error(_KCCODELINE_, Error::SYSTEM, file->error());
+      delete[] buf;
+      return false;
+    }
+    std::string* hint = active && writer_ ? &hint_ : NULL;
+    std::vector<const char*> trrecs;
+    bool intran = false;
+    const char* rp = buf;
+    const char* ep = buf + bsiz;
+    const char* good = rp;
+    while (rp < ep) {
+      uint8_t op = 0;
+      const char* kbuf = NULL;
+      size_t ksiz = 0;
+      size_t vsiz = 0;
+      size_t rsiz = parse_record(rp, ep, &op, &kbuf, &ksiz, &vsiz);
+      if (rsiz < 1) break;
+      if (op == OPBEGIN) {
+        trrecs.clear();
+        intran = true;
+      } else if (op == OPCOMMIT) {
+        std::vector<const char*>::iterator it = trrecs.begin();
+        std::vector<const char*>::iterator itend = trrecs.end();
+        while (it != itend) {
+          replay_record(seg, buf, *it, ep, hint);
+          ++it;
+        }
+        trrecs.clear();
+        intran = false;
+      } else if (intran) {
+        trrecs.push_back(rp);
+      } else {
+        replay_record(seg, buf, rp, ep, hint);
+      }
+      rp += rsiz;
+      if (!intran) good = rp;
+    }
+    bool err = false;
+    if (good < ep) {
+      recov_ = true;
+      report(_KCCODELINE_, Logger::WARN,
+             "discarding the broken tail of a segment (id=%lld size=%lld)",
+             (long long)seg->id, (long long)(ep - good));
+      if (active && writer_ && !file->truncate(sizeof(head) + (good - buf))) {
+        set_error(_KCCODELINE_, Error::SYSTEM, file->error());
+        err = true;
+      }
+    }
+    delete[] buf;
+    return !err;
+  }
+  /**
+   * Parse a record in a segment file.
+   * @param rp the pointer to the record.
+   * @param ep the pointer to the end of the region.
+   * @param opp the pointer to the variable to contain the operation code.
+   * @param kbufp the pointer to the variable to contain the pointer to the key region.
+   * @param ksizp the pointer to the variable to contain the size of the key region.
+   * @param vsizp the pointer to the variable to contain the size of the value region, which
+   * follows the key region.
+   * @return the size of the record, or 0 if the record is broken.
+   */
+  static size_t parse_record(const char* rp, const char* ep, uint8_t* opp,
+                             const char** kbufp, size_t* ksizp, size_t* vsizp) {
+    _assert_(rp && ep && opp && kbufp && ksizp && vsizp);
+    uint8_t op = *(uint8_t*)rp;
+    *opp = op;
+    if (op == OPBEGIN || op == OPCOMMIT) return 1;
+    if (op != OPSET && op != OPREMOVE) return 0;
+    const char* bp = rp++;
+    uint64_t ksiz, vsiz;
+    size_t step = readvarnum(rp, ep - rp, &ksiz);
+    if (step < 1) return 0;
+    rp += step;
+    step = readvarnum(rp, ep - rp, &vsiz);
+    if (step < 1) return 0;
+    rp += step;
+    if (ksiz > MEMMAXSIZ || vsiz > MEMMAXSIZ ||
+        (uint64_t)(ep - rp) < ksiz + vsiz + RECCHKSIZ) return 0;
+    size_t bsiz = rp - bp + ksiz + vsiz;
+    if (readfixnum(bp + bsiz, RECCHKSIZ) != calc_checksum(bp, bsiz)) return 0;
+    *kbufp = rp;
+    *ksizp = ksiz;
+    *vsizp = vsiz;
+    return bsiz + RECCHKSIZ;
+  }
+  /**
+   * Apply a record in a segment file to the table in memory.
+   * @param seg the segment.
+   * @param buf the pointer to the region of the segment after the header.
+   * @param rp the pointer to the record.
+   * @param ep the pointer to the end of the region.
+   * @param hint the string to which the hint entry is appended, or NULL.
+   */
+  void replay_record(Segment* seg, const char* buf, const char* rp, const char* ep,
+                     std::string* hint) {
+    _assert_(seg && buf && rp && ep);
+    uint8_t op = 0;
+    const char* kbuf = NULL;
+    size_t ksiz = 0;
+    size_t vsiz = 0;
+    parse_record(rp, ep, &op, &kbuf, &ksiz, &vsiz);
+    int64_t voff = SEGHEADSIZ + (kbuf - buf) + ksiz;
+    if (hint) add_hint(hint, op, kbuf, ksiz, vsiz, voff);
+    if (op == OPREMOVE) {
+      remove_entry(kbuf, ksiz);
+    } else {
+      set_entry(kbuf, ksiz, seg, voff, vsiz);
+    }
+  }
+  /**
+   * Append an entry to the hint data of a segment.
+   * @param hint the string of the hint data.
+   * @param op the operation code.
+   * @param kbuf the pointer to the key region.
+   * @param ksiz the size of the key region.
+   * @param vsiz the size of the value region.
+   * @param off the offset of the value.
+   */
+  static void add_hint(std::string* hint, uint8_t op, const char* kbuf, size_t ksiz,
+                       size_t vsiz, int64_t off) {
+    _assert_(hint && kbuf && ksiz <= MEMMAXSIZ && vsiz <= MEMMAXSIZ && off >= 0);
+    char nbuf[NUMBUFSIZ];
+    hint->push_back(op);
+    hint->append(nbuf, writevarnum(nbuf, ksiz));
+    hint->append(nbuf, writevarnum(nbuf, vsiz));
+    hint->append(nbuf, writevarnum(nbuf, off));
+    hint->append(kbuf, ksiz);
+  }
+  /**
+   * Write the hint file of a segment.
+   * @param seg the segment.
+   * @param hint the hint data.
+   * @return true on success, or false on failure.
+   * @note The segment file is synchronized with the device before the hint file is written,
+   * and the hint file is synchronized before it is renamed into place, so that a hint file never
+   * refers to records which are not persistent.
+   */
+  bool dump_hint(Segment* seg, const std::string& hint) {
+    _assert_(seg);
+    if (!seg->file->synchronize(true)) {
+      set_error(_KCCODELINE_, Error::SYSTEM, seg->file->error());
+      return false;
+    }
+    int64_t id = seg->id;
+    std::string data;
+    data.reserve(HINTHEADSIZ + hint.size() + sizeof(uint64_t));
+    char head[HINTHEADSIZ];
+    std::memset(head, 0, sizeof(head));
+    std::memcpy(head, KCCDBHINTMAGICDATA, sizeof(KCCDBHINTMAGICDATA) - 1);
+    writefixnum(head + sizeof(uint64_t), id, sizeof(uint64_t));
+    data.append(head, sizeof(head));
+    data.append(hint);
+    char nbuf[sizeof(uint64_t)];
+    writefixnum(nbuf, hashmurmur(hint.data(), hint.size()), sizeof(nbuf));
+    data.append(nbuf, sizeof(nbuf));
+    const std::string& hpath = segment_path(id, KCCDBHINTPATHEXT);
+    const std::string& tpath = hpath + File::EXTCHR + KCCDBTMPPATHEXT;
+    File file;
+    if (!file.open(tpath, File::OWRITER | File::OCREATE | File::OTRUNCATE | File::ONOLOCK)) {
+      set_error(_KCCODELINE_, Error::SYSTEM, file.error());
+      return false;
+    }
+    bool err = false;
+    if (!file.write(0, data.data(), data.size()) || !file.synchronize(true)) {
+      set_error(_KCCODELINE_, Error::SYSTEM, file.error());
+      err = true;
+    }
+    if (!file.close()) {
+      set_error(_KCCODELINE_, Error::SYSTEM, file.error());
+      err = true;
+    }
+    if (err) {
+      File::remove(tpath);
+      return false;
+    }
+    if (!File::rename(tpath, hpath)) {
+      set_error(_KCCODELINE_, Error::SYSTEM, "renaming a file failed");
+      return false;
+    }
+    return true;
+  }
+  /**
+   * Read the hint file of a segment into the table in memory.
+   * @param seg the segment.
+   * @return true on success, or false if the hint file is missing or invalid.
+   * @note Every entry is validated against the size of the segment file before any of them is
+   * applied, so that a stale hint falls back to scanning the segment.
+   */
+  bool load_hint(Segment* seg) {
+    _assert_(seg);
+    int64_t hsiz;
+    char* hbuf = File::read_file(segment_path(seg->id, KCCDBHINTPATHEXT), &hsiz);
+    if (!hbuf) return false;
+    const char* ep = hbuf + hsiz - sizeof(uint64_t);
+    bool ok = hsiz >= HINTHEADSIZ + (int64_t)sizeof(uint64_t) &&
+        !std::memcmp(hbuf, KCCDBHINTMAGICDATA, sizeof(KCCDBHINTMAGICDATA) - 1) &&
+        (int64_t)readfixnum(hbuf + sizeof(uint64_t), sizeof(uint64_t)) == seg->id &&
+        readfixnum(ep, sizeof(uint64_t)) ==
+        hashmurmur(hbuf + HINTHEADSIZ, ep - hbuf - HINTHEADSIZ);
+    int64_t fsiz = seg->file->size();
+    for (int32_t pass = 0; ok && pass < 2; pass++) {
+      const char* rp = hbuf + HINTHEADSIZ;
+      while (rp < ep) {
+        uint8_t op = *(uint8_t*)(rp++);
+        uint64_t ksiz, vsiz, off;
+        size_t step = readvarnum(rp, ep - rp, &ksiz);
+        rp += step;
+        if (step > 0) {
+          step = readvarnum(rp, ep - rp, &vsiz);
+          rp += step;
+        }
+        if (step > 0) {
+          step = readvarnum(rp, ep - rp, &off);
+          rp += step;
+        }
+        if (step < 1 || (op != OPSET && op != OPREMOVE) || ksiz > MEMMAXSIZ ||
+            vsiz > MEMMAXSIZ || (uint64_t)(ep - rp) < ksiz ||
+            off < SEGHEADSIZ + 1 + sizevarnum(ksiz) + sizevarnum(vsiz) + ksiz ||
+            off + vsiz + RECCHKSIZ > (uint64_t)fsiz) {
+          ok = false;
+          break;
+        }
+        if (pass > 0) {
+          if (op == OPREMOVE) {
+            remove_entry(rp, ksiz);
+          } else {
+            set_entry(rp, ksiz, seg, off, vsiz);
+          }
+        }
+        rp += ksiz;
+      }
+    }
+    if (!ok) report(_KCCODELINE_, Logger::WARN, "invalid hint file (id=%lld)", (long long)seg->id);
+    delete[] hbuf;
+    return ok;
+  }
+  /**
+   * Request the background thread to check the segments.
+   */
+  void request_merge() {
+    _assert_(true);
+    mgmutex_.lock();
+    mgreq_ = true;
+    mgcond_.signal();
+    mgmutex_.unlock();
+  }
+  /**
+   * Stop the background thread.
+   */
+  void stop_merger() {
+    _assert_(true);
+    if (!merger_) return;
+    mgmutex_.lock();
+    mgstop_ = true;
+    mgcond_.signal();
+    mgmutex_.unlock();
+    merger_->join();
+    delete merger_;
+    merger_ = NULL;
+  }
+  /**
+   * Check whether the background thread is being stopped.
+   * @return true if it is being stopped, or false if not.
+   */
+  bool merge_stopped() {
+    _assert_(true);
+    ScopedMutex lock(&mgmutex_);
+    return mgstop_;
+  }
+  /**
+   * Perform the loop of the background thread.
+   */
+  void merge_loop() {
+    _assert_(true);
+    mgmutex_.lock();
+    while (!mgstop_) {
+      if (!mgreq_) {
+        mgcond_.wait(&mgmutex_, 1.0);
+        continue;
+      }
+      mgreq_ = false;
+      mgmutex_.unlock();
+      bool done = true;
+      while (done) {
+        if (!merge_segments(false, &done)) {
+          const Error& e = error();
+          report(_KCCODELINE_, Logger::ERROR, "merging failed: %s: %s",
+                 e.name(), e.message());
+          break;
+        }
+      }
+      mgmutex_.lock();
+    }
+    mgmutex_.unlock();
+  }
+  /**
+   * Check whether a record in a segment is the newest version of the key.
+   * @param kbuf the pointer to the key region.
+   * @param ksiz the size of the key region.
+   * @param seg the segment of the record.
+   * @param off the offset of the value.
+   * @return true if the record is referred to by the table in memory or by the locations
+   * before transaction, or false if not.
+   */
+  bool check_live(const char* kbuf, size_t ksiz, Segment* seg, int64_t off) {
+    _assert_(kbuf && ksiz <= MEMMAXSIZ && seg);
+    ScopedRWLock lock(&mlock_, false);
+    Entry* ent = find_entry(kbuf, ksiz);
+    if (ent && ent->seg == seg && ent->off == off) return true;
+    if (tran_) {
+      UndoMap::const_iterator it = trundo_.find(std::string(kbuf, ksiz));
+      if (it != trundo_.end() && it->second.seg == seg && it->second.off == off) return true;
+    }
+    return false;
+  }
+  /**
+   * Merge the immutable segments into new ones.
+   * @param force true to merge regardless of the ratio of garbage.
+   * @param donep the pointer to the variable to indicate whether segments were merged.
+   * @return true on success, or false on failure.
+   * @note Live records are copied without blocking other threads and the table in memory is
+   * switched to the copies at the end.  Removal marks are dropped because every older version
+   * of the same key is in the merged segments.
+   */
+  bool merge_segments(bool force, bool* donep) {
+    _assert_(donep);
+    *donep = false;
+    ScopedMutex glock(&mglock_);
+    mlock_.lock_writer();
+    if (omode_ == 0 || !writer_) {
+      mlock_.unlock();
+      return true;
+    }
+    size_t snum = segs_.size() - 1;
+    int64_t total = 0;
+    int64_t live = 0;
+    for (size_t i = 0; i < snum; i++) {
+      total += segs_[i]->file->size() - SEGHEADSIZ;
+      live += segs_[i]->live;
+    }
+    if (snum < 1 || total <= live || (!force && total - live < total * mgratio_)) {
+      mlock_.unlock();
+      return true;
+    }
+    SegmentVector srcs(segs_.begin(), segs_.begin() + snum);
+    mlock_.unlock();
+    report(_KCCODELINE_, Logger::INFO, "merging %lld segments (size=%lld live=%lld)",
+           (long long)snum, (long long)total, (long long)live);
+    SegmentVector dests;
+    MoveVector moves;
+    std::string hint;
+    Segment* dest = NULL;
+    bool err = false;
+    int64_t cnt = 0;
+    for (size_t i = 0; !err && i < snum; i++) {
+      Segment* src = srcs[i];
+      int64_t bsiz = src->file->size() - SEGHEADSIZ;
+      char* buf = new char[bsiz+1];
+      if (!src->file->read(SEGHEADSIZ, buf, bsiz)) {
+        set_error(_KCCODELINE_, Error::SYSTEM, src->file->error());
+        delete[] buf;
+        err = true;
+        break;
+      }
+      const char* rp = buf;
+      const char* ep = buf + bsiz;
+      while (rp < ep) {
+        uint8_t op = 0;
+        const char* kbuf = NULL;
+        size_t ksiz = 0;
+        size_t vsiz = 0;
+        size_t rsiz = parse_record(rp, ep, &op, &kbuf, &ksiz, &vsiz);
+        if (rsiz < 1) break;
+        int64_t off = SEGHEADSIZ + (kbuf - buf) + ksiz;
+        if (op == OPSET && check_live(kbuf, ksiz, src, off)) {
+          if (!dest || dest->file->size() >= segcap_) {
+            if (dest && !dump_hint(dest, hint)) {
+              err = true;
+              break;
+            }
+            hint.clear();
+            mlock_.lock_writer();
+            int64_t id = nextid_++;
+            mlock_.unlock();
+            dest = create_segment(id);
+            if (!dest) {
+              err = true;
+              break;
+            }
+            dests.push_back(dest);
+          }
+          int64_t noff = dest->file->size() + (kbuf - rp) + ksiz;
+          if (!dest->file->append(rp, rsiz)) {
+            set_error(_KCCODELINE_, Error::SYSTEM, dest->file->error());
+            err = true;
+            break;
+          }
+          add_hint(&hint, op, kbuf, ksiz, vsiz, noff);
+          Move move;
+          move.key.assign(kbuf, ksiz);
+          move.src = src;
+          move.off = off;
+          move.dest = dest;
+          move.noff = noff;
+          moves.push_back(move);
+        }
+        rp += rsiz;
+        if (++cnt % MGCHECKFREQ == 0 && merge_stopped()) {
+          delete[] buf;
+          for (size_t j = 0; j < dests.size(); j++) {
+            discard_segment(dests[j]);
+          }
+          return true;
+        }
+      }
+      delete[] buf;
+    }
+    if (!err && dest && !dump_hint(dest, hint)) err = true;
+    if (err) {
+      for (size_t i = 0; i < dests.size(); i++) {
+        discard_segment(dests[i]);
+      }
+      return false;
+    }
+    mlock_.lock_writer();
+    MoveVector::const_iterator mit = moves.begin();
+    MoveVector::const_iterator mitend = moves.end();
+    while (mit != mitend) {
+      Entry* ent = find_entry(mit->key.data(), mit->key.size());
+      if (ent && ent->seg == mit->src && ent->off == mit->off) {
+        ent->seg = mit->dest;
+        ent->off = mit->noff;
+        mit->dest->live += record_size(ent->ksiz, ent->vsiz);
+      }
+      if (tran_) {
+        UndoMap::iterator uit = trundo_.find(mit->key);
+        if (uit != trundo_.end() && uit->second.seg == mit->src && uit->second.off == mit->off) {
+          uit->second.seg = mit->dest;
+          uit->second.off = mit->noff;
+        }
+      }
+      ++mit;
+    }
+    segs_.erase(segs_.begin(), segs_.begin() + snum);
+    segs_.insert(segs_.begin(), dests.begin(), dests.end());
+    if (!dump_meta()) err = true;
+    mgcnt_ += 1;
+    mlock_.unlock();
+    for (size_t i = 0; i < snum; i++) {
+      if (err) {
+        srcs[i]->file->close();
+        delete srcs[i]->file;
+        delete srcs[i];
+      } else {
+        discard_segment(srcs[i]);
+      }
+    }
+    *donep = !err;
+    return !err;
+  }
+  /**
+   * Get the size of a record in a segment file.
+   * @param ksiz the size of the key region.
+   * @param vsiz the size of the value region.
+   * @return the size of the record.
+   */
+  static int64_t record_size(size_t ksiz, size_t vsiz) {
+    _assert_(true);
+    return 1 + sizevarnum(ksiz) + sizevarnum(vsiz) + ksiz + vsiz + RECCHKSIZ;
+  }
+  /**
+   * Calculate the checksum of a record.
+   * @param buf the pointer to the region of the record.
+   * @param size the size of the region.
+   * @return the checksum.
+   */
+  static uint32_t calc_checksum(const char* buf, size_t size) {
+    _assert_(buf && size <= MEMMAXSIZ);
+    return (uint32_t)hashmurmur(buf, size);
+  }
+  /** Dummy constructor to forbid the use. */
+  CaskDB(const CaskDB&);
+  /** Dummy Operator to forbid the use. */
+  CaskDB& operator =(const CaskDB&);
+  /** The method lock. */
+  RWLock mlock_;
+  /** The lock for merging. */
+  Mutex mglock_;
+  /** The mutex for the background thread. */
+  Mutex mgmutex_;
+  /** The condition variable for the background thread. */
+  CondVar mgcond_;
+  /** The last happened error. */
+  TSD<Error> error_;
+  /** The internal logger. */
+  Logger* logger_;
+  /** The kinds of logged messages. */
+  uint32_t logkinds_;
+  /** The internal meta operation trigger. */
+  MetaTrigger* mtrigger_;
+  /** The open mode. */
+  uint32_t omode_;
+  /** The flag for writer. */
+  bool writer_;
+  /** The flag for auto synchronization. */
+  bool autosync_;
+  /** The flag for recovered. */
+  bool recov_;
+  /** The lock file. */
+  File lock_;
+  /** The path of the database directory. */
+  std::string path_;
+  /** The bucket number of the table in memory. */
+  int64_t bnum_;
+  /** The capacity of each segment. */
+  int64_t segcap_;
+  /** The ratio of garbage to trigger merging. */
+  double mgratio_;
+  /** The buckets of the table in memory. */
+  Entry** buckets_;
+  /** The segments from the oldest to the active one. */
+  SegmentVector segs_;
+  /** The hint data of the active segment. */
+  std::string hint_;
+  /** The record number. */
+  int64_t count_;
+  /** The next identifier of segments. */
+  int64_t nextid_;
+  /** The flag whether in transaction. */
+  bool tran_;
+  /** The flag whether hard transaction. */
+  bool trhard_;
+  /** The locations of records before transaction. */
+  UndoMap trundo_;
+  /** The size of the active segment before transaction. */
+  int64_t trsegsiz_;
+  /** The size of the hint data before transaction. */
+  size_t trhintsiz_;
+  /** The background thread. */
+  Merger* merger_;
+  /** The flag whether merging is requested. */
+  bool mgreq_;
+  /** The flag whether the background thread is being stopped. */
+  bool mgstop_;
+  /** The number of rotations. */
+  AtomicInt64 rotcnt_;
+  /** The number of merges. */
+  AtomicInt64 mgcnt_;
+};
+
+
+}                                        // common namespace
+
+#endif                                   // duplication check
+
+// END OF FILE
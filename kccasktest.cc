@@ -0,0 +1,680 @@
+/*************************************************************************************************
+ * The test cases of the log-structured hash database
+ *                                                               Copyright (C) 2009-2011 FAL Labs
+ * This file is part of Kyoto Cabinet.
+ * This program is free software: you can redistribute it and/or modify it under the terms of
+ * the GNU General Public License as published by the Free Software Foundation, either version
+ * 3 of the License, or any later version.
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ *************************************************************************************************/
+
+
+#include <kccaskdb.h>
+#include "cmdcommon.h"
+
+
+// global variables
+const char* g_progname;                  // program name
+uint32_t g_randseed;                     // random seed
+int64_t g_memusage;                      // memory usage
+
+
+// function prototypes
+int main(int argc, char** argv);
+static void usage();
+static void dberrprint(kc::BasicDB* db, int32_t line, const char* func);
+static void dbmetaprint(kc::BasicDB* db, bool verbose);
+static size_t makevalue(int64_t num, char* buf);
+static int32_t runorder(int argc, char** argv);
+static int32_t runrecover(int argc, char** argv);
+static int32_t procorder(const char* path, int64_t rnum, int32_t thnum, bool rnd, bool tran,
+                         int32_t oflags, int64_t segcap, bool lv);
+static int32_t procrecover(const char* path, int64_t rnum, int64_t segcap, bool lv);
+
+
+// main routine
+int main(int argc, char** argv) {
+  g_progname = argv[0];
+  const char* ebuf = kc::getenv("KCRNDSEED");
+  g_randseed = ebuf ? (uint32_t)kc::atoi(ebuf) : (uint32_t)(kc::time() * 1000);
+  mysrand(g_randseed);
+  g_memusage = memusage();
+  kc::setstdiobin();
+  if (argc < 2) usage();
+  int32_t rv = 0;
+  if (!std::strcmp(argv[1], "order")) {
+    rv = runorder(argc, argv);
+  } else if (!std::strcmp(argv[1], "recover")) {
+    rv = runrecover(argc, argv);
+  } else {
+    usage();
+  }
+  if (rv != 0) {
+    oprintf("FAILED: KCRNDSEED=%u PID=%ld", g_randseed, (long)kc::getpid());
+    for (int32_t i = 0; i < argc; i++) {
+      oprintf(" %s", argv[i]);
+    }
+    oprintf("\n\n");
+  }
+  return rv;
+}
+
+
+// print the usage and exit
+static void usage() {
+  eprintf("%s: test cases of the log-structured hash database of Kyoto Cabinet\n", g_progname);
+  eprintf("\n");
+  eprintf("usage:\n");
+  eprintf("  %s order [-th num] [-rnd] [-tran] [-oas|-onl|-otl|-onr] [-seg num] [-lv]"
+          " path rnum\n", g_progname);
+  eprintf("  %s recover [-seg num] [-lv] path rnum\n", g_progname);
+  eprintf("\n");
+  std::exit(1);
+}
+
+
+// print the error message of a database
+static void dberrprint(kc::BasicDB* db, int32_t line, const char* func) {
+  const kc::BasicDB::Error& err = db->error();
+  oprintf("%s: %d: %s: %s: %d: %s: %s\n",
+          g_progname, line, func, db->path().c_str(), err.code(), err.name(), err.message());
+}
+
+
+// print members of a database
+static void dbmetaprint(kc::BasicDB* db, bool verbose) {
+  if (verbose) {
+    std::map<std::string, std::string> status;
+    if (db->status(&status)) {
+      uint32_t type = kc::atoi(status["type"].c_str());
+      oprintf("type: %s (%s) (type=0x%02X)\n",
+              kc::BasicDB::typecname(type), kc::BasicDB::typestring(type), type);
+      oprintf("path: %s\n", status["path"].c_str());
+      oprintf("status flags:");
+      if (kc::atoi(status["recovered"].c_str()) > 0) oprintf(" (recovered)");
+      oprintf("\n");
+      oprintf("segment capacity: %lld\n", (long long)kc::atoi(status["segcap"].c_str()));
+      oprintf("segment number: %lld\n", (long long)kc::atoi(status["segnum"].c_str()));
+      oprintf("live size: %lld\n", (long long)kc::atoi(status["live"].c_str()));
+      oprintf("rotation count: %lld\n", (long long)kc::atoi(status["rotcnt"].c_str()));
+      oprintf("merging count: %lld\n", (long long)kc::atoi(status["mgcnt"].c_str()));
+      int64_t count = kc::atoi(status["count"].c_str());
+      std::string cntstr = unitnumstr(count);
+      oprintf("count: %lld (%s)\n", count, cntstr.c_str());
+      int64_t size = kc::atoi(status["size"].c_str());
+      std::string sizestr = unitnumstrbyte(size);
+      oprintf("size: %lld (%s)\n", size, sizestr.c_str());
+    }
+  } else {
+    oprintf("count: %lld\n", (long long)db->count());
+    oprintf("size: %lld\n", (long long)db->size());
+  }
+  int64_t musage = memusage();
+  if (musage > 0) oprintf("memory: %lld\n", (long long)(musage - g_memusage));
+}
+
+
+// make the value of a record, whose length varies with the number
+static size_t makevalue(int64_t num, char* buf) {
+  char* wp = buf;
+  for (int64_t i = 0; i <= num % 5; i++) {
+    wp += std::sprintf(wp, "%08lld", (long long)num);
+  }
+  return wp - buf;
+}
+
+
+// parse arguments of order command
+static int32_t runorder(int argc, char** argv) {
+  bool argbrk = false;
+  const char* path = NULL;
+  const char* rstr = NULL;
+  int32_t thnum = 1;
+  bool rnd = false;
+  bool tran = false;
+  int32_t oflags = 0;
+  int64_t segcap = -1;
+  bool lv = false;
+  for (int32_t i = 2; i < argc; i++) {
+    if (!argbrk && argv[i][0] == '-') {
+      if (!std::strcmp(argv[i], "--")) {
+        argbrk = true;
+      } else if (!std::strcmp(argv[i], "-th")) {
+        if (++i >= argc) usage();
+        thnum = kc::atoix(argv[i]);
+      } else if (!std::strcmp(argv[i], "-rnd")) {
+        rnd = true;
+      } else if (!std::strcmp(argv[i], "-tran")) {
+        tran = true;
+      } else if (!std::strcmp(argv[i], "-oas")) {
+        oflags |= kc::CaskDB::OAUTOSYNC;
+      } else if (!std::strcmp(argv[i], "-onl")) {
+        oflags |= kc::CaskDB::ONOLOCK;
+      } else if (!std::strcmp(argv[i], "-otl")) {
+        oflags |= kc::CaskDB::OTRYLOCK;
+      } else if (!std::strcmp(argv[i], "-onr")) {
+        oflags |= kc::CaskDB::ONOREPAIR;
+      } else if (!std::strcmp(argv[i], "-seg")) {
+        if (++i >= argc) usage();
+        segcap = kc::atoix(argv[i]);
+      } else if (!std::strcmp(argv[i], "-lv")) {
+        lv = true;
+      } else {
+        usage();
+      }
+    } else if (!path) {
+      argbrk = true;
+      path = argv[i];
+    } else if (!rstr) {
+      rstr = argv[i];
+    } else {
+      usage();
+    }
+  }
+  if (!path || !rstr) usage();
+  int64_t rnum = kc::atoix(rstr);
+  if (rnum < 1 || thnum < 1) usage();
+  if (thnum > THREADMAX) thnum = THREADMAX;
+  int32_t rv = procorder(path, rnum, thnum, rnd, tran, oflags, segcap, lv);
+  return rv;
+}
+
+
+// parse arguments of recover command
+static int32_t runrecover(int argc, char** argv) {
+  bool argbrk = false;
+  const char* path = NULL;
+  const char* rstr = NULL;
+  int64_t segcap = -1;
+  bool lv = false;
+  for (int32_t i = 2; i < argc; i++) {
+    if (!argbrk && argv[i][0] == '-') {
+      if (!std::strcmp(argv[i], "--")) {
+        argbrk = true;
+      } else if (!std::strcmp(argv[i], "-seg")) {
+        if (++i >= argc) usage();
+        segcap = kc::atoix(argv[i]);
+      } else if (!std::strcmp(argv[i], "-lv")) {
+        lv = true;
+      } else {
+        usage();
+      }
+    } else if (!path) {
+      argbrk = true;
+      path = argv[i];
+    } else if (!rstr) {
+      rstr = argv[i];
+    } else {
+      usage();
+    }
+  }
+  if (!path || !rstr) usage();
+  int64_t rnum = kc::atoix(rstr);
+  if (rnum < 1) usage();
+  int32_t rv = procrecover(path, rnum, segcap, lv);
+  return rv;
+}
+
+
+// perform order command
+static int32_t procorder(const char* path, int64_t rnum, int32_t thnum, bool rnd, bool tran,
+                         int32_t oflags, int64_t segcap, bool lv) {
+  oprintf("<In-order Test>\n  seed=%u  path=%s  rnum=%lld  thnum=%d  rnd=%d  tran=%d"
+          "  oflags=%d  segcap=%lld  lv=%d\n\n",
+          g_randseed, path, (long long)rnum, thnum, rnd, tran, oflags, (long long)segcap, lv);
+  bool err = false;
+  kc::CaskDB db;
+  oprintf("opening the database:\n");
+  double stime = kc::time();
+  db.tune_logger(stdlogger(g_progname, &std::cout),
+                 lv ? kc::UINT32MAX : kc::BasicDB::Logger::WARN | kc::BasicDB::Logger::ERROR);
+  if (segcap > 0) db.tune_segment(segcap);
+  if (!db.open(path, kc::CaskDB::OWRITER | kc::CaskDB::OCREATE | kc::CaskDB::OTRUNCATE |
+               oflags)) {
+    dberrprint(&db, __LINE__, "DB::open");
+    err = true;
+  }
+  double etime = kc::time();
+  dbmetaprint(&db, false);
+  oprintf("time: %.3f\n", etime - stime);
+  oprintf("setting records:\n");
+  stime = kc::time();
+  class ThreadSet : public kc::Thread {
+   public:
+    void setparams(int32_t id, kc::BasicDB* db, int64_t rnum, int32_t thnum,
+                   bool rnd, bool tran) {
+      id_ = id;
+      db_ = db;
+      rnum_ = rnum;
+      thnum_ = thnum;
+      err_ = false;
+      rnd_ = rnd;
+      tran_ = tran;
+    }
+    bool error() {
+      return err_;
+    }
+    void run() {
+      int64_t base = id_ * rnum_;
+      int64_t range = rnum_ * thnum_;
+      for (int64_t i = 1; !err_ && i <= rnum_; i++) {
+        if (tran_ && !db_->begin_transaction(false)) {
+          dberrprint(db_, __LINE__, "DB::begin_transaction");
+          err_ = true;
+        }
+        int64_t num = rnd_ ? myrand(range) + 1 : base + i;
+        char kbuf[RECBUFSIZ];
+        size_t ksiz = std::sprintf(kbuf, "%08lld", (long long)num);
+        char vbuf[RECBUFSIZ];
+        size_t vsiz = makevalue(num, vbuf);
+        if (!db_->set(kbuf, ksiz, vbuf, vsiz)) {
+          dberrprint(db_, __LINE__, "DB::set");
+          err_ = true;
+        }
+        if (rnd_ && i % 8 == 0 && myrand(4) == 0 &&
+            !db_->remove(kbuf, ksiz) && db_->error() != kc::BasicDB::Error::NOREC) {
+          dberrprint(db_, __LINE__, "DB::remove");
+          err_ = true;
+        }
+        if (tran_ && !db_->end_transaction(true)) {
+          dberrprint(db_, __LINE__, "DB::end_transaction");
+          err_ = true;
+        }
+        if (id_ < 1 && rnum_ > 250 && i % (rnum_ / 250) == 0) {
+          oputchar('.');
+          if (i == rnum_ || i % (rnum_ / 10) == 0) oprintf(" (%08lld)\n", (long long)i);
+        }
+      }
+    }
+   private:
+    int32_t id_;
+    kc::BasicDB* db_;
+    int64_t rnum_;
+    int32_t thnum_;
+    bool err_;
+    bool rnd_;
+    bool tran_;
+  };
+  ThreadSet threadsets[THREADMAX];
+  if (thnum < 2) {
+    threadsets[0].setparams(0, &db, rnum, thnum, rnd, tran);
+    threadsets[0].run();
+    if (threadsets[0].error()) err = true;
+  } else {
+    for (int32_t i = 0; i < thnum; i++) {
+      threadsets[i].setparams(i, &db, rnum, thnum, rnd, tran);
+      threadsets[i].start();
+    }
+    for (int32_t i = 0; i < thnum; i++) {
+      threadsets[i].join();
+      if (threadsets[i].error()) err = true;
+    }
+  }
+  etime = kc::time();
+  dbmetaprint(&db, false);
+  oprintf("time: %.3f\n", etime - stime);
+  oprintf("getting records:\n");
+  stime = kc::time();
+  class ThreadGet : public kc::Thread {
+   public:
+    void setparams(int32_t id, kc::BasicDB* db, int64_t rnum, int32_t thnum, bool rnd) {
+      id_ = id;
+      db_ = db;
+      rnum_ = rnum;
+      thnum_ = thnum;
+      err_ = false;
+      rnd_ = rnd;
+    }
+    bool error() {
+      return err_;
+    }
+    void run() {
+      int64_t base = id_ * rnum_;
+      int64_t range = rnum_ * thnum_;
+      for (int64_t i = 1; !err_ && i <= rnum_; i++) {
+        int64_t num = rnd_ ? myrand(range) + 1 : base + i;
+        char kbuf[RECBUFSIZ];
+        size_t ksiz = std::sprintf(kbuf, "%08lld", (long long)num);
+        char vbuf[RECBUFSIZ];
+        size_t vsiz = makevalue(num, vbuf);
+        size_t rsiz;
+        char* rbuf = db_->get(kbuf, ksiz, &rsiz);
+        if (rbuf) {
+          if (rsiz != vsiz || std::memcmp(rbuf, vbuf, vsiz)) {
+            dberrprint(db_, __LINE__, "DB::get");
+            err_ = true;
+          }
+          delete[] rbuf;
+        } else if (!rnd_ || db_->error() != kc::BasicDB::Error::NOREC) {
+          dberrprint(db_, __LINE__, "DB::get");
+          err_ = true;
+        }
+        if (id_ < 1 && rnum_ > 250 && i % (rnum_ / 250) == 0) {
+          oputchar('.');
+          if (i == rnum_ || i % (rnum_ / 10) == 0) oprintf(" (%08lld)\n", (long long)i);
+        }
+      }
+    }
+   private:
+    int32_t id_;
+    kc::BasicDB* db_;
+    int64_t rnum_;
+    int32_t thnum_;
+    bool err_;
+    bool rnd_;
+  };
+  ThreadGet threadgets[THREADMAX];
+  if (thnum < 2) {
+    threadgets[0].setparams(0, &db, rnum, thnum, rnd);
+    threadgets[0].run();
+    if (threadgets[0].error()) err = true;
+  } else {
+    for (int32_t i = 0; i < thnum; i++) {
+      threadgets[i].setparams(i, &db, rnum, thnum, rnd);
+      threadgets[i].start();
+    }
+    for (int32_t i = 0; i < thnum; i++) {
+      threadgets[i].join();
+      if (threadgets[i].error()) err = true;
+    }
+  }
+  etime = kc::time();
+  dbmetaprint(&db, false);
+  oprintf("time: %.3f\n", etime - stime);
+  oprintf("merging the segments:\n");
+  stime = kc::time();
+  int64_t count = db.count();
+  if (!db.merge()) {
+    dberrprint(&db, __LINE__, "DB::merge");
+    err = true;
+  }
+  if (db.count() != count) {
+    dberrprint(&db, __LINE__, "DB::count");
+    err = true;
+  }
+  etime = kc::time();
+  dbmetaprint(&db, true);
+  oprintf("time: %.3f\n", etime - stime);
+  oprintf("traversing the database:\n");
+  stime = kc::time();
+  class VisitorImpl : public kc::DB::Visitor {
+   public:
+    explicit VisitorImpl() : cnt_(0), err_(false) {}
+    int64_t cnt() {
+      return cnt_;
+    }
+    bool error() {
+      return err_;
+    }
+   private:
+    const char* visit_full(const char* kbuf, size_t ksiz,
+                           const char* vbuf, size_t vsiz, size_t* sp) {
+      cnt_++;
+      char nbuf[RECBUFSIZ];
+      size_t nsiz = makevalue(kc::atoin(kbuf, ksiz), nbuf);
+      if (vsiz != nsiz || std::memcmp(vbuf, nbuf, nsiz)) err_ = true;
+      return NOP;
+    }
+    int64_t cnt_;
+    bool err_;
+  } visitor;
+  if (!db.iterate(&visitor, false)) {
+    dberrprint(&db, __LINE__, "DB::iterate");
+    err = true;
+  }
+  if (visitor.error() || visitor.cnt() != count) {
+    dberrprint(&db, __LINE__, "DB::iterate");
+    err = true;
+  }
+  etime = kc::time();
+  oprintf("time: %.3f\n", etime - stime);
+  oprintf("reopening the database:\n");
+  stime = kc::time();
+  if (!db.close()) {
+    dberrprint(&db, __LINE__, "DB::close");
+    err = true;
+  }
+  if (!db.open(path, kc::CaskDB::OWRITER | oflags)) {
+    dberrprint(&db, __LINE__, "DB::open");
+    err = true;
+  }
+  if (db.count() != count) {
+    dberrprint(&db, __LINE__, "DB::count");
+    err = true;
+  }
+  etime = kc::time();
+  dbmetaprint(&db, false);
+  oprintf("time: %.3f\n", etime - stime);
+  oprintf("removing records:\n");
+  stime = kc::time();
+  for (int64_t i = 1; !err && i <= rnum * thnum; i++) {
+    char kbuf[RECBUFSIZ];
+    size_t ksiz = std::sprintf(kbuf, "%08lld", (long long)i);
+    if (!db.remove(kbuf, ksiz) && (!rnd || db.error() != kc::BasicDB::Error::NOREC)) {
+      dberrprint(&db, __LINE__, "DB::remove");
+      err = true;
+    }
+    if (rnum * thnum > 250 && i % (rnum * thnum / 250) == 0) {
+      oputchar('.');
+      if (i == rnum * thnum || i % (rnum * thnum / 10) == 0)
+        oprintf(" (%08lld)\n", (long long)i);
+    }
+  }
+  if (!err && db.count() != 0) {
+    dberrprint(&db, __LINE__, "DB::count");
+    err = true;
+  }
+  etime = kc::time();
+  dbmetaprint(&db, true);
+  oprintf("time: %.3f\n", etime - stime);
+  oprintf("closing the database:\n");
+  stime = kc::time();
+  if (!db.close()) {
+    dberrprint(&db, __LINE__, "DB::close");
+    err = true;
+  }
+  etime = kc::time();
+  oprintf("time: %.3f\n", etime - stime);
+  oprintf("%s\n\n", err ? "error" : "ok");
+  return err ? 1 : 0;
+}
+
+
+// perform recover command
+static int32_t procrecover(const char* path, int64_t rnum, int64_t segcap, bool lv) {
+  oprintf("<Recovery Test>\n  seed=%u  path=%s  rnum=%lld  segcap=%lld  lv=%d\n\n",
+          g_randseed, path, (long long)rnum, (long long)segcap, lv);
+  bool err = false;
+  kc::CaskDB db;
+  db.tune_logger(stdlogger(g_progname, &std::cout),
+                 lv ? kc::UINT32MAX : kc::BasicDB::Logger::WARN | kc::BasicDB::Logger::ERROR);
+  if (segcap > 0) db.tune_segment(segcap);
+  oprintf("setting records:\n");
+  double stime = kc::time();
+  if (!db.open(path, kc::CaskDB::OWRITER | kc::CaskDB::OCREATE | kc::CaskDB::OTRUNCATE)) {
+    dberrprint(&db, __LINE__, "DB::open");
+    err = true;
+  }
+  for (int64_t i = 1; !err && i <= rnum; i++) {
+    char kbuf[RECBUFSIZ];
+    size_t ksiz = std::sprintf(kbuf, "%08lld", (long long)i);
+    char vbuf[RECBUFSIZ];
+    size_t vsiz = makevalue(i, vbuf);
+    if (!db.set(kbuf, ksiz, vbuf, vsiz)) {
+      dberrprint(&db, __LINE__, "DB::set");
+      err = true;
+    }
+  }
+  if (!db.close()) {
+    dberrprint(&db, __LINE__, "DB::close");
+    err = true;
+  }
+  double etime = kc::time();
+  oprintf("time: %.3f\n", etime - stime);
+  oprintf("damaging the segments:\n");
+  stime = kc::time();
+  std::vector<std::string> names;
+  kc::DirStream dir;
+  if (dir.open(path)) {
+    std::string name;
+    const std::string& ext = std::string(1, kc::File::EXTCHR) + KCCDBSEGPATHEXT;
+    while (dir.read(&name)) {
+      if (name.size() > ext.size() &&
+          !name.compare(name.size() - ext.size(), ext.size(), ext))
+        names.push_back(name.substr(0, name.size() - ext.size()));
+    }
+    dir.close();
+  }
+  std::sort(names.begin(), names.end());
+  if (names.size() < 5) {
+    oprintf("%s: %d: too few segments: %d\n", g_progname, __LINE__, (int)names.size());
+    err = true;
+  }
+  for (size_t i = 0; !err && i < 4; i++) {
+    const std::string& base = std::string(path) + kc::File::PATHCHR + names[i] +
+        kc::File::EXTCHR;
+    const std::string& spath = base + KCCDBSEGPATHEXT;
+    const std::string& hpath = base + KCCDBHINTPATHEXT;
+    if (i == 1 || i == 2) {
+      kc::File file;
+      if (!file.open(spath, kc::File::OWRITER | kc::File::ONOLOCK) ||
+          !file.truncate(file.size() - 1) || !file.close()) {
+        oprintf("%s: %d: %s: %s\n", g_progname, __LINE__, spath.c_str(), file.error());
+        err = true;
+      }
+      oprintf("truncated: %s\n", spath.c_str());
+    }
+    if (i == 0 || i == 2) {
+      if (!kc::File::remove(hpath)) {
+        oprintf("%s: %d: %s: removing failed\n", g_progname, __LINE__, hpath.c_str());
+        err = true;
+      }
+      oprintf("removed: %s\n", hpath.c_str());
+    } else if (i == 3) {
+      const std::string& opath = std::string(path) + kc::File::PATHCHR + names[i+1] +
+          kc::File::EXTCHR + KCCDBHINTPATHEXT;
+      int64_t hsiz;
+      char* hbuf = kc::File::read_file(opath, &hsiz);
+      if (!hbuf || !kc::File::write_file(hpath, hbuf, hsiz)) {
+        oprintf("%s: %d: %s: copying failed\n", g_progname, __LINE__, hpath.c_str());
+        err = true;
+      }
+      delete[] hbuf;
+      oprintf("replaced: %s\n", hpath.c_str());
+    }
+  }
+  etime = kc::time();
+  oprintf("time: %.3f\n", etime - stime);
+  oprintf("reopening the database:\n");
+  stime = kc::time();
+  if (!db.open(path, kc::CaskDB::OWRITER)) {
+    dberrprint(&db, __LINE__, "DB::open");
+    err = true;
+  }
+  std::map<std::string, std::string> status;
+  if (!db.status(&status) || kc::atoi(status["recovered"].c_str()) < 1) {
+    dberrprint(&db, __LINE__, "DB::status");
+    err = true;
+  }
+  etime = kc::time();
+  dbmetaprint(&db, true);
+  oprintf("time: %.3f\n", etime - stime);
+  oprintf("checking records:\n");
+  stime = kc::time();
+  int64_t miss = 0;
+  for (int64_t i = 1; !err && i <= rnum; i++) {
+    char kbuf[RECBUFSIZ];
+    size_t ksiz = std::sprintf(kbuf, "%08lld", (long long)i);
+    char vbuf[RECBUFSIZ];
+    size_t vsiz = makevalue(i, vbuf);
+    size_t rsiz;
+    char* rbuf = db.get(kbuf, ksiz, &rsiz);
+    if (rbuf) {
+      if (rsiz != vsiz || std::memcmp(rbuf, vbuf, vsiz)) {
+        dberrprint(&db, __LINE__, "DB::get");
+        err = true;
+      }
+      delete[] rbuf;
+    } else if (db.error() == kc::BasicDB::Error::NOREC) {
+      miss++;
+    } else {
+      dberrprint(&db, __LINE__, "DB::get");
+      err = true;
+    }
+  }
+  if (!err && (miss != 2 || db.count() != rnum - miss)) {
+    oprintf("%s: %d: unexpected missing records: miss=%lld count=%lld\n",
+            g_progname, __LINE__, (long long)miss, (long long)db.count());
+    err = true;
+  }
+  etime = kc::time();
+  oprintf("miss: %lld\n", (long long)miss);
+  oprintf("time: %.3f\n", etime - stime);
+  oprintf("repairing records:\n");
+  stime = kc::time();
+  for (int64_t i = 1; !err && i <= rnum; i++) {
+    char kbuf[RECBUFSIZ];
+    size_t ksiz = std::sprintf(kbuf, "%08lld", (long long)i);
+    char vbuf[RECBUFSIZ];
+    size_t vsiz = makevalue(i, vbuf);
+    if (!db.set(kbuf, ksiz, vbuf, vsiz)) {
+      dberrprint(&db, __LINE__, "DB::set");
+      err = true;
+    }
+  }
+  if (!db.merge()) {
+    dberrprint(&db, __LINE__, "DB::merge");
+    err = true;
+  }
+  if (!db.close()) {
+    dberrprint(&db, __LINE__, "DB::close");
+    err = true;
+  }
+  if (!db.open(path, kc::CaskDB::OREADER)) {
+    dberrprint(&db, __LINE__, "DB::open");
+    err = true;
+  }
+  status.clear();
+  if (!db.status(&status) || kc::atoi(status["recovered"].c_str()) > 0) {
+    dberrprint(&db, __LINE__, "DB::status");
+    err = true;
+  }
+  for (int64_t i = 1; !err && i <= rnum; i++) {
+    char kbuf[RECBUFSIZ];
+    size_t ksiz = std::sprintf(kbuf, "%08lld", (long long)i);
+    char vbuf[RECBUFSIZ];
+    size_t vsiz = makevalue(i, vbuf);
+    size_t rsiz;
+    char* rbuf = db.get(kbuf, ksiz, &rsiz);
+    if (!rbuf || rsiz != vsiz || std::memcmp(rbuf, vbuf, vsiz)) {
+      dberrprint(&db, __LINE__, "DB::get");
+      err = true;
+    }
+    delete[] rbuf;
+  }
+  if (!err && db.count() != rnum) {
+    dberrprint(&db, __LINE__, "DB::count");
+    err = true;
+  }
+  etime = kc::time();
+  dbmetaprint(&db, true);
+  oprintf("time: %.3f\n", etime - stime);
+  oprintf("closing the database:\n");
+  stime = kc::time();
+  if (!db.close()) {
+    dberrprint(&db, __LINE__, "DB::close");
+    err = true;
+  }
+  etime = kc::time();
+  oprintf("time: %.3f\n", etime - stime);
+  oprintf("%s\n\n", err ? "error" : "ok");
+  return err ? 1 : 0;
+}
+
+
+
+// END OF FILE
@@ -53,10 +53,8 @@ class LexicalComparator : public Comparator {
   int32_t compare(const char* akbuf, size_t aksiz, const char* bkbuf, size_t bksiz) {
     _assert_(akbuf && bkbuf);
     size_t msiz = aksiz < bksiz ? aksiz : bksiz;
-    for (size_t i = 0; i < msiz; i++) {
-      if (((uint8_t*)akbuf)[i] != ((uint8_t*)bkbuf)[i])
-        return ((uint8_t*)akbuf)[i] - ((uint8_t*)bkbuf)[i];
-    }
+    int32_t rv = std::memcmp(akbuf, bkbuf, msiz);
+    if (rv != 0) return rv;
     return (int32_t)aksiz - (int32_t)bksiz;
   }
 };
@@ -26,6 +26,20 @@ const char* const DB::Visitor::NOP = (const char*)0;
 const char* const DB::Visitor::REMOVE = (const char*)1;
 
 
+/**
+ * Prepared pointer of the merge operator to add numbers.
+ */
+AdditionMergeOperator additionmergefunc;
+AdditionMergeOperator* const ADDITIONMERGE = &additionmergefunc;
+
+
+/**
+ * Prepared pointer of the merge operator to concatenate values.
+ */
+ConcatenationMergeOperator concatmergefunc;
+ConcatenationMergeOperator* const CONCATMERGE = &concatmergefunc;
+
+
 }                                        // common namespace
 
 // END OF FILE
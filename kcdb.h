@@ -25,10 +25,106 @@
 #include <kcmap.h>
 
 #define KCDBSSMAGICDATA  "KCSS\n"        ///< The magic data of the snapshot file
+#define KCDBSBMAGICDATA  "KCSB\n"        ///< The magic data of the block snapshot file
 
 namespace kyotocabinet {                 // common namespace
 
 
+/**
+ * Interface of merge operators.
+ * @note A merge operator folds an operand into the value of a record.  A database may keep
+ * operands without reading the existing value and apply them later, so the operation must
+ * depend only on its arguments.
+ */
+class MergeOperator {
+ public:
+  /**
+   * Destructor.
+   */
+  virtual ~MergeOperator() {
+    _assert_(true);
+  }
+  /**
+   * Merge an operand into a value.
+   * @param kbuf the pointer to the key region.
+   * @param ksiz the size of the key region.
+   * @param vbuf the pointer to the region of the existing value, or NULL if the record does
+   * not exist.
+   * @param vsiz the size of the region of the existing value.
+   * @param obuf the pointer to the operand region.
+   * @param osiz the size of the operand region.
+   * @param sp the pointer to the variable into which the size of the region of the return
+   * value is assigned.
+   * @return the pointer to the region of the merged value.
+   * @note Because the region of the return value is allocated with the the new[] operator, it
+   * should be released with the delete[] operator when it is no longer in use.
+   */
+  virtual char* merge(const char* kbuf, size_t ksiz, const char* vbuf, size_t vsiz,
+                      const char* obuf, size_t osiz, size_t* sp) = 0;
+};
+
+
+/**
+ * Merge operator to add numbers.
+ * @note The value and the operand are serialized as 8-byte binary integers in big-endian order
+ * as with the DB::increment method.  A region whose size is not 8 is regarded as zero.
+ */
+class AdditionMergeOperator : public MergeOperator {
+ public:
+  char* merge(const char* kbuf, size_t ksiz, const char* vbuf, size_t vsiz,
+              const char* obuf, size_t osiz, size_t* sp) {
+    _assert_(kbuf && ksiz <= MEMMAXSIZ && vsiz <= MEMMAXSIZ && obuf && osiz <= MEMMAXSIZ && sp);
+    int64_t num = 0;
+    if (vbuf && vsiz == sizeof(num)) {
+      std::memcpy(&num, vbuf, sizeof(num));
+      num = ntoh64(num);
+    }
+    if (osiz == sizeof(num)) {
+      int64_t onum;
+      std::memcpy(&onum, obuf, sizeof(onum));
+      num += (int64_t)ntoh64(onum);
+    }
+    char* rbuf = new char[sizeof(num)];
+    num = hton64(num);
+    std::memcpy(rbuf, &num, sizeof(num));
+    *sp = sizeof(num);
+    return rbuf;
+  }
+};
+
+
+/**
+ * Merge operator to concatenate values.
+ * @note The operand is appended at the end of the value as with the DB::append method.
+ */
+class ConcatenationMergeOperator : public MergeOperator {
+ public:
+  char* merge(const char* kbuf, size_t ksiz, const char* vbuf, size_t vsiz,
+              const char* obuf, size_t osiz, size_t* sp) {
+    _assert_(kbuf && ksiz <= MEMMAXSIZ && vsiz <= MEMMAXSIZ && obuf && osiz <= MEMMAXSIZ && sp);
+    if (!vbuf) vsiz = 0;
+    size_t rsiz = vsiz + osiz;
+    char* rbuf = new char[rsiz+1];
+    if (vsiz > 0) std::memcpy(rbuf, vbuf, vsiz);
+    std::memcpy(rbuf + vsiz, obuf, osiz);
+    *sp = rsiz;
+    return rbuf;
+  }
+};
+
+
+/**
+ * Prepared pointer of the merge operator to add numbers.
+ */
+extern AdditionMergeOperator* const ADDITIONMERGE;
+
+
+/**
+ * Prepared pointer of the merge operator to concatenate values.
+ */
+extern ConcatenationMergeOperator* const CONCATMERGE;
+
+
 /**
  * Interface of database abstraction.
  * @note This class is an abstract class to prescribe the interface of record access.
@@ -470,9 +566,21 @@ class BasicDB : public DB {
   class FileProcessor;
   class Logger;
   class MetaTrigger;
+  class Metrics;
+  class CacheManager;
  private:
   /** The size of the IO buffer. */
   static const size_t IOBUFSIZ = 8192;
+  /** The default size of the raw data of each block of the block snapshot. */
+  static const int64_t SBBLKSIZ = 1LL << 20;
+  /** The size of the header of each block of the block snapshot. */
+  static const size_t SBHEADSIZ = 16;
+  /** The size of the trailer of the block snapshot. */
+  static const size_t SBTRAILSIZ = 32;
+  /** The flag of the block snapshot whose records are in the lexical order. */
+  static const uint64_t SBFORDERED = 1 << 0;
+  class SnapshotDumpQueue;
+  class SnapshotLoadQueue;
  public:
   /**
    * Database types.
@@ -488,6 +596,8 @@ class BasicDB : public DB {
     TYPETREE = 0x31,                     ///< file tree database
     TYPEDIR = 0x40,                      ///< directory hash database
     TYPEFOREST = 0x41,                   ///< directory tree database
+    TYPELTREE = 0x42,                    ///< log-structured tree database
+    TYPECASK = 0x43,                     ///< log-structured hash database
     TYPEMISC = 0x80                      ///< miscellaneous database
   };
   /**
@@ -791,6 +901,54 @@ class BasicDB : public DB {
       if (!accept(&visitor, false, step)) return false;
       return visitor.ok();
     }
+    /**
+     * Accept a visitor to the current record and the following records.
+     * @param visitor a visitor object.
+     * @param max the maximum number of records to visit.
+     * @param writable true for writable operation, or false for read-only operation.
+     * @return the number of visited records, or -1 on failure.
+     * @note The cursor is moved forward over the visited records.  If the cursor reaches the
+     * end of the database, the result is less than the maximum and the cursor is invalidated.
+     * The default implementation calls the accept method for each record.  A concrete cursor
+     * may override it to read many records at once.
+     */
+    virtual int64_t accept_batch(Visitor* visitor, int64_t max, bool writable = false) {
+      _assert_(visitor);
+      int64_t cnt = 0;
+      while (cnt < max) {
+        if (!accept(visitor, writable, true)) {
+          if (error() == Error::NOREC) break;
+          return -1;
+        }
+        cnt++;
+      }
+      return cnt;
+    }
+    /**
+     * Get the current record and the following records.
+     * @param recs a vector to contain the pairs of the key and the value of the records.
+     * @param max the maximum number of records to retrieve.
+     * @return the number of retrieved records, or -1 on failure.
+     * @note The cursor is moved forward over the retrieved records.  The vector is not cleared
+     * and the records are appended at the end.
+     */
+    int64_t get_batch(std::vector<std::pair<std::string, std::string> >* recs, int64_t max) {
+      _assert_(recs);
+      class VisitorImpl : public Visitor {
+       public:
+        explicit VisitorImpl(std::vector<std::pair<std::string, std::string> >* recs) :
+            recs_(recs) {}
+       private:
+        const char* visit_full(const char* kbuf, size_t ksiz,
+                               const char* vbuf, size_t vsiz, size_t* sp) {
+          recs_->push_back(std::make_pair(std::string(kbuf, ksiz), std::string(vbuf, vsiz)));
+          return NOP;
+        }
+        std::vector<std::pair<std::string, std::string> >* recs_;
+      };
+      VisitorImpl visitor(recs);
+      return accept_batch(&visitor, max, false);
+    }
     /**
      * Get the database object.
      * @return the database object.
@@ -1046,6 +1204,518 @@ class BasicDB : public DB {
      */
     virtual void trigger(Kind kind, const char* message) = 0;
   };
+  /**
+   * Collector of runtime metrics.
+   * @note Counters and latency histograms are striped by the calling thread to avoid contention.
+   * Each database engine passes the names of its own counters to the constructor and reports
+   * them with the add method.
+   */
+  class Metrics {
+   public:
+    class ScopedTimer;
+    /**
+     * Measured operations.
+     */
+    enum Operation {
+      ACCEPT,                            ///< visiting a record
+      ITERATE,                           ///< iteration
+      SYNCHRONIZE,                       ///< synchronization
+      COMMITTRAN,                        ///< committing transaction
+      OPNUM                              ///< number of operations
+    };
+    /**
+     * Stopwatch to record the latency of an operation in its scope.
+     */
+    class ScopedTimer {
+     public:
+      /**
+       * Constructor.
+       * @param metrics the metrics collector.  If it is NULL, no measurement is performed.
+       * @param op the measured operation.
+       */
+      explicit ScopedTimer(Metrics* metrics, Operation op) :
+          metrics_(metrics), op_(op), stime_(metrics ? time() : 0) {
+        _assert_(true);
+      }
+      /**
+       * Destructor.
+       */
+      ~ScopedTimer() {
+        _assert_(true);
+        if (metrics_) metrics_->record(op_, time() - stime_);
+      }
+     private:
+      /** The metrics collector. */
+      Metrics* metrics_;
+      /** The measured operation. */
+      Operation op_;
+      /** The starting time. */
+      double stime_;
+    };
+    /**
+     * Default constructor.
+     * @param names an array of the names of additional counters.
+     * @param num the number of the additional counters.
+     */
+    explicit Metrics(const char* const* names = NULL, size_t num = 0) :
+        names_(names), cnum_(names ? num : 0), stime_(time()) {
+      _assert_(true);
+      for (size_t i = 0; i < STRIPENUM; i++) {
+        Stripe* stripe = stripes_ + i;
+        stripe->ccnts = cnum_ > 0 ? new AtomicInt64[cnum_] : NULL;
+      }
+    }
+    /**
+     * Destructor.
+     */
+    ~Metrics() {
+      _assert_(true);
+      for (size_t i = 0; i < STRIPENUM; i++) {
+        delete[] stripes_[i].ccnts;
+      }
+    }
+    /**
+     * Add a value to an additional counter.
+     * @param idx the index of the counter.
+     * @param num the additional value.
+     */
+    void add(size_t idx, int64_t num = 1) {
+      _assert_(idx < cnum_);
+      stripes_[stripe_index()].ccnts[idx] += num;
+    }
+    /**
+     * Record the latency of an operation.
+     * @param op the measured operation.
+     * @param sec the elapsed time in seconds.
+     */
+    void record(Operation op, double sec) {
+      _assert_(op < OPNUM);
+      int64_t usec = sec > 0 ? (int64_t)(sec * 1000000) : 0;
+      size_t hidx = 0;
+      while (hidx < HISTNUM - 1 && (usec >> hidx) > 0) {
+        hidx++;
+      }
+      Stripe* stripe = stripes_ + stripe_index();
+      stripe->lcnts[op][hidx] += 1;
+      stripe->lsums[op] += usec;
+      stripe->lmaxs[op].secure_least(usec);
+    }
+    /**
+     * Get the value of an additional counter.
+     * @param idx the index of the counter.
+     * @return the sum of the counter over all stripes.
+     */
+    int64_t get(size_t idx) const {
+      _assert_(idx < cnum_);
+      int64_t sum = 0;
+      for (size_t i = 0; i < STRIPENUM; i++) {
+        sum += stripes_[i].ccnts[idx];
+      }
+      return sum;
+    }
+    /**
+     * Get the miscellaneous status information.
+     * @param strmap a string map to contain the result.
+     * @note Each record is named with the prefix "mt_".  Latencies are in microseconds.
+     */
+    void status(std::map<std::string, std::string>* strmap) const {
+      _assert_(strmap);
+      const char* opnames[] = { "accept", "iterate", "synchronize", "commit" };
+      double etime = time() - stime_;
+      (*strmap)["mt_elapsed"] = strprintf("%.6f", etime);
+      for (size_t i = 0; i < OPNUM; i++) {
+        int64_t hist[HISTNUM];
+        std::memset(hist, 0, sizeof(hist));
+        int64_t cnt = 0;
+        int64_t sum = 0;
+        int64_t max = 0;
+        for (size_t j = 0; j < STRIPENUM; j++) {
+          const Stripe* stripe = stripes_ + j;
+          for (size_t k = 0; k < HISTNUM; k++) {
+            int64_t num = stripe->lcnts[i][k];
+            hist[k] += num;
+            cnt += num;
+          }
+          sum += stripe->lsums[i];
+          int64_t smax = stripe->lmaxs[i];
+          if (smax > max) max = smax;
+        }
+        std::string prefix = strprintf("mt_%s_", opnames[i]);
+        (*strmap)[prefix + "count"] = strprintf("%lld", (long long)cnt);
+        (*strmap)[prefix + "qps"] = strprintf("%.3f", etime > 0 ? cnt / etime : 0.0);
+        (*strmap)[prefix + "mean"] = strprintf("%.3f", cnt > 0 ? (double)sum / cnt : 0.0);
+        (*strmap)[prefix + "p50"] = strprintf("%lld", (long long)percentile(hist, cnt, max, 0.5));
+        (*strmap)[prefix + "p99"] =
+            strprintf("%lld", (long long)percentile(hist, cnt, max, 0.99));
+        (*strmap)[prefix + "p999"] =
+            strprintf("%lld", (long long)percentile(hist, cnt, max, 0.999));
+        (*strmap)[prefix + "max"] = strprintf("%lld", (long long)max);
+      }
+      for (size_t i = 0; i < cnum_; i++) {
+        (*strmap)[std::string("mt_") + names_[i]] = strprintf("%lld", (long long)get(i));
+      }
+    }
+    /**
+     * Reset all counters and histograms.
+     */
+    void reset() {
+      _assert_(true);
+      for (size_t i = 0; i < STRIPENUM; i++) {
+        Stripe* stripe = stripes_ + i;
+        for (size_t j = 0; j < OPNUM; j++) {
+          for (size_t k = 0; k < HISTNUM; k++) {
+            stripe->lcnts[j][k] = 0;
+          }
+          stripe->lsums[j] = 0;
+          stripe->lmaxs[j] = 0;
+        }
+        for (size_t j = 0; j < cnum_; j++) {
+          stripe->ccnts[j] = 0;
+        }
+      }
+      stime_ = time();
+    }
+   private:
+    /** The number of stripes. */
+    static const size_t STRIPENUM = 16;
+    /** The number of buckets of each latency histogram. */
+    static const size_t HISTNUM = 40;
+    /**
+     * Counters of a stripe.
+     */
+    struct Stripe {
+      AtomicInt64 lcnts[OPNUM][HISTNUM]; ///< latency histograms
+      AtomicInt64 lsums[OPNUM];          ///< sums of latencies
+      AtomicInt64 lmaxs[OPNUM];          ///< maximum latencies
+      AtomicInt64* ccnts;                ///< additional counters
+      char pad[64];                      ///< padding against false sharing
+    };
+    /**
+     * Get the index of the stripe of the current thread.
+     */
+    static size_t stripe_index() {
+      _assert_(true);
+      uint64_t id = Thread::hash();
+      return hashmurmur(&id, sizeof(id)) % STRIPENUM;
+    }
+    /**
+     * Estimate a percentile of a histogram.
+     */
+    static int64_t percentile(const int64_t* hist, int64_t cnt, int64_t max, double ratio) {
+      _assert_(hist && cnt >= 0 && ratio >= 0);
+      if (cnt < 1) return 0;
+      int64_t goal = (int64_t)std::ceil(cnt * ratio);
+      if (goal < 1) goal = 1;
+      int64_t sum = 0;
+      for (size_t i = 0; i < HISTNUM; i++) {
+        sum += hist[i];
+        if (sum >= goal) {
+          int64_t hval = ((int64_t)1 << i) - 1;
+          return hval < max ? hval : max;
+        }
+      }
+      return max;
+    }
+    /** Dummy constructor to forbid the use. */
+    Metrics(const Metrics&);
+    /** Dummy Operator to forbid the use. */
+    Metrics& operator =(const Metrics&);
+    /** The names of additional counters. */
+    const char* const* names_;
+    /** The number of additional counters. */
+    size_t cnum_;
+    /** The stripes of counters. */
+    Stripe stripes_[STRIPENUM];
+    /** The time of starting measurement. */
+    double stime_;
+  };
+  /**
+   * Manager of a memory budget shared by the caches of databases.
+   * @note Each database registered with the manager holds a slot whose quota is a part of the
+   * global budget.  The quotas are redistributed periodically by the marginal utility of memory
+   * of each cache, which is estimated by the recent cache misses per byte of the quota of the
+   * caches filled up to the quota.  The manager must outlive every database registered with it.
+   */
+  class CacheManager {
+   public:
+    class Slot;
+    /**
+     * Share of the budget held by a database.
+     */
+    class Slot {
+      friend class CacheManager;
+     public:
+      /**
+       * Record a cache hit.
+       */
+      void hit() {
+        _assert_(true);
+        hits_ += 1;
+        mgr_->tick();
+      }
+      /**
+       * Record a cache miss.
+       */
+      void miss() {
+        _assert_(true);
+        misses_ += 1;
+        mgr_->tick();
+      }
+      /**
+       * Set the current memory usage of the cache.
+       * @param usage the memory usage in bytes.
+       */
+      void set_usage(int64_t usage) {
+        _assert_(true);
+        usage_.set(usage);
+      }
+      /**
+       * Add a difference to the current memory usage of the cache.
+       * @param diff the difference in bytes.
+       */
+      void add_usage(int64_t diff) {
+        _assert_(true);
+        usage_.add(diff);
+      }
+      /**
+       * Get the quota of the cache.
+       * @return the quota in bytes.
+       */
+      int64_t quota() const {
+        _assert_(true);
+        return quota_.get();
+      }
+      /**
+       * Get the current memory usage of the cache.
+       * @return the memory usage in bytes.
+       */
+      int64_t usage() const {
+        _assert_(true);
+        return usage_.get();
+      }
+      /**
+       * Get the number of cache hits.
+       * @return the number of cache hits.
+       */
+      int64_t hits() const {
+        _assert_(true);
+        return hits_.get();
+      }
+      /**
+       * Get the number of cache misses.
+       * @return the number of cache misses.
+       */
+      int64_t misses() const {
+        _assert_(true);
+        return misses_.get();
+      }
+      /**
+       * Get the name of the slot.
+       * @return the name of the slot.
+       */
+      const std::string& name() const {
+        _assert_(true);
+        return name_;
+      }
+     private:
+      /** constructor */
+      explicit Slot(CacheManager* mgr, const std::string& name, int64_t quota) :
+          mgr_(mgr), name_(name), quota_(), usage_(), hits_(), misses_(),
+          lmisses_(0), wmisses_(0) {
+        _assert_(mgr);
+        quota_.set(quota);
+      }
+      /** Dummy constructor to forbid the use. */
+      Slot(const Slot&);
+      /** Dummy Operator to forbid the use. */
+      Slot& operator =(const Slot&);
+      /** The owner manager. */
+      CacheManager* mgr_;
+      /** The name. */
+      std::string name_;
+      /** The quota. */
+      AtomicInt64 quota_;
+      /** The memory usage. */
+      AtomicInt64 usage_;
+      /** The number of hits. */
+      AtomicInt64 hits_;
+      /** The number of misses. */
+      AtomicInt64 misses_;
+      /** The number of misses at the last rebalancing. */
+      int64_t lmisses_;
+      /** The decayed number of recent misses. */
+      double wmisses_;
+    };
+    /**
+     * Default constructor.
+     * @param budget the total size of memory shared by the registered caches.
+     */
+    explicit CacheManager(int64_t budget) :
+        lock_(), slots_(), budget_(budget > 0 ? budget : 1), opcnt_() {
+      _assert_(true);
+    }
+    /**
+     * Destructor.
+     */
+    ~CacheManager() {
+      _assert_(true);
+      std::vector<Slot*>::iterator it = slots_.begin();
+      std::vector<Slot*>::iterator itend = slots_.end();
+      while (it != itend) {
+        delete *it;
+        ++it;
+      }
+    }
+    /**
+     * Get the total budget.
+     * @return the total size of memory shared by the registered caches.
+     */
+    int64_t budget() const {
+      _assert_(true);
+      return budget_;
+    }
+    /**
+     * Register a cache.
+     * @param name the name of the cache.
+     * @return the slot of the cache.  The quotas of the existing slots are reduced in proportion
+     * to make room for the new slot.
+     */
+    Slot* attach(const std::string& name) {
+      _assert_(true);
+      ScopedMutex lock(&lock_);
+      int64_t num = slots_.size();
+      int64_t rest = budget_;
+      std::vector<Slot*>::iterator it = slots_.begin();
+      std::vector<Slot*>::iterator itend = slots_.end();
+      while (it != itend) {
+        Slot* slot = *it;
+        int64_t quota = (int64_t)((double)slot->quota_.get() * num / (num + 1));
+        slot->quota_.set(quota);
+        rest -= quota;
+        ++it;
+      }
+      Slot* slot = new Slot(this, name, rest);
+      slots_.push_back(slot);
+      return slot;
+    }
+    /**
+     * Unregister a cache.
+     * @param slot the slot of the cache.  It is released and its quota is distributed to the
+     * other slots.
+     */
+    void detach(Slot* slot) {
+      _assert_(slot);
+      ScopedMutex lock(&lock_);
+      std::vector<Slot*>::iterator it = std::find(slots_.begin(), slots_.end(), slot);
+      if (it == slots_.end()) return;
+      slots_.erase(it);
+      int64_t rest = slot->quota_.get();
+      delete slot;
+      int64_t num = slots_.size();
+      for (int64_t i = 0; i < num; i++) {
+        int64_t share = rest / (num - i);
+        slots_[i]->quota_.add(share);
+        rest -= share;
+      }
+    }
+    /**
+     * Redistribute the quotas by the recent cache statistics.
+     * @note It is called implicitly every some thousands of cache accesses.
+     */
+    void rebalance() {
+      _assert_(true);
+      ScopedMutex lock(&lock_);
+      rebalance_impl();
+    }
+    /**
+     * Get the miscellaneous status information.
+     * @param strmap a string map to contain the result.
+     * @note Each record is named with the prefix "cm_".  The attributes of each slot are named
+     * with the index of the slot.
+     */
+    void status(std::map<std::string, std::string>* strmap) {
+      _assert_(strmap);
+      ScopedMutex lock(&lock_);
+      (*strmap)["cm_budget"] = strprintf("%lld", (long long)budget_);
+      (*strmap)["cm_slots"] = strprintf("%lld", (long long)slots_.size());
+      for (size_t i = 0; i < slots_.size(); i++) {
+        Slot* slot = slots_[i];
+        std::string prefix = strprintf("cm_%d_", (int)i);
+        (*strmap)[prefix + "name"] = slot->name_;
+        (*strmap)[prefix + "quota"] = strprintf("%lld", (long long)slot->quota_.get());
+        (*strmap)[prefix + "usage"] = strprintf("%lld", (long long)slot->usage_.get());
+        (*strmap)[prefix + "hits"] = strprintf("%lld", (long long)slot->hits_.get());
+        (*strmap)[prefix + "misses"] = strprintf("%lld", (long long)slot->misses_.get());
+      }
+    }
+   private:
+    /** The number of cache accesses between rebalancing. */
+    static const int64_t RBLOPNUM = 4096;
+    /** The divisor of the budget to calculate the size moved at once. */
+    static const int64_t RBLSTEPDIV = 32;
+    /** The divisor of the even share to calculate the least quota. */
+    static const int64_t RBLFLOORDIV = 4;
+    /**
+     * Count a cache access and rebalance periodically.
+     */
+    void tick() {
+      _assert_(true);
+      if (opcnt_.add(1) % RBLOPNUM != RBLOPNUM - 1) return;
+      if (!lock_.lock_try()) return;
+      rebalance_impl();
+      lock_.unlock();
+    }
+    /**
+     * Redistribute the quotas without locking.
+     */
+    void rebalance_impl() {
+      _assert_(true);
+      int64_t num = slots_.size();
+      int64_t step = budget_ / RBLSTEPDIV;
+      if (step < 1) step = 1;
+      int64_t floor = num > 0 ? budget_ / (num * RBLFLOORDIV) : 0;
+      Slot* donor = NULL;
+      double dutil = 0;
+      Slot* taker = NULL;
+      double tutil = 0;
+      std::vector<Slot*>::iterator it = slots_.begin();
+      std::vector<Slot*>::iterator itend = slots_.end();
+      while (it != itend) {
+        Slot* slot = *it;
+        int64_t misses = slot->misses_.get();
+        slot->wmisses_ = slot->wmisses_ / 2 + (misses - slot->lmisses_);
+        slot->lmisses_ = misses;
+        int64_t quota = slot->quota_.get();
+        bool full = slot->usage_.get() >= quota - quota / 10;
+        double util = full ? slot->wmisses_ / (quota + 1) : 0.0;
+        if (full && util > 0 && (!taker || util > tutil)) {
+          taker = slot;
+          tutil = util;
+        }
+        if (quota - step >= floor && (!donor || util < dutil)) {
+          donor = slot;
+          dutil = util;
+        }
+        ++it;
+      }
+      if (taker && donor && taker != donor && tutil > dutil) {
+        donor->quota_.add(-step);
+        taker->quota_.add(step);
+      }
+    }
+    /** Dummy constructor to forbid the use. */
+    CacheManager(const CacheManager&);
+    /** Dummy Operator to forbid the use. */
+    CacheManager& operator =(const CacheManager&);
+    /** The mutex for the slots. */
+    Mutex lock_;
+    /** The registered slots. */
+    std::vector<Slot*> slots_;
+    /** The total budget. */
+    int64_t budget_;
+    /** The number of cache accesses. */
+    AtomicInt64 opcnt_;
+  };
   /**
    * Open modes.
    */
@@ -1060,6 +1730,15 @@ class BasicDB : public DB {
     OTRYLOCK = 1 << 7,                   ///< lock without blocking
     ONOREPAIR = 1 << 8                   ///< open without auto repair
   };
+  /**
+   * Compression codecs of the block snapshot.
+   */
+  enum SnapshotCodec {
+    SBCNONE = 0,                         ///< without compression
+    SBCZLIB = 1,                         ///< ZLIB raw compression
+    SBCLZO = 2,                          ///< LZO raw compression
+    SBCLZMA = 3                          ///< LZMA raw compression
+  };
   /**
    * Destructor.
    * @note If the database is not closed, it is closed implicitly.
@@ -1157,6 +1836,9 @@ class BasicDB : public DB {
    * @param dest the path of the destination file.
    * @param checker a progress checker object.  If it is NULL, no checking is performed.
    * @return true on success, or false on failure.
+   * @note Companion files beside the database file, such as the blob file of the file hash
+   * database, are copied together with the same suffixes.  Stale companion files of the
+   * destination are removed.
    */
   bool copy(const std::string& dest, ProgressChecker* checker = NULL) {
     _assert_(true);
@@ -1208,14 +1890,33 @@ class BasicDB : public DB {
           }
           return !err;
         }
+        if (!copy_file(path, dest_, size, checker_)) return false;
+        std::vector<std::string> exts;
+        exts.push_back("blob");
+        exts.push_back(std::string("blob") + File::EXTCHR + "tmpkch");
+        exts.push_back("idx");
+        bool err = false;
+        for (size_t i = 0; i < exts.size(); i++) {
+          const std::string& spath = path + File::EXTCHR + exts[i];
+          const std::string& dpath = dest_ + File::EXTCHR + exts[i];
+          if (File::status(spath)) {
+            if (!copy_file(spath, dpath, -1, NULL)) err = true;
+          } else if (File::status(dpath) && !File::remove(dpath)) {
+            err = true;
+          }
+        }
+        return !err;
+      }
+      bool copy_file(const std::string& path, const std::string& dest, int64_t size,
+                     ProgressChecker* checker) {
         std::ofstream ofs;
-        ofs.open(dest_.c_str(),
+        ofs.open(dest.c_str(),
                  std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
         if (!ofs) return false;
         bool err = false;
         std::ifstream ifs;
         ifs.open(path.c_str(), std::ios_base::in | std::ios_base::binary);
-        if (checker_ && !checker_->check("copy", "beginning", 0, size)) {
+        if (checker && !checker->check("copy", "beginning", 0, size)) {
           db_->set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
           err = true;
         }
@@ -1232,7 +1933,7 @@ class BasicDB : public DB {
               }
             }
             curcnt += n;
-            if (checker_ && !checker_->check("copy", "processing", curcnt, size)) {
+            if (checker && !checker->check("copy", "processing", curcnt, size)) {
               db_->set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
               err = true;
               break;
@@ -1243,7 +1944,7 @@ class BasicDB : public DB {
         } else {
           err = true;
         }
-        if (checker_ && !checker_->check("copy", "ending", -1, size)) {
+        if (checker && !checker->check("copy", "ending", -1, size)) {
           db_->set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
           err = true;
         }
@@ -1854,48 +2555,194 @@ class BasicDB : public DB {
     return vsiz;
   }
   /**
-   * Store records at once.
-   * @param recs the records to store.
-   * @param atomic true to perform all operations atomically, or false for non-atomic operations.
-   * @return the number of stored records, or -1 on failure.
+   * Retrieve a part of the value of a record.
+   * @param kbuf the pointer to the key region.
+   * @param ksiz the size of the key region.
+   * @param off the offset in the value where the part begins.
+   * @param vbuf the pointer to the buffer into which the part of the value is written.
+   * @param max the size of the buffer.
+   * @return the size of the written part, or -1 on failure.
+   * @note If no record corresponds to the key, -1 is returned.  If the offset is not less than
+   * the size of the value, 0 is returned.  The default implementation visits the whole value.
+   * A concrete database may override it to read only the part from the storage.
    */
-  int64_t set_bulk(const std::map<std::string, std::string>& recs, bool atomic = true) {
-    _assert_(true);
-    if (atomic) {
-      std::vector<std::string> keys;
-      keys.reserve(recs.size());
-      std::map<std::string, std::string>::const_iterator rit = recs.begin();
-      std::map<std::string, std::string>::const_iterator ritend = recs.end();
-      while (rit != ritend) {
-        keys.push_back(rit->first);
-        ++rit;
+  virtual int64_t get_range(const char* kbuf, size_t ksiz, int64_t off, char* vbuf, size_t max) {
+    _assert_(kbuf && ksiz <= MEMMAXSIZ && off >= 0 && vbuf);
+    class VisitorImpl : public Visitor {
+     public:
+      explicit VisitorImpl(int64_t off, char* vbuf, size_t max) :
+          off_(off), vbuf_(vbuf), max_(max), rsiz_(-1) {}
+      int64_t rsiz() {
+        return rsiz_;
       }
-      class VisitorImpl : public Visitor {
-       public:
-        explicit VisitorImpl(const std::map<std::string, std::string>& recs) : recs_(recs) {}
-       private:
-        const char* visit_full(const char* kbuf, size_t ksiz,
-                               const char* vbuf, size_t vsiz, size_t* sp) {
-          std::map<std::string, std::string>::const_iterator rit =
-              recs_.find(std::string(kbuf, ksiz));
-          if (rit == recs_.end()) return NOP;
-          *sp = rit->second.size();
-          return rit->second.data();
-        }
-        const char* visit_empty(const char* kbuf, size_t ksiz, size_t* sp) {
-          std::map<std::string, std::string>::const_iterator rit =
-              recs_.find(std::string(kbuf, ksiz));
-          if (rit == recs_.end()) return NOP;
-          *sp = rit->second.size();
-          return rit->second.data();
+     private:
+      const char* visit_full(const char* kbuf, size_t ksiz,
+                             const char* vbuf, size_t vsiz, size_t* sp) {
+        rsiz_ = 0;
+        if (off_ < (int64_t)vsiz) {
+          rsiz_ = std::min((int64_t)(vsiz - off_), (int64_t)max_);
+          std::memcpy(vbuf_, vbuf + off_, rsiz_);
         }
-        const std::map<std::string, std::string>& recs_;
-      };
-      VisitorImpl visitor(recs);
-      if (!accept_bulk(keys, &visitor, true)) return -1;
-      return keys.size();
+        return NOP;
+      }
+      int64_t off_;
+      char* vbuf_;
+      size_t max_;
+      int64_t rsiz_;
+    };
+    VisitorImpl visitor(off, vbuf, max);
+    if (!accept(kbuf, ksiz, &visitor, false)) return -1;
+    int64_t rsiz = visitor.rsiz();
+    if (rsiz < 0) {
+      set_error(_KCCODELINE_, Error::NOREC, "no record");
+      return -1;
     }
-    std::map<std::string, std::string>::const_iterator rit = recs.begin();
+    return rsiz;
+  }
+  /**
+   * Overwrite a part of the value of a record.
+   * @param kbuf the pointer to the key region.
+   * @param ksiz the size of the key region.
+   * @param off the offset in the value where the part begins.
+   * @param vbuf the pointer to the region of the part.
+   * @param vsiz the size of the region of the part.
+   * @return true on success, or false on failure.
+   * @note If no record corresponds to the key, a new record is created.  If the part goes
+   * beyond the end of the existing value, the value is extended and the gap between them is
+   * filled with zero.  The default implementation rewrites the whole value.  A concrete
+   * database may override it to write only the part into the storage.
+   */
+  virtual bool write_range(const char* kbuf, size_t ksiz, int64_t off,
+                           const char* vbuf, size_t vsiz) {
+    _assert_(kbuf && ksiz <= MEMMAXSIZ && off >= 0 && vbuf && vsiz <= MEMMAXSIZ);
+    class VisitorImpl : public Visitor {
+     public:
+      explicit VisitorImpl(int64_t off, const char* vbuf, size_t vsiz) :
+          off_(off), vbuf_(vbuf), vsiz_(vsiz), nbuf_(NULL) {}
+      ~VisitorImpl() {
+        if (nbuf_) delete[] nbuf_;
+      }
+     private:
+      const char* visit_full(const char* kbuf, size_t ksiz,
+                             const char* vbuf, size_t vsiz, size_t* sp) {
+        return merge(vbuf, vsiz, sp);
+      }
+      const char* visit_empty(const char* kbuf, size_t ksiz, size_t* sp) {
+        return merge("", 0, sp);
+      }
+      const char* merge(const char* vbuf, size_t vsiz, size_t* sp) {
+        size_t end = off_ + vsiz_;
+        size_t nsiz = vsiz > end ? vsiz : end;
+        nbuf_ = new char[nsiz];
+        std::memcpy(nbuf_, vbuf, vsiz);
+        if ((int64_t)vsiz < off_) std::memset(nbuf_ + vsiz, 0, off_ - vsiz);
+        std::memcpy(nbuf_ + off_, vbuf_, vsiz_);
+        *sp = nsiz;
+        return nbuf_;
+      }
+      int64_t off_;
+      const char* vbuf_;
+      size_t vsiz_;
+      char* nbuf_;
+    };
+    VisitorImpl visitor(off, vbuf, vsiz);
+    if (!accept(kbuf, ksiz, &visitor, true)) return false;
+    return true;
+  }
+  /**
+   * Merge an operand into the value of a record.
+   * @param kbuf the pointer to the key region.
+   * @param ksiz the size of the key region.
+   * @param obuf the pointer to the operand region.
+   * @param osiz the size of the operand region.
+   * @param mop the merge operator.
+   * @return true on success, or false on failure.
+   * @note The value of the record is replaced with the result of the merge operator applied to
+   * the existing value, or to NULL if no record corresponds to the key.  The default
+   * implementation applies the operator at once.  A concrete database may override it to store
+   * the operand and apply it when the record is read.
+   */
+  virtual bool merge_operand(const char* kbuf, size_t ksiz, const char* obuf, size_t osiz,
+                             MergeOperator* mop) {
+    _assert_(kbuf && ksiz <= MEMMAXSIZ && obuf && osiz <= MEMMAXSIZ && mop);
+    class VisitorImpl : public Visitor {
+     public:
+      explicit VisitorImpl(const char* obuf, size_t osiz, MergeOperator* mop) :
+          obuf_(obuf), osiz_(osiz), mop_(mop), nbuf_(NULL) {}
+      ~VisitorImpl() {
+        if (nbuf_) delete[] nbuf_;
+      }
+     private:
+      const char* visit_full(const char* kbuf, size_t ksiz,
+                             const char* vbuf, size_t vsiz, size_t* sp) {
+        nbuf_ = mop_->merge(kbuf, ksiz, vbuf, vsiz, obuf_, osiz_, sp);
+        return nbuf_;
+      }
+      const char* visit_empty(const char* kbuf, size_t ksiz, size_t* sp) {
+        nbuf_ = mop_->merge(kbuf, ksiz, NULL, 0, obuf_, osiz_, sp);
+        return nbuf_;
+      }
+      const char* obuf_;
+      size_t osiz_;
+      MergeOperator* mop_;
+      char* nbuf_;
+    };
+    VisitorImpl visitor(obuf, osiz, mop);
+    if (!accept(kbuf, ksiz, &visitor, true)) return false;
+    return true;
+  }
+  /**
+   * Merge an operand into the value of a record.
+   * @note Equal to the original DB::merge_operand method except that the parameters are
+   * std::string.
+   */
+  bool merge_operand(const std::string& key, const std::string& operand, MergeOperator* mop) {
+    _assert_(mop);
+    return merge_operand(key.c_str(), key.size(), operand.c_str(), operand.size(), mop);
+  }
+  /**
+   * Store records at once.
+   * @param recs the records to store.
+   * @param atomic true to perform all operations atomically, or false for non-atomic operations.
+   * @return the number of stored records, or -1 on failure.
+   */
+  int64_t set_bulk(const std::map<std::string, std::string>& recs, bool atomic = true) {
+    _assert_(true);
+    if (atomic) {
+      std::vector<std::string> keys;
+      keys.reserve(recs.size());
+      std::map<std::string, std::string>::const_iterator rit = recs.begin();
+      std::map<std::string, std::string>::const_iterator ritend = recs.end();
+      while (rit != ritend) {
+        keys.push_back(rit->first);
+        ++rit;
+      }
+      class VisitorImpl : public Visitor {
+       public:
+        explicit VisitorImpl(const std::map<std::string, std::string>& recs) : recs_(recs) {}
+       private:
+        const char* visit_full(const char* kbuf, size_t ksiz,
+                               const char* vbuf, size_t vsiz, size_t* sp) {
+          std::map<std::string, std::string>::const_iterator rit =
+              recs_.find(std::string(kbuf, ksiz));
+          if (rit == recs_.end()) return NOP;
+          *sp = rit->second.size();
+          return rit->second.data();
+        }
+        const char* visit_empty(const char* kbuf, size_t ksiz, size_t* sp) {
+          std::map<std::string, std::string>::const_iterator rit =
+              recs_.find(std::string(kbuf, ksiz));
+          if (rit == recs_.end()) return NOP;
+          *sp = rit->second.size();
+          return rit->second.data();
+        }
+        const std::map<std::string, std::string>& recs_;
+      };
+      VisitorImpl visitor(recs);
+      if (!accept_bulk(keys, &visitor, true)) return -1;
+      return keys.size();
+    }
+    std::map<std::string, std::string>::const_iterator rit = recs.begin();
     std::map<std::string, std::string>::const_iterator ritend = recs.end();
     while (rit != ritend) {
       if (!set(rit->first.data(), rit->first.size(), rit->second.data(), rit->second.size()))
@@ -2058,89 +2905,212 @@ class BasicDB : public DB {
    * @param src the source stream.
    * @param checker a progress checker object.  If it is NULL, no checking is performed.
    * @return true on success, or false on failure.
+   * @note Both of the plain snapshot format and the block snapshot format are accepted.
    */
   bool load_snapshot(std::istream* src, ProgressChecker* checker = NULL) {
     _assert_(src);
-    if (src->fail()) {
-      set_error(_KCCODELINE_, Error::INVALID, "invalid stream");
+    return load_snapshot_parallel(src, 1, checker);
+  }
+  /**
+   * Load records from a file.
+   * @param src the path of the source file.
+   * @param checker a progress checker object.  If it is NULL, no checking is performed.
+   * @return true on success, or false on failure.
+   */
+  bool load_snapshot(const std::string& src, ProgressChecker* checker = NULL) {
+    _assert_(true);
+    std::ifstream ifs;
+    ifs.open(src.c_str(), std::ios_base::in | std::ios_base::binary);
+    if (!ifs) {
+      set_error(_KCCODELINE_, Error::NOREPOS, "open failed");
       return false;
     }
-    char buf[IOBUFSIZ];
-    src->read(buf, sizeof(KCDBSSMAGICDATA));
-    if (src->fail()) {
-      set_error(_KCCODELINE_, Error::SYSTEM, "stream input error");
+    bool err = false;
+    if (!load_snapshot(&ifs, checker)) err = true;
+    ifs.close();
+    if (ifs.bad()) {
+      set_error(_KCCODELINE_, Error::SYSTEM, "close failed");
       return false;
     }
-    if (std::memcmp(buf, KCDBSSMAGICDATA, sizeof(KCDBSSMAGICDATA))) {
-      set_error(_KCCODELINE_, Error::INVALID, "invalid magic data of input stream");
+    return !err;
+  }
+  /**
+   * Dump records into a data stream in the block snapshot format.
+   * @param dest the destination stream.
+   * @param codec the compression codec: BasicDB::SBCNONE for no compression, BasicDB::SBCZLIB
+   * for ZLIB raw, BasicDB::SBCLZO for LZO raw, or BasicDB::SBCLZMA for LZMA raw.
+   * @param thnum the number of worker threads to compress blocks.
+   * @param bsiz the size of the raw data of each block.  If it is not more than 0, the default
+   * setting is specified.
+   * @param checker a progress checker object.  If it is NULL, no checking is performed.
+   * @return true on success, or false on failure.
+   * @note The block snapshot is a sequence of independently compressed blocks with checksums,
+   * followed by an index of the first key of each block.  If the records are visited in the
+   * lexical order of keys, the snapshot is marked as ordered so that load_snapshot_range can
+   * seek to a key range without decompressing the other blocks.  Both of load_snapshot and
+   * load_snapshot_parallel can read the format.
+   */
+  bool dump_snapshot_blocks(std::ostream* dest, uint32_t codec = SBCZLIB, size_t thnum = 1,
+                            int64_t bsiz = 0, ProgressChecker* checker = NULL) {
+    _assert_(dest && thnum <= MEMMAXSIZ);
+    if (dest->fail()) {
+      set_error(_KCCODELINE_, Error::INVALID, "invalid stream");
       return false;
     }
-    bool err = false;
-    if (checker && !checker->check("load_snapshot", "beginning", 0, -1)) {
-      set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
-      err = true;
+    if (codec > SBCLZMA) {
+      set_error(_KCCODELINE_, Error::INVALID, "unknown codec");
+      return false;
     }
-    int64_t curcnt = 0;
-    while (!err) {
-      int32_t c = src->get();
-      if (src->fail()) {
-        set_error(_KCCODELINE_, Error::SYSTEM, "stream input error");
-        err = true;
-        break;
+    if (thnum < 1) thnum = 1;
+    if (bsiz < 1) bsiz = SBBLKSIZ;
+    class VisitorImpl : public Visitor {
+     public:
+      explicit VisitorImpl(SnapshotDumpQueue* queue, int64_t bsiz) :
+          queue_(queue), bsiz_(bsiz), task_(NULL), lkey_(), cnt_(0), ordered_(true),
+          err_(false) {}
+      ~VisitorImpl() {
+        delete task_;
       }
-      if (c == 0xff) break;
-      if (c == 0x00) {
-        size_t ksiz = 0;
-        do {
-          c = src->get();
-          ksiz = (ksiz << 7) + (c & 0x7f);
-        } while (c >= 0x80);
-        size_t vsiz = 0;
-        do {
-          c = src->get();
-          vsiz = (vsiz << 7) + (c & 0x7f);
-        } while (c >= 0x80);
-        size_t rsiz = ksiz + vsiz;
-        char* rbuf = rsiz > sizeof(buf) ? new char[rsiz] : buf;
-        src->read(rbuf, ksiz + vsiz);
-        if (src->fail()) {
-          set_error(_KCCODELINE_, Error::SYSTEM, "stream input error");
-          err = true;
-          if (rbuf != buf) delete[] rbuf;
-          break;
+      bool finish() {
+        if (task_) {
+          if (!queue_->submit(task_)) err_ = true;
+          task_ = NULL;
         }
-        if (!set(rbuf, ksiz, rbuf + ksiz, vsiz)) {
-          err = true;
-          if (rbuf != buf) delete[] rbuf;
-          break;
-        }
-        if (rbuf != buf) delete[] rbuf;
-      } else {
-        set_error(_KCCODELINE_, Error::INVALID, "invalid magic data of input stream");
-        err = true;
-        break;
+        return !err_;
       }
-      curcnt++;
-      if (checker && !checker->check("load_snapshot", "processing", curcnt, -1)) {
-        set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
-        err = true;
-        break;
+      bool ordered() {
+        return ordered_;
       }
+     private:
+      const char* visit_full(const char* kbuf, size_t ksiz,
+                             const char* vbuf, size_t vsiz, size_t* sp) {
+        if (err_) return NOP;
+        if (ordered_) {
+          if (cnt_ > 0) {
+            size_t msiz = ksiz < lkey_.size() ? ksiz : lkey_.size();
+            int32_t rv = std::memcmp(kbuf, lkey_.data(), msiz);
+            if (rv < 0 || (rv == 0 && ksiz <= lkey_.size())) ordered_ = false;
+          }
+          lkey_.assign(kbuf, ksiz);
+        }
+        cnt_++;
+        if (!task_) {
+          task_ = new SnapshotDumpQueue::BlockTask;
+          task_->fkey.append(kbuf, ksiz);
+        }
+        char stack[NUMBUFSIZ*2];
+        char* wp = stack;
+        wp += writevarnum(wp, ksiz);
+        wp += writevarnum(wp, vsiz);
+        task_->raw.append(stack, wp - stack);
+        task_->raw.append(kbuf, ksiz);
+        task_->raw.append(vbuf, vsiz);
+        task_->rnum++;
+        if ((int64_t)task_->raw.size() >= bsiz_) {
+          if (!queue_->submit(task_)) err_ = true;
+          task_ = NULL;
+        }
+        return NOP;
+      }
+      SnapshotDumpQueue* queue_;
+      int64_t bsiz_;
+      SnapshotDumpQueue::BlockTask* task_;
+      std::string lkey_;
+      int64_t cnt_;
+      bool ordered_;
+      bool err_;
+    };
+    Compressor* comp = snapshot_compressor(codec);
+    SnapshotDumpQueue queue(comp, dest, thnum);
+    bool err = false;
+    char head[sizeof(KCDBSBMAGICDATA)+1];
+    std::memcpy(head, KCDBSBMAGICDATA, sizeof(KCDBSBMAGICDATA));
+    head[sizeof(KCDBSBMAGICDATA)] = codec;
+    dest->write(head, sizeof(head));
+    queue.start(thnum);
+    VisitorImpl visitor(&queue, bsiz);
+    if (!iterate(&visitor, false, checker)) err = true;
+    if (!visitor.finish()) err = true;
+    queue.finish();
+    if (!queue.flush(0)) err = true;
+    if (!err && !queue.write_index(visitor.ordered())) err = true;
+    if (!err && dest->fail()) {
+      set_error(_KCCODELINE_, Error::SYSTEM, "stream output error");
+      err = true;
+    } else if (queue.error() != Error::SUCCESS) {
+      set_error(_KCCODELINE_, queue.error(), queue.message());
+      err = true;
     }
-    if (checker && !checker->check("load_snapshot", "ending", -1, -1)) {
-      set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
+    delete comp;
+    return !err;
+  }
+  /**
+   * Dump records into a file in the block snapshot format.
+   * @param dest the path of the destination file.
+   * @param codec the compression codec: BasicDB::SBCNONE for no compression, BasicDB::SBCZLIB
+   * for ZLIB raw, BasicDB::SBCLZO for LZO raw, or BasicDB::SBCLZMA for LZMA raw.
+   * @param thnum the number of worker threads to compress blocks.
+   * @param bsiz the size of the raw data of each block.  If it is not more than 0, the default
+   * setting is specified.
+   * @param checker a progress checker object.  If it is NULL, no checking is performed.
+   * @return true on success, or false on failure.
+   */
+  bool dump_snapshot_blocks(const std::string& dest, uint32_t codec = SBCZLIB, size_t thnum = 1,
+                            int64_t bsiz = 0, ProgressChecker* checker = NULL) {
+    _assert_(thnum <= MEMMAXSIZ);
+    std::ofstream ofs;
+    ofs.open(dest.c_str(), std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+    if (!ofs) {
+      set_error(_KCCODELINE_, Error::NOREPOS, "open failed");
+      return false;
+    }
+    bool err = false;
+    if (!dump_snapshot_blocks(&ofs, codec, thnum, bsiz, checker)) err = true;
+    ofs.close();
+    if (!ofs) {
+      set_error(_KCCODELINE_, Error::SYSTEM, "close failed");
       err = true;
     }
     return !err;
   }
   /**
-   * Load records from a file.
+   * Load records from a data stream with multiple threads.
+   * @param src the source stream.
+   * @param thnum the number of worker threads to decompress and store blocks.
+   * @param checker a progress checker object.  If it is NULL, no checking is performed.
+   * @return true on success, or false on failure.
+   * @note Blocks of the block snapshot format are processed in parallel.  The plain snapshot
+   * format is loaded by the calling thread only.
+   */
+  bool load_snapshot_parallel(std::istream* src, size_t thnum, ProgressChecker* checker = NULL) {
+    _assert_(src && thnum <= MEMMAXSIZ);
+    if (src->fail()) {
+      set_error(_KCCODELINE_, Error::INVALID, "invalid stream");
+      return false;
+    }
+    char buf[sizeof(KCDBSSMAGICDATA)];
+    src->read(buf, sizeof(buf));
+    if (src->fail()) {
+      set_error(_KCCODELINE_, Error::SYSTEM, "stream input error");
+      return false;
+    }
+    if (!std::memcmp(buf, KCDBSSMAGICDATA, sizeof(KCDBSSMAGICDATA)))
+      return load_snapshot_plain(src, checker);
+    if (!std::memcmp(buf, KCDBSBMAGICDATA, sizeof(KCDBSBMAGICDATA)))
+      return load_snapshot_framed(src, thnum, checker);
+    set_error(_KCCODELINE_, Error::INVALID, "invalid magic data of input stream");
+    return false;
+  }
+  /**
+   * Load records from a file with multiple threads.
    * @param src the path of the source file.
+   * @param thnum the number of worker threads to decompress and store blocks.
    * @param checker a progress checker object.  If it is NULL, no checking is performed.
    * @return true on success, or false on failure.
    */
-  bool load_snapshot(const std::string& src, ProgressChecker* checker = NULL) {
-    _assert_(true);
+  bool load_snapshot_parallel(const std::string& src, size_t thnum,
+                              ProgressChecker* checker = NULL) {
+    _assert_(thnum <= MEMMAXSIZ);
     std::ifstream ifs;
     ifs.open(src.c_str(), std::ios_base::in | std::ios_base::binary);
     if (!ifs) {
@@ -2148,7 +3118,7 @@ class BasicDB : public DB {
       return false;
     }
     bool err = false;
-    if (!load_snapshot(&ifs, checker)) err = true;
+    if (!load_snapshot_parallel(&ifs, thnum, checker)) err = true;
     ifs.close();
     if (ifs.bad()) {
       set_error(_KCCODELINE_, Error::SYSTEM, "close failed");
@@ -2156,6 +3126,124 @@ class BasicDB : public DB {
     }
     return !err;
   }
+  /**
+   * Load records in a key range from a file in the block snapshot format.
+   * @param src the path of the source file.
+   * @param bkbuf the pointer to the lower bound key, inclusive.  If it is NULL, the range has no
+   * lower bound.
+   * @param bksiz the size of the lower bound key.
+   * @param ekbuf the pointer to the upper bound key, exclusive.  If it is NULL, the range has no
+   * upper bound.
+   * @param eksiz the size of the upper bound key.
+   * @param checker a progress checker object.  If it is NULL, no checking is performed.
+   * @return true on success, or false on failure.
+   * @note Keys are compared in the lexical order.  If the snapshot is ordered, only the blocks
+   * overlapping the range are read and decompressed.  Otherwise, every block is read.
+   */
+  bool load_snapshot_range(const std::string& src, const char* bkbuf, size_t bksiz,
+                           const char* ekbuf, size_t eksiz, ProgressChecker* checker = NULL) {
+    _assert_(bksiz <= MEMMAXSIZ && eksiz <= MEMMAXSIZ);
+    std::ifstream ifs;
+    ifs.open(src.c_str(), std::ios_base::in | std::ios_base::binary);
+    if (!ifs) {
+      set_error(_KCCODELINE_, Error::NOREPOS, "open failed");
+      return false;
+    }
+    char head[sizeof(KCDBSBMAGICDATA)+1];
+    ifs.read(head, sizeof(head));
+    if (ifs.fail() || std::memcmp(head, KCDBSBMAGICDATA, sizeof(KCDBSBMAGICDATA)) ||
+        (uint8_t)head[sizeof(KCDBSBMAGICDATA)] > SBCLZMA) {
+      set_error(_KCCODELINE_, Error::INVALID, "invalid magic data of input stream");
+      return false;
+    }
+    char tbuf[SBTRAILSIZ];
+    ifs.seekg(-(int64_t)SBTRAILSIZ, std::ios_base::end);
+    int64_t tail = ifs.tellg();
+    ifs.read(tbuf, sizeof(tbuf));
+    int64_t idxoff = readfixnum(tbuf, sizeof(uint64_t));
+    int64_t bnum = readfixnum(tbuf + sizeof(uint64_t), sizeof(uint64_t));
+    uint64_t flags = readfixnum(tbuf + sizeof(uint64_t) * 3, sizeof(uint64_t));
+    if (ifs.fail() || idxoff < (int64_t)sizeof(head) || idxoff > tail || bnum < 0) {
+      set_error(_KCCODELINE_, Error::BROKEN, "invalid trailer of the snapshot");
+      return false;
+    }
+    std::vector<int64_t> offs;
+    std::vector<std::string> fkeys;
+    ifs.seekg(idxoff);
+    for (int64_t i = 0; i < bnum; i++) {
+      char nbuf[sizeof(uint64_t)];
+      ifs.read(nbuf, sizeof(nbuf));
+      uint64_t ksiz = 0;
+      int32_t c;
+      do {
+        c = ifs.get();
+        ksiz = (ksiz << 7) + (c & 0x7f);
+      } while (c >= 0x80);
+      if (ifs.fail() || ksiz > (uint64_t)(tail - idxoff)) {
+        set_error(_KCCODELINE_, Error::BROKEN, "invalid index of the snapshot");
+        return false;
+      }
+      std::string fkey(ksiz, '\0');
+      if (ksiz > 0) ifs.read((char*)fkey.data(), ksiz);
+      offs.push_back(readfixnum(nbuf, sizeof(nbuf)));
+      fkeys.push_back(fkey);
+    }
+    if (ifs.fail()) {
+      set_error(_KCCODELINE_, Error::BROKEN, "invalid index of the snapshot");
+      return false;
+    }
+    std::string bkey = bkbuf ? std::string(bkbuf, bksiz) : std::string();
+    std::string ekey = ekbuf ? std::string(ekbuf, eksiz) : std::string();
+    int64_t bidx = 0;
+    if ((flags & SBFORDERED) && bkbuf) {
+      bidx = std::upper_bound(fkeys.begin(), fkeys.end(), bkey) - fkeys.begin() - 1;
+      if (bidx < 0) bidx = 0;
+    }
+    Compressor* comp = snapshot_compressor((uint8_t)head[sizeof(KCDBSBMAGICDATA)]);
+    bool err = false;
+    if (checker && !checker->check("load_snapshot_range", "beginning", 0, bnum)) {
+      set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
+      err = true;
+    }
+    int64_t curcnt = 0;
+    for (int64_t i = bidx; !err && i < bnum; i++) {
+      if ((flags & SBFORDERED) && ekbuf && fkeys[i] >= ekey) break;
+      ifs.seekg(offs[i]);
+      char hbuf[SBHEADSIZ];
+      ifs.read(hbuf, sizeof(hbuf));
+      uint32_t rsiz = readfixnum(hbuf + sizeof(uint32_t), sizeof(uint32_t));
+      uint32_t zsiz = readfixnum(hbuf + sizeof(uint32_t) * 2, sizeof(uint32_t));
+      uint32_t sum = readfixnum(hbuf + sizeof(uint32_t) * 3, sizeof(uint32_t));
+      if (ifs.fail() || zsiz > tail - offs[i]) {
+        set_error(_KCCODELINE_, Error::BROKEN, "invalid block of the snapshot");
+        err = true;
+        break;
+      }
+      char* zbuf = new char[zsiz+1];
+      ifs.read(zbuf, zsiz);
+      char* rbuf = ifs.fail() ? NULL : inflate_snapshot_block(comp, zbuf, zsiz, rsiz, sum);
+      delete[] zbuf;
+      if (!rbuf) {
+        set_error(_KCCODELINE_, Error::BROKEN, "invalid block of the snapshot");
+        err = true;
+        break;
+      }
+      if (!store_snapshot_block(rbuf, rsiz, bkbuf ? &bkey : NULL, ekbuf ? &ekey : NULL))
+        err = true;
+      delete[] rbuf;
+      curcnt++;
+      if (!err && checker && !checker->check("load_snapshot_range", "processing", curcnt, bnum)) {
+        set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
+        err = true;
+      }
+    }
+    delete comp;
+    if (checker && !checker->check("load_snapshot_range", "ending", -1, -1)) {
+      set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
+      err = true;
+    }
+    return !err;
+  }
   /**
    * Create a cursor object.
    * @return the return value is the created cursor object.
@@ -2196,6 +3284,8 @@ class BasicDB : public DB {
       case TYPETREE: return "TreeDB";
       case TYPEDIR: return "DirDB";
       case TYPEFOREST: return "ForestDB";
+      case TYPELTREE: return "LogTreeDB";
+      case TYPECASK: return "CaskDB";
       case TYPEMISC: return "misc";
     }
     return "unknown";
@@ -2218,10 +3308,549 @@ class BasicDB : public DB {
       case TYPETREE: return "file tree database";
       case TYPEDIR: return "directory hash database";
       case TYPEFOREST: return "directory tree database";
+      case TYPELTREE: return "log-structured tree database";
+      case TYPECASK: return "log-structured hash database";
       case TYPEMISC: return "miscellaneous database";
     }
     return "unknown";
   }
+ protected:
+  /**
+   * Store the statistics of sizes into a status map.
+   * @param name the prefix of the keys.
+   * @param sizes the sizes to be sorted.
+   * @param strmap a string map to contain the result.
+   */
+  static void store_size_stats(const char* name, std::vector<int64_t>* sizes,
+                               std::map<std::string, std::string>* strmap) {
+    _assert_(name && sizes && strmap);
+    size_t num = sizes->size();
+    int64_t sum = 0;
+    for (size_t i = 0; i < num; i++) {
+      sum += (*sizes)[i];
+    }
+    std::sort(sizes->begin(), sizes->end());
+    (*strmap)[strprintf("%s_mean", name)] = strprintf("%.3f", num > 0 ? (double)sum / num : 0.0);
+    (*strmap)[strprintf("%s_p50", name)] =
+        strprintf("%lld", num > 0 ? (long long)(*sizes)[num/2] : 0LL);
+    (*strmap)[strprintf("%s_p99", name)] =
+        strprintf("%lld", num > 0 ? (long long)(*sizes)[num*99/100] : 0LL);
+    (*strmap)[strprintf("%s_max", name)] =
+        strprintf("%lld", num > 0 ? (long long)(*sizes)[num-1] : 0LL);
+  }
+ private:
+  /**
+   * Task queue to compress blocks of the block snapshot and to write them in order.
+   */
+  class SnapshotDumpQueue : public TaskQueue {
+   public:
+    /**
+     * Block of serialized records.
+     */
+    class BlockTask : public Task {
+     public:
+      explicit BlockTask() :
+          raw(), fkey(), rnum(0), zbuf(NULL), zsiz(0), sum(0), done(false), failed(false) {}
+      ~BlockTask() {
+        delete[] zbuf;
+      }
+      std::string raw;                   ///< serialized records
+      std::string fkey;                  ///< first key
+      uint32_t rnum;                     ///< number of records
+      char* zbuf;                        ///< compressed data
+      size_t zsiz;                       ///< size of the compressed data
+      uint32_t sum;                      ///< checksum of the serialized records
+      bool done;                         ///< whether the task has been processed
+      bool failed;                       ///< whether the compression failed
+    };
+    explicit SnapshotDumpQueue(Compressor* comp, std::ostream* dest, size_t thnum) :
+        comp_(comp), dest_(dest), limit_(thnum * 2), lock_(), pending_(), offs_(), fkeys_(),
+        off_(sizeof(KCDBSBMAGICDATA) + 1), rcnt_(0), ecode_(Error::SUCCESS), emsg_("no error") {}
+    ~SnapshotDumpQueue() {
+      std::list<BlockTask*>::iterator it = pending_.begin();
+      std::list<BlockTask*>::iterator itend = pending_.end();
+      while (it != itend) {
+        delete *it;
+        ++it;
+      }
+    }
+    /** submit a filled block */
+    bool submit(BlockTask* task) {
+      pending_.push_back(task);
+      add_task(task);
+      return flush(limit_);
+    }
+    /** write processed blocks in order until the number of pending ones is within a limit */
+    bool flush(size_t limit) {
+      while (!pending_.empty()) {
+        BlockTask* task = pending_.front();
+        lock_.lock();
+        bool done = task->done;
+        lock_.unlock();
+        if (!done) {
+          if (pending_.size() <= limit) break;
+          Thread::sleep(1.0 / CLOCKTICK);
+          continue;
+        }
+        pending_.pop_front();
+        bool ok = write_block(task);
+        delete task;
+        if (!ok) return false;
+      }
+      return true;
+    }
+    /** write the terminator, the index, and the trailer */
+    bool write_index(bool ordered) {
+      char hbuf[SBHEADSIZ];
+      std::memset(hbuf, 0, sizeof(hbuf));
+      dest_->write(hbuf, sizeof(hbuf));
+      int64_t idxoff = off_ + sizeof(hbuf);
+      for (size_t i = 0; i < offs_.size(); i++) {
+        char nbuf[sizeof(uint64_t)+NUMBUFSIZ];
+        writefixnum(nbuf, offs_[i], sizeof(uint64_t));
+        size_t nsiz = sizeof(uint64_t) + writevarnum(nbuf + sizeof(uint64_t), fkeys_[i].size());
+        dest_->write(nbuf, nsiz);
+        dest_->write(fkeys_[i].data(), fkeys_[i].size());
+      }
+      char tbuf[SBTRAILSIZ];
+      writefixnum(tbuf, idxoff, sizeof(uint64_t));
+      writefixnum(tbuf + sizeof(uint64_t), offs_.size(), sizeof(uint64_t));
+      writefixnum(tbuf + sizeof(uint64_t) * 2, rcnt_, sizeof(uint64_t));
+      writefixnum(tbuf + sizeof(uint64_t) * 3, ordered ? SBFORDERED : 0, sizeof(uint64_t));
+      dest_->write(tbuf, sizeof(tbuf));
+      if (dest_->fail()) {
+        ecode_ = Error::SYSTEM;
+        emsg_ = "stream output error";
+        return false;
+      }
+      return true;
+    }
+    /** get the error code */
+    Error::Code error() const {
+      return ecode_;
+    }
+    /** get the error message */
+    const char* message() const {
+      return emsg_;
+    }
+   private:
+    /** compress a block */
+    void do_task(Task* task) {
+      BlockTask* btask = (BlockTask*)task;
+      uint32_t sum = hashmurmur(btask->raw.data(), btask->raw.size());
+      char* zbuf = NULL;
+      size_t zsiz = 0;
+      if (comp_) zbuf = comp_->compress(btask->raw.data(), btask->raw.size(), &zsiz);
+      ScopedMutex lock(&lock_);
+      btask->sum = sum;
+      btask->zbuf = zbuf;
+      btask->zsiz = zsiz;
+      btask->failed = comp_ && !zbuf;
+      btask->done = true;
+    }
+    /** write a processed block */
+    bool write_block(BlockTask* task) {
+      if (ecode_ != Error::SUCCESS) return false;
+      if (task->failed) {
+        ecode_ = Error::SYSTEM;
+        emsg_ = "compression failed";
+        return false;
+      }
+      const char* zbuf = task->zbuf ? task->zbuf : task->raw.data();
+      size_t zsiz = task->zbuf ? task->zsiz : task->raw.size();
+      if (task->raw.size() > INT32MAX || zsiz > INT32MAX) {
+        ecode_ = Error::LOGIC;
+        emsg_ = "too large block";
+        return false;
+      }
+      char hbuf[SBHEADSIZ];
+      writefixnum(hbuf, task->rnum, sizeof(uint32_t));
+      writefixnum(hbuf + sizeof(uint32_t), task->raw.size(), sizeof(uint32_t));
+      writefixnum(hbuf + sizeof(uint32_t) * 2, zsiz, sizeof(uint32_t));
+      writefixnum(hbuf + sizeof(uint32_t) * 3, task->sum, sizeof(uint32_t));
+      dest_->write(hbuf, sizeof(hbuf));
+      dest_->write(zbuf, zsiz);
+      if (dest_->fail()) {
+        ecode_ = Error::SYSTEM;
+        emsg_ = "stream output error";
+        return false;
+      }
+      offs_.push_back(off_);
+      fkeys_.push_back(task->fkey);
+      off_ += sizeof(hbuf) + zsiz;
+      rcnt_ += task->rnum;
+      return true;
+    }
+    Compressor* comp_;                   ///< compressor or NULL
+    std::ostream* dest_;                 ///< destination stream
+    size_t limit_;                       ///< maximum number of pending blocks
+    Mutex lock_;                         ///< lock for the task states
+    std::list<BlockTask*> pending_;     ///< pending blocks in the order of submission
+    std::vector<int64_t> offs_;          ///< offsets of written blocks
+    std::vector<std::string> fkeys_;     ///< first keys of written blocks
+    int64_t off_;                        ///< current offset
+    int64_t rcnt_;                       ///< number of written records
+    Error::Code ecode_;                  ///< error code
+    const char* emsg_;                   ///< error message
+  };
+  /**
+   * Task queue to decompress blocks of the block snapshot and to store their records.
+   */
+  class SnapshotLoadQueue : public TaskQueue {
+   public:
+    /**
+     * Block of compressed records.
+     */
+    class BlockTask : public Task {
+     public:
+      explicit BlockTask(char* zbuf, size_t zsiz, uint32_t rsiz, uint32_t sum) :
+          zbuf(zbuf), zsiz(zsiz), rsiz(rsiz), sum(sum) {}
+      ~BlockTask() {
+        delete[] zbuf;
+      }
+      char* zbuf;                        ///< compressed data
+      size_t zsiz;                       ///< size of the compressed data
+      uint32_t rsiz;                     ///< size of the serialized records
+      uint32_t sum;                      ///< checksum of the serialized records
+    };
+    explicit SnapshotLoadQueue(BasicDB* db, Compressor* comp) :
+        db_(db), comp_(comp), lock_(), ecode_(Error::SUCCESS), emsg_("no error") {}
+    /** check whether an error has happened */
+    bool failed() {
+      ScopedMutex lock(&lock_);
+      return ecode_ != Error::SUCCESS;
+    }
+    /** get the error code */
+    Error::Code error() {
+      ScopedMutex lock(&lock_);
+      return ecode_;
+    }
+    /** get the error message */
+    const char* message() {
+      ScopedMutex lock(&lock_);
+      return emsg_;
+    }
+   private:
+    /** decompress a block and store the records */
+    void do_task(Task* task) {
+      BlockTask* btask = (BlockTask*)task;
+      if (!failed()) {
+        char* rbuf = inflate_snapshot_block(comp_, btask->zbuf, btask->zsiz,
+                                            btask->rsiz, btask->sum);
+        if (rbuf) {
+          if (!db_->store_snapshot_block(rbuf, btask->rsiz, NULL, NULL)) {
+            const Error& e = db_->error();
+            set_error(e.code(), e.message());
+          }
+          delete[] rbuf;
+        } else {
+          set_error(Error::BROKEN, "invalid block of the snapshot");
+        }
+      }
+      delete btask;
+    }
+    /** record the first error */
+    void set_error(Error::Code code, const char* message) {
+      ScopedMutex lock(&lock_);
+      if (ecode_ != Error::SUCCESS) return;
+      ecode_ = code;
+      emsg_ = message;
+    }
+    BasicDB* db_;                        ///< database
+    Compressor* comp_;                   ///< compressor or NULL
+    Mutex lock_;                         ///< lock for the error state
+    Error::Code ecode_;                  ///< error code
+    const char* emsg_;                   ///< error message
+  };
+  /**
+   * Load records from a data stream in the plain snapshot format.
+   * @param src the source stream, whose magic data has been read.
+   * @param checker a progress checker object.  If it is NULL, no checking is performed.
+   * @return true on success, or false on failure.
+   */
+  bool load_snapshot_plain(std::istream* src, ProgressChecker* checker) {
+    _assert_(src);
+    char buf[IOBUFSIZ];
+    bool err = false;
+    if (checker && !checker->check("load_snapshot", "beginning", 0, -1)) {
+      set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
+      err = true;
+    }
+    int64_t curcnt = 0;
+    while (!err) {
+      int32_t c = src->get();
+      if (src->fail()) {
+        set_error(_KCCODELINE_, Error::SYSTEM, "stream input error");
+        err = true;
+        break;
+      }
+      if (c == 0xff) break;
+      if (c == 0x00) {
+        size_t ksiz = 0;
+        do {
+          c = src->get();
+          ksiz = (ksiz << 7) + (c & 0x7f);
+        } while (c >= 0x80);
+        size_t vsiz = 0;
+        do {
+          c = src->get();
+          vsiz = (vsiz << 7) + (c & 0x7f);
+        } while (c >= 0x80);
+        size_t rsiz = ksiz + vsiz;
+        char* rbuf = rsiz > sizeof(buf) ? new char[rsiz] : buf;
+        src->read(rbuf, ksiz + vsiz);
+        if (src->fail()) {
+          set_error(_KCCODELINE_, Error::SYSTEM, "stream input error");
+          err = true;
+          if (rbuf != buf) delete[] rbuf;
+          break;
+        }
+        if (!set(rbuf, ksiz, rbuf + ksiz, vsiz)) {
+          err = true;
+          if (rbuf != buf) delete[] rbuf;
+          break;
+        }
+        if (rbuf != buf) delete[] rbuf;
+      } else {
+        set_error(_KCCODELINE_, Error::INVALID, "invalid magic data of input stream");
+        err = true;
+        break;
+      }
+      curcnt++;
+      if (checker && !checker->check("load_snapshot", "processing", curcnt, -1)) {
+        set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
+        err = true;
+        break;
+      }
+    }
+    if (checker && !checker->check("load_snapshot", "ending", -1, -1)) {
+      set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
+      err = true;
+    }
+    return !err;
+  }
+  /**
+   * Load records from a data stream in the block snapshot format.
+   * @param src the source stream, whose magic data has been read.
+   * @param thnum the number of worker threads.
+   * @param checker a progress checker object.  If it is NULL, no checking is performed.
+   * @return true on success, or false on failure.
+   */
+  bool load_snapshot_framed(std::istream* src, size_t thnum, ProgressChecker* checker) {
+    _assert_(src && thnum <= MEMMAXSIZ);
+    int32_t codec = src->get();
+    if (src->fail() || codec < 0 || codec > (int32_t)SBCLZMA) {
+      set_error(_KCCODELINE_, Error::INVALID, "unknown codec");
+      return false;
+    }
+    if (thnum < 1) thnum = 1;
+    bool err = false;
+    if (checker && !checker->check("load_snapshot", "beginning", 0, -1)) {
+      set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
+      return false;
+    }
+    int64_t tail = src->tellg();
+    if (tail >= 0) {
+      int64_t cur = tail;
+      src->seekg(0, std::ios_base::end);
+      tail = src->tellg();
+      src->seekg(cur);
+      if (src->fail() || tail < cur) {
+        set_error(_KCCODELINE_, Error::SYSTEM, "stream input error");
+        return false;
+      }
+    } else {
+      src->clear();
+    }
+    Compressor* comp = snapshot_compressor(codec);
+    SnapshotLoadQueue queue(this, comp);
+    queue.start(thnum);
+    int64_t bcnt = 0;
+    int64_t rcnt = 0;
+    while (!err) {
+      char hbuf[SBHEADSIZ];
+      src->read(hbuf, sizeof(hbuf));
+      if (src->fail()) {
+        set_error(_KCCODELINE_, Error::SYSTEM, "stream input error");
+        err = true;
+        break;
+      }
+      uint32_t rnum = readfixnum(hbuf, sizeof(uint32_t));
+      uint32_t rsiz = readfixnum(hbuf + sizeof(uint32_t), sizeof(uint32_t));
+      uint32_t zsiz = readfixnum(hbuf + sizeof(uint32_t) * 2, sizeof(uint32_t));
+      uint32_t sum = readfixnum(hbuf + sizeof(uint32_t) * 3, sizeof(uint32_t));
+      if (rnum < 1) break;
+      if (tail >= 0 && (int64_t)zsiz > tail - (int64_t)src->tellg()) {
+        set_error(_KCCODELINE_, Error::BROKEN, "invalid block of the snapshot");
+        err = true;
+        break;
+      }
+      char* zbuf = read_snapshot_block(src, zsiz, tail < 0);
+      if (!zbuf) {
+        set_error(_KCCODELINE_, Error::SYSTEM, "stream input error");
+        err = true;
+        break;
+      }
+      while (queue.count() > (int64_t)thnum * 2) {
+        Thread::sleep(1.0 / CLOCKTICK);
+      }
+      queue.add_task(new SnapshotLoadQueue::BlockTask(zbuf, zsiz, rsiz, sum));
+      if (queue.failed()) break;
+      bcnt++;
+      rcnt += rnum;
+      if (checker && !checker->check("load_snapshot", "processing", rcnt, -1)) {
+        set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
+        err = true;
+      }
+    }
+    queue.finish();
+    delete comp;
+    if (queue.error() != Error::SUCCESS) {
+      set_error(_KCCODELINE_, queue.error(), queue.message());
+      err = true;
+    }
+    if (!err) {
+      for (int64_t i = 0; i < bcnt; i++) {
+        src->ignore(sizeof(uint64_t));
+        uint64_t ksiz = 0;
+        int32_t c;
+        do {
+          c = src->get();
+          ksiz = (ksiz << 7) + (c & 0x7f);
+        } while (c >= 0x80);
+        src->ignore(ksiz);
+      }
+      char tbuf[SBTRAILSIZ];
+      src->read(tbuf, sizeof(tbuf));
+      if (src->fail() || (int64_t)readfixnum(tbuf + sizeof(uint64_t), sizeof(uint64_t)) != bcnt ||
+          (int64_t)readfixnum(tbuf + sizeof(uint64_t) * 2, sizeof(uint64_t)) != rcnt) {
+        set_error(_KCCODELINE_, Error::BROKEN, "inconsistent trailer of the snapshot");
+        err = true;
+      }
+    }
+    if (checker && !checker->check("load_snapshot", "ending", -1, -1)) {
+      set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
+      err = true;
+    }
+    return !err;
+  }
+  /**
+   * Read the compressed data of a block of the block snapshot from a data stream.
+   * @param src the source stream.
+   * @param zsiz the size of the compressed data.
+   * @param grow true to extend the buffer step by step as the data arrives, or false to
+   * allocate it at once.
+   * @return the pointer to the region of the data, or NULL on failure.
+   * @note Growing is for streams whose length is unknown, so that a corrupted size does not
+   * allocate more memory than the stream actually holds.  Because the region of the return
+   * value is allocated with the the new[] operator, it should be released with the delete[]
+   * operator when it is no longer in use.
+   */
+  static char* read_snapshot_block(std::istream* src, size_t zsiz, bool grow) {
+    _assert_(src && zsiz <= MEMMAXSIZ);
+    if (!grow || zsiz <= (size_t)SBBLKSIZ) {
+      char* zbuf = new char[zsiz+1];
+      src->read(zbuf, zsiz);
+      if (src->fail()) {
+        delete[] zbuf;
+        return NULL;
+      }
+      return zbuf;
+    }
+    std::string zstr;
+    while (zstr.size() < zsiz) {
+      size_t osiz = zstr.size();
+      size_t rsiz = zsiz - osiz;
+      if (rsiz > (size_t)SBBLKSIZ) rsiz = SBBLKSIZ;
+      zstr.resize(osiz + rsiz);
+      src->read((char*)zstr.data() + osiz, rsiz);
+      if (src->fail()) return NULL;
+    }
+    char* zbuf = new char[zsiz+1];
+    std::memcpy(zbuf, zstr.data(), zsiz);
+    return zbuf;
+  }
+  /**
+   * Store the records of a decompressed block of the block snapshot.
+   * @param rbuf the pointer to the serialized records.
+   * @param rsiz the size of the serialized records.
+   * @param bkey the lower bound key, inclusive, or NULL for no bound.
+   * @param ekey the upper bound key, exclusive, or NULL for no bound.
+   * @return true on success, or false on failure.
+   */
+  bool store_snapshot_block(const char* rbuf, size_t rsiz,
+                            const std::string* bkey, const std::string* ekey) {
+    _assert_(rbuf && rsiz <= MEMMAXSIZ);
+    const char* rp = rbuf;
+    const char* ep = rbuf + rsiz;
+    while (rp < ep) {
+      uint64_t ksiz, vsiz;
+      size_t step = readvarnum(rp, ep - rp, &ksiz);
+      rp += step;
+      size_t vstep = step > 0 ? readvarnum(rp, ep - rp, &vsiz) : 0;
+      rp += vstep;
+      if (vstep < 1 || ksiz > (uint64_t)(ep - rp) || vsiz > (uint64_t)(ep - rp) - ksiz) {
+        set_error(_KCCODELINE_, Error::BROKEN, "invalid record of the snapshot");
+        return false;
+      }
+      bool hit = true;
+      if (bkey || ekey) {
+        std::string key(rp, ksiz);
+        hit = (!bkey || key >= *bkey) && (!ekey || key < *ekey);
+      }
+      if (hit && !set(rp, ksiz, rp + ksiz, vsiz)) return false;
+      rp += ksiz + vsiz;
+    }
+    return true;
+  }
+  /**
+   * Create the compressor of a codec of the block snapshot.
+   * @param codec the compression codec.
+   * @return the compressor object, or NULL for no compression.
+   */
+  static Compressor* snapshot_compressor(uint32_t codec) {
+    _assert_(true);
+    switch (codec) {
+      case SBCZLIB: return new ZLIBCompressor<ZLIB::RAW>;
+      case SBCLZO: return new LZOCompressor<LZO::RAW>;
+      case SBCLZMA: return new LZMACompressor<LZMA::RAW>;
+    }
+    return NULL;
+  }
+  /**
+   * Decompress a block of the block snapshot and verify it.
+   * @param comp the compressor or NULL for no compression.
+   * @param zbuf the pointer to the stored data.
+   * @param zsiz the size of the stored data.
+   * @param rsiz the expected size of the serialized records.
+   * @param sum the expected checksum of the serialized records.
+   * @return the pointer to the serialized records, or NULL on failure.
+   * @note Because the region of the return value is allocated with the the new[] operator, it
+   * should be released with the delete[] operator when it is no longer in use.
+   */
+  static char* inflate_snapshot_block(Compressor* comp, const char* zbuf, size_t zsiz,
+                                      size_t rsiz, uint32_t sum) {
+    _assert_(zbuf && zsiz <= MEMMAXSIZ && rsiz <= MEMMAXSIZ);
+    char* rbuf;
+    if (comp) {
+      size_t dsiz;
+      rbuf = comp->decompress(zbuf, zsiz, &dsiz);
+      if (!rbuf) return NULL;
+      if (dsiz != rsiz) {
+        delete[] rbuf;
+        return NULL;
+      }
+    } else {
+      if (zsiz != rsiz) return NULL;
+      rbuf = new char[rsiz+1];
+      std::memcpy(rbuf, zbuf, rsiz);
+    }
+    if ((uint32_t)hashmurmur(rbuf, rsiz) != sum) {
+      delete[] rbuf;
+      return NULL;
+    }
+    return rbuf;
+  }
 };
 
 
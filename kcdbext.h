@@ -647,6 +647,889 @@ class MapReduce {
 };
 
 
+/**
+ * Secondary index framework.
+ * @note This class maintains ordered index databases of a primary database.  Each record of an
+ * index database has the key which concatenates an escaped index key and the primary key, and
+ * the empty value, so that the index database should be a tree database with the lexical
+ * comparator.  Every update operation through this class is performed in a transaction of each
+ * database, which is committed or aborted together.  However, the atomicity across the
+ * databases is not guaranteed against a crash of the process.  Update operations must not be
+ * performed in a transaction of any of the databases.
+ */
+class IndexedDB {
+ public:
+  class Extractor;
+  class Cursor;
+ private:
+  struct Index;
+  struct Entry;
+  class Rebuild;
+  class RebuildQueue;
+  /** An alias of vector of indices. */
+  typedef std::vector<Index> IndexList;
+  /** The number of records processed in a batch. */
+  static const size_t IXBATCHNUM = 256;
+ public:
+  /**
+   * Interface to extract the index keys of a record.
+   */
+  class Extractor {
+   public:
+    /**
+     * Destructor.
+     */
+    virtual ~Extractor() {
+      _assert_(true);
+    }
+    /**
+     * Extract the index keys of a record.
+     * @param kbuf the pointer to the key region.
+     * @param ksiz the size of the key region.
+     * @param vbuf the pointer to the value region.
+     * @param vsiz the size of the value region.
+     * @param ikeys a string vector to which the index keys are added.
+     * @note To avoid deadlock, any explicit database operation must not be performed in this
+     * function.  This function can be called from multiple threads at the same time.
+     */
+    virtual void extract(const char* kbuf, size_t ksiz, const char* vbuf, size_t vsiz,
+                         std::vector<std::string>* ikeys) = 0;
+  };
+  /**
+   * Cursor to scan an index in the order of the index keys.
+   * @note The records of the primary database are retrieved in batches.
+   */
+  class Cursor {
+   public:
+    /**
+     * Constructor.
+     * @param db the container database object.
+     * @param idx the index number.
+     */
+    explicit Cursor(IndexedDB* db, size_t idx) :
+        db_(db), idx_(idx), cur_(NULL), entries_(), pos_(0), end_(true) {
+      _assert_(db && idx < db->indices_.size());
+      cur_ = db_->indices_[idx_].db->cursor();
+    }
+    /**
+     * Destructor.
+     */
+    ~Cursor() {
+      _assert_(true);
+      delete cur_;
+    }
+    /**
+     * Jump the cursor to the first record of the index.
+     * @return true on success, or false on failure.
+     */
+    bool jump() {
+      _assert_(true);
+      entries_.clear();
+      pos_ = 0;
+      end_ = false;
+      if (!cur_->jump()) {
+        const BasicDB::Error& e = cur_->error();
+        db_->db_->set_error(_KCCODELINE_, e.code(), e.message());
+        end_ = true;
+        return false;
+      }
+      return fill();
+    }
+    /**
+     * Jump the cursor to the first record whose index key is equal to or greater than a key.
+     * @param kbuf the pointer to the index key region.
+     * @param ksiz the size of the index key region.
+     * @return true on success, or false on failure.
+     */
+    bool jump(const char* kbuf, size_t ksiz) {
+      _assert_(kbuf && ksiz <= MEMMAXSIZ);
+      entries_.clear();
+      pos_ = 0;
+      end_ = false;
+      std::string ekey;
+      escape_key(kbuf, ksiz, &ekey);
+      if (!cur_->jump(ekey)) {
+        const BasicDB::Error& e = cur_->error();
+        db_->db_->set_error(_KCCODELINE_, e.code(), e.message());
+        end_ = true;
+        return false;
+      }
+      return fill();
+    }
+    /**
+     * Jump the cursor to the first record whose index key is equal to or greater than a key.
+     * @note Equal to the original Cursor::jump method except that the parameter is std::string.
+     */
+    bool jump(const std::string& key) {
+      _assert_(true);
+      return jump(key.data(), key.size());
+    }
+    /**
+     * Get the current record.
+     * @param ikey a string to contain the index key.  If it is NULL, it is ignored.
+     * @param pkey a string to contain the primary key.  If it is NULL, it is ignored.
+     * @param value a string to contain the value of the primary record.  If it is NULL, it is
+     * ignored.
+     * @param step true to move the cursor to the next record, or false for no move.
+     * @return true on success, or false on failure.
+     */
+    bool get(std::string* ikey, std::string* pkey, std::string* value, bool step = false) {
+      _assert_(true);
+      if (pos_ >= entries_.size()) {
+        db_->db_->set_error(_KCCODELINE_, BasicDB::Error::NOREC, "no record");
+        return false;
+      }
+      const Entry& entry = entries_[pos_];
+      if (ikey) *ikey = entry.ikey;
+      if (pkey) *pkey = entry.pkey;
+      if (value) *value = entry.value;
+      if (step) return this->step() || db_->db_->error() == BasicDB::Error::NOREC;
+      return true;
+    }
+    /**
+     * Step the cursor to the next record.
+     * @return true on success, or false on failure.
+     */
+    bool step() {
+      _assert_(true);
+      if (pos_ >= entries_.size()) {
+        db_->db_->set_error(_KCCODELINE_, BasicDB::Error::NOREC, "no record");
+        return false;
+      }
+      pos_++;
+      if (pos_ < entries_.size()) return true;
+      return fill();
+    }
+   private:
+    /**
+     * Fill the buffer with the next batch of records.
+     * @return true on success, or false on failure.
+     */
+    bool fill() {
+      _assert_(true);
+      entries_.clear();
+      pos_ = 0;
+      ScopedRWLock lock(&db_->mlock_, false);
+      BasicDB* idb = db_->indices_[idx_].db;
+      while (!end_ && entries_.empty()) {
+        std::vector<std::string> pkeys;
+        for (size_t i = 0; i < IXBATCHNUM; i++) {
+          std::string ekey;
+          if (!cur_->get_key(&ekey, true)) {
+            if (idb->error() != BasicDB::Error::NOREC) {
+              const BasicDB::Error& e = idb->error();
+              db_->db_->set_error(_KCCODELINE_, e.code(), e.message());
+              return false;
+            }
+            end_ = true;
+            break;
+          }
+          Entry entry;
+          if (!unescape_key(ekey, &entry.ikey, &entry.pkey)) {
+            db_->db_->set_error(_KCCODELINE_, BasicDB::Error::BROKEN, "invalid index record");
+            return false;
+          }
+          pkeys.push_back(entry.pkey);
+          entries_.push_back(entry);
+        }
+        std::map<std::string, std::string> recs;
+        if (db_->db_->get_bulk(pkeys, &recs) < 0) return false;
+        std::vector<Entry>::iterator wit = entries_.begin();
+        std::vector<Entry>::iterator rit = entries_.begin();
+        std::vector<Entry>::iterator ritend = entries_.end();
+        while (rit != ritend) {
+          std::map<std::string, std::string>::iterator it = recs.find(rit->pkey);
+          if (it != recs.end()) {
+            if (wit != rit) *wit = *rit;
+            wit->value = it->second;
+            ++wit;
+          }
+          ++rit;
+        }
+        entries_.erase(wit, entries_.end());
+      }
+      if (entries_.empty()) {
+        db_->db_->set_error(_KCCODELINE_, BasicDB::Error::NOREC, "no record");
+        return false;
+      }
+      return true;
+    }
+    /** Dummy constructor to forbid the use. */
+    Cursor(const Cursor&);
+    /** Dummy Operator to forbid the use. */
+    Cursor& operator =(const Cursor&);
+    /** The inner database. */
+    IndexedDB* db_;
+    /** The index number. */
+    size_t idx_;
+    /** The cursor of the index database. */
+    BasicDB::Cursor* cur_;
+    /** The buffered records. */
+    std::vector<Entry> entries_;
+    /** The position of the current record in the buffer. */
+    size_t pos_;
+    /** The flag of the end of the index database. */
+    bool end_;
+  };
+  /**
+   * Constructor.
+   * @param db the primary database object.  Its possession is not transferred.
+   */
+  explicit IndexedDB(BasicDB* db) : mlock_(), db_(db), indices_(), rblock_(), rbstate_(NULL) {
+    _assert_(db);
+  }
+  /**
+   * Destructor.
+   */
+  ~IndexedDB() {
+    _assert_(true);
+  }
+  /**
+   * Add an index.
+   * @param idb the index database object.  Its possession is not transferred.
+   * @param extractor the extractor object of the index keys.  Its possession is not
+   * transferred.
+   * @return the index number.
+   * @note The index is not built for the existing records.  Call the IndexedDB::rebuild method
+   * if necessary.
+   */
+  size_t add_index(BasicDB* idb, Extractor* extractor) {
+    _assert_(idb && extractor);
+    ScopedRWLock lock(&mlock_, true);
+    Index index;
+    index.db = idb;
+    index.extractor = extractor;
+    indices_.push_back(index);
+    return indices_.size() - 1;
+  }
+  /**
+   * Set the value of a record and update the indices.
+   * @param kbuf the pointer to the key region.
+   * @param ksiz the size of the key region.
+   * @param vbuf the pointer to the value region.
+   * @param vsiz the size of the value region.
+   * @return true on success, or false on failure.
+   */
+  bool set(const char* kbuf, size_t ksiz, const char* vbuf, size_t vsiz) {
+    _assert_(kbuf && ksiz <= MEMMAXSIZ && vbuf && vsiz <= MEMMAXSIZ);
+    std::map<std::string, std::string> recs;
+    recs[std::string(kbuf, ksiz)] = std::string(vbuf, vsiz);
+    return set_bulk(recs) >= 0;
+  }
+  /**
+   * Set the value of a record and update the indices.
+   * @note Equal to the original IndexedDB::set method except that the parameters are
+   * std::string.
+   */
+  bool set(const std::string& key, const std::string& value) {
+    _assert_(true);
+    return set(key.data(), key.size(), value.data(), value.size());
+  }
+  /**
+   * Remove a record and update the indices.
+   * @param kbuf the pointer to the key region.
+   * @param ksiz the size of the key region.
+   * @return true on success, or false on failure.
+   * @note If no record corresponds to the key, false is returned.
+   */
+  bool remove(const char* kbuf, size_t ksiz) {
+    _assert_(kbuf && ksiz <= MEMMAXSIZ);
+    std::vector<std::string> keys;
+    keys.push_back(std::string(kbuf, ksiz));
+    int64_t cnt = remove_bulk(keys);
+    if (cnt < 0) return false;
+    if (cnt < 1) {
+      db_->set_error(_KCCODELINE_, BasicDB::Error::NOREC, "no record");
+      return false;
+    }
+    return true;
+  }
+  /**
+   * Remove a record and update the indices.
+   * @note Equal to the original IndexedDB::remove method except that the parameter is
+   * std::string.
+   */
+  bool remove(const std::string& key) {
+    _assert_(true);
+    return remove(key.data(), key.size());
+  }
+  /**
+   * Store records at once and update the indices.
+   * @param recs the records to store.
+   * @return the number of stored records, or -1 on failure.
+   * @note The index records of all of the records are updated at once in each index database.
+   */
+  int64_t set_bulk(const std::map<std::string, std::string>& recs) {
+    _assert_(true);
+    std::vector<std::string> keys;
+    keys.reserve(recs.size());
+    std::map<std::string, std::string>::const_iterator it = recs.begin();
+    std::map<std::string, std::string>::const_iterator itend = recs.end();
+    while (it != itend) {
+      keys.push_back(it->first);
+      ++it;
+    }
+    return update(keys, &recs);
+  }
+  /**
+   * Remove records at once and update the indices.
+   * @param keys the keys of the records to remove.
+   * @return the number of removed records, or -1 on failure.
+   */
+  int64_t remove_bulk(const std::vector<std::string>& keys) {
+    _assert_(true);
+    return update(keys, NULL);
+  }
+  /**
+   * Rebuild all indices from the records of the primary database.
+   * @param thnum the number of worker threads to extract and store the index keys.
+   * @return true on success, or false on failure.
+   * @note The indices are built into temporary on-memory databases while update operations
+   * through this object go on, and the records of the temporary databases are stored into the
+   * index databases at the end, when update operations are blocked.  Updates during the
+   * rebuilding are applied to the temporary databases too.  Only one rebuilding is performed
+   * at the same time.  Each index database is updated in a transaction, which is committed
+   * only if all of them are updated successfully, so a failed rebuilding leaves the indices as
+   * they were, unless committing one of the transactions fails.
+   */
+  bool rebuild(size_t thnum = 1) {
+    _assert_(true);
+    ScopedMutex rblock(&rblock_);
+    if (thnum < 1) thnum = 1;
+    bool err = false;
+    Rebuild rb;
+    mlock_.lock_writer();
+    IndexList::iterator xit = indices_.begin();
+    IndexList::iterator xitend = indices_.end();
+    while (xit != xitend) {
+      GrassDB* tdb = new GrassDB;
+      Index index;
+      index.db = tdb;
+      index.extractor = xit->extractor;
+      rb.indices.push_back(index);
+      if (!tdb->open("%", GrassDB::OWRITER | GrassDB::OCREATE | GrassDB::OTRUNCATE)) {
+        const BasicDB::Error& e = tdb->error();
+        db_->set_error(_KCCODELINE_, e.code(), e.message());
+        mlock_.unlock();
+        return false;
+      }
+      ++xit;
+    }
+    rbstate_ = &rb;
+    mlock_.unlock();
+    RebuildQueue queue(&rb, thnum * 2);
+    queue.start(thnum);
+    BasicDB::Cursor* cur = db_->cursor();
+    bool ok = cur->jump();
+    if (!ok && db_->error() != BasicDB::Error::NOREC) err = true;
+    while (ok && rb.error() == BasicDB::Error::SUCCESS) {
+      RebuildQueue::RecordTask* task = new RebuildQueue::RecordTask;
+      for (size_t i = 0; i < IXBATCHNUM; i++) {
+        std::string key, value;
+        if (!cur->get(&key, &value, true)) {
+          if (db_->error() != BasicDB::Error::NOREC) err = true;
+          ok = false;
+          break;
+        }
+        task->recs.push_back(std::make_pair(key, value));
+      }
+      if (task->recs.empty()) {
+        delete task;
+        break;
+      }
+      queue.add(task);
+    }
+    delete cur;
+    queue.finish();
+    ScopedRWLock lock(&mlock_, true);
+    rbstate_ = NULL;
+    const BasicDB::Error& e = rb.error();
+    if (e != BasicDB::Error::SUCCESS) {
+      db_->set_error(_KCCODELINE_, e.code(), e.message());
+      err = true;
+    }
+    size_t trnum = 0;
+    while (!err && trnum < indices_.size()) {
+      BasicDB* idb = indices_[trnum].db;
+      if (!idb->begin_transaction()) {
+        const BasicDB::Error& e = idb->error();
+        db_->set_error(_KCCODELINE_, e.code(), e.message());
+        err = true;
+        break;
+      }
+      trnum++;
+    }
+    for (size_t i = 0; !err && i < rb.indices.size(); i++) {
+      if (!store_index(rb.indices[i].db, indices_[i].db)) err = true;
+    }
+    bool commit = !err;
+    for (size_t i = 0; i < trnum; i++) {
+      BasicDB* idb = indices_[i].db;
+      if (!idb->end_transaction(commit)) {
+        const BasicDB::Error& e = idb->error();
+        db_->set_error(_KCCODELINE_, e.code(), e.message());
+        err = true;
+      }
+    }
+    return !err;
+  }
+  /**
+   * Get the primary database object.
+   * @return the primary database object.
+   */
+  BasicDB* db() {
+    _assert_(true);
+    return db_;
+  }
+  /**
+   * Get an index database object.
+   * @param idx the index number.
+   * @return the index database object, or NULL on failure.
+   */
+  BasicDB* index_db(size_t idx) {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, false);
+    if (idx >= indices_.size()) return NULL;
+    return indices_[idx].db;
+  }
+  /**
+   * Create a cursor object of an index.
+   * @param idx the index number.
+   * @return the return value is the created cursor object, or NULL on failure.
+   * @note Because the object of the return value is allocated by the constructor, it should be
+   * released with the delete operator when it is no longer in use.
+   */
+  Cursor* cursor(size_t idx) {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, false);
+    if (idx >= indices_.size()) {
+      db_->set_error(_KCCODELINE_, BasicDB::Error::INVALID, "no such index");
+      return NULL;
+    }
+    return new Cursor(this, idx);
+  }
+ private:
+  /**
+   * Index data.
+   */
+  struct Index {
+    BasicDB* db;                         ///< index database
+    Extractor* extractor;                ///< extractor
+  };
+  /**
+   * Record buffered by the cursor.
+   */
+  struct Entry {
+    std::string ikey;                    ///< index key
+    std::string pkey;                    ///< primary key
+    std::string value;                   ///< value of the primary record
+  };
+  /**
+   * State of rebuilding shared with update operations.
+   */
+  class Rebuild {
+   public:
+    /** constructor */
+    explicit Rebuild() : mutex(), indices(), touched(), error_() {}
+    /** destructor */
+    ~Rebuild() {
+      for (size_t i = 0; i < indices.size(); i++) {
+        delete indices[i].db;
+      }
+    }
+    /** get the first error */
+    BasicDB::Error error() {
+      ScopedMutex lock(&mutex);
+      return error_;
+    }
+    /** set the error of a temporary database, with the mutex locked */
+    void set_error(BasicDB* db) {
+      if (error_ == BasicDB::Error::SUCCESS) error_ = db->error();
+    }
+    Mutex mutex;                         ///< mutex for the temporary databases
+    IndexList indices;                   ///< indices with the temporary databases
+    std::set<std::string> touched;       ///< keys updated during the rebuilding
+   private:
+    BasicDB::Error error_;               ///< first error
+  };
+  /**
+   * Task queue for rebuilding.
+   */
+  class RebuildQueue : public TaskQueue {
+   public:
+    /** task of a batch of records */
+    class RecordTask : public Task {
+     public:
+      std::vector<std::pair<std::string, std::string> > recs;
+    };
+    /** constructor */
+    explicit RebuildQueue(Rebuild* rb, size_t limit) :
+        rb_(rb), limit_(limit), mutex_(), cond_(), pending_(0) {}
+    /** add a task, waiting while too many tasks are pending */
+    void add(RecordTask* task) {
+      mutex_.lock();
+      while (pending_ >= limit_) {
+        cond_.wait(&mutex_);
+      }
+      pending_++;
+      mutex_.unlock();
+      add_task(task);
+    }
+   private:
+    /** process a task */
+    void do_task(Task* task) {
+      RecordTask* rtask = (RecordTask*)task;
+      IndexList& indices = rb_->indices;
+      size_t rnum = rtask->recs.size();
+      size_t inum = indices.size();
+      std::vector<std::set<std::string> > ekeys(rnum * inum);
+      for (size_t i = 0; i < rnum; i++) {
+        const std::pair<std::string, std::string>& rec = rtask->recs[i];
+        for (size_t j = 0; j < inum; j++) {
+          extract_entries(indices[j].extractor, rec.first, rec.second, &ekeys[i*inum+j]);
+        }
+      }
+      rb_->mutex.lock();
+      for (size_t j = 0; j < inum; j++) {
+        std::map<std::string, std::string> entries;
+        for (size_t i = 0; i < rnum; i++) {
+          // records updated meanwhile are indexed by the update operations instead
+          if (rb_->touched.find(rtask->recs[i].first) != rb_->touched.end()) continue;
+          const std::set<std::string>& keys = ekeys[i*inum+j];
+          std::set<std::string>::const_iterator it = keys.begin();
+          std::set<std::string>::const_iterator itend = keys.end();
+          while (it != itend) {
+            entries[*it] = "";
+            ++it;
+          }
+        }
+        if (indices[j].db->set_bulk(entries, false) < 0) rb_->set_error(indices[j].db);
+      }
+      rb_->mutex.unlock();
+      delete rtask;
+      mutex_.lock();
+      pending_--;
+      cond_.signal();
+      mutex_.unlock();
+    }
+    Rebuild* rb_;                        ///< rebuilding state
+    size_t limit_;                       ///< maximum number of pending tasks
+    Mutex mutex_;                        ///< mutex for the pending tasks
+    CondVar cond_;                       ///< condition variable for the pending tasks
+    size_t pending_;                     ///< number of pending tasks
+  };
+  /**
+   * Escape an index key so that the order is kept.
+   * @param kbuf the pointer to the index key region.
+   * @param ksiz the size of the index key region.
+   * @param dest the string to which the result is appended.
+   */
+  static void escape_key(const char* kbuf, size_t ksiz, std::string* dest) {
+    _assert_(kbuf && ksiz <= MEMMAXSIZ && dest);
+    const char* ep = kbuf + ksiz;
+    while (kbuf < ep) {
+      const char* pv = (const char*)std::memchr(kbuf, '\0', ep - kbuf);
+      if (!pv) {
+        dest->append(kbuf, ep - kbuf);
+        break;
+      }
+      dest->append(kbuf, pv - kbuf);
+      dest->append(1, '\0');
+      dest->append(1, '\1');
+      kbuf = pv + 1;
+    }
+  }
+  /**
+   * Make the key of an index record.
+   * @param ikey the index key.
+   * @param pkey the primary key.
+   * @param dest the string to contain the result.
+   */
+  static void make_entry_key(const std::string& ikey, const std::string& pkey,
+                             std::string* dest) {
+    _assert_(dest);
+    dest->clear();
+    dest->reserve(ikey.size() + pkey.size() + 2);
+    escape_key(ikey.data(), ikey.size(), dest);
+    dest->append(2, '\0');
+    dest->append(pkey);
+  }
+  /**
+   * Extract the keys of the index records of a record.
+   * @param extractor the extractor object of the index keys.
+   * @param pkey the primary key.
+   * @param value the value of the primary record.
+   * @param ekeys a string set to which the keys of the index records are added.
+   */
+  static void extract_entries(Extractor* extractor, const std::string& pkey,
+                              const std::string& value, std::set<std::string>* ekeys) {
+    _assert_(extractor && ekeys);
+    std::vector<std::string> ikeys;
+    extractor->extract(pkey.data(), pkey.size(), value.data(), value.size(), &ikeys);
+    std::vector<std::string>::iterator it = ikeys.begin();
+    std::vector<std::string>::iterator itend = ikeys.end();
+    while (it != itend) {
+      std::string ekey;
+      make_entry_key(*it, pkey, &ekey);
+      ekeys->insert(ekey);
+      ++it;
+    }
+  }
+  /**
+   * Split the key of an index record.
+   * @param ekey the key of the index record.
+   * @param ikey the string to contain the index key.
+   * @param pkey the string to contain the primary key.
+   * @return true on success, or false on failure.
+   */
+  static bool unescape_key(const std::string& ekey, std::string* ikey, std::string* pkey) {
+    _assert_(ikey && pkey);
+    ikey->clear();
+    const char* rp = ekey.data();
+    const char* ep = rp + ekey.size();
+    while (rp < ep) {
+      const char* pv = (const char*)std::memchr(rp, '\0', ep - rp);
+      if (!pv || pv + 1 >= ep) return false;
+      ikey->append(rp, pv - rp);
+      if (pv[1] == '\0') {
+        pkey->assign(pv + 2, ep - pv - 2);
+        return true;
+      }
+      ikey->append(1, '\0');
+      rp = pv + 2;
+    }
+    return false;
+  }
+  /**
+   * Store and remove records and update the indices.
+   * @param keys the keys of the records.
+   * @param recs the records to store.  If it is NULL, the records are removed.
+   * @return the number of stored or removed records, or -1 on failure.
+   */
+  int64_t update(const std::vector<std::string>& keys,
+                 const std::map<std::string, std::string>* recs) {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, true);
+    Rebuild* rb = rbstate_;
+    if (rb) {
+      ScopedMutex rblock(&rb->mutex);
+      rb->touched.insert(keys.begin(), keys.end());
+    }
+    std::vector<BasicDB*> dbs;
+    dbs.push_back(db_);
+    IndexList::iterator xit = indices_.begin();
+    IndexList::iterator xitend = indices_.end();
+    while (xit != xitend) {
+      dbs.push_back(xit->db);
+      ++xit;
+    }
+    size_t tnum = 0;
+    while (tnum < dbs.size()) {
+      if (!dbs[tnum]->begin_transaction()) {
+        const BasicDB::Error& e = dbs[tnum]->error();
+        db_->set_error(_KCCODELINE_, e.code(), e.message());
+        break;
+      }
+      tnum++;
+    }
+    bool err = tnum < dbs.size();
+    std::map<std::string, std::string> olds;
+    if (!err && !indices_.empty() && db_->get_bulk(keys, &olds) < 0) err = true;
+    for (size_t i = 0; !err && i < indices_.size(); i++) {
+      Index* index = &indices_[i];
+      std::set<std::string> rems;
+      std::map<std::string, std::string>::iterator oit = olds.begin();
+      std::map<std::string, std::string>::iterator oitend = olds.end();
+      while (oit != oitend) {
+        std::vector<std::string> ikeys;
+        index->extractor->extract(oit->first.data(), oit->first.size(),
+                                  oit->second.data(), oit->second.size(), &ikeys);
+        std::vector<std::string>::iterator kit = ikeys.begin();
+        std::vector<std::string>::iterator kitend = ikeys.end();
+        while (kit != kitend) {
+          std::string ekey;
+          make_entry_key(*kit, oit->first, &ekey);
+          rems.insert(ekey);
+          ++kit;
+        }
+        ++oit;
+      }
+      std::map<std::string, std::string> adds;
+      if (recs) {
+        std::map<std::string, std::string>::const_iterator rit = recs->begin();
+        std::map<std::string, std::string>::const_iterator ritend = recs->end();
+        while (rit != ritend) {
+          std::vector<std::string> ikeys;
+          index->extractor->extract(rit->first.data(), rit->first.size(),
+                                    rit->second.data(), rit->second.size(), &ikeys);
+          std::vector<std::string>::iterator kit = ikeys.begin();
+          std::vector<std::string>::iterator kitend = ikeys.end();
+          while (kit != kitend) {
+            std::string ekey;
+            make_entry_key(*kit, rit->first, &ekey);
+            if (rems.erase(ekey) < 1) adds[ekey] = "";
+            ++kit;
+          }
+          ++rit;
+        }
+      }
+      std::vector<std::string> remkeys(rems.begin(), rems.end());
+      if (index->db->remove_bulk(remkeys, false) < 0 || index->db->set_bulk(adds, false) < 0) {
+        const BasicDB::Error& e = index->db->error();
+        db_->set_error(_KCCODELINE_, e.code(), e.message());
+        err = true;
+      }
+    }
+    int64_t cnt = -1;
+    if (!err) {
+      if (recs) {
+        cnt = db_->set_bulk(*recs, false);
+      } else {
+        cnt = db_->remove_bulk(keys, false);
+      }
+      if (cnt < 0) err = true;
+    }
+    while (tnum > 0) {
+      tnum--;
+      if (!dbs[tnum]->end_transaction(!err)) {
+        const BasicDB::Error& e = dbs[tnum]->error();
+        db_->set_error(_KCCODELINE_, e.code(), e.message());
+        err = true;
+      }
+    }
+    if (rb) update_rebuild(rb, keys, olds, recs, !err);
+    return err ? -1 : cnt;
+  }
+  /**
+   * Apply an update operation to the temporary databases of the rebuilding.
+   * @param rb the rebuilding state.
+   * @param keys the keys of the records.
+   * @param olds the records before the update.
+   * @param recs the stored records, or NULL if the records were removed.
+   * @param done true if the update was committed, or false if it was aborted.
+   */
+  void update_rebuild(Rebuild* rb, const std::vector<std::string>& keys,
+                      const std::map<std::string, std::string>& olds,
+                      const std::map<std::string, std::string>* recs, bool done) {
+    _assert_(rb);
+    std::map<std::string, std::string> curs;
+    if (done) {
+      if (recs) curs = *recs;
+    } else if (db_->get_bulk(keys, &curs) < 0) {
+      ScopedMutex lock(&rb->mutex);
+      rb->set_error(db_);
+      return;
+    }
+    ScopedMutex lock(&rb->mutex);
+    for (size_t i = 0; i < rb->indices.size(); i++) {
+      Index* index = &rb->indices[i];
+      std::set<std::string> rems;
+      std::map<std::string, std::string>::const_iterator it = olds.begin();
+      std::map<std::string, std::string>::const_iterator itend = olds.end();
+      while (it != itend) {
+        extract_entries(index->extractor, it->first, it->second, &rems);
+        ++it;
+      }
+      std::set<std::string> ekeys;
+      it = curs.begin();
+      itend = curs.end();
+      while (it != itend) {
+        extract_entries(index->extractor, it->first, it->second, &ekeys);
+        ++it;
+      }
+      std::vector<std::string> remkeys;
+      std::map<std::string, std::string> adds;
+      std::set<std::string>::iterator kit = rems.begin();
+      std::set<std::string>::iterator kitend = rems.end();
+      while (kit != kitend) {
+        if (ekeys.find(*kit) == ekeys.end()) remkeys.push_back(*kit);
+        ++kit;
+      }
+      kit = ekeys.begin();
+      kitend = ekeys.end();
+      while (kit != kitend) {
+        adds[*kit] = "";
+        ++kit;
+      }
+      if (index->db->remove_bulk(remkeys, false) < 0 || index->db->set_bulk(adds, false) < 0)
+        rb->set_error(index->db);
+    }
+  }
+  /**
+   * Store the records of a temporary database into an index database.
+   * @param src the temporary database.
+   * @param dest the index database.
+   * @return true on success, or false on failure.
+   * @note The records missing in the temporary database are removed one by one instead of
+   * clearing the index database, so that the update is undone by aborting the transaction.
+   */
+  bool store_index(BasicDB* src, BasicDB* dest) {
+    _assert_(src && dest);
+    class StaleRemover : public BasicDB::Visitor {
+     public:
+      explicit StaleRemover(BasicDB* src) : src_(src) {}
+     private:
+      const char* visit_full(const char* kbuf, size_t ksiz,
+                             const char* vbuf, size_t vsiz, size_t* sp) {
+        size_t rsiz;
+        char* rbuf = src_->get(kbuf, ksiz, &rsiz);
+        if (!rbuf) return REMOVE;
+        delete[] rbuf;
+        return NOP;
+      }
+      BasicDB* src_;
+    };
+    StaleRemover remover(src);
+    if (!dest->iterate(&remover, true)) {
+      const BasicDB::Error& e = dest->error();
+      db_->set_error(_KCCODELINE_, e.code(), e.message());
+      return false;
+    }
+    bool err = false;
+    BasicDB::Cursor* cur = src->cursor();
+    bool ok = cur->jump();
+    while (ok) {
+      std::map<std::string, std::string> entries;
+      for (size_t i = 0; i < IXBATCHNUM; i++) {
+        std::string key;
+        if (!cur->get_key(&key, true)) {
+          ok = false;
+          break;
+        }
+        entries[key] = "";
+      }
+      if (dest->set_bulk(entries, false) < 0) {
+        const BasicDB::Error& e = dest->error();
+        db_->set_error(_KCCODELINE_, e.code(), e.message());
+        err = true;
+        break;
+      }
+    }
+    if (!err && src->error() != BasicDB::Error::NOREC) {
+      const BasicDB::Error& e = src->error();
+      db_->set_error(_KCCODELINE_, e.code(), e.message());
+      err = true;
+    }
+    delete cur;
+    return !err;
+  }
+  /** Dummy constructor to forbid the use. */
+  IndexedDB(const IndexedDB&);
+  /** Dummy Operator to forbid the use. */
+  IndexedDB& operator =(const IndexedDB&);
+  /** The method lock. */
+  RWLock mlock_;
+  /** The primary database. */
+  BasicDB* db_;
+  /** The indices. */
+  IndexList indices_;
+  /** The lock for rebuilding. */
+  Mutex rblock_;
+  /** The state of the rebuilding in progress. */
+  Rebuild* rbstate_;
+};
+
+
 }                                        // common namespace
 
 #endif                                   // duplication check
@@ -436,6 +436,78 @@ class DirDB : public BasicDB {
     rlock_.unlock(lidx);
     return !err;
   }
+  /**
+   * Retrieve a part of the value of a record.
+   * @param kbuf the pointer to the key region.
+   * @param ksiz the size of the key region.
+   * @param off the offset in the value where the part begins.
+   * @param vbuf the pointer to the buffer into which the part of the value is written.
+   * @param max the size of the buffer.
+   * @return the size of the written part, or -1 on failure.
+   * @note Equal to the original BasicDB::get_range method except that only the header of the
+   * record and the part of the value are read from the file of the record.  If the records are
+   * compressed, the whole record is read and decompressed.
+   */
+  int64_t get_range(const char* kbuf, size_t ksiz, int64_t off, char* vbuf, size_t max) {
+    _assert_(kbuf && ksiz <= MEMMAXSIZ && off >= 0 && vbuf);
+    mlock_.lock_reader();
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      mlock_.unlock();
+      return -1;
+    }
+    if (comp_) {
+      mlock_.unlock();
+      return BasicDB::get_range(kbuf, ksiz, off, vbuf, max);
+    }
+    char name[NUMBUFSIZ];
+    size_t lidx = hashpath(kbuf, ksiz, name) % RLOCKSLOT;
+    rlock_.lock_reader(lidx);
+    int64_t rsiz = get_range_impl(kbuf, ksiz, off, vbuf, max, name);
+    rlock_.unlock(lidx);
+    mlock_.unlock();
+    return rsiz;
+  }
+  /**
+   * Overwrite a part of the value of a record.
+   * @param kbuf the pointer to the key region.
+   * @param ksiz the size of the key region.
+   * @param off the offset in the value where the part begins.
+   * @param vbuf the pointer to the region of the part.
+   * @param vsiz the size of the region of the part.
+   * @return true on success, or false on failure.
+   * @note Equal to the original BasicDB::write_range method except that the part is written in
+   * place of the file of the record if it is within the existing value.  If the records are
+   * compressed or transaction is used, the whole record is rewritten.
+   */
+  bool write_range(const char* kbuf, size_t ksiz, int64_t off, const char* vbuf, size_t vsiz) {
+    _assert_(kbuf && ksiz <= MEMMAXSIZ && off >= 0 && vbuf && vsiz <= MEMMAXSIZ);
+    mlock_.lock_reader();
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      mlock_.unlock();
+      return false;
+    }
+    if (!writer_) {
+      set_error(_KCCODELINE_, Error::NOPERM, "permission denied");
+      mlock_.unlock();
+      return false;
+    }
+    if (comp_ || tran_ || autotran_) {
+      mlock_.unlock();
+      return BasicDB::write_range(kbuf, ksiz, off, vbuf, vsiz);
+    }
+    char name[NUMBUFSIZ];
+    size_t lidx = hashpath(kbuf, ksiz, name) % RLOCKSLOT;
+    rlock_.lock_writer(lidx);
+    bool hit = false;
+    bool err = false;
+    if (!write_range_impl(kbuf, ksiz, off, vbuf, vsiz, name, &hit)) err = true;
+    rlock_.unlock(lidx);
+    mlock_.unlock();
+    if (!err && !hit) return BasicDB::write_range(kbuf, ksiz, off, vbuf, vsiz);
+    return !err;
+  }
   /**
    * Accept a visitor to multiple records at once.
    * @param keys specifies a string vector of the keys.
@@ -1882,6 +1954,146 @@ class DirDB : public BasicDB {
     }
     return !err;
   }
+  /**
+   * Open the file of a record and locate the region of its value.
+   * @param file the file object to be opened.
+   * @param rpath the path of the record.
+   * @param kbuf the pointer to the key region.
+   * @param ksiz the size of the key region.
+   * @param mode the connection mode of the file.
+   * @param op the pointer to the variable into which the offset of the value is assigned.
+   * @param sp the pointer to the variable into which the size of the value is assigned.
+   * @return true on success, or false on failure.
+   * @note The records must not be compressed.  The file is left open only on success.
+   */
+  bool locate_value(File* file, const std::string& rpath, const char* kbuf, size_t ksiz,
+                    uint32_t mode, int64_t* op, int64_t* sp) {
+    _assert_(file && kbuf && ksiz <= MEMMAXSIZ && op && sp);
+    if (!file->open(rpath, mode | File::ONOLOCK, 0)) {
+      set_error(_KCCODELINE_, Error::NOREC, "no record");
+      return false;
+    }
+    int64_t fsiz = file->size();
+    char hbuf[NUMBUFSIZ*2];
+    size_t hsiz = fsiz < (int64_t)sizeof(hbuf) ? fsiz : sizeof(hbuf);
+    if (!file->read(0, hbuf, hsiz)) {
+      set_error(_KCCODELINE_, Error::SYSTEM, file->error());
+      file->close();
+      return false;
+    }
+    const char* rp = hbuf;
+    if (hsiz < 4 || *(const unsigned char*)rp != RECMAGIC) {
+      set_error(_KCCODELINE_, Error::BROKEN, "invalid magic data of a record");
+      report(_KCCODELINE_, Logger::WARN, "rpath=%s", rpath.c_str());
+      file->close();
+      return false;
+    }
+    rp++;
+    hsiz--;
+    uint64_t rksiz, rvsiz;
+    size_t step = readvarnum(rp, hsiz, &rksiz);
+    rp += step;
+    hsiz -= step;
+    if (step > 0) {
+      step = readvarnum(rp, hsiz, &rvsiz);
+      rp += step;
+    }
+    int64_t koff = rp - hbuf;
+    if (step < 1 || koff + (int64_t)rksiz + (int64_t)rvsiz + 1 > fsiz) {
+      set_error(_KCCODELINE_, Error::BROKEN, "too short record");
+      report(_KCCODELINE_, Logger::WARN, "rpath=%s", rpath.c_str());
+      file->close();
+      return false;
+    }
+    if (rksiz != ksiz) {
+      set_error(_KCCODELINE_, Error::LOGIC, "collision of the hash values");
+      file->close();
+      return false;
+    }
+    char stack[NUMBUFSIZ];
+    char* rkbuf = ksiz > sizeof(stack) ? new char[ksiz] : stack;
+    bool err = false;
+    if (!file->read(koff, rkbuf, ksiz)) {
+      set_error(_KCCODELINE_, Error::SYSTEM, file->error());
+      err = true;
+    } else if (std::memcmp(rkbuf, kbuf, ksiz)) {
+      set_error(_KCCODELINE_, Error::LOGIC, "collision of the hash values");
+      err = true;
+    }
+    if (rkbuf != stack) delete[] rkbuf;
+    if (err) {
+      file->close();
+      return false;
+    }
+    *op = koff + ksiz;
+    *sp = rvsiz;
+    return true;
+  }
+  /**
+   * Retrieve a part of the value of a record.
+   * @param kbuf the pointer to the key region.
+   * @param ksiz the size of the key region.
+   * @param off the offset in the value where the part begins.
+   * @param vbuf the pointer to the buffer into which the part of the value is written.
+   * @param max the size of the buffer.
+   * @param name the encoded key.
+   * @return the size of the written part, or -1 on failure.
+   */
+  int64_t get_range_impl(const char* kbuf, size_t ksiz, int64_t off, char* vbuf, size_t max,
+                         const char* name) {
+    _assert_(kbuf && ksiz <= MEMMAXSIZ && off >= 0 && vbuf && name);
+    const std::string& rpath = path_ + File::PATHCHR + name;
+    File file;
+    int64_t voff, vsiz;
+    if (!locate_value(&file, rpath, kbuf, ksiz, File::OREADER, &voff, &vsiz)) return -1;
+    int64_t rsiz = off < vsiz ? std::min(vsiz - off, (int64_t)max) : 0;
+    if (rsiz > 0 && !file.read(voff + off, vbuf, rsiz)) {
+      set_error(_KCCODELINE_, Error::SYSTEM, file.error());
+      rsiz = -1;
+    }
+    if (!file.close()) {
+      set_error(_KCCODELINE_, Error::SYSTEM, file.error());
+      rsiz = -1;
+    }
+    return rsiz;
+  }
+  /**
+   * Overwrite a part of the value of a record in place.
+   * @param kbuf the pointer to the key region.
+   * @param ksiz the size of the key region.
+   * @param off the offset in the value where the part begins.
+   * @param vbuf the pointer to the region of the part.
+   * @param vsiz the size of the region of the part.
+   * @param name the encoded key.
+   * @param hp the pointer to the variable into which whether the part was written is assigned.
+   * @return true on success, or false on failure.
+   * @note If the record does not exist or the part is not within the value, nothing is written
+   * and false is assigned to the variable of the second result.
+   */
+  bool write_range_impl(const char* kbuf, size_t ksiz, int64_t off, const char* vbuf,
+                        size_t vsiz, const char* name, bool* hp) {
+    _assert_(kbuf && ksiz <= MEMMAXSIZ && off >= 0 && vbuf && vsiz <= MEMMAXSIZ &&
+             name && hp);
+    *hp = false;
+    const std::string& rpath = path_ + File::PATHCHR + name;
+    if (!File::status(rpath)) return true;
+    File file;
+    int64_t voff, rvsiz;
+    if (!locate_value(&file, rpath, kbuf, ksiz, File::OWRITER, &voff, &rvsiz)) return false;
+    bool err = false;
+    if (off + (int64_t)vsiz <= rvsiz) {
+      *hp = true;
+      if (!file.write(voff + off, vbuf, vsiz) || (autosync_ && !file.synchronize(true))) {
+        set_error(_KCCODELINE_, Error::SYSTEM, file.error());
+        err = true;
+      }
+    }
+    if (!file.close()) {
+      set_error(_KCCODELINE_, Error::SYSTEM, file.error());
+      err = true;
+    }
+    return !err;
+  }
   /**
    * Accept a visitor to a record.
    * @param kbuf the pointer to the key region.
@@ -50,10 +50,13 @@ static int32_t procget(const char* path, const char* kbuf, size_t ksiz,
 static int32_t proclist(const char* path, const char*kbuf, size_t ksiz, int32_t oflags,
                         int64_t max, bool pv, bool px);
 static int32_t procclear(const char* path, int32_t oflags);
-static int32_t procimport(const char* path, const char* file, int32_t oflags, bool sx);
+static int32_t procimport(const char* path, const char* file, int32_t oflags, bool sx,
+                          int32_t thnum, int64_t bulk);
 static int32_t proccopy(const char* path, const char* file, int32_t oflags);
-static int32_t procdump(const char* path, const char* file, int32_t oflags);
-static int32_t procload(const char* path, const char* file, int32_t oflags);
+static int32_t procdump(const char* path, const char* file, int32_t oflags,
+                        int32_t codec, int32_t thnum);
+static int32_t procload(const char* path, const char* file, int32_t oflags,
+                        int32_t thnum, const char* kbstr, const char* kestr);
 static int32_t procsetbulk(const char* path, int32_t oflags,
                            const std::map<std::string, std::string>& recs);
 static int32_t procremovebulk(const char* path, int32_t oflags,
@@ -122,10 +125,12 @@ static void usage() {
   eprintf("  %s get [-onl|-otl|-onr] [-sx] [-px] [-pz] path key\n", g_progname);
   eprintf("  %s list [-onl|-otl|-onr] [-max num] [-sx] [-pv] [-px] path [key]\n", g_progname);
   eprintf("  %s clear [-onl|-otl|-onr] path\n", g_progname);
-  eprintf("  %s import [-onl|-otl|-onr] [-sx] path [file]\n", g_progname);
+  eprintf("  %s import [-onl|-otl|-onr] [-sx] [-th num] [-bulk num] path [file]\n",
+          g_progname);
   eprintf("  %s copy [-onl|-otl|-onr] path file\n", g_progname);
-  eprintf("  %s dump [-onl|-otl|-onr] path [file]\n", g_progname);
-  eprintf("  %s load [-otr] [-onl|-otl|-onr] path [file]\n", g_progname);
+  eprintf("  %s dump [-onl|-otl|-onr] [-blk str] [-th num] path [file]\n", g_progname);
+  eprintf("  %s load [-otr] [-onl|-otl|-onr] [-th num] [-kb str] [-ke str] path [file]\n",
+          g_progname);
   eprintf("  %s setbulk [-onl|-otl|-onr] [-sx] path key value ...\n", g_progname);
   eprintf("  %s removebulk [-onl|-otl|-onr] [-sx] path key ...\n", g_progname);
   eprintf("  %s getbulk [-onl|-otl|-onr] [-sx] [-px] path key ...\n", g_progname);
@@ -480,6 +485,8 @@ static int32_t runimport(int argc, char** argv) {
   const char* file = NULL;
   int32_t oflags = 0;
   bool sx = false;
+  int32_t thnum = 1;
+  int64_t bulk = IMPBULKNUM;
   for (int32_t i = 2; i < argc; i++) {
     if (!argbrk && argv[i][0] == '-') {
       if (!std::strcmp(argv[i], "--")) {
@@ -492,6 +499,12 @@ static int32_t runimport(int argc, char** argv) {
         oflags |= kc::DirDB::ONOREPAIR;
       } else if (!std::strcmp(argv[i], "-sx")) {
         sx = true;
+      } else if (!std::strcmp(argv[i], "-th")) {
+        if (++i >= argc) usage();
+        thnum = kc::atoix(argv[i]);
+      } else if (!std::strcmp(argv[i], "-bulk")) {
+        if (++i >= argc) usage();
+        bulk = kc::atoix(argv[i]);
       } else {
         usage();
       }
@@ -504,8 +517,8 @@ static int32_t runimport(int argc, char** argv) {
       usage();
     }
   }
-  if (!path) usage();
-  int32_t rv = procimport(path, file, oflags, sx);
+  if (!path || thnum < 1 || bulk < 1) usage();
+  int32_t rv = procimport(path, file, oflags, sx, thnum, bulk);
   return rv;
 }
 
@@ -550,6 +563,8 @@ static int32_t rundump(int argc, char** argv) {
   const char* path = NULL;
   const char* file = NULL;
   int32_t oflags = 0;
+  int32_t codec = -1;
+  int32_t thnum = 1;
   for (int32_t i = 2; i < argc; i++) {
     if (!argbrk && argv[i][0] == '-') {
       if (!std::strcmp(argv[i], "--")) {
@@ -560,6 +575,21 @@ static int32_t rundump(int argc, char** argv) {
         oflags |= kc::DirDB::OTRYLOCK;
       } else if (!std::strcmp(argv[i], "-onr")) {
         oflags |= kc::DirDB::ONOREPAIR;
+      } else if (!std::strcmp(argv[i], "-blk")) {
+        if (++i >= argc) usage();
+        codec = kc::BasicDB::SBCZLIB;
+        if (!std::strcmp(argv[i], "none")) {
+          codec = kc::BasicDB::SBCNONE;
+        } else if (!std::strcmp(argv[i], "lzo")) {
+          codec = kc::BasicDB::SBCLZO;
+        } else if (!std::strcmp(argv[i], "lzma")) {
+          codec = kc::BasicDB::SBCLZMA;
+        } else if (std::strcmp(argv[i], "zlib")) {
+          usage();
+        }
+      } else if (!std::strcmp(argv[i], "-th")) {
+        if (++i >= argc) usage();
+        thnum = kc::atoix(argv[i]);
       } else {
         usage();
       }
@@ -572,8 +602,8 @@ static int32_t rundump(int argc, char** argv) {
       usage();
     }
   }
-  if (!path) usage();
-  int32_t rv = procdump(path, file, oflags);
+  if (!path || thnum < 1) usage();
+  int32_t rv = procdump(path, file, oflags, codec, thnum);
   return rv;
 }
 
@@ -584,6 +614,9 @@ static int32_t runload(int argc, char** argv) {
   const char* path = NULL;
   const char* file = NULL;
   int32_t oflags = 0;
+  int32_t thnum = 1;
+  const char* kbstr = NULL;
+  const char* kestr = NULL;
   for (int32_t i = 2; i < argc; i++) {
     if (!argbrk && argv[i][0] == '-') {
       if (!std::strcmp(argv[i], "--")) {
@@ -596,6 +629,15 @@ static int32_t runload(int argc, char** argv) {
         oflags |= kc::DirDB::OTRYLOCK;
       } else if (!std::strcmp(argv[i], "-onr")) {
         oflags |= kc::DirDB::ONOREPAIR;
+      } else if (!std::strcmp(argv[i], "-th")) {
+        if (++i >= argc) usage();
+        thnum = kc::atoix(argv[i]);
+      } else if (!std::strcmp(argv[i], "-kb")) {
+        if (++i >= argc) usage();
+        kbstr = argv[i];
+      } else if (!std::strcmp(argv[i], "-ke")) {
+        if (++i >= argc) usage();
+        kestr = argv[i];
       } else {
         usage();
       }
@@ -608,8 +650,8 @@ static int32_t runload(int argc, char** argv) {
       usage();
     }
   }
-  if (!path) usage();
-  int32_t rv = procload(path, file, oflags);
+  if (!path || thnum < 1 || ((kbstr || kestr) && !file)) usage();
+  int32_t rv = procload(path, file, oflags, thnum, kbstr, kestr);
   return rv;
 }
 
@@ -1093,7 +1135,8 @@ static int32_t procclear(const char* path, int32_t oflags) {
 
 
 // perform import command
-static int32_t procimport(const char* path, const char* file, int32_t oflags, bool sx) {
+static int32_t procimport(const char* path, const char* file, int32_t oflags, bool sx,
+                          int32_t thnum, int64_t bulk) {
   std::istream *is = &std::cin;
   std::ifstream ifs;
   if (file) {
@@ -1111,44 +1154,11 @@ static int32_t procimport(const char* path, const char* file, int32_t oflags, bo
     return 1;
   }
   bool err = false;
-  int64_t cnt = 0;
-  std::string line;
-  std::vector<std::string> fields;
-  while (!err && mygetline(is, &line)) {
-    cnt++;
-    kc::strsplit(line, '\t', &fields);
-    if (sx) {
-      std::vector<std::string>::iterator it = fields.begin();
-      std::vector<std::string>::iterator itend = fields.end();
-      while (it != itend) {
-        size_t esiz;
-        char* ebuf = kc::hexdecode(it->c_str(), &esiz);
-        it->clear();
-        it->append(ebuf, esiz);
-        delete[] ebuf;
-        ++it;
-      }
-    }
-    switch (fields.size()) {
-      case 2: {
-        if (!db.set(fields[0], fields[1])) {
-          dberrprint(&db, "DB::set failed");
-          err = true;
-        }
-        break;
-      }
-      case 1: {
-        if (!db.remove(fields[0]) && db.error() != kc::BasicDB::Error::NOREC) {
-          dberrprint(&db, "DB::remove failed");
-          err = true;
-        }
-        break;
-      }
-    }
-    oputchar('.');
-    if (cnt % 50 == 0) oprintf(" (%lld)\n", (long long)cnt);
+  const char* fname = NULL;
+  if (!importtsv(&db, is, sx, thnum, bulk, &fname)) {
+    dberrprint(&db, fname);
+    err = true;
   }
-  if (cnt % 50 > 0) oprintf(" (%lld)\n", (long long)cnt);
   if (!db.close()) {
     dberrprint(&db, "DB::close failed");
     err = true;
@@ -1182,7 +1192,8 @@ static int32_t proccopy(const char* path, const char* file, int32_t oflags) {
 
 
 // perform dump command
-static int32_t procdump(const char* path, const char* file, int32_t oflags) {
+static int32_t procdump(const char* path, const char* file, int32_t oflags,
+                        int32_t codec, int32_t thnum) {
   kc::DirDB db;
   db.tune_logger(stdlogger(g_progname, &std::cerr));
   if (!db.open(path, kc::DirDB::OREADER | oflags)) {
@@ -1192,14 +1203,18 @@ static int32_t procdump(const char* path, const char* file, int32_t oflags) {
   bool err = false;
   if (file) {
     DotChecker checker(&std::cout, 1000);
-    if (!db.dump_snapshot(file)) {
+    bool ok = codec >= 0 ? db.dump_snapshot_blocks(file, codec, thnum, 0) :
+        db.dump_snapshot(file);
+    if (!ok) {
       dberrprint(&db, "DB::dump_snapshot");
       err = true;
     }
     oprintf(" (end)\n");
     if (!err) oprintf("%lld records were dumped successfully\n", (long long)checker.count());
   } else {
-    if (!db.dump_snapshot(&std::cout)) {
+    bool ok = codec >= 0 ? db.dump_snapshot_blocks(&std::cout, codec, thnum) :
+        db.dump_snapshot(&std::cout);
+    if (!ok) {
       dberrprint(&db, "DB::dump_snapshot");
       err = true;
     }
@@ -1213,7 +1228,8 @@ static int32_t procdump(const char* path, const char* file, int32_t oflags) {
 
 
 // perform load command
-static int32_t procload(const char* path, const char* file, int32_t oflags) {
+static int32_t procload(const char* path, const char* file, int32_t oflags,
+                        int32_t thnum, const char* kbstr, const char* kestr) {
   kc::DirDB db;
   db.tune_logger(stdlogger(g_progname, &std::cerr));
   if (!db.open(path, kc::DirDB::OWRITER | kc::DirDB::OCREATE | oflags)) {
@@ -1223,7 +1239,11 @@ static int32_t procload(const char* path, const char* file, int32_t oflags) {
   bool err = false;
   if (file) {
     DotChecker checker(&std::cout, -1000);
-    if (!db.load_snapshot(file)) {
+    bool ok = kbstr || kestr ?
+        db.load_snapshot_range(file, kbstr, kbstr ? std::strlen(kbstr) : 0,
+                               kestr, kestr ? std::strlen(kestr) : 0) :
+        db.load_snapshot_parallel(file, thnum);
+    if (!ok) {
       dberrprint(&db, "DB::load_snapshot");
       err = true;
     }
@@ -1231,7 +1251,7 @@ static int32_t procload(const char* path, const char* file, int32_t oflags) {
     if (!err) oprintf("%lld records were loaded successfully\n", (long long)checker.count());
   } else {
     DotChecker checker(&std::cout, -1000);
-    if (!db.load_snapshot(&std::cin)) {
+    if (!db.load_snapshot_parallel(&std::cin, thnum)) {
       dberrprint(&db, "DB::load_snapshot");
       err = true;
     }
@@ -1011,6 +1011,119 @@ static int32_t procorder(const char* path, int64_t rnum, int32_t thnum, bool rnd
     dbmetaprint(&db, mode == 'w');
     oprintf("time: %.3f\n", etime - stime);
   }
+  if (mode == 'e') {
+    oprintf("accessing parts of records:\n");
+    stime = kc::time();
+    class ThreadRange : public kc::Thread {
+     public:
+      void setparams(int32_t id, kc::BasicDB* db, int64_t rnum, int32_t thnum,
+                     bool rnd, bool tran) {
+        id_ = id;
+        db_ = db;
+        rnum_ = rnum;
+        thnum_ = thnum;
+        err_ = false;
+        rnd_ = rnd;
+        tran_ = tran;
+      }
+      bool error() {
+        return err_;
+      }
+      void run() {
+        int64_t base = id_ * rnum_;
+        int64_t range = rnum_ * thnum_;
+        for (int64_t i = 1; !err_ && i <= rnum_; i++) {
+          if (tran_ && !db_->begin_transaction(false)) {
+            dberrprint(db_, __LINE__, "DB::begin_transaction");
+            err_ = true;
+          }
+          char kbuf[RECBUFSIZ];
+          size_t ksiz = std::sprintf(kbuf, "%08lld",
+                                     (long long)(rnd_ ? myrand(range) + 1 : base + i));
+          char vbuf[RECBUFSIZ];
+          int32_t vsiz = db_->get(kbuf, ksiz, vbuf, sizeof(vbuf));
+          if (vsiz >= 0) {
+            bool chk = !rnd_ && vsiz <= (int32_t)sizeof(vbuf) / 2;
+            if (vsiz > (int32_t)sizeof(vbuf)) vsiz = sizeof(vbuf);
+            int64_t off = myrand(vsiz + 1);
+            size_t max = myrand(ksiz) + 1;
+            char rbuf[RECBUFSIZ];
+            int64_t rsiz = db_->get_range(kbuf, ksiz, off, rbuf, max);
+            if (rsiz < 0) {
+              if (!rnd_ || db_->error() != kc::BasicDB::Error::NOREC) {
+                dberrprint(db_, __LINE__, "DB::get_range");
+                err_ = true;
+              }
+            } else if (chk && (rsiz != std::min(vsiz - off, (int64_t)max) ||
+                               std::memcmp(rbuf, vbuf + off, rsiz))) {
+              dberrprint(db_, __LINE__, "DB::get_range");
+              err_ = true;
+            }
+            off = myrand(vsiz + 2);
+            std::memset(rbuf, '*', max);
+            if (!db_->write_range(kbuf, ksiz, off, rbuf, max)) {
+              dberrprint(db_, __LINE__, "DB::write_range");
+              err_ = true;
+            }
+            if (chk) {
+              char nbuf[RECBUFSIZ];
+              std::memcpy(nbuf, vbuf, vsiz);
+              if (off > vsiz) std::memset(nbuf + vsiz, 0, off - vsiz);
+              std::memcpy(nbuf + off, rbuf, max);
+              int32_t nsiz = std::max((int64_t)vsiz, off + (int64_t)max);
+              char cbuf[RECBUFSIZ];
+              if (db_->get(kbuf, ksiz, cbuf, sizeof(cbuf)) != nsiz ||
+                  std::memcmp(cbuf, nbuf, nsiz)) {
+                dberrprint(db_, __LINE__, "DB::write_range");
+                err_ = true;
+              }
+            }
+            if (!db_->set(kbuf, ksiz, vbuf, vsiz)) {
+              dberrprint(db_, __LINE__, "DB::set");
+              err_ = true;
+            }
+          } else if (!rnd_ || db_->error() != kc::BasicDB::Error::NOREC) {
+            dberrprint(db_, __LINE__, "DB::get");
+            err_ = true;
+          }
+          if (tran_ && !db_->end_transaction(true)) {
+            dberrprint(db_, __LINE__, "DB::end_transaction");
+            err_ = true;
+          }
+          if (id_ < 1 && rnum_ > 250 && i % (rnum_ / 250) == 0) {
+            oputchar('.');
+            if (i == rnum_ || i % (rnum_ / 10) == 0) oprintf(" (%08lld)\n", (long long)i);
+          }
+        }
+      }
+     private:
+      int32_t id_;
+      kc::BasicDB* db_;
+      int64_t rnum_;
+      int32_t thnum_;
+      bool err_;
+      bool rnd_;
+      bool tran_;
+    };
+    ThreadRange threadranges[THREADMAX];
+    if (thnum < 2) {
+      threadranges[0].setparams(0, &db, rnum, thnum, rnd, tran);
+      threadranges[0].run();
+      if (threadranges[0].error()) err = true;
+    } else {
+      for (int32_t i = 0; i < thnum; i++) {
+        threadranges[i].setparams(i, &db, rnum, thnum, rnd, tran);
+        threadranges[i].start();
+      }
+      for (int32_t i = 0; i < thnum; i++) {
+        threadranges[i].join();
+        if (threadranges[i].error()) err = true;
+      }
+    }
+    etime = kc::time();
+    dbmetaprint(&db, false);
+    oprintf("time: %.3f\n", etime - stime);
+  }
   if (mode == 'e') {
     oprintf("traversing the database by the inner iterator:\n");
     stime = kc::time();
@@ -1503,6 +1503,16 @@ bool File::recovered() const {
 }
 
 
+/**
+ * Get the size of the write ahead log of the current transaction.
+ */
+int64_t File::wal_size() const {
+  _assert_(true);
+  FileCore* core = (FileCore*)opq_;
+  return core->tran ? core->walsiz : 0;
+}
+
+
 /**
  * Read the whole data from a file.
  */
@@ -1947,6 +1957,25 @@ bool File::synchronize_whole() {
 }
 
 
+/**
+ * Synchronize the entries of a directory with the device.
+ */
+bool File::synchronize_directory(const std::string& path) {
+#if defined(_SYS_MSVC_) || defined(_SYS_MINGW_)
+  _assert_(true);
+  return true;
+#else
+  _assert_(true);
+  int32_t fd = ::open(path.c_str(), O_RDONLY, FILEPERM);
+  if (fd < 0) return false;
+  bool err = false;
+  if (::fsync(fd) != 0) err = true;
+  if (::close(fd) != 0) err = true;
+  return !err;
+#endif
+}
+
+
 
 /**
  * Default constructor.
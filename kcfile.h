@@ -240,6 +240,11 @@ class File {
    * @return true if recovered, or false if not.
    */
   bool recovered() const;
+  /**
+   * Get the size of the write ahead log of the current transaction.
+   * @return the size of the write ahead log, or 0 if no transaction is running.
+   */
+  int64_t wal_size() const;
   /**
    * Read the whole data from a file.
    * @param path the path of a file.
@@ -330,6 +335,14 @@ class File {
    * @return true on success, or false on failure.
    */
   static bool synchronize_whole();
+  /**
+   * Synchronize the entries of a directory with the device.
+   * @param path the path of a directory.
+   * @return true on success, or false on failure.
+   * @note This makes creation, renaming, and removal of files in the directory persistent.  It
+   * does nothing on platforms where directories can not be synchronized.
+   */
+  static bool synchronize_directory(const std::string& path);
  private:
   /** Dummy constructor to forbid the use. */
   File(const File&);
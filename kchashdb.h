@@ -30,6 +30,12 @@
 #define KCHDBMAGICDATA  "KC\n"           ///< magic data of the file
 #define KCHDBCHKSUMSEED  "__kyotocabinet__"  ///< seed of the module checksum
 #define KCHDBTMPPATHEXT  "tmpkch"        ///< extension of the temporary file
+#define KCHDBJNLPATHEXT  "jnl"           ///< extension of the recovery journal file
+#define KCHDBJNLMAGICDATA  "KCJ\n"       ///< magic data of the recovery journal file
+#define KCHDBBLBPATHEXT  "blob"          ///< extension of the blob file
+#define KCHDBBLBMAGICDATA  "KCB\n"       ///< magic data of the blob file
+#define KCHDBIDXPATHEXT  "idx"           ///< extension of the index file
+#define KCHDBIDXMAGICDATA  "KCI\n"       ///< magic data of the index file
 
 namespace kyotocabinet {                 // common namespace
 
@@ -53,6 +59,7 @@ class HashDB : public BasicDB {
   struct FreeBlock;
   struct FreeBlockComparator;
   class Repeater;
+  class BlobCompressor;
   class ScopedVisitor;
   /** An alias of set of free blocks. */
   typedef std::set<FreeBlock> FBP;
@@ -96,8 +103,12 @@ class HashDB : public BasicDB {
   static const size_t RECBUFSIZ = 48;
   /** The size of the IO buffer. */
   static const size_t IOBUFSIZ = 1024;
+  /** The size of the chunk read at once by the batched scan of cursors. */
+  static const size_t SCANBUFSIZ = 1 << 20;
   /** The number of slots of the record lock. */
   static const int32_t RLOCKSLOT = 1024;
+  /** The number of slots of the lock of the recovery journal. */
+  static const int32_t JNLLOCKSLOT = 64;
   /** The default alignment power. */
   static const uint8_t DEFAPOW = 3;
   /** The maximum alignment power. */
@@ -116,6 +127,38 @@ class HashDB : public BasicDB {
   static const uint8_t PADMAGIC = 0xee;
   /** The magic data for free block. */
   static const uint8_t FBMAGIC = 0xdd;
+  /** The magic data for a pre-image entry of the recovery journal. */
+  static const uint8_t JNLMAGIC = 0xbb;
+  /** The size of the header of the recovery journal. */
+  static const int64_t JNLHEADSIZ = 16;
+  /** The size of the header of a pre-image entry of the recovery journal. */
+  static const int64_t JNLRHSIZ = 21;
+  /** The default threshold of the size of values stored in the blob file. */
+  static const int64_t DEFBTHRES = 1LL << 12;
+  /** The minimum size of the blob file collected automatically. */
+  static const int64_t BLBGCMIN = 1LL << 20;
+  /** The number of records scanned in each step of the automatic collection. */
+  static const int64_t BLBGCSTEP = 256;
+  /** The size of the header of the blob file. */
+  static const int64_t BLBHEADSIZ = 32;
+  /** The tag of a value stored in the record. */
+  static const uint8_t BLBTAGINL = 0x00;
+  /** The tag of a value stored in the blob file. */
+  static const uint8_t BLBTAGREF = 0x01;
+  /** The size of a reference to the blob file. */
+  static const size_t BLBREFSIZ = 17;
+  /** The size of a bucket page of the index file. */
+  static const int64_t IDXPGSIZ = 4096;
+  /** The size of the header of a bucket page. */
+  static const int64_t IDXPHSIZ = 8;
+  /** The size of the header of the index file. */
+  static const int64_t IDXHEADSIZ = 32;
+  /** The maximum depth of the directory of the index file. */
+  static const int32_t IDXMAXDEPTH = 20;
+  /** The offset of the directory in the index file. */
+  static const int64_t IDXDIROFF = IDXPGSIZ;
+  /** The offset of the first bucket page in the index file. */
+  static const int64_t IDXPGOFF = IDXDIROFF + ((int64_t)sizeof(uint32_t) << IDXMAXDEPTH);
   /** The maximum unit of auto defragmentation. */
   static const int32_t DFRGMAX = 512;
   /** The coefficient of auto defragmentation. */
@@ -124,6 +167,30 @@ class HashDB : public BasicDB {
   static const int64_t SLVGWIDTH = 1LL << 20;
   /** The threshold of busy loop and sleep for locking. */
   static const uint32_t LOCKBUSYLOOP = 8192;
+  /** The default number of sampled buckets of analysis. */
+  static const int64_t ANASMPNUM = 4096;
+  /** The minimum bucket number recommended by analysis. */
+  static const int64_t ANAMINBNUM = 1024;
+  /** The percentage of fragmentation worth caring about in analysis. */
+  static const int32_t ANAFRAGLOW = 5;
+  /** The percentage of heavy fragmentation in analysis. */
+  static const int32_t ANAFRAGHIGH = 20;
+  /** The unit of auto defragmentation recommended by analysis. */
+  static const int64_t ANADFUNIT = 8;
+  /** The unit of the memory-mapped region recommended by analysis. */
+  static const int64_t ANAMAPUNIT = 1LL << 20;
+  /** Indices of the counters of the metrics. */
+  enum MetricsCounter {
+    MCHIT,                               ///< records found
+    MCMISS,                              ///< records not found
+    MCCHAIN,                             ///< records walked in collision chains
+    MCFBREUSE,                           ///< free blocks reused
+    MCFBMISS,                            ///< free block pool misses
+    MCWALSIZ,                            ///< bytes written into the WAL
+    MCFSYNC,                             ///< physical synchronizations
+    MCFSYNCTIME,                         ///< time of physical synchronizations
+    MCNUM                                ///< number of counters
+  };
  public:
   /**
    * Cursor to indicate a record.
@@ -206,7 +273,7 @@ class HashDB : public BasicDB {
       if (vbuf == Visitor::REMOVE) {
         uint64_t hash = db_->hash_record(rec.kbuf, rec.ksiz);
         uint32_t pivot = db_->fold_hash(hash);
-        int64_t bidx = hash % db_->bnum_;
+        int64_t bidx = db_->bucket_index(hash);
         Repeater repeater(Visitor::REMOVE, 0);
         if (!db_->accept_impl(rec.kbuf, rec.ksiz, &repeater, bidx, pivot, true)) {
           delete[] rec.bbuf;
@@ -226,9 +293,8 @@ class HashDB : public BasicDB {
         zbuf = NULL;
         zsiz = 0;
         if (db_->comp_) {
-          zbuf = db_->comp_->compress(vbuf, vsiz, &zsiz);
+          zbuf = db_->compress_value(vbuf, vsiz, &zsiz);
           if (!zbuf) {
-            db_->set_error(_KCCODELINE_, Error::SYSTEM, "data compression failed");
             delete[] rec.bbuf;
             return false;
           }
@@ -237,6 +303,7 @@ class HashDB : public BasicDB {
         }
         size_t rsiz = db_->calc_record_size(rec.ksiz, vsiz);
         if (rsiz <= rec.rsiz) {
+          db_->release_blob_value(rec.vbuf, rec.vsiz);
           rec.psiz = rec.rsiz - rsiz;
           rec.vsiz = vsiz;
           rec.vbuf = vbuf;
@@ -257,7 +324,7 @@ class HashDB : public BasicDB {
         } else {
           uint64_t hash = db_->hash_record(rec.kbuf, rec.ksiz);
           uint32_t pivot = db_->fold_hash(hash);
-          int64_t bidx = hash % db_->bnum_;
+          int64_t bidx = db_->bucket_index(hash);
           Repeater repeater(vbuf, vsiz);
           if (!db_->accept_impl(rec.kbuf, rec.ksiz, &repeater, bidx, pivot, true)) {
             delete[] zbuf;
@@ -310,11 +377,26 @@ class HashDB : public BasicDB {
       off_ = 0;
       uint64_t hash = db_->hash_record(kbuf, ksiz);
       uint32_t pivot = db_->fold_hash(hash);
-      int64_t bidx = hash % db_->bnum_;
-      int64_t off = db_->get_bucket(bidx);
-      if (off < 0) return false;
+      int64_t bidx = db_->bucket_index(hash);
       Record rec;
       char rbuf[RECBUFSIZ];
+      if (db_->iopen_) {
+        IndexPage page;
+        int32_t sidx;
+        int64_t rpno;
+        if (!db_->search_index(kbuf, ksiz, hash, bidx, &page, &sidx, &rpno, &rec, rbuf))
+          return false;
+        if (sidx >= 0) {
+          delete[] rec.bbuf;
+          off_ = rec.off;
+          end_ = db_->lsiz_;
+          return true;
+        }
+        db_->set_error(_KCCODELINE_, Error::NOREC, "no record");
+        return false;
+      }
+      int64_t off = db_->get_bucket(bidx);
+      if (off < 0) return false;
       while (off > 0) {
         rec.off = off;
         if (!db_->read_record(&rec, rbuf)) return false;
@@ -427,6 +509,108 @@ class HashDB : public BasicDB {
       }
       return !err;
     }
+    /**
+     * Accept a visitor to the current record and the following records.
+     * @param visitor a visitor object.
+     * @param max the maximum number of records to visit.
+     * @param writable true for writable operation, or false for read-only operation.
+     * @return the number of visited records, or -1 on failure.
+     * @note The read-only operation reads the file in large chunks and parses the records in
+     * each chunk.  The writable operation calls the accept method for each record.
+     */
+    int64_t accept_batch(Visitor* visitor, int64_t max, bool writable = false) {
+      _assert_(visitor);
+      if (writable) return BasicDB::Cursor::accept_batch(visitor, max, true);
+      ScopedSpinRWLock lock(&db_->mlock_, true);
+      if (db_->omode_ == 0) {
+        db_->set_error(_KCCODELINE_, Error::INVALID, "not opened");
+        return -1;
+      }
+      if (off_ < 1) {
+        db_->set_error(_KCCODELINE_, Error::NOREC, "no record");
+        return 0;
+      }
+      if (off_ >= end_) {
+        db_->set_error(_KCCODELINE_, Error::BROKEN, "cursor after the end");
+        db_->report(_KCCODELINE_, Logger::WARN, "psiz=%lld off=%lld fsiz=%lld",
+                    (long long)db_->psiz_, (long long)off_, (long long)db_->file_.size());
+        return -1;
+      }
+      size_t bsiz = SCANBUFSIZ;
+      if ((int64_t)bsiz > db_->psiz_ - off_) bsiz = db_->psiz_ - off_;
+      char* cbuf = new char[bsiz];
+      int64_t coff = off_;
+      size_t csiz = 0;
+      int64_t cnt = 0;
+      bool err = false;
+      while (cnt < max && off_ < end_) {
+        size_t rsiz = coff + csiz - off_;
+        if (off_ < coff || off_ > coff + (int64_t)csiz ||
+            (rsiz < RECBUFSIZ && coff + (int64_t)csiz < db_->psiz_)) {
+          coff = off_;
+          csiz = bsiz;
+          if ((int64_t)csiz > db_->psiz_ - coff) csiz = db_->psiz_ - coff;
+          if (!db_->file_.read_fast(coff, cbuf, csiz)) {
+            db_->set_error(_KCCODELINE_, Error::SYSTEM, db_->file_.error());
+            db_->report(_KCCODELINE_, Logger::WARN, "psiz=%lld off=%lld rsiz=%lld fsiz=%lld",
+                        (long long)db_->psiz_, (long long)coff, (long long)csiz,
+                        (long long)db_->file_.size());
+            err = true;
+            break;
+          }
+          rsiz = csiz;
+        }
+        if (rsiz < db_->rhsiz_) {
+          db_->set_error(_KCCODELINE_, Error::BROKEN, "too short record region");
+          db_->report(_KCCODELINE_, Logger::WARN, "psiz=%lld off=%lld rsiz=%lld fsiz=%lld",
+                      (long long)db_->psiz_, (long long)off_, (long long)rsiz,
+                      (long long)db_->file_.size());
+          err = true;
+          break;
+        }
+        Record rec;
+        rec.off = off_;
+        if (!db_->parse_record(&rec, cbuf + (off_ - coff), rsiz)) {
+          err = true;
+          break;
+        }
+        if (rec.psiz == UINT16MAX) {
+          off_ += rec.rsiz;
+          continue;
+        }
+        if (!rec.vbuf && !db_->read_record_body(&rec)) {
+          err = true;
+          break;
+        }
+        const char* vbuf = rec.vbuf;
+        size_t vsiz = rec.vsiz;
+        char* zbuf = NULL;
+        size_t zsiz = 0;
+        if (db_->comp_) {
+          zbuf = db_->comp_->decompress(vbuf, vsiz, &zsiz);
+          if (!zbuf) {
+            db_->set_error(_KCCODELINE_, Error::SYSTEM, "data decompression failed");
+            delete[] rec.bbuf;
+            err = true;
+            break;
+          }
+          vbuf = zbuf;
+          vsiz = zsiz;
+        }
+        visitor->visit_full(rec.kbuf, rec.ksiz, vbuf, vsiz, &vsiz);
+        delete[] zbuf;
+        delete[] rec.bbuf;
+        off_ += rec.rsiz;
+        cnt++;
+      }
+      delete[] cbuf;
+      if (err) return -1;
+      if (off_ >= end_) {
+        db_->set_error(_KCCODELINE_, Error::NOREC, "no record");
+        off_ = 0;
+      }
+      return cnt;
+    }
     /**
      * Step the cursor to the previous record.
      * @note This is a dummy implementation for compatibility.
@@ -492,13 +676,409 @@ class HashDB : public BasicDB {
     /** The end offset. */
     int64_t end_;
   };
+  /**
+   * Transaction locking only the records it accesses.
+   * @note Unlike the transaction by the HashDB::begin_transaction method, which excludes any
+   * other transaction, each object of this class locks the record slots as it accesses them and
+   * keeps them locked until it is committed or aborted.  Thus, transactions on disjoint records
+   * proceed concurrently.  The original values of updated records are kept in memory and are
+   * written back on abort.  A slot whose index is smaller than the largest one held already is
+   * only tried to lock, and the operation fails with the logic error if the slot is busy, which
+   * prevents deadlock.  In that case, the transaction should be aborted and retried.  Updates
+   * are not protected against a crash of the process; use the HashDB::begin_transaction method
+   * for atomicity against crashes.  Cursors and iterators may observe uncommitted records.  An
+   * object of this class must be used by one thread only and must be finished before the
+   * database is closed.
+   */
+  class Transaction {
+    friend class HashDB;
+   public:
+    /**
+     * Constructor.
+     * @param db the container database object.
+     */
+    explicit Transaction(HashDB* db) : db_(db), slots_(), undos_(), active_(false) {
+      _assert_(db);
+    }
+    /**
+     * Destructor.
+     * @note If the transaction is not finished, it is aborted implicitly.
+     */
+    virtual ~Transaction() {
+      _assert_(true);
+      if (active_) abort();
+    }
+    /**
+     * Accept a visitor to a record.
+     * @param kbuf the pointer to the key region.
+     * @param ksiz the size of the key region.
+     * @param visitor a visitor object.
+     * @param writable true for writable operation, or false for read-only operation.
+     * @return true on success, or false on failure.
+     * @note The record slot is kept locked until the end of the transaction.  To avoid
+     * deadlock, any explicit database operation must not be performed in this function.
+     */
+    bool accept(const char* kbuf, size_t ksiz, Visitor* visitor, bool writable = true) {
+      _assert_(kbuf && ksiz <= MEMMAXSIZ && visitor);
+      Metrics::ScopedTimer mtimer(db_->mtrc_, Metrics::ACCEPT);
+      uint64_t hash = db_->hash_record(kbuf, ksiz);
+      uint32_t pivot = db_->fold_hash(hash);
+      int64_t bidx = 0;
+      uint32_t wcnt = 0;
+      uint32_t lcnt = 0;
+      while (true) {
+        db_->mlock_.lock_reader();
+        if (db_->omode_ == 0) {
+          db_->set_error(_KCCODELINE_, Error::INVALID, "not opened");
+          db_->mlock_.unlock();
+          return false;
+        }
+        if (active_ || !db_->tran_) {
+          if (writable) {
+            if (!db_->writer_) {
+              db_->set_error(_KCCODELINE_, Error::NOPERM, "permission denied");
+              db_->mlock_.unlock();
+              return false;
+            }
+            if (!(db_->flags_ & FOPEN) && !db_->autotran_ && !db_->set_flag(FOPEN, true)) {
+              db_->mlock_.unlock();
+              return false;
+            }
+          }
+          if (!active_) {
+            db_->txnum_ += 1;
+            active_ = true;
+            db_->trigger_meta(MetaTrigger::BEGINTRAN, "Transaction::accept");
+          }
+          bidx = db_->bucket_index(hash);
+          size_t lidx = bidx % RLOCKSLOT;
+          if (lock_slot_try(lidx)) break;
+          // wait for the slot without the method lock, and then check the bucket again
+          if (slots_.empty() || lidx > *slots_.rbegin()) {
+            db_->mlock_.unlock();
+            db_->rlock_.lock_writer(lidx);
+            slots_.insert(lidx);
+            continue;
+          }
+          if (lcnt >= LOCKBUSYLOOP) {
+            db_->set_error(_KCCODELINE_, Error::LOGIC, "lock conflict");
+            db_->mlock_.unlock();
+            return false;
+          }
+          db_->mlock_.unlock();
+          Thread::yield();
+          lcnt++;
+          continue;
+        }
+        db_->mlock_.unlock();
+        if (wcnt >= LOCKBUSYLOOP) {
+          Thread::chill();
+        } else {
+          Thread::yield();
+          wcnt++;
+        }
+      }
+      bool err = false;
+      if (writable) {
+        UndoVisitor uvisitor(&undos_, visitor);
+        if (!db_->accept_impl(kbuf, ksiz, &uvisitor, bidx, pivot, false)) err = true;
+      } else {
+        if (!db_->accept_impl(kbuf, ksiz, visitor, bidx, pivot, false)) err = true;
+      }
+      if (!err && db_->dfunit_ > 0 && db_->frgcnt_ >= db_->dfunit_ && db_->mlock_.promote()) {
+        int64_t unit = db_->frgcnt_;
+        if (unit >= db_->dfunit_) {
+          if (unit > DFRGMAX) unit = DFRGMAX;
+          if (!db_->defrag_impl(unit * DFRGCEF)) err = true;
+          db_->frgcnt_ -= unit;
+        }
+      } else if (!err && writable && db_->check_blob_garbage() && db_->mlock_.promote()) {
+        if (db_->check_blob_garbage() && !db_->defrag_blob_impl(BLBGCSTEP)) err = true;
+      } else if (!err && writable && db_->check_index_split() && db_->mlock_.promote()) {
+        if (db_->check_index_split() && !db_->split_index_pages()) err = true;
+      }
+      db_->mlock_.unlock();
+      return !err;
+    }
+    /**
+     * Set the value of a record.
+     * @param key the key.
+     * @param value the value of the record.
+     * @return true on success, or false on failure.
+     */
+    bool set(const std::string& key, const std::string& value) {
+      _assert_(true);
+      class VisitorImpl : public Visitor {
+       public:
+        explicit VisitorImpl(const std::string& value) : value_(value) {}
+       private:
+        const char* visit_full(const char* kbuf, size_t ksiz,
+                               const char* vbuf, size_t vsiz, size_t* sp) {
+          *sp = value_.size();
+          return value_.data();
+        }
+        const char* visit_empty(const char* kbuf, size_t ksiz, size_t* sp) {
+          *sp = value_.size();
+          return value_.data();
+        }
+        const std::string& value_;
+      };
+      VisitorImpl visitor(value);
+      return accept(key.data(), key.size(), &visitor, true);
+    }
+    /**
+     * Remove a record.
+     * @param key the key.
+     * @return true on success, or false on failure.
+     * @note If no record corresponds to the key, false is returned.
+     */
+    bool remove(const std::string& key) {
+      _assert_(true);
+      class VisitorImpl : public Visitor {
+       public:
+        explicit VisitorImpl() : ok_(false) {}
+        bool ok() const {
+          return ok_;
+        }
+       private:
+        const char* visit_full(const char* kbuf, size_t ksiz,
+                               const char* vbuf, size_t vsiz, size_t* sp) {
+          ok_ = true;
+          return REMOVE;
+        }
+        bool ok_;
+      };
+      VisitorImpl visitor;
+      if (!accept(key.data(), key.size(), &visitor, true)) return false;
+      if (!visitor.ok()) {
+        db_->set_error(_KCCODELINE_, Error::NOREC, "no record");
+        return false;
+      }
+      return true;
+    }
+    /**
+     * Retrieve the value of a record.
+     * @param key the key.
+     * @param value a string to contain the value.
+     * @return true on success, or false on failure.
+     * @note If no record corresponds to the key, false is returned.  The record slot is locked
+     * exclusively as with updating operations, so that the value is not changed by other
+     * threads until the end of the transaction.
+     */
+    bool get(const std::string& key, std::string* value) {
+      _assert_(value);
+      class VisitorImpl : public Visitor {
+       public:
+        explicit VisitorImpl(std::string* value) : value_(value), ok_(false) {}
+        bool ok() const {
+          return ok_;
+        }
+       private:
+        const char* visit_full(const char* kbuf, size_t ksiz,
+                               const char* vbuf, size_t vsiz, size_t* sp) {
+          value_->clear();
+          value_->append(vbuf, vsiz);
+          ok_ = true;
+          return NOP;
+        }
+        std::string* value_;
+        bool ok_;
+      };
+      VisitorImpl visitor(value);
+      if (!accept(key.data(), key.size(), &visitor, false)) return false;
+      if (!visitor.ok()) {
+        db_->set_error(_KCCODELINE_, Error::NOREC, "no record");
+        return false;
+      }
+      return true;
+    }
+    /**
+     * Commit the transaction.
+     * @return true on success, or false on failure.
+     * @note All locked record slots are released.
+     */
+    bool commit() {
+      _assert_(true);
+      if (!active_) return true;
+      finish();
+      db_->trigger_meta(MetaTrigger::COMMITTRAN, "Transaction::commit");
+      return true;
+    }
+    /**
+     * Abort the transaction.
+     * @return true on success, or false on failure.
+     * @note The updated records are restored and all locked record slots are released.
+     */
+    bool abort() {
+      _assert_(true);
+      if (!active_) return true;
+      bool err = false;
+      db_->mlock_.lock_reader();
+      if (db_->omode_ == 0) {
+        db_->set_error(_KCCODELINE_, Error::INVALID, "not opened");
+        err = true;
+      } else {
+        UndoMap::const_iterator it = undos_.begin();
+        UndoMap::const_iterator itend = undos_.end();
+        while (it != itend) {
+          const std::string& key = it->first;
+          uint64_t hash = db_->hash_record(key.data(), key.size());
+          uint32_t pivot = db_->fold_hash(hash);
+          int64_t bidx = db_->bucket_index(hash);
+          RestoreVisitor visitor(&it->second);
+          if (!db_->accept_impl(key.data(), key.size(), &visitor, bidx, pivot, false)) {
+            err = true;
+          }
+          ++it;
+        }
+      }
+      db_->mlock_.unlock();
+      finish();
+      db_->trigger_meta(MetaTrigger::ABORTTRAN, "Transaction::abort");
+      return !err;
+    }
+    /**
+     * Get the database object.
+     * @return the database object.
+     */
+    HashDB* db() {
+      _assert_(true);
+      return db_;
+    }
+   private:
+    /**
+     * Original state of an updated record.
+     */
+    struct Undo {
+      bool exists;                       ///< whether the record existed
+      std::string value;                 ///< the original value
+    };
+    /**
+     * Type of the map of original states.
+     */
+    typedef std::map<std::string, Undo> UndoMap;
+    /**
+     * Visitor to save the original state of a record before updating.
+     */
+    class UndoVisitor : public Visitor {
+     public:
+      /** constructor */
+      explicit UndoVisitor(UndoMap* undos, Visitor* visitor) :
+          undos_(undos), visitor_(visitor) {
+        _assert_(undos && visitor);
+      }
+     private:
+      /** visit a record */
+      const char* visit_full(const char* kbuf, size_t ksiz,
+                             const char* vbuf, size_t vsiz, size_t* sp) {
+        _assert_(kbuf && vbuf && sp);
+        const char* rv = visitor_->visit_full(kbuf, ksiz, vbuf, vsiz, sp);
+        if (rv != NOP) {
+          std::pair<UndoMap::iterator, bool> res =
+              undos_->insert(std::make_pair(std::string(kbuf, ksiz), Undo()));
+          if (res.second) {
+            res.first->second.exists = true;
+            res.first->second.value.append(vbuf, vsiz);
+          }
+        }
+        return rv;
+      }
+      /** visit an empty record */
+      const char* visit_empty(const char* kbuf, size_t ksiz, size_t* sp) {
+        _assert_(kbuf && sp);
+        const char* rv = visitor_->visit_empty(kbuf, ksiz, sp);
+        if (rv != NOP) {
+          std::pair<UndoMap::iterator, bool> res =
+              undos_->insert(std::make_pair(std::string(kbuf, ksiz), Undo()));
+          if (res.second) res.first->second.exists = false;
+        }
+        return rv;
+      }
+      UndoMap* undos_;
+      Visitor* visitor_;
+    };
+    /**
+     * Visitor to restore the original state of a record.
+     */
+    class RestoreVisitor : public Visitor {
+     public:
+      /** constructor */
+      explicit RestoreVisitor(const Undo* undo) : undo_(undo) {
+        _assert_(undo);
+      }
+     private:
+      /** visit a record */
+      const char* visit_full(const char* kbuf, size_t ksiz,
+                             const char* vbuf, size_t vsiz, size_t* sp) {
+        _assert_(kbuf && vbuf && sp);
+        if (!undo_->exists) return REMOVE;
+        *sp = undo_->value.size();
+        return undo_->value.data();
+      }
+      /** visit an empty record */
+      const char* visit_empty(const char* kbuf, size_t ksiz, size_t* sp) {
+        _assert_(kbuf && sp);
+        if (!undo_->exists) return NOP;
+        *sp = undo_->value.size();
+        return undo_->value.data();
+      }
+      const Undo* undo_;
+    };
+    /**
+     * Try to lock a record slot.
+     * @param lidx the index of the slot.
+     * @return true if the slot is locked by the transaction, or false if it is locked by
+     * another thread.
+     * @note This never waits, because the method lock is held by the caller.  Slots are waited
+     * for only in ascending order and without the method lock, so that neither other
+     * transactions nor operations locking all slots can deadlock with the transaction.
+     */
+    bool lock_slot_try(size_t lidx) {
+      _assert_(true);
+      if (slots_.find(lidx) != slots_.end()) return true;
+      if (!db_->rlock_.lock_writer_try(lidx)) return false;
+      slots_.insert(lidx);
+      return true;
+    }
+    /**
+     * Release all locked record slots and finish the transaction.
+     */
+    void finish() {
+      _assert_(true);
+      if (!active_) return;
+      std::set<size_t>::const_iterator it = slots_.begin();
+      std::set<size_t>::const_iterator itend = slots_.end();
+      while (it != itend) {
+        db_->rlock_.unlock(*it);
+        ++it;
+      }
+      slots_.clear();
+      undos_.clear();
+      db_->txnum_ -= 1;
+      active_ = false;
+    }
+    /** Dummy constructor to forbid the use. */
+    Transaction(const Transaction&);
+    /** Dummy Operator to forbid the use. */
+    Transaction& operator =(const Transaction&);
+    /** The inner database. */
+    HashDB* db_;
+    /** The indices of the locked record slots. */
+    std::set<size_t> slots_;
+    /** The original states of the updated records. */
+    UndoMap undos_;
+    /** The flag whether in progress. */
+    bool active_;
+  };
   /**
    * Tuning options.
    */
   enum Option {
     TSMALL = 1 << 0,                     ///< use 32-bit addressing
     TLINEAR = 1 << 1,                    ///< use linear collision chaining
-    TCOMPRESS = 1 << 2                   ///< compress each record
+    TCOMPRESS = 1 << 2,                  ///< compress each record
+    TBLOB = 1 << 3,                      ///< store large values in the blob file
+    TPAGE = 1 << 4                       ///< use paged buckets in the index file
   };
   /**
    * Status flags.
@@ -512,17 +1092,26 @@ class HashDB : public BasicDB {
    */
   explicit HashDB() :
       mlock_(), rlock_(RLOCKSLOT), flock_(), atlock_(), error_(),
-      logger_(NULL), logkinds_(0), mtrigger_(NULL),
+      logger_(NULL), logkinds_(0), mtrigger_(NULL), mtrc_(NULL),
       omode_(0), writer_(false), autotran_(false), autosync_(false),
       reorg_(false), trim_(false),
-      file_(), fbp_(), curs_(), path_(""),
+      file_(), jnfile_(), jnlock_(JNLLOCKSLOT), jnunit_(0), jnopen_(false), jnsiz_(0), jnflags_(),
+      jnrec_(false), fbp_(), curs_(), path_(""),
       libver_(0), librev_(0), fmtver_(0), chksum_(0), type_(TYPEHASH),
       apow_(DEFAPOW), fpow_(DEFFPOW), opts_(0), bnum_(DEFBNUM),
       flags_(0), flagopen_(false), count_(0), lsiz_(0), psiz_(0), opaque_(),
       msiz_(DEFMSIZ), dfunit_(0), embcomp_(ZLIBRAWCOMP),
       align_(0), fbpnum_(0), width_(0), linear_(false),
       comp_(NULL), rhsiz_(0), boff_(0), roff_(0), dfcur_(0), frgcnt_(0),
-      tran_(false), trhard_(false), trfbp_(), trcount_(0), trsize_(0) {
+      sratio_(0), sgrow_(0), sfill_(0),
+      blbcomp_(this), bthres_(DEFBTHRES), bgcratio_(0.5), bfile_(), bopen_(false), bgen_(0),
+      bsize_(0), blive_(0), bofile_(), boopen_(false), bogen_(0), bosize_(0), bolive_(0),
+      bgcoff_(0), bgccnt_(0),
+      ifile_(), iopen_(false), iplock_(), ibdepth_(0), igdepth_(0), idir_(),
+      ipnum_(0), ifree_(0), islotsiz_(0), islotnum_(0), isplits_(), ispnum_(0),
+      isplitcnt_(0),
+      tran_(false), trhard_(false), trfbp_(), trcount_(0), trsize_(0), trblive_(0),
+      trbolive_(0), tripnum_(0), trifree_(0), trigdepth_(0), tridir_(), txnum_(0) {
     _assert_(true);
   }
   /**
@@ -541,6 +1130,7 @@ class HashDB : public BasicDB {
         ++cit;
       }
     }
+    delete mtrc_;
   }
   /**
    * Accept a visitor to a record.
@@ -555,6 +1145,7 @@ class HashDB : public BasicDB {
    */
   bool accept(const char* kbuf, size_t ksiz, Visitor* visitor, bool writable = true) {
     _assert_(kbuf && ksiz <= MEMMAXSIZ && visitor);
+    Metrics::ScopedTimer mtimer(mtrc_, Metrics::ACCEPT);
     mlock_.lock_reader();
     if (omode_ == 0) {
       set_error(_KCCODELINE_, Error::INVALID, "not opened");
@@ -575,7 +1166,7 @@ class HashDB : public BasicDB {
     bool err = false;
     uint64_t hash = hash_record(kbuf, ksiz);
     uint32_t pivot = fold_hash(hash);
-    int64_t bidx = hash % bnum_;
+    int64_t bidx = bucket_index(hash);
     size_t lidx = bidx % RLOCKSLOT;
     if (writable) {
       rlock_.lock_writer(lidx);
@@ -591,6 +1182,10 @@ class HashDB : public BasicDB {
         if (!defrag_impl(unit * DFRGCEF)) err = true;
         frgcnt_ -= unit;
       }
+    } else if (!err && writable && check_blob_garbage() && mlock_.promote()) {
+      if (check_blob_garbage() && !defrag_blob_impl(BLBGCSTEP)) err = true;
+    } else if (!err && writable && check_index_split() && mlock_.promote()) {
+      if (check_index_split() && !split_index_pages()) err = true;
     }
     mlock_.unlock();
     return !err;
@@ -608,6 +1203,7 @@ class HashDB : public BasicDB {
   bool accept_bulk(const std::vector<std::string>& keys, Visitor* visitor,
                    bool writable = true) {
     _assert_(visitor);
+    Metrics::ScopedTimer mtimer(mtrc_, Metrics::ACCEPT);
     mlock_.lock_reader();
     if (omode_ == 0) {
       set_error(_KCCODELINE_, Error::INVALID, "not opened");
@@ -648,7 +1244,7 @@ class HashDB : public BasicDB {
       rkey->ksiz = key.size();
       uint64_t hash = hash_record(rkey->kbuf, rkey->ksiz);
       rkey->pivot = fold_hash(hash);
-      rkey->bidx = hash % bnum_;
+      rkey->bidx = bucket_index(hash);
       lidxs.insert(rkey->bidx % RLOCKSLOT);
     }
     std::set<size_t>::iterator lit = lidxs.begin();
@@ -688,46 +1284,182 @@ class HashDB : public BasicDB {
     return !err;
   }
   /**
-   * Iterate to accept a visitor for each record.
-   * @param visitor a visitor object.
-   * @param writable true for writable operation, or false for read-only operation.
-   * @param checker a progress checker object.  If it is NULL, no checking is performed.
-   * @return true on success, or false on failure.
-   * @note The whole iteration is performed atomically and other threads are blocked.  To avoid
-   * deadlock, any explicit database operation must not be performed in this function.
+   * Retrieve a part of the value of a record.
+   * @param kbuf the pointer to the key region.
+   * @param ksiz the size of the key region.
+   * @param off the offset in the value where the part begins.
+   * @param vbuf the pointer to the buffer into which the part of the value is written.
+   * @param max the size of the buffer.
+   * @return the size of the written part, or -1 on failure.
+   * @note Equal to the original BasicDB::get_range method except that only the header of the
+   * record and the part of the value are read from the database file or the blob file.  If the
+   * values are compressed, the whole value is read and decompressed.
    */
-  bool iterate(Visitor *visitor, bool writable = true, ProgressChecker* checker = NULL) {
-    _assert_(visitor);
-    ScopedSpinRWLock lock(&mlock_, true);
+  int64_t get_range(const char* kbuf, size_t ksiz, int64_t off, char* vbuf, size_t max) {
+    _assert_(kbuf && ksiz <= MEMMAXSIZ && off >= 0 && vbuf);
+    mlock_.lock_reader();
     if (omode_ == 0) {
       set_error(_KCCODELINE_, Error::INVALID, "not opened");
-      return false;
+      mlock_.unlock();
+      return -1;
     }
-    if (writable) {
-      if (!writer_) {
-        set_error(_KCCODELINE_, Error::NOPERM, "permission denied");
-        return false;
-      }
-      if (!(flags_ & FOPEN) && !autotran_ && !tran_ && !set_flag(FOPEN, true)) {
-        mlock_.unlock();
-        return false;
-      }
+    if (!check_range_access()) {
+      mlock_.unlock();
+      return BasicDB::get_range(kbuf, ksiz, off, vbuf, max);
     }
-    ScopedVisitor svis(visitor);
-    bool err = false;
-    if (!iterate_impl(visitor, checker)) err = true;
-    trigger_meta(MetaTrigger::ITERATE, "iterate");
-    return !err;
+    uint64_t hash = hash_record(kbuf, ksiz);
+    uint32_t pivot = fold_hash(hash);
+    int64_t bidx = bucket_index(hash);
+    size_t lidx = bidx % RLOCKSLOT;
+    rlock_.lock_reader(lidx);
+    int64_t rsiz = get_range_impl(kbuf, ksiz, off, vbuf, max, bidx, pivot);
+    rlock_.unlock(lidx);
+    mlock_.unlock();
+    return rsiz;
   }
   /**
-   * Get the last happened error.
-   * @return the last happened error.
+   * Overwrite a part of the value of a record.
+   * @param kbuf the pointer to the key region.
+   * @param ksiz the size of the key region.
+   * @param off the offset in the value where the part begins.
+   * @param vbuf the pointer to the region of the part.
+   * @param vsiz the size of the region of the part.
+   * @return true on success, or false on failure.
+   * @note Equal to the original BasicDB::write_range method except that the part is written in
+   * place if it is within the existing value.  A value in the blob file is written in place
+   * only if neither transaction nor the recovery journal is used.  Otherwise, and if the values
+   * are compressed, the whole value is rewritten.
    */
-  Error error() const {
-    _assert_(true);
-    return error_;
-  }
-  /**
+  bool write_range(const char* kbuf, size_t ksiz, int64_t off, const char* vbuf, size_t vsiz) {
+    _assert_(kbuf && ksiz <= MEMMAXSIZ && off >= 0 && vbuf && vsiz <= MEMMAXSIZ);
+    mlock_.lock_reader();
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      mlock_.unlock();
+      return false;
+    }
+    if (!writer_) {
+      set_error(_KCCODELINE_, Error::NOPERM, "permission denied");
+      mlock_.unlock();
+      return false;
+    }
+    if (!check_range_access()) {
+      mlock_.unlock();
+      return BasicDB::write_range(kbuf, ksiz, off, vbuf, vsiz);
+    }
+    if (!(flags_ & FOPEN) && !autotran_ && !tran_ && !set_flag(FOPEN, true)) {
+      mlock_.unlock();
+      return false;
+    }
+    uint64_t hash = hash_record(kbuf, ksiz);
+    uint32_t pivot = fold_hash(hash);
+    int64_t bidx = bucket_index(hash);
+    size_t lidx = bidx % RLOCKSLOT;
+    rlock_.lock_writer(lidx);
+    bool hit = false;
+    bool err = false;
+    if (!write_range_impl(kbuf, ksiz, off, vbuf, vsiz, bidx, pivot, &hit)) err = true;
+    rlock_.unlock(lidx);
+    mlock_.unlock();
+    if (!err && !hit) return BasicDB::write_range(kbuf, ksiz, off, vbuf, vsiz);
+    return !err;
+  }
+  /**
+   * Append the value of a record.
+   * @param kbuf the pointer to the key region.
+   * @param ksiz the size of the key region.
+   * @param vbuf the pointer to the value region.
+   * @param vsiz the size of the value region.
+   * @return true on success, or false on failure.
+   * @note Equal to the original BasicDB::append method except that the given value is written
+   * in place into the padding of the existing record if it has enough room.  Then neither the
+   * existing value is read nor the record is rewritten.  The tune_slack method reserves room in
+   * the padding when a record grows.
+   */
+  bool append(const char* kbuf, size_t ksiz, const char* vbuf, size_t vsiz) {
+    _assert_(kbuf && ksiz <= MEMMAXSIZ && vbuf && vsiz <= MEMMAXSIZ);
+    mlock_.lock_reader();
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      mlock_.unlock();
+      return false;
+    }
+    if (!writer_) {
+      set_error(_KCCODELINE_, Error::NOPERM, "permission denied");
+      mlock_.unlock();
+      return false;
+    }
+    if (!check_range_access()) {
+      mlock_.unlock();
+      return BasicDB::append(kbuf, ksiz, vbuf, vsiz);
+    }
+    if (!(flags_ & FOPEN) && !autotran_ && !tran_ && !set_flag(FOPEN, true)) {
+      mlock_.unlock();
+      return false;
+    }
+    uint64_t hash = hash_record(kbuf, ksiz);
+    uint32_t pivot = fold_hash(hash);
+    int64_t bidx = bucket_index(hash);
+    size_t lidx = bidx % RLOCKSLOT;
+    rlock_.lock_writer(lidx);
+    bool hit = false;
+    bool err = false;
+    if (!append_impl(kbuf, ksiz, vbuf, vsiz, bidx, pivot, &hit)) err = true;
+    rlock_.unlock(lidx);
+    mlock_.unlock();
+    if (!err && !hit) return BasicDB::append(kbuf, ksiz, vbuf, vsiz);
+    return !err;
+  }
+  /**
+   * Append the value of a record.
+   * @note Equal to the original DB::append method except that the parameters are std::string.
+   */
+  bool append(const std::string& key, const std::string& value) {
+    _assert_(true);
+    return append(key.c_str(), key.size(), value.c_str(), value.size());
+  }
+  /**
+   * Iterate to accept a visitor for each record.
+   * @param visitor a visitor object.
+   * @param writable true for writable operation, or false for read-only operation.
+   * @param checker a progress checker object.  If it is NULL, no checking is performed.
+   * @return true on success, or false on failure.
+   * @note The whole iteration is performed atomically and other threads are blocked.  To avoid
+   * deadlock, any explicit database operation must not be performed in this function.
+   */
+  bool iterate(Visitor *visitor, bool writable = true, ProgressChecker* checker = NULL) {
+    _assert_(visitor);
+    Metrics::ScopedTimer mtimer(mtrc_, Metrics::ITERATE);
+    ScopedSpinRWLock lock(&mlock_, true);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
+    }
+    if (writable) {
+      if (!writer_) {
+        set_error(_KCCODELINE_, Error::NOPERM, "permission denied");
+        return false;
+      }
+      if (!(flags_ & FOPEN) && !autotran_ && !tran_ && !set_flag(FOPEN, true)) {
+        mlock_.unlock();
+        return false;
+      }
+    }
+    ScopedVisitor svis(visitor);
+    bool err = false;
+    if (!iterate_impl(visitor, checker)) err = true;
+    trigger_meta(MetaTrigger::ITERATE, "iterate");
+    return !err;
+  }
+  /**
+   * Get the last happened error.
+   * @return the last happened error.
+   */
+  Error error() const {
+    _assert_(true);
+    return error_;
+  }
+  /**
    * Set the error information.
    * @param file the file name of the program source code.
    * @param line the line number of the program source code.
@@ -779,6 +1511,7 @@ class HashDB : public BasicDB {
     autosync_ = false;
     reorg_ = false;
     trim_ = false;
+    jnrec_ = false;
     uint32_t fmode = File::OREADER;
     if (mode & OWRITER) {
       writer_ = true;
@@ -802,7 +1535,14 @@ class HashDB : public BasicDB {
       return false;
     }
     if (file_.recovered()) report(_KCCODELINE_, Logger::WARN, "recovered by the WAL file");
+    if ((mode & OWRITER) && !(mode & ONOREPAIR) && !(mode & ONOLOCK) &&
+        !recover_journal(path)) {
+      file_.close();
+      return false;
+    }
+    bool fresh = false;
     if ((mode & OWRITER) && file_.size() < 1) {
+      fresh = true;
       calc_meta();
       libver_ = LIBVER;
       librev_ = LIBREV;
@@ -837,20 +1577,36 @@ class HashDB : public BasicDB {
       file_.close();
       return false;
     }
+    if (!open_blob(path, mode, fresh)) {
+      file_.close();
+      return false;
+    }
+    if (jnrec_ && !(flags_ & FFATAL)) {
+      flags_ &= ~FOPEN;
+      flagopen_ = false;
+    }
     if (((flags_ & FOPEN) || (flags_ & FFATAL)) && !(mode & ONOREPAIR) && !(mode & ONOLOCK)) {
       if (!reorganize_file(path)) {
+        close_blob();
+        file_.close();
+        return false;
+      }
+      if (!close_blob() || !open_blob(path, mode, false)) {
         file_.close();
         return false;
       }
       if (!file_.close()) {
         set_error(_KCCODELINE_, Error::SYSTEM, file_.error());
+        close_blob();
         return false;
       }
       if (!file_.open(path, fmode, msiz_)) {
         set_error(_KCCODELINE_, Error::SYSTEM, file_.error());
+        close_blob();
         return false;
       }
       if (!load_meta()) {
+        close_blob();
         file_.close();
         return false;
       }
@@ -863,6 +1619,7 @@ class HashDB : public BasicDB {
       report(_KCCODELINE_, Logger::WARN, "type=0x%02X apow=%d fpow=%d bnum=%lld count=%lld"
              " lsiz=%lld fsiz=%lld", (unsigned)type_, (int)apow_, (int)fpow_, (long long)bnum_,
              (long long)count_, (long long)lsiz_, (long long)file_.size());
+      close_blob();
       file_.close();
       return false;
     }
@@ -870,23 +1627,65 @@ class HashDB : public BasicDB {
       set_error(_KCCODELINE_, Error::BROKEN, "inconsistent file size");
       report(_KCCODELINE_, Logger::WARN, "lsiz=%lld fsiz=%lld",
              (long long)lsiz_, (long long)file_.size());
+      close_blob();
       file_.close();
       return false;
     }
     if (file_.size() != lsiz_ && !(mode & ONOREPAIR) && !(mode & ONOLOCK) && !trim_file(path)) {
+      close_blob();
+      file_.close();
+      return false;
+    }
+    if (!open_index(path, mode, fresh)) {
+      close_blob();
       file_.close();
       return false;
     }
     if (mode & OWRITER) {
-      if (!(flags_ & FOPEN) && !(flags_ & FFATAL) && !load_free_blocks()) {
+      if (!(flags_ & FOPEN) && !(flags_ & FFATAL) && !jnrec_ && !load_free_blocks()) {
+        close_index();
+        close_blob();
         file_.close();
         return false;
       }
       if (!dump_empty_free_blocks()) {
+        close_index();
+        close_blob();
         file_.close();
         return false;
       }
       if (!autotran_ && !set_flag(FOPEN, true)) {
+        close_index();
+        close_blob();
+        file_.close();
+        return false;
+      }
+      if (!autotran_ && jnunit_ > 0) {
+        const std::string& jpath = path + File::EXTCHR + KCHDBJNLPATHEXT;
+        if (!jnfile_.open(jpath, File::OWRITER | File::OCREATE | File::ONOLOCK, 0)) {
+          set_error(_KCCODELINE_, Error::SYSTEM, jnfile_.error());
+          close_index();
+          close_blob();
+          file_.close();
+          return false;
+        }
+        jnopen_ = true;
+        if (!start_journal()) {
+          jnfile_.close();
+          jnopen_ = false;
+          close_index();
+          close_blob();
+          file_.close();
+          return false;
+        }
+      }
+      if (boopen_ && !defrag_blob_impl(INT64MAX)) {
+        if (jnopen_) {
+          jnfile_.close();
+          jnopen_ = false;
+        }
+        close_index();
+        close_blob();
         file_.close();
         return false;
       }
@@ -915,10 +1714,25 @@ class HashDB : public BasicDB {
       if (!dump_free_blocks()) err = true;
       if (!dump_meta()) err = true;
     }
+    if (!close_blob()) err = true;
+    if (!close_index()) err = true;
     if (!file_.close()) {
       set_error(_KCCODELINE_, Error::SYSTEM, file_.error());
       err = true;
     }
+    if (jnopen_) {
+      const std::string& jpath = jnfile_.path();
+      if (!jnfile_.close()) {
+        set_error(_KCCODELINE_, Error::SYSTEM, jnfile_.error());
+        err = true;
+      }
+      if (!err && !File::remove(jpath)) {
+        set_error(_KCCODELINE_, Error::SYSTEM, "removing the journal file failed");
+        err = true;
+      }
+      jnopen_ = false;
+      jnflags_.clear();
+    }
     fbp_.clear();
     omode_ = 0;
     path_.clear();
@@ -939,6 +1753,7 @@ class HashDB : public BasicDB {
   bool synchronize(bool hard = false, FileProcessor* proc = NULL,
                    ProgressChecker* checker = NULL) {
     _assert_(true);
+    Metrics::ScopedTimer mtimer(mtrc_, Metrics::SYNCHRONIZE);
     ScopedSpinRWLock lock(&mlock_, false);
     if (omode_ == 0) {
       set_error(_KCCODELINE_, Error::INVALID, "not opened");
@@ -992,7 +1807,7 @@ class HashDB : public BasicDB {
         mlock_.unlock();
         return false;
       }
-      if (!tran_) break;
+      if (!tran_ && txnum_ < 1) break;
       mlock_.unlock();
       if (wcnt >= LOCKBUSYLOOP) {
         Thread::chill();
@@ -1030,7 +1845,7 @@ class HashDB : public BasicDB {
       mlock_.unlock();
       return false;
     }
-    if (tran_) {
+    if (tran_ || txnum_ > 0) {
       set_error(_KCCODELINE_, Error::LOGIC, "competition avoided");
       mlock_.unlock();
       return false;
@@ -1052,6 +1867,7 @@ class HashDB : public BasicDB {
    */
   bool end_transaction(bool commit = true) {
     _assert_(true);
+    Metrics::ScopedTimer mtimer(commit ? mtrc_ : NULL, Metrics::COMMITTRAN);
     ScopedSpinRWLock lock(&mlock_, true);
     if (omode_ == 0) {
       set_error(_KCCODELINE_, Error::INVALID, "not opened");
@@ -1087,6 +1903,13 @@ class HashDB : public BasicDB {
       return false;
     }
     disable_cursors();
+    if (jnopen_) {
+      if (!jnfile_.truncate(0)) {
+        set_error(_KCCODELINE_, Error::SYSTEM, jnfile_.error());
+        return false;
+      }
+      jnsiz_ = 0;
+    }
     if (!file_.truncate(HEADSIZ)) {
       set_error(_KCCODELINE_, Error::SYSTEM, file_.error());
       return false;
@@ -1106,8 +1929,11 @@ class HashDB : public BasicDB {
       set_error(_KCCODELINE_, Error::SYSTEM, file_.error());
       err = true;
     }
+    if (bopen_ && !clear_blob()) err = true;
+    if (iopen_ && !init_index()) err = true;
     if (!dump_meta()) err = true;
     if (!autotran_ && !set_flag(FOPEN, true)) err = true;
+    if (jnopen_ && !start_journal()) err = true;
     trigger_meta(MetaTrigger::CLEAR, "clear");
     return true;
   }
@@ -1177,10 +2003,28 @@ class HashDB : public BasicDB {
     (*strmap)["msiz"] = strprintf("%lld", (long long)msiz_);
     (*strmap)["dfunit"] = strprintf("%lld", (long long)dfunit_);
     (*strmap)["frgcnt"] = strprintf("%lld", (long long)(frgcnt_ > 0 ? (int64_t)frgcnt_ : 0));
+    (*strmap)["sratio"] = strprintf("%.3f", sratio_);
+    (*strmap)["sgrow"] = strprintf("%lld", (long long)sgrow_);
+    (*strmap)["sfill"] = strprintf("%lld", (long long)sfill_);
     (*strmap)["realsize"] = strprintf("%lld", (long long)file_.size());
     (*strmap)["recovered"] = strprintf("%d", file_.recovered());
     (*strmap)["reorganized"] = strprintf("%d", reorg_);
     (*strmap)["trimmed"] = strprintf("%d", trim_);
+    (*strmap)["jnunit"] = strprintf("%lld", (long long)jnunit_);
+    (*strmap)["jnlrecovered"] = strprintf("%d", jnrec_);
+    if (bopen_) {
+      (*strmap)["bthres"] = strprintf("%lld", (long long)bthres_);
+      (*strmap)["bgen"] = strprintf("%lld", (long long)bgen_);
+      (*strmap)["bsize"] = strprintf("%lld", (long long)bsize_.get());
+      (*strmap)["blive"] = strprintf("%lld", (long long)std::max(blive_.get(), (int64_t)0));
+      (*strmap)["bgccnt"] = strprintf("%lld", (long long)bgccnt_);
+    }
+    if (iopen_) {
+      (*strmap)["ipnum"] = strprintf("%lld", (long long)ipnum_);
+      (*strmap)["islots"] = strprintf("%d", (int)islotnum_);
+      (*strmap)["idepth"] = strprintf("%d", (int)igdepth_);
+      (*strmap)["isplit"] = strprintf("%lld", (long long)isplitcnt_);
+    }
     if (strmap->count("opaque") > 0)
       (*strmap)["opaque"] = std::string(opaque_, sizeof(opaque_));
     if (strmap->count("fbpnum_used") > 0) {
@@ -1192,7 +2036,12 @@ class HashDB : public BasicDB {
         fbp_.clear();
       }
     }
-    if (strmap->count("bnum_used") > 0) {
+    if (strmap->count("padding") > 0) {
+      int64_t pdsiz;
+      if (!scan_padding(&pdsiz)) return false;
+      (*strmap)["padding"] = strprintf("%lld", (long long)pdsiz);
+    }
+    if (strmap->count("bnum_used") > 0 && !iopen_) {
       int64_t cnt = 0;
       for (int64_t i = 0; i < bnum_; i++) {
         if (get_bucket(i) > 0) cnt++;
@@ -1201,6 +2050,19 @@ class HashDB : public BasicDB {
     }
     (*strmap)["count"] = strprintf("%lld", (long long)count_);
     (*strmap)["size"] = strprintf("%lld", (long long)lsiz_);
+    if (mtrc_) {
+      mtrc_->status(strmap);
+      int64_t hit = mtrc_->get(MCHIT);
+      int64_t miss = mtrc_->get(MCMISS);
+      int64_t fbreuse = mtrc_->get(MCFBREUSE);
+      int64_t fbmiss = mtrc_->get(MCFBMISS);
+      (*strmap)["mt_hitrate"] =
+          strprintf("%.6f", hit + miss > 0 ? (double)hit / (hit + miss) : 0.0);
+      (*strmap)["mt_chainavg"] =
+          strprintf("%.3f", hit + miss > 0 ? (double)mtrc_->get(MCCHAIN) / (hit + miss) : 0.0);
+      (*strmap)["mt_fbreuserate"] =
+          strprintf("%.6f", fbreuse + fbmiss > 0 ? (double)fbreuse / (fbreuse + fbmiss) : 0.0);
+    }
     return true;
   }
   /**
@@ -1247,6 +2109,26 @@ class HashDB : public BasicDB {
     mtrigger_ = trigger;
     return true;
   }
+  /**
+   * Enable or disable the collection of runtime metrics.
+   * @param enabled true to collect metrics, or false not to.
+   * @return true on success, or false on failure.
+   * @note The collected metrics are reported by the status method with the prefix "mt_".
+   */
+  bool tune_metrics(bool enabled = true) {
+    _assert_(true);
+    ScopedSpinRWLock lock(&mlock_, true);
+    if (omode_ != 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "already opened");
+      return false;
+    }
+    static const char* const names[] = {
+      "hit", "miss", "chain", "fbreuse", "fbmiss", "walsize", "fsync", "fsynctime"
+    };
+    delete mtrc_;
+    mtrc_ = enabled ? new Metrics(names, MCNUM) : NULL;
+    return true;
+  }
   /**
    * Set the power of the alignment of record size.
    * @param apow the power of the alignment of record size.
@@ -1282,8 +2164,15 @@ class HashDB : public BasicDB {
   /**
    * Set the optional features.
    * @param opts the optional features by bitwise-or: HashDB::TSMALL to use 32-bit addressing,
-   * HashDB::TLINEAR to use linear collision chaining, HashDB::TCOMPRESS to compress each record.
+   * HashDB::TLINEAR to use linear collision chaining, HashDB::TCOMPRESS to compress each record,
+   * HashDB::TBLOB to store large values in the blob file, HashDB::TPAGE to use paged buckets in
+   * the index file.
    * @return true on success, or false on failure.
+   * @note With HashDB::TPAGE, the buckets are kept in fixed-size pages of a separate index file
+   * and each slot holds a tag of the hash value as well as the offset of the record, so that
+   * a lookup reads one bucket page and then the matching record only.  Overflowing pages are
+   * split by extendible hashing and the number of buckets is only a hint of the initial number
+   * of pages.
    */
   bool tune_options(int8_t opts) {
     _assert_(true);
@@ -1341,6 +2230,76 @@ class HashDB : public BasicDB {
     dfunit_ = dfunit > 0 ? dfunit : 0;
     return true;
   }
+  /**
+   * Set the region unit of the recovery journal.
+   * @param jnunit the size of each region whose pre-image is saved in the journal.  If it is not
+   * more than 0, the journal is not used.
+   * @return true on success, or false on failure.
+   * @note The journal keeps the original contents of the regions modified since the last
+   * synchronization.  If the database was not closed properly, the next opening as a writer
+   * restores the regions instead of reorganizing the whole file, which rolls the database back
+   * to the state at the last call of the synchronize method.  Each pre-image is synchronized with
+   * the device before the region is modified, and each synchronization of the database
+   * synchronizes the file with the device before starting a new journal.  The journal is not
+   * used with HashDB::OAUTOTRAN, which keeps the file consistent by itself.
+   */
+  bool tune_journal(int64_t jnunit) {
+    _assert_(true);
+    ScopedSpinRWLock lock(&mlock_, true);
+    if (omode_ != 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "already opened");
+      return false;
+    }
+    jnunit_ = jnunit > 0 ? jnunit : 0;
+    return true;
+  }
+  /**
+   * Set the tuning parameters of the blob file.
+   * @param bthres the threshold of the size of values stored in the blob file.  If it is not
+   * more than 0, the default value is specified.  The default value is 4096.
+   * @param bgcratio the ratio of live values under which the blob file is collected
+   * automatically.  If it is not more than 0, automatic collection is disabled.  The automatic
+   * collection proceeds by a few records at each update.
+   * @return true on success, or false on failure.
+   * @note This also enables HashDB::TBLOB.  Values whose size after compression is not less
+   * than the threshold are appended to the blob file beside the database file, whose name is
+   * suffixed with ".blob", and the records keep fixed-length references to them.  Updating and
+   * removing records leave garbage in the blob file, which is collected by the defrag_blob
+   * method.  The option is fixed at creation of the database while the threshold can be
+   * changed at every opening.
+   */
+  bool tune_blob(int64_t bthres, double bgcratio = 0.5) {
+    _assert_(true);
+    ScopedSpinRWLock lock(&mlock_, true);
+    if (omode_ != 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "already opened");
+      return false;
+    }
+    opts_ |= TBLOB;
+    bthres_ = bthres > 0 ? bthres : DEFBTHRES;
+    bgcratio_ = bgcratio > 0 ? bgcratio : 0;
+    return true;
+  }
+  /**
+   * Set the ratio of the slack space reserved for growing values.
+   * @param sratio the ratio of the slack space to the size of the value.  If it is not more than
+   * 0, no slack space is reserved.
+   * @return true on success, or false on failure.
+   * @note When a record is relocated because its value has grown, its padding is extended in
+   * proportion to the new value, up to about 32KB.  Appending to a record whose padding has
+   * enough room writes only the appended data and the header in place.  The ratio is not stored
+   * in the database and can be changed at every opening.
+   */
+  bool tune_slack(double sratio) {
+    _assert_(true);
+    ScopedSpinRWLock lock(&mlock_, true);
+    if (omode_ != 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "already opened");
+      return false;
+    }
+    sratio_ = sratio > 0 ? sratio : 0;
+    return true;
+  }
   /**
    * Set the data compressor.
    * @param comp the data compressor object.
@@ -1414,6 +2373,191 @@ class HashDB : public BasicDB {
     frgcnt_ = 0;
     return !err;
   }
+  /**
+   * Collect the garbage of the blob file.
+   * @return true on success, or false on failure.
+   * @note Live values are copied into a new blob file and the references in the records are
+   * rewritten in place.  The database is synchronized with the device before the new blob file
+   * replaces the old one.  If the process is interrupted, the next opening as a writer resumes
+   * it.  An automatic collection in progress is completed.  This does nothing if the database
+   * does not use the blob file.
+   */
+  bool defrag_blob() {
+    _assert_(true);
+    ScopedSpinRWLock lock(&mlock_, true);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
+    }
+    if (!writer_) {
+      set_error(_KCCODELINE_, Error::NOPERM, "permission denied");
+      return false;
+    }
+    if (tran_ || txnum_ > 0) {
+      set_error(_KCCODELINE_, Error::LOGIC, "competition avoided");
+      return false;
+    }
+    if (!bopen_) return true;
+    return defrag_blob_impl(INT64MAX);
+  }
+  /**
+   * Analyze the database and recommend tuning parameters.
+   * @param strmap a string map to contain the result.
+   * @param snum the number of buckets to be sampled.  If it is not more than 0, the default
+   * number is specified.
+   * @return true on success, or false on failure.
+   * @note Record sizes and chain lengths are measured by walking the sampled buckets, and the
+   * fragmentation is measured from the free block pool and the live data ratio.  Recommended
+   * values are stored with the prefix "rec_" and predicted effects with the prefix "est_".
+   * "rebuild" is set to "1" if the structural parameters of "bnum", "apow", or "fpow" should
+   * be changed by rebuilding the database.  "msiz" and "dfunit" can be applied just by opening
+   * the database again.
+   */
+  bool analyze(std::map<std::string, std::string>* strmap, int64_t snum = 0) {
+    _assert_(strmap);
+    ScopedSpinRWLock lock(&mlock_, true);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
+    }
+    if (snum < 1) snum = ANASMPNUM;
+    int64_t snmax = iopen_ ? (int64_t)idir_.size() : bnum_;
+    if (snum > snmax) snum = snmax;
+    int64_t step = snmax / snum;
+    std::vector<int64_t> ksizs, vsizs, chains;
+    int64_t rsum = 0;
+    int64_t psum = 0;
+    int64_t used = 0;
+    std::vector<int64_t> offs;
+    for (int64_t i = 0; i < snum; i++) {
+      int64_t chain = 0;
+      if (iopen_) {
+        if (!load_index_offsets(idir_[i * step], &offs)) return false;
+        if (!offs.empty()) used++;
+      } else {
+        int64_t off = get_bucket(i * step);
+        if (off < 0) return false;
+        if (off > 0) {
+          offs.push_back(off);
+          used++;
+        }
+      }
+      while (!offs.empty()) {
+        Record rec;
+        char rbuf[RECBUFSIZ];
+        rec.off = offs.back();
+        offs.pop_back();
+        if (!read_record(&rec, rbuf)) return false;
+        delete[] rec.bbuf;
+        if (rec.psiz == UINT16MAX) {
+          set_error(_KCCODELINE_, Error::BROKEN, "free block in the chain");
+          return false;
+        }
+        ksizs.push_back(rec.ksiz);
+        vsizs.push_back(rec.vsiz);
+        rsum += rec.rsiz;
+        psum += rec.psiz;
+        chain++;
+        if (rec.left > 0) offs.push_back(rec.left);
+        if (rec.right > 0) offs.push_back(rec.right);
+      }
+      chains.push_back(chain);
+    }
+    if (fbpnum_ > 0 && !writer_ && !load_free_blocks()) return false;
+    int64_t fbnum = fbp_.size();
+    int64_t fbsiz = 0;
+    for (FBP::const_iterator it = fbp_.begin(); it != fbp_.end(); ++it) {
+      fbsiz += it->rsiz;
+    }
+    if (!writer_) fbp_.clear();
+    int64_t rnum = ksizs.size();
+    store_size_stats("ksiz", &ksizs, strmap);
+    store_size_stats("vsiz", &vsizs, strmap);
+    store_size_stats("chain", &chains, strmap);
+    double rmean = rnum > 0 ? (double)rsum / rnum : 0;
+    double bodymean = rnum > 0 ? (double)(rsum - psum) / rnum : 0;
+    int64_t count = count_;
+    int64_t lsiz = lsiz_;
+    int64_t dsiz = lsiz - roff_;
+    double liveratio = dsiz > 0 ? count * rmean / dsiz : 1.0;
+    if (liveratio > 1.0) liveratio = 1.0;
+    (*strmap)["sample_buckets"] = strprintf("%lld", (long long)snum);
+    (*strmap)["sample_records"] = strprintf("%lld", (long long)rnum);
+    (*strmap)["bucket_usage"] = strprintf("%.6f", snum > 0 ? (double)used / snum : 0.0);
+    (*strmap)["load_factor"] = strprintf("%.3f", (double)count / bnum_);
+    (*strmap)["rsiz_mean"] = strprintf("%.3f", rmean);
+    (*strmap)["pad_ratio"] = strprintf("%.6f", rsum > 0 ? (double)psum / rsum : 0.0);
+    (*strmap)["free_blocks"] = strprintf("%lld", (long long)fbnum);
+    (*strmap)["free_size"] = strprintf("%lld", (long long)fbsiz);
+    (*strmap)["frag_ratio"] = strprintf("%.6f", 1.0 - liveratio);
+    (*strmap)["bnum"] = strprintf("%lld", (long long)bnum_);
+    (*strmap)["apow"] = strprintf("%u", apow_);
+    (*strmap)["fpow"] = strprintf("%u", fpow_);
+    (*strmap)["msiz"] = strprintf("%lld", (long long)msiz_);
+    (*strmap)["dfunit"] = strprintf("%lld", (long long)dfunit_);
+    (*strmap)["count"] = strprintf("%lld", (long long)count);
+    (*strmap)["size"] = strprintf("%lld", (long long)lsiz);
+    // twice as many buckets as records keeps chains short without wasting the bucket array
+    int64_t rbnum = bnum_;
+    if (!iopen_ && (bnum_ < count / 2 || bnum_ > count * 4)) {
+      rbnum = count * 2;
+      if (rbnum < ANAMINBNUM) rbnum = ANAMINBNUM;
+      if (rbnum > INT16MAX) rbnum = nearbyprime(rbnum);
+    }
+    // the alignment is kept below an eighth of the record body to bound the padding
+    int32_t rapow = apow_;
+    if (rnum > 0) {
+      rapow = 0;
+      while (rapow < MAXAPOW && (double)(1 << (rapow + 1)) <= bodymean / 8) {
+        rapow++;
+      }
+      if (opts_ & TSMALL) {
+        while (rapow < MAXAPOW && (uint64_t)(lsiz * 2 >> rapow) > UINT32MAX) {
+          rapow++;
+        }
+      }
+    }
+    // a larger pool helps if the pool overflows under heavy fragmentation
+    double fragratio = 1.0 - liveratio;
+    int32_t rfpow = fpow_;
+    if (fpow_ < 1) {
+      if (fragratio * 100 > ANAFRAGLOW) rfpow = DEFFPOW;
+    } else if (fbnum * 8 >= fbpnum_ * 7 && fragratio * 100 > ANAFRAGLOW) {
+      rfpow = fpow_ + 2;
+      if (rfpow > MAXFPOW) rfpow = MAXFPOW;
+    }
+    // mapping the whole file with some room for growth avoids system calls for reading
+    int64_t rmsiz = msiz_;
+    if (msiz_ < lsiz) {
+      rmsiz = lsiz + lsiz / 4;
+      rmsiz = (rmsiz + ANAMAPUNIT - 1) / ANAMAPUNIT * ANAMAPUNIT;
+    }
+    int64_t rdfunit = dfunit_;
+    if (fragratio * 100 > ANAFRAGHIGH) {
+      if (rdfunit < ANADFUNIT) rdfunit = ANADFUNIT;
+    } else if (fragratio * 100 > ANAFRAGLOW) {
+      if (rdfunit < 1) rdfunit = ANADFUNIT / 2;
+    }
+    (*strmap)["rec_bnum"] = strprintf("%lld", (long long)rbnum);
+    (*strmap)["rec_apow"] = strprintf("%d", rapow);
+    (*strmap)["rec_fpow"] = strprintf("%d", rfpow);
+    (*strmap)["rec_msiz"] = strprintf("%lld", (long long)rmsiz);
+    (*strmap)["rec_dfunit"] = strprintf("%lld", (long long)rdfunit);
+    (*strmap)["est_load_factor"] = strprintf("%.3f", (double)count / rbnum);
+    double rpad = (1 << rapow) / 2.0;
+    (*strmap)["est_pad_ratio"] = strprintf("%.6f", rnum > 0 ? rpad / (bodymean + rpad) : 0.0);
+    double mapratio = lsiz > 0 ? (double)msiz_ / lsiz : 1.0;
+    double rmapratio = lsiz > 0 ? (double)rmsiz / lsiz : 1.0;
+    (*strmap)["map_ratio"] = strprintf("%.6f", mapratio < 1.0 ? mapratio : 1.0);
+    (*strmap)["est_map_ratio"] = strprintf("%.6f", rmapratio < 1.0 ? rmapratio : 1.0);
+    bool rebuild = rbnum != bnum_ || rapow != apow_ || rfpow != fpow_;
+    double rsize = count * (bodymean + rpad) + HEADSIZ;
+    if (!iopen_) rsize += rbnum * width_;
+    if (rfpow > 0) rsize += (1 << rfpow) * FBPWIDTH;
+    (*strmap)["est_size"] = strprintf("%lld", (long long)rsize);
+    (*strmap)["rebuild"] = strprintf("%d", rebuild);
+    return true;
+  }
   /**
    * Get the status flags.
    * @return the status flags, or 0 on failure.
@@ -1670,11 +2814,11 @@ class HashDB : public BasicDB {
       set_error(_KCCODELINE_, Error::INVALID, "not opened");
       return NULL;
     }
-    return comp_;
+    return comp_ == &blbcomp_ ? blbcomp_.comp_ : comp_;
   }
   /**
    * Check whether the database was recovered or not.
-   * @return true if recovered, or false if not.
+   * @return true if recovered by the WAL file or the recovery journal, or false if not.
    */
   bool recovered() {
     _assert_(true);
@@ -1683,7 +2827,7 @@ class HashDB : public BasicDB {
       set_error(_KCCODELINE_, Error::INVALID, "not opened");
       return false;
     }
-    return file_.recovered();
+    return file_.recovered() || jnrec_;
   }
   /**
    * Check whether the database was reorganized or not.
@@ -1715,6 +2859,16 @@ class HashDB : public BasicDB {
     int64_t boff;                        ///< offset of the body
     char* bbuf;                          ///< buffer of the body
   };
+  /**
+   * Bucket page data.
+   */
+  struct IndexPage {
+    int64_t pno;                         ///< page number
+    int32_t depth;                       ///< local depth
+    int32_t num;                         ///< number of slots
+    int64_t next;                        ///< number of the next overflow page
+    char buf[IDXPGSIZ];                  ///< image of the page
+  };
   /**
    * Free block data.
    */
@@ -1759,6 +2913,43 @@ class HashDB : public BasicDB {
     const char* vbuf_;
     size_t vsiz_;
   };
+  /**
+   * Compressor to separate large values into the blob file.
+   */
+  class BlobCompressor : public Compressor {
+    friend class HashDB;
+   public:
+    /** constructor */
+    explicit BlobCompressor(HashDB* db) : db_(db), comp_(NULL) {
+      _assert_(db);
+    }
+   private:
+    /** compress a serial data */
+    char* compress(const void* buf, size_t size, size_t* sp) {
+      _assert_(buf && size <= MEMMAXSIZ && sp);
+      char* zbuf = NULL;
+      if (comp_) {
+        size_t zsiz;
+        zbuf = comp_->compress(buf, size, &zsiz);
+        if (!zbuf) return NULL;
+        buf = zbuf;
+        size = zsiz;
+      }
+      char* rbuf = new char[size+1];
+      *(uint8_t*)rbuf = BLBTAGINL;
+      std::memcpy(rbuf + 1, buf, size);
+      *sp = size + 1;
+      delete[] zbuf;
+      return rbuf;
+    }
+    /** decompress a serial data */
+    char* decompress(const void* buf, size_t size, size_t* sp) {
+      _assert_(buf && size <= MEMMAXSIZ && sp);
+      return db_->read_blob_value((const char*)buf, size, sp);
+    }
+    HashDB* db_;
+    Compressor* comp_;
+  };
   /**
    * Scoped visitor.
    */
@@ -1790,6 +2981,7 @@ class HashDB : public BasicDB {
   bool accept_impl(const char* kbuf, size_t ksiz, Visitor* visitor,
                    int64_t bidx, uint32_t pivot, bool isiter) {
     _assert_(kbuf && ksiz <= MEMMAXSIZ && visitor && bidx >= 0);
+    if (iopen_) return accept_page_impl(kbuf, ksiz, visitor, bidx, isiter);
     int64_t top = get_bucket(bidx);
     int64_t off = top;
     if (off < 0) return false;
@@ -1798,6 +2990,7 @@ class HashDB : public BasicDB {
     Record rec;
     char rbuf[RECBUFSIZ];
     while (off > 0) {
+      if (mtrc_) mtrc_->add(MCCHAIN);
       rec.off = off;
       if (!read_record(&rec, rbuf)) return false;
       if (rec.psiz == UINT16MAX) {
@@ -1847,6 +3040,7 @@ class HashDB : public BasicDB {
           }
           entoff = rec.off + sizeof(uint16_t) + width_;
         } else {
+          if (mtrc_) mtrc_->add(MCHIT);
           if (!rec.vbuf && !read_record_body(&rec)) {
             delete[] rec.bbuf;
             return false;
@@ -1855,7 +3049,7 @@ class HashDB : public BasicDB {
           size_t vsiz = rec.vsiz;
           char* zbuf = NULL;
           size_t zsiz = 0;
-          if (comp_) {
+          if (comp_ && !isiter) {
             zbuf = comp_->decompress(vbuf, vsiz, &zsiz);
             if (!zbuf) {
               set_error(_KCCODELINE_, Error::SYSTEM, "data decompression failed");
@@ -1876,6 +3070,7 @@ class HashDB : public BasicDB {
               }
               atran = true;
             }
+            release_blob_value(rec.vbuf, rec.vsiz);
             if (!write_free_block(rec.off, rec.rsiz, rbuf)) {
               if (atran) abort_auto_transaction();
               delete[] rec.bbuf;
@@ -1900,9 +3095,8 @@ class HashDB : public BasicDB {
             zbuf = NULL;
             zsiz = 0;
             if (comp_ && !isiter) {
-              zbuf = comp_->compress(vbuf, vsiz, &zsiz);
+              zbuf = compress_value(vbuf, vsiz, &zsiz);
               if (!zbuf) {
-                set_error(_KCCODELINE_, Error::SYSTEM, "data compression failed");
                 delete[] rec.bbuf;
                 return false;
               }
@@ -1918,6 +3112,7 @@ class HashDB : public BasicDB {
               }
               atran = true;
             }
+            release_blob_value(rec.vbuf, rec.vsiz);
             size_t rsiz = calc_record_size(rec.ksiz, vsiz);
             if (rsiz <= rec.rsiz) {
               rec.psiz = rec.rsiz - rsiz;
@@ -1940,7 +3135,7 @@ class HashDB : public BasicDB {
               }
               insert_free_block(rec.off, rec.rsiz);
               frgcnt_ += 1;
-              size_t psiz = calc_record_padding(rsiz);
+              size_t psiz = calc_growth_padding(rsiz, vsiz);
               rec.rsiz = rsiz + psiz;
               rec.psiz = psiz;
               rec.vsiz = vsiz;
@@ -1992,17 +3187,15 @@ class HashDB : public BasicDB {
         }
       }
     }
+    if (mtrc_) mtrc_->add(MCMISS);
     size_t vsiz;
     const char* vbuf = visitor->visit_empty(kbuf, ksiz, &vsiz);
     if (vbuf != Visitor::NOP && vbuf != Visitor::REMOVE) {
       char* zbuf = NULL;
       size_t zsiz = 0;
       if (comp_) {
-        zbuf = comp_->compress(vbuf, vsiz, &zsiz);
-        if (!zbuf) {
-          set_error(_KCCODELINE_, Error::SYSTEM, "data compression failed");
-          return false;
-        }
+        zbuf = compress_value(vbuf, vsiz, &zsiz);
+        if (!zbuf) return false;
         vbuf = zbuf;
         vsiz = zsiz;
       }
@@ -2087,18 +3280,567 @@ class HashDB : public BasicDB {
     return true;
   }
   /**
-   * Iterate to accept a visitor for each record.
+   * Accept a visitor to a record in the paged buckets.
+   * @param kbuf the pointer to the key region.
+   * @param ksiz the size of the key region.
    * @param visitor a visitor object.
-   * @param checker a progress checker object.
+   * @param bidx the number of the primary bucket page.
+   * @param isiter true for iterator use, or false for direct use.
    * @return true on success, or false on failure.
    */
-  bool iterate_impl(Visitor* visitor, ProgressChecker* checker) {
-    _assert_(visitor);
-    int64_t allcnt = count_;
-    if (checker && !checker->check("iterate", "beginning", 0, allcnt)) {
-      set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
-      return false;
-    }
+  bool accept_page_impl(const char* kbuf, size_t ksiz, Visitor* visitor,
+                        int64_t bidx, bool isiter) {
+    _assert_(kbuf && ksiz <= MEMMAXSIZ && visitor && bidx >= 0);
+    uint64_t hash = hash_record(kbuf, ksiz);
+    IndexPage page;
+    int32_t sidx;
+    int64_t rpno;
+    Record rec;
+    char rbuf[RECBUFSIZ];
+    if (!search_index(kbuf, ksiz, hash, bidx, &page, &sidx, &rpno, &rec, rbuf)) return false;
+    if (sidx >= 0) {
+      if (mtrc_) mtrc_->add(MCHIT);
+      if (!rec.vbuf && !read_record_body(&rec)) {
+        delete[] rec.bbuf;
+        return false;
+      }
+      const char* vbuf = rec.vbuf;
+      size_t vsiz = rec.vsiz;
+      char* zbuf = NULL;
+      size_t zsiz = 0;
+      if (comp_ && !isiter) {
+        zbuf = comp_->decompress(vbuf, vsiz, &zsiz);
+        if (!zbuf) {
+          set_error(_KCCODELINE_, Error::SYSTEM, "data decompression failed");
+          delete[] rec.bbuf;
+          return false;
+        }
+        vbuf = zbuf;
+        vsiz = zsiz;
+      }
+      vbuf = visitor->visit_full(kbuf, ksiz, vbuf, vsiz, &vsiz);
+      delete[] zbuf;
+      if (vbuf == Visitor::REMOVE) {
+        bool atran = false;
+        if (autotran_ && !tran_) {
+          if (!begin_auto_transaction()) {
+            delete[] rec.bbuf;
+            return false;
+          }
+          atran = true;
+        }
+        release_blob_value(rec.vbuf, rec.vsiz);
+        delete[] rec.bbuf;
+        if (!write_free_block(rec.off, rec.rsiz, rbuf) || !remove_index_slot(&page, sidx)) {
+          if (atran) abort_auto_transaction();
+          return false;
+        }
+        insert_free_block(rec.off, rec.rsiz);
+        frgcnt_ += 1;
+        count_ -= 1;
+        if (atran) {
+          if (!commit_auto_transaction()) return false;
+        } else if (autosync_) {
+          if (!synchronize_meta()) return false;
+        }
+      } else if (vbuf == Visitor::NOP) {
+        delete[] rec.bbuf;
+      } else {
+        zbuf = NULL;
+        zsiz = 0;
+        if (comp_ && !isiter) {
+          zbuf = compress_value(vbuf, vsiz, &zsiz);
+          if (!zbuf) {
+            delete[] rec.bbuf;
+            return false;
+          }
+          vbuf = zbuf;
+          vsiz = zsiz;
+        }
+        bool atran = false;
+        if (autotran_ && !tran_) {
+          if (!begin_auto_transaction()) {
+            delete[] zbuf;
+            delete[] rec.bbuf;
+            return false;
+          }
+          atran = true;
+        }
+        release_blob_value(rec.vbuf, rec.vsiz);
+        size_t rsiz = calc_record_size(rec.ksiz, vsiz);
+        bool err = false;
+        if (rsiz <= rec.rsiz) {
+          rec.psiz = rec.rsiz - rsiz;
+          rec.vsiz = vsiz;
+          rec.vbuf = vbuf;
+          if (!adjust_record(&rec) || !write_record(&rec, true)) err = true;
+        } else if (!write_free_block(rec.off, rec.rsiz, rbuf)) {
+          err = true;
+        } else {
+          insert_free_block(rec.off, rec.rsiz);
+          frgcnt_ += 1;
+          size_t psiz = calc_growth_padding(rsiz, vsiz);
+          rec.rsiz = rsiz + psiz;
+          rec.psiz = psiz;
+          rec.vsiz = vsiz;
+          rec.vbuf = vbuf;
+          bool over = false;
+          FreeBlock fb;
+          if (!isiter && fetch_free_block(rec.rsiz, &fb)) {
+            rec.off = fb.off;
+            rec.rsiz = fb.rsiz;
+            rec.psiz = rec.rsiz - rsiz;
+            over = true;
+            if (!adjust_record(&rec)) err = true;
+          } else {
+            rec.off = lsiz_.add(rec.rsiz);
+          }
+          if (!err && !write_record(&rec, over)) err = true;
+          if (!err) {
+            if (!over) psiz_.secure_least(rec.off + rec.rsiz);
+            set_index_slot(&page, sidx, hash, rec.off);
+            if (!write_index_page(&page)) err = true;
+          }
+        }
+        delete[] zbuf;
+        delete[] rec.bbuf;
+        if (err) {
+          if (atran) abort_auto_transaction();
+          return false;
+        }
+        if (atran) {
+          if (!commit_auto_transaction()) return false;
+        } else if (autosync_) {
+          if (!synchronize_meta()) return false;
+        }
+      }
+      return true;
+    }
+    if (mtrc_) mtrc_->add(MCMISS);
+    size_t vsiz;
+    const char* vbuf = visitor->visit_empty(kbuf, ksiz, &vsiz);
+    if (vbuf != Visitor::NOP && vbuf != Visitor::REMOVE) {
+      char* zbuf = NULL;
+      size_t zsiz = 0;
+      if (comp_) {
+        zbuf = compress_value(vbuf, vsiz, &zsiz);
+        if (!zbuf) return false;
+        vbuf = zbuf;
+        vsiz = zsiz;
+      }
+      bool atran = false;
+      if (autotran_ && !tran_) {
+        if (!begin_auto_transaction()) {
+          delete[] zbuf;
+          return false;
+        }
+        atran = true;
+      }
+      size_t rsiz = calc_record_size(ksiz, vsiz);
+      size_t psiz = calc_record_padding(rsiz);
+      rec.rsiz = rsiz + psiz;
+      rec.psiz = psiz;
+      rec.ksiz = ksiz;
+      rec.vsiz = vsiz;
+      rec.left = 0;
+      rec.right = 0;
+      rec.kbuf = kbuf;
+      rec.vbuf = vbuf;
+      bool err = false;
+      bool over = false;
+      FreeBlock fb;
+      if (fetch_free_block(rec.rsiz, &fb)) {
+        rec.off = fb.off;
+        rec.rsiz = fb.rsiz;
+        rec.psiz = rec.rsiz - rsiz;
+        over = true;
+        if (!adjust_record(&rec)) err = true;
+      } else {
+        rec.off = lsiz_.add(rec.rsiz);
+      }
+      if (!err && !write_record(&rec, over)) err = true;
+      if (!err) {
+        if (!over) psiz_.secure_least(rec.off + rec.rsiz);
+        if (!add_index_slot(hash, rec.off, &page, rpno)) err = true;
+      }
+      delete[] zbuf;
+      if (err) {
+        if (atran) abort_auto_transaction();
+        return false;
+      }
+      count_ += 1;
+      if (atran) {
+        if (!commit_auto_transaction()) return false;
+      } else if (autosync_) {
+        if (!synchronize_meta()) return false;
+      }
+    }
+    return true;
+  }
+  /**
+   * Check whether parts of values can be accessed in the files directly.
+   * @return true if values are stored as they are, or false if they are compressed.
+   */
+  bool check_range_access() {
+    _assert_(true);
+    return !comp_ || (comp_ == &blbcomp_ && !blbcomp_.comp_);
+  }
+  /**
+   * Find the record of a key.
+   * @param kbuf the pointer to the key region.
+   * @param ksiz the size of the key region.
+   * @param bidx the bucket index.
+   * @param pivot the second hash value.
+   * @param rec the record structure into which the found record is read.
+   * @param rbuf the working buffer of the record.
+   * @return true on success, or false on failure.
+   * @note If no record corresponds to the key, the offset of the record structure is set to 0.
+   */
+  bool find_record(const char* kbuf, size_t ksiz, int64_t bidx, uint32_t pivot,
+                   Record* rec, char* rbuf) {
+    _assert_(kbuf && ksiz <= MEMMAXSIZ && bidx >= 0 && rec && rbuf);
+    if (iopen_) {
+      IndexPage page;
+      int32_t sidx;
+      int64_t rpno;
+      if (!search_index(kbuf, ksiz, hash_record(kbuf, ksiz), bidx, &page, &sidx, &rpno,
+                        rec, rbuf)) return false;
+      if (sidx < 0) {
+        if (mtrc_) mtrc_->add(MCMISS);
+        rec->off = 0;
+      } else if (mtrc_) {
+        mtrc_->add(MCHIT);
+      }
+      return true;
+    }
+    int64_t off = get_bucket(bidx);
+    if (off < 0) return false;
+    while (off > 0) {
+      if (mtrc_) mtrc_->add(MCCHAIN);
+      rec->off = off;
+      if (!read_record(rec, rbuf)) return false;
+      if (rec->psiz == UINT16MAX) {
+        set_error(_KCCODELINE_, Error::BROKEN, "free block in the chain");
+        report(_KCCODELINE_, Logger::WARN, "psiz=%lld off=%lld fsiz=%lld",
+               (long long)psiz_, (long long)rec->off, (long long)file_.size());
+        return false;
+      }
+      uint32_t tpivot = linear_ ? pivot : fold_hash(hash_record(rec->kbuf, rec->ksiz));
+      int32_t kcmp;
+      if (pivot > tpivot) {
+        kcmp = 1;
+      } else if (pivot < tpivot) {
+        kcmp = -1;
+      } else {
+        kcmp = compare_keys(kbuf, ksiz, rec->kbuf, rec->ksiz);
+        if (kcmp == 0) {
+          if (mtrc_) mtrc_->add(MCHIT);
+          return true;
+        }
+        if (linear_) kcmp = 1;
+      }
+      delete[] rec->bbuf;
+      off = kcmp > 0 ? rec->left : rec->right;
+    }
+    if (mtrc_) mtrc_->add(MCMISS);
+    rec->off = 0;
+    return true;
+  }
+  /**
+   * Locate the region of the value of a record.
+   * @param rec the record structure.
+   * @param fp the pointer to the variable into which the file of the value is assigned.
+   * @param op the pointer to the variable into which the offset of the value is assigned.
+   * @param sp the pointer to the variable into which the size of the value is assigned.
+   * @param mp the pointer to the variable into which the pointer to the value is assigned if
+   * it has been read in the record structure, or NULL is assigned if not.
+   * @return true on success, or false on failure.
+   * @note The values must not be compressed.  A value separated by the blob file is located
+   * in the blob file.
+   */
+  bool locate_value(Record* rec, File** fp, int64_t* op, int64_t* sp, const char** mp) {
+    _assert_(rec && fp && op && sp && mp);
+    *fp = &file_;
+    *op = rec->boff + rec->ksiz;
+    *sp = rec->vsiz;
+    *mp = rec->vbuf;
+    if (comp_ != &blbcomp_) return true;
+    size_t tsiz = rec->vsiz < BLBREFSIZ ? rec->vsiz : BLBREFSIZ;
+    if (tsiz < 1) {
+      set_error(_KCCODELINE_, Error::BROKEN, "invalid stored value");
+      report(_KCCODELINE_, Logger::WARN, "off=%lld", (long long)rec->off);
+      return false;
+    }
+    char tbuf[BLBREFSIZ];
+    const char* rp = rec->vbuf;
+    if (!rp) {
+      if (!file_.read_fast(*op, tbuf, tsiz)) {
+        set_error(_KCCODELINE_, Error::SYSTEM, file_.error());
+        return false;
+      }
+      rp = tbuf;
+    }
+    if (*(uint8_t*)rp == BLBTAGINL) {
+      *op += 1;
+      *sp -= 1;
+      if (*mp) *mp += 1;
+      return true;
+    }
+    int64_t gen, off, size;
+    if (!parse_blob_ref(rp, rec->vsiz, &gen, &off, &size)) {
+      set_error(_KCCODELINE_, Error::BROKEN, "invalid stored value");
+      report(_KCCODELINE_, Logger::WARN, "off=%lld", (long long)rec->off);
+      return false;
+    }
+    File* file = NULL;
+    if (bopen_ && gen == bgen_) {
+      file = &bfile_;
+    } else if (boopen_ && gen == bogen_) {
+      file = &bofile_;
+    } else {
+      set_error(_KCCODELINE_, Error::BROKEN, "missing blob generation");
+      report(_KCCODELINE_, Logger::WARN, "gen=%lld", (long long)gen);
+      return false;
+    }
+    if (off < BLBHEADSIZ || off + size > file->size()) {
+      set_error(_KCCODELINE_, Error::BROKEN, "invalid blob reference");
+      report(_KCCODELINE_, Logger::WARN, "off=%lld size=%lld", (long long)off, (long long)size);
+      return false;
+    }
+    *fp = file;
+    *op = off;
+    *sp = size;
+    *mp = NULL;
+    return true;
+  }
+  /**
+   * Retrieve a part of the value of a record.
+   * @param kbuf the pointer to the key region.
+   * @param ksiz the size of the key region.
+   * @param off the offset in the value where the part begins.
+   * @param vbuf the pointer to the buffer into which the part of the value is written.
+   * @param max the size of the buffer.
+   * @param bidx the bucket index.
+   * @param pivot the second hash value.
+   * @return the size of the written part, or -1 on failure.
+   */
+  int64_t get_range_impl(const char* kbuf, size_t ksiz, int64_t off, char* vbuf, size_t max,
+                         int64_t bidx, uint32_t pivot) {
+    _assert_(kbuf && ksiz <= MEMMAXSIZ && off >= 0 && vbuf && bidx >= 0);
+    Metrics::ScopedTimer mtimer(mtrc_, Metrics::ACCEPT);
+    Record rec;
+    char rbuf[RECBUFSIZ];
+    if (!find_record(kbuf, ksiz, bidx, pivot, &rec, rbuf)) return -1;
+    if (rec.off < 1) {
+      set_error(_KCCODELINE_, Error::NOREC, "no record");
+      return -1;
+    }
+    File* file;
+    int64_t voff, vsiz;
+    const char* mbuf;
+    int64_t rsiz = -1;
+    if (locate_value(&rec, &file, &voff, &vsiz, &mbuf)) {
+      rsiz = off < vsiz ? std::min(vsiz - off, (int64_t)max) : 0;
+      if (rsiz < 1) {
+        rsiz = 0;
+      } else if (mbuf) {
+        std::memcpy(vbuf, mbuf + off, rsiz);
+      } else if (file == &file_ ? !file_.read_fast(voff + off, vbuf, rsiz) :
+                 !file->read(voff + off, vbuf, rsiz)) {
+        set_error(_KCCODELINE_, Error::SYSTEM, file->error());
+        report(_KCCODELINE_, Logger::WARN, "off=%lld size=%lld",
+               (long long)(voff + off), (long long)rsiz);
+        rsiz = -1;
+      }
+    }
+    delete[] rec.bbuf;
+    return rsiz;
+  }
+  /**
+   * Overwrite a part of the value of a record in place.
+   * @param kbuf the pointer to the key region.
+   * @param ksiz the size of the key region.
+   * @param off the offset in the value where the part begins.
+   * @param vbuf the pointer to the region of the part.
+   * @param vsiz the size of the region of the part.
+   * @param bidx the bucket index.
+   * @param pivot the second hash value.
+   * @param hp the pointer to the variable into which whether the part was written is assigned.
+   * @return true on success, or false on failure.
+   * @note If the record does not exist or the part is not within the value, nothing is written
+   * and false is assigned to the variable of the second result.
+   */
+  bool write_range_impl(const char* kbuf, size_t ksiz, int64_t off, const char* vbuf,
+                        size_t vsiz, int64_t bidx, uint32_t pivot, bool* hp) {
+    _assert_(kbuf && ksiz <= MEMMAXSIZ && off >= 0 && vbuf && vsiz <= MEMMAXSIZ &&
+             bidx >= 0 && hp);
+    Metrics::ScopedTimer mtimer(mtrc_, Metrics::ACCEPT);
+    *hp = false;
+    Record rec;
+    char rbuf[RECBUFSIZ];
+    if (!find_record(kbuf, ksiz, bidx, pivot, &rec, rbuf)) return false;
+    if (rec.off < 1) return true;
+    File* file;
+    int64_t voff, rvsiz;
+    const char* mbuf;
+    bool err = false;
+    if (!locate_value(&rec, &file, &voff, &rvsiz, &mbuf)) err = true;
+    delete[] rec.bbuf;
+    if (err) return false;
+    if (off + (int64_t)vsiz > rvsiz) return true;
+    if (file != &file_ && (file != &bfile_ || tran_ || autotran_ || jnopen_)) return true;
+    *hp = true;
+    if (vsiz < 1) return true;
+    if (file == &bfile_) {
+      if (!bfile_.write(voff + off, vbuf, vsiz) || (autosync_ && !bfile_.synchronize(true))) {
+        set_error(_KCCODELINE_, Error::SYSTEM, bfile_.error());
+        return false;
+      }
+      return true;
+    }
+    bool atran = false;
+    if (autotran_ && !tran_) {
+      if (!begin_auto_transaction()) return false;
+      atran = true;
+    }
+    if (!journal_region(voff + off, vsiz)) {
+      err = true;
+    } else if (!file_.write_fast(voff + off, vbuf, vsiz)) {
+      set_error(_KCCODELINE_, Error::SYSTEM, file_.error());
+      err = true;
+    }
+    if (atran) {
+      if (err) {
+        abort_auto_transaction();
+      } else if (!commit_auto_transaction()) {
+        err = true;
+      }
+    } else if (!err && autosync_) {
+      if (!synchronize_meta()) err = true;
+    }
+    return !err;
+  }
+  /**
+   * Append a value into the padding of a record in place.
+   * @param kbuf the pointer to the key region.
+   * @param ksiz the size of the key region.
+   * @param vbuf the pointer to the value region.
+   * @param vsiz the size of the value region.
+   * @param bidx the bucket index.
+   * @param pivot the second hash value.
+   * @param hp the pointer to the variable into which whether the value was appended is
+   * assigned.
+   * @return true on success, or false on failure.
+   * @note If the record does not exist, the padding is too small, the value is in the blob
+   * file, or the length of the size field of the value changes, nothing is written and false
+   * is assigned to the variable of the second result.
+   */
+  bool append_impl(const char* kbuf, size_t ksiz, const char* vbuf, size_t vsiz,
+                   int64_t bidx, uint32_t pivot, bool* hp) {
+    _assert_(kbuf && ksiz <= MEMMAXSIZ && vbuf && vsiz <= MEMMAXSIZ && bidx >= 0 && hp);
+    Metrics::ScopedTimer mtimer(mtrc_, Metrics::ACCEPT);
+    *hp = false;
+    Record rec;
+    char rbuf[RECBUFSIZ];
+    if (!find_record(kbuf, ksiz, bidx, pivot, &rec, rbuf)) return false;
+    if (rec.off < 1) return true;
+    File* file;
+    int64_t voff, osiz;
+    const char* mbuf;
+    bool err = false;
+    if (!locate_value(&rec, &file, &voff, &osiz, &mbuf)) err = true;
+    delete[] rec.bbuf;
+    if (err) return false;
+    if (file != &file_ || vsiz > rec.psiz) return true;
+    if (comp_ == &blbcomp_ && bopen_ && osiz + (int64_t)vsiz >= bthres_) return true;
+    size_t psiz = rec.psiz - vsiz;
+    char hbuf[RECBUFSIZ];
+    char* wp = hbuf;
+    uint16_t snum = hton16(psiz);
+    std::memcpy(wp, &snum, sizeof(snum));
+    if (psiz < 0x100) *wp = RECMAGIC;
+    wp += sizeof(snum);
+    writefixnum(wp, rec.left >> apow_, width_);
+    wp += width_;
+    if (!linear_) {
+      writefixnum(wp, rec.right >> apow_, width_);
+      wp += width_;
+    }
+    wp += writevarnum(wp, rec.ksiz);
+    wp += writevarnum(wp, rec.vsiz + vsiz);
+    size_t hsiz = wp - hbuf;
+    if (rec.off + (int64_t)hsiz != rec.boff) return true;
+    *hp = true;
+    if (vsiz < 1) return true;
+    int64_t toff = rec.boff + rec.ksiz + rec.vsiz;
+    size_t tsiz = vsiz;
+    if (psiz > 0) tsiz++;
+    char stack[IOBUFSIZ];
+    char* tbuf = tsiz > sizeof(stack) ? new char[tsiz] : stack;
+    std::memcpy(tbuf, vbuf, vsiz);
+    if (psiz > 0) tbuf[vsiz] = PADMAGIC;
+    bool atran = false;
+    if (autotran_ && !tran_) {
+      if (!begin_auto_transaction()) {
+        if (tbuf != stack) delete[] tbuf;
+        return false;
+      }
+      atran = true;
+    }
+    if (!journal_region(rec.off, hsiz) || !journal_region(toff, tsiz)) {
+      err = true;
+    } else if (!file_.write_fast(toff, tbuf, tsiz) || !file_.write_fast(rec.off, hbuf, hsiz)) {
+      set_error(_KCCODELINE_, Error::SYSTEM, file_.error());
+      err = true;
+    }
+    if (tbuf != stack) delete[] tbuf;
+    if (atran) {
+      if (err) {
+        abort_auto_transaction();
+      } else if (!commit_auto_transaction()) {
+        err = true;
+      }
+    } else if (!err && autosync_) {
+      if (!synchronize_meta()) err = true;
+    }
+    if (!err) sfill_ += vsiz;
+    return !err;
+  }
+  /**
+   * Calculate the total size of the padding of all records.
+   * @param sp the pointer to the variable into which the total size is assigned.
+   * @return true on success, or false on failure.
+   */
+  bool scan_padding(int64_t* sp) {
+    _assert_(sp);
+    int64_t sum = 0;
+    int64_t off = roff_;
+    int64_t end = lsiz_;
+    Record rec;
+    char rbuf[RECBUFSIZ];
+    while (off < end) {
+      rec.off = off;
+      if (!read_record(&rec, rbuf)) return false;
+      if (rec.psiz != UINT16MAX) sum += rec.psiz;
+      delete[] rec.bbuf;
+      off += rec.rsiz;
+    }
+    *sp = sum;
+    return true;
+  }
+  /**
+   * Iterate to accept a visitor for each record.
+   * @param visitor a visitor object.
+   * @param checker a progress checker object.
+   * @return true on success, or false on failure.
+   */
+  bool iterate_impl(Visitor* visitor, ProgressChecker* checker) {
+    _assert_(visitor);
+    int64_t allcnt = count_;
+    if (checker && !checker->check("iterate", "beginning", 0, allcnt)) {
+      set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
+      return false;
+    }
     int64_t off = roff_;
     int64_t end = lsiz_;
     Record rec;
@@ -2133,7 +3875,7 @@ class HashDB : public BasicDB {
         if (vbuf == Visitor::REMOVE) {
           uint64_t hash = hash_record(rec.kbuf, rec.ksiz);
           uint32_t pivot = fold_hash(hash);
-          int64_t bidx = hash % bnum_;
+          int64_t bidx = bucket_index(hash);
           Repeater repeater(Visitor::REMOVE, 0);
           if (!accept_impl(rec.kbuf, rec.ksiz, &repeater, bidx, pivot, true)) {
             delete[] rec.bbuf;
@@ -2146,9 +3888,8 @@ class HashDB : public BasicDB {
           zbuf = NULL;
           zsiz = 0;
           if (comp_) {
-            zbuf = comp_->compress(vbuf, vsiz, &zsiz);
+            zbuf = compress_value(vbuf, vsiz, &zsiz);
             if (!zbuf) {
-              set_error(_KCCODELINE_, Error::SYSTEM, "data compression failed");
               delete[] rec.bbuf;
               return false;
             }
@@ -2157,6 +3898,7 @@ class HashDB : public BasicDB {
           }
           size_t rsiz = calc_record_size(rec.ksiz, vsiz);
           if (rsiz <= rec.rsiz) {
+            release_blob_value(rec.vbuf, rec.vsiz);
             rec.psiz = rec.rsiz - rsiz;
             rec.vsiz = vsiz;
             rec.vbuf = vbuf;
@@ -2170,7 +3912,7 @@ class HashDB : public BasicDB {
           } else {
             uint64_t hash = hash_record(rec.kbuf, rec.ksiz);
             uint32_t pivot = fold_hash(hash);
-            int64_t bidx = hash % bnum_;
+            int64_t bidx = bucket_index(hash);
             Repeater repeater(vbuf, vsiz);
             if (!accept_impl(rec.kbuf, rec.ksiz, &repeater, bidx, pivot, true)) {
               delete[] zbuf;
@@ -2216,12 +3958,17 @@ class HashDB : public BasicDB {
         set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
         return false;
       }
+      if (bopen_ && !synchronize_blob(hard)) err = true;
+      if (iopen_ && !ifile_.synchronize(hard)) {
+        set_error(_KCCODELINE_, Error::SYSTEM, ifile_.error());
+        err = true;
+      }
       if (!dump_meta()) err = true;
       if (checker && !checker->check("synchronize", "synchronizing the file", -1, -1)) {
         set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
         return false;
       }
-      if (!file_.synchronize(hard)) {
+      if (!synchronize_file(hard)) {
         set_error(_KCCODELINE_, Error::SYSTEM, file_.error());
         err = true;
       }
@@ -2237,6 +3984,7 @@ class HashDB : public BasicDB {
       }
     }
     if (writer_ && !autotran_ && !set_flag(FOPEN, true)) err = true;
+    if (jnopen_ && !tran_ && !err && !start_journal()) err = true;
     return !err;
   }
   /**
@@ -2247,11 +3995,707 @@ class HashDB : public BasicDB {
     _assert_(true);
     ScopedSpinLock lock(&flock_);
     bool err = false;
+    if (bopen_ && !synchronize_blob(true)) err = true;
     if (!dump_meta()) err = true;
-    if (!file_.synchronize(true)) {
+    if (!synchronize_file(true)) {
+      set_error(_KCCODELINE_, Error::SYSTEM, file_.error());
+      err = true;
+    }
+    return !err;
+  }
+  /**
+   * Synchronize the file with the file system or the device.
+   * @param hard true for physical synchronization with the device, or false for logical
+   * synchronization with the file system.
+   * @return true on success, or false on failure.
+   */
+  bool synchronize_file(bool hard) {
+    _assert_(true);
+    if (!mtrc_ || !hard) return file_.synchronize(hard);
+    double stime = time();
+    bool rv = file_.synchronize(true);
+    mtrc_->add(MCFSYNC);
+    mtrc_->add(MCFSYNCTIME, (int64_t)((time() - stime) * 1000000));
+    return rv;
+  }
+  /**
+   * Start a new epoch of the recovery journal.
+   * @return true on success, or false on failure.
+   * @note The current state of the file is regarded as the restoration point.  The file is
+   * synchronized with the device before the journal of the former epoch is discarded, and the
+   * new journal is synchronized before any region is modified.  No other thread may modify the
+   * file meanwhile.
+   */
+  bool start_journal() {
+    _assert_(true);
+    if (!synchronize_file(true)) {
+      set_error(_KCCODELINE_, Error::SYSTEM, file_.error());
+      return false;
+    }
+    jnlock_.lock_all();
+    char head[JNLHEADSIZ];
+    std::memset(head, 0, sizeof(head));
+    std::memcpy(head, KCHDBJNLMAGICDATA, sizeof(KCHDBJNLMAGICDATA));
+    writefixnum(head + sizeof(uint64_t), lsiz_, sizeof(uint64_t));
+    bool err = false;
+    if (!jnfile_.truncate(0) || !jnfile_.write(0, head, sizeof(head)) ||
+        !jnfile_.synchronize(true)) {
+      set_error(_KCCODELINE_, Error::SYSTEM, jnfile_.error());
+      err = true;
+    }
+    jnsiz_ = lsiz_;
+    jnflags_.clear();
+    jnflags_.resize(jnsiz_ / jnunit_ / 64 + 1);
+    jnlock_.unlock_all();
+    return !err;
+  }
+  /**
+   * Save the pre-images of the regions to be modified into the recovery journal.
+   * @param off the offset of the modified region.
+   * @param size the size of the modified region.
+   * @return true on success, or false on failure.
+   * @note Each region unit is saved once in an epoch and the area beyond the restoration point
+   * is not saved because it is just cut off on recovery.  The journal is synchronized with the
+   * device before returning so that the pre-image is durable before the region is modified.
+   */
+  bool journal_region(int64_t off, int64_t size) {
+    _assert_(off >= 0);
+    if (!jnopen_) return true;
+    int64_t end = off + size;
+    if (end > jnsiz_) end = jnsiz_;
+    if (off >= end) return true;
+    bool err = false;
+    for (int64_t zidx = off / jnunit_; !err && zidx * jnunit_ < end; zidx++) {
+      AtomicInt64& flags = jnflags_[zidx/64];
+      int64_t mask = 1LL << (zidx % 64);
+      if (flags.get() & mask) continue;
+      size_t lidx = zidx % JNLLOCKSLOT;
+      jnlock_.lock(lidx);
+      if (!(flags.get() & mask)) {
+        if (save_journal_region(zidx)) {
+          flags.add(mask);
+        } else {
+          err = true;
+        }
+      }
+      jnlock_.unlock(lidx);
+    }
+    return !err;
+  }
+  /**
+   * Save the pre-image of a region unit into the recovery journal.
+   * @param zidx the index of the region unit.
+   * @return true on success, or false on failure.
+   */
+  bool save_journal_region(int64_t zidx) {
+    _assert_(zidx >= 0);
+    int64_t zoff = zidx * jnunit_;
+    int64_t zsiz = std::min(jnunit_, std::min((int64_t)jnsiz_, file_.size()) - zoff);
+    if (zsiz < 1) return true;
+    bool err = false;
+    char* rbuf = new char[JNLRHSIZ+zsiz];
+    char* data = rbuf + JNLRHSIZ;
+    if (file_.read_fast(zoff, data, zsiz)) {
+      char* wp = rbuf;
+      *(wp++) = JNLMAGIC;
+      writefixnum(wp, zoff, sizeof(uint64_t));
+      wp += sizeof(uint64_t);
+      writefixnum(wp, zsiz, sizeof(uint64_t));
+      wp += sizeof(uint64_t);
+      writefixnum(wp, hashmurmur(data, zsiz), sizeof(uint32_t));
+      if (!jnfile_.append(rbuf, JNLRHSIZ + zsiz) || !jnfile_.synchronize(true)) {
+        set_error(_KCCODELINE_, Error::SYSTEM, jnfile_.error());
+        err = true;
+      }
+    } else {
+      set_error(_KCCODELINE_, Error::SYSTEM, file_.error());
+      report(_KCCODELINE_, Logger::WARN, "psiz=%lld off=%lld fsiz=%lld",
+             (long long)psiz_, (long long)zoff, (long long)file_.size());
+      err = true;
+    }
+    delete[] rbuf;
+    return !err;
+  }
+  /**
+   * Restore the file by the recovery journal.
+   * @param path the path of the database file.
+   * @return true on success, or false on failure.
+   * @note The recovery is regarded as complete only if every entry up to the end of the journal
+   * is valid and the file covers the restoration point.  Otherwise, the journal is discarded
+   * after the valid entries are written back, and the reorganization is left to the caller.
+   */
+  bool recover_journal(const std::string& path) {
+    _assert_(true);
+    const std::string& jpath = path + File::EXTCHR + KCHDBJNLPATHEXT;
+    if (!File::status(jpath)) return true;
+    uint8_t flags;
+    if (file_.size() < HEADSIZ) return true;
+    if (!file_.read(MOFFFLAGS, &flags, sizeof(flags))) {
+      set_error(_KCCODELINE_, Error::SYSTEM, file_.error());
+      return false;
+    }
+    if (!(flags & FOPEN)) {
+      if (!File::remove(jpath)) {
+        set_error(_KCCODELINE_, Error::SYSTEM, "removing the journal file failed");
+        return false;
+      }
+      return true;
+    }
+    File jfile;
+    if (!jfile.open(jpath, File::OREADER | File::ONOLOCK, 0)) {
+      set_error(_KCCODELINE_, Error::SYSTEM, jfile.error());
+      return false;
+    }
+    int64_t jsiz = jfile.size();
+    char head[JNLHEADSIZ];
+    if (jsiz < JNLHEADSIZ || !jfile.read(0, head, sizeof(head)) ||
+        std::memcmp(head, KCHDBJNLMAGICDATA, sizeof(KCHDBJNLMAGICDATA))) {
+      report(_KCCODELINE_, Logger::WARN, "ignoring the broken journal file");
+      jfile.close();
+      if (!File::remove(jpath)) {
+        set_error(_KCCODELINE_, Error::SYSTEM, "removing the journal file failed");
+        return false;
+      }
+      return true;
+    }
+    int64_t lsiz = readfixnum(head + sizeof(uint64_t), sizeof(uint64_t));
+    report(_KCCODELINE_, Logger::WARN, "recovering the database by the journal file");
+    bool err = false;
+    int64_t rnum = 0;
+    int64_t off = JNLHEADSIZ;
+    char rhead[JNLRHSIZ];
+    while (!err && off + JNLRHSIZ <= jsiz) {
+      if (!jfile.read(off, rhead, sizeof(rhead))) {
+        set_error(_KCCODELINE_, Error::SYSTEM, jfile.error());
+        err = true;
+        break;
+      }
+      const char* rp = rhead;
+      if (*(uint8_t*)(rp++) != JNLMAGIC) break;
+      int64_t roff = readfixnum(rp, sizeof(uint64_t));
+      rp += sizeof(uint64_t);
+      int64_t rsiz = readfixnum(rp, sizeof(uint64_t));
+      rp += sizeof(uint64_t);
+      uint32_t hash = readfixnum(rp, sizeof(uint32_t));
+      if (roff < 0 || rsiz < 1 || rsiz > jsiz - off - JNLRHSIZ) break;
+      char* rbuf = new char[rsiz];
+      if (!jfile.read(off + JNLRHSIZ, rbuf, rsiz)) {
+        set_error(_KCCODELINE_, Error::SYSTEM, jfile.error());
+        err = true;
+      } else if (((uint32_t)hashmurmur(rbuf, rsiz)) == hash) {
+        if (!file_.write(roff, rbuf, rsiz)) {
+          set_error(_KCCODELINE_, Error::SYSTEM, file_.error());
+          err = true;
+        }
+        rnum++;
+      } else {
+        delete[] rbuf;
+        break;
+      }
+      delete[] rbuf;
+      off += JNLRHSIZ + rsiz;
+    }
+    if (!jfile.close()) {
+      set_error(_KCCODELINE_, Error::SYSTEM, jfile.error());
+      err = true;
+    }
+    if (err) return false;
+    if (off != jsiz || file_.size() < lsiz) {
+      report(_KCCODELINE_, Logger::WARN, "the journal file is incomplete: lsiz=%lld fsiz=%lld"
+             " joff=%lld jsiz=%lld", (long long)lsiz, (long long)file_.size(),
+             (long long)off, (long long)jsiz);
+      if (!file_.synchronize(true)) {
+        set_error(_KCCODELINE_, Error::SYSTEM, file_.error());
+        return false;
+      }
+      if (!File::remove(jpath)) {
+        set_error(_KCCODELINE_, Error::SYSTEM, "removing the journal file failed");
+        return false;
+      }
+      return true;
+    }
+    if (!file_.truncate(lsiz) || !file_.synchronize(true)) {
+      set_error(_KCCODELINE_, Error::SYSTEM, file_.error());
+      return false;
+    }
+    if (!File::remove(jpath)) {
+      set_error(_KCCODELINE_, Error::SYSTEM, "removing the journal file failed");
+      return false;
+    }
+    report(_KCCODELINE_, Logger::INFO, "restored %lld regions by the journal file",
+           (long long)rnum);
+    jnrec_ = true;
+    return true;
+  }
+  /**
+   * Open the blob file.
+   * @param path the path of the database file.
+   * @param mode the connection mode.
+   * @param fresh true if the database file has just been created.
+   * @return true on success, or false on failure.
+   * @note A blob file under collection left by an interrupted collection is opened together
+   * so that the values moved into it are readable.
+   */
+  bool open_blob(const std::string& path, uint32_t mode, bool fresh) {
+    _assert_(true);
+    if (!(opts_ & TBLOB)) return true;
+    const std::string& bpath = path + File::EXTCHR + KCHDBBLBPATHEXT;
+    const std::string& npath = bpath + File::EXTCHR + KCHDBTMPPATHEXT;
+    uint32_t fmode = File::OREADER | File::ONOLOCK;
+    if (mode & OWRITER) {
+      fmode = File::OWRITER | File::ONOLOCK;
+      if (fresh) fmode |= File::OCREATE | File::OTRUNCATE;
+    }
+    if (!bfile_.open(bpath, fmode, 0)) {
+      set_error(_KCCODELINE_, Error::SYSTEM, bfile_.error());
+      return false;
+    }
+    if (fresh && (mode & OWRITER)) {
+      if (!write_blob_head(&bfile_, 1, 0)) {
+        bfile_.close();
+        return false;
+      }
+      File::remove(npath);
+    }
+    int64_t live;
+    if (!read_blob_head(&bfile_, &bgen_, &live)) {
+      set_error(_KCCODELINE_, Error::BROKEN, "invalid blob file");
+      bfile_.close();
+      return false;
+    }
+    bsize_ = bfile_.size();
+    blive_ = live;
+    bopen_ = true;
+    if (File::status(npath)) {
+      if (bofile_.open(npath, fmode, 0) && read_blob_head(&bofile_, &bogen_, &live) &&
+          bogen_ == bgen_ + 1) {
+        report(_KCCODELINE_, Logger::WARN, "found an interrupted collection of the blob file");
+        bosize_ = bofile_.size();
+        bolive_ = live;
+        boopen_ = true;
+      } else {
+        bofile_.close();
+        if ((mode & OWRITER) && !File::remove(npath)) {
+          set_error(_KCCODELINE_, Error::SYSTEM, "removing the broken blob file failed");
+          close_blob();
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+  /**
+   * Close the blob file.
+   * @return true on success, or false on failure.
+   */
+  bool close_blob() {
+    _assert_(true);
+    bool err = false;
+    bgcoff_ = 0;
+    if (boopen_) {
+      if (writer_ && !write_blob_head(&bofile_, bogen_, bolive_)) err = true;
+      if (!bofile_.close()) {
+        set_error(_KCCODELINE_, Error::SYSTEM, bofile_.error());
+        err = true;
+      }
+      boopen_ = false;
+    }
+    if (bopen_) {
+      if (writer_ && !write_blob_head(&bfile_, bgen_, blive_)) err = true;
+      if (!bfile_.close()) {
+        set_error(_KCCODELINE_, Error::SYSTEM, bfile_.error());
+        err = true;
+      }
+      bopen_ = false;
+    }
+    return !err;
+  }
+  /**
+   * Synchronize the blob file.
+   * @param hard true for physical synchronization with the device, or false for logical
+   * synchronization with the file system.
+   * @return true on success, or false on failure.
+   */
+  bool synchronize_blob(bool hard) {
+    _assert_(true);
+    bool err = false;
+    if (!write_blob_head(&bfile_, bgen_, blive_)) err = true;
+    if (!bfile_.synchronize(hard)) {
+      set_error(_KCCODELINE_, Error::SYSTEM, bfile_.error());
+      err = true;
+    }
+    if (boopen_) {
+      if (!write_blob_head(&bofile_, bogen_, bolive_)) err = true;
+      if (!bofile_.synchronize(hard)) {
+        set_error(_KCCODELINE_, Error::SYSTEM, bofile_.error());
+        err = true;
+      }
+    }
+    return !err;
+  }
+  /**
+   * Remove all values in the blob file.
+   * @return true on success, or false on failure.
+   * @note In a transaction, the values are only marked as dead so that aborting it keeps the
+   * references valid.
+   */
+  bool clear_blob() {
+    _assert_(true);
+    blive_ = 0;
+    bolive_ = 0;
+    if (tran_) return true;
+    bool err = false;
+    bgcoff_ = 0;
+    if (boopen_) {
+      const std::string& npath = bofile_.path();
+      if (!bofile_.close()) {
+        set_error(_KCCODELINE_, Error::SYSTEM, bofile_.error());
+        err = true;
+      }
+      boopen_ = false;
+      File::remove(npath);
+    }
+    if (!bfile_.truncate(BLBHEADSIZ)) {
+      set_error(_KCCODELINE_, Error::SYSTEM, bfile_.error());
+      err = true;
+    }
+    bsize_ = (int64_t)BLBHEADSIZ;
+    if (!write_blob_head(&bfile_, bgen_, 0)) err = true;
+    return !err;
+  }
+  /**
+   * Write the header of a blob file.
+   * @param file the blob file.
+   * @param gen the generation of the blob file.
+   * @param live the size of live values.
+   * @return true on success, or false on failure.
+   */
+  bool write_blob_head(File* file, int64_t gen, int64_t live) {
+    _assert_(file);
+    char head[BLBHEADSIZ];
+    std::memset(head, 0, sizeof(head));
+    std::memcpy(head, KCHDBBLBMAGICDATA, sizeof(KCHDBBLBMAGICDATA));
+    writefixnum(head + sizeof(uint64_t), gen, sizeof(uint64_t));
+    writefixnum(head + sizeof(uint64_t) * 2, live > 0 ? live : 0, sizeof(uint64_t));
+    if (!file->write(0, head, sizeof(head))) {
+      set_error(_KCCODELINE_, Error::SYSTEM, file->error());
+      return false;
+    }
+    return true;
+  }
+  /**
+   * Read the header of a blob file.
+   * @param file the blob file.
+   * @param gp the pointer to the variable into which the generation is assigned.
+   * @param lp the pointer to the variable into which the size of live values is assigned.
+   * @return true on success, or false on failure.
+   */
+  bool read_blob_head(File* file, int64_t* gp, int64_t* lp) {
+    _assert_(file && gp && lp);
+    char head[BLBHEADSIZ];
+    if (file->size() < BLBHEADSIZ || !file->read(0, head, sizeof(head)) ||
+        std::memcmp(head, KCHDBBLBMAGICDATA, sizeof(KCHDBBLBMAGICDATA))) return false;
+    *gp = readfixnum(head + sizeof(uint64_t), sizeof(uint64_t));
+    *lp = readfixnum(head + sizeof(uint64_t) * 2, sizeof(uint64_t));
+    return *gp > 0;
+  }
+  /**
+   * Parse a reference to the blob file in a stored value.
+   * @param vbuf the pointer to the stored value.
+   * @param vsiz the size of the stored value.
+   * @param gp the pointer to the variable into which the generation is assigned.
+   * @param op the pointer to the variable into which the offset is assigned.
+   * @param sp the pointer to the variable into which the size is assigned.
+   * @return true if the value is a valid reference, or false if not.
+   */
+  bool parse_blob_ref(const char* vbuf, size_t vsiz, int64_t* gp, int64_t* op, int64_t* sp) {
+    _assert_(vbuf && gp && op && sp);
+    if (vsiz != BLBREFSIZ || *(uint8_t*)vbuf != BLBTAGREF) return false;
+    *gp = readfixnum(vbuf + 1, sizeof(uint32_t));
+    *op = readfixnum(vbuf + 1 + sizeof(uint32_t), sizeof(uint64_t));
+    *sp = readfixnum(vbuf + 1 + sizeof(uint32_t) + sizeof(uint64_t), sizeof(uint32_t));
+    return true;
+  }
+  /**
+   * Make a reference to the blob file.
+   * @param buf the pointer to the buffer into which the reference is written.  Its size must
+   * be BLBREFSIZ.
+   * @param gen the generation of the blob file.
+   * @param off the offset of the value.
+   * @param size the size of the value.
+   * @note The reference is of fixed length so that rewriting it never moves the record.
+   */
+  void make_blob_ref(char* buf, int64_t gen, int64_t off, int64_t size) {
+    _assert_(buf && gen > 0 && off >= 0 && size >= 0);
+    *(uint8_t*)buf = BLBTAGREF;
+    writefixnum(buf + 1, gen, sizeof(uint32_t));
+    writefixnum(buf + 1 + sizeof(uint32_t), off, sizeof(uint64_t));
+    writefixnum(buf + 1 + sizeof(uint32_t) + sizeof(uint64_t), size, sizeof(uint32_t));
+  }
+  /**
+   * Compress a value into its stored form.
+   * @param vbuf the pointer to the value.
+   * @param vsiz the size of the value.
+   * @param sp the pointer to the variable into which the size of the result is assigned.
+   * @return the stored form, or NULL on failure.
+   */
+  char* compress_value(const char* vbuf, size_t vsiz, size_t* sp) {
+    _assert_(vbuf && sp);
+    char* zbuf = comp_->compress(vbuf, vsiz, sp);
+    if (!zbuf) {
+      set_error(_KCCODELINE_, Error::SYSTEM, "data compression failed");
+      return NULL;
+    }
+    if (comp_ == &blbcomp_) zbuf = write_blob_value(zbuf, sp);
+    return zbuf;
+  }
+  /**
+   * Move a value in the stored form into the blob file.
+   * @param zbuf the stored form made by the blob compressor.
+   * @param sp the pointer to the variable of the size of the stored form, into which the size
+   * of the result is assigned.
+   * @return the stored form itself or a reference replacing it, or NULL on failure.
+   * @note A value whose compressed size is not less than the threshold is written at the end
+   * of the blob file, or of the blob file under collection if any.  The given stored form is
+   * released unless it is returned.
+   */
+  char* write_blob_value(char* zbuf, size_t* sp) {
+    _assert_(zbuf && sp);
+    int64_t vsiz = *sp - 1;
+    if (!bopen_ || vsiz < bthres_) return zbuf;
+    File* file;
+    int64_t gen, off;
+    if (boopen_) {
+      file = &bofile_;
+      gen = bogen_;
+      off = bosize_.add(vsiz);
+    } else {
+      file = &bfile_;
+      gen = bgen_;
+      off = bsize_.add(vsiz);
+    }
+    if (!file->write(off, zbuf + 1, vsiz)) {
+      set_error(_KCCODELINE_, Error::SYSTEM, file->error());
+      delete[] zbuf;
+      return NULL;
+    }
+    delete[] zbuf;
+    if (boopen_) {
+      bolive_ += vsiz;
+    } else {
+      blive_ += vsiz;
+    }
+    char* rbuf = new char[BLBREFSIZ];
+    make_blob_ref(rbuf, gen, off, vsiz);
+    *sp = BLBREFSIZ;
+    return rbuf;
+  }
+  /**
+   * Restore a value from its stored form.
+   * @param vbuf the pointer to the stored form.
+   * @param vsiz the size of the stored form.
+   * @param sp the pointer to the variable into which the size of the result is assigned.
+   * @return the value, or NULL on failure.
+   */
+  char* read_blob_value(const char* vbuf, size_t vsiz, size_t* sp) {
+    _assert_(vbuf && sp);
+    if (vsiz < 1) return NULL;
+    char* bbuf = NULL;
+    int64_t gen, off, size;
+    if (*(uint8_t*)vbuf == BLBTAGINL) {
+      vbuf++;
+      vsiz--;
+    } else if (parse_blob_ref(vbuf, vsiz, &gen, &off, &size)) {
+      File* file = NULL;
+      if (bopen_ && gen == bgen_) {
+        file = &bfile_;
+      } else if (boopen_ && gen == bogen_) {
+        file = &bofile_;
+      } else {
+        report(_KCCODELINE_, Logger::WARN, "missing blob generation: gen=%lld",
+               (long long)gen);
+        return NULL;
+      }
+      if (size > (int64_t)MEMMAXSIZ || off < BLBHEADSIZ || off + size > file->size()) {
+        report(_KCCODELINE_, Logger::WARN, "invalid blob reference: off=%lld size=%lld",
+               (long long)off, (long long)size);
+        return NULL;
+      }
+      bbuf = new char[size+1];
+      if (!file->read(off, bbuf, size)) {
+        report(_KCCODELINE_, Logger::WARN, "reading the blob file failed: %s", file->error());
+        delete[] bbuf;
+        return NULL;
+      }
+      vbuf = bbuf;
+      vsiz = size;
+    } else {
+      return NULL;
+    }
+    char* rbuf;
+    if (blbcomp_.comp_) {
+      rbuf = blbcomp_.comp_->decompress(vbuf, vsiz, sp);
+      delete[] bbuf;
+    } else if (bbuf) {
+      bbuf[vsiz] = '\0';
+      *sp = vsiz;
+      rbuf = bbuf;
+    } else {
+      rbuf = new char[vsiz+1];
+      std::memcpy(rbuf, vbuf, vsiz);
+      rbuf[vsiz] = '\0';
+      *sp = vsiz;
+    }
+    return rbuf;
+  }
+  /**
+   * Release the value in the blob file referred to by a stored value.
+   * @param vbuf the pointer to the stored value.
+   * @param vsiz the size of the stored value.
+   */
+  void release_blob_value(const char* vbuf, size_t vsiz) {
+    _assert_(true);
+    if (comp_ != &blbcomp_ || !vbuf) return;
+    int64_t gen, off, size;
+    if (!parse_blob_ref(vbuf, vsiz, &gen, &off, &size)) return;
+    if (gen == bgen_) {
+      blive_ -= size;
+    } else if (boopen_ && gen == bogen_) {
+      bolive_ -= size;
+    }
+  }
+  /**
+   * Check whether the blob file should be collected.
+   * @return true if a collection is in progress or the ratio of live values is under the
+   * threshold, or false if not.
+   */
+  bool check_blob_garbage() {
+    _assert_(true);
+    if (!bopen_ || tran_ || txnum_ > 0) return false;
+    if (bgcoff_ > 0) return true;
+    if (bgcratio_ <= 0) return false;
+    int64_t size = bsize_.get() - BLBHEADSIZ;
+    return size >= BLBGCMIN && blive_.get() < size * bgcratio_;
+  }
+  /**
+   * Collect the garbage of the blob file.
+   * @param step the number of records scanned.
+   * @return true on success, or false on failure.
+   * @note Live values are copied into a blob file of the next generation and the references
+   * in the records are updated step by step, while new values are written into the blob file
+   * of the next generation.  When the scan reaches the end, the database is synchronized and
+   * the blob file of the next generation replaces the current one.  If the collection is
+   * interrupted, it is resumed with the same blob file of the next generation.
+   */
+  bool defrag_blob_impl(int64_t step) {
+    _assert_(step >= 0);
+    const std::string& bpath = bfile_.path();
+    const std::string& npath = bpath + File::EXTCHR + KCHDBTMPPATHEXT;
+    int64_t ngen = bgen_ + 1;
+    if (!boopen_) {
+      if (!bofile_.open(npath, File::OWRITER | File::OCREATE | File::OTRUNCATE |
+                        File::ONOLOCK, 0)) {
+        set_error(_KCCODELINE_, Error::SYSTEM, bofile_.error());
+        return false;
+      }
+      if (!write_blob_head(&bofile_, ngen, 0)) {
+        bofile_.close();
+        return false;
+      }
+      bogen_ = ngen;
+      bosize_ = BLBHEADSIZ;
+      bolive_ = 0;
+      boopen_ = true;
+    }
+    if (bgcoff_ < 1) bgcoff_ = roff_;
+    Record rec;
+    char rbuf[RECBUFSIZ];
+    while (bgcoff_ < lsiz_) {
+      if (step-- < 1) return true;
+      rec.off = bgcoff_;
+      if (!read_record(&rec, rbuf)) return false;
+      if (rec.psiz != UINT16MAX) {
+        if (!rec.vbuf && !read_record_body(&rec)) {
+          delete[] rec.bbuf;
+          return false;
+        }
+        bool err = false;
+        int64_t gen, boff, bsiz;
+        if (parse_blob_ref(rec.vbuf, rec.vsiz, &gen, &boff, &bsiz) && gen != ngen) {
+          if (gen != bgen_ || boff < BLBHEADSIZ || boff + bsiz > bfile_.size()) {
+            set_error(_KCCODELINE_, Error::BROKEN, "invalid blob reference");
+            report(_KCCODELINE_, Logger::WARN, "gen=%lld off=%lld size=%lld",
+                   (long long)gen, (long long)boff, (long long)bsiz);
+            err = true;
+          } else {
+            char* bbuf = new char[bsiz];
+            int64_t noff = bosize_.add(bsiz);
+            if (!bfile_.read(boff, bbuf, bsiz)) {
+              set_error(_KCCODELINE_, Error::SYSTEM, bfile_.error());
+              err = true;
+            } else if (!bofile_.write(noff, bbuf, bsiz)) {
+              set_error(_KCCODELINE_, Error::SYSTEM, bofile_.error());
+              err = true;
+            } else {
+              char pbuf[BLBREFSIZ];
+              make_blob_ref(pbuf, ngen, noff, bsiz);
+              uint64_t hash = hash_record(rec.kbuf, rec.ksiz);
+              uint32_t pivot = fold_hash(hash);
+              int64_t bidx = bucket_index(hash);
+              Repeater repeater(pbuf, sizeof(pbuf));
+              if (accept_impl(rec.kbuf, rec.ksiz, &repeater, bidx, pivot, true)) {
+                bolive_ += bsiz;
+              } else {
+                err = true;
+              }
+            }
+            delete[] bbuf;
+          }
+        }
+        delete[] rec.bbuf;
+        if (err) return false;
+      }
+      bgcoff_ += rec.rsiz;
+    }
+    if (!synchronize_blob(true)) return false;
+    if (!dump_meta()) return false;
+    if (!synchronize_file(true)) {
       set_error(_KCCODELINE_, Error::SYSTEM, file_.error());
+      return false;
+    }
+    if (jnopen_ && !start_journal()) return false;
+    bgcoff_ = 0;
+    bool err = false;
+    if (!bofile_.close()) {
+      set_error(_KCCODELINE_, Error::SYSTEM, bofile_.error());
+      err = true;
+    }
+    boopen_ = false;
+    if (!bfile_.close()) {
+      set_error(_KCCODELINE_, Error::SYSTEM, bfile_.error());
+      err = true;
+    }
+    bopen_ = false;
+    bool renamed = File::rename(npath, bpath);
+    if (!renamed) {
+      set_error(_KCCODELINE_, Error::SYSTEM, "renaming the blob file failed");
       err = true;
+      if (!bofile_.open(npath, File::OWRITER | File::ONOLOCK, 0)) {
+        set_error(_KCCODELINE_, Error::SYSTEM, bofile_.error());
+        return false;
+      }
+      boopen_ = true;
+    }
+    if (!bfile_.open(bpath, File::OWRITER | File::ONOLOCK, 0)) {
+      set_error(_KCCODELINE_, Error::SYSTEM, bfile_.error());
+      return false;
     }
+    bopen_ = true;
+    if (!renamed) return false;
+    bgen_ = ngen;
+    bsize_ = bosize_.get();
+    blive_ = bolive_.get();
+    bgccnt_++;
     return !err;
   }
   /**
@@ -2317,6 +4761,10 @@ class HashDB : public BasicDB {
     if (dfcur_ >= end) {
       lsiz_ = dest;
       psiz_ = lsiz_;
+      if (!journal_region(lsiz_, jnsiz_ - lsiz_)) {
+        if (atran) abort_auto_transaction();
+        return false;
+      }
       if (!file_.truncate(lsiz_)) {
         if (atran) abort_auto_transaction();
         return false;
@@ -2339,6 +4787,635 @@ class HashDB : public BasicDB {
     }
     return true;
   }
+  /**
+   * Open the index file.
+   * @param path the path of the database file.
+   * @param mode the connection mode.
+   * @param fresh true if the database file has just been created.
+   * @return true on success, or false on failure.
+   * @note The index is rebuilt from the records if it is missing or was not closed properly.
+   * The header marked as dirty is synchronized with the device before any page is updated.
+   */
+  bool open_index(const std::string& path, uint32_t mode, bool fresh) {
+    _assert_(true);
+    if (!(opts_ & TPAGE)) return true;
+    const std::string& ipath = path + File::EXTCHR + KCHDBIDXPATHEXT;
+    uint32_t fmode = File::OREADER | File::ONOLOCK;
+    if (mode & OWRITER) {
+      fmode = File::OWRITER | File::OCREATE | File::ONOLOCK;
+      if (fresh) fmode |= File::OTRUNCATE;
+    }
+    if (!ifile_.open(ipath, fmode, 0)) {
+      set_error(_KCCODELINE_, Error::SYSTEM, ifile_.error());
+      return false;
+    }
+    iopen_ = true;
+    islotsiz_ = sizeof(uint32_t) + sizeof(uint16_t) + width_;
+    islotnum_ = (IDXPGSIZ - IDXPHSIZ) / islotsiz_;
+    isplitcnt_ = 0;
+    bool dirty = true;
+    bool valid = !fresh && load_index(&dirty);
+    bool err = false;
+    if (mode & OWRITER) {
+      if (!valid || dirty) {
+        if (!fresh) report(_KCCODELINE_, Logger::WARN, "rebuilding the index file");
+        if (!rebuild_index()) err = true;
+      }
+      if (!err && !write_index_head(true)) err = true;
+      if (!err && !ifile_.synchronize(true)) {
+        set_error(_KCCODELINE_, Error::SYSTEM, ifile_.error());
+        err = true;
+      }
+    } else if (!valid) {
+      set_error(_KCCODELINE_, Error::BROKEN, "invalid index file");
+      err = true;
+    } else if (dirty) {
+      report(_KCCODELINE_, Logger::WARN, "the index file was not closed properly");
+    }
+    if (err) {
+      ifile_.close();
+      iopen_ = false;
+      idir_.clear();
+      return false;
+    }
+    return true;
+  }
+  /**
+   * Close the index file.
+   * @return true on success, or false on failure.
+   * @note The pages are synchronized with the device before the header is marked as clean.
+   */
+  bool close_index() {
+    _assert_(true);
+    if (!iopen_) return true;
+    bool err = false;
+    if (writer_) {
+      if (!ifile_.synchronize(true)) {
+        set_error(_KCCODELINE_, Error::SYSTEM, ifile_.error());
+        err = true;
+      }
+      if (!err && !write_index_head(false)) err = true;
+    }
+    if (!ifile_.close()) {
+      set_error(_KCCODELINE_, Error::SYSTEM, ifile_.error());
+      err = true;
+    }
+    iopen_ = false;
+    idir_.clear();
+    isplits_.clear();
+    ispnum_ = 0;
+    return !err;
+  }
+  /**
+   * Load the header and the directory of the index file.
+   * @param dp the pointer to the variable into which the dirty flag is assigned.
+   * @return true on success, or false if the index file is missing or invalid.
+   */
+  bool load_index(bool* dp) {
+    _assert_(dp);
+    char head[IDXHEADSIZ];
+    if (ifile_.size() < IDXPGOFF || !ifile_.read(0, head, sizeof(head)) ||
+        std::memcmp(head, KCHDBIDXMAGICDATA, sizeof(KCHDBIDXMAGICDATA))) return false;
+    int32_t bdepth = *(uint8_t*)(head + 9);
+    int32_t gdepth = *(uint8_t*)(head + 10);
+    int64_t slotsiz = readfixnum(head + 12, sizeof(uint32_t));
+    int64_t pnum = readfixnum(head + 16, sizeof(uint64_t));
+    int64_t free = readfixnum(head + 24, sizeof(uint64_t));
+    if (bdepth > gdepth || gdepth > IDXMAXDEPTH || slotsiz != islotsiz_ ||
+        pnum < (1LL << bdepth) || pnum > (int64_t)UINT32MAX || free >= pnum) return false;
+    size_t dnum = (size_t)1 << gdepth;
+    char* dbuf = new char[dnum*sizeof(uint32_t)];
+    if (!ifile_.read(IDXDIROFF, dbuf, dnum * sizeof(uint32_t))) {
+      delete[] dbuf;
+      return false;
+    }
+    std::vector<uint32_t> dir(dnum);
+    const char* rp = dbuf;
+    for (size_t i = 0; i < dnum; i++) {
+      dir[i] = readfixnum(rp, sizeof(uint32_t));
+      rp += sizeof(uint32_t);
+      if ((int64_t)dir[i] >= pnum) {
+        delete[] dbuf;
+        return false;
+      }
+    }
+    delete[] dbuf;
+    *dp = head[8] != 0;
+    ibdepth_ = bdepth;
+    igdepth_ = gdepth;
+    ipnum_ = pnum;
+    ifree_ = free;
+    idir_.swap(dir);
+    return true;
+  }
+  /**
+   * Write the header of the index file.
+   * @param dirty true if the index may be inconsistent with the records until it is closed.
+   * @return true on success, or false on failure.
+   */
+  bool write_index_head(bool dirty) {
+    _assert_(true);
+    char head[IDXHEADSIZ];
+    std::memset(head, 0, sizeof(head));
+    std::memcpy(head, KCHDBIDXMAGICDATA, sizeof(KCHDBIDXMAGICDATA));
+    head[8] = dirty ? 1 : 0;
+    head[9] = ibdepth_;
+    head[10] = igdepth_;
+    writefixnum(head + 12, islotsiz_, sizeof(uint32_t));
+    writefixnum(head + 16, ipnum_, sizeof(uint64_t));
+    writefixnum(head + 24, ifree_, sizeof(uint64_t));
+    if (!ifile_.write(0, head, sizeof(head))) {
+      set_error(_KCCODELINE_, Error::SYSTEM, ifile_.error());
+      return false;
+    }
+    return true;
+  }
+  /**
+   * Write elements of the directory into the index file.
+   * @param beg the index of the first element.
+   * @param num the number of the elements.
+   * @return true on success, or false on failure.
+   */
+  bool write_index_dir(size_t beg, size_t num) {
+    _assert_(beg + num <= idir_.size());
+    char stack[IOBUFSIZ];
+    size_t dsiz = num * sizeof(uint32_t);
+    char* dbuf = dsiz > sizeof(stack) ? new char[dsiz] : stack;
+    char* wp = dbuf;
+    for (size_t i = beg; i < beg + num; i++) {
+      writefixnum(wp, idir_[i], sizeof(uint32_t));
+      wp += sizeof(uint32_t);
+    }
+    bool err = false;
+    if (!ifile_.write(IDXDIROFF + beg * sizeof(uint32_t), dbuf, dsiz)) {
+      set_error(_KCCODELINE_, Error::SYSTEM, ifile_.error());
+      err = true;
+    }
+    if (dbuf != stack) delete[] dbuf;
+    return !err;
+  }
+  /**
+   * Initialize the index file with empty bucket pages.
+   * @return true on success, or false on failure.
+   * @note The initial number of pages is enough to hold as many slots as the buckets.
+   */
+  bool init_index() {
+    _assert_(true);
+    int32_t depth = 0;
+    while (depth < IDXMAXDEPTH && ((int64_t)islotnum_ << depth) < bnum_) {
+      depth++;
+    }
+    ibdepth_ = depth;
+    igdepth_ = depth;
+    ipnum_ = 1LL << depth;
+    ifree_ = 0;
+    idir_.resize(ipnum_);
+    for (int64_t i = 0; i < ipnum_; i++) {
+      idir_[i] = i;
+    }
+    {
+      ScopedMutex lock(&iplock_);
+      isplits_.clear();
+      ispnum_ = 0;
+    }
+    if (!ifile_.truncate(0) || !ifile_.truncate(IDXPGOFF + ipnum_ * IDXPGSIZ)) {
+      set_error(_KCCODELINE_, Error::SYSTEM, ifile_.error());
+      return false;
+    }
+    if (!write_index_dir(0, idir_.size())) return false;
+    return write_index_head(true);
+  }
+  /**
+   * Rebuild the index file by scanning all records.
+   * @return true on success, or false on failure.
+   */
+  bool rebuild_index() {
+    _assert_(true);
+    if (!init_index()) return false;
+    int64_t off = roff_;
+    int64_t end = lsiz_;
+    Record rec;
+    char rbuf[RECBUFSIZ];
+    IndexPage page;
+    while (off < end) {
+      rec.off = off;
+      if (!read_record(&rec, rbuf)) return false;
+      if (rec.psiz != UINT16MAX) {
+        uint64_t hash = hash_record(rec.kbuf, rec.ksiz);
+        delete[] rec.bbuf;
+        int64_t pno = bucket_index(hash);
+        int64_t rpno = -1;
+        while (true) {
+          if (!read_index_page(pno, &page)) return false;
+          if (page.num < islotnum_) {
+            rpno = pno;
+            break;
+          }
+          if (page.next < 1) break;
+          pno = page.next;
+        }
+        if (!add_index_slot(hash, off, &page, rpno)) return false;
+        if (ispnum_ > 0 && !split_index_pages()) return false;
+      }
+      off += rec.rsiz;
+    }
+    return true;
+  }
+  /**
+   * Save the state of the index for transaction.
+   */
+  void save_index_state() {
+    _assert_(true);
+    ScopedMutex lock(&iplock_);
+    tripnum_ = ipnum_;
+    trifree_ = ifree_;
+    trigdepth_ = igdepth_;
+    tridir_.clear();
+  }
+  /**
+   * Abort the transaction of the index file.
+   * @return true on success, or false on failure.
+   * @note The directory is restored from the copy saved before the first split in the
+   * transaction.  As splits are done only with the writer lock, auto transactions never
+   * change the directory, which readers look up with the reader lock.
+   */
+  bool abort_index_transaction() {
+    _assert_(true);
+    bool err = false;
+    if (!ifile_.end_transaction(false)) {
+      set_error(_KCCODELINE_, Error::SYSTEM, ifile_.error());
+      err = true;
+    }
+    ScopedMutex lock(&iplock_);
+    ipnum_ = tripnum_;
+    ifree_ = trifree_;
+    if (!tridir_.empty()) {
+      igdepth_ = trigdepth_;
+      idir_.swap(tridir_);
+      tridir_.clear();
+    }
+    return !err;
+  }
+  /**
+   * Get the number of the primary bucket page or the bucket index of a hash value.
+   * @param hash the hash value.
+   * @return the page number in the index file, or the bucket index otherwise.
+   */
+  int64_t bucket_index(uint64_t hash) {
+    _assert_(true);
+    if (iopen_) return idir_[(hash >> 32) & (idir_.size() - 1)];
+    return hash % bnum_;
+  }
+  /**
+   * Read a bucket page from the index file.
+   * @param pno the page number.
+   * @param page the page structure.
+   * @return true on success, or false on failure.
+   */
+  bool read_index_page(int64_t pno, IndexPage* page) {
+    _assert_(pno >= 0 && page);
+    if (!ifile_.read(IDXPGOFF + pno * IDXPGSIZ, page->buf, IDXPGSIZ)) {
+      set_error(_KCCODELINE_, Error::SYSTEM, ifile_.error());
+      report(_KCCODELINE_, Logger::WARN, "pno=%lld fsiz=%lld",
+             (long long)pno, (long long)ifile_.size());
+      return false;
+    }
+    page->pno = pno;
+    page->depth = ibdepth_ + *(uint8_t*)page->buf;
+    page->num = readfixnum(page->buf + sizeof(uint16_t), sizeof(uint16_t));
+    page->next = readfixnum(page->buf + sizeof(uint32_t), sizeof(uint32_t));
+    if (page->num > islotnum_ || page->depth > IDXMAXDEPTH) {
+      set_error(_KCCODELINE_, Error::BROKEN, "invalid bucket page");
+      report(_KCCODELINE_, Logger::WARN, "pno=%lld num=%d depth=%d",
+             (long long)pno, (int)page->num, (int)page->depth);
+      return false;
+    }
+    return true;
+  }
+  /**
+   * Write a bucket page into the index file.
+   * @param page the page structure.
+   * @return true on success, or false on failure.
+   */
+  bool write_index_page(IndexPage* page) {
+    _assert_(page);
+    char* wp = page->buf;
+    *(uint8_t*)wp = page->depth - ibdepth_;
+    *(uint8_t*)(wp + 1) = 0;
+    writefixnum(wp + sizeof(uint16_t), page->num, sizeof(uint16_t));
+    writefixnum(wp + sizeof(uint32_t), page->next, sizeof(uint32_t));
+    if (!ifile_.write(IDXPGOFF + page->pno * IDXPGSIZ, page->buf, IDXPGSIZ)) {
+      set_error(_KCCODELINE_, Error::SYSTEM, ifile_.error());
+      report(_KCCODELINE_, Logger::WARN, "pno=%lld fsiz=%lld",
+             (long long)page->pno, (long long)ifile_.size());
+      return false;
+    }
+    return true;
+  }
+  /**
+   * Get a slot of a bucket page.
+   * @param page the page structure.
+   * @param sidx the index of the slot.
+   * @param hp the pointer to the variable into which the upper half of the hash value is
+   * assigned.
+   * @param tp the pointer to the variable into which the tag of the hash value is assigned.
+   * @param op the pointer to the variable into which the offset of the record is assigned.
+   */
+  void get_index_slot(const IndexPage* page, int32_t sidx,
+                      uint32_t* hp, uint16_t* tp, int64_t* op) {
+    _assert_(page && sidx >= 0 && hp && tp && op);
+    const char* rp = page->buf + IDXPHSIZ + sidx * islotsiz_;
+    *hp = readfixnum(rp, sizeof(uint32_t));
+    *tp = readfixnum(rp + sizeof(uint32_t), sizeof(uint16_t));
+    *op = readfixnum(rp + sizeof(uint32_t) + sizeof(uint16_t), width_) << apow_;
+  }
+  /**
+   * Set a slot of a bucket page.
+   * @param page the page structure.
+   * @param sidx the index of the slot.
+   * @param hash the hash value of the key.
+   * @param off the offset of the record.
+   */
+  void set_index_slot(IndexPage* page, int32_t sidx, uint64_t hash, int64_t off) {
+    _assert_(page && sidx >= 0 && off >= 0);
+    char* wp = page->buf + IDXPHSIZ + sidx * islotsiz_;
+    writefixnum(wp, hash >> 32, sizeof(uint32_t));
+    writefixnum(wp + sizeof(uint32_t), hash & 0xffff, sizeof(uint16_t));
+    writefixnum(wp + sizeof(uint32_t) + sizeof(uint16_t), off >> apow_, width_);
+  }
+  /**
+   * Search the chain of bucket pages for a record.
+   * @param kbuf the pointer to the key region.
+   * @param ksiz the size of the key region.
+   * @param hash the hash value of the key.
+   * @param pno the number of the primary bucket page.
+   * @param page the page structure into which the page of the found slot, or the last page of
+   * the chain is read.
+   * @param sp the pointer to the variable into which the index of the found slot is assigned,
+   * or -1 is assigned if no record corresponds.
+   * @param rp the pointer to the variable into which the number of the first page with a free
+   * slot is assigned, or -1 is assigned if every page is full.
+   * @param rec the record structure into which the found record is read.
+   * @param rbuf the working buffer of the record.
+   * @return true on success, or false on failure.
+   * @note Records are read only for the slots whose hash value and tag match the key.
+   */
+  bool search_index(const char* kbuf, size_t ksiz, uint64_t hash, int64_t pno,
+                    IndexPage* page, int32_t* sp, int64_t* rp, Record* rec, char* rbuf) {
+    _assert_(kbuf && ksiz <= MEMMAXSIZ && pno >= 0 && page && sp && rp && rec && rbuf);
+    uint32_t khash = hash >> 32;
+    uint16_t ktag = hash & 0xffff;
+    *sp = -1;
+    *rp = -1;
+    while (true) {
+      if (!read_index_page(pno, page)) return false;
+      if (*rp < 0 && page->num < islotnum_) *rp = pno;
+      for (int32_t i = 0; i < page->num; i++) {
+        uint32_t thash;
+        uint16_t ttag;
+        int64_t off;
+        get_index_slot(page, i, &thash, &ttag, &off);
+        if (thash != khash || ttag != ktag) continue;
+        if (mtrc_) mtrc_->add(MCCHAIN);
+        rec->off = off;
+        if (!read_record(rec, rbuf)) return false;
+        if (rec->psiz == UINT16MAX) {
+          set_error(_KCCODELINE_, Error::BROKEN, "free block in the bucket page");
+          report(_KCCODELINE_, Logger::WARN, "psiz=%lld off=%lld fsiz=%lld",
+                 (long long)psiz_, (long long)rec->off, (long long)file_.size());
+          return false;
+        }
+        if (compare_keys(kbuf, ksiz, rec->kbuf, rec->ksiz) == 0) {
+          *sp = i;
+          return true;
+        }
+        delete[] rec->bbuf;
+      }
+      if (page->next < 1) break;
+      pno = page->next;
+    }
+    return true;
+  }
+  /**
+   * Add a slot to the chain of bucket pages.
+   * @param hash the hash value of the key.
+   * @param off the offset of the record.
+   * @param page the page structure of the last page of the chain.
+   * @param rpno the number of a page with a free slot, or -1 to append an overflow page.
+   * @return true on success, or false on failure.
+   */
+  bool add_index_slot(uint64_t hash, int64_t off, IndexPage* page, int64_t rpno) {
+    _assert_(off >= 0 && page);
+    if (rpno >= 0) {
+      if (page->pno != rpno && !read_index_page(rpno, page)) return false;
+      set_index_slot(page, page->num++, hash, off);
+      return write_index_page(page);
+    }
+    IndexPage npage;
+    std::memset(npage.buf, 0, sizeof(npage.buf));
+    if (!alloc_index_page(&npage.pno)) return false;
+    npage.depth = page->depth;
+    npage.num = 0;
+    npage.next = 0;
+    set_index_slot(&npage, npage.num++, hash, off);
+    if (!write_index_page(&npage)) return false;
+    page->next = npage.pno;
+    if (!write_index_page(page)) return false;
+    ScopedMutex lock(&iplock_);
+    isplits_.insert(hash >> 32);
+    ispnum_ = isplits_.size();
+    return true;
+  }
+  /**
+   * Remove a slot from a bucket page.
+   * @param page the page structure.
+   * @param sidx the index of the slot.
+   * @return true on success, or false on failure.
+   */
+  bool remove_index_slot(IndexPage* page, int32_t sidx) {
+    _assert_(page && sidx >= 0);
+    page->num--;
+    if (sidx < page->num) {
+      std::memcpy(page->buf + IDXPHSIZ + sidx * islotsiz_,
+                  page->buf + IDXPHSIZ + page->num * islotsiz_, islotsiz_);
+    }
+    return write_index_page(page);
+  }
+  /**
+   * Load the offsets of the records in the chain of bucket pages.
+   * @param pno the number of the primary bucket page.
+   * @param offs a vector to contain the result.
+   * @return true on success, or false on failure.
+   */
+  bool load_index_offsets(int64_t pno, std::vector<int64_t>* offs) {
+    _assert_(pno >= 0 && offs);
+    IndexPage page;
+    while (true) {
+      if (!read_index_page(pno, &page)) return false;
+      for (int32_t i = 0; i < page.num; i++) {
+        uint32_t thash;
+        uint16_t ttag;
+        int64_t off;
+        get_index_slot(&page, i, &thash, &ttag, &off);
+        offs->push_back(off);
+      }
+      if (page.next < 1) break;
+      pno = page.next;
+    }
+    return true;
+  }
+  /**
+   * Allocate a bucket page.
+   * @param pp the pointer to the variable into which the page number is assigned.
+   * @return true on success, or false on failure.
+   */
+  bool alloc_index_page(int64_t* pp) {
+    _assert_(pp);
+    ScopedMutex lock(&iplock_);
+    if (ifree_ > 0) {
+      IndexPage page;
+      if (!read_index_page(ifree_, &page)) return false;
+      *pp = ifree_;
+      ifree_ = page.next;
+    } else {
+      if (ipnum_ >= (int64_t)UINT32MAX) {
+        set_error(_KCCODELINE_, Error::BROKEN, "too many bucket pages");
+        return false;
+      }
+      *pp = ipnum_++;
+    }
+    return write_index_head(true);
+  }
+  /**
+   * Release a bucket page into the free page list.
+   * @param pno the page number.
+   * @return true on success, or false on failure.
+   */
+  bool free_index_page(int64_t pno) {
+    _assert_(pno > 0);
+    ScopedMutex lock(&iplock_);
+    IndexPage page;
+    std::memset(page.buf, 0, sizeof(page.buf));
+    page.pno = pno;
+    page.depth = ibdepth_;
+    page.num = 0;
+    page.next = ifree_;
+    if (!write_index_page(&page)) return false;
+    ifree_ = pno;
+    return write_index_head(true);
+  }
+  /**
+   * Check whether some bucket pages should be split.
+   * @return true if splitting is needed, or false if not.
+   */
+  bool check_index_split() {
+    _assert_(true);
+    return iopen_ && ispnum_ > 0 && txnum_ < 1;
+  }
+  /**
+   * Split the bucket pages with overflow pages.
+   * @return true on success, or false on failure.
+   */
+  bool split_index_pages() {
+    _assert_(true);
+    std::vector<uint32_t> hashes;
+    {
+      ScopedMutex lock(&iplock_);
+      hashes.insert(hashes.end(), isplits_.begin(), isplits_.end());
+      isplits_.clear();
+      ispnum_ = 0;
+    }
+    while (!hashes.empty()) {
+      uint32_t khash = hashes.back();
+      hashes.pop_back();
+      if (!split_index_page(khash, &hashes)) return false;
+    }
+    return true;
+  }
+  /**
+   * Split the primary bucket page of a hash value.
+   * @param khash the upper half of the hash value.
+   * @param hashes a vector to which the hash values of the pages still overflowing are added.
+   * @return true on success, or false on failure.
+   * @note The slots of the page and its overflow pages are distributed into the page and a new
+   * page by the next bit of the hash value, doubling the directory if the page is referred to
+   * by only one element of it.
+   */
+  bool split_index_page(uint32_t khash, std::vector<uint32_t>* hashes) {
+    _assert_(hashes);
+    int64_t pno = idir_[khash & (idir_.size() - 1)];
+    IndexPage page;
+    if (!read_index_page(pno, &page)) return false;
+    if (page.next < 1 || page.depth >= IDXMAXDEPTH) return true;
+    if (tran_ && tridir_.empty()) tridir_ = idir_;
+    int32_t depth = page.depth;
+    std::string slots(page.buf + IDXPHSIZ, page.num * islotsiz_);
+    int64_t next = page.next;
+    while (next > 0) {
+      if (!read_index_page(next, &page)) return false;
+      slots.append(page.buf + IDXPHSIZ, page.num * islotsiz_);
+      if (!free_index_page(next)) return false;
+      next = page.next;
+    }
+    if (depth >= igdepth_) {
+      size_t onum = idir_.size();
+      idir_.resize(onum * 2);
+      for (size_t i = 0; i < onum; i++) {
+        idir_[onum+i] = idir_[i];
+      }
+      igdepth_++;
+      if (!write_index_dir(onum, onum) || !write_index_head(true)) return false;
+    }
+    std::string lslots, rslots;
+    for (size_t i = 0; i < slots.size(); i += islotsiz_) {
+      uint32_t thash = readfixnum(slots.data() + i, sizeof(uint32_t));
+      std::string& dest = ((thash >> depth) & 1) ? rslots : lslots;
+      dest.append(slots.data() + i, islotsiz_);
+    }
+    int64_t npno;
+    if (!alloc_index_page(&npno)) return false;
+    if (!write_index_chain(pno, depth + 1, lslots, hashes) ||
+        !write_index_chain(npno, depth + 1, rslots, hashes)) return false;
+    size_t step = (size_t)1 << (depth + 1);
+    for (size_t i = (khash & (((size_t)1 << depth) - 1)) | ((size_t)1 << depth);
+         i < idir_.size(); i += step) {
+      idir_[i] = npno;
+      if (!write_index_dir(i, 1)) return false;
+    }
+    isplitcnt_++;
+    return true;
+  }
+  /**
+   * Write slots into a chain of bucket pages.
+   * @param pno the number of the primary bucket page.
+   * @param depth the local depth of the pages.
+   * @param slots the serialized slots.
+   * @param hashes a vector to which the hash value is added if overflow pages are needed.
+   * @return true on success, or false on failure.
+   */
+  bool write_index_chain(int64_t pno, int32_t depth, const std::string& slots,
+                         std::vector<uint32_t>* hashes) {
+    _assert_(pno >= 0 && hashes);
+    int32_t rnum = slots.size() / islotsiz_;
+    const char* rp = slots.data();
+    if (rnum > islotnum_) hashes->push_back(readfixnum(rp, sizeof(uint32_t)));
+    IndexPage page;
+    while (true) {
+      std::memset(page.buf, 0, sizeof(page.buf));
+      page.pno = pno;
+      page.depth = depth;
+      page.num = std::min(rnum, islotnum_);
+      page.next = 0;
+      std::memcpy(page.buf + IDXPHSIZ, rp, page.num * islotsiz_);
+      rp += page.num * islotsiz_;
+      rnum -= page.num;
+      if (rnum > 0 && !alloc_index_page(&page.next)) return false;
+      if (!write_index_page(&page)) return false;
+      if (rnum < 1) break;
+      pno = page.next;
+    }
+    return true;
+  }
   /**
    * Calculate meta data with saved ones.
    */
@@ -2347,17 +5424,24 @@ class HashDB : public BasicDB {
     align_ = 1 << apow_;
     fbpnum_ = fpow_ > 0 ? 1 << fpow_ : 0;
     width_ = (opts_ & TSMALL) ? sizeof(uint32_t) : sizeof(uint32_t) + 2;
-    linear_ = (opts_ & TLINEAR) ? true : false;
+    linear_ = (opts_ & (TLINEAR | TPAGE)) ? true : false;
     comp_ = (opts_ & TCOMPRESS) ? embcomp_ : NULL;
+    if (opts_ & TBLOB) {
+      blbcomp_.comp_ = comp_;
+      comp_ = &blbcomp_;
+    }
     rhsiz_ = sizeof(uint16_t) + sizeof(uint8_t) * 2;
     rhsiz_ += linear_ ? width_ : width_ * 2;
     boff_ = HEADSIZ + FBPWIDTH * fbpnum_;
     if (fbpnum_ > 0) boff_ += width_ * 2 + sizeof(uint8_t) * 2;
-    roff_ = boff_ + width_ * bnum_;
+    roff_ = boff_;
+    if (!(opts_ & TPAGE)) roff_ += width_ * bnum_;
     int64_t rem = roff_ % align_;
     if (rem > 0) roff_ += align_ - rem;
     dfcur_ = roff_;
     frgcnt_ = 0;
+    sgrow_ = 0;
+    sfill_ = 0;
     tran_ = false;
   }
   /**
@@ -2370,8 +5454,9 @@ class HashDB : public BasicDB {
     size_t ksiz = sizeof(KCHDBCHKSUMSEED) - 1;
     char* zbuf = NULL;
     size_t zsiz = 0;
-    if (comp_) {
-      zbuf = comp_->compress(kbuf, ksiz, &zsiz);
+    Compressor* comp = (opts_ & TCOMPRESS) ? embcomp_ : NULL;
+    if (comp) {
+      zbuf = comp->compress(kbuf, ksiz, &zsiz);
       if (!zbuf) return 0;
       kbuf = zbuf;
       ksiz = zsiz;
@@ -2406,6 +5491,7 @@ class HashDB : public BasicDB {
     num = hton64(lsiz_);
     std::memcpy(head + MOFFSIZE, &num, sizeof(num));
     std::memcpy(head + MOFFOPAQUE, opaque_, sizeof(opaque_));
+    if (!journal_region(0, sizeof(head))) return false;
     if (!file_.write(0, head, sizeof(head))) {
       set_error(_KCCODELINE_, Error::SYSTEM, file_.error());
       return false;
@@ -2427,6 +5513,7 @@ class HashDB : public BasicDB {
     std::memcpy(head, &num, sizeof(num));
     num = hton64(lsiz_);
     std::memcpy(head + MOFFSIZE - MOFFCOUNT, &num, sizeof(num));
+    if (!journal_region(MOFFCOUNT, sizeof(head))) return false;
     if (!file_.write_fast(MOFFCOUNT, head, sizeof(head))) {
       set_error(_KCCODELINE_, Error::SYSTEM, file_.error());
       return false;
@@ -2441,6 +5528,7 @@ class HashDB : public BasicDB {
    */
   bool dump_opaque() {
     _assert_(true);
+    if (!journal_region(MOFFOPAQUE, sizeof(opaque_))) return false;
     if (!file_.write_fast(MOFFOPAQUE, opaque_, sizeof(opaque_))) {
       set_error(_KCCODELINE_, Error::SYSTEM, file_.error());
       return false;
@@ -2511,6 +5599,7 @@ class HashDB : public BasicDB {
     } else {
       flags &= ~flag;
     }
+    if (!journal_region(MOFFFLAGS, sizeof(flags))) return false;
     if (!file_.write(MOFFFLAGS, &flags, sizeof(flags))) {
       set_error(_KCCODELINE_, Error::SYSTEM, file_.error());
       return false;
@@ -2534,7 +5623,10 @@ class HashDB : public BasicDB {
     db.tune_buckets(bnum_);
     db.tune_map(msiz_);
     if (embcomp_) db.tune_compressor(embcomp_);
+    if (opts_ & TBLOB) db.tune_blob(bthres_, bgcratio_);
     const std::string& npath = path + File::EXTCHR + KCHDBTMPPATHEXT;
+    const std::string& nbpath = npath + File::EXTCHR + KCHDBBLBPATHEXT;
+    const std::string& nipath = npath + File::EXTCHR + KCHDBIDXPATHEXT;
     if (db.open(npath, OWRITER | OCREATE | OTRUNCATE)) {
       report(_KCCODELINE_, Logger::WARN, "reorganizing the database");
       lsiz_ = file_.size();
@@ -2544,6 +5636,20 @@ class HashDB : public BasicDB {
           if (!File::rename(npath, path)) {
             set_error(_KCCODELINE_, Error::SYSTEM, "renaming the destination failed");
             err = true;
+          } else if (opts_ & TBLOB) {
+            const std::string& bpath = path + File::EXTCHR + KCHDBBLBPATHEXT;
+            if (!File::rename(nbpath, bpath)) {
+              set_error(_KCCODELINE_, Error::SYSTEM, "renaming the destination blob failed");
+              err = true;
+            }
+            File::remove(bpath + File::EXTCHR + KCHDBTMPPATHEXT);
+          }
+          if (!err && (opts_ & TPAGE)) {
+            const std::string& ipath = path + File::EXTCHR + KCHDBIDXPATHEXT;
+            if (!File::rename(nipath, ipath)) {
+              set_error(_KCCODELINE_, Error::SYSTEM, "renaming the destination index failed");
+              err = true;
+            }
           }
         } else {
           set_error(_KCCODELINE_, db.error().code(), "closing the destination failed");
@@ -2554,6 +5660,8 @@ class HashDB : public BasicDB {
         err = true;
       }
       File::remove(npath);
+      File::remove(nbpath);
+      File::remove(nipath);
     } else {
       set_error(_KCCODELINE_, db.error().code(), "opening the destination failed");
       err = true;
@@ -2737,6 +5845,7 @@ class HashDB : public BasicDB {
     _assert_(bidx >= 0 && off >= 0);
     char buf[sizeof(uint64_t)];
     writefixnum(buf, off >> apow_, width_);
+    if (!journal_region(boff_ + bidx * width_, width_)) return false;
     if (!file_.write_fast(boff_ + bidx * width_, buf, width_)) {
       set_error(_KCCODELINE_, Error::SYSTEM, file_.error());
       return false;
@@ -2769,6 +5878,7 @@ class HashDB : public BasicDB {
     _assert_(entoff >= 0 && off >= 0);
     char buf[sizeof(uint64_t)];
     writefixnum(buf, off >> apow_, width_);
+    if (!journal_region(entoff, width_)) return false;
     if (!file_.write_fast(entoff, buf, width_)) {
       set_error(_KCCODELINE_, Error::SYSTEM, file_.error());
       return false;
@@ -2807,6 +5917,20 @@ class HashDB : public BasicDB {
              (long long)psiz_, (long long)rec->off, (long long)rsiz, (long long)file_.size());
       return false;
     }
+    return parse_record(rec, rbuf, rsiz);
+  }
+  /**
+   * Parse a record in a buffer read from the file.
+   * @param rec the record structure whose offset is set.
+   * @param rbuf the buffer beginning at the offset of the record.
+   * @param rsiz the size of the available region of the buffer.
+   * @return true on success, or false on failure.
+   * @note The key and the value refer to the buffer if they are in the available region.
+   * Otherwise, the body is read from the file if the key is not in the region, or the value
+   * is left NULL if only the value is not in the region.
+   */
+  bool parse_record(Record* rec, const char* rbuf, size_t rsiz) {
+    _assert_(rec && rbuf);
     const char* rp = rbuf;
     uint16_t snum;
     if (*(uint8_t*)rp == RECMAGIC) {
@@ -2991,7 +6115,9 @@ class HashDB : public BasicDB {
       wp += rec->psiz;
     }
     bool err = false;
-    if (over) {
+    if (!journal_region(rec->off, rec->rsiz)) {
+      err = true;
+    } else if (over) {
       if (!file_.write_fast(rec->off, rbuf, rec->rsiz)) {
         set_error(_KCCODELINE_, Error::SYSTEM, file_.error());
         err = true;
@@ -3012,8 +6138,9 @@ class HashDB : public BasicDB {
    */
   bool adjust_record(Record* rec) {
     _assert_(rec);
-    if (rec->psiz > (size_t)INT16MAX || rec->psiz > rec->rsiz / 2) {
-      size_t nsiz = (rec->psiz >> apow_) << apow_;
+    size_t ssiz = calc_record_slack(rec->vsiz);
+    if (rec->psiz > (size_t)INT16MAX || (rec->psiz > rec->rsiz / 2 && rec->psiz > ssiz)) {
+      size_t nsiz = ((rec->psiz - ssiz) >> apow_) << apow_;
       if (nsiz < rhsiz_) return true;
       rec->rsiz -= nsiz;
       rec->psiz -= nsiz;
@@ -3070,6 +6197,33 @@ class HashDB : public BasicDB {
     size_t diff = rsiz & (align_ - 1);
     return diff > 0 ? align_ - diff : 0;
   }
+  /**
+   * Calculate the size of the slack space of a value.
+   * @param vsiz the size of the value.
+   * @return the size of the slack space.
+   */
+  size_t calc_record_slack(size_t vsiz) {
+    _assert_(true);
+    if (sratio_ <= 0 || align_ >= (size_t)INT16MAX) return 0;
+    double ssiz = vsiz * sratio_;
+    double max = (size_t)INT16MAX - align_;
+    return (size_t)(ssiz < max ? ssiz : max);
+  }
+  /**
+   * Calculate the padding size of a relocated record whose value has grown.
+   * @param rsiz the size of the record.
+   * @param vsiz the size of the value.
+   * @return the size of the padding.
+   */
+  size_t calc_growth_padding(size_t rsiz, size_t vsiz) {
+    _assert_(true);
+    size_t psiz = calc_record_padding(rsiz);
+    size_t ssiz = calc_record_slack(vsiz);
+    if (ssiz <= psiz) return psiz;
+    ssiz += calc_record_padding(rsiz + ssiz);
+    sgrow_ += ssiz - psiz;
+    return ssiz;
+  }
   /**
    * Shift a record to another place.
    * @param orec the original record structure.
@@ -3080,7 +6234,31 @@ class HashDB : public BasicDB {
     _assert_(orec && dest >= 0);
     uint64_t hash = hash_record(orec->kbuf, orec->ksiz);
     uint32_t pivot = fold_hash(hash);
-    int64_t bidx = hash % bnum_;
+    int64_t bidx = bucket_index(hash);
+    if (iopen_) {
+      IndexPage page;
+      int64_t pno = bidx;
+      while (true) {
+        if (!read_index_page(pno, &page)) return false;
+        for (int32_t i = 0; i < page.num; i++) {
+          uint32_t thash;
+          uint16_t ttag;
+          int64_t toff;
+          get_index_slot(&page, i, &thash, &ttag, &toff);
+          if (toff != orec->off) continue;
+          orec->off = dest;
+          if (!write_record(orec, true)) return false;
+          set_index_slot(&page, i, hash, dest);
+          return write_index_page(&page);
+        }
+        if (page.next < 1) break;
+        pno = page.next;
+      }
+      set_error(_KCCODELINE_, Error::BROKEN, "no record to shift");
+      report(_KCCODELINE_, Logger::WARN, "psiz=%lld fsiz=%lld",
+             (long long)psiz_, (long long)file_.size());
+      return false;
+    }
     int64_t off = get_bucket(bidx);
     if (off < 0) return false;
     if (off == orec->off) {
@@ -3155,6 +6333,7 @@ class HashDB : public BasicDB {
     wp += width_;
     *(wp++) = PADMAGIC;
     *(wp++) = PADMAGIC;
+    if (!journal_region(off, wp - rbuf)) return false;
     if (!file_.write_fast(off, rbuf, wp - rbuf)) {
       set_error(_KCCODELINE_, Error::SYSTEM, file_.error());
       return false;
@@ -3191,7 +6370,11 @@ class HashDB : public BasicDB {
     ScopedSpinLock lock(&flock_);
     FreeBlock fb = { INT64MAX, rsiz };
     FBP::const_iterator it = fbp_.upper_bound(fb);
-    if (it == fbp_.end()) return false;
+    if (it == fbp_.end()) {
+      if (mtrc_) mtrc_->add(MCFBMISS);
+      return false;
+    }
+    if (mtrc_) mtrc_->add(MCFBREUSE);
     res->off = it->off;
     res->rsiz = it->rsiz;
     fbp_.erase(it);
@@ -3249,7 +6432,9 @@ class HashDB : public BasicDB {
     *(wp++) = 0;
     *(wp++) = 0;
     bool err = false;
-    if (!file_.write(HEADSIZ, rbuf, wp - rbuf)) {
+    if (!journal_region(HEADSIZ, wp - rbuf)) {
+      err = true;
+    } else if (!file_.write(HEADSIZ, rbuf, wp - rbuf)) {
       set_error(_KCCODELINE_, Error::SYSTEM, file_.error());
       err = true;
     }
@@ -3268,7 +6453,9 @@ class HashDB : public BasicDB {
     *(wp++) = 0;
     *(wp++) = 0;
     bool err = false;
-    if (!file_.write(HEADSIZ, rbuf, wp - rbuf)) {
+    if (!journal_region(HEADSIZ, wp - rbuf)) {
+      err = true;
+    } else if (!file_.write(HEADSIZ, rbuf, wp - rbuf)) {
       set_error(_KCCODELINE_, Error::SYSTEM, file_.error());
       err = true;
     }
@@ -3351,9 +6538,11 @@ class HashDB : public BasicDB {
    * Escape cursors on a free block.
    * @param off the offset of the free block.
    * @param dest the destination offset.
+   * @note The scan of the collection of the blob file is escaped as well.
    */
   void escape_cursors(int64_t off, int64_t dest) {
     _assert_(off >= 0 && dest >= 0);
+    if (bgcoff_ == off) bgcoff_ = dest;
     if (curs_.empty()) return;
     CursorList::const_iterator cit = curs_.begin();
     CursorList::const_iterator citend = curs_.end();
@@ -3468,6 +6657,14 @@ class HashDB : public BasicDB {
       file_.end_transaction(false);
       return false;
     }
+    if (iopen_) {
+      if (!ifile_.begin_transaction(trhard_, 0)) {
+        set_error(_KCCODELINE_, Error::SYSTEM, ifile_.error());
+        file_.end_transaction(false);
+        return false;
+      }
+      save_index_state();
+    }
     if (fbpnum_ > 0) {
       FBP::const_iterator it = fbp_.end();
       FBP::const_iterator itbeg = fbp_.begin();
@@ -3477,6 +6674,8 @@ class HashDB : public BasicDB {
         trfbp_.insert(*it);
       }
     }
+    trblive_ = blive_;
+    trbolive_ = bolive_;
     return true;
   }
   /**
@@ -3497,6 +6696,15 @@ class HashDB : public BasicDB {
       atlock_.unlock();
       return false;
     }
+    if (iopen_) {
+      if (!ifile_.begin_transaction(autosync_, 0)) {
+        set_error(_KCCODELINE_, Error::SYSTEM, ifile_.error());
+        file_.end_transaction(false);
+        atlock_.unlock();
+        return false;
+      }
+      save_index_state();
+    }
     return true;
   }
   /**
@@ -3506,7 +6714,14 @@ class HashDB : public BasicDB {
   bool commit_transaction() {
     _assert_(true);
     bool err = false;
+    if (bopen_ && !synchronize_blob(trhard_)) err = true;
+    if (iopen_ && !ifile_.end_transaction(true)) {
+      set_error(_KCCODELINE_, Error::SYSTEM, ifile_.error());
+      err = true;
+    }
+    tridir_.clear();
     if ((count_ != trcount_ || lsiz_ != trsize_) && !dump_auto_meta()) err = true;
+    if (mtrc_) mtrc_->add(MCWALSIZ, file_.wal_size());
     if (!file_.end_transaction(true)) {
       set_error(_KCCODELINE_, Error::SYSTEM, file_.error());
       err = true;
@@ -3521,7 +6736,13 @@ class HashDB : public BasicDB {
   bool commit_auto_transaction() {
     _assert_(true);
     bool err = false;
+    if (bopen_ && !synchronize_blob(autosync_)) err = true;
+    if (iopen_ && !ifile_.end_transaction(true)) {
+      set_error(_KCCODELINE_, Error::SYSTEM, ifile_.error());
+      err = true;
+    }
     if ((count_ != trcount_ || lsiz_ != trsize_) && !dump_auto_meta()) err = true;
+    if (mtrc_) mtrc_->add(MCWALSIZ, file_.wal_size());
     if (!file_.end_transaction(true)) {
       set_error(_KCCODELINE_, Error::SYSTEM, file_.error());
       err = true;
@@ -3540,6 +6761,7 @@ class HashDB : public BasicDB {
       set_error(_KCCODELINE_, Error::SYSTEM, file_.error());
       err = true;
     }
+    if (iopen_ && !abort_index_transaction()) err = true;
     bool flagopen = flagopen_;
     if (!load_meta()) err = true;
     flagopen_ = flagopen;
@@ -3547,6 +6769,8 @@ class HashDB : public BasicDB {
     disable_cursors();
     fbp_.swap(trfbp_);
     trfbp_.clear();
+    blive_ = trblive_;
+    bolive_ = trbolive_;
     return !err;
   }
   /**
@@ -3560,6 +6784,7 @@ class HashDB : public BasicDB {
       set_error(_KCCODELINE_, Error::SYSTEM, file_.error());
       err = true;
     }
+    if (iopen_ && !abort_index_transaction()) err = true;
     if (!load_meta()) err = true;
     calc_meta();
     disable_cursors();
@@ -3587,6 +6812,8 @@ class HashDB : public BasicDB {
   uint32_t logkinds_;
   /** The internal meta operation trigger. */
   MetaTrigger* mtrigger_;
+  /** The collector of runtime metrics. */
+  Metrics* mtrc_;
   /** The open mode. */
   uint32_t omode_;
   /** The flag for writer. */
@@ -3601,6 +6828,20 @@ class HashDB : public BasicDB {
   bool trim_;
   /** The file for data. */
   File file_;
+  /** The file for the recovery journal. */
+  File jnfile_;
+  /** The locks for the regions of the recovery journal. */
+  SlottedMutex jnlock_;
+  /** The region unit of the recovery journal. */
+  int64_t jnunit_;
+  /** The flag whether the recovery journal is open. */
+  bool jnopen_;
+  /** The logical size of the file at the restoration point. */
+  int64_t jnsiz_;
+  /** The bit flags of the regions saved in the current epoch. */
+  std::vector<AtomicInt64> jnflags_;
+  /** The flag for recovered by the journal. */
+  bool jnrec_;
   /** The free block pool. */
   FBP fbp_;
   /** The cursor objects. */
@@ -3663,6 +6904,68 @@ class HashDB : public BasicDB {
   int64_t dfcur_;
   /** The count of fragmentation. */
   AtomicInt64 frgcnt_;
+  /** The ratio of the slack space reserved for growing values. */
+  double sratio_;
+  /** The total size of the slack space reserved since opening. */
+  AtomicInt64 sgrow_;
+  /** The total size of the values appended into the slack space since opening. */
+  AtomicInt64 sfill_;
+  /** The compressor to separate large values. */
+  BlobCompressor blbcomp_;
+  /** The threshold of the size of values stored in the blob file. */
+  int64_t bthres_;
+  /** The ratio of live data under which the blob file is collected. */
+  double bgcratio_;
+  /** The blob file. */
+  File bfile_;
+  /** The flag whether the blob file is open. */
+  bool bopen_;
+  /** The generation of the blob file. */
+  int64_t bgen_;
+  /** The size of the blob file. */
+  AtomicInt64 bsize_;
+  /** The size of live values in the blob file. */
+  AtomicInt64 blive_;
+  /** The blob file of the next generation under collection. */
+  File bofile_;
+  /** The flag whether the blob file under collection is open. */
+  bool boopen_;
+  /** The generation of the blob file under collection. */
+  int64_t bogen_;
+  /** The size of the blob file under collection. */
+  AtomicInt64 bosize_;
+  /** The size of live values in the blob file under collection. */
+  AtomicInt64 bolive_;
+  /** The offset of the next record scanned by the collection, or 0 if not collecting. */
+  int64_t bgcoff_;
+  /** The number of collections of the blob file. */
+  int64_t bgccnt_;
+  /** The index file. */
+  File ifile_;
+  /** The flag whether the index file is open. */
+  bool iopen_;
+  /** The lock for allocation of bucket pages. */
+  Mutex iplock_;
+  /** The base depth of the directory. */
+  int32_t ibdepth_;
+  /** The global depth of the directory. */
+  int32_t igdepth_;
+  /** The directory of primary bucket pages. */
+  std::vector<uint32_t> idir_;
+  /** The number of bucket pages. */
+  int64_t ipnum_;
+  /** The first page of the free page list. */
+  int64_t ifree_;
+  /** The size of a slot of a bucket page. */
+  int32_t islotsiz_;
+  /** The number of slots of a bucket page. */
+  int32_t islotnum_;
+  /** The hash values of keys whose bucket pages overflow. */
+  std::set<uint32_t> isplits_;
+  /** The number of pending page splits. */
+  AtomicInt64 ispnum_;
+  /** The number of page splits. */
+  int64_t isplitcnt_;
   /** The flag whether in transaction. */
   bool tran_;
   /** The flag whether hard transaction. */
@@ -3673,6 +6976,20 @@ class HashDB : public BasicDB {
   int64_t trcount_;
   /** The size history for transaction. */
   int64_t trsize_;
+  /** The live size of the blob file history for transaction. */
+  int64_t trblive_;
+  /** The live size of the blob file under collection history for transaction. */
+  int64_t trbolive_;
+  /** The number of bucket pages history for transaction. */
+  int64_t tripnum_;
+  /** The first page of the free page list history for transaction. */
+  int64_t trifree_;
+  /** The global depth of the directory history for transaction. */
+  int32_t trigdepth_;
+  /** The directory history for transaction, saved before the first split. */
+  std::vector<uint32_t> tridir_;
+  /** The number of record-level transactions in progress. */
+  AtomicInt64 txnum_;
 };
 
 
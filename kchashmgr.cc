@@ -38,6 +38,7 @@ static int32_t rundump(int argc, char** argv);
 static int32_t runload(int argc, char** argv);
 static int32_t rundefrag(int argc, char** argv);
 static int32_t runcheck(int argc, char** argv);
+static int32_t runanalyze(int argc, char** argv);
 static int32_t runsetbulk(int argc, char** argv);
 static int32_t runremovebulk(int argc, char** argv);
 static int32_t rungetbulk(int argc, char** argv);
@@ -52,10 +53,13 @@ static int32_t procget(const char* path, const char* kbuf, size_t ksiz,
 static int32_t proclist(const char* path, const char*kbuf, size_t ksiz, int32_t oflags,
                         int64_t max, bool pv, bool px);
 static int32_t procclear(const char* path, int32_t oflags);
-static int32_t procimport(const char* path, const char* file, int32_t oflags, bool sx);
+static int32_t procimport(const char* path, const char* file, int32_t oflags, bool sx,
+                          int32_t thnum, int64_t bulk);
 static int32_t proccopy(const char* path, const char* file, int32_t oflags);
-static int32_t procdump(const char* path, const char* file, int32_t oflags);
-static int32_t procload(const char* path, const char* file, int32_t oflags);
+static int32_t procdump(const char* path, const char* file, int32_t oflags,
+                        int32_t codec, int32_t thnum);
+static int32_t procload(const char* path, const char* file, int32_t oflags,
+                        int32_t thnum, const char* kbstr, const char* kestr);
 static int32_t procdefrag(const char* path, int32_t oflags);
 static int32_t procsetbulk(const char* path, int32_t oflags,
                            const std::map<std::string, std::string>& recs);
@@ -64,6 +68,7 @@ static int32_t procremovebulk(const char* path, int32_t oflags,
 static int32_t procgetbulk(const char* path, int32_t oflags,
                            const std::vector<std::string>& keys, bool px);
 static int32_t proccheck(const char* path, int32_t oflags);
+static int32_t procanalyze(const char* path, int32_t oflags, int64_t snum, bool apply);
 
 
 // main routine
@@ -104,6 +109,8 @@ int main(int argc, char** argv) {
     rv = rungetbulk(argc, argv);
   } else if (!std::strcmp(argv[1], "check")) {
     rv = runcheck(argc, argv);
+  } else if (!std::strcmp(argv[1], "analyze")) {
+    rv = runanalyze(argc, argv);
   } else if (!std::strcmp(argv[1], "version") || !std::strcmp(argv[1], "--version")) {
     printversion();
   } else {
@@ -120,7 +127,7 @@ static void usage() {
   eprintf("\n");
   eprintf("usage:\n");
   eprintf("  %s create [-otr] [-onl|-otl|-onr] [-apow num] [-fpow num] [-ts] [-tl] [-tc]"
-          " [-bnum num] path\n", g_progname);
+          " [-tb] [-tp] [-bnum num] path\n", g_progname);
   eprintf("  %s inform [-onl|-otl|-onr] [-st] path\n", g_progname);
   eprintf("  %s set [-onl|-otl|-onr] [-add|-rep|-app|-inci|-incd] [-sx] path key value\n",
           g_progname);
@@ -128,15 +135,18 @@ static void usage() {
   eprintf("  %s get [-onl|-otl|-onr] [-sx] [-px] [-pz] path key\n", g_progname);
   eprintf("  %s list [-onl|-otl|-onr] [-max num] [-sx] [-pv] [-px] path [key]\n", g_progname);
   eprintf("  %s clear [-onl|-otl|-onr] path\n", g_progname);
-  eprintf("  %s import [-onl|-otl|-onr] [-sx] path [file]\n", g_progname);
+  eprintf("  %s import [-onl|-otl|-onr] [-sx] [-th num] [-bulk num] path [file]\n",
+          g_progname);
   eprintf("  %s copy [-onl|-otl|-onr] path file\n", g_progname);
-  eprintf("  %s dump [-onl|-otl|-onr] path [file]\n", g_progname);
-  eprintf("  %s load [-otr] [-onl|-otl|-onr] path [file]\n", g_progname);
+  eprintf("  %s dump [-onl|-otl|-onr] [-blk str] [-th num] path [file]\n", g_progname);
+  eprintf("  %s load [-otr] [-onl|-otl|-onr] [-th num] [-kb str] [-ke str] path [file]\n",
+          g_progname);
   eprintf("  %s defrag [-onl|-otl|-onr] path\n", g_progname);
   eprintf("  %s setbulk [-onl|-otl|-onr] [-sx] path key value ...\n", g_progname);
   eprintf("  %s removebulk [-onl|-otl|-onr] [-sx] path key ...\n", g_progname);
   eprintf("  %s getbulk [-onl|-otl|-onr] [-sx] [-px] path key ...\n", g_progname);
   eprintf("  %s check [-onl|-otl|-onr] path\n", g_progname);
+  eprintf("  %s analyze [-onl|-otl|-onr] [-snum num] [-apply] path\n", g_progname);
   eprintf("\n");
   std::exit(1);
 }
@@ -183,6 +193,10 @@ static int32_t runcreate(int argc, char** argv) {
         opts |= kc::HashDB::TLINEAR;
       } else if (!std::strcmp(argv[i], "-tc")) {
         opts |= kc::HashDB::TCOMPRESS;
+      } else if (!std::strcmp(argv[i], "-tb")) {
+        opts |= kc::HashDB::TBLOB;
+      } else if (!std::strcmp(argv[i], "-tp")) {
+        opts |= kc::HashDB::TPAGE;
       } else if (!std::strcmp(argv[i], "-bnum")) {
         if (++i >= argc) usage();
         bnum = kc::atoix(argv[i]);
@@ -503,6 +517,8 @@ static int32_t runimport(int argc, char** argv) {
   const char* file = NULL;
   int32_t oflags = 0;
   bool sx = false;
+  int32_t thnum = 1;
+  int64_t bulk = IMPBULKNUM;
   for (int32_t i = 2; i < argc; i++) {
     if (!argbrk && argv[i][0] == '-') {
       if (!std::strcmp(argv[i], "--")) {
@@ -515,6 +531,12 @@ static int32_t runimport(int argc, char** argv) {
         oflags |= kc::HashDB::ONOREPAIR;
       } else if (!std::strcmp(argv[i], "-sx")) {
         sx = true;
+      } else if (!std::strcmp(argv[i], "-th")) {
+        if (++i >= argc) usage();
+        thnum = kc::atoix(argv[i]);
+      } else if (!std::strcmp(argv[i], "-bulk")) {
+        if (++i >= argc) usage();
+        bulk = kc::atoix(argv[i]);
       } else {
         usage();
       }
@@ -527,8 +549,8 @@ static int32_t runimport(int argc, char** argv) {
       usage();
     }
   }
-  if (!path) usage();
-  int32_t rv = procimport(path, file, oflags, sx);
+  if (!path || thnum < 1 || bulk < 1) usage();
+  int32_t rv = procimport(path, file, oflags, sx, thnum, bulk);
   return rv;
 }
 
@@ -573,6 +595,8 @@ static int32_t rundump(int argc, char** argv) {
   const char* path = NULL;
   const char* file = NULL;
   int32_t oflags = 0;
+  int32_t codec = -1;
+  int32_t thnum = 1;
   for (int32_t i = 2; i < argc; i++) {
     if (!argbrk && argv[i][0] == '-') {
       if (!std::strcmp(argv[i], "--")) {
@@ -583,6 +607,21 @@ static int32_t rundump(int argc, char** argv) {
         oflags |= kc::HashDB::OTRYLOCK;
       } else if (!std::strcmp(argv[i], "-onr")) {
         oflags |= kc::HashDB::ONOREPAIR;
+      } else if (!std::strcmp(argv[i], "-blk")) {
+        if (++i >= argc) usage();
+        codec = kc::BasicDB::SBCZLIB;
+        if (!std::strcmp(argv[i], "none")) {
+          codec = kc::BasicDB::SBCNONE;
+        } else if (!std::strcmp(argv[i], "lzo")) {
+          codec = kc::BasicDB::SBCLZO;
+        } else if (!std::strcmp(argv[i], "lzma")) {
+          codec = kc::BasicDB::SBCLZMA;
+        } else if (std::strcmp(argv[i], "zlib")) {
+          usage();
+        }
+      } else if (!std::strcmp(argv[i], "-th")) {
+        if (++i >= argc) usage();
+        thnum = kc::atoix(argv[i]);
       } else {
         usage();
       }
@@ -595,8 +634,8 @@ static int32_t rundump(int argc, char** argv) {
       usage();
     }
   }
-  if (!path) usage();
-  int32_t rv = procdump(path, file, oflags);
+  if (!path || thnum < 1) usage();
+  int32_t rv = procdump(path, file, oflags, codec, thnum);
   return rv;
 }
 
@@ -607,6 +646,9 @@ static int32_t runload(int argc, char** argv) {
   const char* path = NULL;
   const char* file = NULL;
   int32_t oflags = 0;
+  int32_t thnum = 1;
+  const char* kbstr = NULL;
+  const char* kestr = NULL;
   for (int32_t i = 2; i < argc; i++) {
     if (!argbrk && argv[i][0] == '-') {
       if (!std::strcmp(argv[i], "--")) {
@@ -619,6 +661,15 @@ static int32_t runload(int argc, char** argv) {
         oflags |= kc::HashDB::OTRYLOCK;
       } else if (!std::strcmp(argv[i], "-onr")) {
         oflags |= kc::HashDB::ONOREPAIR;
+      } else if (!std::strcmp(argv[i], "-th")) {
+        if (++i >= argc) usage();
+        thnum = kc::atoix(argv[i]);
+      } else if (!std::strcmp(argv[i], "-kb")) {
+        if (++i >= argc) usage();
+        kbstr = argv[i];
+      } else if (!std::strcmp(argv[i], "-ke")) {
+        if (++i >= argc) usage();
+        kestr = argv[i];
       } else {
         usage();
       }
@@ -631,8 +682,8 @@ static int32_t runload(int argc, char** argv) {
       usage();
     }
   }
-  if (!path) usage();
-  int32_t rv = procload(path, file, oflags);
+  if (!path || thnum < 1 || ((kbstr || kestr) && !file)) usage();
+  int32_t rv = procload(path, file, oflags, thnum, kbstr, kestr);
   return rv;
 }
 
@@ -853,6 +904,44 @@ static int32_t runcheck(int argc, char** argv) {
 }
 
 
+// parse arguments of analyze command
+static int32_t runanalyze(int argc, char** argv) {
+  bool argbrk = false;
+  const char* path = NULL;
+  int32_t oflags = 0;
+  int64_t snum = 0;
+  bool apply = false;
+  for (int32_t i = 2; i < argc; i++) {
+    if (!argbrk && argv[i][0] == '-') {
+      if (!std::strcmp(argv[i], "--")) {
+        argbrk = true;
+      } else if (!std::strcmp(argv[i], "-onl")) {
+        oflags |= kc::HashDB::ONOLOCK;
+      } else if (!std::strcmp(argv[i], "-otl")) {
+        oflags |= kc::HashDB::OTRYLOCK;
+      } else if (!std::strcmp(argv[i], "-onr")) {
+        oflags |= kc::HashDB::ONOREPAIR;
+      } else if (!std::strcmp(argv[i], "-snum")) {
+        if (++i >= argc) usage();
+        snum = kc::atoix(argv[i]);
+      } else if (!std::strcmp(argv[i], "-apply")) {
+        apply = true;
+      } else {
+        usage();
+      }
+    } else if (!path) {
+      argbrk = true;
+      path = argv[i];
+    } else {
+      usage();
+    }
+  }
+  if (!path) usage();
+  int32_t rv = procanalyze(path, oflags, snum, apply);
+  return rv;
+}
+
+
 // perform create command
 static int32_t proccreate(const char* path, int32_t oflags,
                           int32_t apow, int32_t fpow, int32_t opts, int64_t bnum) {
@@ -889,6 +978,7 @@ static int32_t procinform(const char* path, int32_t oflags, bool st) {
     status["opaque"] = "";
     status["fbpnum_used"] = "";
     status["bnum_used"] = "";
+    status["padding"] = "";
     if (db.status(&status)) {
       uint32_t type = kc::atoi(status["type"].c_str());
       oprintf("type: %s (%s) (type=0x%02X)\n",
@@ -923,6 +1013,8 @@ static int32_t procinform(const char* path, int32_t oflags, bool st) {
       if (opts & kc::HashDB::TSMALL) oprintf(" small");
       if (opts & kc::HashDB::TLINEAR) oprintf(" linear");
       if (opts & kc::HashDB::TCOMPRESS) oprintf(" compress");
+      if (opts & kc::HashDB::TBLOB) oprintf(" blob");
+      if (opts & kc::HashDB::TPAGE) oprintf(" page");
       oprintf(" (opts=%d)\n", opts);
       if (status["opaque"].size() >= 16) {
         const char* opaque = status["opaque"].c_str();
@@ -944,8 +1036,13 @@ static int32_t procinform(const char* path, int32_t oflags, bool st) {
         load = (double)count / bnumused;
         if (!(opts & kc::HashDB::TLINEAR)) load = std::log(load + 1) / std::log(2.0);
       }
-      oprintf("buckets: %lld (used=%lld) (load=%.2f)\n",
-              (long long)bnum, (long long)bnumused, load);
+      if (status.count("ipnum") > 0) {
+        oprintf("pages: %s (slots=%s) (depth=%s) (split=%s)\n", status["ipnum"].c_str(),
+                status["islots"].c_str(), status["idepth"].c_str(), status["isplit"].c_str());
+      } else {
+        oprintf("buckets: %lld (used=%lld) (load=%.2f)\n",
+                (long long)bnum, (long long)bnumused, load);
+      }
       std::string cntstr = unitnumstr(count);
       oprintf("count: %lld (%s)\n", count, cntstr.c_str());
       int64_t size = kc::atoi(status["size"].c_str());
@@ -955,6 +1052,21 @@ static int32_t procinform(const char* path, int32_t oflags, bool st) {
       oprintf("size: %lld (%s) (map=%lld)", size, sizestr.c_str(), (long long)msiz);
       if (size != realsize) oprintf(" (gap=%lld)", (long long)(realsize - size));
       oprintf("\n");
+      if (status.count("bsize") > 0) {
+        int64_t bsize = kc::atoi(status["bsize"].c_str());
+        int64_t blive = kc::atoi(status["blive"].c_str());
+        std::string bsizestr = unitnumstrbyte(bsize);
+        oprintf("blob: %lld (%s) (live=%lld) (gen=%s) (thres=%s)\n", (long long)bsize,
+                bsizestr.c_str(), (long long)blive, status["bgen"].c_str(),
+                status["bthres"].c_str());
+      }
+      if (status.count("padding") > 0) {
+        int64_t pdsiz = kc::atoi(status["padding"].c_str());
+        std::string pdsizstr = unitnumstrbyte(pdsiz);
+        oprintf("padding: %lld (%s) (slack=%s) (grown=%s) (filled=%s)\n", (long long)pdsiz,
+                pdsizstr.c_str(), status["sratio"].c_str(), status["sgrow"].c_str(),
+                status["sfill"].c_str());
+      }
     } else {
       dberrprint(&db, "DB::status failed");
       err = true;
@@ -1182,7 +1294,8 @@ static int32_t procclear(const char* path, int32_t oflags) {
 
 
 // perform import command
-static int32_t procimport(const char* path, const char* file, int32_t oflags, bool sx) {
+static int32_t procimport(const char* path, const char* file, int32_t oflags, bool sx,
+                          int32_t thnum, int64_t bulk) {
   std::istream *is = &std::cin;
   std::ifstream ifs;
   if (file) {
@@ -1200,44 +1313,11 @@ static int32_t procimport(const char* path, const char* file, int32_t oflags, bo
     return 1;
   }
   bool err = false;
-  int64_t cnt = 0;
-  std::string line;
-  std::vector<std::string> fields;
-  while (!err && mygetline(is, &line)) {
-    cnt++;
-    kc::strsplit(line, '\t', &fields);
-    if (sx) {
-      std::vector<std::string>::iterator it = fields.begin();
-      std::vector<std::string>::iterator itend = fields.end();
-      while (it != itend) {
-        size_t esiz;
-        char* ebuf = kc::hexdecode(it->c_str(), &esiz);
-        it->clear();
-        it->append(ebuf, esiz);
-        delete[] ebuf;
-        ++it;
-      }
-    }
-    switch (fields.size()) {
-      case 2: {
-        if (!db.set(fields[0], fields[1])) {
-          dberrprint(&db, "DB::set failed");
-          err = true;
-        }
-        break;
-      }
-      case 1: {
-        if (!db.remove(fields[0]) && db.error() != kc::BasicDB::Error::NOREC) {
-          dberrprint(&db, "DB::remove failed");
-          err = true;
-        }
-        break;
-      }
-    }
-    oputchar('.');
-    if (cnt % 50 == 0) oprintf(" (%lld)\n", (long long)cnt);
+  const char* fname = NULL;
+  if (!importtsv(&db, is, sx, thnum, bulk, &fname)) {
+    dberrprint(&db, fname);
+    err = true;
   }
-  if (cnt % 50 > 0) oprintf(" (%lld)\n", (long long)cnt);
   if (!db.close()) {
     dberrprint(&db, "DB::close failed");
     err = true;
@@ -1271,7 +1351,8 @@ static int32_t proccopy(const char* path, const char* file, int32_t oflags) {
 
 
 // perform dump command
-static int32_t procdump(const char* path, const char* file, int32_t oflags) {
+static int32_t procdump(const char* path, const char* file, int32_t oflags,
+                        int32_t codec, int32_t thnum) {
   kc::HashDB db;
   db.tune_logger(stdlogger(g_progname, &std::cerr));
   if (!db.open(path, kc::HashDB::OREADER | oflags)) {
@@ -1281,14 +1362,18 @@ static int32_t procdump(const char* path, const char* file, int32_t oflags) {
   bool err = false;
   if (file) {
     DotChecker checker(&std::cout, 1000);
-    if (!db.dump_snapshot(file)) {
+    bool ok = codec >= 0 ? db.dump_snapshot_blocks(file, codec, thnum, 0) :
+        db.dump_snapshot(file);
+    if (!ok) {
       dberrprint(&db, "DB::dump_snapshot");
       err = true;
     }
     oprintf(" (end)\n");
     if (!err) oprintf("%lld records were dumped successfully\n", (long long)checker.count());
   } else {
-    if (!db.dump_snapshot(&std::cout)) {
+    bool ok = codec >= 0 ? db.dump_snapshot_blocks(&std::cout, codec, thnum) :
+        db.dump_snapshot(&std::cout);
+    if (!ok) {
       dberrprint(&db, "DB::dump_snapshot");
       err = true;
     }
@@ -1302,7 +1387,8 @@ static int32_t procdump(const char* path, const char* file, int32_t oflags) {
 
 
 // perform load command
-static int32_t procload(const char* path, const char* file, int32_t oflags) {
+static int32_t procload(const char* path, const char* file, int32_t oflags,
+                        int32_t thnum, const char* kbstr, const char* kestr) {
   kc::HashDB db;
   db.tune_logger(stdlogger(g_progname, &std::cerr));
   if (!db.open(path, kc::HashDB::OWRITER | kc::HashDB::OCREATE | oflags)) {
@@ -1312,7 +1398,11 @@ static int32_t procload(const char* path, const char* file, int32_t oflags) {
   bool err = false;
   if (file) {
     DotChecker checker(&std::cout, -1000);
-    if (!db.load_snapshot(file)) {
+    bool ok = kbstr || kestr ?
+        db.load_snapshot_range(file, kbstr, kbstr ? std::strlen(kbstr) : 0,
+                               kestr, kestr ? std::strlen(kestr) : 0) :
+        db.load_snapshot_parallel(file, thnum);
+    if (!ok) {
       dberrprint(&db, "DB::load_snapshot");
       err = true;
     }
@@ -1320,7 +1410,7 @@ static int32_t procload(const char* path, const char* file, int32_t oflags) {
     if (!err) oprintf("%lld records were loaded successfully\n", (long long)checker.count());
   } else {
     DotChecker checker(&std::cout, -1000);
-    if (!db.load_snapshot(&std::cin)) {
+    if (!db.load_snapshot_parallel(&std::cin, thnum)) {
       dberrprint(&db, "DB::load_snapshot");
       err = true;
     }
@@ -1512,5 +1602,97 @@ static int32_t proccheck(const char* path, int32_t oflags) {
 }
 
 
+// perform analyze command
+static int32_t procanalyze(const char* path, int32_t oflags, int64_t snum, bool apply) {
+  kc::HashDB db;
+  db.tune_logger(stdlogger(g_progname, &std::cerr));
+  uint32_t omode = apply ? kc::HashDB::OWRITER : kc::HashDB::OREADER;
+  if (!db.open(path, omode | oflags)) {
+    dberrprint(&db, "DB::open failed");
+    return 1;
+  }
+  bool err = false;
+  std::map<std::string, std::string> result;
+  std::map<std::string, std::string> status;
+  if (db.analyze(&result, snum) && db.status(&status)) {
+    std::map<std::string, std::string>::iterator it = result.begin();
+    std::map<std::string, std::string>::iterator itend = result.end();
+    while (it != itend) {
+      oprintf("%s: %s\n", it->first.c_str(), it->second.c_str());
+      ++it;
+    }
+    oprintf("runtime parameters: msiz=%s dfunit=%s\n",
+            result["rec_msiz"].c_str(), result["rec_dfunit"].c_str());
+    oprintf("structural parameters: bnum=%s apow=%s fpow=%s\n", result["rec_bnum"].c_str(),
+            result["rec_apow"].c_str(), result["rec_fpow"].c_str());
+  } else {
+    dberrprint(&db, "DB::analyze failed");
+    err = true;
+  }
+  bool rebuild = apply && !err && kc::atoi(result["rebuild"].c_str()) > 0;
+  std::string npath;
+  if (rebuild) {
+    kc::HashDB ndb;
+    ndb.tune_logger(stdlogger(g_progname, &std::cerr));
+    ndb.tune_alignment(kc::atoi(result["rec_apow"].c_str()));
+    ndb.tune_fbp(kc::atoi(result["rec_fpow"].c_str()));
+    ndb.tune_options(kc::atoi(status["opts"].c_str()));
+    ndb.tune_buckets(kc::atoi(result["rec_bnum"].c_str()));
+    npath = std::string(path) + kc::File::EXTCHR + KCHDBTMPPATHEXT;
+    oprintf("rebuilding the database into %s\n", npath.c_str());
+    uint32_t nmode = kc::HashDB::OWRITER | kc::HashDB::OCREATE | kc::HashDB::OTRUNCATE;
+    if (ndb.open(npath, nmode)) {
+      class VisitorImpl : public kc::DB::Visitor {
+       public:
+        explicit VisitorImpl(kc::BasicDB* dest) : dest_(dest), err_(false) {}
+        bool error() {
+          return err_;
+        }
+       private:
+        const char* visit_full(const char* kbuf, size_t ksiz,
+                               const char* vbuf, size_t vsiz, size_t* sp) {
+          if (!err_ && !dest_->set(kbuf, ksiz, vbuf, vsiz)) err_ = true;
+          return NOP;
+        }
+        kc::BasicDB* dest_;
+        bool err_;
+      } visitor(&ndb);
+      DotChecker checker(&std::cout, -1000);
+      if (!db.iterate(&visitor, false, &checker)) {
+        dberrprint(&db, "DB::iterate failed");
+        err = true;
+      }
+      oprintf(" (end)\n");
+      if (visitor.error()) {
+        dberrprint(&ndb, "DB::set failed");
+        err = true;
+      }
+      if (!ndb.close()) {
+        dberrprint(&ndb, "DB::close failed");
+        err = true;
+      }
+    } else {
+      dberrprint(&ndb, "DB::open failed");
+      err = true;
+    }
+  }
+  if (!db.close()) {
+    dberrprint(&db, "DB::close failed");
+    err = true;
+  }
+  if (rebuild) {
+    if (err) {
+      kc::File::remove(npath);
+    } else if (kc::File::rename(npath, path)) {
+      oprintf("the database was rebuilt successfully\n");
+    } else {
+      eprintf("%s: %s: renaming the rebuilt database failed\n", g_progname, path);
+      err = true;
+    }
+  }
+  return err ? 1 : 0;
+}
+
+
 
 // END OF FILE
@@ -32,18 +32,29 @@ static int32_t runorder(int argc, char** argv);
 static int32_t runqueue(int argc, char** argv);
 static int32_t runwicked(int argc, char** argv);
 static int32_t runtran(int argc, char** argv);
+static int32_t runcrash(int argc, char** argv);
+static int32_t runrectran(int argc, char** argv);
 static int32_t procorder(const char* path, int64_t rnum, int32_t thnum, bool rnd, int32_t mode,
                          bool tran, int32_t oflags, int32_t apow, int32_t fpow,
-                         int32_t opts, int64_t bnum, int64_t msiz, int64_t dfunit, bool lv);
+                         int32_t opts, int64_t bnum, int64_t msiz, int64_t dfunit,
+                         double sratio, bool lv);
 static int32_t procqueue(const char* path, int64_t rnum, int32_t thnum, int32_t itnum,
                          bool rnd, int32_t oflags, int32_t apow, int32_t fpow, int32_t opts,
                          int64_t bnum, int64_t msiz, int64_t dfunit, bool lv);
 static int32_t procwicked(const char* path, int64_t rnum, int32_t thnum, int32_t itnum,
                           int32_t oflags, int32_t apow, int32_t fpow, int32_t opts,
-                          int64_t bnum, int64_t msiz, int64_t dfunit, bool lv);
+                          int64_t bnum, int64_t msiz, int64_t dfunit, int64_t bthres,
+                          double sratio, bool lv);
 static int32_t proctran(const char* path, int64_t rnum, int32_t thnum, int32_t itnum, bool hard,
                         int32_t oflags, int32_t apow, int32_t fpow, int32_t opts,
-                        int64_t bnum, int64_t msiz, int64_t dfunit, bool lv);
+                        int64_t bnum, int64_t msiz, int64_t dfunit, int64_t bthres, bool lv);
+static int32_t proccrash(const char* path, int64_t rnum, int32_t itnum, int64_t jnunit,
+                         int32_t oflags, int32_t apow, int32_t fpow, int32_t opts,
+                         int64_t bnum, int64_t msiz, int64_t dfunit, bool lv);
+static bool readimage(const std::string& path, std::string* img);
+static int32_t procrectran(const char* path, int64_t rnum, int32_t thnum, bool sync,
+                           int32_t oflags, int32_t apow, int32_t fpow, int32_t opts,
+                           int64_t bnum, int64_t msiz, int64_t dfunit, bool lv);
 
 
 // main routine
@@ -64,6 +75,10 @@ int main(int argc, char** argv) {
     rv = runwicked(argc, argv);
   } else if (!std::strcmp(argv[1], "tran")) {
     rv = runtran(argc, argv);
+  } else if (!std::strcmp(argv[1], "crash")) {
+    rv = runcrash(argc, argv);
+  } else if (!std::strcmp(argv[1], "rectran")) {
+    rv = runrectran(argc, argv);
   } else {
     usage();
   }
@@ -84,17 +99,22 @@ static void usage() {
   eprintf("\n");
   eprintf("usage:\n");
   eprintf("  %s order [-th num] [-rnd] [-set|-get|-getw|-rem|-etc] [-tran]"
-          " [-oat|-oas|-onl|-otl|-onr] [-apow num] [-fpow num] [-ts] [-tl] [-tc] [-bnum num]"
-          " [-msiz num] [-dfunit num] [-lv] path rnum\n", g_progname);
+          " [-oat|-oas|-onl|-otl|-onr] [-apow num] [-fpow num] [-ts] [-tl] [-tc] [-tp]"
+          " [-bnum num] [-msiz num] [-dfunit num] [-sratio num] [-lv] path rnum\n", g_progname);
   eprintf("  %s queue [-th num] [-it num] [-rnd] [-oat|-oas|-onl|-otl|-onr]"
-          " [-apow num] [-fpow num] [-ts] [-tl] [-tc] [-bnum num] [-msiz num] [-dfunit num]"
-          " [-lv] path rnum\n", g_progname);
+          " [-apow num] [-fpow num] [-ts] [-tl] [-tc] [-tp] [-bnum num] [-msiz num]"
+          " [-dfunit num] [-lv] path rnum\n", g_progname);
   eprintf("  %s wicked [-th num] [-it num] [-oat|-oas|-onl|-otl|-onr]"
-          " [-apow num] [-fpow num] [-ts] [-tl] [-tc] [-bnum num] [-msiz num] [-dfunit num]"
-          " [-lv] path rnum\n", g_progname);
+          " [-apow num] [-fpow num] [-ts] [-tl] [-tc] [-tp] [-bnum num] [-msiz num]"
+          " [-dfunit num] [-bthres num] [-sratio num] [-lv] path rnum\n", g_progname);
   eprintf("  %s tran [-th num] [-it num] [-hard] [-oat|-oas|-onl|-otl|-onr]"
-          " [-apow num] [-fpow num] [-ts] [-tl] [-tc] [-bnum num] [-msiz num] [-dfunit num]"
-          " [-lv] path rnum\n", g_progname);
+          " [-apow num] [-fpow num] [-ts] [-tl] [-tc] [-tp] [-bnum num] [-msiz num]"
+          " [-dfunit num] [-bthres num] [-lv] path rnum\n", g_progname);
+  eprintf("  %s crash [-it num] [-jnunit num] [-oas] [-apow num] [-fpow num] [-ts] [-tl] [-tc]"
+          " [-tp] [-bnum num] [-msiz num] [-dfunit num] [-lv] path rnum\n", g_progname);
+  eprintf("  %s rectran [-th num] [-sync] [-oat|-oas|-onl|-otl|-onr] [-apow num] [-fpow num]"
+          " [-ts] [-tl] [-tc] [-tp] [-bnum num] [-msiz num] [-dfunit num] [-lv] path rnum\n",
+          g_progname);
   eprintf("\n");
   std::exit(1);
 }
@@ -115,6 +135,7 @@ static void dbmetaprint(kc::BasicDB* db, bool verbose) {
     status["opaque"] = "";
     status["fbpnum_used"] = "";
     status["bnum_used"] = "";
+    status["padding"] = "";
     if (db->status(&status)) {
       uint32_t type = kc::atoi(status["type"].c_str());
       oprintf("type: %s (%s) (type=0x%02X)\n",
@@ -149,6 +170,8 @@ static void dbmetaprint(kc::BasicDB* db, bool verbose) {
       if (opts & kc::HashDB::TSMALL) oprintf(" small");
       if (opts & kc::HashDB::TLINEAR) oprintf(" linear");
       if (opts & kc::HashDB::TCOMPRESS) oprintf(" compress");
+      if (opts & kc::HashDB::TBLOB) oprintf(" blob");
+      if (opts & kc::HashDB::TPAGE) oprintf(" page");
       oprintf(" (opts=%d)\n", opts);
       if (status["opaque"].size() >= 16) {
         const char* opaque = status["opaque"].c_str();
@@ -181,6 +204,21 @@ static void dbmetaprint(kc::BasicDB* db, bool verbose) {
       oprintf("size: %lld (%s) (map=%lld)", size, sizestr.c_str(), (long long)msiz);
       if (size != realsize) oprintf(" (gap=%lld)", (long long)(realsize - size));
       oprintf("\n");
+      if (status.count("bsize") > 0) {
+        int64_t bsize = kc::atoi(status["bsize"].c_str());
+        int64_t blive = kc::atoi(status["blive"].c_str());
+        std::string bsizestr = unitnumstrbyte(bsize);
+        oprintf("blob: %lld (%s) (live=%lld) (gen=%s) (thres=%s)\n", (long long)bsize,
+                bsizestr.c_str(), (long long)blive, status["bgen"].c_str(),
+                status["bthres"].c_str());
+      }
+      if (status.count("padding") > 0) {
+        int64_t pdsiz = kc::atoi(status["padding"].c_str());
+        std::string pdsizstr = unitnumstrbyte(pdsiz);
+        oprintf("padding: %lld (%s) (slack=%s) (grown=%s) (filled=%s)\n", (long long)pdsiz,
+                pdsizstr.c_str(), status["sratio"].c_str(), status["sgrow"].c_str(),
+                status["sfill"].c_str());
+      }
     }
   } else {
     oprintf("count: %lld\n", (long long)db->count());
@@ -207,6 +245,7 @@ static int32_t runorder(int argc, char** argv) {
   int64_t bnum = -1;
   int64_t msiz = -1;
   int64_t dfunit = -1;
+  double sratio = -1;
   bool lv = false;
   for (int32_t i = 2; i < argc; i++) {
     if (!argbrk && argv[i][0] == '-') {
@@ -251,6 +290,8 @@ static int32_t runorder(int argc, char** argv) {
         opts |= kc::HashDB::TLINEAR;
       } else if (!std::strcmp(argv[i], "-tc")) {
         opts |= kc::HashDB::TCOMPRESS;
+      } else if (!std::strcmp(argv[i], "-tp")) {
+        opts |= kc::HashDB::TPAGE;
       } else if (!std::strcmp(argv[i], "-bnum")) {
         if (++i >= argc) usage();
         bnum = kc::atoix(argv[i]);
@@ -260,6 +301,9 @@ static int32_t runorder(int argc, char** argv) {
       } else if (!std::strcmp(argv[i], "-dfunit")) {
         if (++i >= argc) usage();
         dfunit = kc::atoix(argv[i]);
+      } else if (!std::strcmp(argv[i], "-sratio")) {
+        if (++i >= argc) usage();
+        sratio = kc::atof(argv[i]);
       } else if (!std::strcmp(argv[i], "-lv")) {
         lv = true;
       } else {
@@ -279,7 +323,7 @@ static int32_t runorder(int argc, char** argv) {
   if (rnum < 1 || thnum < 1) usage();
   if (thnum > THREADMAX) thnum = THREADMAX;
   int32_t rv = procorder(path, rnum, thnum, rnd, mode, tran, oflags,
-                         apow, fpow, opts, bnum, msiz, dfunit, lv);
+                         apow, fpow, opts, bnum, msiz, dfunit, sratio, lv);
   return rv;
 }
 
@@ -334,6 +378,8 @@ static int32_t runqueue(int argc, char** argv) {
         opts |= kc::HashDB::TLINEAR;
       } else if (!std::strcmp(argv[i], "-tc")) {
         opts |= kc::HashDB::TCOMPRESS;
+      } else if (!std::strcmp(argv[i], "-tp")) {
+        opts |= kc::HashDB::TPAGE;
       } else if (!std::strcmp(argv[i], "-bnum")) {
         if (++i >= argc) usage();
         bnum = kc::atoix(argv[i]);
@@ -381,6 +427,8 @@ static int32_t runwicked(int argc, char** argv) {
   int64_t bnum = -1;
   int64_t msiz = -1;
   int64_t dfunit = -1;
+  int64_t bthres = -1;
+  double sratio = -1;
   bool lv = false;
   for (int32_t i = 2; i < argc; i++) {
     if (!argbrk && argv[i][0] == '-') {
@@ -414,6 +462,8 @@ static int32_t runwicked(int argc, char** argv) {
         opts |= kc::HashDB::TLINEAR;
       } else if (!std::strcmp(argv[i], "-tc")) {
         opts |= kc::HashDB::TCOMPRESS;
+      } else if (!std::strcmp(argv[i], "-tp")) {
+        opts |= kc::HashDB::TPAGE;
       } else if (!std::strcmp(argv[i], "-bnum")) {
         if (++i >= argc) usage();
         bnum = kc::atoix(argv[i]);
@@ -423,6 +473,12 @@ static int32_t runwicked(int argc, char** argv) {
       } else if (!std::strcmp(argv[i], "-dfunit")) {
         if (++i >= argc) usage();
         dfunit = kc::atoix(argv[i]);
+      } else if (!std::strcmp(argv[i], "-bthres")) {
+        if (++i >= argc) usage();
+        bthres = kc::atoix(argv[i]);
+      } else if (!std::strcmp(argv[i], "-sratio")) {
+        if (++i >= argc) usage();
+        sratio = kc::atof(argv[i]);
       } else if (!std::strcmp(argv[i], "-lv")) {
         lv = true;
       } else {
@@ -442,7 +498,7 @@ static int32_t runwicked(int argc, char** argv) {
   if (rnum < 1 || thnum < 1 || itnum < 1) usage();
   if (thnum > THREADMAX) thnum = THREADMAX;
   int32_t rv = procwicked(path, rnum, thnum, itnum, oflags,
-                          apow, fpow, opts, bnum, msiz, dfunit, lv);
+                          apow, fpow, opts, bnum, msiz, dfunit, bthres, sratio, lv);
   return rv;
 }
 
@@ -462,6 +518,7 @@ static int32_t runtran(int argc, char** argv) {
   int64_t bnum = -1;
   int64_t msiz = -1;
   int64_t dfunit = -1;
+  int64_t bthres = -1;
   bool lv = false;
   for (int32_t i = 2; i < argc; i++) {
     if (!argbrk && argv[i][0] == '-') {
@@ -497,6 +554,8 @@ static int32_t runtran(int argc, char** argv) {
         opts |= kc::HashDB::TLINEAR;
       } else if (!std::strcmp(argv[i], "-tc")) {
         opts |= kc::HashDB::TCOMPRESS;
+      } else if (!std::strcmp(argv[i], "-tp")) {
+        opts |= kc::HashDB::TPAGE;
       } else if (!std::strcmp(argv[i], "-bnum")) {
         if (++i >= argc) usage();
         bnum = kc::atoix(argv[i]);
@@ -506,6 +565,9 @@ static int32_t runtran(int argc, char** argv) {
       } else if (!std::strcmp(argv[i], "-dfunit")) {
         if (++i >= argc) usage();
         dfunit = kc::atoix(argv[i]);
+      } else if (!std::strcmp(argv[i], "-bthres")) {
+        if (++i >= argc) usage();
+        bthres = kc::atoix(argv[i]);
       } else if (!std::strcmp(argv[i], "-lv")) {
         lv = true;
       } else {
@@ -525,7 +587,161 @@ static int32_t runtran(int argc, char** argv) {
   if (rnum < 1 || thnum < 1 || itnum < 1) usage();
   if (thnum > THREADMAX) thnum = THREADMAX;
   int32_t rv = proctran(path, rnum, thnum, itnum, hard, oflags,
-                        apow, fpow, opts, bnum, msiz, dfunit, lv);
+                        apow, fpow, opts, bnum, msiz, dfunit, bthres, lv);
+  return rv;
+}
+
+
+// parse arguments of crash command
+static int32_t runcrash(int argc, char** argv) {
+  bool argbrk = false;
+  const char* path = NULL;
+  const char* rstr = NULL;
+  int32_t itnum = 1;
+  int64_t jnunit = 4096;
+  int32_t oflags = 0;
+  int32_t apow = -1;
+  int32_t fpow = -1;
+  int32_t opts = 0;
+  int64_t bnum = -1;
+  int64_t msiz = -1;
+  int64_t dfunit = -1;
+  bool lv = false;
+  for (int32_t i = 2; i < argc; i++) {
+    if (!argbrk && argv[i][0] == '-') {
+      if (!std::strcmp(argv[i], "--")) {
+        argbrk = true;
+      } else if (!std::strcmp(argv[i], "-it")) {
+        if (++i >= argc) usage();
+        itnum = kc::atoix(argv[i]);
+      } else if (!std::strcmp(argv[i], "-jnunit")) {
+        if (++i >= argc) usage();
+        jnunit = kc::atoix(argv[i]);
+      } else if (!std::strcmp(argv[i], "-oas")) {
+        oflags |= kc::HashDB::OAUTOSYNC;
+      } else if (!std::strcmp(argv[i], "-apow")) {
+        if (++i >= argc) usage();
+        apow = kc::atoix(argv[i]);
+      } else if (!std::strcmp(argv[i], "-fpow")) {
+        if (++i >= argc) usage();
+        fpow = kc::atoix(argv[i]);
+      } else if (!std::strcmp(argv[i], "-ts")) {
+        opts |= kc::HashDB::TSMALL;
+      } else if (!std::strcmp(argv[i], "-tl")) {
+        opts |= kc::HashDB::TLINEAR;
+      } else if (!std::strcmp(argv[i], "-tc")) {
+        opts |= kc::HashDB::TCOMPRESS;
+      } else if (!std::strcmp(argv[i], "-tp")) {
+        opts |= kc::HashDB::TPAGE;
+      } else if (!std::strcmp(argv[i], "-bnum")) {
+        if (++i >= argc) usage();
+        bnum = kc::atoix(argv[i]);
+      } else if (!std::strcmp(argv[i], "-msiz")) {
+        if (++i >= argc) usage();
+        msiz = kc::atoix(argv[i]);
+      } else if (!std::strcmp(argv[i], "-dfunit")) {
+        if (++i >= argc) usage();
+        dfunit = kc::atoix(argv[i]);
+      } else if (!std::strcmp(argv[i], "-lv")) {
+        lv = true;
+      } else {
+        usage();
+      }
+    } else if (!path) {
+      argbrk = true;
+      path = argv[i];
+    } else if (!rstr) {
+      rstr = argv[i];
+    } else {
+      usage();
+    }
+  }
+  if (!path || !rstr) usage();
+  int64_t rnum = kc::atoix(rstr);
+  if (rnum < 1 || itnum < 1 || jnunit < 1) usage();
+  int32_t rv = proccrash(path, rnum, itnum, jnunit, oflags,
+                         apow, fpow, opts, bnum, msiz, dfunit, lv);
+  return rv;
+}
+
+
+// parse arguments of rectran command
+static int32_t runrectran(int argc, char** argv) {
+  bool argbrk = false;
+  const char* path = NULL;
+  const char* rstr = NULL;
+  int32_t thnum = 1;
+  bool sync = false;
+  int32_t oflags = 0;
+  int32_t apow = -1;
+  int32_t fpow = -1;
+  int32_t opts = 0;
+  int64_t bnum = -1;
+  int64_t msiz = -1;
+  int64_t dfunit = -1;
+  bool lv = false;
+  for (int32_t i = 2; i < argc; i++) {
+    if (!argbrk && argv[i][0] == '-') {
+      if (!std::strcmp(argv[i], "--")) {
+        argbrk = true;
+      } else if (!std::strcmp(argv[i], "-th")) {
+        if (++i >= argc) usage();
+        thnum = kc::atoix(argv[i]);
+      } else if (!std::strcmp(argv[i], "-sync")) {
+        sync = true;
+      } else if (!std::strcmp(argv[i], "-oat")) {
+        oflags |= kc::HashDB::OAUTOTRAN;
+      } else if (!std::strcmp(argv[i], "-oas")) {
+        oflags |= kc::HashDB::OAUTOSYNC;
+      } else if (!std::strcmp(argv[i], "-onl")) {
+        oflags |= kc::HashDB::ONOLOCK;
+      } else if (!std::strcmp(argv[i], "-otl")) {
+        oflags |= kc::HashDB::OTRYLOCK;
+      } else if (!std::strcmp(argv[i], "-onr")) {
+        oflags |= kc::HashDB::ONOREPAIR;
+      } else if (!std::strcmp(argv[i], "-apow")) {
+        if (++i >= argc) usage();
+        apow = kc::atoix(argv[i]);
+      } else if (!std::strcmp(argv[i], "-fpow")) {
+        if (++i >= argc) usage();
+        fpow = kc::atoix(argv[i]);
+      } else if (!std::strcmp(argv[i], "-ts")) {
+        opts |= kc::HashDB::TSMALL;
+      } else if (!std::strcmp(argv[i], "-tl")) {
+        opts |= kc::HashDB::TLINEAR;
+      } else if (!std::strcmp(argv[i], "-tc")) {
+        opts |= kc::HashDB::TCOMPRESS;
+      } else if (!std::strcmp(argv[i], "-tp")) {
+        opts |= kc::HashDB::TPAGE;
+      } else if (!std::strcmp(argv[i], "-bnum")) {
+        if (++i >= argc) usage();
+        bnum = kc::atoix(argv[i]);
+      } else if (!std::strcmp(argv[i], "-msiz")) {
+        if (++i >= argc) usage();
+        msiz = kc::atoix(argv[i]);
+      } else if (!std::strcmp(argv[i], "-dfunit")) {
+        if (++i >= argc) usage();
+        dfunit = kc::atoix(argv[i]);
+      } else if (!std::strcmp(argv[i], "-lv")) {
+        lv = true;
+      } else {
+        usage();
+      }
+    } else if (!path) {
+      argbrk = true;
+      path = argv[i];
+    } else if (!rstr) {
+      rstr = argv[i];
+    } else {
+      usage();
+    }
+  }
+  if (!path || !rstr) usage();
+  int64_t rnum = kc::atoix(rstr);
+  if (rnum < 1 || thnum < 1) usage();
+  if (thnum > THREADMAX) thnum = THREADMAX;
+  int32_t rv = procrectran(path, rnum, thnum, sync, oflags,
+                           apow, fpow, opts, bnum, msiz, dfunit, lv);
   return rv;
 }
 
@@ -533,11 +749,13 @@ static int32_t runtran(int argc, char** argv) {
 // perform order command
 static int32_t procorder(const char* path, int64_t rnum, int32_t thnum, bool rnd, int32_t mode,
                          bool tran, int32_t oflags, int32_t apow, int32_t fpow,
-                         int32_t opts, int64_t bnum, int64_t msiz, int64_t dfunit, bool lv) {
+                         int32_t opts, int64_t bnum, int64_t msiz, int64_t dfunit,
+                         double sratio, bool lv) {
   oprintf("<In-order Test>\n  seed=%u  path=%s  rnum=%lld  thnum=%d  rnd=%d  mode=%d  tran=%d"
           "  oflags=%d  apow=%d  fpow=%d  opts=%d  bnum=%lld  msiz=%lld  dfunit=%lld"
-          "  lv=%d\n\n", g_randseed, path, (long long)rnum, thnum, rnd, mode, tran,
-          oflags, apow, fpow, opts, (long long)bnum, (long long)msiz, (long long)dfunit, lv);
+          "  sratio=%.3f  lv=%d\n\n", g_randseed, path, (long long)rnum, thnum, rnd, mode, tran,
+          oflags, apow, fpow, opts, (long long)bnum, (long long)msiz, (long long)dfunit,
+          sratio, lv);
   bool err = false;
   kc::HashDB db;
   oprintf("opening the database:\n");
@@ -550,6 +768,7 @@ static int32_t procorder(const char* path, int64_t rnum, int32_t thnum, bool rnd
   if (bnum > 0) db.tune_buckets(bnum);
   if (msiz >= 0) db.tune_map(msiz);
   if (dfunit > 0) db.tune_defrag(dfunit);
+  if (sratio > 0) db.tune_slack(sratio);
   uint32_t omode = kc::HashDB::OWRITER | kc::HashDB::OCREATE | kc::HashDB::OTRUNCATE;
   if (mode == 'r') {
     omode = kc::HashDB::OWRITER | kc::HashDB::OCREATE;
@@ -1150,6 +1369,119 @@ static int32_t procorder(const char* path, int64_t rnum, int32_t thnum, bool rnd
     dbmetaprint(&db, mode == 'w');
     oprintf("time: %.3f\n", etime - stime);
   }
+  if (mode == 'e') {
+    oprintf("accessing parts of records:\n");
+    stime = kc::time();
+    class ThreadRange : public kc::Thread {
+     public:
+      void setparams(int32_t id, kc::BasicDB* db, int64_t rnum, int32_t thnum,
+                     bool rnd, bool tran) {
+        id_ = id;
+        db_ = db;
+        rnum_ = rnum;
+        thnum_ = thnum;
+        err_ = false;
+        rnd_ = rnd;
+        tran_ = tran;
+      }
+      bool error() {
+        return err_;
+      }
+      void run() {
+        int64_t base = id_ * rnum_;
+        int64_t range = rnum_ * thnum_;
+        for (int64_t i = 1; !err_ && i <= rnum_; i++) {
+          if (tran_ && !db_->begin_transaction(false)) {
+            dberrprint(db_, __LINE__, "DB::begin_transaction");
+            err_ = true;
+          }
+          char kbuf[RECBUFSIZ];
+          size_t ksiz = std::sprintf(kbuf, "%08lld",
+                                     (long long)(rnd_ ? myrand(range) + 1 : base + i));
+          char vbuf[RECBUFSIZ];
+          int32_t vsiz = db_->get(kbuf, ksiz, vbuf, sizeof(vbuf));
+          if (vsiz >= 0) {
+            bool chk = !rnd_ && vsiz <= (int32_t)sizeof(vbuf) / 2;
+            if (vsiz > (int32_t)sizeof(vbuf)) vsiz = sizeof(vbuf);
+            int64_t off = myrand(vsiz + 1);
+            size_t max = myrand(ksiz) + 1;
+            char rbuf[RECBUFSIZ];
+            int64_t rsiz = db_->get_range(kbuf, ksiz, off, rbuf, max);
+            if (rsiz < 0) {
+              if (!rnd_ || db_->error() != kc::BasicDB::Error::NOREC) {
+                dberrprint(db_, __LINE__, "DB::get_range");
+                err_ = true;
+              }
+            } else if (chk && (rsiz != std::min(vsiz - off, (int64_t)max) ||
+                               std::memcmp(rbuf, vbuf + off, rsiz))) {
+              dberrprint(db_, __LINE__, "DB::get_range");
+              err_ = true;
+            }
+            off = myrand(vsiz + 2);
+            std::memset(rbuf, '*', max);
+            if (!db_->write_range(kbuf, ksiz, off, rbuf, max)) {
+              dberrprint(db_, __LINE__, "DB::write_range");
+              err_ = true;
+            }
+            if (chk) {
+              char nbuf[RECBUFSIZ];
+              std::memcpy(nbuf, vbuf, vsiz);
+              if (off > vsiz) std::memset(nbuf + vsiz, 0, off - vsiz);
+              std::memcpy(nbuf + off, rbuf, max);
+              int32_t nsiz = std::max((int64_t)vsiz, off + (int64_t)max);
+              char cbuf[RECBUFSIZ];
+              if (db_->get(kbuf, ksiz, cbuf, sizeof(cbuf)) != nsiz ||
+                  std::memcmp(cbuf, nbuf, nsiz)) {
+                dberrprint(db_, __LINE__, "DB::write_range");
+                err_ = true;
+              }
+            }
+            if (!db_->set(kbuf, ksiz, vbuf, vsiz)) {
+              dberrprint(db_, __LINE__, "DB::set");
+              err_ = true;
+            }
+          } else if (!rnd_ || db_->error() != kc::BasicDB::Error::NOREC) {
+            dberrprint(db_, __LINE__, "DB::get");
+            err_ = true;
+          }
+          if (tran_ && !db_->end_transaction(true)) {
+            dberrprint(db_, __LINE__, "DB::end_transaction");
+            err_ = true;
+          }
+          if (id_ < 1 && rnum_ > 250 && i % (rnum_ / 250) == 0) {
+            oputchar('.');
+            if (i == rnum_ || i % (rnum_ / 10) == 0) oprintf(" (%08lld)\n", (long long)i);
+          }
+        }
+      }
+     private:
+      int32_t id_;
+      kc::BasicDB* db_;
+      int64_t rnum_;
+      int32_t thnum_;
+      bool err_;
+      bool rnd_;
+      bool tran_;
+    };
+    ThreadRange threadranges[THREADMAX];
+    if (thnum < 2) {
+      threadranges[0].setparams(0, &db, rnum, thnum, rnd, tran);
+      threadranges[0].run();
+      if (threadranges[0].error()) err = true;
+    } else {
+      for (int32_t i = 0; i < thnum; i++) {
+        threadranges[i].setparams(i, &db, rnum, thnum, rnd, tran);
+        threadranges[i].start();
+      }
+      for (int32_t i = 0; i < thnum; i++) {
+        threadranges[i].join();
+        if (threadranges[i].error()) err = true;
+      }
+    }
+    etime = kc::time();
+    dbmetaprint(&db, false);
+    oprintf("time: %.3f\n", etime - stime);
+  }
   if (mode == 'e') {
     oprintf("traversing the database by the inner iterator:\n");
     stime = kc::time();
@@ -1309,6 +1641,52 @@ static int32_t procorder(const char* path, int64_t rnum, int32_t thnum, bool rnd
     dbmetaprint(&db, false);
     oprintf("time: %.3f\n", etime - stime);
   }
+  if (mode == 'e') {
+    oprintf("scanning the database by the batched cursor:\n");
+    stime = kc::time();
+    int64_t cnt = db.count();
+    int64_t batnum = 0;
+    int64_t scnt = 0;
+    kc::HashDB::Cursor cur(&db);
+    if (cur.jump()) {
+      std::vector<std::pair<std::string, std::string> > recs;
+      while (!err) {
+        recs.clear();
+        int64_t num = cur.get_batch(&recs, rnd ? myrand(200) + 1 : 100);
+        if (num < 0) {
+          dberrprint(&db, __LINE__, "Cursor::get_batch");
+          err = true;
+          break;
+        }
+        if (num != (int64_t)recs.size()) {
+          dberrprint(&db, __LINE__, "Cursor::get_batch");
+          err = true;
+          break;
+        }
+        if (num < 1) break;
+        const std::pair<std::string, std::string>& rec = recs[myrand(num)];
+        std::string value;
+        if (!db.get(rec.first, &value) || value != rec.second) {
+          dberrprint(&db, __LINE__, "DB::get");
+          err = true;
+        }
+        scnt += num;
+        batnum++;
+        if (rnum > 250 && batnum % (rnum / 2500 + 1) == 0) oputchar('.');
+      }
+    } else if (db.error() != kc::BasicDB::Error::NOREC) {
+      dberrprint(&db, __LINE__, "Cursor::jump");
+      err = true;
+    }
+    oprintf(" (end)\n");
+    if (scnt != cnt) {
+      dberrprint(&db, __LINE__, "Cursor::get_batch");
+      err = true;
+    }
+    etime = kc::time();
+    dbmetaprint(&db, false);
+    oprintf("time: %.3f\n", etime - stime);
+  }
   if (mode == 'e') {
     oprintf("synchronizing the database:\n");
     stime = kc::time();
@@ -1766,11 +2144,13 @@ static int32_t procqueue(const char* path, int64_t rnum, int32_t thnum, int32_t
 // perform wicked command
 static int32_t procwicked(const char* path, int64_t rnum, int32_t thnum, int32_t itnum,
                           int32_t oflags, int32_t apow, int32_t fpow, int32_t opts,
-                          int64_t bnum, int64_t msiz, int64_t dfunit, bool lv) {
+                          int64_t bnum, int64_t msiz, int64_t dfunit, int64_t bthres,
+                          double sratio, bool lv) {
   oprintf("<Wicked Test>\n  seed=%u  path=%s  rnum=%lld  thnum=%d  itnum=%d"
           "  oflags=%d  apow=%d  fpow=%d  opts=%d  bnum=%lld  msiz=%lld  dfunit=%lld"
-          "  lv=%d\n\n", g_randseed, path, (long long)rnum, thnum, itnum,
-          oflags, apow, fpow, opts, (long long)bnum, (long long)msiz, (long long)dfunit, lv);
+          "  bthres=%lld  sratio=%.3f  lv=%d\n\n", g_randseed, path, (long long)rnum, thnum,
+          itnum, oflags, apow, fpow, opts, (long long)bnum, (long long)msiz, (long long)dfunit,
+          (long long)bthres, sratio, lv);
   bool err = false;
   kc::HashDB db;
   db.tune_logger(stdlogger(g_progname, &std::cout),
@@ -1781,6 +2161,8 @@ static int32_t procwicked(const char* path, int64_t rnum, int32_t thnum, int32_t
   if (bnum > 0) db.tune_buckets(bnum);
   if (msiz >= 0) db.tune_map(msiz);
   if (dfunit > 0) db.tune_defrag(dfunit);
+  if (bthres > 0) db.tune_blob(bthres);
+  if (sratio > 0) db.tune_slack(sratio);
   for (int32_t itcnt = 1; itcnt <= itnum; itcnt++) {
     if (itnum > 1) oprintf("iteration %d:\n", itcnt);
     double stime = kc::time();
@@ -2020,6 +2402,10 @@ static int32_t procwicked(const char* path, int64_t rnum, int32_t thnum, int32_t
                   dberrprint(db_, __LINE__, "DB::defrag");
                   err_ = true;
                 }
+                if (!db_->defrag_blob() && db_->error() != kc::BasicDB::Error::LOGIC) {
+                  dberrprint(db_, __LINE__, "DB::defrag_blob");
+                  err_ = true;
+                }
               } else {
                 if (!db_->clear()) {
                   dberrprint(db_, __LINE__, "DB::clear");
@@ -2094,11 +2480,12 @@ static int32_t procwicked(const char* path, int64_t rnum, int32_t thnum, int32_t
 // perform tran command
 static int32_t proctran(const char* path, int64_t rnum, int32_t thnum, int32_t itnum, bool hard,
                         int32_t oflags, int32_t apow, int32_t fpow, int32_t opts,
-                        int64_t bnum, int64_t msiz, int64_t dfunit, bool lv) {
+                        int64_t bnum, int64_t msiz, int64_t dfunit, int64_t bthres, bool lv) {
   oprintf("<Transaction Test>\n  seed=%u  path=%s  rnum=%lld  thnum=%d  itnum=%d  hard=%d"
           "  oflags=%d  apow=%d  fpow=%d  opts=%d  bnum=%lld  msiz=%lld  dfunit=%lld"
-          "  lv=%d\n\n", g_randseed, path, (long long)rnum, thnum, itnum, hard,
-          oflags, apow, fpow, opts, (long long)bnum, (long long)msiz, (long long)dfunit, lv);
+          "  bthres=%lld  lv=%d\n\n", g_randseed, path, (long long)rnum, thnum, itnum, hard,
+          oflags, apow, fpow, opts, (long long)bnum, (long long)msiz, (long long)dfunit,
+          (long long)bthres, lv);
   bool err = false;
   kc::HashDB db;
   kc::HashDB paradb;
@@ -2112,6 +2499,7 @@ static int32_t proctran(const char* path, int64_t rnum, int32_t thnum, int32_t i
   if (bnum > 0) db.tune_buckets(bnum);
   if (msiz >= 0) db.tune_map(msiz);
   if (dfunit > 0) db.tune_defrag(dfunit);
+  if (bthres > 0) db.tune_blob(bthres);
   for (int32_t itcnt = 1; itcnt <= itnum; itcnt++) {
     oprintf("iteration %d updating:\n", itcnt);
     double stime = kc::time();
@@ -2388,5 +2776,570 @@ static int32_t proctran(const char* path, int64_t rnum, int32_t thnum, int32_t i
 }
 
 
+// perform crash command
+static int32_t proccrash(const char* path, int64_t rnum, int32_t itnum, int64_t jnunit,
+                         int32_t oflags, int32_t apow, int32_t fpow, int32_t opts,
+                         int64_t bnum, int64_t msiz, int64_t dfunit, bool lv) {
+  oprintf("<Crash Recovery Test>\n  seed=%u  path=%s  rnum=%lld  itnum=%d  jnunit=%lld"
+          "  oflags=%d  apow=%d  fpow=%d  opts=%d  bnum=%lld  msiz=%lld  dfunit=%lld"
+          "  lv=%d\n\n", g_randseed, path, (long long)rnum, itnum, (long long)jnunit,
+          oflags, apow, fpow, opts, (long long)bnum, (long long)msiz, (long long)dfunit, lv);
+  bool err = false;
+  kc::HashDB db;
+  db.tune_logger(stdlogger(g_progname, &std::cout),
+                 lv ? kc::UINT32MAX : kc::BasicDB::Logger::WARN | kc::BasicDB::Logger::ERROR);
+  if (apow >= 0) db.tune_alignment(apow);
+  if (fpow >= 0) db.tune_fbp(fpow);
+  if (opts > 0) db.tune_options(opts);
+  if (bnum > 0) db.tune_buckets(bnum);
+  if (msiz >= 0) db.tune_map(msiz);
+  if (dfunit > 0) db.tune_defrag(dfunit);
+  db.tune_journal(jnunit);
+  oprintf("opening the database:\n");
+  double stime = kc::time();
+  if (!db.open(path, kc::HashDB::OWRITER | kc::HashDB::OCREATE | kc::HashDB::OTRUNCATE |
+               oflags)) {
+    dberrprint(&db, __LINE__, "DB::open");
+    err = true;
+  }
+  oprintf("time: %.3f\n", kc::time() - stime);
+  char lbuf[RECBUFSIZL];
+  std::memset(lbuf, '*', sizeof(lbuf));
+  std::map<std::string, std::string> recs;
+  std::map<std::string, std::string> snap;
+  std::string simg;
+  if (!err && !readimage(db.path(), &simg)) err = true;
+  for (int32_t itcnt = 1; !err && itcnt <= itnum; itcnt++) {
+    oprintf("iteration %d updating:\n", itcnt);
+    stime = kc::time();
+    for (int64_t i = 1; !err && i <= rnum; i++) {
+      char kbuf[RECBUFSIZ];
+      size_t ksiz = std::sprintf(kbuf, "%lld", (long long)(myrand(rnum) + 1));
+      std::string key(kbuf, ksiz);
+      const char* vbuf = kbuf;
+      size_t vsiz = ksiz;
+      if (myrand(10) == 0) {
+        vbuf = lbuf;
+        vsiz = myrand(RECBUFSIZL) / (myrand(5) + 1);
+      }
+      switch (myrand(4)) {
+        default: {
+          if (!db.set(kbuf, ksiz, vbuf, vsiz)) {
+            dberrprint(&db, __LINE__, "DB::set");
+            err = true;
+          }
+          recs[key] = std::string(vbuf, vsiz);
+          break;
+        }
+        case 1: {
+          if (!db.append(kbuf, ksiz, vbuf, vsiz)) {
+            dberrprint(&db, __LINE__, "DB::append");
+            err = true;
+          }
+          recs[key].append(vbuf, vsiz);
+          break;
+        }
+        case 2: {
+          if (!db.remove(kbuf, ksiz) && db.error() != kc::BasicDB::Error::NOREC) {
+            dberrprint(&db, __LINE__, "DB::remove");
+            err = true;
+          }
+          recs.erase(key);
+          break;
+        }
+      }
+      if (rnum > 250 && i % (rnum / 250) == 0) {
+        oputchar('.');
+        if (i == rnum || i % (rnum / 10) == 0) oprintf(" (%08lld)\n", (long long)i);
+      }
+    }
+    if (itcnt < itnum) {
+      if (!db.synchronize(false)) {
+        dberrprint(&db, __LINE__, "DB::synchronize");
+        err = true;
+      }
+      snap = recs;
+      if (!readimage(db.path(), &simg)) err = true;
+    }
+    oprintf("time: %.3f\n", kc::time() - stime);
+  }
+  oprintf("copying the image of the crashed database:\n");
+  stime = kc::time();
+  std::string cpath = db.path() + "-crash";
+  std::string tpath = db.path() + "-torn";
+  std::string cimg, jimg;
+  if (!err && (!readimage(db.path(), &cimg) || !readimage(db.path() + ".jnl", &jimg)))
+    err = true;
+  bool durable = oflags & kc::HashDB::OAUTOSYNC;
+  if (durable) {
+    snap = recs;
+    simg = cimg;
+  }
+  if (!err) {
+    const int64_t pgsiz = 512;
+    int64_t isiz = myrand(2) == 0 ? cimg.size() : simg.size();
+    std::string img;
+    img.reserve(isiz);
+    for (int64_t off = 0; off < isiz; off += pgsiz) {
+      int64_t end = std::min(off + pgsiz, isiz);
+      const std::string& src =
+          off < (int64_t)cimg.size() && (off >= (int64_t)simg.size() || myrand(2) == 0) ?
+          cimg : simg;
+      for (int64_t i = off; i < end; i++) {
+        img.push_back(i < (int64_t)src.size() ? src[i] : 0);
+      }
+    }
+    std::string tjimg = jimg;
+    tjimg.push_back((char)0xbb);
+    tjimg.append(jimg, 0, std::min(jimg.size(), (size_t)(myrand(16) + 1)));
+    if (!kc::File::write_file(cpath, img.data(), img.size()) ||
+        !kc::File::write_file(cpath + ".jnl", jimg.data(), jimg.size()) ||
+        !kc::File::write_file(tpath, img.data(), img.size()) ||
+        !kc::File::write_file(tpath + ".jnl", tjimg.data(), tjimg.size())) {
+      eprintf("%s: %s: writing failed\n", g_progname, cpath.c_str());
+      err = true;
+    }
+    const char* exts[] = { ".idx", ".blob" };
+    for (size_t i = 0; !err && i < sizeof(exts) / sizeof(*exts); i++) {
+      std::string dpaths[] = { cpath + exts[i], tpath + exts[i] };
+      std::string eimg;
+      bool exist = kc::File::status(db.path() + exts[i]);
+      if (exist && !readimage(db.path() + exts[i], &eimg)) err = true;
+      for (size_t j = 0; !err && j < sizeof(dpaths) / sizeof(*dpaths); j++) {
+        if (exist ? !kc::File::write_file(dpaths[j], eimg.data(), eimg.size()) :
+            kc::File::status(dpaths[j]) && !kc::File::remove(dpaths[j])) {
+          eprintf("%s: %s: writing failed\n", g_progname, dpaths[j].c_str());
+          err = true;
+        }
+      }
+    }
+  }
+  if (!db.close()) {
+    dberrprint(&db, __LINE__, "DB::close");
+    err = true;
+  }
+  oprintf("time: %.3f\n", kc::time() - stime);
+  oprintf("recovering the database:\n");
+  stime = kc::time();
+  db.tune_journal(jnunit);
+  if (!db.open(cpath, kc::HashDB::OWRITER | oflags)) {
+    dberrprint(&db, __LINE__, "DB::open");
+    err = true;
+  }
+  std::map<std::string, std::string> status;
+  if (db.status(&status)) {
+    if (status["jnlrecovered"] != (durable ? "0" : "1") || status["reorganized"] != "0") {
+      dberrprint(&db, __LINE__, "DB::status");
+      err = true;
+    }
+  } else {
+    dberrprint(&db, __LINE__, "DB::status");
+    err = true;
+  }
+  oprintf("time: %.3f\n", kc::time() - stime);
+  oprintf("checking the restoration point:\n");
+  stime = kc::time();
+  if (db.count() != (int64_t)snap.size()) {
+    dberrprint(&db, __LINE__, "DB::count");
+    err = true;
+  }
+  int64_t cnt = 0;
+  std::map<std::string, std::string>::const_iterator it = snap.begin();
+  std::map<std::string, std::string>::const_iterator itend = snap.end();
+  while (!err && it != itend) {
+    std::string value;
+    if (!db.get(it->first, &value) || value != it->second) {
+      dberrprint(&db, __LINE__, "DB::get");
+      err = true;
+    }
+    cnt++;
+    ++it;
+  }
+  oprintf("checked: %lld\n", (long long)cnt);
+  dbmetaprint(&db, true);
+  if (!db.close()) {
+    dberrprint(&db, __LINE__, "DB::close");
+    err = true;
+  }
+  oprintf("time: %.3f\n", kc::time() - stime);
+  oprintf("recovering the database with a torn journal:\n");
+  stime = kc::time();
+  db.tune_journal(jnunit);
+  if (!db.open(tpath, kc::HashDB::OWRITER | oflags)) {
+    dberrprint(&db, __LINE__, "DB::open");
+    err = true;
+  }
+  status.clear();
+  if (db.status(&status)) {
+    if (status["jnlrecovered"] != "0" || status["reorganized"] != (durable ? "0" : "1")) {
+      dberrprint(&db, __LINE__, "DB::status");
+      err = true;
+    }
+  } else {
+    dberrprint(&db, __LINE__, "DB::status");
+    err = true;
+  }
+  class VisitorImpl : public kc::DB::Visitor {
+   public:
+    explicit VisitorImpl() : cnt_(0) {}
+    int64_t cnt() {
+      return cnt_;
+    }
+   private:
+    const char* visit_full(const char* kbuf, size_t ksiz,
+                           const char* vbuf, size_t vsiz, size_t* sp) {
+      cnt_++;
+      return NOP;
+    }
+    int64_t cnt_;
+  } visitor;
+  if (!db.iterate(&visitor, false)) {
+    dberrprint(&db, __LINE__, "DB::iterate");
+    err = true;
+  }
+  if (visitor.cnt() != db.count()) {
+    dberrprint(&db, __LINE__, "DB::count");
+    err = true;
+  }
+  oprintf("checked: %lld\n", (long long)visitor.cnt());
+  if (!db.close()) {
+    dberrprint(&db, __LINE__, "DB::close");
+    err = true;
+  }
+  oprintf("time: %.3f\n", kc::time() - stime);
+  oprintf("%s\n\n", err ? "error" : "ok");
+  return err ? 1 : 0;
+}
+
+
+// read the whole image of a file
+static bool readimage(const std::string& path, std::string* img) {
+  int64_t size;
+  char* buf = kc::File::read_file(path, &size);
+  if (!buf) {
+    eprintf("%s: %s: reading failed\n", g_progname, path.c_str());
+    return false;
+  }
+  img->assign(buf, size);
+  delete[] buf;
+  return true;
+}
+
+
+// perform rectran command
+static int32_t procrectran(const char* path, int64_t rnum, int32_t thnum, bool sync,
+                           int32_t oflags, int32_t apow, int32_t fpow, int32_t opts,
+                           int64_t bnum, int64_t msiz, int64_t dfunit, bool lv) {
+  oprintf("<Record-level Transaction Test>\n  seed=%u  path=%s  rnum=%lld  thnum=%d  sync=%d"
+          "  oflags=%d  apow=%d  fpow=%d  opts=%d  bnum=%lld  msiz=%lld  dfunit=%lld"
+          "  lv=%d\n\n", g_randseed, path, (long long)rnum, thnum, sync,
+          oflags, apow, fpow, opts, (long long)bnum, (long long)msiz, (long long)dfunit, lv);
+  bool err = false;
+  kc::HashDB db;
+  db.tune_logger(stdlogger(g_progname, &std::cout),
+                 lv ? kc::UINT32MAX : kc::BasicDB::Logger::WARN | kc::BasicDB::Logger::ERROR);
+  if (apow >= 0) db.tune_alignment(apow);
+  if (fpow >= 0) db.tune_fbp(fpow);
+  if (opts > 0) db.tune_options(opts);
+  if (bnum > 0) db.tune_buckets(bnum);
+  if (msiz >= 0) db.tune_map(msiz);
+  if (dfunit > 0) db.tune_defrag(dfunit);
+  oprintf("opening the database:\n");
+  double stime = kc::time();
+  if (!db.open(path, kc::HashDB::OWRITER | kc::HashDB::OCREATE | kc::HashDB::OTRUNCATE |
+               oflags)) {
+    dberrprint(&db, __LINE__, "DB::open");
+    err = true;
+  }
+  oprintf("time: %.3f\n", kc::time() - stime);
+  oprintf("setting the accounts:\n");
+  stime = kc::time();
+  const int64_t balance = 1000;
+  for (int64_t i = 1; !err && i <= rnum; i++) {
+    char kbuf[RECBUFSIZ];
+    size_t ksiz = std::sprintf(kbuf, "%08lld", (long long)i);
+    if (!db.set(std::string(kbuf, ksiz), kc::strprintf("%lld", (long long)balance))) {
+      dberrprint(&db, __LINE__, "DB::set");
+      err = true;
+    }
+  }
+  oprintf("time: %.3f\n", kc::time() - stime);
+  oprintf("transferring between the accounts:\n");
+  stime = kc::time();
+  class ThreadTransfer : public kc::Thread {
+   public:
+    void setparams(int32_t id, kc::HashDB* db, int64_t rnum, int32_t thnum, bool clear) {
+      id_ = id;
+      db_ = db;
+      rnum_ = rnum;
+      thnum_ = thnum;
+      clear_ = clear;
+      err_ = false;
+      cmtnum_ = 0;
+      abtnum_ = 0;
+      cflnum_ = 0;
+    }
+    bool error() {
+      return err_;
+    }
+    int64_t cmtnum() {
+      return cmtnum_;
+    }
+    int64_t abtnum() {
+      return abtnum_;
+    }
+    int64_t cflnum() {
+      return cflnum_;
+    }
+    void run() {
+      for (int64_t i = 1; !err_ && i <= rnum_; i++) {
+        kc::HashDB::Transaction tran(db_);
+        int32_t anum = myrand(3) + 2;
+        std::string keys[4];
+        int64_t values[4];
+        bool cfl = false;
+        for (int32_t j = 0; !err_ && !cfl && j < anum; j++) {
+          keys[j] = kc::strprintf("%08lld", (long long)(myrand(rnum_) + 1));
+          std::string value;
+          if (tran.get(keys[j], &value)) {
+            values[j] = kc::atoi(value.c_str());
+          } else if (db_->error() == kc::BasicDB::Error::LOGIC ||
+                     (clear_ && db_->error() == kc::BasicDB::Error::NOREC)) {
+            cfl = true;
+          } else {
+            dberrprint(db_, __LINE__, "Transaction::get");
+            err_ = true;
+          }
+        }
+        if (!err_ && !cfl) {
+          int64_t amount = myrand(100);
+          int32_t dest = myrand(anum - 1) + 1;
+          std::map<std::string, int64_t> sums;
+          for (int32_t j = 0; j < anum; j++) {
+            sums[keys[j]] = values[j];
+          }
+          sums[keys[0]] -= amount;
+          sums[keys[dest]] += amount;
+          std::map<std::string, int64_t>::iterator it = sums.begin();
+          std::map<std::string, int64_t>::iterator itend = sums.end();
+          while (!err_ && it != itend) {
+            if (!tran.set(it->first, kc::strprintf("%lld", (long long)it->second))) {
+              dberrprint(db_, __LINE__, "Transaction::set");
+              err_ = true;
+            }
+            ++it;
+          }
+        }
+        if (!err_ && !cfl && myrand(10) == 0) {
+          std::string key = kc::strprintf("x%d-%lld", id_, (long long)i);
+          if (!tran.set(key, key)) {
+            if (db_->error() == kc::BasicDB::Error::LOGIC) {
+              cfl = true;
+            } else {
+              dberrprint(db_, __LINE__, "Transaction::set");
+              err_ = true;
+            }
+          }
+          if (!err_ && !cfl && !tran.remove(keys[0]) &&
+              db_->error() != kc::BasicDB::Error::NOREC) {
+            dberrprint(db_, __LINE__, "Transaction::remove");
+            err_ = true;
+          }
+          if (!tran.abort()) {
+            dberrprint(db_, __LINE__, "Transaction::abort");
+            err_ = true;
+          }
+          abtnum_++;
+        } else if (cfl) {
+          if (!tran.abort()) {
+            dberrprint(db_, __LINE__, "Transaction::abort");
+            err_ = true;
+          }
+          cflnum_++;
+        } else {
+          if (!tran.commit()) {
+            dberrprint(db_, __LINE__, "Transaction::commit");
+            err_ = true;
+          }
+          cmtnum_++;
+        }
+        if (id_ < 1 && rnum_ > 250 && i % (rnum_ / 250) == 0) {
+          oputchar('.');
+          if (i == rnum_ || i % (rnum_ / 10) == 0) oprintf(" (%08lld)\n", (long long)i);
+        }
+      }
+    }
+   private:
+    int32_t id_;
+    kc::HashDB* db_;
+    int64_t rnum_;
+    int32_t thnum_;
+    bool clear_;
+    bool err_;
+    int64_t cmtnum_;
+    int64_t abtnum_;
+    int64_t cflnum_;
+  };
+  class ThreadSync : public kc::Thread {
+   public:
+    void setparams(kc::HashDB* db, bool clear) {
+      db_ = db;
+      clear_ = clear;
+      stop_.set(0);
+      err_ = false;
+      cnt_ = 0;
+    }
+    void stop() {
+      stop_.set(1);
+    }
+    bool error() {
+      return err_;
+    }
+    int64_t cnt() {
+      return cnt_;
+    }
+    void run() {
+      while (!err_ && stop_.get() == 0) {
+        if (clear_) {
+          if (!db_->clear()) {
+            dberrprint(db_, __LINE__, "DB::clear");
+            err_ = true;
+          }
+        } else if (!db_->synchronize(false)) {
+          dberrprint(db_, __LINE__, "DB::synchronize");
+          err_ = true;
+        }
+        cnt_++;
+        kc::Thread::sleep(0.001);
+      }
+    }
+   private:
+    kc::HashDB* db_;
+    bool clear_;
+    kc::AtomicInt64 stop_;
+    bool err_;
+    int64_t cnt_;
+  };
+  ThreadSync thsync;
+  if (sync) {
+    thsync.setparams(&db, false);
+    thsync.start();
+  }
+  ThreadTransfer threads[THREADMAX];
+  for (int32_t i = 0; i < thnum; i++) {
+    threads[i].setparams(i, &db, rnum, thnum, false);
+    threads[i].start();
+  }
+  int64_t cmtnum = 0;
+  int64_t abtnum = 0;
+  int64_t cflnum = 0;
+  for (int32_t i = 0; i < thnum; i++) {
+    threads[i].join();
+    if (threads[i].error()) err = true;
+    cmtnum += threads[i].cmtnum();
+    abtnum += threads[i].abtnum();
+    cflnum += threads[i].cflnum();
+  }
+  if (sync) {
+    thsync.stop();
+    thsync.join();
+    if (thsync.error()) err = true;
+    oprintf("synchronized: %lld\n", (long long)thsync.cnt());
+  }
+  oprintf("committed: %lld\n", (long long)cmtnum);
+  oprintf("aborted: %lld\n", (long long)abtnum);
+  oprintf("conflicted: %lld\n", (long long)cflnum);
+  if (dfunit > 0) {
+    std::map<std::string, std::string> status;
+    if (db.status(&status)) {
+      int64_t frgcnt = kc::atoi(status["frgcnt"].c_str());
+      oprintf("fragments: %lld\n", (long long)frgcnt);
+      if (frgcnt >= dfunit * thnum * 4) {
+        eprintf("%s: fragments not defragmented: %lld\n", g_progname, (long long)frgcnt);
+        err = true;
+      }
+    } else {
+      dberrprint(&db, __LINE__, "DB::status");
+      err = true;
+    }
+  }
+  oprintf("time: %.3f\n", kc::time() - stime);
+  oprintf("checking the accounts:\n");
+  stime = kc::time();
+  if (db.count() != rnum) {
+    dberrprint(&db, __LINE__, "DB::count");
+    err = true;
+  }
+  int64_t total = 0;
+  for (int64_t i = 1; !err && i <= rnum; i++) {
+    char kbuf[RECBUFSIZ];
+    size_t ksiz = std::sprintf(kbuf, "%08lld", (long long)i);
+    std::string value;
+    if (db.get(std::string(kbuf, ksiz), &value)) {
+      total += kc::atoi(value.c_str());
+    } else {
+      dberrprint(&db, __LINE__, "DB::get");
+      err = true;
+    }
+  }
+  if (total != rnum * balance) {
+    eprintf("%s: total mismatch: %lld\n", g_progname, (long long)total);
+    err = true;
+  }
+  oprintf("total: %lld\n", (long long)total);
+  oprintf("time: %.3f\n", kc::time() - stime);
+  if (sync) {
+    oprintf("transferring while clearing the database:\n");
+    stime = kc::time();
+    thsync.setparams(&db, true);
+    thsync.start();
+    for (int32_t i = 0; i < thnum; i++) {
+      threads[i].setparams(i, &db, rnum / 10 + 1, thnum, true);
+      threads[i].start();
+    }
+    for (int32_t i = 0; i < thnum; i++) {
+      threads[i].join();
+      if (threads[i].error()) err = true;
+    }
+    thsync.stop();
+    thsync.join();
+    if (thsync.error()) err = true;
+    oprintf("cleared: %lld\n", (long long)thsync.cnt());
+    class VisitorImpl : public kc::DB::Visitor {
+     public:
+      explicit VisitorImpl() : cnt_(0) {}
+      int64_t cnt() {
+        return cnt_;
+      }
+     private:
+      const char* visit_full(const char* kbuf, size_t ksiz,
+                             const char* vbuf, size_t vsiz, size_t* sp) {
+        cnt_++;
+        return NOP;
+      }
+      int64_t cnt_;
+    } visitor;
+    if (!db.iterate(&visitor, false)) {
+      dberrprint(&db, __LINE__, "DB::iterate");
+      err = true;
+    }
+    if (visitor.cnt() != db.count()) {
+      dberrprint(&db, __LINE__, "DB::count");
+      err = true;
+    }
+    oprintf("time: %.3f\n", kc::time() - stime);
+    stime = kc::time();
+  }
+  dbmetaprint(&db, true);
+  if (!db.close()) {
+    dberrprint(&db, __LINE__, "DB::close");
+    err = true;
+  }
+  oprintf("time: %.3f\n", kc::time() - stime);
+  oprintf("%s\n\n", err ? "error" : "ok");
+  return err ? 1 : 0;
+}
+
+
 
 // END OF FILE
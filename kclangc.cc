@@ -299,6 +299,29 @@ int32_t kcdbiterate(KCDB* db, KCVISITFULL fullproc, void* opq, int32_t writable)
 }
 
 
+/**
+ * Scan each record in parallel.
+ */
+int32_t kcdbscanpara(KCDB* db, KCVISITFULL fullproc, void* opq, size_t thnum) {
+  _assert_(db && thnum <= MEMMAXSIZ);
+  PolyDB* pdb = (PolyDB*)db;
+  class VisitorImpl : public DB::Visitor {
+   public:
+    explicit VisitorImpl(KCVISITFULL fullproc, void* opq) : fullproc_(fullproc), opq_(opq) {}
+    const char* visit_full(const char* kbuf, size_t ksiz,
+                           const char* vbuf, size_t vsiz, size_t* sp) {
+      if (!fullproc_) return NOP;
+      return fullproc_(kbuf, ksiz, vbuf, vsiz, sp, opq_);
+    }
+   private:
+    KCVISITFULL fullproc_;
+    void* opq_;
+  };
+  VisitorImpl visitor(fullproc, opq);
+  return pdb->scan_parallel(&visitor, thnum);
+}
+
+
 /**
  * Set the value of a record.
  */
@@ -400,6 +423,39 @@ int32_t kcdbgetbuf(KCDB* db, const char* kbuf, size_t ksiz, char* vbuf, size_t m
 }
 
 
+/**
+ * Retrieve the value of a record without copying it.
+ */
+int32_t kcdbgetproc(KCDB* db, const char* kbuf, size_t ksiz, KCVALUEPROC proc, void* opq) {
+  _assert_(db && kbuf && ksiz <= MEMMAXSIZ && proc);
+  PolyDB* pdb = (PolyDB*)db;
+  class VisitorImpl : public DB::Visitor {
+   public:
+    explicit VisitorImpl(KCVALUEPROC proc, void* opq) : proc_(proc), opq_(opq), hits_(0) {}
+    int64_t hits() {
+      return hits_;
+    }
+   private:
+    const char* visit_full(const char* kbuf, size_t ksiz,
+                           const char* vbuf, size_t vsiz, size_t* sp) {
+      proc_(kbuf, ksiz, vbuf, vsiz, opq_);
+      hits_++;
+      return NOP;
+    }
+    KCVALUEPROC proc_;
+    void* opq_;
+    int64_t hits_;
+  };
+  VisitorImpl visitor(proc, opq);
+  if (!pdb->accept(kbuf, ksiz, &visitor, false)) return false;
+  if (visitor.hits() < 1) {
+    pdb->set_error(_KCCODELINE_, PolyDB::Error::NOREC, "no record");
+    return false;
+  }
+  return true;
+}
+
+
 /**
  * Store records at once.
  */
@@ -469,6 +525,47 @@ int64_t kcdbgetbulk(KCDB* db, const KCSTR* keys, size_t knum, KCREC* recs, int32
 }
 
 
+/**
+ * Retrieve records at once without copying them.
+ */
+int64_t kcdbgetbulkproc(KCDB* db, const KCSTR* keys, size_t knum,
+                        KCVALUEPROC proc, void* opq, int32_t atomic) {
+  _assert_(db && keys && knum <= MEMMAXSIZ && proc);
+  PolyDB* pdb = (PolyDB*)db;
+  class VisitorImpl : public DB::Visitor {
+   public:
+    explicit VisitorImpl(KCVALUEPROC proc, void* opq) : proc_(proc), opq_(opq), hits_(0) {}
+    int64_t hits() {
+      return hits_;
+    }
+   private:
+    const char* visit_full(const char* kbuf, size_t ksiz,
+                           const char* vbuf, size_t vsiz, size_t* sp) {
+      proc_(kbuf, ksiz, vbuf, vsiz, opq_);
+      hits_++;
+      return NOP;
+    }
+    KCVALUEPROC proc_;
+    void* opq_;
+    int64_t hits_;
+  };
+  VisitorImpl visitor(proc, opq);
+  if (atomic) {
+    std::vector<std::string> xkeys;
+    xkeys.reserve(knum);
+    for (size_t i = 0; i < knum; i++) {
+      xkeys.push_back(std::string(keys[i].buf, keys[i].size));
+    }
+    if (!pdb->accept_bulk(xkeys, &visitor, false)) return -1;
+  } else {
+    for (size_t i = 0; i < knum; i++) {
+      if (!pdb->accept(keys[i].buf, keys[i].size, &visitor, false)) return -1;
+    }
+  }
+  return visitor.hits();
+}
+
+
 /**
  * Remove all records.
  */
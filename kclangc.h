@@ -162,6 +162,19 @@ typedef const char* (*KCVISITFULL)(const char* kbuf, size_t ksiz,
 typedef const char* (*KCVISITEMPTY)(const char* kbuf, size_t ksiz, size_t* sp, void* opq);
 
 
+/**
+ * Call back function to receive the value of a record.
+ * @param kbuf the pointer to the key region.
+ * @param ksiz the size of the key region.
+ * @param vbuf the pointer to the value region.
+ * @param vsiz the size of the value region.
+ * @param opq an opaque pointer.
+ * @note The regions are lent by the database and are valid only in the function.
+ */
+typedef void (*KCVALUEPROC)(const char* kbuf, size_t ksiz,
+                            const char* vbuf, size_t vsiz, void* opq);
+
+
 /**
  * Call back function to process the database file.
  * @param path the path of the database file.
@@ -421,6 +434,20 @@ int32_t kcdbacceptbulk(KCDB* db, const KCSTR* keys, size_t knum,
 int32_t kcdbiterate(KCDB* db, KCVISITFULL fullproc, void* opq, int32_t writable);
 
 
+/**
+ * Scan each record in parallel.
+ * @param db a database object.
+ * @param fullproc a call back function to visit a record.  Its return value is ignored.
+ * @param opq an opaque pointer to be given to the call back function.
+ * @param thnum the number of worker threads.
+ * @return true on success, or false on failure.
+ * @note This function is for reading records and not for updating ones.  The call back
+ * function is called by the worker threads concurrently, so it must be thread-safe.  Other
+ * threads are not blocked through the whole scanning.
+ */
+int32_t kcdbscanpara(KCDB* db, KCVISITFULL fullproc, void* opq, size_t thnum);
+
+
 /**
  * Set the value of a record.
  * @param db a database object.
@@ -554,6 +581,22 @@ char* kcdbget(KCDB* db, const char* kbuf, size_t ksiz, size_t* sp);
 int32_t kcdbgetbuf(KCDB* db, const char* kbuf, size_t ksiz, char* vbuf, size_t max);
 
 
+/**
+ * Retrieve the value of a record without copying it.
+ * @param db a database object.
+ * @param kbuf the pointer to the key region.
+ * @param ksiz the size of the key region.
+ * @param proc a call back function to receive the value.  It is called only if the record
+ * exists.
+ * @param opq an opaque pointer to be given to the call back function.
+ * @return true on success, or false on failure or if no record corresponds.
+ * @note The value region given to the call back function is lent by the database and valid
+ * only in the function.  To avoid deadlock, any explicit database operation must not be
+ * performed in the function.
+ */
+int32_t kcdbgetproc(KCDB* db, const char* kbuf, size_t ksiz, KCVALUEPROC proc, void* opq);
+
+
 /**
  * Store records at once.
  * @param db a database object.
@@ -590,6 +633,24 @@ int64_t kcdbremovebulk(KCDB* db, const KCSTR* keys, size_t knum, int32_t atomic)
 int64_t kcdbgetbulk(KCDB* db, const KCSTR* keys, size_t knum, KCREC* recs, int32_t atomic);
 
 
+/**
+ * Retrieve records at once without copying them.
+ * @param db a database object.
+ * @param keys the keys of the records to retrieve.
+ * @param knum specifies the number of the keys.
+ * @param proc a call back function to receive each value.  It is called only for existing
+ * records.
+ * @param opq an opaque pointer to be given to the call back function.
+ * @param atomic true to perform all operations atomically, or false for non-atomic operations.
+ * @return the number of retrieved records, or -1 on failure.
+ * @note The value regions given to the call back function are lent by the database and valid
+ * only in the function.  To avoid deadlock, any explicit database operation must not be
+ * performed in the function.
+ */
+int64_t kcdbgetbulkproc(KCDB* db, const KCSTR* keys, size_t knum,
+                        KCVALUEPROC proc, void* opq, int32_t atomic);
+
+
 /**
  * Remove all records.
  * @param db a database object.
@@ -17,6 +17,7 @@
 
 #define RECBUFSIZ    64                  /* buffer size for a record */
 #define RECBUFSIZL   1024                /* buffer size for a long record */
+#define BULKNUM      16                  /* number of records in a bulk operation */
 #if !defined(TRUE)
 #define TRUE         1                   /* boolean true */
 #endif
@@ -46,6 +47,9 @@ static void eprintf(const char* format, ...);
 static void dberrprint(KCDB* db, int32_t line, const char* func);
 const char* visitfull(const char* kbuf, size_t ksiz,
                       const char* vbuf, size_t vsiz, size_t* sp, void* opq);
+void checkvalue(const char* kbuf, size_t ksiz, const char* vbuf, size_t vsiz, void* opq);
+const char* scanfull(const char* kbuf, size_t ksiz,
+                     const char* vbuf, size_t vsiz, size_t* sp, void* opq);
 static int32_t runorder(int argc, char** argv);
 static int32_t runmap(int argc, char** argv);
 static int32_t procorder(const char* path, int64_t rnum, int32_t rnd, int32_t etc,
@@ -196,6 +200,29 @@ const char* visitfull(const char* kbuf, size_t ksiz,
 }
 
 
+/* check a value lent by the database */
+void checkvalue(const char* kbuf, size_t ksiz, const char* vbuf, size_t vsiz, void* opq) {
+  VISARG* arg;
+  arg = opq;
+  if (vsiz < ksiz || memcmp(vbuf, kbuf, ksiz)) {
+    arg->rnd = TRUE;
+  } else {
+    arg->cnt++;
+  }
+}
+
+
+/* visit a record in parallel scanning */
+const char* scanfull(const char* kbuf, size_t ksiz,
+                     const char* vbuf, size_t vsiz, size_t* sp, void* opq) {
+  VISARG* arg;
+  arg = opq;
+  if (ksiz < 1 || !vbuf) arg->rnd = TRUE;
+  if (arg->rnum == 1) arg->cnt++;
+  return KCVISNOP;
+}
+
+
 /* parse arguments of order command */
 static int32_t runorder(int argc, char** argv) {
   int32_t argbrk = FALSE;
@@ -450,6 +477,85 @@ static int32_t procorder(const char* path, int64_t rnum, int32_t rnd, int32_t et
     dbmetaprint(db, FALSE);
     oprintf("time: %.3f\n", etime - stime);
   }
+  if (etc) {
+    oprintf("getting records without copying:\n");
+    stime = kctime();
+    for (i = 1; !err && i <= rnum; i++) {
+      if (tran && !kcdbbegintran(db, FALSE)) {
+        dberrprint(db, __LINE__, "kcdbbegintran");
+        err = TRUE;
+      }
+      ksiz = sprintf(kbuf, "%08ld", (long)(rnd ? myrand(rnum) + 1 : i));
+      visarg.rnd = FALSE;
+      visarg.cnt = 0;
+      if (kcdbgetproc(db, kbuf, ksiz, checkvalue, &visarg)) {
+        if (visarg.rnd || visarg.cnt != 1) {
+          dberrprint(db, __LINE__, "kcdbgetproc");
+          err = TRUE;
+        }
+      } else if (!rnd || kcdbecode(db) != KCENOREC) {
+        dberrprint(db, __LINE__, "kcdbgetproc");
+        err = TRUE;
+      }
+      if (tran && !kcdbendtran(db, TRUE)) {
+        dberrprint(db, __LINE__, "kcdbendtran");
+        err = TRUE;
+      }
+      if (rnum > 250 && i % (rnum / 250) == 0) {
+        oputchar('.');
+        if (i == rnum || i % (rnum / 10) == 0) oprintf(" (%08ld)\n", (long)i);
+      }
+    }
+    etime = kctime();
+    dbmetaprint(db, FALSE);
+    oprintf("time: %.3f\n", etime - stime);
+  }
+  if (etc) {
+    oprintf("getting records at once without copying:\n");
+    stime = kctime();
+    for (i = 1; !err && i <= rnum; i += BULKNUM) {
+      KCSTR keys[BULKNUM];
+      char kbufs[BULKNUM][RECBUFSIZ];
+      int32_t knum, j;
+      int64_t hits;
+      knum = 0;
+      for (j = 0; j < BULKNUM && i + j <= rnum; j++) {
+        keys[knum].size = sprintf(kbufs[knum], "%08ld",
+                                  (long)(rnd ? myrand(rnum) + 1 : i + j));
+        keys[knum].buf = kbufs[knum];
+        knum++;
+      }
+      visarg.rnd = FALSE;
+      visarg.cnt = 0;
+      hits = kcdbgetbulkproc(db, keys, knum, checkvalue, &visarg, rnd ? myrand(2) : TRUE);
+      if (hits < 0 || visarg.rnd || visarg.cnt != hits || (!rnd && hits != knum)) {
+        dberrprint(db, __LINE__, "kcdbgetbulkproc");
+        err = TRUE;
+      }
+    }
+    etime = kctime();
+    dbmetaprint(db, FALSE);
+    oprintf("time: %.3f\n", etime - stime);
+  }
+  if (etc) {
+    oprintf("scanning the database in parallel:\n");
+    stime = kctime();
+    cnt = kcdbcount(db);
+    visarg.rnum = rnd ? myrand(4) + 1 : 1;
+    visarg.rnd = FALSE;
+    visarg.cnt = 0;
+    if (!kcdbscanpara(db, scanfull, &visarg, visarg.rnum)) {
+      dberrprint(db, __LINE__, "kcdbscanpara");
+      err = TRUE;
+    }
+    if (visarg.rnd || (visarg.rnum == 1 && visarg.cnt != cnt)) {
+      dberrprint(db, __LINE__, "kcdbscanpara");
+      err = TRUE;
+    }
+    etime = kctime();
+    dbmetaprint(db, FALSE);
+    oprintf("time: %.3f\n", etime - stime);
+  }
   if (etc) {
     oprintf("traversing the database by the inner iterator:\n");
     stime = kctime();
@@ -0,0 +1,2983 @@
+/*************************************************************************************************
+ * Log-structured tree database
+ *                                                               Copyright (C) 2009-2011 FAL Labs
+ * This file is part of Kyoto Cabinet.
+ * This program is free software: you can redistribute it and/or modify it under the terms of
+ * the GNU General Public License as published by the Free Software Foundation, either version
+ * 3 of the License, or any later version.
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ *************************************************************************************************/
+
+
+#ifndef _KCLOGDB_H                       // duplication check
+#define _KCLOGDB_H
+
+#include <kccommon.h>
+#include <kcutil.h>
+#include <kcthread.h>
+#include <kcfile.h>
+#include <kccompress.h>
+#include <kccompare.h>
+#include <kcmap.h>
+#include <kcregex.h>
+#include <kcdb.h>
+#include <kcplantdb.h>
+#include <kchashdb.h>
+
+#define KCLDBMAGICDATA  "KCLT\n"         ///< magic data of the meta data file
+#define KCLDBWALMAGICDATA  "KCLW\n"      ///< magic data of the WAL file
+#define KCLDBMETAFILE  "__meta__"        ///< meta data file of the directory
+#define KCLDBWALFILE  "__wal__"          ///< WAL file of the directory
+#define KCLDBTMPPATHEXT  "tmp"           ///< extension of the temporary file
+#define KCLDBRUNPATHEXT  "kct"           ///< extension of the run files
+#define KCLDBBLOOMPATHEXT  "kcb"         ///< extension of the Bloom filter files
+
+namespace kyotocabinet {                 // common namespace
+
+
+/**
+ * Log-structured tree database.
+ * @note This class is a concrete class to operate a write-optimized tree database in a
+ * directory.  Updates are logged into the WAL file and absorbed by an ordered table in memory.
+ * When the table exceeds its capacity, it is written as an immutable sorted run, which is a
+ * file tree database with a Bloom filter.  A background thread merges runs into larger ones.
+ * Merge operands are logged without reading the existing value and folded when the record is
+ * read or the table is written as a run.  This class can be inherited but overwriting methods
+ * is forbidden.  Before every database operation, it is necessary to call the LogTreeDB::open
+ * method in order to open a database directory and connect the database object to it.  To
+ * avoid data missing or corruption, it is important to close every database by the
+ * LogTreeDB::close method when the database is no longer in use.  It is forbidden for multible
+ * database objects in a process to open the same database at the same time.  It is forbidden
+ * to share a database object with child processes.
+ */
+class LogTreeDB : public BasicDB {
+ public:
+  class Cursor;
+ private:
+  struct MemtableComparator;
+  struct Run;
+  class RunScan;
+  class ScopedVisitor;
+  class Compactor;
+  /** An alias of the ordered table in memory. */
+  typedef std::map<std::string, std::string, MemtableComparator> Memtable;
+  /** An alias of vector of runs. */
+  typedef std::vector<Run*> RunVector;
+  /** An alias of list of cursors. */
+  typedef std::list<Cursor*> CursorList;
+  /** An alias of the table of records before transaction. */
+  typedef std::map<std::string, std::string> UndoMap;
+  /** The default capacity of the table in memory. */
+  static const int64_t DEFMTCAP = 64LL << 20;
+  /** The default number of runs to trigger compaction. */
+  static const int32_t DEFCMPNUM = 4;
+  /** The size of the header of the meta data file. */
+  static const int32_t METAHEADSIZ = 48;
+  /** The size of the header of the WAL file. */
+  static const int32_t WALHEADSIZ = 16;
+  /** The size of the stack buffer of a WAL record. */
+  static const size_t WALBUFSIZ = 1024;
+  /** The estimated overhead of a record in memory. */
+  static const int32_t MTUNITSIZ = 64;
+  /** The number of bits of the Bloom filter per record. */
+  static const int32_t BLOOMBITS = 10;
+  /** The number of hash functions of the Bloom filter. */
+  static const int32_t BLOOMHASHNUM = 7;
+  /** The tag of a live record. */
+  static const char RECLIVE = 0x01;
+  /** The tag of a removed record. */
+  static const char RECTOMB = 0x00;
+  /** The tag of a record of merge operands whose base value is in the runs. */
+  static const char RECMERGE = 0x02;
+  /** The operation code to add a new record. */
+  static const uint8_t WALADD = 0xa1;
+  /** The operation code to replace an existing record. */
+  static const uint8_t WALREPLACE = 0xa2;
+  /** The operation code to remove an existing record. */
+  static const uint8_t WALREMOVE = 0xa3;
+  /** The operation code to merge an operand into a record. */
+  static const uint8_t WALMERGE = 0xa4;
+  /** The operation code to begin transaction. */
+  static const uint8_t WALBEGIN = 0xb1;
+  /** The operation code to commit transaction. */
+  static const uint8_t WALCOMMIT = 0xb2;
+  /** The kind of operands of the registered merge operator. */
+  static const uint8_t MRGCUSTOM = 0x00;
+  /** The kind of operands of the merge operator to add numbers. */
+  static const uint8_t MRGADD = 0x01;
+  /** The kind of operands of the merge operator to concatenate values. */
+  static const uint8_t MRGCONCAT = 0x02;
+  /** The size of pending merge operands to trigger folding them with the base value. */
+  static const size_t MRGFOLDSIZ = 1024;
+  /** The frequency of checking cancellation of compaction. */
+  static const int64_t CMPCHECKFREQ = 1024;
+  /** The threshold of busy loop and sleep for locking. */
+  static const uint32_t LOCKBUSYLOOP = 8192;
+  /**
+   * Cursors of the runs positioned for an incremental scan.
+   */
+  class RunScan {
+   public:
+    /** constructor */
+    explicit RunScan() :
+        curs(), keys(), values(), hits(), pivot(), pos(false), has(false), incl(false),
+        fwd(true) {}
+    /** destructor */
+    ~RunScan() {
+      for (size_t i = 0; i < curs.size(); i++) {
+        delete curs[i];
+      }
+    }
+    std::vector<TreeDB::Cursor*> curs;   ///< cursors of the runs from the oldest
+    std::vector<std::string> keys;       ///< keys of the records under the cursors
+    std::vector<std::string> values;     ///< tagged values of the records under the cursors
+    std::vector<bool> hits;              ///< flags whether the cursors are on records
+    std::string pivot;                   ///< key of the position
+    bool pos;                            ///< flag whether the cursors are positioned
+    bool has;                            ///< flag whether the position has the pivot
+    bool incl;                           ///< flag whether the pivot itself is included
+    bool fwd;                            ///< flag whether the direction is forward
+  };
+ public:
+  /**
+   * Cursor to indicate a record.
+   * @note The cursor holds the key of the current record and a cursor of each run positioned
+   * next to it, so that stepping moves only the runs behind the current record.  The table in
+   * memory is looked up at each operation.  The cursors of the runs are repositioned after the
+   * set of runs is changed by flushing or compaction.
+   */
+  class Cursor : public BasicDB::Cursor {
+    friend class LogTreeDB;
+   public:
+    /**
+     * Constructor.
+     * @param db the container database object.
+     */
+    explicit Cursor(LogTreeDB* db) : db_(db), key_(""), alive_(false), scan_() {
+      _assert_(db);
+      ScopedRWLock lock(&db_->mlock_, true);
+      db_->curs_.push_back(this);
+    }
+    /**
+     * Destructor.
+     */
+    virtual ~Cursor() {
+      _assert_(true);
+      if (!db_) return;
+      ScopedRWLock lock(&db_->mlock_, true);
+      db_->clear_scan(&scan_);
+      db_->curs_.remove(this);
+    }
+    /**
+     * Accept a visitor to the current record.
+     * @param visitor a visitor object.
+     * @param writable true for writable operation, or false for read-only operation.
+     * @param step true to move the cursor to the next record, or false for no move.
+     * @return true on success, or false on failure.
+     * @note The operation for each record is performed atomically and other threads accessing
+     * the same record are blocked.  To avoid deadlock, any explicit database operation must not
+     * be performed in this function.
+     */
+    bool accept(Visitor* visitor, bool writable = true, bool step = false) {
+      _assert_(visitor);
+      ScopedRWLock lock(&db_->mlock_, writable);
+      if (db_->omode_ == 0) {
+        db_->set_error(_KCCODELINE_, Error::INVALID, "not opened");
+        return false;
+      }
+      if (writable && !db_->writer_) {
+        db_->set_error(_KCCODELINE_, Error::NOPERM, "permission denied");
+        return false;
+      }
+      if (!alive_) {
+        db_->set_error(_KCCODELINE_, Error::NOREC, "no record");
+        return false;
+      }
+      std::string key, value;
+      bool hit;
+      if (!db_->seek_record(&scan_, &key_, true, true, &key, &value, &hit)) return false;
+      if (!hit) {
+        alive_ = false;
+        db_->set_error(_KCCODELINE_, Error::NOREC, "no record");
+        return false;
+      }
+      key_ = key;
+      bool err = false;
+      if (!db_->visit_record(key_.data(), key_.size(), &value, visitor, writable)) err = true;
+      if (!err && step) {
+        if (!db_->seek_record(&scan_, &key, false, true, &key_, NULL, &hit)) {
+          err = true;
+        } else if (!hit) {
+          alive_ = false;
+        }
+      }
+      if (writable && !db_->flush_auto()) err = true;
+      return !err;
+    }
+    /**
+     * Jump the cursor to the first record for forward scan.
+     * @return true on success, or false on failure.
+     */
+    bool jump() {
+      _assert_(true);
+      ScopedRWLock lock(&db_->mlock_, false);
+      if (db_->omode_ == 0) {
+        db_->set_error(_KCCODELINE_, Error::INVALID, "not opened");
+        return false;
+      }
+      return set_position(NULL, true, true);
+    }
+    /**
+     * Jump the cursor to a record for forward scan.
+     * @param kbuf the pointer to the key region.
+     * @param ksiz the size of the key region.
+     * @return true on success, or false on failure.
+     */
+    bool jump(const char* kbuf, size_t ksiz) {
+      _assert_(kbuf && ksiz <= MEMMAXSIZ);
+      ScopedRWLock lock(&db_->mlock_, false);
+      if (db_->omode_ == 0) {
+        db_->set_error(_KCCODELINE_, Error::INVALID, "not opened");
+        return false;
+      }
+      std::string key(kbuf, ksiz);
+      return set_position(&key, true, true);
+    }
+    /**
+     * Jump the cursor to a record for forward scan.
+     * @note Equal to the original Cursor::jump method except that the parameter is std::string.
+     */
+    bool jump(const std::string& key) {
+      _assert_(true);
+      return jump(key.c_str(), key.size());
+    }
+    /**
+     * Jump the cursor to the last record for backward scan.
+     * @return true on success, or false on failure.
+     */
+    bool jump_back() {
+      _assert_(true);
+      ScopedRWLock lock(&db_->mlock_, false);
+      if (db_->omode_ == 0) {
+        db_->set_error(_KCCODELINE_, Error::INVALID, "not opened");
+        return false;
+      }
+      return set_position(NULL, true, false);
+    }
+    /**
+     * Jump the cursor to a record for backward scan.
+     * @param kbuf the pointer to the key region.
+     * @param ksiz the size of the key region.
+     * @return true on success, or false on failure.
+     */
+    bool jump_back(const char* kbuf, size_t ksiz) {
+      _assert_(kbuf && ksiz <= MEMMAXSIZ);
+      ScopedRWLock lock(&db_->mlock_, false);
+      if (db_->omode_ == 0) {
+        db_->set_error(_KCCODELINE_, Error::INVALID, "not opened");
+        return false;
+      }
+      std::string key(kbuf, ksiz);
+      return set_position(&key, true, false);
+    }
+    /**
+     * Jump the cursor to a record for backward scan.
+     * @note Equal to the original Cursor::jump_back method except that the parameter is
+     * std::string.
+     */
+    bool jump_back(const std::string& key) {
+      _assert_(true);
+      return jump_back(key.c_str(), key.size());
+    }
+    /**
+     * Step the cursor to the next record.
+     * @return true on success, or false on failure.
+     */
+    bool step() {
+      _assert_(true);
+      ScopedRWLock lock(&db_->mlock_, false);
+      if (db_->omode_ == 0) {
+        db_->set_error(_KCCODELINE_, Error::INVALID, "not opened");
+        return false;
+      }
+      if (!alive_) {
+        db_->set_error(_KCCODELINE_, Error::NOREC, "no record");
+        return false;
+      }
+      std::string key = key_;
+      return set_position(&key, false, true);
+    }
+    /**
+     * Step the cursor to the previous record.
+     * @return true on success, or false on failure.
+     */
+    bool step_back() {
+      _assert_(true);
+      ScopedRWLock lock(&db_->mlock_, false);
+      if (db_->omode_ == 0) {
+        db_->set_error(_KCCODELINE_, Error::INVALID, "not opened");
+        return false;
+      }
+      if (!alive_) {
+        db_->set_error(_KCCODELINE_, Error::NOREC, "no record");
+        return false;
+      }
+      std::string key = key_;
+      return set_position(&key, false, false);
+    }
+    /**
+     * Get the database object.
+     * @return the database object.
+     */
+    LogTreeDB* db() {
+      _assert_(true);
+      return db_;
+    }
+   private:
+    /**
+     * Set the position to the nearest live record.
+     * @param key the key of the pivot, or NULL to specify the first or the last record.
+     * @param incl true to include the pivot itself, or false to exclude it.
+     * @param fwd true for forward direction, or false for backward direction.
+     * @return true on success, or false on failure.
+     */
+    bool set_position(const std::string* key, bool incl, bool fwd) {
+      _assert_(true);
+      alive_ = false;
+      bool hit;
+      if (!db_->seek_record(&scan_, key, incl, fwd, &key_, NULL, &hit)) return false;
+      if (!hit) {
+        db_->set_error(_KCCODELINE_, Error::NOREC, "no record");
+        return false;
+      }
+      alive_ = true;
+      return true;
+    }
+    /** Dummy constructor to forbid the use. */
+    Cursor(const Cursor&);
+    /** Dummy Operator to forbid the use. */
+    Cursor& operator =(const Cursor&);
+    /** The inner database. */
+    LogTreeDB* db_;
+    /** The key of the current record. */
+    std::string key_;
+    /** The flag of availability. */
+    bool alive_;
+    /** The cursors of the runs. */
+    RunScan scan_;
+  };
+  /**
+   * Tuning options.
+   */
+  enum Option {
+    TSMALL = TreeDB::TSMALL,             ///< use 32-bit addressing
+    TLINEAR = TreeDB::TLINEAR,           ///< use linear collision chaining
+    TCOMPRESS = TreeDB::TCOMPRESS        ///< compress each record
+  };
+  /**
+   * Default constructor.
+   */
+  explicit LogTreeDB() :
+      mlock_(), cmplock_(), cmpmutex_(), cmpcond_(), error_(),
+      logger_(NULL), logkinds_(0), mtrigger_(NULL),
+      omode_(0), writer_(false), autosync_(false), recov_(false),
+      wal_(), path_(""), comp_(NULL), opts_(0), psiz_(0), pccap_(0), embcomp_(NULL),
+      mtcap_(DEFMTCAP), cmpnum_(DEFCMPNUM),
+      mem_(MemtableComparator(LEXICALCOMP)), memsiz_(0), runs_(), curs_(),
+      count_(0), runcount_(0), walid_(0), nextid_(0),
+      mop_(NULL), mrgnum_(0),
+      tran_(false), trhard_(false), trundo_(), trcount_(0), trmemsiz_(0), trmrgnum_(0),
+      trwalsiz_(0),
+      compactor_(NULL), cmpreq_(false), cmpstop_(false),
+      flushcnt_(0), cmpcnt_(0), bloomskip_(0), mrgcnt_(0), mrgfold_(0) {
+    _assert_(true);
+  }
+  /**
+   * Destructor.
+   * @note If the database is not closed, it is closed implicitly.
+   */
+  virtual ~LogTreeDB() {
+    _assert_(true);
+    if (omode_ != 0) close();
+    if (!curs_.empty()) {
+      CursorList::const_iterator cit = curs_.begin();
+      CursorList::const_iterator citend = curs_.end();
+      while (cit != citend) {
+        Cursor* cur = *cit;
+        cur->db_ = NULL;
+        ++cit;
+      }
+    }
+  }
+  /**
+   * Accept a visitor to a record.
+   * @param kbuf the pointer to the key region.
+   * @param ksiz the size of the key region.
+   * @param visitor a visitor object.
+   * @param writable true for writable operation, or false for read-only operation.
+   * @return true on success, or false on failure.
+   * @note The operation for each record is performed atomically and other threads accessing the
+   * same record are blocked.  To avoid deadlock, any explicit database operation must not be
+   * performed in this function.
+   */
+  bool accept(const char* kbuf, size_t ksiz, Visitor* visitor, bool writable = true) {
+    _assert_(kbuf && ksiz <= MEMMAXSIZ && visitor);
+    ScopedRWLock lock(&mlock_, writable);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
+    }
+    if (writable && !writer_) {
+      set_error(_KCCODELINE_, Error::NOPERM, "permission denied");
+      return false;
+    }
+    bool err = false;
+    if (!accept_impl(kbuf, ksiz, visitor, writable)) err = true;
+    if (writable && !flush_auto()) err = true;
+    return !err;
+  }
+  /**
+   * Accept a visitor to multiple records at once.
+   * @param keys specifies a string vector of the keys.
+   * @param visitor a visitor object.
+   * @param writable true for writable operation, or false for read-only operation.
+   * @return true on success, or false on failure.
+   * @note The operations for specified records are performed atomically and other threads
+   * accessing the same records are blocked.  To avoid deadlock, any explicit database operation
+   * must not be performed in this function.
+   */
+  bool accept_bulk(const std::vector<std::string>& keys, Visitor* visitor,
+                   bool writable = true) {
+    _assert_(visitor);
+    ScopedRWLock lock(&mlock_, writable);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
+    }
+    if (writable && !writer_) {
+      set_error(_KCCODELINE_, Error::NOPERM, "permission denied");
+      return false;
+    }
+    ScopedVisitor svis(visitor);
+    bool err = false;
+    std::vector<std::string>::const_iterator kit = keys.begin();
+    std::vector<std::string>::const_iterator kitend = keys.end();
+    while (kit != kitend) {
+      if (!accept_impl(kit->data(), kit->size(), visitor, writable)) {
+        err = true;
+        break;
+      }
+      ++kit;
+    }
+    if (writable && !flush_auto()) err = true;
+    return !err;
+  }
+  /**
+   * Merge an operand into the value of a record.
+   * @param kbuf the pointer to the key region.
+   * @param ksiz the size of the key region.
+   * @param obuf the pointer to the operand region.
+   * @param osiz the size of the operand region.
+   * @param mop the merge operator.
+   * @return true on success, or false on failure.
+   * @note Equal to the original BasicDB::merge_operand method except that the operand is
+   * logged without reading the existing value if the operator is ADDITIONMERGE, CONCATMERGE, or
+   * the one set by the tune_merge_operator method.  Operands are folded with the existing value
+   * when the record is read, when their total size exceeds a limit, and when the table in
+   * memory is written as a run.  While operands of records which are not in memory are queued,
+   * the count method looks up the runs for each of them.
+   */
+  bool merge_operand(const char* kbuf, size_t ksiz, const char* obuf, size_t osiz,
+                     MergeOperator* mop) {
+    _assert_(kbuf && ksiz <= MEMMAXSIZ && obuf && osiz <= MEMMAXSIZ && mop);
+    mlock_.lock_writer();
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      mlock_.unlock();
+      return false;
+    }
+    if (!writer_) {
+      set_error(_KCCODELINE_, Error::NOPERM, "permission denied");
+      mlock_.unlock();
+      return false;
+    }
+    uint8_t kind;
+    if (mop == ADDITIONMERGE) {
+      kind = MRGADD;
+    } else if (mop == CONCATMERGE) {
+      kind = MRGCONCAT;
+    } else if (mop == mop_) {
+      kind = MRGCUSTOM;
+    } else {
+      mlock_.unlock();
+      return BasicDB::merge_operand(kbuf, ksiz, obuf, osiz, mop);
+    }
+    size_t rsiz = 1 + osiz;
+    char stack[WALBUFSIZ];
+    char* rbuf = rsiz > sizeof(stack) ? new char[rsiz] : stack;
+    *rbuf = kind;
+    std::memcpy(rbuf + 1, obuf, osiz);
+    bool err = false;
+    if (!write_record(kbuf, ksiz, rbuf, rsiz, WALMERGE)) err = true;
+    if (rbuf != stack) delete[] rbuf;
+    if (!err) mrgcnt_ += 1;
+    if (!flush_auto()) err = true;
+    mlock_.unlock();
+    return !err;
+  }
+  /**
+   * Merge an operand into the value of a record.
+   * @note Equal to the original DB::merge_operand method except that the parameters are
+   * std::string.
+   */
+  bool merge_operand(const std::string& key, const std::string& operand, MergeOperator* mop) {
+    _assert_(mop);
+    return merge_operand(key.c_str(), key.size(), operand.c_str(), operand.size(), mop);
+  }
+  /**
+   * Append the value of a record.
+   * @param kbuf the pointer to the key region.
+   * @param ksiz the size of the key region.
+   * @param vbuf the pointer to the value region.
+   * @param vsiz the size of the value region.
+   * @return true on success, or false on failure.
+   * @note Equal to the original BasicDB::append method except that the value is logged as an
+   * operand of CONCATMERGE without reading the existing value.
+   */
+  bool append(const char* kbuf, size_t ksiz, const char* vbuf, size_t vsiz) {
+    _assert_(kbuf && ksiz <= MEMMAXSIZ && vbuf && vsiz <= MEMMAXSIZ);
+    return merge_operand(kbuf, ksiz, vbuf, vsiz, CONCATMERGE);
+  }
+  /**
+   * Append the value of a record.
+   * @note Equal to the original DB::append method except that the parameters are std::string.
+   */
+  bool append(const std::string& key, const std::string& value) {
+    _assert_(true);
+    return append(key.c_str(), key.size(), value.c_str(), value.size());
+  }
+  /**
+   * Iterate to accept a visitor for each record.
+   * @param visitor a visitor object.
+   * @param writable true for writable operation, or false for read-only operation.
+   * @param checker a progress checker object.  If it is NULL, no checking is performed.
+   * @return true on success, or false on failure.
+   * @note The whole iteration is performed atomically and other threads are blocked.  To avoid
+   * deadlock, any explicit database operation must not be performed in this function.
+   */
+  bool iterate(Visitor *visitor, bool writable = true, ProgressChecker* checker = NULL) {
+    _assert_(visitor);
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
+    }
+    if (writable && !writer_) {
+      set_error(_KCCODELINE_, Error::NOPERM, "permission denied");
+      return false;
+    }
+    ScopedVisitor svis(visitor);
+    bool err = false;
+    if (!iterate_impl(visitor, writable, checker)) err = true;
+    if (writable && !flush_auto()) err = true;
+    trigger_meta(MetaTrigger::ITERATE, "iterate");
+    return !err;
+  }
+  /**
+   * Get the last happened error.
+   * @return the last happened error.
+   */
+  Error error() const {
+    _assert_(true);
+    return error_;
+  }
+  /**
+   * Set the error information.
+   * @param file the file name of the program source code.
+   * @param line the line number of the program source code.
+   * @param func the function name of the program source code.
+   * @param code an error code.
+   * @param message a supplement message.
+   */
+  void set_error(const char* file, int32_t line, const char* func,
+                 Error::Code code, const char* message) {
+    _assert_(file && line > 0 && func && message);
+    error_->set(code, message);
+    if (logger_) {
+      Logger::Kind kind = code == Error::BROKEN || code == Error::SYSTEM ?
+          Logger::ERROR : Logger::INFO;
+      if (kind & logkinds_)
+        report(file, line, func, kind, "%d: %s: %s", code, Error::codename(code), message);
+    }
+  }
+  /**
+   * Open a database directory.
+   * @param path the path of a database directory.
+   * @param mode the connection mode.  LogTreeDB::OWRITER as a writer, LogTreeDB::OREADER as a
+   * reader.  The following may be added to the writer mode by bitwise-or: LogTreeDB::OCREATE,
+   * which means it creates a new database if the directory does not exist,
+   * LogTreeDB::OTRUNCATE, which means it creates a new database regardless if the directory
+   * exists, LogTreeDB::OAUTOTRAN, which means each updating operation is performed in implicit
+   * transaction, LogTreeDB::OAUTOSYNC, which means each updating operation is followed by
+   * implicit synchronization with the file system.  The following may be added to both of the
+   * reader mode and the writer mode by bitwise-or: LogTreeDB::ONOLOCK, which means it opens
+   * the database directory without file locking, LogTreeDB::OTRYLOCK, which means locking is
+   * performed without blocking, LogTreeDB::ONOREPAIR, which means the database directory is
+   * not repaired implicitly even if file destruction is detected.
+   * @return true on success, or false on failure.
+   * @note Every opened database must be closed by the LogTreeDB::close method when it is no
+   * longer in use.  It is not allowed for two or more database objects in the same process to
+   * keep their connections to the same database directory at the same time.  Because every
+   * record in the WAL file is atomic, the auto transaction mode is always achieved implicitly.
+   */
+  bool open(const std::string& path, uint32_t mode = OWRITER | OCREATE) {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ != 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "already opened");
+      return false;
+    }
+    report(_KCCODELINE_, Logger::DEBUG, "opening the database (path=%s)", path.c_str());
+    writer_ = false;
+    autosync_ = false;
+    recov_ = false;
+    uint32_t fmode = File::OREADER;
+    if (mode & OWRITER) {
+      writer_ = true;
+      fmode = File::OWRITER | File::OCREATE;
+      if (mode & OAUTOSYNC) autosync_ = true;
+    }
+    if (mode & ONOLOCK) fmode |= File::ONOLOCK;
+    if (mode & OTRYLOCK) fmode |= File::OTRYLOCK;
+    size_t psiz = path.size();
+    while (psiz > 0 && path[psiz-1] == File::PATHCHR) {
+      psiz--;
+    }
+    const std::string& cpath = path.substr(0, psiz);
+    const std::string& metapath = cpath + File::PATHCHR + KCLDBMETAFILE;
+    const std::string& walpath = cpath + File::PATHCHR + KCLDBWALFILE;
+    bool hot = false;
+    File::Status sbuf;
+    if (File::status(cpath, &sbuf)) {
+      if (!sbuf.isdir) {
+        set_error(_KCCODELINE_, Error::NOPERM, "invalid path (not directory)");
+        return false;
+      }
+      if (!File::status(metapath)) {
+        if (!writer_ || !(mode & OCREATE)) {
+          set_error(_KCCODELINE_, Error::BROKEN, "missing meta data");
+          return false;
+        }
+        hot = true;
+      }
+    } else if (writer_ && (mode & OCREATE)) {
+      if (!File::make_directory(cpath)) {
+        set_error(_KCCODELINE_, Error::SYSTEM, "making a directory failed");
+        return false;
+      }
+      hot = true;
+    } else {
+      set_error(_KCCODELINE_, Error::NOREPOS, "open failed (file not found)");
+      return false;
+    }
+    if (writer_ && (mode & OTRUNCATE)) hot = true;
+    if (!wal_.open(walpath, fmode)) {
+      set_error(_KCCODELINE_, Error::SYSTEM, wal_.error());
+      return false;
+    }
+    path_ = cpath;
+    tran_ = false;
+    memsiz_ = 0;
+    flushcnt_ = 0;
+    cmpcnt_ = 0;
+    bloomskip_ = 0;
+    mrgcnt_ = 0;
+    mrgfold_ = 0;
+    if (hot) {
+      if (!remove_files(NULL)) {
+        wal_.close();
+        return false;
+      }
+      if (!comp_) comp_ = LEXICALCOMP;
+      reset_memtable();
+      count_ = 0;
+      runcount_ = 0;
+      walid_ = 1;
+      nextid_ = walid_ + 1;
+      if (!dump_meta() || !reset_wal()) {
+        wal_.close();
+        return false;
+      }
+    } else {
+      if (!load_meta()) {
+        wal_.close();
+        return false;
+      }
+      if (!open_runs()) {
+        close_runs(false);
+        wal_.close();
+        return false;
+      }
+      if (writer_ && !remove_files(&runs_)) {
+        close_runs(false);
+        wal_.close();
+        return false;
+      }
+      reset_memtable();
+      count_ = runcount_;
+      if (!load_wal()) {
+        close_runs(false);
+        wal_.close();
+        return false;
+      }
+    }
+    omode_ = mode;
+    if (writer_) {
+      cmpreq_ = true;
+      cmpstop_ = false;
+      compactor_ = new Compactor(this);
+      compactor_->start();
+    }
+    trigger_meta(MetaTrigger::OPEN, "open");
+    return true;
+  }
+  /**
+   * Close the database directory.
+   * @return true on success, or false on failure.
+   * @note The records in memory are written as a new run before closing.
+   */
+  bool close() {
+    _assert_(true);
+    stop_compactor();
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
+    }
+    report(_KCCODELINE_, Logger::DEBUG, "closing the database (path=%s)", path_.c_str());
+    bool err = false;
+    if (tran_ && !abort_transaction()) err = true;
+    tran_ = false;
+    if (writer_ && !mem_.empty() && !flush_memtable()) err = true;
+    if (!close_runs(false)) err = true;
+    if (!wal_.close()) {
+      set_error(_KCCODELINE_, Error::SYSTEM, wal_.error());
+      err = true;
+    }
+    mem_.clear();
+    memsiz_ = 0;
+    mrgnum_ = 0;
+    omode_ = 0;
+    trigger_meta(MetaTrigger::CLOSE, "close");
+    return !err;
+  }
+  /**
+   * Synchronize updated contents with the file and the device.
+   * @param hard true for physical synchronization with the device, or false for logical
+   * synchronization with the file system.
+   * @param proc a postprocessor object.  If it is NULL, no postprocessing is performed.
+   * @param checker a progress checker object.  If it is NULL, no checking is performed.
+   * @return true on success, or false on failure.
+   * @note The operation of the postprocessor is performed atomically and other threads accessing
+   * the same record are blocked.  To avoid deadlock, any explicit database operation must not
+   * be performed in this function.  The records in memory are kept in the WAL file, which is
+   * a part of the database directory.  The run files, the Bloom filter files, and the meta data
+   * file are synchronized with the device whenever they are written, so the WAL file is the only
+   * file to be synchronized.
+   */
+  bool synchronize(bool hard = false, FileProcessor* proc = NULL,
+                   ProgressChecker* checker = NULL) {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
+    }
+    bool err = false;
+    if (checker && !checker->check("synchronize", "synchronizing the WAL file", -1, -1)) {
+      set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
+      return false;
+    }
+    if (writer_ && !wal_.synchronize(hard)) {
+      set_error(_KCCODELINE_, Error::SYSTEM, wal_.error());
+      err = true;
+    }
+    if (proc) {
+      if (checker && !checker->check("synchronize", "running the post processor", -1, -1)) {
+        set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
+        return false;
+      }
+      if (!proc->process(path_, count_impl(), size_impl())) {
+        set_error(_KCCODELINE_, Error::LOGIC, "postprocessing failed");
+        err = true;
+      }
+    }
+    trigger_meta(MetaTrigger::SYNCHRONIZE, "synchronize");
+    return !err;
+  }
+  /**
+   * Occupy database by locking and do something meanwhile.
+   * @param writable true to use writer lock, or false to use reader lock.
+   * @param proc a processor object.  If it is NULL, no processing is performed.
+   * @return true on success, or false on failure.
+   * @note The operation of the processor is performed atomically and other threads accessing
+   * the same record are blocked.  To avoid deadlock, any explicit database operation must not
+   * be performed in this function.
+   */
+  bool occupy(bool writable = true, FileProcessor* proc = NULL) {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, writable);
+    bool err = false;
+    if (proc && !proc->process(path_, count_impl(), size_impl())) {
+      set_error(_KCCODELINE_, Error::LOGIC, "processing failed");
+      err = true;
+    }
+    trigger_meta(MetaTrigger::OCCUPY, "occupy");
+    return !err;
+  }
+  /**
+   * Begin transaction.
+   * @param hard true for physical synchronization with the device, or false for logical
+   * synchronization with the file system.
+   * @return true on success, or false on failure.
+   */
+  bool begin_transaction(bool hard = false) {
+    _assert_(true);
+    uint32_t wcnt = 0;
+    while (true) {
+      mlock_.lock_writer();
+      if (omode_ == 0) {
+        set_error(_KCCODELINE_, Error::INVALID, "not opened");
+        mlock_.unlock();
+        return false;
+      }
+      if (!writer_) {
+        set_error(_KCCODELINE_, Error::NOPERM, "permission denied");
+        mlock_.unlock();
+        return false;
+      }
+      if (!tran_) break;
+      mlock_.unlock();
+      if (wcnt >= LOCKBUSYLOOP) {
+        Thread::chill();
+      } else {
+        Thread::yield();
+        wcnt++;
+      }
+    }
+    trhard_ = hard;
+    if (!begin_transaction_impl()) {
+      mlock_.unlock();
+      return false;
+    }
+    tran_ = true;
+    trigger_meta(MetaTrigger::BEGINTRAN, "begin_transaction");
+    mlock_.unlock();
+    return true;
+  }
+  /**
+   * Try to begin transaction.
+   * @param hard true for physical synchronization with the device, or false for logical
+   * synchronization with the file system.
+   * @return true on success, or false on failure.
+   */
+  bool begin_transaction_try(bool hard = false) {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
+    }
+    if (!writer_) {
+      set_error(_KCCODELINE_, Error::NOPERM, "permission denied");
+      return false;
+    }
+    if (tran_) {
+      set_error(_KCCODELINE_, Error::LOGIC, "competition avoided");
+      return false;
+    }
+    trhard_ = hard;
+    if (!begin_transaction_impl()) return false;
+    tran_ = true;
+    trigger_meta(MetaTrigger::BEGINTRAN, "begin_transaction_try");
+    return true;
+  }
+  /**
+   * End transaction.
+   * @param commit true to commit the transaction, or false to abort the transaction.
+   * @return true on success, or false on failure.
+   */
+  bool end_transaction(bool commit = true) {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
+    }
+    if (!tran_) {
+      set_error(_KCCODELINE_, Error::INVALID, "not in transaction");
+      return false;
+    }
+    bool err = false;
+    if (commit) {
+      if (!commit_transaction()) err = true;
+    } else {
+      if (!abort_transaction()) err = true;
+    }
+    tran_ = false;
+    if (!err && !flush_auto()) err = true;
+    trigger_meta(commit ? MetaTrigger::COMMITTRAN : MetaTrigger::ABORTTRAN, "end_transaction");
+    return !err;
+  }
+  /**
+   * Remove all records.
+   * @return true on success, or false on failure.
+   * @note In a transaction, every record is overwritten by a removal mark so that it can be
+   * restored by aborting the transaction.
+   */
+  bool clear() {
+    _assert_(true);
+    ScopedMutex clock(&cmplock_);
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
+    }
+    if (!writer_) {
+      set_error(_KCCODELINE_, Error::NOPERM, "permission denied");
+      return false;
+    }
+    bool err = false;
+    if (tran_) {
+      RunScan scan;
+      std::string key, pivot;
+      int64_t cnt = 0;
+      while (true) {
+        bool hit;
+        if (!seek_record(&scan, cnt > 0 ? &pivot : NULL, false, true, &key, NULL, &hit)) {
+          err = true;
+          break;
+        }
+        if (!hit) break;
+        if (!write_record(key.data(), key.size(), NULL, 0, WALREMOVE)) {
+          err = true;
+          break;
+        }
+        pivot = key;
+        cnt++;
+      }
+    } else {
+      clear_cursor_scans();
+      RunVector runs;
+      runs.swap(runs_);
+      mem_.clear();
+      memsiz_ = 0;
+      mrgnum_ = 0;
+      count_ = 0;
+      runcount_ = 0;
+      walid_ = nextid_++;
+      if (!dump_meta()) err = true;
+      if (!reset_wal()) err = true;
+      runs_.swap(runs);
+      if (!close_runs(!err)) err = true;
+    }
+    trigger_meta(MetaTrigger::CLEAR, "clear");
+    return !err;
+  }
+  /**
+   * Get the number of records.
+   * @return the number of records, or -1 on failure.
+   * @note The time is constant unless merge operands are queued.  Otherwise, the table in
+   * memory is scanned and the runs are looked up for each record of queued operands, because
+   * whether the record is new is not known until its operands are folded.  The status method
+   * has the same cost.
+   */
+  int64_t count() {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, false);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return -1;
+    }
+    return count_impl();
+  }
+  /**
+   * Get the size of the database directory.
+   * @return the total size of the run files and the WAL file in bytes, or -1 on failure.
+   */
+  int64_t size() {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, false);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return -1;
+    }
+    return size_impl();
+  }
+  /**
+   * Get the path of the database directory.
+   * @return the path of the database directory, or an empty string on failure.
+   */
+  std::string path() {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, false);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return "";
+    }
+    return path_;
+  }
+  /**
+   * Get the miscellaneous status information.
+   * @param strmap a string map to contain the result.
+   * @return true on success, or false on failure.
+   */
+  bool status(std::map<std::string, std::string>* strmap) {
+    _assert_(strmap);
+    ScopedRWLock lock(&mlock_, false);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
+    }
+    (*strmap)["type"] = strprintf("%u", (unsigned)TYPELTREE);
+    (*strmap)["path"] = path_;
+    (*strmap)["opts"] = strprintf("%u", opts_);
+    (*strmap)["recovered"] = strprintf("%d", recov_);
+    if (comp_ == LEXICALCOMP) {
+      (*strmap)["rcomp"] = "lexical";
+    } else if (comp_ == DECIMALCOMP) {
+      (*strmap)["rcomp"] = "decimal";
+    } else if (comp_ == LEXICALDESCCOMP) {
+      (*strmap)["rcomp"] = "lexicaldesc";
+    } else if (comp_ == DECIMALDESCCOMP) {
+      (*strmap)["rcomp"] = "decimaldesc";
+    } else {
+      (*strmap)["rcomp"] = "external";
+    }
+    (*strmap)["mtcap"] = strprintf("%lld", (long long)mtcap_);
+    (*strmap)["mtcount"] = strprintf("%lld", (long long)mem_.size());
+    (*strmap)["mtsize"] = strprintf("%lld", (long long)memsiz_);
+    (*strmap)["cmpnum"] = strprintf("%d", (int)cmpnum_);
+    (*strmap)["runnum"] = strprintf("%lld", (long long)runs_.size());
+    int64_t runcnt = 0;
+    RunVector::const_iterator rit = runs_.begin();
+    RunVector::const_iterator ritend = runs_.end();
+    while (rit != ritend) {
+      runcnt += (*rit)->count;
+      ++rit;
+    }
+    (*strmap)["runcount"] = strprintf("%lld", (long long)runcnt);
+    (*strmap)["flushcnt"] = strprintf("%lld", (long long)flushcnt_.get());
+    (*strmap)["cmpcnt"] = strprintf("%lld", (long long)cmpcnt_.get());
+    (*strmap)["bloomskip"] = strprintf("%lld", (long long)bloomskip_.get());
+    (*strmap)["mrgnum"] = strprintf("%lld", (long long)mrgnum_);
+    (*strmap)["mrgcnt"] = strprintf("%lld", (long long)mrgcnt_.get());
+    (*strmap)["mrgfold"] = strprintf("%lld", (long long)mrgfold_.get());
+    (*strmap)["count"] = strprintf("%lld", (long long)count_impl());
+    (*strmap)["size"] = strprintf("%lld", (long long)size_impl());
+    return true;
+  }
+  /**
+   * Create a cursor object.
+   * @return the return value is the created cursor object.
+   * @note Because the object of the return value is allocated by the constructor, it should be
+   * released with the delete operator when it is no longer in use.
+   */
+  Cursor* cursor() {
+    _assert_(true);
+    return new Cursor(this);
+  }
+  /**
+   * Set the internal logger.
+   * @param logger the logger object.
+   * @param kinds kinds of logged messages by bitwise-or: Logger::DEBUG for debugging,
+   * Logger::INFO for normal information, Logger::WARN for warning, and Logger::ERROR for fatal
+   * error.
+   * @return true on success, or false on failure.
+   */
+  bool tune_logger(Logger* logger, uint32_t kinds = Logger::WARN | Logger::ERROR) {
+    _assert_(logger);
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ != 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "already opened");
+      return false;
+    }
+    logger_ = logger;
+    logkinds_ = kinds;
+    return true;
+  }
+  /**
+   * Set the internal meta operation trigger.
+   * @param trigger the trigger object.
+   * @return true on success, or false on failure.
+   */
+  bool tune_meta_trigger(MetaTrigger* trigger) {
+    _assert_(trigger);
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ != 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "already opened");
+      return false;
+    }
+    mtrigger_ = trigger;
+    return true;
+  }
+  /**
+   * Set the optional features of the runs.
+   * @param opts the optional features by bitwise-or: LogTreeDB::TSMALL to use 32-bit
+   * addressing, LogTreeDB::TLINEAR to use linear collision chaining, LogTreeDB::TCOMPRESS to
+   * compress each record.
+   * @return true on success, or false on failure.
+   */
+  bool tune_options(int8_t opts) {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ != 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "already opened");
+      return false;
+    }
+    opts_ = opts;
+    return true;
+  }
+  /**
+   * Set the size of each page of the runs.
+   * @param psiz the size of each page.
+   * @return true on success, or false on failure.
+   */
+  bool tune_page(int32_t psiz) {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ != 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "already opened");
+      return false;
+    }
+    psiz_ = psiz;
+    return true;
+  }
+  /**
+   * Set the capacity size of the page cache of each run.
+   * @param pccap the capacity size of the page cache.
+   * @return true on success, or false on failure.
+   */
+  bool tune_page_cache(int64_t pccap) {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ != 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "already opened");
+      return false;
+    }
+    pccap_ = pccap;
+    return true;
+  }
+  /**
+   * Set the data compressor of the runs.
+   * @param comp the data compressor object.
+   * @return true on success, or false on failure.
+   */
+  bool tune_compressor(Compressor* comp) {
+    _assert_(comp);
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ != 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "already opened");
+      return false;
+    }
+    embcomp_ = comp;
+    return true;
+  }
+  /**
+   * Set the record comparator.
+   * @param rcomp the record comparator object.
+   * @return true on success, or false on failure.
+   * @note Note that the comparator is stored in the meta data only if it is one of the built-in
+   * comparators.  A custom comparator must be set again whenever the database is opened.
+   */
+  bool tune_comparator(Comparator* rcomp) {
+    _assert_(rcomp);
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ != 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "already opened");
+      return false;
+    }
+    comp_ = rcomp;
+    return true;
+  }
+  /**
+   * Set the capacity of the table in memory.
+   * @param mtcap the capacity in bytes of the records in memory.  When the total size exceeds
+   * it, the records are written as a new run.
+   * @return true on success, or false on failure.
+   */
+  bool tune_memtable(int64_t mtcap) {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ != 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "already opened");
+      return false;
+    }
+    mtcap_ = mtcap > 0 ? mtcap : DEFMTCAP;
+    return true;
+  }
+  /**
+   * Set the number of runs to trigger compaction.
+   * @param cmpnum the number of runs.  When the number of runs reaches it, adjacent runs of
+   * similar size are merged in the background.
+   * @return true on success, or false on failure.
+   */
+  bool tune_compaction(int32_t cmpnum) {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ != 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "already opened");
+      return false;
+    }
+    cmpnum_ = cmpnum > 1 ? cmpnum : DEFCMPNUM;
+    return true;
+  }
+  /**
+   * Set the merge operator.
+   * @param mop the merge operator object.
+   * @return true on success, or false on failure.
+   * @note Operands given to the merge_operand method with this operator are logged and folded
+   * lazily.  Because operands may remain in the WAL file, the same operator must be set again
+   * whenever the database is opened.  Without it, operands of records which are not in memory
+   * are kept queued, but reading such records and closing the database fail with the
+   * Error::INVALID code, and opening fails if an operand has to be folded into a value written
+   * in the WAL file.  The records are recovered by opening the database again with the
+   * operator.
+   */
+  bool tune_merge_operator(MergeOperator* mop) {
+    _assert_(mop);
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ != 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "already opened");
+      return false;
+    }
+    mop_ = mop;
+    return true;
+  }
+  /**
+   * Get the record comparator.
+   * @return the record comparator object, or NULL on failure.
+   */
+  Comparator* rcomp() {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, false);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return NULL;
+    }
+    return comp_;
+  }
+  /**
+   * Write the records in memory as a new run.
+   * @return true on success, or false on failure.
+   */
+  bool flush() {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
+    }
+    if (!writer_) {
+      set_error(_KCCODELINE_, Error::NOPERM, "permission denied");
+      return false;
+    }
+    if (tran_) {
+      set_error(_KCCODELINE_, Error::LOGIC, "competition avoided");
+      return false;
+    }
+    return flush_memtable();
+  }
+ protected:
+  /**
+   * Report a message for debugging.
+   * @param file the file name of the program source code.
+   * @param line the line number of the program source code.
+   * @param func the function name of the program source code.
+   * @param kind the kind of the event.  Logger::DEBUG for debugging, Logger::INFO for normal
+   * information, Logger::WARN for warning, and Logger::ERROR for fatal error.
+   * @param format the printf-like format string.
+   * @param ... used according to the format string.
+   */
+  void report(const char* file, int32_t line, const char* func, Logger::Kind kind,
+              const char* format, ...) {
+    _assert_(file && line > 0 && func && format);
+    if (!logger_ || !(kind & logkinds_)) return;
+    std::string message;
+    strprintf(&message, "%s: ", path_.empty() ? "-" : path_.c_str());
+    va_list ap;
+    va_start(ap, format);
+    vstrprintf(&message, format, ap);
+    va_end(ap);
+    logger_->log(file, line, func, kind, message.c_str());
+  }
+  /**
+   * Trigger a meta database operation.
+   * @param kind the kind of the event.  MetaTrigger::OPEN for opening, MetaTrigger::CLOSE for
+   * closing, MetaTrigger::CLEAR for clearing, MetaTrigger::ITERATE for iteration,
+   * MetaTrigger::SYNCHRONIZE for synchronization, MetaTrigger::BEGINTRAN for beginning
+   * transaction, MetaTrigger::COMMITTRAN for committing transaction, MetaTrigger::ABORTTRAN
+   * for aborting transaction, and MetaTrigger::MISC for miscellaneous operations.
+   * @param message the supplement message.
+   */
+  void trigger_meta(MetaTrigger::Kind kind, const char* message) {
+    _assert_(message);
+    if (mtrigger_) mtrigger_->trigger(kind, message);
+  }
+ private:
+  /**
+   * Comparator of the table in memory.
+   */
+  struct MemtableComparator {
+    /** constructor */
+    explicit MemtableComparator(Comparator* comp) : comp(comp) {}
+    /** comparing operator */
+    bool operator ()(const std::string& a, const std::string& b) const {
+      return comp->compare(a.data(), a.size(), b.data(), b.size()) < 0;
+    }
+    Comparator* comp;                    ///< comparator
+  };
+  /**
+   * Immutable sorted run.
+   */
+  struct Run {
+    int64_t id;                          ///< identifier
+    TreeDB* db;                          ///< database of the records
+    std::string bloom;                   ///< bit array of the Bloom filter
+    int64_t count;                       ///< number of records including removal marks
+  };
+  /**
+   * Scoped visitor.
+   */
+  class ScopedVisitor {
+   public:
+    /** constructor */
+    explicit ScopedVisitor(Visitor* visitor) : visitor_(visitor) {
+      _assert_(visitor);
+      visitor_->visit_before();
+    }
+    /** destructor */
+    ~ScopedVisitor() {
+      _assert_(true);
+      visitor_->visit_after();
+    }
+   private:
+    Visitor* visitor_;                   ///< visitor
+  };
+  /**
+   * Background thread to merge runs.
+   */
+  class Compactor : public Thread {
+   public:
+    /** constructor */
+    explicit Compactor(LogTreeDB* db) : db_(db) {}
+    /** perform the concrete process */
+    void run() {
+      _assert_(true);
+      db_->compact_loop();
+    }
+   private:
+    LogTreeDB* db_;                      ///< database
+  };
+  /**
+   * Accept a visitor to a record.
+   * @param kbuf the pointer to the key region.
+   * @param ksiz the size of the key region.
+   * @param visitor a visitor object.
+   * @param writable true for writable operation, or false for read-only operation.
+   * @return true on success, or false on failure.
+   */
+  bool accept_impl(const char* kbuf, size_t ksiz, Visitor* visitor, bool writable) {
+    _assert_(kbuf && ksiz <= MEMMAXSIZ && visitor);
+    std::string value;
+    bool hit;
+    if (!find_record(kbuf, ksiz, &value, &hit)) return false;
+    return visit_record(kbuf, ksiz, hit ? &value : NULL, visitor, writable);
+  }
+  /**
+   * Call a visitor for a record and apply the result.
+   * @param kbuf the pointer to the key region.
+   * @param ksiz the size of the key region.
+   * @param value the current value, or NULL if the record does not exist.
+   * @param visitor a visitor object.
+   * @param writable true for writable operation, or false for read-only operation.
+   * @return true on success, or false on failure.
+   */
+  bool visit_record(const char* kbuf, size_t ksiz, const std::string* value,
+                    Visitor* visitor, bool writable) {
+    _assert_(kbuf && ksiz <= MEMMAXSIZ && visitor);
+    size_t rsiz;
+    const char* rbuf = value ?
+        visitor->visit_full(kbuf, ksiz, value->data(), value->size(), &rsiz) :
+        visitor->visit_empty(kbuf, ksiz, &rsiz);
+    if (!writable) return true;
+    if (rbuf == Visitor::REMOVE) {
+      if (value && !write_record(kbuf, ksiz, NULL, 0, WALREMOVE)) return false;
+    } else if (rbuf != Visitor::NOP) {
+      if (!write_record(kbuf, ksiz, rbuf, rsiz, value ? WALREPLACE : WALADD)) return false;
+    }
+    return true;
+  }
+  /**
+   * Find the newest version of a record.
+   * @param kbuf the pointer to the key region.
+   * @param ksiz the size of the key region.
+   * @param value the string to contain the value.
+   * @param hitp the pointer to the variable for the hit flag.
+   * @return true on success, or false on failure.
+   */
+  bool find_record(const char* kbuf, size_t ksiz, std::string* value, bool* hitp) {
+    _assert_(kbuf && ksiz <= MEMMAXSIZ && value && hitp);
+    *hitp = false;
+    Memtable::const_iterator it = mem_.find(std::string(kbuf, ksiz));
+    if (it != mem_.end()) {
+      const std::string& rec = it->second;
+      if (rec[0] == RECLIVE) {
+        value->assign(rec, 1, std::string::npos);
+        *hitp = true;
+      } else if (rec[0] == RECMERGE) {
+        if (!find_run_record(kbuf, ksiz, value, hitp)) return false;
+        if (!fold_operands(kbuf, ksiz, rec.data() + 1, rec.size() - 1, value, hitp)) return false;
+      }
+      return true;
+    }
+    return find_run_record(kbuf, ksiz, value, hitp);
+  }
+  /**
+   * Find the newest version of a record in the runs.
+   * @param kbuf the pointer to the key region.
+   * @param ksiz the size of the key region.
+   * @param value the string to contain the value.
+   * @param hitp the pointer to the variable for the hit flag.
+   * @return true on success, or false on failure.
+   */
+  bool find_run_record(const char* kbuf, size_t ksiz, std::string* value, bool* hitp) {
+    _assert_(kbuf && ksiz <= MEMMAXSIZ && value && hitp);
+    *hitp = false;
+    for (int64_t i = (int64_t)runs_.size() - 1; i >= 0; i--) {
+      Run* run = runs_[i];
+      if (!check_bloom(run->bloom, kbuf, ksiz)) {
+        bloomskip_ += 1;
+        continue;
+      }
+      size_t vsiz;
+      char* vbuf = run->db->get(kbuf, ksiz, &vsiz);
+      if (!vbuf) {
+        const Error& e = run->db->error();
+        if (e == Error::NOREC) continue;
+        set_error(_KCCODELINE_, e.code(), e.message());
+        return false;
+      }
+      if (vsiz > 0 && *vbuf == RECLIVE) {
+        value->assign(vbuf + 1, vsiz - 1);
+        *hitp = true;
+      }
+      delete[] vbuf;
+      return true;
+    }
+    return true;
+  }
+  /**
+   * Find the nearest live record from a pivot.
+   * @param scan the cursors of the runs, which are moved or repositioned.
+   * @param key the key of the pivot, or NULL to specify the first or the last record.
+   * @param incl true to include the pivot itself, or false to exclude it.
+   * @param fwd true for forward direction, or false for backward direction.
+   * @param rkey the string to contain the key of the found record.
+   * @param rvalue the string to contain the value of the found record.  If it is NULL, it is
+   * ignored.
+   * @param hitp the pointer to the variable for the hit flag.
+   * @return true on success, or false on failure.
+   */
+  bool seek_record(RunScan* scan, const std::string* key, bool incl, bool fwd,
+                   std::string* rkey, std::string* rvalue, bool* hitp) {
+    _assert_(scan && rkey && hitp);
+    *hitp = false;
+    std::string pivot;
+    if (key) pivot = *key;
+    bool has = key != NULL;
+    while (true) {
+      bool found = false;
+      std::string ckey, cvalue;
+      Memtable::const_iterator it;
+      if (fwd) {
+        it = has ? (incl ? mem_.lower_bound(pivot) : mem_.upper_bound(pivot)) : mem_.begin();
+        if (it != mem_.end()) found = true;
+      } else {
+        it = has ? (incl ? mem_.upper_bound(pivot) : mem_.lower_bound(pivot)) : mem_.end();
+        if (it != mem_.begin()) {
+          --it;
+          found = true;
+        }
+      }
+      if (found) {
+        ckey = it->first;
+        cvalue = it->second;
+      }
+      if (!position_scan(scan, has ? &pivot : NULL, incl, fwd)) return false;
+      for (int64_t i = (int64_t)runs_.size() - 1; i >= 0; i--) {
+        if (!scan->hits[i]) continue;
+        const std::string& rk = scan->keys[i];
+        if (found) {
+          int32_t cmp = comp_->compare(rk.data(), rk.size(), ckey.data(), ckey.size());
+          if (fwd ? cmp >= 0 : cmp <= 0) continue;
+        }
+        ckey = rk;
+        cvalue = scan->values[i];
+        found = true;
+      }
+      if (!found) return true;
+      if (!cvalue.empty() && cvalue[0] == RECLIVE) {
+        *rkey = ckey;
+        if (rvalue) rvalue->assign(cvalue, 1, std::string::npos);
+        *hitp = true;
+        return true;
+      }
+      if (!cvalue.empty() && cvalue[0] == RECMERGE) {
+        if (rvalue) {
+          bool vhit;
+          if (!find_run_record(ckey.data(), ckey.size(), rvalue, &vhit)) return false;
+          if (!fold_operands(ckey.data(), ckey.size(), cvalue.data() + 1, cvalue.size() - 1,
+                             rvalue, &vhit)) return false;
+        }
+        *rkey = ckey;
+        *hitp = true;
+        return true;
+      }
+      pivot = ckey;
+      has = true;
+      incl = false;
+    }
+    return true;
+  }
+  /**
+   * Position the cursors of the runs at the nearest records from a pivot.
+   * @param scan the cursors of the runs.
+   * @param key the key of the pivot, or NULL to specify the first or the last record.
+   * @param incl true to include the pivot itself, or false to exclude it.
+   * @param fwd true for forward direction, or false for backward direction.
+   * @return true on success, or false on failure.
+   * @note If the cursors were positioned short of the pivot in the same direction, only the
+   * cursors left behind it are moved.  Otherwise, all of them are repositioned.
+   */
+  bool position_scan(RunScan* scan, const std::string* key, bool incl, bool fwd) {
+    _assert_(scan);
+    bool reuse = scan->pos && scan->fwd == fwd;
+    if (reuse && scan->has) {
+      if (key) {
+        int32_t cmp = comp_->compare(key->data(), key->size(),
+                                     scan->pivot.data(), scan->pivot.size());
+        if (!fwd) cmp = -cmp;
+        reuse = cmp > 0 || (cmp == 0 && (scan->incl || !incl));
+      } else {
+        reuse = false;
+      }
+    }
+    size_t rnum = runs_.size();
+    if (!reuse) {
+      clear_scan(scan);
+      scan->curs.reserve(rnum);
+      for (size_t i = 0; i < rnum; i++) {
+        scan->curs.push_back(new TreeDB::Cursor(runs_[i]->db));
+      }
+      scan->keys.resize(rnum);
+      scan->values.resize(rnum);
+      scan->hits.resize(rnum, false);
+    }
+    for (size_t i = 0; i < rnum; i++) {
+      if (reuse) {
+        if (!scan->hits[i] || !key) continue;
+        const std::string& rk = scan->keys[i];
+        int32_t cmp = comp_->compare(rk.data(), rk.size(), key->data(), key->size());
+        if (!fwd) cmp = -cmp;
+        if (cmp > 0 || (cmp == 0 && incl)) continue;
+        if (cmp == 0) {
+          if (!step_run(runs_[i], scan, i, fwd)) return false;
+          continue;
+        }
+      }
+      if (!seek_run(runs_[i], scan, i, key, incl, fwd)) return false;
+    }
+    scan->pos = true;
+    scan->has = key != NULL;
+    if (key) scan->pivot = *key;
+    scan->incl = incl;
+    scan->fwd = fwd;
+    return true;
+  }
+  /**
+   * Release the cursors of the runs.
+   * @param scan the cursors of the runs.
+   */
+  void clear_scan(RunScan* scan) {
+    _assert_(scan);
+    for (size_t i = 0; i < scan->curs.size(); i++) {
+      delete scan->curs[i];
+    }
+    scan->curs.clear();
+    scan->keys.clear();
+    scan->values.clear();
+    scan->hits.clear();
+    scan->pos = false;
+  }
+  /**
+   * Release the cursors of the runs held by all cursors.
+   * @note This must be called with the writer lock before the set of runs is changed.
+   */
+  void clear_cursor_scans() {
+    _assert_(true);
+    CursorList::const_iterator cit = curs_.begin();
+    CursorList::const_iterator citend = curs_.end();
+    while (cit != citend) {
+      clear_scan(&(*cit)->scan_);
+      ++cit;
+    }
+  }
+  /**
+   * Move the cursor of a run to the nearest record from a pivot.
+   * @param run the run.
+   * @param scan the cursors of the runs.
+   * @param idx the index of the run.
+   * @param key the key of the pivot, or NULL to specify the first or the last record.
+   * @param incl true to include the pivot itself, or false to exclude it.
+   * @param fwd true for forward direction, or false for backward direction.
+   * @return true on success, or false on failure.
+   */
+  bool seek_run(Run* run, RunScan* scan, size_t idx, const std::string* key, bool incl,
+                bool fwd) {
+    _assert_(run && scan);
+    TreeDB::Cursor* cur = scan->curs[idx];
+    std::string* rkey = &scan->keys[idx];
+    std::string* rvalue = &scan->values[idx];
+    scan->hits[idx] = false;
+    bool ok;
+    if (fwd) {
+      ok = key ? cur->jump(*key) : cur->jump();
+    } else {
+      ok = key ? cur->jump_back(*key) : cur->jump_back();
+    }
+    if (ok) ok = cur->get(rkey, rvalue, false);
+    if (ok && key && !incl &&
+        comp_->compare(rkey->data(), rkey->size(), key->data(), key->size()) == 0) {
+      ok = fwd ? cur->step() : cur->step_back();
+      if (ok) ok = cur->get(rkey, rvalue, false);
+    }
+    if (!ok) {
+      const Error& e = run->db->error();
+      if (e == Error::NOREC) return true;
+      set_error(_KCCODELINE_, e.code(), e.message());
+      return false;
+    }
+    scan->hits[idx] = true;
+    return true;
+  }
+  /**
+   * Move the cursor of a run to the next record.
+   * @param run the run.
+   * @param scan the cursors of the runs.
+   * @param idx the index of the run.
+   * @param fwd true for forward direction, or false for backward direction.
+   * @return true on success, or false on failure.
+   */
+  bool step_run(Run* run, RunScan* scan, size_t idx, bool fwd) {
+    _assert_(run && scan);
+    TreeDB::Cursor* cur = scan->curs[idx];
+    scan->hits[idx] = false;
+    bool ok = fwd ? cur->step() : cur->step_back();
+    if (ok) ok = cur->get(&scan->keys[idx], &scan->values[idx], false);
+    if (!ok) {
+      const Error& e = run->db->error();
+      if (e == Error::NOREC) return true;
+      set_error(_KCCODELINE_, e.code(), e.message());
+      return false;
+    }
+    scan->hits[idx] = true;
+    return true;
+  }
+  /**
+   * Iterate to accept a visitor for each record.
+   * @param visitor a visitor object.
+   * @param writable true for writable operation, or false for read-only operation.
+   * @param checker a progress checker object.
+   * @return true on success, or false on failure.
+   */
+  bool iterate_impl(Visitor* visitor, bool writable, ProgressChecker* checker) {
+    _assert_(visitor);
+    int64_t allcnt = count_impl();
+    if (allcnt < 0) return false;
+    if (checker && !checker->check("iterate", "beginning", 0, allcnt)) {
+      set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
+      return false;
+    }
+    RunScan scan;
+    std::string key, pivot, value;
+    int64_t curcnt = 0;
+    while (true) {
+      bool hit;
+      if (!seek_record(&scan, curcnt > 0 ? &pivot : NULL, false, true, &key, &value, &hit))
+        return false;
+      if (!hit) break;
+      if (!visit_record(key.data(), key.size(), &value, visitor, writable)) return false;
+      pivot = key;
+      curcnt++;
+      if (checker && !checker->check("iterate", "processing", curcnt, allcnt)) {
+        set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
+        return false;
+      }
+    }
+    if (checker && !checker->check("iterate", "ending", -1, allcnt)) {
+      set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
+      return false;
+    }
+    return true;
+  }
+  /**
+   * Write a record into the WAL file and the table in memory.
+   * @param kbuf the pointer to the key region.
+   * @param ksiz the size of the key region.
+   * @param vbuf the pointer to the value region.
+   * @param vsiz the size of the value region.
+   * @param op the operation code.
+   * @return true on success, or false on failure.
+   */
+  bool write_record(const char* kbuf, size_t ksiz, const char* vbuf, size_t vsiz, uint8_t op) {
+    _assert_(kbuf && ksiz <= MEMMAXSIZ && vsiz <= MEMMAXSIZ);
+    size_t rsiz = 1 + sizevarnum(ksiz) + sizevarnum(vsiz) + ksiz + vsiz;
+    char stack[WALBUFSIZ];
+    char* rbuf = rsiz > sizeof(stack) ? new char[rsiz] : stack;
+    char* wp = rbuf;
+    *(wp++) = op;
+    wp += writevarnum(wp, ksiz);
+    wp += writevarnum(wp, vsiz);
+    std::memcpy(wp, kbuf, ksiz);
+    wp += ksiz;
+    if (vsiz > 0) std::memcpy(wp, vbuf, vsiz);
+    bool err = false;
+    int64_t wsiz = wal_.size();
+    if (!wal_.append(rbuf, rsiz)) {
+      set_error(_KCCODELINE_, Error::SYSTEM, wal_.error());
+      err = true;
+    }
+    if (rbuf != stack) delete[] rbuf;
+    if (err) return false;
+    if (!apply_record(kbuf, ksiz, vbuf, vsiz, op)) {
+      if (!wal_.truncate(wsiz))
+        report(_KCCODELINE_, Logger::ERROR, "truncating the WAL file failed: %s", wal_.error());
+      return false;
+    }
+    if (autosync_ && !tran_ && !wal_.synchronize(true)) {
+      set_error(_KCCODELINE_, Error::SYSTEM, wal_.error());
+      return false;
+    }
+    return true;
+  }
+  /**
+   * Apply an operation to the table in memory.
+   * @param kbuf the pointer to the key region.
+   * @param ksiz the size of the key region.
+   * @param vbuf the pointer to the value region.
+   * @param vsiz the size of the value region.
+   * @param op the operation code.
+   * @return true on success, or false on failure.
+   */
+  bool apply_record(const char* kbuf, size_t ksiz, const char* vbuf, size_t vsiz, uint8_t op) {
+    _assert_(kbuf && ksiz <= MEMMAXSIZ && vsiz <= MEMMAXSIZ);
+    std::string key(kbuf, ksiz);
+    Memtable::iterator it = mem_.find(key);
+    if (tran_ && trundo_.find(key) == trundo_.end())
+      trundo_[key] = it == mem_.end() ? std::string() : it->second;
+    if (op == WALMERGE) return apply_merge(key, it, vbuf, vsiz);
+    if (it == mem_.end()) {
+      it = mem_.insert(std::make_pair(key, std::string())).first;
+      memsiz_ += ksiz + MTUNITSIZ;
+    } else {
+      if (it->second[0] == RECMERGE) {
+        std::string base;
+        bool hit;
+        if (!find_run_record(kbuf, ksiz, &base, &hit)) return false;
+        if (!hit) count_++;
+        mrgnum_--;
+      }
+      memsiz_ -= it->second.size();
+    }
+    std::string& value = it->second;
+    value.clear();
+    if (op == WALREMOVE) {
+      value.push_back(RECTOMB);
+    } else {
+      value.reserve(vsiz + 1);
+      value.push_back(RECLIVE);
+      value.append(vbuf, vsiz);
+    }
+    memsiz_ += value.size();
+    if (op == WALADD) {
+      count_++;
+    } else if (op == WALREMOVE) {
+      count_--;
+    }
+    return true;
+  }
+  /**
+   * Apply a merge operand to the table in memory.
+   * @param key the key of the record.
+   * @param it the iterator of the record in memory, or the end if it is not in memory.
+   * @param vbuf the pointer to the region of the kind and the operand.
+   * @param vsiz the size of the region.
+   * @return true on success, or false on failure.
+   * @note If the record is in memory, the operand is folded at once.  Otherwise, it is queued
+   * until the total size of queued operands exceeds the limit and then they are folded with the
+   * value in the runs.
+   */
+  bool apply_merge(const std::string& key, Memtable::iterator it,
+                   const char* vbuf, size_t vsiz) {
+    _assert_(vbuf && vsiz > 0);
+    uint8_t kind = *(uint8_t*)vbuf;
+    const char* obuf = vbuf + 1;
+    size_t osiz = vsiz - 1;
+    std::string value;
+    bool hit = false;
+    if (it == mem_.end() || it->second[0] == RECMERGE) {
+      char nbuf[NUMBUFSIZ];
+      size_t nsiz = writevarnum(nbuf, osiz);
+      size_t qsiz = (it == mem_.end() ? 1 : it->second.size()) + 1 + nsiz + osiz;
+      if (qsiz <= MRGFOLDSIZ || !foldable(it, kind)) {
+        if (it == mem_.end()) {
+          it = mem_.insert(std::make_pair(key, std::string(1, RECMERGE))).first;
+          memsiz_ += key.size() + MTUNITSIZ + 1;
+          mrgnum_++;
+        }
+        std::string& rec = it->second;
+        rec.reserve(qsiz);
+        rec.push_back(kind);
+        rec.append(nbuf, nsiz);
+        rec.append(obuf, osiz);
+        memsiz_ += 1 + nsiz + osiz;
+        return true;
+      }
+      if (!find_run_record(key.data(), key.size(), &value, &hit)) return false;
+      bool base = hit;
+      if (it != mem_.end() && !fold_operands(key.data(), key.size(), it->second.data() + 1,
+                                             it->second.size() - 1, &value, &hit))
+        return false;
+      if (!combine_operand(key.data(), key.size(), kind, obuf, osiz, &value, &hit)) return false;
+      if (!base) count_++;
+      if (it == mem_.end()) {
+        it = mem_.insert(std::make_pair(key, std::string())).first;
+        memsiz_ += key.size() + MTUNITSIZ;
+      } else {
+        mrgnum_--;
+      }
+    } else {
+      if (it->second[0] == RECLIVE) {
+        value.assign(it->second, 1, std::string::npos);
+        hit = true;
+      }
+      bool base = hit;
+      if (!combine_operand(key.data(), key.size(), kind, obuf, osiz, &value, &hit)) return false;
+      if (!base) count_++;
+    }
+    std::string& rec = it->second;
+    memsiz_ -= rec.size();
+    rec.clear();
+    rec.reserve(value.size() + 1);
+    rec.push_back(RECLIVE);
+    rec.append(value);
+    memsiz_ += rec.size();
+    return true;
+  }
+  /**
+   * Check whether queued merge operands can be folded with a new one.
+   * @param it the iterator of the record in memory, or the end if it is not in memory.
+   * @param kind the kind of the merge operator of the new operand.
+   * @return true if the operators of all operands are available, or false if not.
+   * @note Operands of the custom operator are kept queued while the operator is not given,
+   * for example when the WAL is replayed without it, so that they are not lost.
+   */
+  bool foldable(Memtable::const_iterator it, uint8_t kind) {
+    _assert_(true);
+    if (mop_) return true;
+    if (kind == MRGCUSTOM) return false;
+    if (it == mem_.end()) return true;
+    const char* rp = it->second.data() + 1;
+    const char* ep = it->second.data() + it->second.size();
+    while (rp < ep) {
+      if (*(uint8_t*)rp == MRGCUSTOM) return false;
+      uint64_t osiz;
+      size_t step = readvarnum(rp + 1, ep - rp - 1, &osiz);
+      if (step < 1) return false;
+      rp += 1 + step + osiz;
+    }
+    return true;
+  }
+  /**
+   * Fold queued merge operands into a value.
+   * @param kbuf the pointer to the key region.
+   * @param ksiz the size of the key region.
+   * @param rbuf the pointer to the region of the queued operands.
+   * @param rsiz the size of the region.
+   * @param value the string of the value to be updated.
+   * @param hitp the pointer to the variable for the hit flag, which is true if the record exists.
+   * @return true on success, or false on failure.
+   */
+  bool fold_operands(const char* kbuf, size_t ksiz, const char* rbuf, size_t rsiz,
+                     std::string* value, bool* hitp) {
+    _assert_(kbuf && ksiz <= MEMMAXSIZ && rbuf && value && hitp);
+    const char* rp = rbuf;
+    const char* ep = rbuf + rsiz;
+    while (rp < ep) {
+      uint8_t kind = *(uint8_t*)(rp++);
+      uint64_t osiz;
+      size_t step = readvarnum(rp, ep - rp, &osiz);
+      if (step < 1 || (uint64_t)(ep - rp - step) < osiz) {
+        set_error(_KCCODELINE_, Error::BROKEN, "invalid merge operands");
+        return false;
+      }
+      rp += step;
+      if (!combine_operand(kbuf, ksiz, kind, rp, osiz, value, hitp)) return false;
+      rp += osiz;
+    }
+    mrgfold_ += 1;
+    return true;
+  }
+  /**
+   * Merge an operand into a value.
+   * @param kbuf the pointer to the key region.
+   * @param ksiz the size of the key region.
+   * @param kind the kind of the merge operator.
+   * @param obuf the pointer to the operand region.
+   * @param osiz the size of the operand region.
+   * @param value the string of the value to be updated.
+   * @param hitp the pointer to the variable for the hit flag, which is true if the record exists.
+   * @return true on success, or false on failure.
+   */
+  bool combine_operand(const char* kbuf, size_t ksiz, uint8_t kind, const char* obuf, size_t osiz,
+                     std::string* value, bool* hitp) {
+    _assert_(kbuf && ksiz <= MEMMAXSIZ && obuf && osiz <= MEMMAXSIZ && value && hitp);
+    MergeOperator* mop;
+    if (kind == MRGADD) {
+      mop = ADDITIONMERGE;
+    } else if (kind == MRGCONCAT) {
+      mop = CONCATMERGE;
+    } else if (kind == MRGCUSTOM) {
+      mop = mop_;
+      if (!mop) {
+        set_error(_KCCODELINE_, Error::INVALID, "the merge operator is not given");
+        return false;
+      }
+    } else {
+      set_error(_KCCODELINE_, Error::BROKEN, "invalid kind of merge operator");
+      return false;
+    }
+    size_t rsiz;
+    char* rbuf = mop->merge(kbuf, ksiz, *hitp ? value->data() : NULL, *hitp ? value->size() : 0,
+                            obuf, osiz, &rsiz);
+    value->assign(rbuf, rsiz);
+    delete[] rbuf;
+    *hitp = true;
+    return true;
+  }
+  /**
+   * Write the records in memory as a new run if the capacity is exceeded.
+   * @return true on success, or false on failure.
+   */
+  bool flush_auto() {
+    _assert_(true);
+    if (tran_ || memsiz_ < mtcap_) return true;
+    return flush_memtable();
+  }
+  /**
+   * Write the records in memory as a new run.
+   * @return true on success, or false on failure.
+   */
+  bool flush_memtable() {
+    _assert_(true);
+    if (mem_.empty()) return true;
+    report(_KCCODELINE_, Logger::INFO, "flushing the memtable (count=%lld size=%lld)",
+           (long long)mem_.size(), (long long)memsiz_);
+    Run* run = create_run(walid_, mem_.size());
+    if (!run) return false;
+    bool err = false;
+    int64_t mcnt = 0;
+    Memtable::const_iterator it = mem_.begin();
+    Memtable::const_iterator itend = mem_.end();
+    while (it != itend) {
+      const std::string& rec = it->second;
+      if (rec[0] == RECMERGE) {
+        const std::string& key = it->first;
+        std::string value;
+        bool hit;
+        if (!find_run_record(key.data(), key.size(), &value, &hit)) {
+          err = true;
+          break;
+        }
+        if (!hit) mcnt++;
+        if (!fold_operands(key.data(), key.size(), rec.data() + 1, rec.size() - 1,
+                           &value, &hit)) {
+          err = true;
+          break;
+        }
+        value.insert(0, 1, RECLIVE);
+        if (!add_run_record(run, key, value)) {
+          err = true;
+          break;
+        }
+      } else if (!add_run_record(run, it->first, rec)) {
+        err = true;
+        break;
+      }
+      ++it;
+    }
+    if (err || !finish_run(run)) {
+      discard_run(run);
+      return false;
+    }
+    clear_cursor_scans();
+    runs_.push_back(run);
+    walid_ = nextid_++;
+    count_ += mcnt;
+    mrgnum_ = 0;
+    runcount_ = count_;
+    if (!dump_meta()) return false;
+    if (!reset_wal()) return false;
+    mem_.clear();
+    memsiz_ = 0;
+    flushcnt_ += 1;
+    request_compaction();
+    return true;
+  }
+  /**
+   * Begin transaction.
+   * @return true on success, or false on failure.
+   */
+  bool begin_transaction_impl() {
+    _assert_(true);
+    trwalsiz_ = wal_.size();
+    char op = WALBEGIN;
+    if (!wal_.append(&op, sizeof(op))) {
+      set_error(_KCCODELINE_, Error::SYSTEM, wal_.error());
+      return false;
+    }
+    trundo_.clear();
+    trcount_ = count_;
+    trmemsiz_ = memsiz_;
+    trmrgnum_ = mrgnum_;
+    return true;
+  }
+  /**
+   * Commit transaction.
+   * @return true on success, or false on failure.
+   */
+  bool commit_transaction() {
+    _assert_(true);
+    bool err = false;
+    char op = WALCOMMIT;
+    if (!wal_.append(&op, sizeof(op))) {
+      set_error(_KCCODELINE_, Error::SYSTEM, wal_.error());
+      err = true;
+    }
+    if ((trhard_ || autosync_) && !wal_.synchronize(trhard_)) {
+      set_error(_KCCODELINE_, Error::SYSTEM, wal_.error());
+      err = true;
+    }
+    trundo_.clear();
+    return !err;
+  }
+  /**
+   * Abort transaction.
+   * @return true on success, or false on failure.
+   */
+  bool abort_transaction() {
+    _assert_(true);
+    bool err = false;
+    UndoMap::const_iterator it = trundo_.begin();
+    UndoMap::const_iterator itend = trundo_.end();
+    while (it != itend) {
+      if (it->second.empty()) {
+        mem_.erase(it->first);
+      } else {
+        mem_[it->first] = it->second;
+      }
+      ++it;
+    }
+    trundo_.clear();
+    count_ = trcount_;
+    memsiz_ = trmemsiz_;
+    mrgnum_ = trmrgnum_;
+    if (!wal_.truncate(trwalsiz_)) {
+      set_error(_KCCODELINE_, Error::SYSTEM, wal_.error());
+      err = true;
+    }
+    return !err;
+  }
+  /**
+   * Get the number of records.
+   * @return the number of records, or -1 on failure.
+   * @note Records of merge operands whose base value is not in the runs are counted by looking
+   * up the runs.
+   */
+  int64_t count_impl() {
+    _assert_(true);
+    if (mrgnum_ < 1) return count_;
+    int64_t cnt = count_;
+    Memtable::const_iterator it = mem_.begin();
+    Memtable::const_iterator itend = mem_.end();
+    while (it != itend) {
+      if (it->second[0] == RECMERGE) {
+        std::string value;
+        bool hit;
+        if (!find_run_record(it->first.data(), it->first.size(), &value, &hit)) return -1;
+        if (!hit) cnt++;
+      }
+      ++it;
+    }
+    return cnt;
+  }
+  /**
+   * Get the size of the database directory.
+   * @return the size of the database directory in bytes.
+   */
+  int64_t size_impl() {
+    _assert_(true);
+    int64_t size = wal_.size();
+    RunVector::const_iterator it = runs_.begin();
+    RunVector::const_iterator itend = runs_.end();
+    while (it != itend) {
+      size += (*it)->db->size();
+      ++it;
+    }
+    return size;
+  }
+  /**
+   * Get the path of a run file.
+   * @param id the identifier of the run.
+   * @param ext the extension of the file.
+   * @return the path of the file.
+   */
+  std::string run_path(int64_t id, const char* ext) {
+    _assert_(ext);
+    return path_ + File::PATHCHR + strprintf("%010lld", (long long)id) + File::EXTCHR + ext;
+  }
+  /**
+   * Create a new run to be written.
+   * @param id the identifier of the run.
+   * @param cap the expected number of records.
+   * @return the new run object, or NULL on failure.
+   */
+  Run* create_run(int64_t id, int64_t cap) {
+    _assert_(id > 0);
+    TreeDB* db = new TreeDB;
+    tune_run(db);
+    if (!db->open(run_path(id, KCLDBRUNPATHEXT),
+                  TreeDB::OWRITER | TreeDB::OCREATE | TreeDB::OTRUNCATE | TreeDB::ONOLOCK)) {
+      const Error& e = db->error();
+      set_error(_KCCODELINE_, e.code(), e.message());
+      delete db;
+      return NULL;
+    }
+    Run* run = new Run;
+    run->id = id;
+    run->db = db;
+    run->bloom.resize(cap * BLOOMBITS / 8 + 8, '\0');
+    run->count = 0;
+    return run;
+  }
+  /**
+   * Add a record into a run being written.
+   * @param run the run.
+   * @param key the key of the record.
+   * @param value the tagged value of the record.
+   * @return true on success, or false on failure.
+   */
+  bool add_run_record(Run* run, const std::string& key, const std::string& value) {
+    _assert_(run);
+    if (!run->db->set(key, value)) {
+      const Error& e = run->db->error();
+      set_error(_KCCODELINE_, e.code(), e.message());
+      return false;
+    }
+    add_bloom(&run->bloom, key.data(), key.size());
+    run->count++;
+    return true;
+  }
+  /**
+   * Finish writing a run and reopen it as read-only.
+   * @param run the run.
+   * @return true on success, or false on failure.
+   * @note The run file and the Bloom filter file are synchronized with the device, so that the
+   * meta data listing the run can be written safely after this.
+   */
+  bool finish_run(Run* run) {
+    _assert_(run);
+    if (!run->db->close()) {
+      const Error& e = run->db->error();
+      set_error(_KCCODELINE_, e.code(), e.message());
+      return false;
+    }
+    if (!synchronize_file(run_path(run->id, KCLDBRUNPATHEXT))) return false;
+    const std::string& bpath = run_path(run->id, KCLDBBLOOMPATHEXT);
+    if (!write_file_hard(bpath, run->bloom.data(), run->bloom.size())) return false;
+    tune_run(run->db);
+    if (!run->db->open(run_path(run->id, KCLDBRUNPATHEXT), TreeDB::OREADER | TreeDB::ONOLOCK)) {
+      const Error& e = run->db->error();
+      set_error(_KCCODELINE_, e.code(), e.message());
+      return false;
+    }
+    return true;
+  }
+  /**
+   * Close a run and keep its files.
+   * @param run the run.
+   */
+  void close_run(Run* run) {
+    _assert_(run);
+    if (run->db->path().size() > 0) run->db->close();
+    delete run->db;
+    delete run;
+  }
+  /**
+   * Close a run and remove its files.
+   * @param run the run.
+   */
+  void discard_run(Run* run) {
+    _assert_(run);
+    if (run->db->path().size() > 0) run->db->close();
+    delete run->db;
+    File::remove(run_path(run->id, KCLDBRUNPATHEXT));
+    File::remove(run_path(run->id, KCLDBBLOOMPATHEXT));
+    delete run;
+  }
+  /**
+   * Apply the tuning parameters to the database of a run.
+   * @param db the database.
+   */
+  void tune_run(TreeDB* db) {
+    _assert_(db);
+    if (logger_) db->tune_logger(logger_, logkinds_);
+    if (opts_ > 0) db->tune_options(opts_);
+    if (psiz_ > 0) db->tune_page(psiz_);
+    if (pccap_ > 0) db->tune_page_cache(pccap_);
+    if (embcomp_) db->tune_compressor(embcomp_);
+    db->tune_comparator(comp_);
+  }
+  /**
+   * Open the runs listed in the meta data.
+   * @return true on success, or false on failure.
+   */
+  bool open_runs() {
+    _assert_(true);
+    for (size_t i = 0; i < runs_.size(); i++) {
+      Run* run = runs_[i];
+      run->db = new TreeDB;
+      tune_run(run->db);
+      if (!run->db->open(run_path(run->id, KCLDBRUNPATHEXT),
+                         TreeDB::OREADER | TreeDB::ONOLOCK)) {
+        const Error& e = run->db->error();
+        set_error(_KCCODELINE_, e.code(), e.message());
+        return false;
+      }
+      run->count = run->db->count();
+      int64_t bsiz;
+      char* bbuf = File::read_file(run_path(run->id, KCLDBBLOOMPATHEXT), &bsiz);
+      if (bbuf) {
+        run->bloom.assign(bbuf, bsiz);
+        delete[] bbuf;
+      } else {
+        report(_KCCODELINE_, Logger::WARN, "missing Bloom filter (id=%lld)", (long long)run->id);
+      }
+    }
+    return true;
+  }
+  /**
+   * Close all runs.
+   * @param remove true to remove the files of the runs, or false to keep them.
+   * @return true on success, or false on failure.
+   */
+  bool close_runs(bool remove) {
+    _assert_(true);
+    clear_cursor_scans();
+    bool err = false;
+    RunVector::iterator it = runs_.begin();
+    RunVector::iterator itend = runs_.end();
+    while (it != itend) {
+      Run* run = *it;
+      if (run->db) {
+        if (run->db->path().size() > 0 && !run->db->close()) {
+          const Error& e = run->db->error();
+          set_error(_KCCODELINE_, e.code(), e.message());
+          err = true;
+        }
+        delete run->db;
+      }
+      if (remove) {
+        File::remove(run_path(run->id, KCLDBRUNPATHEXT));
+        File::remove(run_path(run->id, KCLDBBLOOMPATHEXT));
+      }
+      delete run;
+      ++it;
+    }
+    runs_.clear();
+    return !err;
+  }
+  /**
+   * Remove files which do not belong to the database.
+   * @param runs the runs to be kept, or NULL to remove every file except for the WAL file.
+   * @return true on success, or false on failure.
+   */
+  bool remove_files(const RunVector* runs) {
+    _assert_(true);
+    std::set<std::string> names;
+    names.insert(KCLDBWALFILE);
+    if (runs) {
+      names.insert(KCLDBMETAFILE);
+      RunVector::const_iterator it = runs->begin();
+      RunVector::const_iterator itend = runs->end();
+      while (it != itend) {
+        const std::string& base = strprintf("%010lld", (long long)(*it)->id) + File::EXTCHR;
+        names.insert(base + KCLDBRUNPATHEXT);
+        names.insert(base + KCLDBBLOOMPATHEXT);
+        ++it;
+      }
+    }
+    std::vector<std::string> files;
+    if (!File::read_directory(path_, &files)) {
+      set_error(_KCCODELINE_, Error::SYSTEM, "reading a directory failed");
+      return false;
+    }
+    bool err = false;
+    std::vector<std::string>::iterator it = files.begin();
+    std::vector<std::string>::iterator itend = files.end();
+    while (it != itend) {
+      if (names.find(*it) == names.end()) {
+        const std::string& fpath = path_ + File::PATHCHR + *it;
+        if (runs) report(_KCCODELINE_, Logger::WARN, "removing a garbage file: %s", it->c_str());
+        if (!File::remove(fpath)) {
+          set_error(_KCCODELINE_, Error::SYSTEM, "removing a file failed");
+          err = true;
+        }
+      }
+      ++it;
+    }
+    return !err;
+  }
+  /**
+   * Dump the meta data into the file.
+   * @return true on success, or false on failure.
+   * @note The file is replaced atomically and synchronized with the device together with the
+   * directory, so the WAL file can be truncated safely after this.
+   */
+  bool dump_meta() {
+    _assert_(true);
+    size_t msiz = METAHEADSIZ + runs_.size() * sizeof(uint64_t);
+    char* mbuf = new char[msiz];
+    std::memset(mbuf, 0, METAHEADSIZ);
+    std::memcpy(mbuf, KCLDBMAGICDATA, sizeof(KCLDBMAGICDATA) - 1);
+    char* wp = mbuf + sizeof(uint64_t);
+    if (comp_ == LEXICALCOMP) {
+      *(uint8_t*)wp = 0x10;
+    } else if (comp_ == DECIMALCOMP) {
+      *(uint8_t*)wp = 0x11;
+    } else if (comp_ == LEXICALDESCCOMP) {
+      *(uint8_t*)wp = 0x18;
+    } else if (comp_ == DECIMALDESCCOMP) {
+      *(uint8_t*)wp = 0x19;
+    } else {
+      *(uint8_t*)wp = 0xff;
+    }
+    wp += sizeof(uint64_t);
+    writefixnum(wp, runcount_, sizeof(uint64_t));
+    wp += sizeof(uint64_t);
+    writefixnum(wp, walid_, sizeof(uint64_t));
+    wp += sizeof(uint64_t);
+    writefixnum(wp, nextid_, sizeof(uint64_t));
+    wp += sizeof(uint64_t);
+    writefixnum(wp, runs_.size(), sizeof(uint64_t));
+    wp += sizeof(uint64_t);
+    RunVector::const_iterator it = runs_.begin();
+    RunVector::const_iterator itend = runs_.end();
+    while (it != itend) {
+      writefixnum(wp, (*it)->id, sizeof(uint64_t));
+      wp += sizeof(uint64_t);
+      ++it;
+    }
+    const std::string& mpath = path_ + File::PATHCHR + KCLDBMETAFILE;
+    const std::string& tpath = mpath + File::EXTCHR + KCLDBTMPPATHEXT;
+    bool err = false;
+    if (!write_file_hard(tpath, mbuf, msiz)) {
+      err = true;
+    } else if (!File::rename(tpath, mpath)) {
+      set_error(_KCCODELINE_, Error::SYSTEM, "renaming a file failed");
+      err = true;
+    } else if (!File::synchronize_directory(path_)) {
+      set_error(_KCCODELINE_, Error::SYSTEM, "synchronizing the directory failed");
+      err = true;
+    }
+    delete[] mbuf;
+    return !err;
+  }
+  /**
+   * Write a file and synchronize it with the device.
+   * @param path the path of the file.
+   * @param buf the pointer to the data region.
+   * @param size the size of the data region.
+   * @return true on success, or false on failure.
+   */
+  bool write_file_hard(const std::string& path, const char* buf, int64_t size) {
+    _assert_(buf && size >= 0);
+    File file;
+    if (!file.open(path, File::OWRITER | File::OCREATE | File::OTRUNCATE | File::ONOLOCK)) {
+      set_error(_KCCODELINE_, Error::SYSTEM, file.error());
+      return false;
+    }
+    bool err = false;
+    if (!file.write(0, buf, size) || !file.synchronize(true)) {
+      set_error(_KCCODELINE_, Error::SYSTEM, file.error());
+      err = true;
+    }
+    if (!file.close()) {
+      set_error(_KCCODELINE_, Error::SYSTEM, file.error());
+      err = true;
+    }
+    return !err;
+  }
+  /**
+   * Synchronize a closed file with the device.
+   * @param path the path of the file.
+   * @return true on success, or false on failure.
+   */
+  bool synchronize_file(const std::string& path) {
+    _assert_(true);
+    File file;
+    if (!file.open(path, File::OWRITER | File::ONOLOCK)) {
+      set_error(_KCCODELINE_, Error::SYSTEM, file.error());
+      return false;
+    }
+    bool err = false;
+    if (!file.synchronize(true)) {
+      set_error(_KCCODELINE_, Error::SYSTEM, file.error());
+      err = true;
+    }
+    if (!file.close()) {
+      set_error(_KCCODELINE_, Error::SYSTEM, file.error());
+      err = true;
+    }
+    return !err;
+  }
+  /**
+   * Load the meta data from the file.
+   * @return true on success, or false on failure.
+   */
+  bool load_meta() {
+    _assert_(true);
+    int64_t msiz;
+    char* mbuf = File::read_file(path_ + File::PATHCHR + KCLDBMETAFILE, &msiz);
+    if (!mbuf) {
+      set_error(_KCCODELINE_, Error::SYSTEM, "reading a file failed");
+      return false;
+    }
+    if (msiz < METAHEADSIZ ||
+        std::memcmp(mbuf, KCLDBMAGICDATA, sizeof(KCLDBMAGICDATA) - 1)) {
+      set_error(_KCCODELINE_, Error::BROKEN, "invalid meta data");
+      delete[] mbuf;
+      return false;
+    }
+    const char* rp = mbuf + sizeof(uint64_t);
+    uint8_t code = *(uint8_t*)rp;
+    if (code == 0x10) {
+      comp_ = LEXICALCOMP;
+    } else if (code == 0x11) {
+      comp_ = DECIMALCOMP;
+    } else if (code == 0x18) {
+      comp_ = LEXICALDESCCOMP;
+    } else if (code == 0x19) {
+      comp_ = DECIMALDESCCOMP;
+    } else if (code != 0xff) {
+      set_error(_KCCODELINE_, Error::BROKEN, "comparator is invalid");
+      delete[] mbuf;
+      return false;
+    } else if (!comp_) {
+      set_error(_KCCODELINE_, Error::INVALID, "the custom comparator is not given");
+      delete[] mbuf;
+      return false;
+    }
+    rp += sizeof(uint64_t);
+    runcount_ = readfixnum(rp, sizeof(uint64_t));
+    rp += sizeof(uint64_t);
+    walid_ = readfixnum(rp, sizeof(uint64_t));
+    rp += sizeof(uint64_t);
+    nextid_ = readfixnum(rp, sizeof(uint64_t));
+    rp += sizeof(uint64_t);
+    int64_t rnum = readfixnum(rp, sizeof(uint64_t));
+    rp += sizeof(uint64_t);
+    if (rnum < 0 || msiz != METAHEADSIZ + rnum * (int64_t)sizeof(uint64_t)) {
+      set_error(_KCCODELINE_, Error::BROKEN, "invalid meta data");
+      delete[] mbuf;
+      return false;
+    }
+    for (int64_t i = 0; i < rnum; i++) {
+      Run* run = new Run;
+      run->id = readfixnum(rp, sizeof(uint64_t));
+      run->db = NULL;
+      run->count = 0;
+      runs_.push_back(run);
+      rp += sizeof(uint64_t);
+    }
+    delete[] mbuf;
+    return true;
+  }
+  /**
+   * Truncate the WAL file and write the header for the current identifier.
+   * @return true on success, or false on failure.
+   */
+  bool reset_wal() {
+    _assert_(true);
+    char head[WALHEADSIZ];
+    std::memset(head, 0, sizeof(head));
+    std::memcpy(head, KCLDBWALMAGICDATA, sizeof(KCLDBWALMAGICDATA) - 1);
+    writefixnum(head + sizeof(uint64_t), walid_, sizeof(uint64_t));
+    if (!wal_.truncate(0) || !wal_.write(0, head, sizeof(head))) {
+      set_error(_KCCODELINE_, Error::SYSTEM, wal_.error());
+      return false;
+    }
+    return true;
+  }
+  /**
+   * Reset the table in memory with the current comparator.
+   */
+  void reset_memtable() {
+    _assert_(true);
+    Memtable mem((MemtableComparator(comp_)));
+    mem_.swap(mem);
+    memsiz_ = 0;
+    mrgnum_ = 0;
+  }
+  /**
+   * Replay the WAL file into the table in memory.
+   * @return true on success, or false on failure.
+   * @note Records of an unfinished transaction and a broken tail are discarded.
+   */
+  bool load_wal() {
+    _assert_(true);
+    int64_t wsiz = wal_.size();
+    char head[WALHEADSIZ];
+    if (wsiz < (int64_t)sizeof(head) || !wal_.read(0, head, sizeof(head)) ||
+        std::memcmp(head, KCLDBWALMAGICDATA, sizeof(KCLDBWALMAGICDATA) - 1) ||
+        (int64_t)readfixnum(head + sizeof(uint64_t), sizeof(uint64_t)) != walid_) {
+      if (wsiz > 0) report(_KCCODELINE_, Logger::INFO, "discarding a stale WAL file");
+      return writer_ ? reset_wal() : true;
+    }
+    wsiz -= sizeof(head);
+    char* wbuf = new char[wsiz+1];
+    if (!wal_.read(sizeof(head), wbuf, wsiz)) {
+      set_error(_KCCODELINE_, Error::SYSTEM, wal_.error());
+      delete[] wbuf;
+      return false;
+    }
+    std::vector<const char*> trrecs;
+    bool intran = false;
+    const char* rp = wbuf;
+    const char* ep = wbuf + wsiz;
+    const char* good = rp;
+    while (rp < ep) {
+      uint8_t op = *(uint8_t*)rp;
+      if (op == WALBEGIN) {
+        trrecs.clear();
+        intran = true;
+        rp++;
+        continue;
+      }
+      if (op == WALCOMMIT) {
+        std::vector<const char*>::iterator it = trrecs.begin();
+        std::vector<const char*>::iterator itend = trrecs.end();
+        while (it != itend) {
+          if (!replay_record(*it, ep)) {
+            delete[] wbuf;
+            return false;
+          }
+          ++it;
+        }
+        trrecs.clear();
+        intran = false;
+        rp++;
+        good = rp;
+        continue;
+      }
+      size_t rsiz = replay_size(rp, ep);
+      if (rsiz < 1) break;
+      if (intran) {
+        trrecs.push_back(rp);
+      } else if (!replay_record(rp, ep)) {
+        delete[] wbuf;
+        return false;
+      }
+      rp += rsiz;
+      if (!intran) good = rp;
+    }
+    bool err = false;
+    if (good < ep) {
+      recov_ = true;
+      report(_KCCODELINE_, Logger::WARN, "discarding the broken tail of the WAL file (%lld)",
+             (long long)(ep - good));
+      if (writer_ && !wal_.truncate(sizeof(head) + (good - wbuf))) {
+        set_error(_KCCODELINE_, Error::SYSTEM, wal_.error());
+        err = true;
+      }
+    }
+    delete[] wbuf;
+    return !err;
+  }
+  /**
+   * Get the size of a record in the WAL file.
+   * @param rp the pointer to the record.
+   * @param ep the pointer to the end of the region.
+   * @return the size of the record, or 0 if the record is broken.
+   */
+  size_t replay_size(const char* rp, const char* ep) {
+    _assert_(rp && ep);
+    uint8_t op = *(uint8_t*)rp;
+    if (op != WALADD && op != WALREPLACE && op != WALREMOVE && op != WALMERGE) return 0;
+    const char* bp = rp++;
+    uint64_t ksiz, vsiz;
+    size_t step = readvarnum(rp, ep - rp, &ksiz);
+    if (step < 1) return 0;
+    rp += step;
+    step = readvarnum(rp, ep - rp, &vsiz);
+    if (step < 1) return 0;
+    rp += step;
+    if ((uint64_t)(ep - rp) < ksiz + vsiz) return 0;
+    if (op == WALMERGE && vsiz < 1) return 0;
+    return rp - bp + ksiz + vsiz;
+  }
+  /**
+   * Apply a record in the WAL file to the table in memory.
+   * @param rp the pointer to the record.
+   * @param ep the pointer to the end of the region.
+   * @return true on success, or false on failure.
+   */
+  bool replay_record(const char* rp, const char* ep) {
+    _assert_(rp && ep);
+    uint8_t op = *(uint8_t*)(rp++);
+    uint64_t ksiz, vsiz;
+    rp += readvarnum(rp, ep - rp, &ksiz);
+    rp += readvarnum(rp, ep - rp, &vsiz);
+    return apply_record(rp, ksiz, rp + ksiz, vsiz, op);
+  }
+  /**
+   * Request the background thread to check the runs.
+   */
+  void request_compaction() {
+    _assert_(true);
+    cmpmutex_.lock();
+    cmpreq_ = true;
+    cmpcond_.signal();
+    cmpmutex_.unlock();
+  }
+  /**
+   * Stop the background thread.
+   */
+  void stop_compactor() {
+    _assert_(true);
+    if (!compactor_) return;
+    cmpmutex_.lock();
+    cmpstop_ = true;
+    cmpcond_.signal();
+    cmpmutex_.unlock();
+    compactor_->join();
+    delete compactor_;
+    compactor_ = NULL;
+  }
+  /**
+   * Check whether the background thread is being stopped.
+   * @return true if it is being stopped, or false if not.
+   */
+  bool compaction_stopped() {
+    _assert_(true);
+    ScopedMutex lock(&cmpmutex_);
+    return cmpstop_;
+  }
+  /**
+   * Perform the loop of the background thread.
+   */
+  void compact_loop() {
+    _assert_(true);
+    cmpmutex_.lock();
+    while (!cmpstop_) {
+      if (!cmpreq_) {
+        cmpcond_.wait(&cmpmutex_, 1.0);
+        continue;
+      }
+      cmpreq_ = false;
+      cmpmutex_.unlock();
+      bool done = true;
+      while (done) {
+        if (!compact_runs(&done)) {
+          const Error& e = error();
+          report(_KCCODELINE_, Logger::ERROR, "compaction failed: %s: %s",
+                 e.name(), e.message());
+          break;
+        }
+      }
+      cmpmutex_.lock();
+    }
+    cmpmutex_.unlock();
+  }
+  /**
+   * Merge adjacent runs of similar size.
+   * @param donep the pointer to the variable to indicate whether runs were merged.
+   * @return true on success, or false on failure.
+   * @note The newest runs are gathered while the preceding run is not larger than the sum of
+   * them, so that each record is rewritten logarithmic times.  Removal marks are dropped only
+   * when the oldest run is merged.
+   */
+  bool compact_runs(bool* donep) {
+    _assert_(donep);
+    *donep = false;
+    ScopedMutex clock(&cmplock_);
+    mlock_.lock_writer();
+    if (omode_ == 0 || !writer_) {
+      mlock_.unlock();
+      return true;
+    }
+    size_t rnum = runs_.size();
+    if (rnum < (size_t)cmpnum_) {
+      mlock_.unlock();
+      return true;
+    }
+    size_t beg = rnum - 1;
+    int64_t sum = runs_[beg]->count;
+    while (beg > 0 && runs_[beg-1]->count <= sum) {
+      beg--;
+      sum += runs_[beg]->count;
+    }
+    if (rnum - beg < 2) {
+      if (rnum < (size_t)cmpnum_ * 2) {
+        mlock_.unlock();
+        return true;
+      }
+      while (beg > 0) {
+        beg--;
+        sum += runs_[beg]->count;
+      }
+    }
+    RunVector srcs(runs_.begin() + beg, runs_.end());
+    int64_t id = nextid_++;
+    bool droptomb = beg == 0;
+    mlock_.unlock();
+    report(_KCCODELINE_, Logger::INFO, "merging %lld runs (count=%lld)",
+           (long long)srcs.size(), (long long)sum);
+    Run* run = create_run(id, sum);
+    if (!run) return false;
+    size_t snum = srcs.size();
+    std::vector<TreeDB::Cursor*> curs(snum);
+    std::vector<std::string> keys(snum), values(snum);
+    std::vector<bool> lives(snum);
+    bool err = false;
+    for (size_t i = 0; i < snum; i++) {
+      curs[i] = srcs[i]->db->cursor();
+      lives[i] = curs[i]->jump() && curs[i]->get(&keys[i], &values[i], true);
+      if (!lives[i] && curs[i]->error() != Error::NOREC) err = true;
+    }
+    int64_t cnt = 0;
+    while (!err) {
+      int64_t mi = -1;
+      for (int64_t i = snum - 1; i >= 0; i--) {
+        if (!lives[i]) continue;
+        if (mi < 0 || comp_->compare(keys[i].data(), keys[i].size(),
+                                     keys[mi].data(), keys[mi].size()) < 0) mi = i;
+      }
+      if (mi < 0) break;
+      const std::string key = keys[mi];
+      if (!droptomb || (!values[mi].empty() && values[mi][0] == RECLIVE)) {
+        if (!add_run_record(run, key, values[mi])) {
+          err = true;
+          break;
+        }
+      }
+      for (size_t i = 0; i < snum; i++) {
+        if (!lives[i] || comp_->compare(keys[i].data(), keys[i].size(),
+                                        key.data(), key.size()) != 0) continue;
+        lives[i] = curs[i]->get(&keys[i], &values[i], true);
+        if (!lives[i] && curs[i]->error() != Error::NOREC) err = true;
+      }
+      if (++cnt % CMPCHECKFREQ == 0 && compaction_stopped()) {
+        discard_run(run);
+        for (size_t i = 0; i < snum; i++) {
+          delete curs[i];
+        }
+        return true;
+      }
+    }
+    for (size_t i = 0; i < snum; i++) {
+      if (err && curs[i]->error() != Error::NOREC) {
+        const Error& e = curs[i]->error();
+        set_error(_KCCODELINE_, e.code(), e.message());
+      }
+      delete curs[i];
+    }
+    if (err || !finish_run(run)) {
+      discard_run(run);
+      return false;
+    }
+    mlock_.lock_writer();
+    clear_cursor_scans();
+    RunVector::iterator it = runs_.begin() + beg;
+    runs_.erase(it, it + snum);
+    if (run->count > 0) runs_.insert(runs_.begin() + beg, run);
+    if (!dump_meta()) err = true;
+    cmpcnt_ += 1;
+    mlock_.unlock();
+    if (run->count < 1) discard_run(run);
+    for (size_t i = 0; i < snum; i++) {
+      if (err) {
+        close_run(srcs[i]);
+      } else {
+        discard_run(srcs[i]);
+      }
+    }
+    *donep = !err;
+    return !err;
+  }
+  /**
+   * Add a key into a Bloom filter.
+   * @param bloom the bit array of the Bloom filter.
+   * @param kbuf the pointer to the key region.
+   * @param ksiz the size of the key region.
+   */
+  static void add_bloom(std::string* bloom, const char* kbuf, size_t ksiz) {
+    _assert_(bloom && kbuf && ksiz <= MEMMAXSIZ);
+    uint64_t bnum = bloom->size() * 8;
+    uint64_t hash = hashmurmur(kbuf, ksiz);
+    uint64_t delta = hashfnv(kbuf, ksiz) | 1;
+    for (int32_t i = 0; i < BLOOMHASHNUM; i++) {
+      uint64_t bit = hash % bnum;
+      (*bloom)[bit>>3] |= (char)(1 << (bit & 7));
+      hash += delta;
+    }
+  }
+  /**
+   * Check whether a key may be contained in a Bloom filter.
+   * @param bloom the bit array of the Bloom filter.
+   * @param kbuf the pointer to the key region.
+   * @param ksiz the size of the key region.
+   * @return true if the key may be contained, or false if it is not contained certainly.
+   */
+  static bool check_bloom(const std::string& bloom, const char* kbuf, size_t ksiz) {
+    _assert_(kbuf && ksiz <= MEMMAXSIZ);
+    if (bloom.empty()) return true;
+    uint64_t bnum = bloom.size() * 8;
+    uint64_t hash = hashmurmur(kbuf, ksiz);
+    uint64_t delta = hashfnv(kbuf, ksiz) | 1;
+    for (int32_t i = 0; i < BLOOMHASHNUM; i++) {
+      uint64_t bit = hash % bnum;
+      if (!(bloom[bit>>3] & (1 << (bit & 7)))) return false;
+      hash += delta;
+    }
+    return true;
+  }
+  /** Dummy constructor to forbid the use. */
+  LogTreeDB(const LogTreeDB&);
+  /** Dummy Operator to forbid the use. */
+  LogTreeDB& operator =(const LogTreeDB&);
+  /** The method lock. */
+  RWLock mlock_;
+  /** The lock for compaction. */
+  Mutex cmplock_;
+  /** The mutex for the background thread. */
+  Mutex cmpmutex_;
+  /** The condition variable for the background thread. */
+  CondVar cmpcond_;
+  /** The last happened error. */
+  TSD<Error> error_;
+  /** The internal logger. */
+  Logger* logger_;
+  /** The kinds of logged messages. */
+  uint32_t logkinds_;
+  /** The internal meta operation trigger. */
+  MetaTrigger* mtrigger_;
+  /** The open mode. */
+  uint32_t omode_;
+  /** The flag for writer. */
+  bool writer_;
+  /** The flag for auto synchronization. */
+  bool autosync_;
+  /** The flag for recovered. */
+  bool recov_;
+  /** The WAL file. */
+  File wal_;
+  /** The path of the database directory. */
+  std::string path_;
+  /** The record comparator. */
+  Comparator* comp_;
+  /** The options of the runs. */
+  uint8_t opts_;
+  /** The page size of the runs. */
+  int32_t psiz_;
+  /** The capacity of the page cache of each run. */
+  int64_t pccap_;
+  /** The data compressor of the runs. */
+  Compressor* embcomp_;
+  /** The capacity of the table in memory. */
+  int64_t mtcap_;
+  /** The number of runs to trigger compaction. */
+  int32_t cmpnum_;
+  /** The table in memory. */
+  Memtable mem_;
+  /** The total size of the table in memory. */
+  int64_t memsiz_;
+  /** The runs from the oldest to the newest. */
+  RunVector runs_;
+  /** The cursor objects. */
+  CursorList curs_;
+  /** The record number. */
+  int64_t count_;
+  /** The record number at the last flush. */
+  int64_t runcount_;
+  /** The identifier of the run to which the WAL file belongs. */
+  int64_t walid_;
+  /** The next identifier of runs. */
+  int64_t nextid_;
+  /** The registered merge operator. */
+  MergeOperator* mop_;
+  /** The number of records of merge operands in memory. */
+  int64_t mrgnum_;
+  /** The flag whether in transaction. */
+  bool tran_;
+  /** The flag whether hard transaction. */
+  bool trhard_;
+  /** The records in memory before transaction. */
+  UndoMap trundo_;
+  /** The record number before transaction. */
+  int64_t trcount_;
+  /** The size of the table in memory before transaction. */
+  int64_t trmemsiz_;
+  /** The number of records of merge operands before transaction. */
+  int64_t trmrgnum_;
+  /** The size of the WAL file before transaction. */
+  int64_t trwalsiz_;
+  /** The background thread. */
+  Compactor* compactor_;
+  /** The flag whether compaction is requested. */
+  bool cmpreq_;
+  /** The flag whether the background thread is being stopped. */
+  bool cmpstop_;
+  /** The number of flushes. */
+  AtomicInt64 flushcnt_;
+  /** The number of compactions. */
+  AtomicInt64 cmpcnt_;
+  /** The number of lookups skipped by Bloom filters. */
+  AtomicInt64 bloomskip_;
+  /** The number of merge operands logged without reading. */
+  AtomicInt64 mrgcnt_;
+  /** The number of foldings of merge operands. */
+  AtomicInt64 mrgfold_;
+};
+
+
+}                                        // common namespace
+
+#endif                                   // duplication check
+
+// END OF FILE
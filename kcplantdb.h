@@ -60,7 +60,10 @@ class PlantDB : public BasicDB {
   struct InnerNode;
   struct LeafSlot;
   struct InnerSlot;
+  struct WriteBufferComparator;
+  struct TranMeta;
   class ScopedVisitor;
+  class WriteBufferVisitor;
   /** An alias of array of records. */
   typedef std::vector<Record*> RecordArray;
   /** An alias of array of records. */
@@ -71,6 +74,8 @@ class PlantDB : public BasicDB {
   typedef LinkedHashMap<int64_t, InnerNode*> InnerCache;
   /** An alias of list of cursors. */
   typedef std::list<Cursor*> CursorList;
+  /** An alias of write buffer. */
+  typedef std::map<std::string, std::string, WriteBufferComparator> WriteBuffer;
   /** The number of cache slots. */
   static const int32_t SLOTNUM = 16;
   /** The default alignment power. */
@@ -111,6 +116,40 @@ class PlantDB : public BasicDB {
   static const int32_t ATRANCNUM = 256;
   /** The threshold of busy loop and sleep for locking. */
   static const uint32_t LOCKBUSYLOOP = 8192;
+  /** The flag of a buffered record which is alive. */
+  static const uint8_t WBLIVE = 1 << 0;
+  /** The flag of a buffered record which exists in the tree. */
+  static const uint8_t WBORIG = 1 << 1;
+  /** The default number of sampled leaf nodes of analysis. */
+  static const int64_t ANASMPNUM = 1024;
+  /** The minimum number of records in each leaf node recommended by analysis. */
+  static const int32_t ANAMINLREC = 16;
+  /** The number of records in each leaf node aimed by analysis. */
+  static const int32_t ANALREC = 64;
+  /** The maximum number of records in each leaf node recommended by analysis. */
+  static const int32_t ANAMAXLREC = 512;
+  /** The minimum page size recommended by analysis. */
+  static const int32_t ANAMINPSIZ = 1024;
+  /** The maximum page size recommended by analysis. */
+  static const int32_t ANAMAXPSIZ = 1 << 20;
+  /** The minimum bucket number recommended by analysis. */
+  static const int64_t ANAMINBNUM = 1024;
+  /** The percentage of fragments per page worth caring about in analysis. */
+  static const int32_t ANAFRAGLOW = 5;
+  /** The unit of auto defragmentation recommended by analysis. */
+  static const int64_t ANADFUNIT = 8;
+  /** The unit of the cache and the memory-mapped region recommended by analysis. */
+  static const int64_t ANAMAPUNIT = 1LL << 20;
+  /** Indices of the counters of the metrics. */
+  enum MetricsCounter {
+    MCHIT,                               ///< records found
+    MCMISS,                              ///< records not found
+    MCLCHIT,                             ///< leaf nodes found in the cache
+    MCLCMISS,                            ///< leaf nodes loaded from the database
+    MCICHIT,                             ///< inner nodes found in the cache
+    MCICMISS,                            ///< inner nodes loaded from the database
+    MCNUM                                ///< number of counters
+  };
  public:
   /**
    * Cursor to indicate a record.
@@ -149,7 +188,12 @@ class PlantDB : public BasicDB {
      */
     bool accept(Visitor* visitor, bool writable = true, bool step = false) {
       _assert_(visitor);
-      db_->mlock_.lock_reader();
+      bool wlock = writable && db_->wbcap_ > 0;
+      if (wlock) {
+        db_->mlock_.lock_writer();
+      } else {
+        db_->mlock_.lock_reader();
+      }
       if (db_->omode_ == 0) {
         db_->set_error(_KCCODELINE_, Error::INVALID, "not opened");
         db_->mlock_.unlock();
@@ -165,14 +209,25 @@ class PlantDB : public BasicDB {
         db_->mlock_.unlock();
         return false;
       }
+      if (writable && db_->tran_ && !db_->fix_transaction_base()) {
+        db_->mlock_.unlock();
+        return false;
+      }
+      if (!settle_current(&wlock)) {
+        db_->mlock_.unlock();
+        return false;
+      }
+      std::string okey;
+      if (step && db_->wbcap_ > 0) okey.assign(kbuf_, ksiz_);
       bool err = false;
       bool hit = false;
       if (lid_ > 0 && !accept_spec(visitor, writable, step, &hit)) err = true;
       if (!err && !hit) {
-        if (!db_->mlock_.promote()) {
+        if (!wlock && !db_->mlock_.promote()) {
           db_->mlock_.unlock();
           db_->mlock_.lock_writer();
         }
+        wlock = true;
         if (kbuf_) {
           bool retry = true;
           while (!err && retry) {
@@ -183,6 +238,10 @@ class PlantDB : public BasicDB {
           err = true;
         }
       }
+      if (step && db_->wbcap_ > 0) {
+        if (err && !kbuf_ && db_->error() == Error::NOREC) err = false;
+        if (!err && !settle_step(okey, true, &wlock)) err = true;
+      }
       db_->mlock_.unlock();
       return !err;
     }
@@ -197,6 +256,7 @@ class PlantDB : public BasicDB {
         db_->set_error(_KCCODELINE_, Error::INVALID, "not opened");
         return false;
       }
+      if (!db_->settle_write_buffer()) return false;
       if (kbuf_) clear_position();
       bool err = false;
       if (!set_position(db_->first_)) err = true;
@@ -215,6 +275,7 @@ class PlantDB : public BasicDB {
         db_->set_error(_KCCODELINE_, Error::INVALID, "not opened");
         return false;
       }
+      if (!db_->settle_write_buffer()) return false;
       if (kbuf_) clear_position();
       set_position(kbuf, ksiz, 0);
       bool err = false;
@@ -245,6 +306,7 @@ class PlantDB : public BasicDB {
         db_->set_error(_KCCODELINE_, Error::INVALID, "not opened");
         return false;
       }
+      if (!db_->settle_write_buffer()) return false;
       if (kbuf_) clear_position();
       bool err = false;
       if (!set_position_back(db_->last_)) err = true;
@@ -263,6 +325,7 @@ class PlantDB : public BasicDB {
         db_->set_error(_KCCODELINE_, Error::INVALID, "not opened");
         return false;
       }
+      if (!db_->settle_write_buffer()) return false;
       if (kbuf_) clear_position();
       set_position(kbuf, ksiz, 0);
       bool err = false;
@@ -318,6 +381,7 @@ class PlantDB : public BasicDB {
      */
     bool step_back() {
       _assert_(true);
+      bool wlock = false;
       db_->mlock_.lock_reader();
       if (db_->omode_ == 0) {
         db_->set_error(_KCCODELINE_, Error::INVALID, "not opened");
@@ -329,6 +393,8 @@ class PlantDB : public BasicDB {
         db_->mlock_.unlock();
         return false;
       }
+      std::string okey;
+      if (db_->wbcap_ > 0) okey.assign(kbuf_, ksiz_);
       bool err = false;
       bool hit = false;
       if (lid_ > 0 && !back_position_spec(&hit)) err = true;
@@ -337,6 +403,7 @@ class PlantDB : public BasicDB {
           db_->mlock_.unlock();
           db_->mlock_.lock_writer();
         }
+        wlock = true;
         if (kbuf_) {
           if (!back_position_atom()) err = true;
         } else {
@@ -344,6 +411,14 @@ class PlantDB : public BasicDB {
           err = true;
         }
       }
+      if (db_->wbcap_ > 0) {
+        if (err && !kbuf_ && db_->error() == Error::NOREC) err = false;
+        if (!err && !settle_step(okey, false, &wlock)) err = true;
+        if (!err && !kbuf_) {
+          db_->set_error(_KCCODELINE_, Error::NOREC, "no record");
+          err = true;
+        }
+      }
       db_->mlock_.unlock();
       return !err;
     }
@@ -500,6 +575,7 @@ class PlantDB : public BasicDB {
               const char* vbuf = visitor->visit_full(kbuf, ksiz, kbuf + ksiz,
                                                      rec->vsiz, &vsiz);
               if (vbuf == Visitor::REMOVE) {
+                db_->touch_leaf_node(node);
                 rsiz = sizeof(*rec) + rec->ksiz + rec->vsiz;
                 db_->count_ -= 1;
                 db_->cusage_ -= rsiz;
@@ -522,6 +598,7 @@ class PlantDB : public BasicDB {
                 }
                 recs.erase(rit);
               } else if (vbuf != Visitor::NOP) {
+                db_->touch_leaf_node(node);
                 int64_t diff = (int64_t)vsiz - (int64_t)rec->vsiz;
                 db_->cusage_ += diff;
                 node->size += diff;
@@ -561,11 +638,11 @@ class PlantDB : public BasicDB {
           set_position(node->next);
         }
         if (hit) {
-          bool flush = db_->cusage_ > db_->pccap_;
+          bool flush = db_->cache_overflow();
           if (link || flush || async) {
             int64_t id = node->id;
             if (atran && !link && !db_->fix_auto_transaction_leaf(node)) err = true;
-            if (!db_->mlock_.promote()) {
+            if (db_->wbcap_ < 1 && !db_->mlock_.promote()) {
               db_->mlock_.unlock();
               db_->mlock_.lock_writer();
             }
@@ -676,6 +753,7 @@ class PlantDB : public BasicDB {
         const char* vbuf = visitor->visit_full(kbuf, ksiz, kbuf + ksiz,
                                                rec->vsiz, &vsiz);
         if (vbuf == Visitor::REMOVE) {
+          db_->touch_leaf_node(node);
           rsiz = sizeof(*rec) + rec->ksiz + rec->vsiz;
           db_->count_ -= 1;
           db_->cusage_ -= rsiz;
@@ -691,6 +769,7 @@ class PlantDB : public BasicDB {
           recs.erase(rit);
           if (recs.empty()) reorg = true;
         } else if (vbuf != Visitor::NOP) {
+          db_->touch_leaf_node(node);
           int64_t diff = (int64_t)vsiz - (int64_t)rec->vsiz;
           db_->cusage_ += diff;
           node->size += diff;
@@ -720,7 +799,7 @@ class PlantDB : public BasicDB {
         if (reorg) {
           if (!db_->reorganize_tree(node, hist, hnum)) err = true;
           if (atran && !db_->fix_auto_transaction_tree()) err = true;
-        } else if (db_->cusage_ > db_->pccap_) {
+        } else if (db_->cache_overflow()) {
           int32_t idx = node->id % SLOTNUM;
           LeafSlot* lslot = db_->lslots_ + idx;
           if (!db_->flush_leaf_cache_part(lslot)) err = true;
@@ -900,6 +979,84 @@ class PlantDB : public BasicDB {
       if (lbuf != lstack) delete[] lbuf;
       return !err;
     }
+    /**
+     * Reflect the write buffer in the tree if it has the current record.
+     * @param wlockp the pointer to the variable for the flag whether the method lock is held
+     * as a writer.  The lock is promoted if necessary.
+     * @return true on success, or false on failure.
+     */
+    bool settle_current(bool* wlockp) {
+      _assert_(wlockp);
+      if (db_->wbcap_ < 1 || !kbuf_) return true;
+      {
+        ScopedSpinRWLock lock(&db_->wblock_, false);
+        if (db_->wbuf_.find(std::string(kbuf_, ksiz_)) == db_->wbuf_.end()) return true;
+      }
+      return flush_write_buffer(wlockp);
+    }
+    /**
+     * Reposition the cursor if a step passed over a record in the write buffer.
+     * @param okey the key of the record before the step.
+     * @param fwd true for a forward step, or false for a backward step.
+     * @param wlockp the pointer to the variable for the flag whether the method lock is held
+     * as a writer.  The lock is promoted if necessary.
+     * @return true on success, or false on failure.
+     * @note The buffer is reflected and the cursor moves to the nearest record from the first
+     * buffered key after the former position, only if the key is not beyond the new position.
+     */
+    bool settle_step(const std::string& okey, bool fwd, bool* wlockp) {
+      _assert_(wlockp);
+      if (db_->wbcap_ < 1) return true;
+      std::string bkey;
+      {
+        ScopedSpinRWLock lock(&db_->wblock_, false);
+        const WriteBuffer& wbuf = db_->wbuf_;
+        typename WriteBuffer::const_iterator it;
+        if (fwd) {
+          it = wbuf.upper_bound(okey);
+          if (it == wbuf.end()) return true;
+        } else {
+          it = wbuf.lower_bound(okey);
+          if (it == wbuf.begin()) return true;
+          --it;
+        }
+        if (kbuf_) {
+          int32_t cmp = db_->reccomp_.comp->compare(it->first.data(), it->first.size(),
+                                                    kbuf_, ksiz_);
+          if (fwd ? cmp > 0 : cmp < 0) return true;
+        }
+        bkey = it->first;
+      }
+      if (!flush_write_buffer(wlockp)) return false;
+      if (kbuf_) clear_position();
+      set_position(bkey.data(), bkey.size(), 0);
+      if (!adjust_position() && kbuf_) {
+        clear_position();
+        return false;
+      }
+      if (fwd) return kbuf_ != NULL;
+      if (!kbuf_) return set_position_back(db_->last_);
+      if (db_->reccomp_.comp->compare(bkey.data(), bkey.size(), kbuf_, ksiz_) < 0)
+        return back_position_atom();
+      return true;
+    }
+    /**
+     * Reflect the write buffer in the tree.
+     * @param wlockp the pointer to the variable for the flag whether the method lock is held
+     * as a writer.  The lock is promoted if necessary.
+     * @return true on success, or false on failure.
+     */
+    bool flush_write_buffer(bool* wlockp) {
+      _assert_(wlockp);
+      if (!*wlockp) {
+        if (!db_->mlock_.promote()) {
+          db_->mlock_.unlock();
+          db_->mlock_.lock_writer();
+        }
+        *wlockp = true;
+      }
+      return db_->flush_write_buffer();
+    }
     /** Dummy constructor to forbid the use. */
     Cursor(const Cursor&);
     /** Dummy Operator to forbid the use. */
@@ -934,12 +1091,15 @@ class PlantDB : public BasicDB {
    * Default constructor.
    */
   explicit PlantDB() :
-      mlock_(), mtrigger_(NULL), omode_(0), writer_(false), autotran_(false), autosync_(false),
-      db_(), curs_(), apow_(DEFAPOW), fpow_(DEFFPOW), opts_(0), bnum_(DEFBNUM),
-      psiz_(DEFPSIZ), pccap_(DEFPCCAP),
+      mlock_(), mtrigger_(NULL), mtrc_(NULL), cmgr_(NULL), cmslot_(NULL), omode_(0),
+      writer_(false), autotran_(false), autosync_(false), db_(), curs_(), apow_(DEFAPOW),
+      fpow_(DEFFPOW), opts_(0), bnum_(DEFBNUM), psiz_(DEFPSIZ), pccap_(DEFPCCAP),
       root_(0), first_(0), last_(0), lcnt_(0), icnt_(0), count_(0), cusage_(0),
       lslots_(), islots_(), reccomp_(), linkcomp_(),
-      tran_(false), trclock_(0), trlcnt_(0), trcount_(0) {
+      tran_(false), trclock_(0), trlcnt_(0), trcount_(0),
+      trepoch_(0), trmeta_(), trhard_(false), trbegun_(false), trlock_(),
+      wblock_(), wbcap_(0), wbuf_(), wbsize_(0), wbdelta_(0), wbhit_(0), wbmiss_(0),
+      wbflcnt_(0), wbflrec_(0), wbfltime_(0) {
     _assert_(true);
   }
   /**
@@ -958,6 +1118,7 @@ class PlantDB : public BasicDB {
         ++cit;
       }
     }
+    delete mtrc_;
   }
   /**
    * Accept a visitor to a record.
@@ -968,10 +1129,12 @@ class PlantDB : public BasicDB {
    * @return true on success, or false on failure.
    * @note The operation for each record is performed atomically and other threads accessing the
    * same record are blocked.  To avoid deadlock, any explicit database operation must not be
-   * performed in this function.
+   * performed in this function.  If the write buffer is enabled, updating operations are
+   * recorded in the buffer and reflected in the tree later in order of the keys.
    */
   bool accept(const char* kbuf, size_t ksiz, Visitor* visitor, bool writable = true) {
     _assert_(kbuf && ksiz <= MEMMAXSIZ && visitor);
+    Metrics::ScopedTimer mtimer(mtrc_, Metrics::ACCEPT);
     mlock_.lock_reader();
     if (omode_ == 0) {
       set_error(_KCCODELINE_, Error::INVALID, "not opened");
@@ -983,6 +1146,24 @@ class PlantDB : public BasicDB {
       mlock_.unlock();
       return false;
     }
+    WriteBufferVisitor wbvisitor(this, visitor);
+    if (wbcap_ > 0 && !tran_ && !autotran_ && !autosync_) {
+      bool full = false;
+      if (accept_write_buffer(kbuf, ksiz, visitor, writable, NULL, 0, false, &full)) {
+        wbhit_ += 1;
+        mlock_.unlock();
+        return !full || shrink_write_buffer();
+      }
+      wbmiss_ += 1;
+      if (writable) {
+        visitor = &wbvisitor;
+        writable = false;
+      }
+    }
+    if (writable && tran_ && !fix_transaction_base()) {
+      mlock_.unlock();
+      return false;
+    }
     char lstack[KCPDRECBUFSIZ];
     size_t lsiz = sizeof(Link) + ksiz;
     char* lbuf = lsiz > sizeof(lstack) ? new char[lsiz] : lstack;
@@ -1023,7 +1204,7 @@ class PlantDB : public BasicDB {
       if (!reorganize_tree(node, hist, hnum)) err = true;
       if (atran && !fix_auto_transaction_tree()) err = true;
       reorg = false;
-    } else if (cusage_ > pccap_) {
+    } else if (cache_overflow()) {
       int32_t idx = id % SLOTNUM;
       LeafSlot* lslot = lslots_ + idx;
       if (!clean_leaf_cache_part(lslot)) err = true;
@@ -1062,6 +1243,7 @@ class PlantDB : public BasicDB {
       if (!fix_auto_synchronization()) err = true;
       mlock_.unlock();
     }
+    if (wbvisitor.full() && !shrink_write_buffer()) err = true;
     return !err;
   }
   /**
@@ -1077,6 +1259,7 @@ class PlantDB : public BasicDB {
   bool accept_bulk(const std::vector<std::string>& keys, Visitor* visitor,
                    bool writable = true) {
     _assert_(visitor);
+    Metrics::ScopedTimer mtimer(mtrc_, Metrics::ACCEPT);
     ScopedSpinRWLock lock(&mlock_, true);
     if (omode_ == 0) {
       set_error(_KCCODELINE_, Error::INVALID, "not opened");
@@ -1086,56 +1269,15 @@ class PlantDB : public BasicDB {
       set_error(_KCCODELINE_, Error::NOPERM, "permission denied");
       return false;
     }
+    if (!flush_write_buffer()) return false;
+    if (writable && tran_ && !fix_transaction_base()) return false;
     ScopedVisitor svis(visitor);
     if (keys.empty()) return true;
     bool err = false;
     std::vector<std::string>::const_iterator kit = keys.begin();
     std::vector<std::string>::const_iterator kitend = keys.end();
     while (!err && kit != kitend) {
-      const char* kbuf = kit->data();
-      size_t ksiz = kit->size();
-      char lstack[KCPDRECBUFSIZ];
-      size_t lsiz = sizeof(Link) + ksiz;
-      char* lbuf = lsiz > sizeof(lstack) ? new char[lsiz] : lstack;
-      Link* link = (Link*)lbuf;
-      link->child = 0;
-      link->ksiz = ksiz;
-      std::memcpy(lbuf + sizeof(*link), kbuf, ksiz);
-      int64_t hist[LEVELMAX];
-      int32_t hnum = 0;
-      LeafNode* node = search_tree(link, true, hist, &hnum);
-      if (!node) {
-        set_error(_KCCODELINE_, Error::BROKEN, "search failed");
-        if (lbuf != lstack) delete[] lbuf;
-        err = true;
-        break;
-      }
-      char rstack[KCPDRECBUFSIZ];
-      size_t rsiz = sizeof(Record) + ksiz;
-      char* rbuf = rsiz > sizeof(rstack) ? new char[rsiz] : rstack;
-      Record* rec = (Record*)rbuf;
-      rec->ksiz = ksiz;
-      rec->vsiz = 0;
-      std::memcpy(rbuf + sizeof(*rec), kbuf, ksiz);
-      bool reorg = accept_impl(node, rec, visitor);
-      bool atran = autotran_ && !tran_ && node->dirty;
-      bool async = autosync_ && !autotran_ && !tran_ && node->dirty;
-      if (atran && !reorg && !fix_auto_transaction_leaf(node)) err = true;
-      if (reorg) {
-        if (!reorganize_tree(node, hist, hnum)) err = true;
-        if (atran && !fix_auto_transaction_tree()) err = true;
-      } else if (cusage_ > pccap_) {
-        int32_t idx = node->id % SLOTNUM;
-        LeafSlot* lslot = lslots_ + idx;
-        if (!clean_leaf_cache_part(lslot)) err = true;
-        if (!flush_leaf_cache_part(lslot)) err = true;
-        InnerSlot* islot = islots_ + idx;
-        if (islot->warm->count() > lslot->warm->count() + lslot->hot->count() + 1 &&
-            !flush_inner_cache_part(islot)) err = true;
-      }
-      if (rbuf != rstack) delete[] rbuf;
-      if (lbuf != lstack) delete[] lbuf;
-      if (async && !fix_auto_synchronization()) err = true;
+      if (!accept_writer(kit->data(), kit->size(), visitor)) err = true;
       ++kit;
     }
     return !err;
@@ -1151,6 +1293,7 @@ class PlantDB : public BasicDB {
    */
   bool iterate(Visitor *visitor, bool writable = true, ProgressChecker* checker = NULL) {
     _assert_(visitor);
+    Metrics::ScopedTimer mtimer(mtrc_, Metrics::ITERATE);
     ScopedSpinRWLock lock(&mlock_, true);
     if (omode_ == 0) {
       set_error(_KCCODELINE_, Error::INVALID, "not opened");
@@ -1160,6 +1303,8 @@ class PlantDB : public BasicDB {
       set_error(_KCCODELINE_, Error::NOPERM, "permission denied");
       return false;
     }
+    if (!flush_write_buffer()) return false;
+    if (writable && tran_ && !fix_transaction_base()) return false;
     ScopedVisitor svis(visitor);
     int64_t allcnt = count_;
     if (checker && !checker->check("iterate", "beginning", 0, allcnt)) {
@@ -1169,7 +1314,7 @@ class PlantDB : public BasicDB {
     bool err = false;
     bool atran = false;
     if (autotran_ && writable && !tran_) {
-      if (begin_transaction_impl(autosync_)) {
+      if (begin_transaction_impl(autosync_) && fix_transaction_base()) {
         atran = true;
       } else {
         err = true;
@@ -1238,7 +1383,7 @@ class PlantDB : public BasicDB {
         }
         if (lbuf != lstack) delete[] lbuf;
       }
-      if (cusage_ > pccap_) {
+      if (cache_overflow()) {
         for (int32_t i = 0; i < SLOTNUM; i++) {
           LeafSlot* lslot = lslots_ + i;
           if (!flush_leaf_cache_part(lslot)) err = true;
@@ -1390,8 +1535,15 @@ class PlantDB : public BasicDB {
     }
     omode_ = mode;
     cusage_ = 0;
+    if (cmgr_) cmslot_ = cmgr_->attach(path);
     tran_ = false;
     trclock_ = 0;
+    reset_write_buffer();
+    wbhit_ = 0;
+    wbmiss_ = 0;
+    wbflcnt_ = 0;
+    wbflrec_ = 0;
+    wbfltime_ = 0;
     trigger_meta(MetaTrigger::OPEN, "open");
     return true;
   }
@@ -1409,6 +1561,12 @@ class PlantDB : public BasicDB {
     const std::string& path = db_.path();
     report(_KCCODELINE_, Logger::DEBUG, "closing the database (path=%s)", path.c_str());
     bool err = false;
+    if (tran_) {
+      tran_ = false;
+      if (!abort_transaction()) err = true;
+    }
+    if (!flush_write_buffer()) err = true;
+    reset_write_buffer();
     disable_cursors();
     int64_t lsiz = calc_leaf_cache_size();
     int64_t isiz = calc_inner_cache_size();
@@ -1433,6 +1591,10 @@ class PlantDB : public BasicDB {
     }
     delete_inner_cache();
     delete_leaf_cache();
+    if (cmslot_) {
+      cmgr_->detach(cmslot_);
+      cmslot_ = NULL;
+    }
     if (writer_ && !dump_meta()) err = true;
     if (!db_.close()) err = true;
     omode_ = 0;
@@ -1453,6 +1615,7 @@ class PlantDB : public BasicDB {
   bool synchronize(bool hard = false, FileProcessor* proc = NULL,
                    ProgressChecker* checker = NULL) {
     _assert_(true);
+    Metrics::ScopedTimer mtimer(mtrc_, Metrics::SYNCHRONIZE);
     mlock_.lock_reader();
     if (omode_ == 0) {
       set_error(_KCCODELINE_, Error::INVALID, "not opened");
@@ -1461,6 +1624,12 @@ class PlantDB : public BasicDB {
     }
     bool err = false;
     if (writer_) {
+      if (checker && !checker->check("synchronize", "flushing the write buffer", -1, -1)) {
+        set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
+        mlock_.unlock();
+        return false;
+      }
+      if (!settle_write_buffer()) err = true;
       if (checker && !checker->check("synchronize", "cleaning the leaf node cache", -1, -1)) {
         set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
         mlock_.unlock();
@@ -1525,6 +1694,7 @@ class PlantDB : public BasicDB {
     _assert_(true);
     ScopedSpinRWLock lock(&mlock_, writable);
     bool err = false;
+    if (writable && !flush_write_buffer()) err = true;
     if (proc && !proc->process(db_.path(), count_, db_.size())) {
       set_error(_KCCODELINE_, Error::LOGIC, "processing failed");
       err = true;
@@ -1562,7 +1732,7 @@ class PlantDB : public BasicDB {
         wcnt++;
       }
     }
-    if (!begin_transaction_impl(hard)) {
+    if (!flush_write_buffer() || !begin_transaction_impl(hard)) {
       mlock_.unlock();
       return false;
     }
@@ -1595,7 +1765,7 @@ class PlantDB : public BasicDB {
       mlock_.unlock();
       return false;
     }
-    if (!begin_transaction_impl(hard)) {
+    if (!flush_write_buffer() || !begin_transaction_impl(hard)) {
       mlock_.unlock();
       return false;
     }
@@ -1611,6 +1781,7 @@ class PlantDB : public BasicDB {
    */
   bool end_transaction(bool commit = true) {
     _assert_(true);
+    Metrics::ScopedTimer mtimer(commit ? mtrc_ : NULL, Metrics::COMMITTRAN);
     ScopedSpinRWLock lock(&mlock_, true);
     if (omode_ == 0) {
       set_error(_KCCODELINE_, Error::INVALID, "not opened");
@@ -1621,12 +1792,12 @@ class PlantDB : public BasicDB {
       return false;
     }
     bool err = false;
+    tran_ = false;
     if (commit) {
       if (!commit_transaction()) err = true;
     } else {
       if (!abort_transaction()) err = true;
     }
-    tran_ = false;
     trigger_meta(commit ? MetaTrigger::COMMITTRAN : MetaTrigger::ABORTTRAN, "end_transaction");
     return !err;
   }
@@ -1645,7 +1816,9 @@ class PlantDB : public BasicDB {
       set_error(_KCCODELINE_, Error::NOPERM, "permission denied");
       return false;
     }
+    if (tran_ && !fix_transaction_base()) return false;
     disable_cursors();
+    reset_write_buffer();
     flush_leaf_cache(false);
     flush_inner_cache(false);
     bool err = false;
@@ -1675,7 +1848,8 @@ class PlantDB : public BasicDB {
       set_error(_KCCODELINE_, Error::INVALID, "not opened");
       return -1;
     }
-    return count_;
+    ScopedSpinRWLock wblock(&wblock_, false);
+    return count_ + wbdelta_;
   }
   /**
    * Get the size of the database file.
@@ -1735,10 +1909,21 @@ class PlantDB : public BasicDB {
     (*strmap)["last"] = strprintf("%lld", (long long)last_);
     (*strmap)["lcnt"] = strprintf("%lld", (long long)lcnt_);
     (*strmap)["icnt"] = strprintf("%lld", (long long)icnt_);
-    (*strmap)["count"] = strprintf("%lld", (long long)count_);
+    (*strmap)["count"] = strprintf("%lld", (long long)(count_ + wbdelta_));
     (*strmap)["bnum"] = strprintf("%lld", (long long)bnum_);
     (*strmap)["pnum"] = strprintf("%lld", (long long)db_.count());
     (*strmap)["cusage"] = strprintf("%lld", (long long)cusage_);
+    (*strmap)["wbcap"] = strprintf("%lld", (long long)wbcap_);
+    (*strmap)["wbcount"] = strprintf("%lld", (long long)wbuf_.size());
+    (*strmap)["wbsize"] = strprintf("%lld", (long long)wbsize_);
+    int64_t wbhit = wbhit_.get();
+    int64_t wbacc = wbhit + wbmiss_.get();
+    (*strmap)["wbhit"] = strprintf("%lld", (long long)wbhit);
+    (*strmap)["wbmiss"] = strprintf("%lld", (long long)(wbacc - wbhit));
+    (*strmap)["wbhitrate"] = strprintf("%.6f", wbacc > 0 ? (double)wbhit / wbacc : 0.0);
+    (*strmap)["wbflush"] = strprintf("%lld", (long long)wbflcnt_);
+    (*strmap)["wbflrec"] = strprintf("%lld", (long long)wbflrec_);
+    (*strmap)["wbfltime"] = strprintf("%.6f", wbfltime_);
     if (strmap->count("cusage_lcnt") > 0)
       (*strmap)["cusage_lcnt"] = strprintf("%lld", (long long)calc_leaf_cache_count());
     if (strmap->count("cusage_lsiz") > 0)
@@ -1755,6 +1940,28 @@ class PlantDB : public BasicDB {
       search_tree(&link, false, hist, &hnum);
       (*strmap)["tree_level"] = strprintf("%d", hnum + 1);
     }
+    if (mtrc_) {
+      mtrc_->status(strmap);
+      int64_t hit = mtrc_->get(MCHIT);
+      int64_t miss = mtrc_->get(MCMISS);
+      int64_t lchit = mtrc_->get(MCLCHIT);
+      int64_t lcmiss = mtrc_->get(MCLCMISS);
+      int64_t ichit = mtrc_->get(MCICHIT);
+      int64_t icmiss = mtrc_->get(MCICMISS);
+      (*strmap)["mt_hitrate"] =
+          strprintf("%.6f", hit + miss > 0 ? (double)hit / (hit + miss) : 0.0);
+      (*strmap)["mt_lchitrate"] =
+          strprintf("%.6f", lchit + lcmiss > 0 ? (double)lchit / (lchit + lcmiss) : 0.0);
+      (*strmap)["mt_ichitrate"] =
+          strprintf("%.6f", ichit + icmiss > 0 ? (double)ichit / (ichit + icmiss) : 0.0);
+    }
+    if (cmslot_) {
+      (*strmap)["cm_budget"] = strprintf("%lld", (long long)cmgr_->budget());
+      (*strmap)["cm_quota"] = strprintf("%lld", (long long)cmslot_->quota());
+      (*strmap)["cm_usage"] = strprintf("%lld", (long long)cmslot_->usage());
+      (*strmap)["cm_hits"] = strprintf("%lld", (long long)cmslot_->hits());
+      (*strmap)["cm_misses"] = strprintf("%lld", (long long)cmslot_->misses());
+    }
     return true;
   }
   /**
@@ -1799,6 +2006,26 @@ class PlantDB : public BasicDB {
     mtrigger_ = trigger;
     return true;
   }
+  /**
+   * Enable or disable the collection of runtime metrics.
+   * @param enabled true to collect metrics, or false not to.
+   * @return true on success, or false on failure.
+   * @note The collected metrics are reported by the status method with the prefix "mt_".
+   */
+  bool tune_metrics(bool enabled = true) {
+    _assert_(true);
+    ScopedSpinRWLock lock(&mlock_, true);
+    if (omode_ != 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "already opened");
+      return false;
+    }
+    static const char* const names[] = {
+      "hit", "miss", "lchit", "lcmiss", "ichit", "icmiss"
+    };
+    delete mtrc_;
+    mtrc_ = enabled ? new Metrics(names, MCNUM) : NULL;
+    return true;
+  }
   /**
    * Set the power of the alignment of record size.
    * @param apow the power of the alignment of record size.
@@ -1904,6 +2131,21 @@ class PlantDB : public BasicDB {
     }
     return db_.tune_defrag(dfunit);
   }
+  /**
+   * Set the region unit of the recovery journal.
+   * @param jnunit the size of each region whose pre-image is saved in the journal.  If it is not
+   * more than 0, the journal is not used.
+   * @return true on success, or false on failure.
+   */
+  bool tune_journal(int64_t jnunit) {
+    _assert_(true);
+    ScopedSpinRWLock lock(&mlock_, true);
+    if (omode_ != 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "already opened");
+      return false;
+    }
+    return db_.tune_journal(jnunit);
+  }
   /**
    * Set the capacity size of the page cache.
    * @param pccap the capacity size of the page cache.
@@ -1919,6 +2161,46 @@ class PlantDB : public BasicDB {
     pccap_ = pccap > 0 ? pccap : DEFPCCAP;
     return true;
   }
+  /**
+   * Set the shared cache manager.
+   * @param cmgr the cache manager object.  If it is NULL, the page cache is not shared.
+   * @return true on success, or false on failure.
+   * @note The database registers its page cache with the manager when it is opened and
+   * unregisters it when it is closed.  While registered, the capacity of the page cache is the
+   * quota assigned by the manager instead of the value of tune_page_cache.  The assignment is
+   * reported by the status method with the prefix "cm_".
+   */
+  bool tune_cache_manager(CacheManager* cmgr) {
+    _assert_(true);
+    ScopedSpinRWLock lock(&mlock_, true);
+    if (omode_ != 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "already opened");
+      return false;
+    }
+    cmgr_ = cmgr;
+    return true;
+  }
+  /**
+   * Set the capacity size of the write buffer.
+   * @param wbcap the capacity size of the write buffer.  If it is not more than 0, the write
+   * buffer is disabled.
+   * @return true on success, or false on failure.
+   * @note The write buffer absorbs updating operations in memory and reflects them in the tree
+   * in order of the keys when its size exceeds the capacity, so that each leaf node is loaded
+   * and rewritten once per batch.  It is bypassed in transaction and with the auto transaction
+   * or the auto synchronization mode.  Jumping a cursor flushes it, and other cursor operations
+   * flush it only when the cursor reaches a buffered record.
+   */
+  bool tune_write_buffer(int64_t wbcap) {
+    _assert_(true);
+    ScopedSpinRWLock lock(&mlock_, true);
+    if (omode_ != 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "already opened");
+      return false;
+    }
+    wbcap_ = wbcap > 0 ? wbcap : 0;
+    return true;
+  }
   /**
    * Set the data compressor.
    * @param comp the data compressor object.
@@ -1991,6 +2273,150 @@ class PlantDB : public BasicDB {
     }
     return db_.defrag(step);
   }
+  /**
+   * Analyze the database and recommend tuning parameters.
+   * @param strmap a string map to contain the result.
+   * @param snum the number of leaf nodes to be sampled.  If it is not more than 0, the default
+   * number is specified.
+   * @return true on success, or false on failure.
+   * @note Record sizes and the fill ratio of leaf nodes are measured by loading the sampled
+   * leaf nodes, and the status of the internal database is also stored.  Recommended values are
+   * stored with the prefix "rec_" and predicted effects with the prefix "est_".  "rebuild" is
+   * set to "1" if the structural parameters of "psiz" or "bnum" should be changed by rebuilding
+   * the database.  "pccap", "msiz", and "dfunit" can be applied just by opening the database
+   * again.
+   */
+  bool analyze(std::map<std::string, std::string>* strmap, int64_t snum = 0) {
+    _assert_(strmap);
+    ScopedSpinRWLock lock(&mlock_, true);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
+    }
+    if (!db_.status(strmap)) return false;
+    int64_t pages = atoi((*strmap)["count"].c_str());
+    (*strmap)["type"] = strprintf("%u", (unsigned)DBTYPE);
+    int64_t lnum = lcnt_;
+    if (snum < 1) snum = ANASMPNUM;
+    if (snum > lnum) snum = lnum;
+    int64_t step = snum > 0 ? lnum / snum : 1;
+    std::vector<int64_t> ksizs, vsizs, lsizs, lrnums;
+    int64_t found = 0;
+    int64_t live = 0;
+    bool err = false;
+    for (int64_t i = 0; i < snum; i++) {
+      // IDs of leaves freed by merging are never reused, so the stride is searched for a live one
+      int64_t id = i * step + 1;
+      int64_t end = i < snum - 1 ? id + step : lnum + 1;
+      LeafNode* node = NULL;
+      while (id < end) {
+        node = load_leaf_node(id, false);
+        if (node && !node->dead) break;
+        node = NULL;
+        id++;
+      }
+      if (!node) continue;
+      if (id == i * step + 1) live++;
+      found++;
+      lsizs.push_back(node->size);
+      lrnums.push_back(node->recs.size());
+      typename RecordArray::const_iterator rit = node->recs.begin();
+      typename RecordArray::const_iterator ritend = node->recs.end();
+      while (rit != ritend) {
+        Record* rec = *rit;
+        ksizs.push_back(rec->ksiz);
+        vsizs.push_back(rec->vsiz);
+        ++rit;
+      }
+    }
+    if (cache_overflow()) {
+      for (int32_t i = 0; i < SLOTNUM; i++) {
+        if (!flush_leaf_cache_part(lslots_ + i)) err = true;
+      }
+    }
+    int64_t rnum = ksizs.size();
+    int64_t rsum = 0;
+    for (int64_t i = 0; i < rnum; i++) {
+      rsum += sizeof(Record) + ksizs[i] + vsizs[i];
+    }
+    int64_t lsum = 0;
+    for (size_t i = 0; i < lsizs.size(); i++) {
+      lsum += lsizs[i];
+    }
+    store_size_stats("ksiz", &ksizs, strmap);
+    store_size_stats("vsiz", &vsizs, strmap);
+    store_size_stats("leaf_size", &lsizs, strmap);
+    store_size_stats("leaf_count", &lrnums, strmap);
+    double rmean = rnum > 0 ? (double)rsum / rnum : 0;
+    double fill = found > 0 ? (double)lsum / found / psiz_ : 0;
+    int64_t count = count_ + wbdelta_;
+    int64_t leaves = snum > 0 ? lnum * live / snum : 0;
+    double total = found > 0 ? (double)lsum / found * leaves : 0;
+    (*strmap)["sample_leaves"] = strprintf("%lld", (long long)found);
+    (*strmap)["sample_records"] = strprintf("%lld", (long long)rnum);
+    (*strmap)["leaf_fill"] = strprintf("%.6f", fill);
+    (*strmap)["leaf_live"] = strprintf("%lld", (long long)leaves);
+    (*strmap)["rsiz_mean"] = strprintf("%.3f", rmean);
+    (*strmap)["psiz"] = strprintf("%d", psiz_);
+    (*strmap)["pccap"] = strprintf("%lld", (long long)pccap_);
+    (*strmap)["bnum"] = strprintf("%lld", (long long)bnum_);
+    (*strmap)["pnum"] = strprintf("%lld", (long long)pages);
+    (*strmap)["count"] = strprintf("%lld", (long long)count);
+    (*strmap)["cache_ratio"] = strprintf("%.6f", total > pccap_ ? pccap_ / total : 1.0);
+    if (mtrc_) {
+      int64_t hit = mtrc_->get(MCLCHIT);
+      int64_t miss = mtrc_->get(MCLCMISS);
+      (*strmap)["cache_hitrate"] =
+          strprintf("%.6f", hit + miss > 0 ? (double)hit / (hit + miss) : 0.0);
+    }
+    // a page should hold tens to hundreds of records to balance the depth and the rewriting cost
+    int32_t rpsiz = psiz_;
+    if (rnum > 0 && (psiz_ < rmean * ANAMINLREC || psiz_ > rmean * ANAMAXLREC)) {
+      rpsiz = ANAMINPSIZ;
+      while (rpsiz < ANAMAXPSIZ && rpsiz < rmean * ANALREC) {
+        rpsiz *= 2;
+      }
+    }
+    // twice as many buckets as pages of the internal database
+    pages = (int64_t)pages * psiz_ / rpsiz;
+    int64_t rbnum = bnum_;
+    if (bnum_ < pages / 2 || bnum_ > pages * 4) {
+      rbnum = pages * 2;
+      if (rbnum < ANAMINBNUM) rbnum = ANAMINBNUM;
+    }
+    // the page cache should cover the whole tree with some room for growth
+    int64_t rpccap = pccap_;
+    if (pccap_ < total) {
+      rpccap = (int64_t)(total * 1.25);
+      rpccap = (rpccap + ANAMAPUNIT - 1) / ANAMAPUNIT * ANAMAPUNIT;
+    }
+    (*strmap)["rec_psiz"] = strprintf("%d", rpsiz);
+    (*strmap)["rec_bnum"] = strprintf("%lld", (long long)rbnum);
+    (*strmap)["rec_pccap"] = strprintf("%lld", (long long)rpccap);
+    (*strmap)["est_leaf_count"] =
+        strprintf("%.3f", rmean > 0 ? rpsiz * (fill > 0 ? fill : 1) / rmean : 0.0);
+    (*strmap)["est_cache_ratio"] = strprintf("%.6f", total > rpccap ? rpccap / total : 1.0);
+    if (strmap->count("realsize") > 0 && strmap->count("msiz") > 0) {
+      int64_t fsiz = atoi((*strmap)["realsize"].c_str());
+      int64_t msiz = atoi((*strmap)["msiz"].c_str());
+      int64_t rmsiz = msiz;
+      if (msiz < fsiz) {
+        rmsiz = fsiz + fsiz / 4;
+        rmsiz = (rmsiz + ANAMAPUNIT - 1) / ANAMAPUNIT * ANAMAPUNIT;
+      }
+      (*strmap)["rec_msiz"] = strprintf("%lld", (long long)rmsiz);
+    }
+    if (strmap->count("frgcnt") > 0 && strmap->count("dfunit") > 0) {
+      // every rewritten page leaves a fragment behind in the internal database
+      int64_t frgcnt = atoi((*strmap)["frgcnt"].c_str());
+      int64_t dfunit = atoi((*strmap)["dfunit"].c_str());
+      if (dfunit < 1 && frgcnt * 100 > (leaves + 1) * ANAFRAGLOW) dfunit = ANADFUNIT;
+      (*strmap)["rec_dfunit"] = strprintf("%lld", (long long)dfunit);
+    }
+    bool rebuild = rpsiz != psiz_ || rbnum != bnum_;
+    (*strmap)["rebuild"] = strprintf("%d", rebuild);
+    return !err;
+  }
   /**
    * Get the status flags.
    * @return the status flags, or 0 on failure.
@@ -2100,6 +2526,8 @@ class PlantDB : public BasicDB {
       _assert_(true);
       char* akbuf = (char*)a + sizeof(*a);
       char* bkbuf = (char*)b + sizeof(*b);
+      if (comp == LEXICALCOMP)
+        return LEXICALCOMP->LexicalComparator::compare(akbuf, a->ksiz, bkbuf, b->ksiz) < 0;
       return comp->compare(akbuf, a->ksiz, bkbuf, b->ksiz) < 0;
     }
   };
@@ -2116,6 +2544,7 @@ class PlantDB : public BasicDB {
     bool hot;                            ///< whether in the hot cache
     bool dirty;                          ///< whether to be written back
     bool dead;                           ///< whether to be removed
+    int64_t trepoch;                     ///< epoch of the transaction touching it
   };
   /**
    * Link to a node.
@@ -2138,6 +2567,8 @@ class PlantDB : public BasicDB {
       _assert_(true);
       char* akbuf = (char*)a + sizeof(*a);
       char* bkbuf = (char*)b + sizeof(*b);
+      if (comp == LEXICALCOMP)
+        return LEXICALCOMP->LexicalComparator::compare(akbuf, a->ksiz, bkbuf, b->ksiz) < 0;
       return comp->compare(akbuf, a->ksiz, bkbuf, b->ksiz) < 0;
     }
   };
@@ -2152,6 +2583,7 @@ class PlantDB : public BasicDB {
     int64_t size;                        ///< total size of links
     bool dirty;                          ///< whether to be written back
     bool dead;                           ///< whether to be removed
+    int64_t trepoch;                     ///< epoch of the transaction touching it
   };
   /**
    * Slot cache of leaf nodes.
@@ -2168,6 +2600,19 @@ class PlantDB : public BasicDB {
     SpinLock lock;                       ///< lock
     InnerCache* warm;                    ///< warm cache
   };
+  /**
+   * Meta data at the beginning of a transaction.
+   */
+  struct TranMeta {
+    int64_t root;                        ///< root node
+    int64_t first;                       ///< first node
+    int64_t last;                        ///< last node
+    int64_t lcnt;                        ///< count of leaf nodes
+    int64_t icnt;                        ///< count of inner nodes
+    int64_t count;                       ///< record number
+    int64_t trlcnt;                      ///< leaf count history
+    int64_t trcount;                     ///< record count history
+  };
   /**
    * Scoped visitor.
    */
@@ -2186,6 +2631,54 @@ class PlantDB : public BasicDB {
    private:
     Visitor* visitor_;                   ///< visitor
   };
+  /**
+   * Comparator for the keys of the write buffer.
+   */
+  struct WriteBufferComparator {
+    Comparator* comp;                    ///< comparator
+    /** constructor */
+    explicit WriteBufferComparator(Comparator* rcomp = NULL) : comp(rcomp) {
+      _assert_(true);
+    }
+    /** comparing operator */
+    bool operator ()(const std::string& a, const std::string& b) const {
+      _assert_(true);
+      if (comp == LEXICALCOMP)
+        return LEXICALCOMP->LexicalComparator::compare(a.data(), a.size(), b.data(), b.size()) < 0;
+      return comp->compare(a.data(), a.size(), b.data(), b.size()) < 0;
+    }
+  };
+  /**
+   * Visitor to record the result of an updating operation into the write buffer.
+   */
+  class WriteBufferVisitor : public Visitor {
+   public:
+    /** constructor */
+    explicit WriteBufferVisitor(PlantDB* db, Visitor* visitor) :
+        db_(db), visitor_(visitor), full_(false) {
+      _assert_(db && visitor);
+    }
+    /** Check whether the write buffer exceeds the capacity. */
+    bool full() {
+      _assert_(true);
+      return full_;
+    }
+   private:
+    const char* visit_full(const char* kbuf, size_t ksiz,
+                           const char* vbuf, size_t vsiz, size_t* sp) {
+      _assert_(kbuf && vbuf && sp);
+      db_->accept_write_buffer(kbuf, ksiz, visitor_, true, vbuf, vsiz, true, &full_);
+      return NOP;
+    }
+    const char* visit_empty(const char* kbuf, size_t ksiz, size_t* sp) {
+      _assert_(kbuf && sp);
+      db_->accept_write_buffer(kbuf, ksiz, visitor_, true, NULL, 0, true, &full_);
+      return NOP;
+    }
+    PlantDB* db_;                        ///< database
+    Visitor* visitor_;                   ///< visitor
+    bool full_;                          ///< flag whether the buffer is full
+  };
   /**
    * Open the leaf cache.
    */
@@ -2316,6 +2809,7 @@ class PlantDB : public BasicDB {
     node->hot = false;
     node->dirty = true;
     node->dead = false;
+    node->trepoch = trepoch_;
     int32_t sidx = node->id % SLOTNUM;
     LeafSlot* slot = lslots_ + sidx;
     slot->warm->set(node->id, node, LeafCache::MLAST);
@@ -2359,6 +2853,7 @@ class PlantDB : public BasicDB {
     _assert_(node);
     ScopedSpinRWLock lock(&node->lock, false);
     if (!node->dirty) return true;
+    touch_leaf_node(node);
     bool err = false;
     char hbuf[NUMBUFSIZ];
     size_t hsiz = std::sprintf(hbuf, "%c%llX", LNPREFIX, (long long)node->id);
@@ -2388,6 +2883,19 @@ class PlantDB : public BasicDB {
     node->dirty = false;
     return !err;
   }
+  /**
+   * Check whether the page cache exceeds its capacity.
+   * @return true if the page cache exceeds its capacity, or false if not.
+   */
+  bool cache_overflow() {
+    _assert_(true);
+    int64_t usage = cusage_;
+    if (cmslot_) {
+      cmslot_->set_usage(usage);
+      return usage > cmslot_->quota();
+    }
+    return usage > pccap_;
+  }
   /**
    * Load a leaf node.
    * @param id the ID number of the leaf node.
@@ -2400,7 +2908,11 @@ class PlantDB : public BasicDB {
     LeafSlot* slot = lslots_ + sidx;
     ScopedMutex lock(&slot->lock);
     LeafNode** np = slot->hot->get(id, LeafCache::MLAST);
-    if (np) return *np;
+    if (np) {
+      if (mtrc_) mtrc_->add(MCLCHIT);
+      if (cmslot_) cmslot_->hit();
+      return *np;
+    }
     if (prom) {
       if (slot->hot->count() * WARMRATIO > slot->warm->count() + WARMRATIO) {
         slot->hot->first_value()->hot = false;
@@ -2408,13 +2920,21 @@ class PlantDB : public BasicDB {
       }
       np = slot->warm->migrate(id, slot->hot, LeafCache::MLAST);
       if (np) {
+        if (mtrc_) mtrc_->add(MCLCHIT);
+        if (cmslot_) cmslot_->hit();
         (*np)->hot = true;
         return *np;
       }
     } else {
       LeafNode** np = slot->warm->get(id, LeafCache::MLAST);
-      if (np) return *np;
+      if (np) {
+        if (mtrc_) mtrc_->add(MCLCHIT);
+        if (cmslot_) cmslot_->hit();
+        return *np;
+      }
     }
+    if (mtrc_) mtrc_->add(MCLCMISS);
+    if (cmslot_) cmslot_->miss();
     char hbuf[NUMBUFSIZ];
     size_t hsiz = std::sprintf(hbuf, "%c%llX", LNPREFIX, (long long)id);
     class VisitorImpl : public DB::Visitor {
@@ -2489,6 +3009,7 @@ class PlantDB : public BasicDB {
     node->hot = false;
     node->dirty = false;
     node->dead = false;
+    node->trepoch = tran_ ? trepoch_ : 0;
     slot->warm->set(id, node, LeafCache::MLAST);
     cusage_ += node->size;
     return node;
@@ -2521,12 +3042,14 @@ class PlantDB : public BasicDB {
     typename RecordArray::iterator ritend = recs.end();
     typename RecordArray::iterator rit = std::lower_bound(recs.begin(), ritend, rec, reccomp_);
     if (rit != ritend && !reccomp_(rec, *rit)) {
+      if (mtrc_) mtrc_->add(MCHIT);
       Record* rec = *rit;
       char* kbuf = (char*)rec + sizeof(*rec);
       size_t ksiz = rec->ksiz;
       size_t vsiz;
       const char* vbuf = visitor->visit_full(kbuf, ksiz, kbuf + ksiz, rec->vsiz, &vsiz);
       if (vbuf == Visitor::REMOVE) {
+        touch_leaf_node(node);
         size_t rsiz = sizeof(*rec) + rec->ksiz + rec->vsiz;
         count_ -= 1;
         cusage_ -= rsiz;
@@ -2536,6 +3059,7 @@ class PlantDB : public BasicDB {
         recs.erase(rit);
         if (recs.empty()) reorg = true;
       } else if (vbuf != Visitor::NOP) {
+        touch_leaf_node(node);
         int64_t diff = (int64_t)vsiz - (int64_t)rec->vsiz;
         cusage_ += diff;
         node->size += diff;
@@ -2550,11 +3074,13 @@ class PlantDB : public BasicDB {
         if (node->size > psiz_ && recs.size() > 1) reorg = true;
       }
     } else {
+      if (mtrc_) mtrc_->add(MCMISS);
       const char* kbuf = (char*)rec + sizeof(*rec);
       size_t ksiz = rec->ksiz;
       size_t vsiz;
       const char* vbuf = visitor->visit_empty(kbuf, ksiz, &vsiz);
       if (vbuf != Visitor::NOP && vbuf != Visitor::REMOVE) {
+        touch_leaf_node(node);
         size_t rsiz = sizeof(*rec) + ksiz + vsiz;
         count_ += 1;
         cusage_ += rsiz;
@@ -2572,6 +3098,199 @@ class PlantDB : public BasicDB {
     }
     return reorg;
   }
+  /**
+   * Accept a visitor to a record under the writer lock.
+   * @param kbuf the pointer to the key region.
+   * @param ksiz the size of the key region.
+   * @param visitor a visitor object.
+   * @return true on success, or false on failure.
+   */
+  bool accept_writer(const char* kbuf, size_t ksiz, Visitor* visitor) {
+    _assert_(kbuf && ksiz <= MEMMAXSIZ && visitor);
+    bool err = false;
+    char lstack[KCPDRECBUFSIZ];
+    size_t lsiz = sizeof(Link) + ksiz;
+    char* lbuf = lsiz > sizeof(lstack) ? new char[lsiz] : lstack;
+    Link* link = (Link*)lbuf;
+    link->child = 0;
+    link->ksiz = ksiz;
+    std::memcpy(lbuf + sizeof(*link), kbuf, ksiz);
+    int64_t hist[LEVELMAX];
+    int32_t hnum = 0;
+    LeafNode* node = search_tree(link, true, hist, &hnum);
+    if (!node) {
+      set_error(_KCCODELINE_, Error::BROKEN, "search failed");
+      if (lbuf != lstack) delete[] lbuf;
+      return false;
+    }
+    char rstack[KCPDRECBUFSIZ];
+    size_t rsiz = sizeof(Record) + ksiz;
+    char* rbuf = rsiz > sizeof(rstack) ? new char[rsiz] : rstack;
+    Record* rec = (Record*)rbuf;
+    rec->ksiz = ksiz;
+    rec->vsiz = 0;
+    std::memcpy(rbuf + sizeof(*rec), kbuf, ksiz);
+    bool reorg = accept_impl(node, rec, visitor);
+    bool atran = autotran_ && !tran_ && node->dirty;
+    bool async = autosync_ && !autotran_ && !tran_ && node->dirty;
+    if (atran && !reorg && !fix_auto_transaction_leaf(node)) err = true;
+    if (reorg) {
+      if (!reorganize_tree(node, hist, hnum)) err = true;
+      if (atran && !fix_auto_transaction_tree()) err = true;
+    } else if (cache_overflow()) {
+      int32_t idx = node->id % SLOTNUM;
+      LeafSlot* lslot = lslots_ + idx;
+      if (!clean_leaf_cache_part(lslot)) err = true;
+      if (!flush_leaf_cache_part(lslot)) err = true;
+      InnerSlot* islot = islots_ + idx;
+      if (islot->warm->count() > lslot->warm->count() + lslot->hot->count() + 1 &&
+          !flush_inner_cache_part(islot)) err = true;
+    }
+    if (rbuf != rstack) delete[] rbuf;
+    if (lbuf != lstack) delete[] lbuf;
+    if (async && !fix_auto_synchronization()) err = true;
+    return !err;
+  }
+  /**
+   * Accept a visitor to a record in the write buffer.
+   * @param kbuf the pointer to the key region.
+   * @param ksiz the size of the key region.
+   * @param visitor a visitor object.
+   * @param writable true for writable operation, or false for read-only operation.
+   * @param vbuf the pointer to the value region in the tree, or NULL if it does not exist.
+   * @param vsiz the size of the value region in the tree.
+   * @param force true to accept the visitor even if the record is not buffered.
+   * @param fullp the pointer to the variable for the flag whether the buffer is full.
+   * @return true if the visitor is accepted, or false if the record is not buffered.
+   * @note The method lock must be held as a reader.
+   */
+  bool accept_write_buffer(const char* kbuf, size_t ksiz, Visitor* visitor, bool writable,
+                           const char* vbuf, size_t vsiz, bool force, bool* fullp) {
+    _assert_(kbuf && ksiz <= MEMMAXSIZ && visitor && fullp);
+    ScopedSpinRWLock lock(&wblock_, writable);
+    std::string key(kbuf, ksiz);
+    typename WriteBuffer::iterator it = wbuf_.find(key);
+    bool orig = vbuf != NULL;
+    if (it != wbuf_.end()) {
+      const std::string& ent = it->second;
+      orig = (ent[0] & WBORIG) != 0;
+      if (ent[0] & WBLIVE) {
+        vbuf = ent.data() + 1;
+        vsiz = ent.size() - 1;
+      } else {
+        vbuf = NULL;
+      }
+    } else if (!force) {
+      return false;
+    }
+    bool live = vbuf != NULL;
+    size_t rsiz;
+    const char* rbuf = live ? visitor->visit_full(kbuf, ksiz, vbuf, vsiz, &rsiz) :
+        visitor->visit_empty(kbuf, ksiz, &rsiz);
+    if (!writable || rbuf == Visitor::NOP) return true;
+    if (rbuf == Visitor::REMOVE && !live) return true;
+    std::string ent;
+    ent.reserve(1 + (rbuf == Visitor::REMOVE ? 0 : rsiz));
+    ent.push_back((char)(orig ? WBORIG : 0));
+    if (rbuf != Visitor::REMOVE) {
+      ent[0] |= WBLIVE;
+      ent.append(rbuf, rsiz);
+      if (!live) wbdelta_ += 1;
+    } else {
+      wbdelta_ -= 1;
+    }
+    if (it == wbuf_.end()) {
+      it = wbuf_.insert(std::make_pair(key, std::string())).first;
+      wbsize_ += ksiz;
+    }
+    wbsize_ += (int64_t)ent.size() - (int64_t)it->second.size();
+    it->second.swap(ent);
+    if (wbsize_ > wbcap_) *fullp = true;
+    return true;
+  }
+  /**
+   * Flush the write buffer if it exceeds the capacity.
+   * @return true on success, or false on failure.
+   * @note The method lock must not be held.
+   */
+  bool shrink_write_buffer() {
+    _assert_(true);
+    ScopedSpinRWLock lock(&mlock_, true);
+    if (wbsize_ <= wbcap_) return true;
+    return flush_write_buffer();
+  }
+  /**
+   * Flush the write buffer while the method lock is held as a reader.
+   * @return true on success, or false on failure.
+   * @note The method lock is promoted temporarily and held as a reader again on return.
+   */
+  bool settle_write_buffer() {
+    _assert_(true);
+    if (wbcap_ < 1) return true;
+    {
+      ScopedSpinRWLock lock(&wblock_, false);
+      if (wbuf_.empty()) return true;
+    }
+    if (!mlock_.promote()) {
+      mlock_.unlock();
+      mlock_.lock_writer();
+    }
+    bool err = false;
+    if (!flush_write_buffer()) err = true;
+    mlock_.demote();
+    return !err;
+  }
+  /**
+   * Reflect all records in the write buffer in the tree.
+   * @return true on success, or false on failure.
+   * @note The method lock must be held as a writer.
+   */
+  bool flush_write_buffer() {
+    _assert_(true);
+    if (wbuf_.empty()) return true;
+    class VisitorImpl : public Visitor {
+     public:
+      explicit VisitorImpl(const std::string& ent) : ent_(ent) {}
+     private:
+      const char* visit_full(const char* kbuf, size_t ksiz,
+                             const char* vbuf, size_t vsiz, size_t* sp) {
+        if (!(ent_[0] & WBLIVE)) return REMOVE;
+        *sp = ent_.size() - 1;
+        return ent_.data() + 1;
+      }
+      const char* visit_empty(const char* kbuf, size_t ksiz, size_t* sp) {
+        if (!(ent_[0] & WBLIVE)) return NOP;
+        *sp = ent_.size() - 1;
+        return ent_.data() + 1;
+      }
+      const std::string& ent_;
+    };
+    double stime = time();
+    bool err = false;
+    typename WriteBuffer::const_iterator it = wbuf_.begin();
+    typename WriteBuffer::const_iterator itend = wbuf_.end();
+    while (it != itend) {
+      const std::string& key = it->first;
+      VisitorImpl visitor(it->second);
+      if (!accept_writer(key.data(), key.size(), &visitor)) err = true;
+      ++it;
+    }
+    wbflrec_ += wbuf_.size();
+    wbflcnt_++;
+    reset_write_buffer();
+    wbfltime_ += time() - stime;
+    return !err;
+  }
+  /**
+   * Discard all records in the write buffer.
+   */
+  void reset_write_buffer() {
+    _assert_(true);
+    WriteBuffer empty(WriteBufferComparator(reccomp_.comp ? reccomp_.comp : LEXICALCOMP));
+    wbuf_.swap(empty);
+    wbsize_ = 0;
+    wbdelta_ = 0;
+  }
   /**
    * Devide a leaf node into two.
    * @param node the leaf node.
@@ -2587,9 +3306,11 @@ class PlantDB : public BasicDB {
         db_.report(_KCCODELINE_, Logger::WARN, "id=%lld", (long long)newnode->next);
         return NULL;
       }
+      touch_leaf_node(nextnode);
       nextnode->prev = newnode->id;
       nextnode->dirty = true;
     }
+    touch_leaf_node(node);
     node->next = newnode->id;
     node->dirty = true;
     RecordArray& recs = node->recs;
@@ -2699,6 +3420,7 @@ class PlantDB : public BasicDB {
     node->size = sizeof(int64_t);
     node->dirty = true;
     node->dead = false;
+    node->trepoch = trepoch_;
     int32_t sidx = node->id % SLOTNUM;
     InnerSlot* slot = islots_ + sidx;
     slot->warm->set(node->id, node, InnerCache::MLAST);
@@ -2737,6 +3459,7 @@ class PlantDB : public BasicDB {
   bool save_inner_node(InnerNode* node) {
     _assert_(true);
     if (!node->dirty) return true;
+    touch_inner_node(node);
     bool err = false;
     char hbuf[NUMBUFSIZ];
     size_t hsiz = std::sprintf(hbuf, "%c%llX",
@@ -2775,7 +3498,13 @@ class PlantDB : public BasicDB {
     InnerSlot* slot = islots_ + sidx;
     ScopedSpinLock lock(&slot->lock);
     InnerNode** np = slot->warm->get(id, InnerCache::MLAST);
-    if (np) return *np;
+    if (np) {
+      if (mtrc_) mtrc_->add(MCICHIT);
+      if (cmslot_) cmslot_->hit();
+      return *np;
+    }
+    if (mtrc_) mtrc_->add(MCICMISS);
+    if (cmslot_) cmslot_->miss();
     char hbuf[NUMBUFSIZ];
     size_t hsiz = std::sprintf(hbuf, "%c%llX", INPREFIX, (long long)(id - INIDBASE));
     class VisitorImpl : public DB::Visitor {
@@ -2839,6 +3568,7 @@ class PlantDB : public BasicDB {
     node->id = id;
     node->dirty = false;
     node->dead = false;
+    node->trepoch = tran_ ? trepoch_ : 0;
     slot->warm->set(id, node, InnerCache::MLAST);
     cusage_ += node->size;
     return node;
@@ -2941,6 +3671,7 @@ class PlantDB : public BasicDB {
           Link* link = links.back();
           size_t rsiz = sizeof(*link) + link->ksiz;
           cusage_ -= rsiz;
+          touch_inner_node(inode);
           inode->size -= rsiz;
           xfree(link);
           links.pop_back();
@@ -2963,6 +3694,7 @@ class PlantDB : public BasicDB {
             db_.report(_KCCODELINE_, Logger::WARN, "id=%lld", (long long)node->prev);
             return false;
           }
+          touch_leaf_node(tnode);
           tnode->next = node->next;
           tnode->dirty = true;
           if (last_ == node->id) last_ = node->prev;
@@ -2974,10 +3706,12 @@ class PlantDB : public BasicDB {
             db_.report(_KCCODELINE_, Logger::WARN, "id=%lld", (long long)node->next);
             return false;
           }
+          touch_leaf_node(tnode);
           tnode->prev = node->prev;
           tnode->dirty = true;
           if (first_ == node->id) first_ = node->next;
         }
+        touch_leaf_node(node);
         node->dead = true;
       }
     }
@@ -2998,6 +3732,7 @@ class PlantDB : public BasicDB {
     link->ksiz = ksiz;
     char* dbuf = (char*)link + sizeof(*link);
     std::memcpy(dbuf, kbuf, ksiz);
+    touch_inner_node(node);
     LinkArray& links = node->links;
     typename LinkArray::iterator litend = links.end();
     typename LinkArray::iterator lit = std::upper_bound(links.begin(), litend, link, linkcomp_);
@@ -3016,6 +3751,7 @@ class PlantDB : public BasicDB {
    */
   bool sub_link_tree(InnerNode* node, int64_t child, int64_t* hist, int32_t hnum) {
     _assert_(node && hist && hnum >= 0);
+    touch_inner_node(node);
     node->dirty = true;
     LinkArray& links = node->links;
     typename LinkArray::iterator lit = links.begin();
@@ -3508,18 +4244,46 @@ class PlantDB : public BasicDB {
    * @param hard true for physical synchronization with the device, or false for logical
    * synchronization with the file system.
    * @return true on success, or false on failure.
+   * @note Nothing is written here.  The transaction of the internal database is begun by
+   * fix_transaction_base before the first update.
    */
   bool begin_transaction_impl(bool hard) {
     _assert_(true);
-    if (!clean_leaf_cache()) return false;
-    if (!clean_inner_cache()) return false;
-    int32_t idx = trclock_++ % SLOTNUM;
-    LeafSlot* lslot = lslots_ + idx;
-    if (lslot->warm->count() + lslot->hot->count() > 1) flush_leaf_cache_part(lslot);
-    InnerSlot* islot = islots_ + idx;
-    if (islot->warm->count() > 1) flush_inner_cache_part(islot);
+    trhard_ = hard;
+    trbegun_ = false;
+    trepoch_++;
+    trmeta_.root = root_;
+    trmeta_.first = first_;
+    trmeta_.last = last_;
+    trmeta_.lcnt = lcnt_;
+    trmeta_.icnt = icnt_;
+    trmeta_.count = count_;
+    trmeta_.trlcnt = trlcnt_;
+    trmeta_.trcount = trcount_;
+    return true;
+  }
+  /**
+   * Fix the state before the transaction on disk and begin the transaction of the internal
+   * database.
+   * @return true on success, or false on failure.
+   * @note This must be called before the first update in the transaction, without locking any
+   * node.  The dirty nodes and the meta data are written so that the internal database rolls
+   * back to a consistent tree if the process crashes in the transaction.  Nodes dirtied outside
+   * the transaction are written only once, as they would be at the commit.
+   */
+  bool fix_transaction_base() {
+    _assert_(true);
+    ScopedMutex lock(&trlock_);
+    if (trbegun_) return true;
+    bool err = false;
+    if (!clean_leaf_cache()) err = true;
+    if (!clean_inner_cache()) err = true;
+    if (err) return false;
     if ((trlcnt_ != lcnt_ || count_ != trcount_) && !dump_meta()) return false;
-    if (!db_.begin_transaction(hard)) return false;
+    trmeta_.trlcnt = trlcnt_;
+    trmeta_.trcount = trcount_;
+    if (!db_.begin_transaction(trhard_)) return false;
+    trbegun_ = true;
     return true;
   }
   /**
@@ -3528,9 +4292,12 @@ class PlantDB : public BasicDB {
    */
   bool commit_transaction() {
     _assert_(true);
+    if (!trbegun_) return true;
+    trbegun_ = false;
     bool err = false;
-    if (!clean_leaf_cache()) return false;
-    if (!clean_inner_cache()) return false;
+    if (!clean_leaf_cache()) err = true;
+    if (!clean_inner_cache()) err = true;
+    if (err) return false;
     if ((trlcnt_ != lcnt_ || count_ != trcount_) && !dump_meta()) err = true;
     if (!db_.end_transaction(true)) return false;
     return !err;
@@ -3541,14 +4308,60 @@ class PlantDB : public BasicDB {
    */
   bool abort_transaction() {
     _assert_(true);
+    if (!trbegun_) return true;
+    trbegun_ = false;
     bool err = false;
-    flush_leaf_cache(false);
-    flush_inner_cache(false);
+    for (int32_t i = SLOTNUM - 1; i >= 0; i--) {
+      LeafSlot* lslot = lslots_ + i;
+      LeafCache* caches[] = { lslot->warm, lslot->hot };
+      for (size_t j = 0; j < sizeof(caches) / sizeof(*caches); j++) {
+        typename LeafCache::Iterator it = caches[j]->begin();
+        typename LeafCache::Iterator itend = caches[j]->end();
+        while (it != itend) {
+          LeafNode* node = it.value();
+          ++it;
+          if (node->trepoch == trepoch_) flush_leaf_node(node, false);
+        }
+      }
+      InnerSlot* islot = islots_ + i;
+      typename InnerCache::Iterator it = islot->warm->begin();
+      typename InnerCache::Iterator itend = islot->warm->end();
+      while (it != itend) {
+        InnerNode* node = it.value();
+        ++it;
+        if (node->trepoch == trepoch_) flush_inner_node(node, false);
+      }
+    }
     if (!db_.end_transaction(false)) err = true;
-    if (!load_meta()) err = true;
+    root_ = trmeta_.root;
+    first_ = trmeta_.first;
+    last_ = trmeta_.last;
+    lcnt_ = trmeta_.lcnt;
+    icnt_ = trmeta_.icnt;
+    count_ = trmeta_.count;
+    trlcnt_ = trmeta_.trlcnt;
+    trcount_ = trmeta_.trcount;
     disable_cursors();
     return !err;
   }
+  /**
+   * Mark a leaf node as touched in the transaction.
+   * @param node the leaf node.
+   * @note The nodes marked are dropped from the cache when the transaction is aborted.
+   */
+  void touch_leaf_node(LeafNode* node) {
+    _assert_(node);
+    if (tran_) node->trepoch = trepoch_;
+  }
+  /**
+   * Mark an inner node as touched in the transaction.
+   * @param node the inner node.
+   * @note The nodes marked are dropped from the cache when the transaction is aborted.
+   */
+  void touch_inner_node(InnerNode* node) {
+    _assert_(node);
+    if (tran_) node->trepoch = trepoch_;
+  }
   /**
    * Fix auto transaction for the B+ tree.
    * @return true on success, or false on failure.
@@ -3600,6 +4413,12 @@ class PlantDB : public BasicDB {
   SpinRWLock mlock_;
   /** The internal meta operation trigger. */
   MetaTrigger* mtrigger_;
+  /** The collector of runtime metrics. */
+  Metrics* mtrc_;
+  /** The shared cache manager. */
+  CacheManager* cmgr_;
+  /** The slot of the shared cache manager. */
+  CacheManager::Slot* cmslot_;
   /** The open mode. */
   uint32_t omode_;
   /** The flag for writer. */
@@ -3654,6 +4473,36 @@ class PlantDB : public BasicDB {
   int64_t trlcnt_;
   /** The record count history for transaction. */
   int64_t trcount_;
+  /** The epoch of the current transaction. */
+  int64_t trepoch_;
+  /** The meta data at the beginning of the transaction. */
+  TranMeta trmeta_;
+  /** The flag whether the transaction is synchronized physically. */
+  bool trhard_;
+  /** The flag whether the transaction of the internal database is begun. */
+  bool trbegun_;
+  /** The lock for beginning the transaction of the internal database. */
+  Mutex trlock_;
+  /** The lock for the write buffer. */
+  SpinRWLock wblock_;
+  /** The capacity size of the write buffer. */
+  int64_t wbcap_;
+  /** The write buffer. */
+  WriteBuffer wbuf_;
+  /** The total size of the write buffer. */
+  int64_t wbsize_;
+  /** The difference of the record number by the write buffer. */
+  int64_t wbdelta_;
+  /** The number of operations hitting the write buffer. */
+  AtomicInt64 wbhit_;
+  /** The number of operations missing the write buffer. */
+  AtomicInt64 wbmiss_;
+  /** The number of flushes of the write buffer. */
+  int64_t wbflcnt_;
+  /** The number of records flushed from the write buffer. */
+  int64_t wbflrec_;
+  /** The total time of flushing the write buffer. */
+  double wbfltime_;
 };
 
 
@@ -31,6 +31,11 @@
 #include <kccachedb.h>
 #include <kchashdb.h>
 #include <kcdirdb.h>
+#include <kclogdb.h>
+#include <kctierdb.h>
+#include <kccaskdb.h>
+
+#define KCPDTRMAGICDATA  "KCTR\n"        ///< The magic data of the trace file
 
 namespace kyotocabinet {                 // common namespace
 
@@ -48,10 +53,39 @@ namespace kyotocabinet {                 // common namespace
 class PolyDB : public BasicDB {
  public:
   class Cursor;
+  class MergeReducer;
+  struct TraceRecord;
+  class TraceReader;
  private:
   class StreamLogger;
   class StreamMetaTrigger;
+  class TraceWriter;
+  class TraceVisitor;
+  class ScanQueue;
+  struct MergeChunk;
+  class MergeQueue;
+  class MergeReader;
   struct MergeLine;
+  class MergeVisitor;
+  class MatchVisitor;
+  /** An alias of vector of values to be merged. */
+  typedef std::vector<std::string> MergeValues;
+  /** The size of a read-ahead chunk of each merging source. */
+  static const size_t MERGECHUNKSIZ = 1 << 20;
+  /** The maximum number of read-ahead chunks of each merging source. */
+  static const size_t MERGECHUNKNUM = 2;
+  /** The maximum number of threads reading merging sources ahead. */
+  static const size_t MERGETHNUM = 4;
+  /** The maximum number of records in a batch written into the merging destination. */
+  static const size_t MERGEBATCHNUM = 1024;
+  /** The maximum size of a batch written into the merging destination. */
+  static const size_t MERGEBATCHSIZ = 4 << 20;
+  /** The size of the output buffer of the trace. */
+  static const size_t TRBUFSIZ = 1 << 16;
+  /** The flag of the trace whose keys are hashed. */
+  static const uint8_t TRFHASH = 1 << 0;
+  /** The number of records in each batch of parallel scanning. */
+  static const size_t SCANBATCHNUM = 1024;
  public:
   /**
    * Cursor to indicate a record.
@@ -95,8 +129,31 @@ class PolyDB : public BasicDB {
         db_->set_error(_KCCODELINE_, Error::INVALID, "not opened");
         return false;
       }
+      if (db_->trace_) {
+        TraceVisitor tvisitor(db_->trace_, visitor);
+        return cur_->accept(&tvisitor, writable, step);
+      }
       return cur_->accept(visitor, writable, step);
     }
+    /**
+     * Accept a visitor to the current record and the following records.
+     * @param visitor a visitor object.
+     * @param max the maximum number of records to visit.
+     * @param writable true for writable operation, or false for read-only operation.
+     * @return the number of visited records, or -1 on failure.
+     */
+    int64_t accept_batch(Visitor* visitor, int64_t max, bool writable = false) {
+      _assert_(visitor);
+      if (db_->type_ == TYPEVOID) {
+        db_->set_error(_KCCODELINE_, Error::INVALID, "not opened");
+        return -1;
+      }
+      if (db_->trace_) {
+        TraceVisitor tvisitor(db_->trace_, visitor);
+        return cur_->accept_batch(&tvisitor, max, writable);
+      }
+      return cur_->accept_batch(visitor, max, writable);
+    }
     /**
      * Jump the cursor to the first record for forward scan.
      * @return true on success, or false on failure.
@@ -227,13 +284,173 @@ class PolyDB : public BasicDB {
     MREPLACE,                            ///< modify the existing record only
     MAPPEND                              ///< append the new value
   };
+  /**
+   * Interface to reduce the values of a record in merging.
+   */
+  class MergeReducer {
+   public:
+    /**
+     * Destructor.
+     */
+    virtual ~MergeReducer() {
+      _assert_(true);
+    }
+    /**
+     * Reduce the existing value and a new value of a record.
+     * @param kbuf the pointer to the key region.
+     * @param ksiz the size of the key region.
+     * @param obuf the pointer to the region of the existing value.
+     * @param osiz the size of the region of the existing value.
+     * @param nbuf the pointer to the region of the new value.
+     * @param nsiz the size of the region of the new value.
+     * @param sp the pointer to the variable into which the size of the region of the return
+     * value is assigned.
+     * @return If it is the pointer to a region, the value is replaced by the content.  If it
+     * is Visitor::NOP, the existing value is kept.  If it is Visitor::REMOVE, the record is
+     * removed.
+     * @note This function is called only if the record exists.  Otherwise, the new value is
+     * stored as it is.  The region of the return value should be kept valid until the next
+     * call.
+     */
+    virtual const char* reduce(const char* kbuf, size_t ksiz, const char* obuf, size_t osiz,
+                               const char* nbuf, size_t nsiz, size_t* sp) = 0;
+  };
+  /**
+   * Kinds of traced operations.
+   */
+  enum TraceKind {
+    TRGET = 1,                           ///< visiting an existing record without update
+    TRMISS,                              ///< visiting a missing record without update
+    TRSET,                               ///< updating an existing record
+    TRADD,                               ///< adding a new record
+    TRREMOVE,                            ///< removing a record
+    TRITERATE,                           ///< iteration
+    TRSYNC,                              ///< synchronization
+    TRBEGIN,                             ///< beginning transaction
+    TRCOMMIT,                            ///< committing transaction
+    TRABORT,                             ///< aborting transaction
+    TRCLEAR                              ///< clearing
+  };
+  /**
+   * Record of the operation trace.
+   */
+  struct TraceRecord {
+    uint8_t kind;                        ///< kind of the operation
+    uint32_t thid;                       ///< ID of the thread in the trace
+    int64_t time;                        ///< elapsed time in microseconds
+    std::string key;                     ///< key
+    int64_t vsiz;                        ///< size of the visited or stored value
+  };
+  /**
+   * Reader of the operation trace.
+   * @note If the keys of the trace are hashed, each key is given as the hexadecimal string of
+   * the hash value.
+   */
+  class TraceReader {
+   public:
+    /**
+     * Default constructor.
+     */
+    explicit TraceReader() : ifs_(), hashed_(false), time_(0) {
+      _assert_(true);
+    }
+    /**
+     * Open a trace file.
+     * @param path the path of the trace file.
+     * @return true on success, or false on failure.
+     */
+    bool open(const std::string& path) {
+      _assert_(true);
+      ifs_.open(path.c_str(), std::ios_base::in | std::ios_base::binary);
+      if (!ifs_) return false;
+      char head[sizeof(KCPDTRMAGICDATA)+1];
+      ifs_.read(head, sizeof(head));
+      if (ifs_.fail() || std::memcmp(head, KCPDTRMAGICDATA, sizeof(KCPDTRMAGICDATA))) {
+        ifs_.close();
+        return false;
+      }
+      hashed_ = (head[sizeof(KCPDTRMAGICDATA)] & TRFHASH) != 0;
+      time_ = 0;
+      return true;
+    }
+    /**
+     * Close the trace file.
+     */
+    void close() {
+      _assert_(true);
+      ifs_.close();
+    }
+    /**
+     * Read the next record.
+     * @param rec the structure to contain the result.
+     * @return true on success, or false at the end of the trace or on broken data.
+     */
+    bool read(TraceRecord* rec) {
+      _assert_(rec);
+      int32_t c = ifs_.get();
+      if (ifs_.fail()) return false;
+      rec->kind = c;
+      uint64_t num;
+      if (!read_number(&num)) return false;
+      rec->thid = num;
+      if (!read_number(&num)) return false;
+      time_ += num;
+      rec->time = time_;
+      if (!read_number(&num) || num > MEMMAXSIZ) return false;
+      size_t ksiz = num;
+      rec->key.resize(ksiz);
+      if (ksiz > 0) {
+        ifs_.read(&rec->key[0], ksiz);
+        if (ifs_.fail()) return false;
+        if (hashed_ && ksiz == sizeof(uint64_t)) {
+          uint64_t hash;
+          std::memcpy(&hash, rec->key.data(), sizeof(hash));
+          rec->key = strprintf("%016llx", (unsigned long long)ntoh64(hash));
+        }
+      }
+      if (!read_number(&num)) return false;
+      rec->vsiz = num;
+      return true;
+    }
+    /**
+     * Check whether the keys of the trace are hashed.
+     * @return true if the keys are hashed, or false if not.
+     */
+    bool hashed() const {
+      _assert_(true);
+      return hashed_;
+    }
+   private:
+    /**
+     * Read a variable length number.
+     */
+    bool read_number(uint64_t* np) {
+      _assert_(np);
+      uint64_t num = 0;
+      int32_t c;
+      do {
+        c = ifs_.get();
+        if (ifs_.fail()) return false;
+        num = (num << 7) + (c & 0x7f);
+      } while (c >= 0x80);
+      *np = num;
+      return true;
+    }
+    /** The input stream. */
+    std::ifstream ifs_;
+    /** The flag whether the keys are hashed. */
+    bool hashed_;
+    /** The elapsed time of the last record. */
+    int64_t time_;
+  };
   /**
    * Default constructor.
    */
   explicit PolyDB() :
-      type_(TYPEVOID), db_(NULL), error_(),
+      type_(TYPEVOID), db_(NULL), bdb_(NULL), error_(),
       stdlogstrm_(NULL), stdlogger_(NULL), logger_(NULL), logkinds_(0),
-      stdmtrgstrm_(NULL), stdmtrigger_(NULL), mtrigger_(NULL), zcomp_(NULL) {
+      stdmtrgstrm_(NULL), stdmtrigger_(NULL), mtrigger_(NULL), cmgr_(NULL), mop_(NULL),
+      zcomp_(NULL), trace_(NULL) {
     _assert_(true);
   }
   /**
@@ -243,6 +460,7 @@ class PolyDB : public BasicDB {
   virtual ~PolyDB() {
     _assert_(true);
     if (type_ != TYPEVOID) close();
+    delete trace_;
     delete zcomp_;
     delete stdmtrigger_;
     delete stdmtrgstrm_;
@@ -282,8 +500,106 @@ class PolyDB : public BasicDB {
       set_error(_KCCODELINE_, Error::INVALID, "not opened");
       return false;
     }
+    if (trace_) {
+      TraceVisitor tvisitor(trace_, visitor);
+      return db_->accept(kbuf, ksiz, &tvisitor, writable);
+    }
     return db_->accept(kbuf, ksiz, visitor, writable);
   }
+  /**
+   * Retrieve a part of the value of a record.
+   * @param kbuf the pointer to the key region.
+   * @param ksiz the size of the key region.
+   * @param off the offset in the value where the part begins.
+   * @param vbuf the pointer to the buffer into which the part of the value is written.
+   * @param max the size of the buffer.
+   * @return the size of the written part, or -1 on failure.
+   * @note The operation is delegated to the inner database unless it is traced.
+   */
+  int64_t get_range(const char* kbuf, size_t ksiz, int64_t off, char* vbuf, size_t max) {
+    _assert_(kbuf && ksiz <= MEMMAXSIZ && off >= 0 && vbuf);
+    if (type_ == TYPEVOID) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return -1;
+    }
+    if (trace_) return BasicDB::get_range(kbuf, ksiz, off, vbuf, max);
+    return db_->get_range(kbuf, ksiz, off, vbuf, max);
+  }
+  /**
+   * Overwrite a part of the value of a record.
+   * @param kbuf the pointer to the key region.
+   * @param ksiz the size of the key region.
+   * @param off the offset in the value where the part begins.
+   * @param vbuf the pointer to the region of the part.
+   * @param vsiz the size of the region of the part.
+   * @return true on success, or false on failure.
+   * @note The operation is delegated to the inner database unless it is traced.
+   */
+  bool write_range(const char* kbuf, size_t ksiz, int64_t off, const char* vbuf, size_t vsiz) {
+    _assert_(kbuf && ksiz <= MEMMAXSIZ && off >= 0 && vbuf && vsiz <= MEMMAXSIZ);
+    if (type_ == TYPEVOID) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
+    }
+    if (trace_) return BasicDB::write_range(kbuf, ksiz, off, vbuf, vsiz);
+    return db_->write_range(kbuf, ksiz, off, vbuf, vsiz);
+  }
+  /**
+   * Append the value of a record.
+   * @param kbuf the pointer to the key region.
+   * @param ksiz the size of the key region.
+   * @param vbuf the pointer to the value region.
+   * @param vsiz the size of the value region.
+   * @return true on success, or false on failure.
+   * @note The operation is delegated to the inner database unless it is traced, so that the
+   * value can be extended in place by the file hash database.
+   */
+  bool append(const char* kbuf, size_t ksiz, const char* vbuf, size_t vsiz) {
+    _assert_(kbuf && ksiz <= MEMMAXSIZ && vbuf && vsiz <= MEMMAXSIZ);
+    if (type_ == TYPEVOID) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
+    }
+    if (trace_) return BasicDB::append(kbuf, ksiz, vbuf, vsiz);
+    return db_->append(kbuf, ksiz, vbuf, vsiz);
+  }
+  /**
+   * Append the value of a record.
+   * @note Equal to the original DB::append method except that the parameters are std::string.
+   */
+  bool append(const std::string& key, const std::string& value) {
+    _assert_(true);
+    return append(key.c_str(), key.size(), value.c_str(), value.size());
+  }
+  /**
+   * Merge an operand into the value of a record.
+   * @param kbuf the pointer to the key region.
+   * @param ksiz the size of the key region.
+   * @param obuf the pointer to the operand region.
+   * @param osiz the size of the operand region.
+   * @param mop the merge operator.
+   * @return true on success, or false on failure.
+   * @note The operation is delegated to the inner database unless it is traced.
+   */
+  bool merge_operand(const char* kbuf, size_t ksiz, const char* obuf, size_t osiz,
+                     MergeOperator* mop) {
+    _assert_(kbuf && ksiz <= MEMMAXSIZ && obuf && osiz <= MEMMAXSIZ && mop);
+    if (type_ == TYPEVOID) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
+    }
+    if (trace_) return BasicDB::merge_operand(kbuf, ksiz, obuf, osiz, mop);
+    return db_->merge_operand(kbuf, ksiz, obuf, osiz, mop);
+  }
+  /**
+   * Merge an operand into the value of a record.
+   * @note Equal to the original DB::merge_operand method except that the parameters are
+   * std::string.
+   */
+  bool merge_operand(const std::string& key, const std::string& operand, MergeOperator* mop) {
+    _assert_(mop);
+    return merge_operand(key.c_str(), key.size(), operand.c_str(), operand.size(), mop);
+  }
   /**
    * Accept a visitor to multiple records at once.
    * @param keys specifies a string vector of the keys.
@@ -301,6 +617,10 @@ class PolyDB : public BasicDB {
       set_error(_KCCODELINE_, Error::INVALID, "not opened");
       return false;
     }
+    if (trace_) {
+      TraceVisitor tvisitor(trace_, visitor);
+      return db_->accept_bulk(keys, &tvisitor, writable);
+    }
     return db_->accept_bulk(keys, visitor, writable);
   }
   /**
@@ -318,8 +638,74 @@ class PolyDB : public BasicDB {
       set_error(_KCCODELINE_, Error::INVALID, "not opened");
       return false;
     }
+    if (trace_) trace_->write(TRITERATE, NULL, 0, 0);
     return db_->iterate(visitor, writable, checker);
   }
+  /**
+   * Scan each record in parallel.
+   * @param visitor a visitor object.
+   * @param thnum the number of worker threads.
+   * @param checker a progress checker object.  If it is NULL, no checking is performed.
+   * @return true on success, or false on failure.
+   * @note This function is for reading records and not for updating ones.  The return value of
+   * the visitor is just ignored.  The visitor is called by the worker threads concurrently, so
+   * it must be thread-safe.  Records are read by a cursor in batches, so other threads are not
+   * blocked through the whole scanning and the result is not necessarily a snapshot.
+   */
+  bool scan_parallel(Visitor *visitor, size_t thnum, ProgressChecker* checker = NULL) {
+    _assert_(visitor && thnum <= MEMMAXSIZ);
+    if (type_ == TYPEVOID) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
+    }
+    if (thnum < 1) thnum = 1;
+    if (trace_) trace_->write(TRITERATE, NULL, 0, 0);
+    int64_t allcnt = db_->count();
+    if (checker && !checker->check("scan_parallel", "beginning", 0, allcnt)) {
+      set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
+      return false;
+    }
+    visitor->visit_before();
+    bool err = false;
+    ScanQueue queue(visitor);
+    queue.start(thnum);
+    BasicDB::Cursor* cur = db_->cursor();
+    bool ok = cur->jump();
+    if (!ok && db_->error() != Error::NOREC) err = true;
+    int64_t curcnt = 0;
+    while (ok) {
+      ScanQueue::RecordTask* task = new ScanQueue::RecordTask;
+      task->recs.reserve(SCANBATCHNUM);
+      for (size_t i = 0; i < SCANBATCHNUM; i++) {
+        task->recs.resize(task->recs.size() + 1);
+        std::pair<std::string, std::string>& rec = task->recs.back();
+        if (!cur->get(&rec.first, &rec.second, true)) {
+          task->recs.pop_back();
+          if (db_->error() != Error::NOREC) err = true;
+          ok = false;
+          break;
+        }
+      }
+      curcnt += task->recs.size();
+      if (ok && checker && !checker->check("scan_parallel", "processing", curcnt, allcnt)) {
+        set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
+        err = true;
+        ok = false;
+      }
+      while (queue.count() > (int64_t)thnum * 2) {
+        Thread::sleep(1.0 / CLOCKTICK);
+      }
+      queue.add_task(task);
+    }
+    delete cur;
+    queue.finish();
+    visitor->visit_after();
+    if (!err && checker && !checker->check("scan_parallel", "ending", -1, allcnt)) {
+      set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
+      err = true;
+    }
+    return !err;
+  }
   /**
    * Get the last happened error.
    * @return the last happened error.
@@ -361,27 +747,35 @@ class PolyDB : public BasicDB {
   }
   /**
    * Open a database file.
-   * @param path the path of a database file.  If it is "-", the database will be a prototype
-   * hash database.  If it is "+", the database will be a prototype tree database.  If it is ":",
-   * the database will be a stash database.  If it is "*", the database will be a cache hash
-   * database.  If it is "%", the database will be a cache tree database.  If its suffix is
-   * ".kch", the database will be a file hash database.  If its suffix is ".kct", the database
-   * will be a file tree database.  If its suffix is ".kcd", the database will be a directory
-   * hash database.  If its suffix is ".kcf", the database will be a directory tree database.
-   * Otherwise, this function fails.  Tuning parameters can trail the name, separated by "#".
-   * Each parameter is composed of the name and the value, separated by "=".  If the "type"
-   * parameter is specified, the database type is determined by the value in "-", "+", ":", "*",
-   * "%", "kch", "kct", "kcd", and "kcf".  All database types support the logging parameters of
-   * "log", "logkinds", and "logpx".  The prototype hash database and the prototype tree
-   * database do not support any other tuning parameter.  The stash database supports "bnum".
-   * The cache hash database supports "opts", "bnum", "zcomp", "capcnt", "capsiz", and "zkey".
-   * The cache tree database supports all parameters of the cache hash database except for
-   * capacity limitation, and supports "psiz", "rcomp", "pccap" in addition.  The file hash
-   * database supports "apow", "fpow", "opts", "bnum", "msiz", "dfunit", "zcomp", and "zkey".
-   * The file tree database supports all parameters of the file hash database and "psiz",
-   * "rcomp", "pccap" in addition.  The directory hash database supports "opts", "zcomp", and
-   * "zkey".  The directory tree database supports all parameters of the directory hash database
-   * and "psiz", "rcomp", "pccap" in addition.
+   * @param path the path of a database file.  If it is "-", the database will be a prototype hash
+   * database.  If it is "+", the database will be a prototype tree database.  If it is ":", the
+   * database will be a stash database.  If it is "*", the database will be a cache hash database.
+   * If it is "%", the database will be a cache tree database.  If its suffix is ".kch", the
+   * database will be a file hash database.  If its suffix is ".kct", the database will be a file
+   * tree database.  If its suffix is ".kcd", the database will be a directory hash database.  If
+   * its suffix is ".kcf", the database will be a directory tree database.  If its suffix is ".kcl",
+   * the database will be a log-structured tree database.  If its suffix is ".kcb", the database
+   * will be a log-structured hash database.  Otherwise, this function fails.  Tuning parameters can
+   * trail the name, separated by "#".  Each parameter is composed of the name and the value,
+   * separated by "=".  If the "type" parameter is specified, the database type is determined by the
+   * value in "-", "+", ":", "*", "%", "kch", "kct", "kcd", "kcf", "kcl", and "kcb".  All database
+   * types support the logging parameters of "log", "logkinds", and "logpx".  The prototype hash
+   * database and the prototype tree database do not support any other tuning parameter.  The stash
+   * database supports "bnum".  The cache hash database supports "opts", "bnum", "zcomp", "capcnt",
+   * "capsiz", and "zkey".  The cache tree database supports all parameters of the cache hash
+   * database except for capacity limitation, and supports "psiz", "rcomp", "pccap" in addition.
+   * The file hash database supports "apow", "fpow", "opts", "bnum", "msiz", "dfunit", "jnunit",
+   * "bthres", "bgcratio", "sratio", "zcomp", and "zkey".  The file tree database supports all
+   * parameters of the file hash database except for "bthres", "bgcratio", and "sratio", and
+   * supports "psiz", "rcomp", "pccap", "wbcap" in addition.  The directory hash database supports
+   * "opts", "zcomp", and "zkey".  The directory tree database supports all parameters of the
+   * directory hash database and "psiz", "rcomp", "pccap", "wbcap" in addition.  The log-structured
+   * tree database supports "opts", "zcomp", "zkey", "psiz", "rcomp", "pccap", "mtcap", and
+   * "cmpnum".  The log-structured hash database supports "bnum", "segcap", and "mgratio".  The
+   * cache hash database, the cache tree database, the file hash database, the file tree database,
+   * and the directory tree database support "metrics" in addition.  All database types support the
+   * tracing parameters of "trace" and "trhash" and the tiering parameters of "tier", "tiercap",
+   * "tierwb", and "tierintv".
    * @param mode the connection mode.  PolyDB::OWRITER as a writer, PolyDB::OREADER as a
    * reader.  The following may be added to the writer mode by bitwise-or: PolyDB::OCREATE,
    * which means it creates a new database if the file does not exist, PolyDB::OTRUNCATE, which
@@ -398,17 +792,27 @@ class PolyDB : public BasicDB {
    * the path of the log file, or "-" for the standard output, or "+" for the standard error.
    * "logkinds" specifies kinds of logged messages and the value can be "debug", "info", "warn",
    * or "error".  "logpx" specifies the prefix of each log message.  "opts" is for "tune_options"
-   * and the value can contain "s" for the small option, "l" for the linear option, and "c" for
-   * the compress option.  "bnum" corresponds to "tune_bucket".  "zcomp" is for "tune_compressor"
-   * and the value can be "zlib" for the ZLIB raw compressor, "def" for the ZLIB deflate
-   * compressor, "gz" for the ZLIB gzip compressor, "lzo" for the LZO compressor, "lzma" for the
-   * LZMA compressor, or "arc" for the Arcfour cipher.  "zkey" specifies the cipher key of the
-   * compressor.  "capcnt" is for "cap_count".  "capsiz" is for "cap_size".  "psiz" is for
-   * "tune_page".  "rcomp" is for "tune_comparator" and the value can be "lex" for the lexical
+   * and the value can contain "s" for the small option, "l" for the linear option, "c" for the
+   * compress option, and "p" for the page option.  "bnum" corresponds to "tune_bucket".  "zcomp"
+   * is for "tune_compressor" and the value can be "zlib" for the ZLIB raw compressor, "def" for
+   * the ZLIB deflate compressor, "gz" for the ZLIB gzip compressor, "lzo" for the LZO compressor,
+   * "lzma" for the LZMA compressor, or "arc" for the Arcfour cipher.  "zkey" specifies the cipher
+   * key of the compressor.  "capcnt" is for "cap_count".  "capsiz" is for "cap_size".  "psiz" is
+   * for "tune_page".  "rcomp" is for "tune_comparator" and the value can be "lex" for the lexical
    * comparator, "dec" for the decimal comparator, "lexdesc" for the lexical descending
    * comparator, or "decdesc" for the decimal descending comparator.  "pccap" is for
-   * "tune_page_cache".  "apow" is for "tune_alignment".  "fpow" is for "tune_fbp".  "msiz" is
-   * for "tune_map".  "dfunit" is for "tune_defrag".  Every opened database must be closed by
+   * "tune_page_cache".  "apow" is for "tune_alignment".  "fpow" is for "tune_fbp".  "msiz" is for
+   * "tune_map".  "dfunit" is for "tune_defrag".  "jnunit" is for "tune_journal".  "bthres" and
+   * "bgcratio" are for "tune_blob".  "sratio" is for "tune_slack".  "wbcap" is for
+   * "tune_write_buffer".  "mtcap" is for "tune_memtable".  "cmpnum" is for "tune_compaction".
+   * "segcap" is for "tune_segment".
+   * "mgratio" is for "tune_merge".  "metrics" is for "tune_metrics" and the value can be "1" to
+   * collect runtime metrics.  "trace" specifies the path of a file into which every operation is
+   * recorded in a compact binary format, which can be read by PolyDB::TraceReader.  "trhash" is
+   * "1" to record the hash values of keys instead of the keys themselves.  "tier" puts a cache in
+   * memory in front of the database by TieredDB and the value can be "wt" for the write-through
+   * mode or "wb" for the write-back mode.  "tiercap" is for "tune_cache" of the tiered database.
+   * "tierwb" and "tierintv" are for "tune_write_back".  Every opened database must be closed by
    * the PolyDB::close method when it is no longer in use.  It is not allowed for two or more
    * database objects in the same process to keep their connections to the same database file at
    * the same time.
@@ -441,12 +845,29 @@ class PolyDB : public BasicDB {
     bool tsmall = false;
     bool tlinear = false;
     bool tcompress = false;
+    bool tpage = false;
     int64_t msiz = -1;
     int64_t dfunit = -1;
+    int64_t jnunit = -1;
+    int64_t bthres = -1;
+    double bgcratio = -1;
+    double sratio = -1;
     std::string zcompname = "";
     int64_t psiz = -1;
     Comparator* rcomp = NULL;
     int64_t pccap = 0;
+    int64_t wbcap = 0;
+    int64_t mtcap = -1;
+    int32_t cmpnum = -1;
+    int64_t segcap = -1;
+    double mgratio = -1;
+    bool metrics = false;
+    std::string trpath = "";
+    bool trhash = false;
+    std::string tiername = "";
+    int64_t tiercap = -1;
+    int64_t tierwb = -1;
+    double tierintv = -1;
     std::string zkey = "";
     std::vector<std::string>::iterator it = elems.begin();
     std::vector<std::string>::iterator itend = elems.end();
@@ -489,6 +910,10 @@ class PolyDB : public BasicDB {
           type = TYPEDIR;
         } else if (!std::strcmp(pv, "kcf") || !std::strcmp(pv, "fdb")) {
           type = TYPEFOREST;
+        } else if (!std::strcmp(pv, "kcl") || !std::strcmp(pv, "ldb")) {
+          type = TYPELTREE;
+        } else if (!std::strcmp(pv, "kcb") || !std::strcmp(pv, "bdb")) {
+          type = TYPECASK;
         }
       }
     }
@@ -525,6 +950,12 @@ class PolyDB : public BasicDB {
           } else if (!std::strcmp(value, "kcf") || !std::strcmp(value, "fdb") ||
                      !std::strcmp(value, "for") || !std::strcmp(value, "forest")) {
             type = TYPEFOREST;
+          } else if (!std::strcmp(value, "kcl") || !std::strcmp(value, "ldb") ||
+                     !std::strcmp(value, "ltree") || !std::strcmp(value, "logtree")) {
+            type = TYPELTREE;
+          } else if (!std::strcmp(value, "kcb") || !std::strcmp(value, "bdb") ||
+                     !std::strcmp(value, "cask") || !std::strcmp(value, "bitcask")) {
+            type = TYPECASK;
           }
         } else if (!std::strcmp(key, "log") || !std::strcmp(key, "logger")) {
           logname = value;
@@ -563,16 +994,49 @@ class PolyDB : public BasicDB {
           if (std::strchr(value, 's')) tsmall = true;
           if (std::strchr(value, 'l')) tlinear = true;
           if (std::strchr(value, 'c')) tcompress = true;
+          if (std::strchr(value, 'p')) tpage = true;
         } else if (!std::strcmp(key, "msiz") || !std::strcmp(key, "map")) {
           msiz = atoix(value);
         } else if (!std::strcmp(key, "dfunit") || !std::strcmp(key, "defrag")) {
           dfunit = atoix(value);
+        } else if (!std::strcmp(key, "jnunit") || !std::strcmp(key, "journal")) {
+          jnunit = atoix(value);
+        } else if (!std::strcmp(key, "bthres") || !std::strcmp(key, "blob")) {
+          bthres = atoix(value);
+        } else if (!std::strcmp(key, "bgcratio")) {
+          bgcratio = atof(value);
+        } else if (!std::strcmp(key, "sratio") || !std::strcmp(key, "slack")) {
+          sratio = atof(value);
         } else if (!std::strcmp(key, "zcomp") || !std::strcmp(key, "compressor")) {
           zcompname = value;
         } else if (!std::strcmp(key, "psiz") || !std::strcmp(key, "page")) {
           psiz = atoix(value);
         } else if (!std::strcmp(key, "pccap") || !std::strcmp(key, "cache")) {
           pccap = atoix(value);
+        } else if (!std::strcmp(key, "wbcap") || !std::strcmp(key, "wbuf")) {
+          wbcap = atoix(value);
+        } else if (!std::strcmp(key, "mtcap") || !std::strcmp(key, "memtable")) {
+          mtcap = atoix(value);
+        } else if (!std::strcmp(key, "cmpnum") || !std::strcmp(key, "compaction")) {
+          cmpnum = atoix(value);
+        } else if (!std::strcmp(key, "segcap") || !std::strcmp(key, "segment")) {
+          segcap = atoix(value);
+        } else if (!std::strcmp(key, "mgratio") || !std::strcmp(key, "merge")) {
+          mgratio = atof(value);
+        } else if (!std::strcmp(key, "metrics") || !std::strcmp(key, "mtrc")) {
+          metrics = atoix(value) > 0;
+        } else if (!std::strcmp(key, "trace")) {
+          trpath = value;
+        } else if (!std::strcmp(key, "trhash") || !std::strcmp(key, "tracehash")) {
+          trhash = atoix(value) > 0;
+        } else if (!std::strcmp(key, "tier")) {
+          tiername = value;
+        } else if (!std::strcmp(key, "tiercap") || !std::strcmp(key, "tiercache")) {
+          tiercap = atoix(value);
+        } else if (!std::strcmp(key, "tierwb") || !std::strcmp(key, "tierwbcap")) {
+          tierwb = atoix(value);
+        } else if (!std::strcmp(key, "tierintv") || !std::strcmp(key, "tierinterval")) {
+          tierintv = atof(value);
         } else if (!std::strcmp(key, "rcomp") || !std::strcmp(key, "comparator")) {
           if (!std::strcmp(value, "lex") || !std::strcmp(value, "lexical")) {
             rcomp = LEXICALCOMP;
@@ -738,6 +1202,8 @@ class PolyDB : public BasicDB {
         if (zcomp_) cdb->tune_compressor(zcomp_);
         if (capcnt > 0) cdb->cap_count(capcnt);
         if (capsiz > 0) cdb->cap_size(capsiz);
+        if (metrics) cdb->tune_metrics();
+        if (cmgr_) cdb->tune_cache_manager(cmgr_);
         db = cdb;
         break;
       }
@@ -761,6 +1227,8 @@ class PolyDB : public BasicDB {
         if (zcomp_) gdb->tune_compressor(zcomp_);
         if (pccap > 0) gdb->tune_page_cache(pccap);
         if (rcomp) gdb->tune_comparator(rcomp);
+        if (metrics) gdb->tune_metrics();
+        if (cmgr_) gdb->tune_cache_manager(cmgr_);
         db = gdb;
         break;
       }
@@ -769,6 +1237,7 @@ class PolyDB : public BasicDB {
         if (tsmall) opts |= HashDB::TSMALL;
         if (tlinear) opts |= HashDB::TLINEAR;
         if (tcompress) opts |= HashDB::TCOMPRESS;
+        if (tpage) opts |= HashDB::TPAGE;
         HashDB* hdb = new HashDB();
         if (stdlogger_) {
           hdb->tune_logger(stdlogger_, logkinds);
@@ -786,7 +1255,11 @@ class PolyDB : public BasicDB {
         if (bnum > 0) hdb->tune_buckets(bnum);
         if (msiz >= 0) hdb->tune_map(msiz);
         if (dfunit > 0) hdb->tune_defrag(dfunit);
+        if (jnunit > 0) hdb->tune_journal(jnunit);
+        if (bthres > 0) hdb->tune_blob(bthres, bgcratio >= 0 ? bgcratio : 0.5);
+        if (sratio > 0) hdb->tune_slack(sratio);
         if (zcomp_) hdb->tune_compressor(zcomp_);
+        if (metrics) hdb->tune_metrics();
         db = hdb;
         break;
       }
@@ -813,9 +1286,13 @@ class PolyDB : public BasicDB {
         if (psiz > 0) tdb->tune_page(psiz);
         if (msiz >= 0) tdb->tune_map(msiz);
         if (dfunit > 0) tdb->tune_defrag(dfunit);
+        if (jnunit > 0) tdb->tune_journal(jnunit);
         if (zcomp_) tdb->tune_compressor(zcomp_);
         if (pccap > 0) tdb->tune_page_cache(pccap);
+        if (wbcap > 0) tdb->tune_write_buffer(wbcap);
         if (rcomp) tdb->tune_comparator(rcomp);
+        if (metrics) tdb->tune_metrics();
+        if (cmgr_) tdb->tune_cache_manager(cmgr_);
         db = tdb;
         break;
       }
@@ -857,16 +1334,80 @@ class PolyDB : public BasicDB {
         if (psiz > 0) fdb->tune_page(psiz);
         if (zcomp_) fdb->tune_compressor(zcomp_);
         if (pccap > 0) fdb->tune_page_cache(pccap);
+        if (wbcap > 0) fdb->tune_write_buffer(wbcap);
         if (rcomp) fdb->tune_comparator(rcomp);
+        if (metrics) fdb->tune_metrics();
+        if (cmgr_) fdb->tune_cache_manager(cmgr_);
         db = fdb;
         break;
       }
+      case TYPELTREE: {
+        int8_t opts = 0;
+        if (tsmall) opts |= LogTreeDB::TSMALL;
+        if (tlinear) opts |= LogTreeDB::TLINEAR;
+        if (tcompress) opts |= LogTreeDB::TCOMPRESS;
+        LogTreeDB* ltdb = new LogTreeDB();
+        if (stdlogger_) {
+          ltdb->tune_logger(stdlogger_, logkinds);
+        } else if (logger_) {
+          ltdb->tune_logger(logger_, logkinds_);
+        }
+        if (stdmtrigger_) {
+          ltdb->tune_meta_trigger(stdmtrigger_);
+        } else if (mtrigger_) {
+          ltdb->tune_meta_trigger(mtrigger_);
+        }
+        if (opts > 0) ltdb->tune_options(opts);
+        if (psiz > 0) ltdb->tune_page(psiz);
+        if (zcomp_) ltdb->tune_compressor(zcomp_);
+        if (pccap > 0) ltdb->tune_page_cache(pccap);
+        if (rcomp) ltdb->tune_comparator(rcomp);
+        if (mtcap > 0) ltdb->tune_memtable(mtcap);
+        if (cmpnum > 0) ltdb->tune_compaction(cmpnum);
+        if (mop_) ltdb->tune_merge_operator(mop_);
+        db = ltdb;
+        break;
+      }
+      case TYPECASK: {
+        CaskDB* cdb = new CaskDB();
+        if (stdlogger_) {
+          cdb->tune_logger(stdlogger_, logkinds);
+        } else if (logger_) {
+          cdb->tune_logger(logger_, logkinds_);
+        }
+        if (stdmtrigger_) {
+          cdb->tune_meta_trigger(stdmtrigger_);
+        } else if (mtrigger_) {
+          cdb->tune_meta_trigger(mtrigger_);
+        }
+        if (bnum > 0) cdb->tune_buckets(bnum);
+        if (segcap > 0) cdb->tune_segment(segcap);
+        if (mgratio > 0) cdb->tune_merge(mgratio);
+        db = cdb;
+        break;
+      }
+    }
+    BasicDB* bdb = NULL;
+    if (!tiername.empty()) {
+      TieredDB* tidb = new TieredDB(db);
+      if (stdlogger_) {
+        tidb->tune_logger(stdlogger_, logkinds);
+      } else if (logger_) {
+        tidb->tune_logger(logger_, logkinds_);
+      }
+      if (tiername == "wb" || tiername == "back" || tiername == "writeback")
+        tidb->tune_write_mode(TieredDB::WBACK);
+      if (tiercap > 0) tidb->tune_cache(tiercap);
+      if (tierwb > 0 || tierintv > 0) tidb->tune_write_back(tierwb, tierintv);
+      bdb = db;
+      db = tidb;
     }
     if (arccomp) arccomp->set_key(zkey.c_str(), zkey.size());
     if (!db->open(fpath, mode)) {
       const Error& error = db->error();
       set_error(_KCCODELINE_, error.code(), error.message());
       delete db;
+      delete bdb;
       return false;
     }
     if (arccomp) {
@@ -875,8 +1416,21 @@ class PolyDB : public BasicDB {
       hash += (uint64_t)(time() * 256);
       arccomp->begin_cycle(hash);
     }
+    if (!trpath.empty()) {
+      TraceWriter* trace = new TraceWriter(trhash);
+      if (!trace->open(trpath)) {
+        set_error(_KCCODELINE_, Error::SYSTEM, trace->error());
+        delete trace;
+        db->close();
+        delete db;
+        delete bdb;
+        return false;
+      }
+      trace_ = trace;
+    }
     type_ = type;
     db_ = db;
+    bdb_ = bdb;
     return true;
   }
   /**
@@ -895,14 +1449,24 @@ class PolyDB : public BasicDB {
       set_error(_KCCODELINE_, error.code(), error.message());
       err = true;
     }
+    if (trace_) {
+      if (!trace_->close()) {
+        set_error(_KCCODELINE_, Error::SYSTEM, trace_->error());
+        err = true;
+      }
+      delete trace_;
+      trace_ = NULL;
+    }
     delete zcomp_;
     delete stdmtrigger_;
     delete stdmtrgstrm_;
     delete stdlogger_;
     delete stdlogstrm_;
     delete db_;
+    delete bdb_;
     type_ = TYPEVOID;
     db_ = NULL;
+    bdb_ = NULL;
     stdlogstrm_ = NULL;
     stdlogger_ = NULL;
     stdmtrgstrm_ = NULL;
@@ -928,6 +1492,7 @@ class PolyDB : public BasicDB {
       set_error(_KCCODELINE_, Error::INVALID, "not opened");
       return false;
     }
+    if (trace_) trace_->write(TRSYNC, NULL, 0, 0);
     return db_->synchronize(hard, proc, checker);
   }
   /**
@@ -959,7 +1524,9 @@ class PolyDB : public BasicDB {
       set_error(_KCCODELINE_, Error::INVALID, "not opened");
       return false;
     }
-    return db_->begin_transaction(hard);
+    if (!db_->begin_transaction(hard)) return false;
+    if (trace_) trace_->write(TRBEGIN, NULL, 0, 0);
+    return true;
   }
   /**
    * Try to begin transaction.
@@ -973,7 +1540,9 @@ class PolyDB : public BasicDB {
       set_error(_KCCODELINE_, Error::INVALID, "not opened");
       return false;
     }
-    return db_->begin_transaction_try(hard);
+    if (!db_->begin_transaction_try(hard)) return false;
+    if (trace_) trace_->write(TRBEGIN, NULL, 0, 0);
+    return true;
   }
   /**
    * End transaction.
@@ -986,6 +1555,7 @@ class PolyDB : public BasicDB {
       set_error(_KCCODELINE_, Error::INVALID, "not opened");
       return false;
     }
+    if (trace_) trace_->write(commit ? TRCOMMIT : TRABORT, NULL, 0, 0);
     return db_->end_transaction(commit);
   }
   /**
@@ -998,6 +1568,7 @@ class PolyDB : public BasicDB {
       set_error(_KCCODELINE_, Error::INVALID, "not opened");
       return false;
     }
+    if (trace_) trace_->write(TRCLEAR, NULL, 0, 0);
     return db_->clear();
   }
   /**
@@ -1072,96 +1643,7 @@ class PolyDB : public BasicDB {
   int64_t match_prefix(const std::string& prefix, std::vector<std::string>* strvec,
                        int64_t max = -1, ProgressChecker* checker = NULL) {
     _assert_(strvec);
-    const char* pbuf = prefix.data();
-    size_t psiz = prefix.size();
-    if (max < 0) max = INT64MAX;
-    Comparator* comp;
-    switch (type_) {
-      case TYPEPTREE: {
-        comp = LEXICALCOMP;
-        break;
-      }
-      case TYPEGRASS: {
-        comp = ((GrassDB*)db_)->rcomp();
-        break;
-      }
-      case TYPETREE: {
-        comp = ((TreeDB*)db_)->rcomp();
-        break;
-      }
-      case TYPEFOREST: {
-        comp = ((ForestDB*)db_)->rcomp();
-        break;
-      }
-      default: {
-        comp = NULL;
-        break;
-      }
-    }
-    bool err = false;
-    int64_t allcnt = count();
-    if (checker && !checker->check("match_prefix", "beginning", 0, allcnt)) {
-      set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
-      err = true;
-    }
-    strvec->clear();
-    Cursor* cur = cursor();
-    int64_t curcnt = 0;
-    if (comp == LEXICALCOMP) {
-      if (cur->jump(pbuf, psiz)) {
-        while ((int64_t)strvec->size() < max) {
-          size_t ksiz;
-          char* kbuf = cur->get_key(&ksiz, true);
-          if (kbuf) {
-            if (ksiz >= psiz && !std::memcmp(kbuf, pbuf, psiz)) {
-              strvec->push_back(std::string(kbuf, ksiz));
-            } else {
-              delete[] kbuf;
-              break;
-            }
-            delete[] kbuf;
-          } else {
-            if (cur->error() != Error::NOREC) err = true;
-            break;
-          }
-          curcnt++;
-          if (checker && !checker->check("match_prefix", "processing", curcnt, allcnt)) {
-            set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
-            err = true;
-          }
-        }
-      } else if (cur->error() != Error::NOREC) {
-        err = true;
-      }
-    } else {
-      if (cur->jump()) {
-        while ((int64_t)strvec->size() < max) {
-          size_t ksiz;
-          char* kbuf = cur->get_key(&ksiz, true);
-          if (kbuf) {
-            if (ksiz >= psiz && !std::memcmp(kbuf, pbuf, psiz))
-              strvec->push_back(std::string(kbuf, ksiz));
-            delete[] kbuf;
-          } else {
-            if (cur->error() != Error::NOREC) err = true;
-            break;
-          }
-          curcnt++;
-          if (checker && !checker->check("match_prefix", "processing", curcnt, allcnt)) {
-            set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
-            err = true;
-          }
-        }
-      } else if (cur->error() != Error::NOREC) {
-        err = true;
-      }
-    }
-    if (checker && !checker->check("match_prefix", "ending", strvec->size(), allcnt)) {
-      set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
-      err = true;
-    }
-    delete cur;
-    return err ? -1 : strvec->size();
+    return match_impl("match_prefix", prefix, "", NULL, strvec, max, checker);
   }
   /**
    * Get keys matching a regular expression string.
@@ -1170,52 +1652,21 @@ class PolyDB : public BasicDB {
    * @param max the maximum number to retrieve.  If it is negative, no limit is specified.
    * @param checker a progress checker object.  If it is NULL, no checking is performed.
    * @return the number of retrieved keys or -1 on failure.
+   * @note If the expression requires a literal prefix, the scan is limited to the range of the
+   * prefix on tree databases.  A literal substring required by the expression is checked
+   * before the expression itself.
    */
   int64_t match_regex(const std::string& regex, std::vector<std::string>* strvec,
                       int64_t max = -1, ProgressChecker* checker = NULL) {
     _assert_(strvec);
-    if (max < 0) max = INT64MAX;
     Regex reg;
     if (!reg.compile(regex, Regex::MATCHONLY)) {
       set_error(_KCCODELINE_, Error::LOGIC, "compilation failed");
       return -1;
     }
-    bool err = false;
-    int64_t allcnt = count();
-    if (checker && !checker->check("match_regex", "beginning", 0, allcnt)) {
-      set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
-      err = true;
-    }
-    strvec->clear();
-    Cursor* cur = cursor();
-    int64_t curcnt = 0;
-    if (cur->jump()) {
-      while ((int64_t)strvec->size() < max) {
-        size_t ksiz;
-        char* kbuf = cur->get_key(&ksiz, true);
-        if (kbuf) {
-          std::string key(kbuf, ksiz);
-          if (reg.match(key)) strvec->push_back(key);
-          delete[] kbuf;
-        } else {
-          if (cur->error() != Error::NOREC) err = true;
-          break;
-        }
-        curcnt++;
-        if (checker && !checker->check("match_regex", "processing", curcnt, allcnt)) {
-          set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
-          err = true;
-        }
-      }
-    } else if (cur->error() != Error::NOREC) {
-      err = true;
-    }
-    if (checker && !checker->check("match_regex", "ending", strvec->size(), allcnt)) {
-      set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
-      err = true;
-    }
-    delete cur;
-    return err ? -1 : strvec->size();
+    const std::string& prefix = Regex::literal_prefix(regex);
+    const std::string& infix = Regex::literal_substring(regex);
+    return match_impl("match_regex", prefix, infix, &reg, strvec, max, checker);
   }
   /**
    * Merge records from other databases.
@@ -1226,104 +1677,27 @@ class PolyDB : public BasicDB {
    * PolyDB::MAPPEND to append the new value.
    * @param checker a progress checker object.  If it is NULL, no checking is performed.
    * @return true on success, or false on failure.
+   * @note The sources are read ahead by a pool of at most four threads.  The records are merged
+   * in the order of the comparator of the destination and written in batches by the accept_bulk
+   * method.
    */
   bool merge(BasicDB** srcary, size_t srcnum, MergeMode mode = MSET,
              ProgressChecker* checker = NULL) {
     _assert_(srcary && srcnum <= MEMMAXSIZ);
-    if (type_ == TYPEVOID) {
-      set_error(_KCCODELINE_, Error::INVALID, "not opened");
-      return false;
-    }
-    bool err = false;
-    Comparator* comp;
-    switch (type_) {
-      case TYPEGRASS: {
-        comp = ((GrassDB*)db_)->rcomp();
-        break;
-      }
-      case TYPETREE: {
-        comp = ((TreeDB*)db_)->rcomp();
-        break;
-      }
-      case TYPEFOREST: {
-        comp = ((ForestDB*)db_)->rcomp();
-        break;
-      }
-      default: {
-        comp = NULL;
-        break;
-      }
-    }
-    if (!comp) comp = LEXICALCOMP;
-    std::priority_queue<MergeLine> lines;
-    int64_t allcnt = 0;
-    for (size_t i = 0; i < srcnum; i++) {
-      MergeLine line;
-      line.cur = srcary[i]->cursor();
-      line.comp = comp;
-      line.cur->jump();
-      line.kbuf = line.cur->get(&line.ksiz, &line.vbuf, &line.vsiz, true);
-      if (line.kbuf) {
-        lines.push(line);
-        int64_t count = srcary[i]->count();
-        if (count > 0) allcnt += count;
-      } else {
-        delete line.cur;
-      }
-    }
-    if (checker && !checker->check("merge", "beginning", 0, allcnt)) {
-      set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
-      err = true;
-    }
-    int64_t curcnt = 0;
-    while (!err && !lines.empty()) {
-      MergeLine line = lines.top();
-      lines.pop();
-      switch (mode) {
-        case MSET: {
-          if (!set(line.kbuf, line.ksiz, line.vbuf, line.vsiz)) err = true;
-          break;
-        }
-        case MADD: {
-          if (!add(line.kbuf, line.ksiz, line.vbuf, line.vsiz) &&
-              error() != Error::DUPREC) err = true;
-          break;
-        }
-        case MREPLACE: {
-          if (!replace(line.kbuf, line.ksiz, line.vbuf, line.vsiz) &&
-              error() != Error::NOREC) err = true;
-          break;
-        }
-        case MAPPEND: {
-          if (!append(line.kbuf, line.ksiz, line.vbuf, line.vsiz)) err = true;
-          break;
-        }
-      }
-      delete[] line.kbuf;
-      line.kbuf = line.cur->get(&line.ksiz, &line.vbuf, &line.vsiz, true);
-      if (line.kbuf) {
-        lines.push(line);
-      } else {
-        delete line.cur;
-      }
-      curcnt++;
-      if (checker && !checker->check("merge", "processing", curcnt, allcnt)) {
-        set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
-        err = true;
-        break;
-      }
-    }
-    if (checker && !checker->check("merge", "ending", -1, allcnt)) {
-      set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
-      err = true;
-    }
-    while (!lines.empty()) {
-      MergeLine line = lines.top();
-      lines.pop();
-      delete[] line.kbuf;
-      delete line.cur;
-    }
-    return !err;
+    return merge_impl(srcary, srcnum, mode, NULL, checker);
+  }
+  /**
+   * Merge records from other databases with a reducer.
+   * @param srcary an array of the source detabase objects.
+   * @param srcnum the number of the elements of the source array.
+   * @param reducer a reducer object to resolve the values of existing records.
+   * @param checker a progress checker object.  If it is NULL, no checking is performed.
+   * @return true on success, or false on failure.
+   */
+  bool merge(BasicDB** srcary, size_t srcnum, MergeReducer* reducer,
+             ProgressChecker* checker = NULL) {
+    _assert_(srcary && srcnum <= MEMMAXSIZ && reducer);
+    return merge_impl(srcary, srcnum, MSET, reducer, checker);
   }
   /**
    * Create a cursor object.
@@ -1367,6 +1741,38 @@ class PolyDB : public BasicDB {
     mtrigger_ = trigger;
     return true;
   }
+  /**
+   * Set the merge operator.
+   * @param mop the merge operator object.
+   * @return true on success, or false on failure.
+   * @note It is applied to the log-structured tree database, which folds the operands of the
+   * operator lazily.  The other database types ignore it.
+   */
+  bool tune_merge_operator(MergeOperator* mop) {
+    _assert_(mop);
+    if (type_ != TYPEVOID) {
+      set_error(_KCCODELINE_, Error::INVALID, "already opened");
+      return false;
+    }
+    mop_ = mop;
+    return true;
+  }
+  /**
+   * Set the shared cache manager.
+   * @param cmgr the cache manager object.  If it is NULL, the memory is not shared.
+   * @return true on success, or false on failure.
+   * @note It is applied to the cache hash database, the cache tree database, the file tree
+   * database, and the directory tree database.  The other database types ignore it.
+   */
+  bool tune_cache_manager(CacheManager* cmgr) {
+    _assert_(true);
+    if (type_ != TYPEVOID) {
+      set_error(_KCCODELINE_, Error::INVALID, "already opened");
+      return false;
+    }
+    cmgr_ = cmgr;
+    return true;
+  }
  private:
   /**
    * Stream logger implementation.
@@ -1424,13 +1830,324 @@ class PolyDB : public BasicDB {
     std::ostream* strm_;                 ///< output stream
     std::string prefix_;                 ///< prefix of each message
   };
+  /**
+   * Writer of the operation trace.
+   */
+  class TraceWriter {
+   public:
+    /** constructor */
+    explicit TraceWriter(bool hashed) :
+        lock_(), file_(), buf_(), thids_(), hashed_(hashed), err_(false), stime_(0), ltime_(0) {}
+    /** open the trace file */
+    bool open(const std::string& path) {
+      _assert_(true);
+      if (!file_.open(path, File::OWRITER | File::OCREATE | File::OTRUNCATE)) return false;
+      buf_.append(KCPDTRMAGICDATA, sizeof(KCPDTRMAGICDATA));
+      buf_.push_back((char)(hashed_ ? TRFHASH : 0));
+      stime_ = time();
+      return true;
+    }
+    /** close the trace file */
+    bool close() {
+      _assert_(true);
+      ScopedMutex lock(&lock_);
+      if (!buf_.empty() && !file_.append(buf_)) err_ = true;
+      if (!file_.close()) err_ = true;
+      return !err_;
+    }
+    /** get the error message */
+    const char* error() const {
+      _assert_(true);
+      return file_.error();
+    }
+    /** record an operation */
+    void write(uint8_t kind, const char* kbuf, size_t ksiz, int64_t vsiz) {
+      _assert_(kbuf || ksiz == 0);
+      char hbuf[sizeof(uint64_t)];
+      if (hashed_ && ksiz > 0) {
+        uint64_t hash = hton64(hashmurmur(kbuf, ksiz));
+        std::memcpy(hbuf, &hash, sizeof(hash));
+        kbuf = hbuf;
+        ksiz = sizeof(hbuf);
+      }
+      int64_t thkey = Thread::hash();
+      ScopedMutex lock(&lock_);
+      std::map<int64_t, uint32_t>::iterator it = thids_.find(thkey);
+      uint32_t thid;
+      if (it == thids_.end()) {
+        thid = thids_.size();
+        thids_[thkey] = thid;
+      } else {
+        thid = it->second;
+      }
+      int64_t etime = (int64_t)((time() - stime_) * 1000000);
+      if (etime < ltime_) etime = ltime_;
+      char nbuf[NUMBUFSIZ];
+      char* wp = nbuf;
+      *(wp++) = kind;
+      wp += writevarnum(wp, thid);
+      wp += writevarnum(wp, etime - ltime_);
+      wp += writevarnum(wp, ksiz);
+      buf_.append(nbuf, wp - nbuf);
+      buf_.append(kbuf, ksiz);
+      wp = nbuf;
+      wp += writevarnum(wp, vsiz);
+      buf_.append(nbuf, wp - nbuf);
+      ltime_ = etime;
+      if (buf_.size() >= TRBUFSIZ) {
+        if (!file_.append(buf_)) err_ = true;
+        buf_.clear();
+      }
+    }
+   private:
+    Mutex lock_;                         ///< lock for the buffer
+    File file_;                          ///< trace file
+    std::string buf_;                    ///< output buffer
+    std::map<int64_t, uint32_t> thids_;  ///< thread IDs
+    bool hashed_;                        ///< whether to hash keys
+    bool err_;                           ///< whether an error happened
+    double stime_;                       ///< starting time
+    int64_t ltime_;                      ///< elapsed time of the last record
+  };
+  /**
+   * Visitor wrapper to record operations into the trace.
+   */
+  class TraceVisitor : public Visitor {
+   public:
+    /** constructor */
+    explicit TraceVisitor(TraceWriter* trace, Visitor* visitor) :
+        trace_(trace), visitor_(visitor) {}
+   private:
+    /** visit a record */
+    const char* visit_full(const char* kbuf, size_t ksiz,
+                           const char* vbuf, size_t vsiz, size_t* sp) {
+      const char* rv = visitor_->visit_full(kbuf, ksiz, vbuf, vsiz, sp);
+      if (rv == NOP) {
+        trace_->write(TRGET, kbuf, ksiz, vsiz);
+      } else if (rv == REMOVE) {
+        trace_->write(TRREMOVE, kbuf, ksiz, vsiz);
+      } else {
+        trace_->write(TRSET, kbuf, ksiz, *sp);
+      }
+      return rv;
+    }
+    /** visit a empty record */
+    const char* visit_empty(const char* kbuf, size_t ksiz, size_t* sp) {
+      const char* rv = visitor_->visit_empty(kbuf, ksiz, sp);
+      if (rv == NOP || rv == REMOVE) {
+        trace_->write(TRMISS, kbuf, ksiz, 0);
+      } else {
+        trace_->write(TRADD, kbuf, ksiz, *sp);
+      }
+      return rv;
+    }
+    /** preprocess the main operations */
+    void visit_before() {
+      visitor_->visit_before();
+    }
+    /** postprocess the main operations */
+    void visit_after() {
+      visitor_->visit_after();
+    }
+    TraceWriter* trace_;                 ///< trace writer
+    Visitor* visitor_;                   ///< inner visitor
+  };
+  /**
+   * Task queue for parallel scanning.
+   */
+  class ScanQueue : public TaskQueue {
+   public:
+    /** task of a batch of records */
+    class RecordTask : public Task {
+     public:
+      std::vector<std::pair<std::string, std::string> > recs;
+    };
+    /** constructor */
+    explicit ScanQueue(Visitor* visitor) : visitor_(visitor) {}
+   private:
+    /** process a task */
+    void do_task(Task* task) {
+      RecordTask* rtask = (RecordTask*)task;
+      std::vector<std::pair<std::string, std::string> >::iterator it = rtask->recs.begin();
+      std::vector<std::pair<std::string, std::string> >::iterator itend = rtask->recs.end();
+      while (it != itend) {
+        size_t sp;
+        visitor_->visit_full(it->first.data(), it->first.size(),
+                             it->second.data(), it->second.size(), &sp);
+        ++it;
+      }
+      delete rtask;
+    }
+    Visitor* visitor_;                   ///< visitor
+  };
+  /**
+   * Read-ahead chunk of a merging source.
+   */
+  struct MergeChunk {
+    std::string buf;                     ///< concatenated keys and values
+    std::vector<std::pair<size_t, size_t> > sizes;  ///< sizes of the keys and the values
+  };
+  /**
+   * Task queue of the workers reading merging sources ahead.
+   */
+  class MergeQueue : public TaskQueue {
+   public:
+    /** task to read a chunk of a source */
+    class ReadTask : public Task {
+     public:
+      explicit ReadTask(MergeReader* reader) : reader(reader) {}
+      MergeReader* reader;
+    };
+   private:
+    /** process a task */
+    void do_task(Task* task) {
+      ReadTask* rtask = (ReadTask*)task;
+      rtask->reader->fill();
+      delete rtask;
+    }
+  };
+  /**
+   * Read-ahead state of a merging source.
+   */
+  class MergeReader {
+   public:
+    /** constructor */
+    explicit MergeReader(BasicDB* db, MergeQueue* queue) :
+        db_(db), queue_(queue), cur_(NULL), mutex_(), cond_(), chunks_(),
+        pending_(false), done_(false), aborted_(false), error_() {
+      _assert_(db && queue);
+    }
+    /** destructor */
+    ~MergeReader() {
+      _assert_(true);
+      std::list<MergeChunk*>::iterator it = chunks_.begin();
+      std::list<MergeChunk*>::iterator itend = chunks_.end();
+      while (it != itend) {
+        delete *it;
+        ++it;
+      }
+      delete cur_;
+    }
+    /** start reading ahead */
+    void start() {
+      _assert_(true);
+      ScopedMutex lock(&mutex_);
+      schedule();
+    }
+    /** pop the next chunk, or NULL at the end */
+    MergeChunk* pop() {
+      _assert_(true);
+      ScopedMutex lock(&mutex_);
+      while (chunks_.empty() && !done_) {
+        cond_.wait(&mutex_);
+      }
+      if (chunks_.empty()) return NULL;
+      MergeChunk* chunk = chunks_.front();
+      chunks_.pop_front();
+      schedule();
+      return chunk;
+    }
+    /** stop reading ahead */
+    void abort() {
+      _assert_(true);
+      ScopedMutex lock(&mutex_);
+      aborted_ = true;
+      cond_.broadcast();
+    }
+    /** get the error of the source */
+    Error error() {
+      _assert_(true);
+      ScopedMutex lock(&mutex_);
+      return error_;
+    }
+    /** read a chunk, called by a worker of the queue */
+    void fill() {
+      _assert_(true);
+      {
+        ScopedMutex lock(&mutex_);
+        if (aborted_) {
+          pending_ = false;
+          return;
+        }
+      }
+      Error error;
+      bool ok = true;
+      if (!cur_) {
+        cur_ = db_->cursor();
+        if (!cur_->jump()) {
+          if (cur_->error() != Error::NOREC) error = cur_->error();
+          ok = false;
+        }
+      }
+      MergeChunk* chunk = new MergeChunk;
+      if (ok) {
+        ChunkVisitor visitor(chunk);
+        chunk->buf.reserve(MERGECHUNKSIZ);
+        while (chunk->buf.size() < MERGECHUNKSIZ) {
+          if (!cur_->accept(&visitor, false, true)) {
+            if (cur_->error() != Error::NOREC) error = cur_->error();
+            ok = false;
+            break;
+          }
+        }
+      }
+      ScopedMutex lock(&mutex_);
+      if (chunk->sizes.empty()) {
+        delete chunk;
+      } else {
+        chunks_.push_back(chunk);
+      }
+      if (!ok) {
+        error_ = error;
+        done_ = true;
+      }
+      pending_ = false;
+      schedule();
+      cond_.broadcast();
+    }
+   private:
+    /** visitor to append each record into a chunk */
+    class ChunkVisitor : public Visitor {
+     public:
+      explicit ChunkVisitor(MergeChunk* chunk) : chunk_(chunk) {}
+     private:
+      const char* visit_full(const char* kbuf, size_t ksiz,
+                             const char* vbuf, size_t vsiz, size_t* sp) {
+        chunk_->buf.append(kbuf, ksiz);
+        chunk_->buf.append(vbuf, vsiz);
+        chunk_->sizes.push_back(std::make_pair(ksiz, vsiz));
+        return NOP;
+      }
+      MergeChunk* chunk_;
+    };
+    /** add a reading task if the queue of chunks has room, with the mutex locked */
+    void schedule() {
+      _assert_(true);
+      if (pending_ || done_ || aborted_ || chunks_.size() >= MERGECHUNKNUM) return;
+      pending_ = true;
+      queue_->add_task(new MergeQueue::ReadTask(this));
+    }
+    BasicDB* db_;                        ///< source database
+    MergeQueue* queue_;                  ///< queue of the reading workers
+    BasicDB::Cursor* cur_;               ///< cursor of the source
+    Mutex mutex_;                        ///< mutex for the chunk queue
+    CondVar cond_;                       ///< condition variable for the chunk queue
+    std::list<MergeChunk*> chunks_;      ///< chunk queue
+    bool pending_;                       ///< flag whether a reading task is queued
+    bool done_;                          ///< flag of the end of the source
+    bool aborted_;                       ///< flag of abortion
+    Error error_;                        ///< error of the source
+  };
   /**
    * Front line of a merging list.
    */
   struct MergeLine {
-    BasicDB::Cursor* cur;                ///< cursor
+    MergeReader* reader;                 ///< read-ahead state
+    MergeChunk* chunk;                   ///< current chunk
+    size_t idx;                          ///< index of the current record in the chunk
+    size_t off;                          ///< offset of the next record in the chunk
     Comparator* comp;                    ///< comparator
-    char* kbuf;                          ///< pointer to the key
+    const char* kbuf;                    ///< pointer to the key
     size_t ksiz;                         ///< size of the key
     const char* vbuf;                    ///< pointer to the value
     size_t vsiz;                         ///< size of the value
@@ -1438,7 +2155,384 @@ class PolyDB : public BasicDB {
     bool operator <(const MergeLine& right) const {
       return comp->compare(kbuf, ksiz, right.kbuf, right.ksiz) > 0;
     }
+    /** move to the next record */
+    bool next() {
+      while (!chunk || idx >= chunk->sizes.size()) {
+        delete chunk;
+        chunk = reader->pop();
+        if (!chunk) return false;
+        idx = 0;
+        off = 0;
+      }
+      const std::pair<size_t, size_t>& size = chunk->sizes[idx++];
+      kbuf = chunk->buf.data() + off;
+      ksiz = size.first;
+      vbuf = kbuf + ksiz;
+      vsiz = size.second;
+      off += ksiz + vsiz;
+      return true;
+    }
   };
+  /**
+   * Visitor to write a batch of merged records.
+   */
+  class MergeVisitor : public Visitor {
+   public:
+    /** constructor */
+    explicit MergeVisitor(MergeMode mode, MergeReducer* reducer) :
+        mode_(mode), reducer_(reducer), keys_(), values_(), index_(), size_(0), rbuf_() {
+      _assert_(true);
+    }
+    /** add a record */
+    void add(const char* kbuf, size_t ksiz, const char* vbuf, size_t vsiz) {
+      _assert_(kbuf && ksiz <= MEMMAXSIZ && vbuf && vsiz <= MEMMAXSIZ);
+      std::string key(kbuf, ksiz);
+      std::map<std::string, size_t>::iterator it = index_.find(key);
+      if (it == index_.end()) {
+        index_[key] = keys_.size();
+        keys_.push_back(key);
+        values_.push_back(MergeValues());
+        values_.back().push_back(std::string(vbuf, vsiz));
+      } else {
+        values_[it->second].push_back(std::string(vbuf, vsiz));
+      }
+      size_ += ksiz + vsiz;
+    }
+    /** get the keys of the batch */
+    const std::vector<std::string>& keys() const {
+      _assert_(true);
+      return keys_;
+    }
+    /** check whether the batch is full */
+    bool full() const {
+      _assert_(true);
+      return keys_.size() >= MERGEBATCHNUM || size_ >= MERGEBATCHSIZ;
+    }
+    /** clear the batch */
+    void clear() {
+      _assert_(true);
+      keys_.clear();
+      values_.clear();
+      index_.clear();
+      size_ = 0;
+    }
+   private:
+    /** visit a record */
+    const char* visit_full(const char* kbuf, size_t ksiz,
+                           const char* vbuf, size_t vsiz, size_t* sp) {
+      rbuf_.assign(vbuf, vsiz);
+      return reduce(kbuf, ksiz, true, sp);
+    }
+    /** visit an empty record space */
+    const char* visit_empty(const char* kbuf, size_t ksiz, size_t* sp) {
+      rbuf_.clear();
+      return reduce(kbuf, ksiz, false, sp);
+    }
+    /** apply the values of the batch in order */
+    const char* reduce(const char* kbuf, size_t ksiz, bool exists, size_t* sp) {
+      std::map<std::string, size_t>::iterator it = index_.find(std::string(kbuf, ksiz));
+      if (it == index_.end()) return NOP;
+      bool orig = exists;
+      bool mod = false;
+      const MergeValues& values = values_[it->second];
+      MergeValues::const_iterator vit = values.begin();
+      MergeValues::const_iterator vitend = values.end();
+      while (vit != vitend) {
+        const std::string& value = *vit;
+        if (reducer_) {
+          if (exists) {
+            size_t rsiz;
+            const char* rbuf = reducer_->reduce(kbuf, ksiz, rbuf_.data(), rbuf_.size(),
+                                                value.data(), value.size(), &rsiz);
+            if (rbuf == REMOVE) {
+              rbuf_.clear();
+              exists = false;
+              mod = true;
+            } else if (rbuf != NOP) {
+              rbuf_.assign(rbuf, rsiz);
+              mod = true;
+            }
+          } else {
+            rbuf_ = value;
+            exists = true;
+            mod = true;
+          }
+        } else {
+          switch (mode_) {
+            case MSET: {
+              rbuf_ = value;
+              exists = true;
+              mod = true;
+              break;
+            }
+            case MADD: {
+              if (!exists) {
+                rbuf_ = value;
+                exists = true;
+                mod = true;
+              }
+              break;
+            }
+            case MREPLACE: {
+              if (exists) {
+                rbuf_ = value;
+                mod = true;
+              }
+              break;
+            }
+            case MAPPEND: {
+              rbuf_.append(value);
+              exists = true;
+              mod = true;
+              break;
+            }
+          }
+        }
+        ++vit;
+      }
+      if (!mod) return NOP;
+      if (!exists) return orig ? REMOVE : NOP;
+      *sp = rbuf_.size();
+      return rbuf_.data();
+    }
+    MergeMode mode_;                     ///< merge mode
+    MergeReducer* reducer_;              ///< reducer
+    std::vector<std::string> keys_;      ///< keys of the batch
+    std::vector<MergeValues> values_;    ///< values of each key of the batch
+    std::map<std::string, size_t> index_;  ///< index of the keys
+    size_t size_;                        ///< total size of the batch
+    std::string rbuf_;                   ///< result buffer
+  };
+  /**
+   * Visitor to match keys in place.
+   */
+  class MatchVisitor : public Visitor {
+   public:
+    /** constructor */
+    explicit MatchVisitor(const std::string& prefix, const std::string& infix, Regex* regex,
+                          bool ordered, std::vector<std::string>* strvec) :
+        prefix_(prefix), infix_(infix), regex_(regex), ordered_(ordered), strvec_(strvec),
+        stop_(false) {
+      _assert_(strvec);
+    }
+    /** check whether the range of the prefix is over */
+    bool stop() const {
+      _assert_(true);
+      return stop_;
+    }
+   private:
+    /** visit a record */
+    const char* visit_full(const char* kbuf, size_t ksiz,
+                           const char* vbuf, size_t vsiz, size_t* sp) {
+      size_t psiz = prefix_.size();
+      if (ksiz < psiz || std::memcmp(kbuf, prefix_.data(), psiz)) {
+        if (ordered_) stop_ = true;
+        return NOP;
+      }
+      if (!infix_.empty() &&
+          std::search(kbuf, kbuf + ksiz, infix_.begin(), infix_.end()) == kbuf + ksiz)
+        return NOP;
+      if (regex_ && !regex_->match(kbuf, ksiz)) return NOP;
+      strvec_->push_back(std::string(kbuf, ksiz));
+      return NOP;
+    }
+    const std::string& prefix_;          ///< required prefix
+    const std::string& infix_;           ///< required substring
+    Regex* regex_;                       ///< regular expression
+    bool ordered_;                       ///< whether the range of the prefix is scanned
+    std::vector<std::string>* strvec_;   ///< result keys
+    bool stop_;                          ///< flag of the end of the range
+  };
+  /**
+   * Get keys matching a condition.
+   * @param name the name of the operation for the progress checker.
+   * @param prefix the prefix string required for each key.
+   * @param infix the substring required for each key.
+   * @param regex the regular expression which each key should match.  If it is NULL, no
+   * expression is tested.
+   * @param strvec a string vector to contain the result.
+   * @param max the maximum number to retrieve.  If it is negative, no limit is specified.
+   * @param checker a progress checker object.
+   * @return the number of retrieved keys or -1 on failure.
+   */
+  int64_t match_impl(const char* name, const std::string& prefix, const std::string& infix,
+                     Regex* regex, std::vector<std::string>* strvec, int64_t max,
+                     ProgressChecker* checker) {
+    _assert_(name && strvec);
+    if (max < 0) max = INT64MAX;
+    BasicDB* idb = bdb_ ? bdb_ : db_;
+    Comparator* comp;
+    switch (type_) {
+      case TYPEPTREE: {
+        comp = LEXICALCOMP;
+        break;
+      }
+      case TYPEGRASS: {
+        comp = ((GrassDB*)idb)->rcomp();
+        break;
+      }
+      case TYPETREE: {
+        comp = ((TreeDB*)idb)->rcomp();
+        break;
+      }
+      case TYPEFOREST: {
+        comp = ((ForestDB*)idb)->rcomp();
+        break;
+      }
+      case TYPELTREE: {
+        comp = ((LogTreeDB*)idb)->rcomp();
+        break;
+      }
+      default: {
+        comp = NULL;
+        break;
+      }
+    }
+    bool ordered = comp == LEXICALCOMP && !prefix.empty();
+    bool err = false;
+    int64_t allcnt = count();
+    if (checker && !checker->check(name, "beginning", 0, allcnt)) {
+      set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
+      err = true;
+    }
+    strvec->clear();
+    MatchVisitor visitor(prefix, infix, regex, ordered, strvec);
+    Cursor* cur = cursor();
+    int64_t curcnt = 0;
+    if (ordered ? cur->jump(prefix.data(), prefix.size()) : cur->jump()) {
+      while ((int64_t)strvec->size() < max) {
+        if (!cur->accept(&visitor, false, true)) {
+          if (cur->error() != Error::NOREC) err = true;
+          break;
+        }
+        if (visitor.stop()) break;
+        curcnt++;
+        if (checker && !checker->check(name, "processing", curcnt, allcnt)) {
+          set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
+          err = true;
+          break;
+        }
+      }
+    } else if (cur->error() != Error::NOREC) {
+      err = true;
+    }
+    if (checker && !checker->check(name, "ending", strvec->size(), allcnt)) {
+      set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
+      err = true;
+    }
+    delete cur;
+    return err ? -1 : strvec->size();
+  }
+  /**
+   * Merge records from other databases.
+   * @param srcary an array of the source detabase objects.
+   * @param srcnum the number of the elements of the source array.
+   * @param mode the merge mode.
+   * @param reducer a reducer object.  If it is not NULL, the merge mode is ignored.
+   * @param checker a progress checker object.
+   * @return true on success, or false on failure.
+   */
+  bool merge_impl(BasicDB** srcary, size_t srcnum, MergeMode mode, MergeReducer* reducer,
+                  ProgressChecker* checker) {
+    _assert_(srcary && srcnum <= MEMMAXSIZ);
+    if (type_ == TYPEVOID) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
+    }
+    bool err = false;
+    BasicDB* idb = bdb_ ? bdb_ : db_;
+    Comparator* comp;
+    switch (type_) {
+      case TYPEGRASS: {
+        comp = ((GrassDB*)idb)->rcomp();
+        break;
+      }
+      case TYPETREE: {
+        comp = ((TreeDB*)idb)->rcomp();
+        break;
+      }
+      case TYPEFOREST: {
+        comp = ((ForestDB*)idb)->rcomp();
+        break;
+      }
+      case TYPELTREE: {
+        comp = ((LogTreeDB*)idb)->rcomp();
+        break;
+      }
+      default: {
+        comp = NULL;
+        break;
+      }
+    }
+    if (!comp) comp = LEXICALCOMP;
+    int64_t allcnt = 0;
+    MergeQueue queue;
+    queue.start(srcnum > 0 && srcnum < MERGETHNUM ? srcnum : MERGETHNUM);
+    std::vector<MergeReader*> readers;
+    readers.reserve(srcnum);
+    for (size_t i = 0; i < srcnum; i++) {
+      int64_t count = srcary[i]->count();
+      if (count > 0) allcnt += count;
+      MergeReader* reader = new MergeReader(srcary[i], &queue);
+      reader->start();
+      readers.push_back(reader);
+    }
+    std::priority_queue<MergeLine> lines;
+    for (size_t i = 0; i < srcnum; i++) {
+      MergeLine line;
+      line.reader = readers[i];
+      line.chunk = NULL;
+      line.idx = 0;
+      line.off = 0;
+      line.comp = comp;
+      if (line.next()) lines.push(line);
+    }
+    if (checker && !checker->check("merge", "beginning", 0, allcnt)) {
+      set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
+      err = true;
+    }
+    MergeVisitor visitor(mode, reducer);
+    int64_t curcnt = 0;
+    while (!err && !lines.empty()) {
+      MergeLine line = lines.top();
+      lines.pop();
+      visitor.add(line.kbuf, line.ksiz, line.vbuf, line.vsiz);
+      if (line.next()) lines.push(line);
+      if (visitor.full() || lines.empty()) {
+        if (!accept_bulk(visitor.keys(), &visitor, true)) err = true;
+        visitor.clear();
+      }
+      curcnt++;
+      if (checker && !checker->check("merge", "processing", curcnt, allcnt)) {
+        set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
+        err = true;
+        break;
+      }
+    }
+    if (checker && !checker->check("merge", "ending", -1, allcnt)) {
+      set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
+      err = true;
+    }
+    while (!lines.empty()) {
+      MergeLine line = lines.top();
+      lines.pop();
+      delete line.chunk;
+    }
+    for (size_t i = 0; i < srcnum; i++) {
+      readers[i]->abort();
+    }
+    queue.finish();
+    for (size_t i = 0; i < srcnum; i++) {
+      MergeReader* reader = readers[i];
+      const Error& error = reader->error();
+      if (!err && error != Error::SUCCESS) {
+        set_error(_KCCODELINE_, error.code(), error.message());
+        err = true;
+      }
+      delete reader;
+    }
+    return !err;
+  }
   /** Dummy constructor to forbid the use. */
   PolyDB(const PolyDB&);
   /** Dummy Operator to forbid the use. */
@@ -1447,6 +2541,8 @@ class PolyDB : public BasicDB {
   Type type_;
   /** The internal database. */
   BasicDB* db_;
+  /** The backend database of the tiered database. */
+  BasicDB* bdb_;
   /** The last happened error. */
   Error error_;
   /** The standard log stream. */
@@ -1463,8 +2559,14 @@ class PolyDB : public BasicDB {
   MetaTrigger* stdmtrigger_;
   /** The internal meta operation trigger. */
   MetaTrigger* mtrigger_;
+  /** The shared cache manager. */
+  CacheManager* cmgr_;
+  /** The merge operator. */
+  MergeOperator* mop_;
   /** The custom compressor. */
   Compressor* zcomp_;
+  /** The operation trace. */
+  TraceWriter* trace_;
 };
 
 
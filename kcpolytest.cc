@@ -34,6 +34,7 @@ static int32_t runqueue(int argc, char** argv);
 static int32_t runwicked(int argc, char** argv);
 static int32_t runtran(int argc, char** argv);
 static int32_t runmapred(int argc, char** argv);
+static int32_t runindex(int argc, char** argv);
 static int32_t runmisc(int argc, char** argv);
 static int32_t procorder(const char* path, int64_t rnum, int32_t thnum, bool rnd, int32_t mode,
                          bool tran, int32_t oflags, bool lv);
@@ -46,6 +47,8 @@ static int32_t proctran(const char* path, int64_t rnum, int32_t thnum, int32_t i
 static int32_t procmapred(const char* path, int64_t rnum, bool rnd, int32_t oflags, bool lv,
                           const char* tmpdir, int64_t dbnum, int64_t clim, int64_t cbnum,
                           int32_t opts);
+static int32_t procindex(const char* path, int64_t rnum, int32_t thnum, bool rnd,
+                         int32_t oflags, bool lv);
 static int32_t procmisc(const char* path);
 
 
@@ -69,6 +72,8 @@ int main(int argc, char** argv) {
     rv = runtran(argc, argv);
   } else if (!std::strcmp(argv[1], "mapred")) {
     rv = runmapred(argc, argv);
+  } else if (!std::strcmp(argv[1], "index")) {
+    rv = runindex(argc, argv);
   } else if (!std::strcmp(argv[1], "misc")) {
     rv = runmisc(argc, argv);
   } else {
@@ -100,6 +105,8 @@ static void usage() {
           " path rnum\n", g_progname);
   eprintf("  %s mapred [-rnd] [-oat|-oas|-onl|-otl|-onr] [-lv] [-tmp str]"
           " [-dbnum num] [-clim num] [-cbnum num] [-xnl] [-xnc] path rnum\n", g_progname);
+  eprintf("  %s index [-th num] [-rnd] [-oat|-oas|-onl|-otl|-onr] [-lv] path rnum\n",
+          g_progname);
   eprintf("  %s misc path\n", g_progname);
   eprintf("\n");
   std::exit(1);
@@ -429,6 +436,57 @@ static int32_t runmapred(int argc, char** argv) {
 }
 
 
+// parse arguments of index command
+static int32_t runindex(int argc, char** argv) {
+  bool argbrk = false;
+  const char* path = NULL;
+  const char* rstr = NULL;
+  int32_t thnum = 1;
+  bool rnd = false;
+  int32_t oflags = 0;
+  bool lv = false;
+  for (int32_t i = 2; i < argc; i++) {
+    if (!argbrk && argv[i][0] == '-') {
+      if (!std::strcmp(argv[i], "--")) {
+        argbrk = true;
+      } else if (!std::strcmp(argv[i], "-th")) {
+        if (++i >= argc) usage();
+        thnum = kc::atoix(argv[i]);
+      } else if (!std::strcmp(argv[i], "-rnd")) {
+        rnd = true;
+      } else if (!std::strcmp(argv[i], "-oat")) {
+        oflags |= kc::PolyDB::OAUTOTRAN;
+      } else if (!std::strcmp(argv[i], "-oas")) {
+        oflags |= kc::PolyDB::OAUTOSYNC;
+      } else if (!std::strcmp(argv[i], "-onl")) {
+        oflags |= kc::PolyDB::ONOLOCK;
+      } else if (!std::strcmp(argv[i], "-otl")) {
+        oflags |= kc::PolyDB::OTRYLOCK;
+      } else if (!std::strcmp(argv[i], "-onr")) {
+        oflags |= kc::PolyDB::ONOREPAIR;
+      } else if (!std::strcmp(argv[i], "-lv")) {
+        lv = true;
+      } else {
+        usage();
+      }
+    } else if (!path) {
+      argbrk = true;
+      path = argv[i];
+    } else if (!rstr) {
+      rstr = argv[i];
+    } else {
+      usage();
+    }
+  }
+  if (!path || !rstr) usage();
+  int64_t rnum = kc::atoix(rstr);
+  if (rnum < 1 || thnum < 1) usage();
+  if (thnum > THREADMAX) thnum = THREADMAX;
+  int32_t rv = procindex(path, rnum, thnum, rnd, oflags, lv);
+  return rv;
+}
+
+
 // parse arguments of misc command
 static int32_t runmisc(int argc, char** argv) {
   bool argbrk = false;
@@ -463,6 +521,22 @@ static int32_t procorder(const char* path, int64_t rnum, int32_t thnum, bool rnd
   double stime = kc::time();
   db.tune_logger(stdlogger(g_progname, &std::cout),
                  lv ? kc::UINT32MAX : kc::BasicDB::Logger::WARN | kc::BasicDB::Logger::ERROR);
+  class MergeOperatorImpl : public kc::MergeOperator {
+   private:
+    char* merge(const char* kbuf, size_t ksiz, const char* vbuf, size_t vsiz,
+                const char* obuf, size_t osiz, size_t* sp) {
+      if (vbuf && kc::atoin(vbuf, vsiz) > kc::atoin(obuf, osiz)) {
+        obuf = vbuf;
+        osiz = vsiz;
+      }
+      char* rbuf = new char[osiz+1];
+      std::memcpy(rbuf, obuf, osiz);
+      *sp = osiz;
+      return rbuf;
+    }
+  };
+  MergeOperatorImpl mop;
+  db.tune_merge_operator(&mop);
   uint32_t omode = kc::PolyDB::OWRITER | kc::PolyDB::OCREATE | kc::PolyDB::OTRUNCATE;
   if (mode == 'r') {
     omode = kc::PolyDB::OWRITER | kc::PolyDB::OCREATE;
@@ -1052,6 +1126,361 @@ static int32_t procorder(const char* path, int64_t rnum, int32_t thnum, bool rnd
     dbmetaprint(&db, mode == 'w');
     oprintf("time: %.3f\n", etime - stime);
   }
+  if (mode == 'e') {
+    oprintf("accessing parts of records:\n");
+    stime = kc::time();
+    class ThreadRange : public kc::Thread {
+     public:
+      void setparams(int32_t id, kc::BasicDB* db, int64_t rnum, int32_t thnum,
+                     bool rnd, bool tran) {
+        id_ = id;
+        db_ = db;
+        rnum_ = rnum;
+        thnum_ = thnum;
+        err_ = false;
+        rnd_ = rnd;
+        tran_ = tran;
+      }
+      bool error() {
+        return err_;
+      }
+      void run() {
+        int64_t base = id_ * rnum_;
+        int64_t range = rnum_ * thnum_;
+        for (int64_t i = 1; !err_ && i <= rnum_; i++) {
+          if (tran_ && !db_->begin_transaction(false)) {
+            dberrprint(db_, __LINE__, "DB::begin_transaction");
+            err_ = true;
+          }
+          char kbuf[RECBUFSIZ];
+          size_t ksiz = std::sprintf(kbuf, "%08lld",
+                                     (long long)(rnd_ ? myrand(range) + 1 : base + i));
+          char vbuf[RECBUFSIZ];
+          int32_t vsiz = db_->get(kbuf, ksiz, vbuf, sizeof(vbuf));
+          if (vsiz >= 0) {
+            bool chk = !rnd_ && vsiz <= (int32_t)sizeof(vbuf) / 2;
+            if (vsiz > (int32_t)sizeof(vbuf)) vsiz = sizeof(vbuf);
+            int64_t off = myrand(vsiz + 1);
+            size_t max = myrand(ksiz) + 1;
+            char rbuf[RECBUFSIZ];
+            int64_t rsiz = db_->get_range(kbuf, ksiz, off, rbuf, max);
+            if (rsiz < 0) {
+              if (!rnd_ || db_->error() != kc::BasicDB::Error::NOREC) {
+                dberrprint(db_, __LINE__, "DB::get_range");
+                err_ = true;
+              }
+            } else if (chk && (rsiz != std::min(vsiz - off, (int64_t)max) ||
+                               std::memcmp(rbuf, vbuf + off, rsiz))) {
+              dberrprint(db_, __LINE__, "DB::get_range");
+              err_ = true;
+            }
+            off = myrand(vsiz + 2);
+            std::memset(rbuf, '*', max);
+            if (!db_->write_range(kbuf, ksiz, off, rbuf, max)) {
+              dberrprint(db_, __LINE__, "DB::write_range");
+              err_ = true;
+            }
+            if (chk) {
+              char nbuf[RECBUFSIZ];
+              std::memcpy(nbuf, vbuf, vsiz);
+              if (off > vsiz) std::memset(nbuf + vsiz, 0, off - vsiz);
+              std::memcpy(nbuf + off, rbuf, max);
+              int32_t nsiz = std::max((int64_t)vsiz, off + (int64_t)max);
+              char cbuf[RECBUFSIZ];
+              if (db_->get(kbuf, ksiz, cbuf, sizeof(cbuf)) != nsiz ||
+                  std::memcmp(cbuf, nbuf, nsiz)) {
+                dberrprint(db_, __LINE__, "DB::write_range");
+                err_ = true;
+              }
+            }
+            if (!db_->set(kbuf, ksiz, vbuf, vsiz)) {
+              dberrprint(db_, __LINE__, "DB::set");
+              err_ = true;
+            }
+          } else if (!rnd_ || db_->error() != kc::BasicDB::Error::NOREC) {
+            dberrprint(db_, __LINE__, "DB::get");
+            err_ = true;
+          }
+          if (tran_ && !db_->end_transaction(true)) {
+            dberrprint(db_, __LINE__, "DB::end_transaction");
+            err_ = true;
+          }
+          if (id_ < 1 && rnum_ > 250 && i % (rnum_ / 250) == 0) {
+            oputchar('.');
+            if (i == rnum_ || i % (rnum_ / 10) == 0) oprintf(" (%08lld)\n", (long long)i);
+          }
+        }
+      }
+     private:
+      int32_t id_;
+      kc::BasicDB* db_;
+      int64_t rnum_;
+      int32_t thnum_;
+      bool err_;
+      bool rnd_;
+      bool tran_;
+    };
+    ThreadRange threadranges[THREADMAX];
+    if (thnum < 2) {
+      threadranges[0].setparams(0, &db, rnum, thnum, rnd, tran);
+      threadranges[0].run();
+      if (threadranges[0].error()) err = true;
+    } else {
+      for (int32_t i = 0; i < thnum; i++) {
+        threadranges[i].setparams(i, &db, rnum, thnum, rnd, tran);
+        threadranges[i].start();
+      }
+      for (int32_t i = 0; i < thnum; i++) {
+        threadranges[i].join();
+        if (threadranges[i].error()) err = true;
+      }
+    }
+    etime = kc::time();
+    dbmetaprint(&db, false);
+    oprintf("time: %.3f\n", etime - stime);
+  }
+  if (mode == 'e') {
+    oprintf("merging records:\n");
+    stime = kc::time();
+    class ThreadMerge : public kc::Thread {
+     public:
+      void setparams(int32_t id, kc::BasicDB* db, int64_t rnum, int32_t thnum,
+                     bool rnd, bool tran, kc::MergeOperator* mop) {
+        id_ = id;
+        db_ = db;
+        rnum_ = rnum;
+        thnum_ = thnum;
+        err_ = false;
+        rnd_ = rnd;
+        tran_ = tran;
+        mop_ = mop;
+        for (int32_t j = 0; j < KEYNUM; j++) {
+          sums_[j] = 0;
+          maxs_[j] = -1;
+          cats_[j].clear();
+        }
+      }
+      bool error() {
+        return err_;
+      }
+      void run() {
+        for (int64_t i = 1; !err_ && i <= rnum_; i++) {
+          if (tran_ && !db_->begin_transaction(false)) {
+            dberrprint(db_, __LINE__, "DB::begin_transaction");
+            err_ = true;
+          }
+          int32_t j = rnd_ ? myrand(KEYNUM) : i % KEYNUM;
+          int64_t num = rnd_ ? myrand(rnum_) : i;
+          char kbuf[RECBUFSIZ];
+          char obuf[RECBUFSIZ];
+          size_t ksiz, osiz;
+          switch (i % 3) {
+            default: {
+              ksiz = std::sprintf(kbuf, "-add-%d-%d", id_, j);
+              uint64_t big = kc::hton64(num);
+              std::memcpy(obuf, &big, sizeof(big));
+              osiz = sizeof(big);
+              if (!db_->merge_operand(kbuf, ksiz, obuf, osiz, kc::ADDITIONMERGE)) {
+                dberrprint(db_, __LINE__, "DB::merge_operand");
+                err_ = true;
+              }
+              sums_[j] += num;
+              break;
+            }
+            case 1: {
+              ksiz = std::sprintf(kbuf, "-cat-%d-%d", id_, j);
+              osiz = std::sprintf(obuf, "%lld,", (long long)num);
+              if (!db_->merge_operand(kbuf, ksiz, obuf, osiz, kc::CONCATMERGE)) {
+                dberrprint(db_, __LINE__, "DB::merge_operand");
+                err_ = true;
+              }
+              cats_[j].append(obuf, osiz);
+              break;
+            }
+            case 2: {
+              ksiz = std::sprintf(kbuf, "-max-%d-%d", id_, j);
+              osiz = std::sprintf(obuf, "%lld", (long long)num);
+              if (!db_->merge_operand(kbuf, ksiz, obuf, osiz, mop_)) {
+                dberrprint(db_, __LINE__, "DB::merge_operand");
+                err_ = true;
+              }
+              if (num > maxs_[j]) maxs_[j] = num;
+              break;
+            }
+          }
+          if (tran_ && !db_->end_transaction(true)) {
+            dberrprint(db_, __LINE__, "DB::end_transaction");
+            err_ = true;
+          }
+          if (id_ < 1 && rnum_ > 250 && i % (rnum_ / 250) == 0) {
+            oputchar('.');
+            if (i == rnum_ || i % (rnum_ / 10) == 0) oprintf(" (%08lld)\n", (long long)i);
+          }
+        }
+        if (!err_ && !check(db_, true)) err_ = true;
+      }
+      bool check(kc::BasicDB* db, bool strict) {
+        for (int32_t j = 0; j < KEYNUM; j++) {
+          char kbuf[RECBUFSIZ];
+          size_t ksiz = std::sprintf(kbuf, "-add-%d-%d", id_, j);
+          size_t vsiz;
+          char* vbuf = db->get(kbuf, ksiz, &vsiz);
+          if (vbuf) {
+            uint64_t big = 0;
+            if (vsiz == sizeof(big)) std::memcpy(&big, vbuf, sizeof(big));
+            if (vsiz != sizeof(big) || (int64_t)kc::ntoh64(big) != sums_[j]) {
+              dberrprint(db, __LINE__, "DB::merge_operand");
+              delete[] vbuf;
+              return false;
+            }
+            delete[] vbuf;
+          } else if (sums_[j] > 0 || db->error() != kc::BasicDB::Error::NOREC) {
+            dberrprint(db, __LINE__, "DB::get");
+            return false;
+          }
+          ksiz = std::sprintf(kbuf, "-cat-%d-%d", id_, j);
+          vbuf = db->get(kbuf, ksiz, &vsiz);
+          if (vbuf) {
+            if (vsiz != cats_[j].size() || std::memcmp(vbuf, cats_[j].data(), vsiz)) {
+              dberrprint(db, __LINE__, "DB::merge_operand");
+              delete[] vbuf;
+              return false;
+            }
+            delete[] vbuf;
+          } else if (!cats_[j].empty() || db->error() != kc::BasicDB::Error::NOREC) {
+            dberrprint(db, __LINE__, "DB::get");
+            return false;
+          }
+          ksiz = std::sprintf(kbuf, "-max-%d-%d", id_, j);
+          vbuf = db->get(kbuf, ksiz, &vsiz);
+          if (vbuf) {
+            if (kc::atoin(vbuf, vsiz) != maxs_[j]) {
+              dberrprint(db, __LINE__, "DB::merge_operand");
+              delete[] vbuf;
+              return false;
+            }
+            delete[] vbuf;
+          } else if (maxs_[j] >= 0 || db->error() != kc::BasicDB::Error::NOREC) {
+            if (strict || db->error() != kc::BasicDB::Error::INVALID) {
+              dberrprint(db, __LINE__, "DB::get");
+              return false;
+            }
+          }
+        }
+        return true;
+      }
+      bool clean() {
+        for (int32_t j = 0; j < KEYNUM; j++) {
+          const char* names[] = { "add", "cat", "max" };
+          for (size_t k = 0; k < sizeof(names) / sizeof(*names); k++) {
+            char kbuf[RECBUFSIZ];
+            size_t ksiz = std::sprintf(kbuf, "-%s-%d-%d", names[k], id_, j);
+            if (!db_->remove(kbuf, ksiz) && db_->error() != kc::BasicDB::Error::NOREC) {
+              dberrprint(db_, __LINE__, "DB::remove");
+              return false;
+            }
+          }
+        }
+        return true;
+      }
+     private:
+      enum { KEYNUM = 17 };
+      int32_t id_;
+      kc::BasicDB* db_;
+      int64_t rnum_;
+      int32_t thnum_;
+      bool err_;
+      bool rnd_;
+      bool tran_;
+      kc::MergeOperator* mop_;
+      int64_t sums_[KEYNUM];
+      int64_t maxs_[KEYNUM];
+      std::string cats_[KEYNUM];
+    };
+    ThreadMerge threadmerges[THREADMAX];
+    int32_t mthnum = thnum < 2 ? 1 : thnum;
+    if (thnum < 2) {
+      threadmerges[0].setparams(0, &db, rnum, thnum, rnd, tran, &mop);
+      threadmerges[0].run();
+      if (threadmerges[0].error()) err = true;
+    } else {
+      for (int32_t i = 0; i < thnum; i++) {
+        threadmerges[i].setparams(i, &db, rnum, thnum, rnd, tran, &mop);
+        threadmerges[i].start();
+      }
+      for (int32_t i = 0; i < thnum; i++) {
+        threadmerges[i].join();
+        if (threadmerges[i].error()) err = true;
+      }
+    }
+    if (!err && dynamic_cast<kc::LogTreeDB*>(db.reveal_inner_db())) {
+      class CopyProcessor : public kc::BasicDB::FileProcessor {
+       public:
+        explicit CopyProcessor(const std::string& dest) : dest_(dest) {}
+       private:
+        bool process(const std::string& path, int64_t count, int64_t size) {
+          kc::File::remove_recursively(dest_);
+          std::vector<std::string> names;
+          if (!kc::File::read_directory(path, &names) || !kc::File::make_directory(dest_))
+            return false;
+          for (size_t i = 0; i < names.size(); i++) {
+            const std::string& spath = path + kc::File::PATHCHR + names[i];
+            int64_t fsiz;
+            char* fbuf = kc::File::read_file(spath, &fsiz);
+            if (!fbuf) {
+              kc::File::Status sbuf;
+              if (kc::File::status(spath, &sbuf)) return false;
+              continue;
+            }
+            bool ok = kc::File::write_file(dest_ + kc::File::PATHCHR + names[i], fbuf, fsiz);
+            delete[] fbuf;
+            if (!ok) return false;
+          }
+          return true;
+        }
+        std::string dest_;
+      };
+      std::string cpath = db.path() + "-copy";
+      CopyProcessor proc(cpath);
+      if (!db.synchronize(false, &proc)) {
+        dberrprint(&db, __LINE__, "DB::synchronize");
+        err = true;
+      }
+      kc::LogTreeDB ldb;
+      if (!err && !ldb.open(cpath, kc::LogTreeDB::OWRITER)) {
+        dberrprint(&ldb, __LINE__, "DB::open");
+        err = true;
+      }
+      for (int32_t i = 0; !err && i < mthnum; i++) {
+        if (!threadmerges[i].check(&ldb, false)) err = true;
+      }
+      if (!err && !ldb.close() && ldb.error() != kc::BasicDB::Error::INVALID) {
+        dberrprint(&ldb, __LINE__, "DB::close");
+        err = true;
+      }
+      if (!err) {
+        ldb.tune_merge_operator(&mop);
+        if (!ldb.open(cpath, kc::LogTreeDB::OWRITER)) {
+          dberrprint(&ldb, __LINE__, "DB::open");
+          err = true;
+        }
+        for (int32_t i = 0; !err && i < mthnum; i++) {
+          if (!threadmerges[i].check(&ldb, true)) err = true;
+        }
+        if (!ldb.close()) {
+          dberrprint(&ldb, __LINE__, "DB::close");
+          err = true;
+        }
+      }
+      kc::File::remove_recursively(cpath);
+    }
+    for (int32_t i = 0; !err && i < mthnum; i++) {
+      if (!threadmerges[i].clean()) err = true;
+    }
+    etime = kc::time();
+    dbmetaprint(&db, false);
+    oprintf("time: %.3f\n", etime - stime);
+  }
   if (mode == 'e') {
     oprintf("traversing the database by the inner iterator:\n");
     stime = kc::time();
@@ -2275,6 +2704,183 @@ static int32_t procmapred(const char* path, int64_t rnum, bool rnd, int32_t ofla
 }
 
 
+// perform index command
+static int32_t procindex(const char* path, int64_t rnum, int32_t thnum, bool rnd,
+                         int32_t oflags, bool lv) {
+  oprintf("<Index Test>\n  seed=%u  path=%s  rnum=%lld  thnum=%d  rnd=%d  oflags=%d  lv=%d\n\n",
+          g_randseed, path, (long long)rnum, thnum, rnd, oflags, lv);
+  bool err = false;
+  kc::PolyDB db;
+  db.tune_logger(stdlogger(g_progname, &std::cout),
+                 lv ? kc::UINT32MAX : kc::BasicDB::Logger::WARN | kc::BasicDB::Logger::ERROR);
+  double stime = kc::time();
+  uint32_t omode = kc::PolyDB::OWRITER | kc::PolyDB::OCREATE | kc::PolyDB::OTRUNCATE;
+  if (!db.open(path, omode | oflags)) {
+    dberrprint(&db, __LINE__, "DB::open");
+    err = true;
+  }
+  kc::PolyDB idb;
+  if (!idb.open("+", omode)) {
+    dberrprint(&idb, __LINE__, "DB::open");
+    err = true;
+  }
+  class ExtractorImpl : public kc::IndexedDB::Extractor {
+   public:
+    void extract(const char* kbuf, size_t ksiz, const char* vbuf, size_t vsiz,
+                 std::vector<std::string>* ikeys) {
+      const char* pv = (const char*)std::memchr(vbuf, ':', vsiz);
+      if (pv) ikeys->push_back(std::string(vbuf, pv - vbuf));
+    }
+  };
+  ExtractorImpl extractor;
+  kc::IndexedDB xdb(&db);
+  size_t idx = xdb.add_index(&idb, &extractor);
+  int64_t pnum = rnum / 10;
+  if (pnum < 1) pnum = 1;
+  oprintf("setting records:\n");
+  std::map<std::string, std::string> recs;
+  for (int64_t i = 1; !err && i <= rnum; i++) {
+    char kbuf[RECBUFSIZ];
+    size_t ksiz = std::sprintf(kbuf, "%lld", (long long)(rnd ? myrand(rnum) + 1 : i));
+    char vbuf[RECBUFSIZ];
+    size_t vsiz = std::sprintf(vbuf, "%08lld:%lld",
+                               (long long)(rnd ? myrand(pnum) : i % pnum), (long long)i);
+    if (i % 3 == 0) {
+      recs[std::string(kbuf, ksiz)] = std::string(vbuf, vsiz);
+      if (recs.size() >= 10) {
+        if (xdb.set_bulk(recs) < 0) {
+          dberrprint(&db, __LINE__, "IndexedDB::set_bulk");
+          err = true;
+        }
+        recs.clear();
+      }
+    } else if (!xdb.set(kbuf, ksiz, vbuf, vsiz)) {
+      dberrprint(&db, __LINE__, "IndexedDB::set");
+      err = true;
+    }
+    if (rnum > 250 && i % (rnum / 250) == 0) {
+      oputchar('.');
+      if (i == rnum || i % (rnum / 10) == 0) oprintf(" (%08lld)\n", (long long)i);
+    }
+  }
+  if (!recs.empty() && xdb.set_bulk(recs) < 0) {
+    dberrprint(&db, __LINE__, "IndexedDB::set_bulk");
+    err = true;
+  }
+  oprintf("removing records:\n");
+  for (int64_t i = 1; !err && i <= rnum; i++) {
+    if (i % 5 != 0) continue;
+    char kbuf[RECBUFSIZ];
+    size_t ksiz = std::sprintf(kbuf, "%lld", (long long)(rnd ? myrand(rnum) + 1 : i));
+    if (!xdb.remove(kbuf, ksiz) && db.error() != kc::BasicDB::Error::NOREC) {
+      dberrprint(&db, __LINE__, "IndexedDB::remove");
+      err = true;
+    }
+  }
+  for (int32_t round = 0; !err && round < 2; round++) {
+    if (round > 0) {
+      oprintf("rebuilding the index while updating records:\n");
+      class ThreadRebuild : public kc::Thread {
+       public:
+        void setparams(kc::IndexedDB* xdb, int32_t thnum) {
+          xdb_ = xdb;
+          thnum_ = thnum;
+          err_ = false;
+        }
+        bool error() {
+          return err_;
+        }
+       private:
+        void run() {
+          if (!xdb_->rebuild(thnum_)) {
+            dberrprint(xdb_->db(), __LINE__, "IndexedDB::rebuild");
+            err_ = true;
+          }
+        }
+        kc::IndexedDB* xdb_;
+        int32_t thnum_;
+        bool err_;
+      };
+      ThreadRebuild threbuild;
+      threbuild.setparams(&xdb, thnum);
+      threbuild.start();
+      for (int64_t i = 1; !err && i <= rnum; i++) {
+        if (i % 7 != 0) continue;
+        char kbuf[RECBUFSIZ];
+        size_t ksiz = std::sprintf(kbuf, "%lld", (long long)(rnd ? myrand(rnum) + 1 : i));
+        if (i % 3 == 0) {
+          if (!xdb.remove(kbuf, ksiz) && db.error() != kc::BasicDB::Error::NOREC) {
+            dberrprint(&db, __LINE__, "IndexedDB::remove");
+            err = true;
+          }
+        } else {
+          char vbuf[RECBUFSIZ];
+          size_t vsiz = std::sprintf(vbuf, "%08lld:%lld",
+                                     (long long)(rnd ? myrand(pnum) : (i + 1) % pnum),
+                                     (long long)i);
+          if (!xdb.set(kbuf, ksiz, vbuf, vsiz)) {
+            dberrprint(&db, __LINE__, "IndexedDB::set");
+            err = true;
+          }
+        }
+      }
+      threbuild.join();
+      if (threbuild.error()) err = true;
+    }
+    oprintf("scanning the index:\n");
+    kc::IndexedDB::Cursor* cur = xdb.cursor(idx);
+    int64_t cnt = 0;
+    std::string ikey, pkey, value, lkey;
+    if (cur->jump()) {
+      while (cur->get(&ikey, &pkey, &value, true)) {
+        if (value.compare(0, ikey.size() + 1, ikey + ":") || ikey < lkey) {
+          dberrprint(&db, __LINE__, "IndexedDB::Cursor::get");
+          err = true;
+          break;
+        }
+        lkey = ikey;
+        cnt++;
+      }
+      if (db.error() != kc::BasicDB::Error::NOREC) {
+        dberrprint(&db, __LINE__, "IndexedDB::Cursor::get");
+        err = true;
+      }
+    } else if (db.error() != kc::BasicDB::Error::NOREC) {
+      dberrprint(&db, __LINE__, "IndexedDB::Cursor::jump");
+      err = true;
+    }
+    if (cnt != db.count() || cnt != idb.count()) {
+      dberrprint(&db, __LINE__, "IndexedDB::Cursor::get");
+      err = true;
+    }
+    char kbuf[RECBUFSIZ];
+    size_t ksiz = std::sprintf(kbuf, "%08lld", (long long)(pnum / 2));
+    if (cur->jump(kbuf, ksiz)) {
+      if (!cur->get(&ikey, NULL, NULL) || ikey < std::string(kbuf, ksiz)) {
+        dberrprint(&db, __LINE__, "IndexedDB::Cursor::get");
+        err = true;
+      }
+    } else if (db.error() != kc::BasicDB::Error::NOREC) {
+      dberrprint(&db, __LINE__, "IndexedDB::Cursor::jump");
+      err = true;
+    }
+    delete cur;
+    dbmetaprint(&idb, false);
+  }
+  if (!idb.close()) {
+    dberrprint(&idb, __LINE__, "DB::close");
+    err = true;
+  }
+  if (!db.close()) {
+    dberrprint(&db, __LINE__, "DB::close");
+    err = true;
+  }
+  oprintf("time: %.3f\n", kc::time() - stime);
+  oprintf("%s\n\n", err ? "error" : "ok");
+  return err ? 1 : 0;
+}
+
+
 // perform misc command
 static int32_t procmisc(const char* path) {
   oprintf("<Miscellaneous Test>\n  seed=%u  path=%s\n\n", g_randseed, path);
@@ -2427,6 +3033,52 @@ static int32_t procmisc(const char* path) {
   }
   kc::PolyDB* pdb = dynamic_cast<kc::PolyDB*>(db);
   if (pdb) {
+    oprintf("matching keys:\n");
+    class VisitorMatch : public kc::DB::Visitor {
+     public:
+      explicit VisitorMatch(kc::Regex* regex, std::vector<std::string>* keys) :
+          regex_(regex), keys_(keys) {}
+     private:
+      const char* visit_full(const char* kbuf, size_t ksiz,
+                             const char* vbuf, size_t vsiz, size_t* sp) {
+        std::string key(kbuf, ksiz);
+        if (regex_->match(key)) keys_->push_back(key);
+        return NOP;
+      }
+      kc::Regex* regex_;
+      std::vector<std::string>* keys_;
+    };
+    const char* regexes[] = {
+      "^0000012", "^000001[0-9]5", "^00.01", "12.*3$", "^0+1{0,2}23", "^(00|11)0001",
+      "9?98$", "0012|0034", "^0*12?34", "^0000[^1]", "", "^"
+    };
+    for (size_t i = 0; !err && i < sizeof(regexes) / sizeof(*regexes); i++) {
+      std::vector<std::string> mkeys;
+      if (pdb->match_regex(regexes[i], &mkeys) < 0) {
+        dberrprint(db, __LINE__, "DB::match_regex");
+        err = true;
+        break;
+      }
+      kc::Regex regex;
+      if (!regex.compile(regexes[i], kc::Regex::MATCHONLY)) {
+        eprintf("%s: %s: compilation failed\n", g_progname, regexes[i]);
+        err = true;
+        break;
+      }
+      std::vector<std::string> skeys;
+      VisitorMatch visitor(&regex, &skeys);
+      if (!db->iterate(&visitor, false)) {
+        dberrprint(db, __LINE__, "DB::iterate");
+        err = true;
+        break;
+      }
+      std::sort(mkeys.begin(), mkeys.end());
+      std::sort(skeys.begin(), skeys.end());
+      if (mkeys != skeys) {
+        eprintf("%s: %s: matched keys mismatch\n", g_progname, regexes[i]);
+        err = true;
+      }
+    }
     kc::BasicDB* idb = pdb->reveal_inner_db();
     if (idb) {
       const std::type_info& info = typeid(*idb);
@@ -2454,11 +3106,75 @@ static int32_t procmisc(const char* path) {
           dberrprint(&srcdb, __LINE__, "DB::open");
           err = true;
         }
+        class VisitorMerged : public kc::DB::Visitor {
+         public:
+          explicit VisitorMerged(kc::BasicDB* db, int32_t times) :
+              db_(db), times_(times), err_(false) {}
+          bool error() {
+            return err_;
+          }
+         private:
+          const char* visit_full(const char* kbuf, size_t ksiz,
+                                 const char* vbuf, size_t vsiz, size_t* sp) {
+            std::string value;
+            for (int32_t i = 0; i < times_; i++) {
+              value.append(vbuf, vsiz);
+            }
+            size_t rsiz;
+            char* rbuf = db_->get(kbuf, ksiz, &rsiz);
+            if (rbuf) {
+              if (rsiz != value.size() || std::memcmp(rbuf, value.data(), rsiz)) {
+                eprintf("%s: merged value mismatch\n", g_progname);
+                err_ = true;
+              }
+              delete[] rbuf;
+            } else {
+              dberrprint(db_, __LINE__, "DB::get");
+              err_ = true;
+            }
+            return NOP;
+          }
+          kc::BasicDB* db_;
+          int32_t times_;
+          bool err_;
+        };
         kc::BasicDB* bdb = &srcdb;
         if (!pdb->merge(&bdb, 1, kc::PolyDB::MAPPEND)) {
           dberrprint(db, __LINE__, "DB::merge");
           err = true;
         }
+        VisitorMerged appended(pdb, 2);
+        if (!err && (!srcdb.iterate(&appended, false) || appended.error())) {
+          dberrprint(&srcdb, __LINE__, "DB::iterate");
+          err = true;
+        }
+        class ReducerImpl : public kc::PolyDB::MergeReducer {
+         private:
+          const char* reduce(const char* kbuf, size_t ksiz, const char* obuf, size_t osiz,
+                             const char* nbuf, size_t nsiz, size_t* sp) {
+            if (osiz <= nsiz) return kc::PolyDB::Visitor::NOP;
+            *sp = nsiz;
+            return nbuf;
+          }
+        };
+        ReducerImpl reducer;
+        kc::BasicDB* srcary[6];
+        for (size_t i = 0; i < sizeof(srcary) / sizeof(*srcary); i++) {
+          srcary[i] = &srcdb;
+        }
+        if (!pdb->merge(srcary, sizeof(srcary) / sizeof(*srcary), &reducer)) {
+          dberrprint(db, __LINE__, "DB::merge");
+          err = true;
+        }
+        VisitorMerged reduced(pdb, 1);
+        if (!err && (!srcdb.iterate(&reduced, false) || reduced.error())) {
+          dberrprint(&srcdb, __LINE__, "DB::iterate");
+          err = true;
+        }
+        if (!err && pdb->count() != srcdb.count()) {
+          dberrprint(db, __LINE__, "DB::count");
+          err = true;
+        }
         if (!srcdb.close()) {
           dberrprint(&srcdb, __LINE__, "DB::close");
           err = true;
@@ -141,6 +141,33 @@ bool Regex::match(const std::string& str) {
 }
 
 
+/**
+ * Check whether a string matches the regular expression.
+ */
+bool Regex::match(const char* buf, size_t size) {
+#if _KC_PXREGEX
+  _assert_(buf && size <= MEMMAXSIZ);
+#if defined(REG_STARTEND)
+  RegexCore* core = (RegexCore*)opq_;
+  if (!core->alive) return false;
+  if (!std::memchr(buf, '\0', size)) {
+    ::regmatch_t subs[1];
+    subs[0].rm_so = 0;
+    subs[0].rm_eo = size;
+    return ::regexec(&core->rbuf, buf, 1, subs, REG_STARTEND) == 0;
+  }
+#endif
+  return match(std::string(buf, size));
+#else
+  _assert_(buf && size <= MEMMAXSIZ);
+  RegexCore* core = (RegexCore*)opq_;
+  if (!core->rbuf) return false;
+  std::cmatch res;
+  return std::regex_search(buf, buf + size, res, *core->rbuf);
+#endif
+}
+
+
 /**
  * Check whether a string matches the regular expression.
  */
@@ -190,6 +217,141 @@ std::string Regex::replace(const std::string& str, const std::string& alt) {
 }
 
 
+/**
+ * Extract the literal prefix required by a regular expression.
+ */
+std::string Regex::literal_prefix(const std::string& regex, uint32_t opts) {
+  _assert_(true);
+  if ((opts & IGNCASE) || regex.empty() || regex[0] != '^') return "";
+  std::vector<std::string> lits;
+  bool head;
+  if (!split_literals(regex.substr(1), &lits, &head) || !head) return "";
+  return lits.front();
+}
+
+
+/**
+ * Extract the longest literal substring required by a regular expression.
+ */
+std::string Regex::literal_substring(const std::string& regex, uint32_t opts) {
+  _assert_(true);
+  if (opts & IGNCASE) return "";
+  std::vector<std::string> lits;
+  bool head;
+  if (!split_literals(regex, &lits, &head)) return "";
+  std::string lit;
+  std::vector<std::string>::iterator it = lits.begin();
+  std::vector<std::string>::iterator itend = lits.end();
+  while (it != itend) {
+    if (it->size() > lit.size()) lit = *it;
+    ++it;
+  }
+  return lit;
+}
+
+
+/**
+ * Split a regular expression into the literal strings required in order.
+ */
+bool Regex::split_literals(const std::string& regex, std::vector<std::string>* lits,
+                           bool* head) {
+  _assert_(lits && head);
+  *head = false;
+  const char* rp = regex.c_str();
+  const char* ep = rp + regex.size();
+  std::string lit;
+  while (rp < ep) {
+    char c = *rp;
+    const char* np = rp + 1;
+    bool literal = false;
+    switch (c) {
+      case '|': {
+        lits->clear();
+        return false;
+      }
+      case '\\': {
+        if (np >= ep) {
+          lits->clear();
+          return false;
+        }
+        c = *np;
+        np++;
+        literal = !((c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') ||
+                    c == '<' || c == '>' || c == '`' || c == '\'');
+        int32_t xnum = c == 'x' ? 2 : c == 'u' ? 4 : c == 'c' ? 1 : 0;
+        while (xnum-- > 0 && np < ep) {
+          np++;
+        }
+        break;
+      }
+      case '[': {
+        if (np < ep && *np == '^') np++;
+        if (np < ep && *np == ']') np++;
+        while (np < ep && *np != ']') {
+          if (*np == '\\' || *np == '[') {
+            lits->clear();
+            return false;
+          }
+          np++;
+        }
+        if (np < ep) np++;
+        break;
+      }
+      case '(': {
+        int32_t depth = 1;
+        while (np < ep && depth > 0) {
+          if (*np == '\\') {
+            np++;
+          } else if (*np == '(') {
+            depth++;
+          } else if (*np == ')') {
+            depth--;
+          }
+          np++;
+        }
+        break;
+      }
+      case '.': case '^': case '$': case ')': case ']': case '{': case '}':
+      case '*': case '+': case '?': {
+        break;
+      }
+      default: {
+        literal = true;
+        break;
+      }
+    }
+    bool optional = false;
+    bool repeated = false;
+    if (np < ep) {
+      switch (*np) {
+        case '*': case '?': case '{': optional = true; break;
+        case '+': repeated = true; break;
+      }
+    }
+    if (literal && !optional) {
+      if (lits->empty() && lit.empty() && rp == regex.c_str()) *head = true;
+      lit.append(1, c);
+    }
+    if (!literal || optional || repeated) {
+      if (!lit.empty()) lits->push_back(lit);
+      lit.clear();
+    }
+    if (optional || repeated) {
+      np++;
+      if (np[-1] == '{') {
+        while (np < ep && np[-1] != '}') {
+          np++;
+        }
+      }
+      if (np < ep && (*np == '?' || *np == '+')) np++;
+    }
+    rp = np;
+  }
+  if (!lit.empty()) lits->push_back(lit);
+  return true;
+}
+
+
 }                                        // common namespace
 
 // END OF FILE
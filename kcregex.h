@@ -55,6 +55,14 @@ class Regex {
    * @return true if the string matches, or false if not.
    */
   bool match(const std::string& str);
+  /**
+   * Check whether a string matches the regular expression.
+   * @param buf the pointer to the region of the string.
+   * @param size the size of the region.
+   * @return true if the string matches, or false if not.
+   * @note The region is copied only if the implementation requires a terminated string.
+   */
+  bool match(const char* buf, size_t size);
   /**
    * Check whether a string matches the regular expression.
    * @param str the string.
@@ -96,7 +104,37 @@ class Regex {
     if (!regex.compile(pattern, opts)) return str;
     return regex.replace(str, alt);
   }
+  /**
+   * Extract the literal prefix required by a regular expression.
+   * @param regex the string of regular expression.
+   * @param opts the optional features by bitwise-or: Regex::IGNCASE for case-insensitive
+   * matching.
+   * @return the literal string with which every matching string begins.  If the expression is
+   * not anchored at the beginning, no such string is determined, or the matching is
+   * case-insensitive, an empty string is returned.
+   */
+  static std::string literal_prefix(const std::string& regex, uint32_t opts = 0);
+  /**
+   * Extract the longest literal substring required by a regular expression.
+   * @param regex the string of regular expression.
+   * @param opts the optional features by bitwise-or: Regex::IGNCASE for case-insensitive
+   * matching.
+   * @return the literal string which every matching string contains.  If no such string is
+   * determined or the matching is case-insensitive, an empty string is returned.
+   */
+  static std::string literal_substring(const std::string& regex, uint32_t opts = 0);
  private:
+  /**
+   * Split a regular expression into the literal strings required in order.
+   * @param regex the string of regular expression.
+   * @param lits a string vector to contain the result.
+   * @param head the pointer to the variable into which whether the first literal string begins
+   * the expression is assigned.
+   * @return true on success, or false if the expression contains top-level alternation or
+   * constructs which are not analyzed.
+   */
+  static bool split_literals(const std::string& regex, std::vector<std::string>* lits,
+                             bool* head);
   /** Dummy constructor to forbid the use. */
   Regex(const Regex&);
   /** Dummy Operator to forbid the use. */
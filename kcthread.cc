@@ -1137,6 +1137,25 @@ void SlottedRWLock::lock_writer(size_t idx) {
 }
 
 
+/**
+ * Try to get the writer lock of a slot.
+ */
+bool SlottedRWLock::lock_writer_try(size_t idx) {
+#if defined(_SYS_MSVC_) || defined(_SYS_MINGW_)
+  _assert_(true);
+  SlottedRWLockCore* core = (SlottedRWLockCore*)opq_;
+  return core->rwlocks[idx].lock_writer_try();
+#else
+  _assert_(true);
+  SlottedRWLockCore* core = (SlottedRWLockCore*)opq_;
+  int32_t ecode = ::pthread_rwlock_trywrlock(core->rwlocks + idx);
+  if (ecode == 0) return true;
+  if (ecode != EBUSY) throw std::runtime_error("pthread_rwlock_trywrlock");
+  return false;
+#endif
+}
+
+
 /**
  * Get the reader lock of a slot.
  */
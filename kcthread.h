@@ -411,6 +411,12 @@ class SlottedRWLock {
    * @param idx the index of a slot.
    */
   void lock_writer(size_t idx);
+  /**
+   * Try to get the writer lock of a slot.
+   * @param idx the index of a slot.
+   * @return true on success, or false on failure.
+   */
+  bool lock_writer_try(size_t idx);
   /**
    * Get the reader lock of a slot.
    * @param idx the index of a slot.
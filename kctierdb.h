@@ -0,0 +1,1304 @@
+/*************************************************************************************************
+ * Tiered database with a cache in memory
+ *                                                               Copyright (C) 2009-2011 FAL Labs
+ * This file is part of Kyoto Cabinet.
+ * This program is free software: you can redistribute it and/or modify it under the terms of
+ * the GNU General Public License as published by the Free Software Foundation, either version
+ * 3 of the License, or any later version.
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ *************************************************************************************************/
+
+
+#ifndef _KCTIERDB_H                      // duplication check
+#define _KCTIERDB_H
+
+#include <kccommon.h>
+#include <kcutil.h>
+#include <kcthread.h>
+#include <kcfile.h>
+#include <kccompress.h>
+#include <kccompare.h>
+#include <kcmap.h>
+#include <kcregex.h>
+#include <kcdb.h>
+#include <kcplantdb.h>
+#include <kccachedb.h>
+
+namespace kyotocabinet {                 // common namespace
+
+
+/**
+ * Tiered database with a cache in memory.
+ * @note This class is a wrapper to put a cache hash database in front of another database as
+ * an automatic read-through cache.  Records read from the backend database are kept in the
+ * cache with LRU eviction.  Updates are written into the backend immediately in the
+ * write-through mode, or buffered and written by a background thread in the write-back mode.
+ * While a transaction is running, every update is written through and the cache is
+ * invalidated for the updated records when the transaction is aborted.  Iteration and cursors
+ * are delegated to the backend database after the buffered updates are written.  This class
+ * can be inherited but overwriting methods is forbidden.  The backend database is opened and
+ * closed by this object but its possession is not transferred.
+ */
+class TieredDB : public BasicDB {
+ public:
+  class Cursor;
+ private:
+  struct DirtyRecord;
+  struct Slot;
+  class ScopedVisitor;
+  class InvalidateVisitor;
+  class Flusher;
+  /** An alias of the table of updated records not written yet. */
+  typedef std::map<std::string, DirtyRecord> DirtyMap;
+  /** An alias of the set of keys updated in transaction. */
+  typedef std::set<std::string> KeySet;
+  /** The number of slots of the record lock. */
+  static const int32_t SLOTNUM = 16;
+  /** The default capacity size of the cache. */
+  static const int64_t DEFCAPSIZ = 64LL << 20;
+  /** The default capacity size of the buffered updates. */
+  static const int64_t DEFWBCAP = 16LL << 20;
+  /** The threshold of busy loop and sleep for locking. */
+  static const uint32_t LOCKBUSYLOOP = 8192;
+ public:
+  /**
+   * Cursor to indicate a record.
+   * @note The cursor is a wrapper of a cursor of the backend database.  Buffered updates are
+   * written into the backend before each operation.
+   */
+  class Cursor : public BasicDB::Cursor {
+    friend class TieredDB;
+   public:
+    /**
+     * Constructor.
+     * @param db the container database object.
+     */
+    explicit Cursor(TieredDB* db) : db_(db), cur_(NULL) {
+      _assert_(db);
+      cur_ = db_->db_->cursor();
+    }
+    /**
+     * Destructor.
+     */
+    virtual ~Cursor() {
+      _assert_(true);
+      delete cur_;
+    }
+    /**
+     * Accept a visitor to the current record.
+     * @param visitor a visitor object.
+     * @param writable true for writable operation, or false for read-only operation.
+     * @param step true to move the cursor to the next record, or false for no move.
+     * @return true on success, or false on failure.
+     * @note The operation for each record is performed atomically and other threads accessing
+     * the same record are blocked.  To avoid deadlock, any explicit database operation must not
+     * be performed in this function.
+     */
+    bool accept(Visitor* visitor, bool writable = true, bool step = false) {
+      _assert_(visitor);
+      ScopedRWLock lock(&db_->mlock_, writable);
+      if (!prepare(writable)) return false;
+      if (!writable) return finish(cur_->accept(visitor, false, step));
+      InvalidateVisitor ivis(db_, visitor);
+      return finish(cur_->accept(&ivis, true, step));
+    }
+    /**
+     * Accept a visitor to the current record and the following records.
+     * @param visitor a visitor object.
+     * @param max the maximum number of records to visit.
+     * @param writable true for writable operation, or false for read-only operation.
+     * @return the number of visited records, or -1 on failure.
+     */
+    int64_t accept_batch(Visitor* visitor, int64_t max, bool writable = false) {
+      _assert_(visitor);
+      ScopedRWLock lock(&db_->mlock_, writable);
+      if (!prepare(writable)) return -1;
+      int64_t cnt;
+      if (writable) {
+        InvalidateVisitor ivis(db_, visitor);
+        cnt = cur_->accept_batch(&ivis, max, true);
+      } else {
+        cnt = cur_->accept_batch(visitor, max, false);
+      }
+      if (cnt < max) finish(false);
+      return cnt;
+    }
+    /**
+     * Jump the cursor to the first record for forward scan.
+     * @return true on success, or false on failure.
+     */
+    bool jump() {
+      _assert_(true);
+      ScopedRWLock lock(&db_->mlock_, false);
+      if (!prepare(false)) return false;
+      return finish(cur_->jump());
+    }
+    /**
+     * Jump the cursor to a record for forward scan.
+     * @param kbuf the pointer to the key region.
+     * @param ksiz the size of the key region.
+     * @return true on success, or false on failure.
+     */
+    bool jump(const char* kbuf, size_t ksiz) {
+      _assert_(kbuf && ksiz <= MEMMAXSIZ);
+      ScopedRWLock lock(&db_->mlock_, false);
+      if (!prepare(false)) return false;
+      return finish(cur_->jump(kbuf, ksiz));
+    }
+    /**
+     * Jump the cursor to a record for forward scan.
+     * @note Equal to the original Cursor::jump method except that the parameter is std::string.
+     */
+    bool jump(const std::string& key) {
+      _assert_(true);
+      return jump(key.c_str(), key.size());
+    }
+    /**
+     * Jump the cursor to the last record for backward scan.
+     * @return true on success, or false on failure.
+     */
+    bool jump_back() {
+      _assert_(true);
+      ScopedRWLock lock(&db_->mlock_, false);
+      if (!prepare(false)) return false;
+      return finish(cur_->jump_back());
+    }
+    /**
+     * Jump the cursor to a record for backward scan.
+     * @param kbuf the pointer to the key region.
+     * @param ksiz the size of the key region.
+     * @return true on success, or false on failure.
+     */
+    bool jump_back(const char* kbuf, size_t ksiz) {
+      _assert_(kbuf && ksiz <= MEMMAXSIZ);
+      ScopedRWLock lock(&db_->mlock_, false);
+      if (!prepare(false)) return false;
+      return finish(cur_->jump_back(kbuf, ksiz));
+    }
+    /**
+     * Jump the cursor to a record for backward scan.
+     * @note Equal to the original Cursor::jump_back method except that the parameter is
+     * std::string.
+     */
+    bool jump_back(const std::string& key) {
+      _assert_(true);
+      return jump_back(key.c_str(), key.size());
+    }
+    /**
+     * Step the cursor to the next record.
+     * @return true on success, or false on failure.
+     */
+    bool step() {
+      _assert_(true);
+      ScopedRWLock lock(&db_->mlock_, false);
+      if (!prepare(false)) return false;
+      return finish(cur_->step());
+    }
+    /**
+     * Step the cursor to the previous record.
+     * @return true on success, or false on failure.
+     */
+    bool step_back() {
+      _assert_(true);
+      ScopedRWLock lock(&db_->mlock_, false);
+      if (!prepare(false)) return false;
+      return finish(cur_->step_back());
+    }
+    /**
+     * Get the database object.
+     * @return the database object.
+     */
+    TieredDB* db() {
+      _assert_(true);
+      return db_;
+    }
+   private:
+    /**
+     * Check the state of the database and write the buffered updates.
+     * @param writable true for writable operation, or false for read-only operation.
+     * @return true on success, or false on failure.
+     */
+    bool prepare(bool writable) {
+      _assert_(true);
+      if (db_->omode_ == 0) {
+        db_->set_error(_KCCODELINE_, Error::INVALID, "not opened");
+        return false;
+      }
+      if (writable && !db_->writer_) {
+        db_->set_error(_KCCODELINE_, Error::NOPERM, "permission denied");
+        return false;
+      }
+      return db_->dcount_.get() < 1 || db_->flush_slots();
+    }
+    /**
+     * Propagate the error of the inner cursor.
+     * @param rv the result of the operation of the inner cursor.
+     * @return the given result.
+     */
+    bool finish(bool rv) {
+      _assert_(true);
+      if (!rv) {
+        const Error& e = cur_->error();
+        db_->set_error(_KCCODELINE_, e.code(), e.message());
+      }
+      return rv;
+    }
+    /** Dummy constructor to forbid the use. */
+    Cursor(const Cursor&);
+    /** Dummy Operator to forbid the use. */
+    Cursor& operator =(const Cursor&);
+    /** The inner database. */
+    TieredDB* db_;
+    /** The cursor of the backend database. */
+    BasicDB::Cursor* cur_;
+  };
+  /**
+   * Writing modes.
+   */
+  enum WriteMode {
+    WTHROUGH,                            ///< write each update into the backend immediately
+    WBACK                                ///< buffer updates and write them in the background
+  };
+  /**
+   * Constructor.
+   * @param db the backend database object.  Its possession is not transferred.
+   */
+  explicit TieredDB(BasicDB* db) :
+      mlock_(), flmutex_(), flcond_(), error_(), logger_(NULL), logkinds_(0), mtrigger_(NULL),
+      db_(db), cache_(), omode_(0), writer_(false), wmode_(WTHROUGH),
+      capsiz_(DEFCAPSIZ), wbcap_(DEFWBCAP), flintv_(1.0), tran_(false),
+      flusher_(NULL), flstop_(false), dcount_(0), hitcnt_(0), misscnt_(0), flushcnt_(0) {
+    _assert_(db);
+  }
+  /**
+   * Destructor.
+   * @note If the database is not closed, it is closed implicitly.
+   */
+  virtual ~TieredDB() {
+    _assert_(true);
+    if (omode_ != 0) close();
+  }
+  /**
+   * Accept a visitor to a record.
+   * @param kbuf the pointer to the key region.
+   * @param ksiz the size of the key region.
+   * @param visitor a visitor object.
+   * @param writable true for writable operation, or false for read-only operation.
+   * @return true on success, or false on failure.
+   * @note The operation for each record is performed atomically and other threads accessing the
+   * same record are blocked.  To avoid deadlock, any explicit database operation must not be
+   * performed in this function.
+   */
+  bool accept(const char* kbuf, size_t ksiz, Visitor* visitor, bool writable = true) {
+    _assert_(kbuf && ksiz <= MEMMAXSIZ && visitor);
+    ScopedRWLock lock(&mlock_, false);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
+    }
+    if (writable && !writer_) {
+      set_error(_KCCODELINE_, Error::NOPERM, "permission denied");
+      return false;
+    }
+    Slot* slot = slots_ + hashmurmur(kbuf, ksiz) % SLOTNUM;
+    ScopedMutex slock(&slot->lock);
+    return accept_impl(slot, kbuf, ksiz, visitor, writable);
+  }
+  /**
+   * Accept a visitor to multiple records at once.
+   * @param keys specifies a string vector of the keys.
+   * @param visitor a visitor object.
+   * @param writable true for writable operation, or false for read-only operation.
+   * @return true on success, or false on failure.
+   * @note The operations for specified records are performed atomically and other threads
+   * accessing the same records are blocked.  To avoid deadlock, any explicit database operation
+   * must not be performed in this function.
+   */
+  bool accept_bulk(const std::vector<std::string>& keys, Visitor* visitor,
+                   bool writable = true) {
+    _assert_(visitor);
+    ScopedRWLock lock(&mlock_, false);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
+    }
+    if (writable && !writer_) {
+      set_error(_KCCODELINE_, Error::NOPERM, "permission denied");
+      return false;
+    }
+    std::set<int32_t> sidxs;
+    std::vector<std::string>::const_iterator kit = keys.begin();
+    std::vector<std::string>::const_iterator kitend = keys.end();
+    while (kit != kitend) {
+      sidxs.insert(hashmurmur(kit->data(), kit->size()) % SLOTNUM);
+      ++kit;
+    }
+    std::set<int32_t>::iterator sit = sidxs.begin();
+    std::set<int32_t>::iterator sitend = sidxs.end();
+    while (sit != sitend) {
+      slots_[*sit].lock.lock();
+      ++sit;
+    }
+    bool err = false;
+    {
+      ScopedVisitor svis(visitor);
+      kit = keys.begin();
+      while (kit != kitend) {
+        Slot* slot = slots_ + hashmurmur(kit->data(), kit->size()) % SLOTNUM;
+        if (!accept_impl(slot, kit->data(), kit->size(), visitor, writable)) {
+          err = true;
+          break;
+        }
+        ++kit;
+      }
+    }
+    sit = sidxs.begin();
+    while (sit != sitend) {
+      slots_[*sit].lock.unlock();
+      ++sit;
+    }
+    return !err;
+  }
+  /**
+   * Iterate to accept a visitor for each record.
+   * @param visitor a visitor object.
+   * @param writable true for writable operation, or false for read-only operation.
+   * @param checker a progress checker object.  If it is NULL, no checking is performed.
+   * @return true on success, or false on failure.
+   * @note The whole iteration is performed atomically and other threads are blocked.  To avoid
+   * deadlock, any explicit database operation must not be performed in this function.
+   */
+  bool iterate(Visitor *visitor, bool writable = true, ProgressChecker* checker = NULL) {
+    _assert_(visitor);
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
+    }
+    if (writable && !writer_) {
+      set_error(_KCCODELINE_, Error::NOPERM, "permission denied");
+      return false;
+    }
+    if (!flush_slots()) return false;
+    bool err = false;
+    if (writable) {
+      InvalidateVisitor ivis(this, visitor);
+      if (!db_->iterate(&ivis, true, checker)) err = true;
+    } else {
+      if (!db_->iterate(visitor, false, checker)) err = true;
+    }
+    if (err) copy_error();
+    trigger_meta(MetaTrigger::ITERATE, "iterate");
+    return !err;
+  }
+  /**
+   * Get the last happened error.
+   * @return the last happened error.
+   */
+  Error error() const {
+    _assert_(true);
+    return error_;
+  }
+  /**
+   * Set the error information.
+   * @param file the file name of the program source code.
+   * @param line the line number of the program source code.
+   * @param func the function name of the program source code.
+   * @param code an error code.
+   * @param message a supplement message.
+   */
+  void set_error(const char* file, int32_t line, const char* func,
+                 Error::Code code, const char* message) {
+    _assert_(file && line > 0 && func && message);
+    error_->set(code, message);
+    if (logger_) {
+      Logger::Kind kind = code == Error::BROKEN || code == Error::SYSTEM ?
+          Logger::ERROR : Logger::INFO;
+      if (kind & logkinds_)
+        report(file, line, func, kind, "%d: %s: %s", code, Error::codename(code), message);
+    }
+  }
+  /**
+   * Open a database file.
+   * @param path the path of a database file of the backend database.
+   * @param mode the connection mode, which is passed to the backend database.
+   * @return true on success, or false on failure.
+   * @note Every opened database must be closed by the TieredDB::close method when it is no
+   * longer in use.
+   */
+  bool open(const std::string& path, uint32_t mode = OWRITER | OCREATE) {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ != 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "already opened");
+      return false;
+    }
+    report(_KCCODELINE_, Logger::DEBUG, "opening the database (path=%s)", path.c_str());
+    if (!db_->open(path, mode)) {
+      copy_error();
+      return false;
+    }
+    cache_.cap_size(capsiz_);
+    if (!cache_.open("*", OWRITER | OCREATE)) {
+      const Error& e = cache_.error();
+      set_error(_KCCODELINE_, e.code(), e.message());
+      db_->close();
+      return false;
+    }
+    omode_ = mode;
+    writer_ = (mode & OWRITER) != 0;
+    tran_ = false;
+    dcount_.set(0);
+    hitcnt_.set(0);
+    misscnt_.set(0);
+    flushcnt_.set(0);
+    if (writer_ && wmode_ == WBACK) {
+      flstop_ = false;
+      flusher_ = new Flusher(this);
+      flusher_->start();
+    }
+    trigger_meta(MetaTrigger::OPEN, "open");
+    return true;
+  }
+  /**
+   * Close the database file.
+   * @return true on success, or false on failure.
+   * @note The buffered updates are written into the backend database before closing.
+   */
+  bool close() {
+    _assert_(true);
+    stop_flusher();
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
+    }
+    report(_KCCODELINE_, Logger::DEBUG, "closing the database (path=%s)", db_->path().c_str());
+    bool err = false;
+    if (!flush_slots()) err = true;
+    tran_ = false;
+    for (int32_t i = 0; i < SLOTNUM; i++) {
+      slots_[i].trkeys.clear();
+    }
+    if (!cache_.close()) {
+      const Error& e = cache_.error();
+      set_error(_KCCODELINE_, e.code(), e.message());
+      err = true;
+    }
+    if (!db_->close()) {
+      copy_error();
+      err = true;
+    }
+    omode_ = 0;
+    trigger_meta(MetaTrigger::CLOSE, "close");
+    return !err;
+  }
+  /**
+   * Synchronize updated contents with the file and the device.
+   * @param hard true for physical synchronization with the device, or false for logical
+   * synchronization with the file system.
+   * @param proc a postprocessor object.  If it is NULL, no postprocessing is performed.
+   * @param checker a progress checker object.  If it is NULL, no checking is performed.
+   * @return true on success, or false on failure.
+   * @note The buffered updates are written into the backend database before synchronization.
+   */
+  bool synchronize(bool hard = false, FileProcessor* proc = NULL,
+                   ProgressChecker* checker = NULL) {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, false);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
+    }
+    bool err = false;
+    if (writer_ && !flush_slots()) err = true;
+    if (!db_->synchronize(hard, proc, checker)) {
+      copy_error();
+      err = true;
+    }
+    trigger_meta(MetaTrigger::SYNCHRONIZE, "synchronize");
+    return !err;
+  }
+  /**
+   * Occupy database by locking and do something meanwhile.
+   * @param writable true to use writer lock, or false to use reader lock.
+   * @param proc a processor object.  If it is NULL, no processing is performed.
+   * @return true on success, or false on failure.
+   * @note The operation of the processor is performed atomically and other threads accessing
+   * the same record are blocked.  To avoid deadlock, any explicit database operation must not
+   * be performed in this function.
+   */
+  bool occupy(bool writable = true, FileProcessor* proc = NULL) {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, writable);
+    bool err = false;
+    if (omode_ != 0 && writer_ && !flush_slots()) err = true;
+    if (!db_->occupy(writable, proc)) {
+      copy_error();
+      err = true;
+    }
+    trigger_meta(MetaTrigger::OCCUPY, "occupy");
+    return !err;
+  }
+  /**
+   * Begin transaction.
+   * @param hard true for physical synchronization with the device, or false for logical
+   * synchronization with the file system.
+   * @return true on success, or false on failure.
+   * @note The buffered updates are written into the backend database before the transaction
+   * and every update in the transaction is written through.
+   */
+  bool begin_transaction(bool hard = false) {
+    _assert_(true);
+    uint32_t wcnt = 0;
+    while (true) {
+      mlock_.lock_writer();
+      if (omode_ == 0) {
+        set_error(_KCCODELINE_, Error::INVALID, "not opened");
+        mlock_.unlock();
+        return false;
+      }
+      if (!writer_) {
+        set_error(_KCCODELINE_, Error::NOPERM, "permission denied");
+        mlock_.unlock();
+        return false;
+      }
+      if (!tran_) break;
+      mlock_.unlock();
+      if (wcnt >= LOCKBUSYLOOP) {
+        Thread::chill();
+      } else {
+        Thread::yield();
+        wcnt++;
+      }
+    }
+    if (!begin_transaction_impl(hard)) {
+      mlock_.unlock();
+      return false;
+    }
+    tran_ = true;
+    trigger_meta(MetaTrigger::BEGINTRAN, "begin_transaction");
+    mlock_.unlock();
+    return true;
+  }
+  /**
+   * Try to begin transaction.
+   * @param hard true for physical synchronization with the device, or false for logical
+   * synchronization with the file system.
+   * @return true on success, or false on failure.
+   */
+  bool begin_transaction_try(bool hard = false) {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
+    }
+    if (!writer_) {
+      set_error(_KCCODELINE_, Error::NOPERM, "permission denied");
+      return false;
+    }
+    if (tran_) {
+      set_error(_KCCODELINE_, Error::LOGIC, "competition avoided");
+      return false;
+    }
+    if (!begin_transaction_impl(hard)) return false;
+    tran_ = true;
+    trigger_meta(MetaTrigger::BEGINTRAN, "begin_transaction_try");
+    return true;
+  }
+  /**
+   * End transaction.
+   * @param commit true to commit the transaction, or false to abort the transaction.
+   * @return true on success, or false on failure.
+   * @note When the transaction is aborted, the cached records updated in the transaction are
+   * discarded.
+   */
+  bool end_transaction(bool commit = true) {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
+    }
+    if (!tran_) {
+      set_error(_KCCODELINE_, Error::INVALID, "not in transaction");
+      return false;
+    }
+    bool err = false;
+    if (!db_->end_transaction(commit)) {
+      copy_error();
+      err = true;
+    }
+    for (int32_t i = 0; i < SLOTNUM; i++) {
+      Slot* slot = slots_ + i;
+      if (!commit || err) {
+        KeySet::iterator it = slot->trkeys.begin();
+        KeySet::iterator itend = slot->trkeys.end();
+        while (it != itend) {
+          cache_.remove(*it);
+          ++it;
+        }
+      }
+      slot->trkeys.clear();
+    }
+    tran_ = false;
+    trigger_meta(commit ? MetaTrigger::COMMITTRAN : MetaTrigger::ABORTTRAN, "end_transaction");
+    return !err;
+  }
+  /**
+   * Remove all records.
+   * @return true on success, or false on failure.
+   */
+  bool clear() {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
+    }
+    if (!writer_) {
+      set_error(_KCCODELINE_, Error::NOPERM, "permission denied");
+      return false;
+    }
+    for (int32_t i = 0; i < SLOTNUM; i++) {
+      Slot* slot = slots_ + i;
+      slot->recs.clear();
+      slot->size = 0;
+      slot->dtime = 0;
+    }
+    dcount_.set(0);
+    bool err = false;
+    if (!db_->clear()) {
+      copy_error();
+      err = true;
+    }
+    cache_.clear();
+    trigger_meta(MetaTrigger::CLEAR, "clear");
+    return !err;
+  }
+  /**
+   * Get the number of records.
+   * @return the number of records, or -1 on failure.
+   * @note The buffered updates are written into the backend database before counting.
+   */
+  int64_t count() {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, false);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return -1;
+    }
+    if (dcount_.get() > 0 && !flush_slots()) return -1;
+    int64_t count = db_->count();
+    if (count < 0) copy_error();
+    return count;
+  }
+  /**
+   * Get the size of the database file.
+   * @return the size of the database file of the backend database in bytes, or -1 on failure.
+   */
+  int64_t size() {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, false);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return -1;
+    }
+    int64_t size = db_->size();
+    if (size < 0) copy_error();
+    return size;
+  }
+  /**
+   * Get the path of the database file.
+   * @return the path of the database file of the backend database, or an empty string on
+   * failure.
+   */
+  std::string path() {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, false);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return "";
+    }
+    return db_->path();
+  }
+  /**
+   * Get the miscellaneous status information.
+   * @param strmap a string map to contain the result.
+   * @return true on success, or false on failure.
+   * @note The status of the backend database is stored with the additional records of
+   * "tier_mode", "tier_capsiz", "tier_hit", "tier_miss", "tier_hitratio", "tier_ccount",
+   * "tier_csize", "tier_dcount", "tier_dsize", "tier_lag", and "tier_flushcnt".
+   */
+  bool status(std::map<std::string, std::string>* strmap) {
+    _assert_(strmap);
+    ScopedRWLock lock(&mlock_, false);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
+    }
+    if (!db_->status(strmap)) {
+      copy_error();
+      return false;
+    }
+    int64_t dsize = 0;
+    double dtime = 0;
+    for (int32_t i = 0; i < SLOTNUM; i++) {
+      Slot* slot = slots_ + i;
+      ScopedMutex slock(&slot->lock);
+      dsize += slot->size;
+      if (!slot->recs.empty() && (dtime <= 0 || slot->dtime < dtime)) dtime = slot->dtime;
+    }
+    int64_t hitcnt = hitcnt_.get();
+    int64_t misscnt = misscnt_.get();
+    int64_t allcnt = hitcnt + misscnt;
+    (*strmap)["tier_mode"] = wmode_ == WBACK ? "back" : "through";
+    (*strmap)["tier_capsiz"] = strprintf("%lld", (long long)capsiz_);
+    (*strmap)["tier_hit"] = strprintf("%lld", (long long)hitcnt);
+    (*strmap)["tier_miss"] = strprintf("%lld", (long long)misscnt);
+    (*strmap)["tier_hitratio"] = strprintf("%.6f", allcnt > 0 ? (double)hitcnt / allcnt : 0.0);
+    (*strmap)["tier_ccount"] = strprintf("%lld", (long long)cache_.count());
+    (*strmap)["tier_csize"] = strprintf("%lld", (long long)cache_.size());
+    (*strmap)["tier_dcount"] = strprintf("%lld", (long long)dcount_.get());
+    (*strmap)["tier_dsize"] = strprintf("%lld", (long long)dsize);
+    (*strmap)["tier_lag"] = strprintf("%.6f", dtime > 0 ? time() - dtime : 0.0);
+    (*strmap)["tier_flushcnt"] = strprintf("%lld", (long long)flushcnt_.get());
+    return true;
+  }
+  /**
+   * Create a cursor object.
+   * @return the return value is the created cursor object.
+   * @note Because the object of the return value is allocated by the constructor, it should be
+   * released with the delete operator when it is no longer in use.
+   */
+  Cursor* cursor() {
+    _assert_(true);
+    return new Cursor(this);
+  }
+  /**
+   * Set the internal logger.
+   * @param logger the logger object.
+   * @param kinds kinds of logged messages by bitwise-or: Logger::DEBUG for debugging,
+   * Logger::INFO for normal information, Logger::WARN for warning, and Logger::ERROR for fatal
+   * error.
+   * @return true on success, or false on failure.
+   */
+  bool tune_logger(Logger* logger, uint32_t kinds = Logger::WARN | Logger::ERROR) {
+    _assert_(logger);
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ != 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "already opened");
+      return false;
+    }
+    logger_ = logger;
+    logkinds_ = kinds;
+    return true;
+  }
+  /**
+   * Set the internal meta operation trigger.
+   * @param trigger the trigger object.
+   * @return true on success, or false on failure.
+   */
+  bool tune_meta_trigger(MetaTrigger* trigger) {
+    _assert_(trigger);
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ != 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "already opened");
+      return false;
+    }
+    mtrigger_ = trigger;
+    return true;
+  }
+  /**
+   * Set the writing mode.
+   * @param wmode the writing mode: TieredDB::WTHROUGH to write each update into the backend
+   * database immediately, or TieredDB::WBACK to buffer updates and write them by a background
+   * thread.
+   * @return true on success, or false on failure.
+   */
+  bool tune_write_mode(WriteMode wmode) {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ != 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "already opened");
+      return false;
+    }
+    wmode_ = wmode;
+    return true;
+  }
+  /**
+   * Set the capacity size of the cache.
+   * @param capsiz the capacity size of the cache in bytes.  When the total size of the cached
+   * records exceeds it, the least recently used records are discarded.
+   * @return true on success, or false on failure.
+   */
+  bool tune_cache(int64_t capsiz) {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ != 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "already opened");
+      return false;
+    }
+    capsiz_ = capsiz > 0 ? capsiz : DEFCAPSIZ;
+    return true;
+  }
+  /**
+   * Set the parameters of the write-back mode.
+   * @param wbcap the capacity size of the buffered updates.  When the size of the buffered
+   * updates of a slot exceeds its share, they are written by the updating thread.  If it is
+   * not more than 0, the default setting is specified.
+   * @param interval the interval in seconds of the background writing.  If it is not more
+   * than 0, the default setting is specified.
+   * @return true on success, or false on failure.
+   */
+  bool tune_write_back(int64_t wbcap, double interval) {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ != 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "already opened");
+      return false;
+    }
+    wbcap_ = wbcap > 0 ? wbcap : DEFWBCAP;
+    flintv_ = interval > 0 ? interval : 1.0;
+    return true;
+  }
+  /**
+   * Write the buffered updates into the backend database.
+   * @return true on success, or false on failure.
+   */
+  bool flush() {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, false);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
+    }
+    if (!writer_) {
+      set_error(_KCCODELINE_, Error::NOPERM, "permission denied");
+      return false;
+    }
+    return flush_slots();
+  }
+  /**
+   * Reveal the backend database object.
+   * @return the backend database object.
+   */
+  BasicDB* reveal_inner_db() {
+    _assert_(true);
+    return db_;
+  }
+ protected:
+  /**
+   * Report a message for debugging.
+   * @param file the file name of the program source code.
+   * @param line the line number of the program source code.
+   * @param func the function name of the program source code.
+   * @param kind the kind of the event.  Logger::DEBUG for debugging, Logger::INFO for normal
+   * information, Logger::WARN for warning, and Logger::ERROR for fatal error.
+   * @param format the printf-like format string.
+   * @param ... used according to the format string.
+   */
+  void report(const char* file, int32_t line, const char* func, Logger::Kind kind,
+              const char* format, ...) {
+    _assert_(file && line > 0 && func && format);
+    if (!logger_ || !(kind & logkinds_)) return;
+    std::string message = "tier: ";
+    va_list ap;
+    va_start(ap, format);
+    vstrprintf(&message, format, ap);
+    va_end(ap);
+    logger_->log(file, line, func, kind, message.c_str());
+  }
+  /**
+   * Trigger a meta database operation.
+   * @param kind the kind of the event.  MetaTrigger::OPEN for opening, MetaTrigger::CLOSE for
+   * closing, MetaTrigger::CLEAR for clearing, MetaTrigger::ITERATE for iteration,
+   * MetaTrigger::SYNCHRONIZE for synchronization, MetaTrigger::BEGINTRAN for beginning
+   * transaction, MetaTrigger::COMMITTRAN for committing transaction, MetaTrigger::ABORTTRAN
+   * for aborting transaction, and MetaTrigger::MISC for miscellaneous operations.
+   * @param message the supplement message.
+   */
+  void trigger_meta(MetaTrigger::Kind kind, const char* message) {
+    _assert_(message);
+    if (mtrigger_) mtrigger_->trigger(kind, message);
+  }
+ private:
+  /**
+   * Updated record not written yet.
+   */
+  struct DirtyRecord {
+    bool rem;                            ///< whether to be removed
+    std::string value;                   ///< new value
+  };
+  /**
+   * Slot of the record lock and the buffered updates.
+   */
+  struct Slot {
+    Mutex lock;                          ///< lock
+    DirtyMap recs;                       ///< buffered updates
+    int64_t size;                        ///< total size of the buffered updates
+    double dtime;                        ///< time of the oldest buffered update
+    KeySet trkeys;                       ///< keys updated in transaction
+    /** constructor */
+    explicit Slot() : lock(), recs(), size(0), dtime(0), trkeys() {}
+  };
+  /**
+   * Scoped visitor.
+   */
+  class ScopedVisitor {
+   public:
+    /** constructor */
+    explicit ScopedVisitor(Visitor* visitor) : visitor_(visitor) {
+      _assert_(visitor);
+      visitor_->visit_before();
+    }
+    /** destructor */
+    ~ScopedVisitor() {
+      _assert_(true);
+      visitor_->visit_after();
+    }
+   private:
+    Visitor* visitor_;                   ///< visitor
+  };
+  /**
+   * Visitor wrapper to discard the cached records updated in the backend database.
+   */
+  class InvalidateVisitor : public Visitor {
+   public:
+    /** constructor */
+    explicit InvalidateVisitor(TieredDB* db, Visitor* visitor) : db_(db), visitor_(visitor) {}
+   private:
+    /** visit a record */
+    const char* visit_full(const char* kbuf, size_t ksiz,
+                           const char* vbuf, size_t vsiz, size_t* sp) {
+      const char* rv = visitor_->visit_full(kbuf, ksiz, vbuf, vsiz, sp);
+      if (rv != NOP) db_->invalidate(kbuf, ksiz);
+      return rv;
+    }
+    /** visit a empty record */
+    const char* visit_empty(const char* kbuf, size_t ksiz, size_t* sp) {
+      const char* rv = visitor_->visit_empty(kbuf, ksiz, sp);
+      if (rv != NOP && rv != REMOVE) db_->invalidate(kbuf, ksiz);
+      return rv;
+    }
+    /** preprocess the main operations */
+    void visit_before() {
+      visitor_->visit_before();
+    }
+    /** postprocess the main operations */
+    void visit_after() {
+      visitor_->visit_after();
+    }
+    TieredDB* db_;                       ///< database
+    Visitor* visitor_;                   ///< inner visitor
+  };
+  /**
+   * Background thread to write the buffered updates.
+   */
+  class Flusher : public Thread {
+   public:
+    /** constructor */
+    explicit Flusher(TieredDB* db) : db_(db) {}
+    /** perform the concrete process */
+    void run() {
+      _assert_(true);
+      db_->flush_loop();
+    }
+   private:
+    TieredDB* db_;                       ///< database
+  };
+  /**
+   * Accept a visitor to a record in a locked slot.
+   * @param slot the slot of the record.
+   * @param kbuf the pointer to the key region.
+   * @param ksiz the size of the key region.
+   * @param visitor a visitor object.
+   * @param writable true for writable operation, or false for read-only operation.
+   * @return true on success, or false on failure.
+   */
+  bool accept_impl(Slot* slot, const char* kbuf, size_t ksiz, Visitor* visitor,
+                   bool writable) {
+    _assert_(slot && kbuf && ksiz <= MEMMAXSIZ && visitor);
+    std::string key(kbuf, ksiz);
+    std::string value;
+    bool hit;
+    if (!find_record(slot, key, &value, &hit)) return false;
+    size_t rsiz;
+    const char* rbuf = hit ?
+        visitor->visit_full(kbuf, ksiz, value.data(), value.size(), &rsiz) :
+        visitor->visit_empty(kbuf, ksiz, &rsiz);
+    if (!writable || rbuf == Visitor::NOP) return true;
+    if (rbuf == Visitor::REMOVE) return !hit || write_record(slot, key, NULL, 0);
+    return write_record(slot, key, rbuf, rsiz);
+  }
+  /**
+   * Find a record in the buffered updates, the cache, or the backend database.
+   * @param slot the slot of the record.
+   * @param key the key of the record.
+   * @param value the string to contain the value.
+   * @param hitp the pointer to the variable to indicate whether the record exists.
+   * @return true on success, or false on failure.
+   */
+  bool find_record(Slot* slot, const std::string& key, std::string* value, bool* hitp) {
+    _assert_(slot && value && hitp);
+    DirtyMap::iterator it = slot->recs.find(key);
+    if (it != slot->recs.end()) {
+      hitcnt_ += 1;
+      *hitp = !it->second.rem;
+      if (*hitp) value->assign(it->second.value);
+      return true;
+    }
+    size_t vsiz;
+    char* vbuf = cache_.get(key.data(), key.size(), &vsiz);
+    if (vbuf) {
+      hitcnt_ += 1;
+      value->assign(vbuf, vsiz);
+      delete[] vbuf;
+      *hitp = true;
+      return true;
+    }
+    misscnt_ += 1;
+    vbuf = db_->get(key.data(), key.size(), &vsiz);
+    if (!vbuf) {
+      if (db_->error() == Error::NOREC) {
+        *hitp = false;
+        return true;
+      }
+      copy_error();
+      return false;
+    }
+    value->assign(vbuf, vsiz);
+    delete[] vbuf;
+    cache_.set(key, *value);
+    *hitp = true;
+    return true;
+  }
+  /**
+   * Apply an update to a record.
+   * @param slot the slot of the record.
+   * @param key the key of the record.
+   * @param vbuf the pointer to the value region, or NULL to remove the record.
+   * @param vsiz the size of the value region.
+   * @return true on success, or false on failure.
+   */
+  bool write_record(Slot* slot, const std::string& key, const char* vbuf, size_t vsiz) {
+    _assert_(slot && vsiz <= MEMMAXSIZ);
+    if (wmode_ == WBACK && !tran_) {
+      DirtyMap::iterator it = slot->recs.find(key);
+      if (it == slot->recs.end()) {
+        if (slot->recs.empty()) slot->dtime = time();
+        it = slot->recs.insert(std::make_pair(key, DirtyRecord())).first;
+        slot->size += key.size();
+        dcount_ += 1;
+      } else {
+        slot->size -= it->second.value.size();
+      }
+      DirtyRecord& rec = it->second;
+      if (vbuf) {
+        rec.rem = false;
+        rec.value.assign(vbuf, vsiz);
+        cache_.set(key.data(), key.size(), vbuf, vsiz);
+      } else {
+        rec.rem = true;
+        rec.value.clear();
+        cache_.remove(key);
+      }
+      slot->size += rec.value.size();
+      if (slot->size > wbcap_ / SLOTNUM) return flush_slot(slot);
+      return true;
+    }
+    bool ok = vbuf ? db_->set(key.data(), key.size(), vbuf, vsiz) : db_->remove(key);
+    if (tran_) slot->trkeys.insert(key);
+    if (!ok) {
+      copy_error();
+      cache_.remove(key);
+      return false;
+    }
+    if (vbuf) {
+      cache_.set(key.data(), key.size(), vbuf, vsiz);
+    } else {
+      cache_.remove(key);
+    }
+    return true;
+  }
+  /**
+   * Write the buffered updates of a locked slot into the backend database.
+   * @param slot the slot.
+   * @return true on success, or false on failure.
+   * @note Updates which failed to be written are kept in the slot.
+   */
+  bool flush_slot(Slot* slot) {
+    _assert_(slot);
+    if (slot->recs.empty()) return true;
+    std::map<std::string, std::string> sets;
+    std::vector<std::string> rems;
+    DirtyMap::iterator it = slot->recs.begin();
+    DirtyMap::iterator itend = slot->recs.end();
+    while (it != itend) {
+      if (it->second.rem) {
+        rems.push_back(it->first);
+      } else {
+        sets[it->first] = it->second.value;
+      }
+      ++it;
+    }
+    bool err = false;
+    if (!sets.empty() && db_->set_bulk(sets, false) < 0) err = true;
+    if (!err && !rems.empty() && db_->remove_bulk(rems, false) < 0) err = true;
+    if (err) {
+      copy_error();
+      return false;
+    }
+    flushcnt_ += slot->recs.size();
+    dcount_ -= slot->recs.size();
+    slot->recs.clear();
+    slot->size = 0;
+    slot->dtime = 0;
+    return true;
+  }
+  /**
+   * Write the buffered updates of all slots into the backend database.
+   * @return true on success, or false on failure.
+   */
+  bool flush_slots() {
+    _assert_(true);
+    bool err = false;
+    for (int32_t i = 0; i < SLOTNUM; i++) {
+      Slot* slot = slots_ + i;
+      ScopedMutex slock(&slot->lock);
+      if (!flush_slot(slot)) err = true;
+    }
+    return !err;
+  }
+  /**
+   * Discard a cached record updated in the backend database.
+   * @param kbuf the pointer to the key region.
+   * @param ksiz the size of the key region.
+   * @note The caller must hold the writer lock.
+   */
+  void invalidate(const char* kbuf, size_t ksiz) {
+    _assert_(kbuf && ksiz <= MEMMAXSIZ);
+    cache_.remove(kbuf, ksiz);
+    if (tran_) slots_[hashmurmur(kbuf, ksiz) % SLOTNUM].trkeys.insert(std::string(kbuf, ksiz));
+  }
+  /**
+   * Begin transaction.
+   * @param hard true for physical synchronization with the device, or false for logical
+   * synchronization with the file system.
+   * @return true on success, or false on failure.
+   */
+  bool begin_transaction_impl(bool hard) {
+    _assert_(true);
+    if (!flush_slots()) return false;
+    if (!db_->begin_transaction(hard)) {
+      copy_error();
+      return false;
+    }
+    return true;
+  }
+  /**
+   * Copy the last happened error of the backend database.
+   */
+  void copy_error() {
+    _assert_(true);
+    const Error& e = db_->error();
+    set_error(_KCCODELINE_, e.code(), e.message());
+  }
+  /**
+   * Perform the loop of the background thread.
+   */
+  void flush_loop() {
+    _assert_(true);
+    flmutex_.lock();
+    while (!flstop_) {
+      flcond_.wait(&flmutex_, flintv_);
+      if (flstop_) break;
+      flmutex_.unlock();
+      mlock_.lock_reader();
+      if (omode_ != 0 && dcount_.get() > 0 && !flush_slots()) {
+        const Error& e = error();
+        report(_KCCODELINE_, Logger::ERROR, "writing back failed: %s: %s",
+               e.name(), e.message());
+      }
+      mlock_.unlock();
+      flmutex_.lock();
+    }
+    flmutex_.unlock();
+  }
+  /**
+   * Stop the background thread.
+   */
+  void stop_flusher() {
+    _assert_(true);
+    if (!flusher_) return;
+    flmutex_.lock();
+    flstop_ = true;
+    flcond_.signal();
+    flmutex_.unlock();
+    flusher_->join();
+    delete flusher_;
+    flusher_ = NULL;
+  }
+  /** Dummy constructor to forbid the use. */
+  TieredDB(const TieredDB&);
+  /** Dummy Operator to forbid the use. */
+  TieredDB& operator =(const TieredDB&);
+  /** The method lock. */
+  RWLock mlock_;
+  /** The mutex for the background thread. */
+  Mutex flmutex_;
+  /** The condition variable for the background thread. */
+  CondVar flcond_;
+  /** The last happened error. */
+  TSD<Error> error_;
+  /** The internal logger. */
+  Logger* logger_;
+  /** The kinds of logged messages. */
+  uint32_t logkinds_;
+  /** The internal meta operation trigger. */
+  MetaTrigger* mtrigger_;
+  /** The backend database. */
+  BasicDB* db_;
+  /** The cache of records. */
+  CacheDB cache_;
+  /** The open mode. */
+  uint32_t omode_;
+  /** The flag for writer. */
+  bool writer_;
+  /** The writing mode. */
+  WriteMode wmode_;
+  /** The capacity size of the cache. */
+  int64_t capsiz_;
+  /** The capacity size of the buffered updates. */
+  int64_t wbcap_;
+  /** The interval of the background writing. */
+  double flintv_;
+  /** The flag whether in transaction. */
+  bool tran_;
+  /** The slots of the record lock. */
+  Slot slots_[SLOTNUM];
+  /** The background thread. */
+  Flusher* flusher_;
+  /** The flag whether the background thread is being stopped. */
+  bool flstop_;
+  /** The number of the buffered updates. */
+  AtomicInt64 dcount_;
+  /** The number of lookups found in the buffered updates or the cache. */
+  AtomicInt64 hitcnt_;
+  /** The number of lookups passed to the backend database. */
+  AtomicInt64 misscnt_;
+  /** The number of updates written back. */
+  AtomicInt64 flushcnt_;
+};
+
+
+}                                        // common namespace
+
+#endif                                   // duplication check
+
+// END OF FILE
@@ -41,6 +41,7 @@ static int32_t runsetbulk(int argc, char** argv);
 static int32_t runremovebulk(int argc, char** argv);
 static int32_t rungetbulk(int argc, char** argv);
 static int32_t runcheck(int argc, char** argv);
+static int32_t runanalyze(int argc, char** argv);
 static int32_t proccreate(const char* path, int32_t oflags, int32_t apow, int32_t fpow,
                           int32_t opts, int64_t bnum, int32_t psiz, kc::Comparator* rcomp);
 static int32_t procinform(const char* path, int32_t oflags, bool st);
@@ -52,10 +53,13 @@ static int32_t procget(const char* path, const char* kbuf, size_t ksiz,
 static int32_t proclist(const char* path, const char*kbuf, size_t ksiz, int32_t oflags,
                         bool des, int64_t max, bool pv, bool px);
 static int32_t procclear(const char* path, int32_t oflags);
-static int32_t procimport(const char* path, const char* file, int32_t oflags, bool sx);
+static int32_t procimport(const char* path, const char* file, int32_t oflags, bool sx,
+                          int32_t thnum, int64_t bulk);
 static int32_t proccopy(const char* path, const char* file, int32_t oflags);
-static int32_t procdump(const char* path, const char* file, int32_t oflags);
-static int32_t procload(const char* path, const char* file, int32_t oflags);
+static int32_t procdump(const char* path, const char* file, int32_t oflags,
+                        int32_t codec, int32_t thnum);
+static int32_t procload(const char* path, const char* file, int32_t oflags,
+                        int32_t thnum, const char* kbstr, const char* kestr);
 static int32_t procdefrag(const char* path, int32_t oflags);
 static int32_t procsetbulk(const char* path, int32_t oflags,
                            const std::map<std::string, std::string>& recs);
@@ -64,6 +68,7 @@ static int32_t procremovebulk(const char* path, int32_t oflags,
 static int32_t procgetbulk(const char* path, int32_t oflags,
                            const std::vector<std::string>& keys, bool px);
 static int32_t proccheck(const char* path, int32_t oflags);
+static int32_t procanalyze(const char* path, int32_t oflags, int64_t snum, bool apply);
 
 
 // main routine
@@ -104,6 +109,8 @@ int main(int argc, char** argv) {
     rv = rungetbulk(argc, argv);
   } else if (!std::strcmp(argv[1], "check")) {
     rv = runcheck(argc, argv);
+  } else if (!std::strcmp(argv[1], "analyze")) {
+    rv = runanalyze(argc, argv);
   } else if (!std::strcmp(argv[1], "version") || !std::strcmp(argv[1], "--version")) {
     printversion();
   } else {
@@ -129,15 +136,18 @@ static void usage() {
   eprintf("  %s list [-onl|-otl|-onr] [-des] [-max num] [-sx] [-pv] [-px] path [key]\n",
           g_progname);
   eprintf("  %s clear [-onl|-otl|-onr] path\n", g_progname);
-  eprintf("  %s import [-onl|-otl|-onr] [-sx] path [file]\n", g_progname);
+  eprintf("  %s import [-onl|-otl|-onr] [-sx] [-th num] [-bulk num] path [file]\n",
+          g_progname);
   eprintf("  %s copy [-onl|-otl|-onr] path file\n", g_progname);
-  eprintf("  %s dump [-onl|-otl|-onr] path [file]\n", g_progname);
-  eprintf("  %s load [-otr] [-onl|-otl|-onr] path [file]\n", g_progname);
+  eprintf("  %s dump [-onl|-otl|-onr] [-blk str] [-th num] path [file]\n", g_progname);
+  eprintf("  %s load [-otr] [-onl|-otl|-onr] [-th num] [-kb str] [-ke str] path [file]\n",
+          g_progname);
   eprintf("  %s defrag [-onl|-otl|-onr] path\n", g_progname);
   eprintf("  %s setbulk [-onl|-otl|-onr] [-sx] path key value ...\n", g_progname);
   eprintf("  %s removebulk [-onl|-otl|-onr] [-sx] path key ...\n", g_progname);
   eprintf("  %s getbulk [-onl|-otl|-onr] [-sx] [-px] path key ...\n", g_progname);
   eprintf("  %s check [-onl|-otl|-onr] path\n", g_progname);
+  eprintf("  %s analyze [-onl|-otl|-onr] [-snum num] [-apply] path\n", g_progname);
   eprintf("\n");
   std::exit(1);
 }
@@ -518,6 +528,8 @@ static int32_t runimport(int argc, char** argv) {
   const char* file = NULL;
   int32_t oflags = 0;
   bool sx = false;
+  int32_t thnum = 1;
+  int64_t bulk = IMPBULKNUM;
   for (int32_t i = 2; i < argc; i++) {
     if (!argbrk && argv[i][0] == '-') {
       if (!std::strcmp(argv[i], "--")) {
@@ -530,6 +542,12 @@ static int32_t runimport(int argc, char** argv) {
         oflags |= kc::TreeDB::ONOREPAIR;
       } else if (!std::strcmp(argv[i], "-sx")) {
         sx = true;
+      } else if (!std::strcmp(argv[i], "-th")) {
+        if (++i >= argc) usage();
+        thnum = kc::atoix(argv[i]);
+      } else if (!std::strcmp(argv[i], "-bulk")) {
+        if (++i >= argc) usage();
+        bulk = kc::atoix(argv[i]);
       } else {
         usage();
       }
@@ -542,8 +560,8 @@ static int32_t runimport(int argc, char** argv) {
       usage();
     }
   }
-  if (!path) usage();
-  int32_t rv = procimport(path, file, oflags, sx);
+  if (!path || thnum < 1 || bulk < 1) usage();
+  int32_t rv = procimport(path, file, oflags, sx, thnum, bulk);
   return rv;
 }
 
@@ -588,6 +606,8 @@ static int32_t rundump(int argc, char** argv) {
   const char* path = NULL;
   const char* file = NULL;
   int32_t oflags = 0;
+  int32_t codec = -1;
+  int32_t thnum = 1;
   for (int32_t i = 2; i < argc; i++) {
     if (!argbrk && argv[i][0] == '-') {
       if (!std::strcmp(argv[i], "--")) {
@@ -598,6 +618,21 @@ static int32_t rundump(int argc, char** argv) {
         oflags |= kc::TreeDB::OTRYLOCK;
       } else if (!std::strcmp(argv[i], "-onr")) {
         oflags |= kc::TreeDB::ONOREPAIR;
+      } else if (!std::strcmp(argv[i], "-blk")) {
+        if (++i >= argc) usage();
+        codec = kc::BasicDB::SBCZLIB;
+        if (!std::strcmp(argv[i], "none")) {
+          codec = kc::BasicDB::SBCNONE;
+        } else if (!std::strcmp(argv[i], "lzo")) {
+          codec = kc::BasicDB::SBCLZO;
+        } else if (!std::strcmp(argv[i], "lzma")) {
+          codec = kc::BasicDB::SBCLZMA;
+        } else if (std::strcmp(argv[i], "zlib")) {
+          usage();
+        }
+      } else if (!std::strcmp(argv[i], "-th")) {
+        if (++i >= argc) usage();
+        thnum = kc::atoix(argv[i]);
       } else {
         usage();
       }
@@ -610,8 +645,8 @@ static int32_t rundump(int argc, char** argv) {
       usage();
     }
   }
-  if (!path) usage();
-  int32_t rv = procdump(path, file, oflags);
+  if (!path || thnum < 1) usage();
+  int32_t rv = procdump(path, file, oflags, codec, thnum);
   return rv;
 }
 
@@ -622,6 +657,9 @@ static int32_t runload(int argc, char** argv) {
   const char* path = NULL;
   const char* file = NULL;
   int32_t oflags = 0;
+  int32_t thnum = 1;
+  const char* kbstr = NULL;
+  const char* kestr = NULL;
   for (int32_t i = 2; i < argc; i++) {
     if (!argbrk && argv[i][0] == '-') {
       if (!std::strcmp(argv[i], "--")) {
@@ -634,6 +672,15 @@ static int32_t runload(int argc, char** argv) {
         oflags |= kc::TreeDB::OTRYLOCK;
       } else if (!std::strcmp(argv[i], "-onr")) {
         oflags |= kc::TreeDB::ONOREPAIR;
+      } else if (!std::strcmp(argv[i], "-th")) {
+        if (++i >= argc) usage();
+        thnum = kc::atoix(argv[i]);
+      } else if (!std::strcmp(argv[i], "-kb")) {
+        if (++i >= argc) usage();
+        kbstr = argv[i];
+      } else if (!std::strcmp(argv[i], "-ke")) {
+        if (++i >= argc) usage();
+        kestr = argv[i];
       } else {
         usage();
       }
@@ -646,8 +693,8 @@ static int32_t runload(int argc, char** argv) {
       usage();
     }
   }
-  if (!path) usage();
-  int32_t rv = procload(path, file, oflags);
+  if (!path || thnum < 1 || ((kbstr || kestr) && !file)) usage();
+  int32_t rv = procload(path, file, oflags, thnum, kbstr, kestr);
   return rv;
 }
 
@@ -868,6 +915,44 @@ static int32_t runcheck(int argc, char** argv) {
 }
 
 
+// parse arguments of analyze command
+static int32_t runanalyze(int argc, char** argv) {
+  bool argbrk = false;
+  const char* path = NULL;
+  int32_t oflags = 0;
+  int64_t snum = 0;
+  bool apply = false;
+  for (int32_t i = 2; i < argc; i++) {
+    if (!argbrk && argv[i][0] == '-') {
+      if (!std::strcmp(argv[i], "--")) {
+        argbrk = true;
+      } else if (!std::strcmp(argv[i], "-onl")) {
+        oflags |= kc::TreeDB::ONOLOCK;
+      } else if (!std::strcmp(argv[i], "-otl")) {
+        oflags |= kc::TreeDB::OTRYLOCK;
+      } else if (!std::strcmp(argv[i], "-onr")) {
+        oflags |= kc::TreeDB::ONOREPAIR;
+      } else if (!std::strcmp(argv[i], "-snum")) {
+        if (++i >= argc) usage();
+        snum = kc::atoix(argv[i]);
+      } else if (!std::strcmp(argv[i], "-apply")) {
+        apply = true;
+      } else {
+        usage();
+      }
+    } else if (!path) {
+      argbrk = true;
+      path = argv[i];
+    } else {
+      usage();
+    }
+  }
+  if (!path) usage();
+  int32_t rv = procanalyze(path, oflags, snum, apply);
+  return rv;
+}
+
+
 // perform create command
 static int32_t proccreate(const char* path, int32_t oflags, int32_t apow, int32_t fpow,
                           int32_t opts, int64_t bnum, int32_t psiz, kc::Comparator* rcomp) {
@@ -1242,7 +1327,8 @@ static int32_t procclear(const char* path, int32_t oflags) {
 
 
 // perform import command
-static int32_t procimport(const char* path, const char* file, int32_t oflags, bool sx) {
+static int32_t procimport(const char* path, const char* file, int32_t oflags, bool sx,
+                          int32_t thnum, int64_t bulk) {
   std::istream *is = &std::cin;
   std::ifstream ifs;
   if (file) {
@@ -1260,44 +1346,11 @@ static int32_t procimport(const char* path, const char* file, int32_t oflags, bo
     return 1;
   }
   bool err = false;
-  int64_t cnt = 0;
-  std::string line;
-  std::vector<std::string> fields;
-  while (!err && mygetline(is, &line)) {
-    cnt++;
-    kc::strsplit(line, '\t', &fields);
-    if (sx) {
-      std::vector<std::string>::iterator it = fields.begin();
-      std::vector<std::string>::iterator itend = fields.end();
-      while (it != itend) {
-        size_t esiz;
-        char* ebuf = kc::hexdecode(it->c_str(), &esiz);
-        it->clear();
-        it->append(ebuf, esiz);
-        delete[] ebuf;
-        ++it;
-      }
-    }
-    switch (fields.size()) {
-      case 2: {
-        if (!db.set(fields[0], fields[1])) {
-          dberrprint(&db, "DB::set failed");
-          err = true;
-        }
-        break;
-      }
-      case 1: {
-        if (!db.remove(fields[0]) && db.error() != kc::BasicDB::Error::NOREC) {
-          dberrprint(&db, "DB::remove failed");
-          err = true;
-        }
-        break;
-      }
-    }
-    oputchar('.');
-    if (cnt % 50 == 0) oprintf(" (%lld)\n", (long long)cnt);
+  const char* fname = NULL;
+  if (!importtsv(&db, is, sx, thnum, bulk, &fname)) {
+    dberrprint(&db, fname);
+    err = true;
   }
-  if (cnt % 50 > 0) oprintf(" (%lld)\n", (long long)cnt);
   if (!db.close()) {
     dberrprint(&db, "DB::close failed");
     err = true;
@@ -1331,7 +1384,8 @@ static int32_t proccopy(const char* path, const char* file, int32_t oflags) {
 
 
 // perform dump command
-static int32_t procdump(const char* path, const char* file, int32_t oflags) {
+static int32_t procdump(const char* path, const char* file, int32_t oflags,
+                        int32_t codec, int32_t thnum) {
   kc::TreeDB db;
   db.tune_logger(stdlogger(g_progname, &std::cerr));
   if (!db.open(path, kc::TreeDB::OREADER | oflags)) {
@@ -1341,14 +1395,18 @@ static int32_t procdump(const char* path, const char* file, int32_t oflags) {
   bool err = false;
   if (file) {
     DotChecker checker(&std::cout, 1000);
-    if (!db.dump_snapshot(file)) {
+    bool ok = codec >= 0 ? db.dump_snapshot_blocks(file, codec, thnum, 0) :
+        db.dump_snapshot(file);
+    if (!ok) {
       dberrprint(&db, "DB::dump_snapshot");
       err = true;
     }
     oprintf(" (end)\n");
     if (!err) oprintf("%lld records were dumped successfully\n", (long long)checker.count());
   } else {
-    if (!db.dump_snapshot(&std::cout)) {
+    bool ok = codec >= 0 ? db.dump_snapshot_blocks(&std::cout, codec, thnum) :
+        db.dump_snapshot(&std::cout);
+    if (!ok) {
       dberrprint(&db, "DB::dump_snapshot");
       err = true;
     }
@@ -1362,7 +1420,8 @@ static int32_t procdump(const char* path, const char* file, int32_t oflags) {
 
 
 // perform load command
-static int32_t procload(const char* path, const char* file, int32_t oflags) {
+static int32_t procload(const char* path, const char* file, int32_t oflags,
+                        int32_t thnum, const char* kbstr, const char* kestr) {
   kc::TreeDB db;
   db.tune_logger(stdlogger(g_progname, &std::cerr));
   if (!db.open(path, kc::TreeDB::OWRITER | kc::TreeDB::OCREATE | oflags)) {
@@ -1372,7 +1431,11 @@ static int32_t procload(const char* path, const char* file, int32_t oflags) {
   bool err = false;
   if (file) {
     DotChecker checker(&std::cout, -1000);
-    if (!db.load_snapshot(file)) {
+    bool ok = kbstr || kestr ?
+        db.load_snapshot_range(file, kbstr, kbstr ? std::strlen(kbstr) : 0,
+                               kestr, kestr ? std::strlen(kestr) : 0) :
+        db.load_snapshot_parallel(file, thnum);
+    if (!ok) {
       dberrprint(&db, "DB::load_snapshot");
       err = true;
     }
@@ -1380,7 +1443,7 @@ static int32_t procload(const char* path, const char* file, int32_t oflags) {
     if (!err) oprintf("%lld records were loaded successfully\n", (long long)checker.count());
   } else {
     DotChecker checker(&std::cout, -1000);
-    if (!db.load_snapshot(&std::cin)) {
+    if (!db.load_snapshot_parallel(&std::cin, thnum)) {
       dberrprint(&db, "DB::load_snapshot");
       err = true;
     }
@@ -1572,5 +1635,111 @@ static int32_t proccheck(const char* path, int32_t oflags) {
 }
 
 
+// perform analyze command
+static int32_t procanalyze(const char* path, int32_t oflags, int64_t snum, bool apply) {
+  kc::TreeDB db;
+  db.tune_logger(stdlogger(g_progname, &std::cerr));
+  uint32_t omode = apply ? kc::TreeDB::OWRITER : kc::TreeDB::OREADER;
+  if (!db.open(path, omode | oflags)) {
+    dberrprint(&db, "DB::open failed");
+    return 1;
+  }
+  bool err = false;
+  std::map<std::string, std::string> result;
+  std::map<std::string, std::string> status;
+  if (db.analyze(&result, snum) && db.status(&status)) {
+    std::map<std::string, std::string>::iterator it = result.begin();
+    std::map<std::string, std::string>::iterator itend = result.end();
+    while (it != itend) {
+      oprintf("%s: %s\n", it->first.c_str(), it->second.c_str());
+      ++it;
+    }
+    oprintf("runtime parameters: pccap=%s msiz=%s dfunit=%s\n", result["rec_pccap"].c_str(),
+            result["rec_msiz"].c_str(), result["rec_dfunit"].c_str());
+    oprintf("structural parameters: psiz=%s bnum=%s\n",
+            result["rec_psiz"].c_str(), result["rec_bnum"].c_str());
+  } else {
+    dberrprint(&db, "DB::analyze failed");
+    err = true;
+  }
+  bool rebuild = apply && !err && kc::atoi(result["rebuild"].c_str()) > 0;
+  if (rebuild && status["rcomp"] == "external") {
+    eprintf("%s: %s: the external comparator cannot be restored\n", g_progname, path);
+    err = true;
+    rebuild = false;
+  }
+  std::string npath;
+  if (rebuild) {
+    kc::TreeDB ndb;
+    ndb.tune_logger(stdlogger(g_progname, &std::cerr));
+    ndb.tune_alignment(kc::atoi(status["apow"].c_str()));
+    ndb.tune_fbp(kc::atoi(status["fpow"].c_str()));
+    ndb.tune_options(kc::atoi(status["opts"].c_str()));
+    ndb.tune_buckets(kc::atoi(result["rec_bnum"].c_str()));
+    ndb.tune_page(kc::atoi(result["rec_psiz"].c_str()));
+    const std::string& rcomp = status["rcomp"];
+    if (rcomp == "decimal") {
+      ndb.tune_comparator(kc::DECIMALCOMP);
+    } else if (rcomp == "lexicaldesc") {
+      ndb.tune_comparator(kc::LEXICALDESCCOMP);
+    } else if (rcomp == "decimaldesc") {
+      ndb.tune_comparator(kc::DECIMALDESCCOMP);
+    }
+    npath = std::string(path) + kc::File::EXTCHR + KCPDBTMPPATHEXT;
+    oprintf("rebuilding the database into %s\n", npath.c_str());
+    uint32_t nmode = kc::TreeDB::OWRITER | kc::TreeDB::OCREATE | kc::TreeDB::OTRUNCATE;
+    if (ndb.open(npath, nmode)) {
+      class VisitorImpl : public kc::DB::Visitor {
+       public:
+        explicit VisitorImpl(kc::BasicDB* dest) : dest_(dest), err_(false) {}
+        bool error() {
+          return err_;
+        }
+       private:
+        const char* visit_full(const char* kbuf, size_t ksiz,
+                               const char* vbuf, size_t vsiz, size_t* sp) {
+          if (!err_ && !dest_->set(kbuf, ksiz, vbuf, vsiz)) err_ = true;
+          return NOP;
+        }
+        kc::BasicDB* dest_;
+        bool err_;
+      } visitor(&ndb);
+      DotChecker checker(&std::cout, -1000);
+      if (!db.iterate(&visitor, false, &checker)) {
+        dberrprint(&db, "DB::iterate failed");
+        err = true;
+      }
+      oprintf(" (end)\n");
+      if (visitor.error()) {
+        dberrprint(&ndb, "DB::set failed");
+        err = true;
+      }
+      if (!ndb.close()) {
+        dberrprint(&ndb, "DB::close failed");
+        err = true;
+      }
+    } else {
+      dberrprint(&ndb, "DB::open failed");
+      err = true;
+    }
+  }
+  if (!db.close()) {
+    dberrprint(&db, "DB::close failed");
+    err = true;
+  }
+  if (rebuild) {
+    if (err) {
+      kc::File::remove(npath);
+    } else if (kc::File::rename(npath, path)) {
+      oprintf("the database was rebuilt successfully\n");
+    } else {
+      eprintf("%s: %s: renaming the rebuilt database failed\n", g_progname, path);
+      err = true;
+    }
+  }
+  return err ? 1 : 0;
+}
+
+
 
 // END OF FILE
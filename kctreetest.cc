@@ -32,10 +32,12 @@ static int32_t runorder(int argc, char** argv);
 static int32_t runqueue(int argc, char** argv);
 static int32_t runwicked(int argc, char** argv);
 static int32_t runtran(int argc, char** argv);
+static int32_t runcrash(int argc, char** argv);
 static int32_t procorder(const char* path, int64_t rnum, int32_t thnum, bool rnd, int32_t mode,
                          bool tran, int32_t oflags, int32_t apow, int32_t fpow,
                          int32_t opts, int64_t bnum, int32_t psiz, int64_t msiz,
-                         int64_t dfunit, int64_t pccap, kc::Comparator* rcomp, bool lv);
+                         int64_t dfunit, int64_t pccap, int64_t cmbud, kc::Comparator* rcomp,
+                         bool lv);
 static int32_t procqueue(const char* path, int64_t rnum, int32_t thnum, int32_t itnum, bool rnd,
                          int32_t oflags, int32_t apow, int32_t fpow, int32_t opts, int64_t bnum,
                          int32_t psiz, int64_t msiz, int64_t dfunit, int64_t pccap,
@@ -48,6 +50,11 @@ static int32_t proctran(const char* path, int64_t rnum, int32_t thnum, int32_t i
                         int32_t oflags, int32_t apow, int32_t fpow, int32_t opts, int64_t bnum,
                         int32_t psiz, int64_t msiz, int64_t dfunit, int64_t pccap,
                         kc::Comparator* rcomp, bool lv);
+static int32_t proccrash(const char* path, int64_t rnum, int32_t itnum, bool hard,
+                         int32_t apow, int32_t fpow, int32_t opts, int64_t bnum,
+                         int32_t psiz, int64_t msiz, int64_t dfunit, int64_t pccap,
+                         kc::Comparator* rcomp, bool lv);
+static bool readimage(const std::string& path, std::string* img);
 
 
 // main routine
@@ -68,6 +75,8 @@ int main(int argc, char** argv) {
     rv = runwicked(argc, argv);
   } else if (!std::strcmp(argv[1], "tran")) {
     rv = runtran(argc, argv);
+  } else if (!std::strcmp(argv[1], "crash")) {
+    rv = runcrash(argc, argv);
   } else {
     usage();
   }
@@ -89,8 +98,8 @@ static void usage() {
   eprintf("usage:\n");
   eprintf("  %s order [-th num] [-rnd] [-set|-get|-getw|-rem|-etc] [-tran]"
           " [-oat|-oas|-onl|-otl|-onr] [-apow num] [-fpow num] [-ts] [-tl] [-tc] [-bnum num]"
-          " [-psiz num] [-msiz num] [-dfunit num] [-pccap num] [-rcd|-rcld|-rcdd] [-lv]"
-          " path rnum\n", g_progname);
+          " [-psiz num] [-msiz num] [-dfunit num] [-pccap num] [-cm num] [-rcd|-rcld|-rcdd]"
+          " [-lv] path rnum\n", g_progname);
   eprintf("  %s queue [-th num] [-it num] [-rnd] [-oat|-oas|-onl|-otl|-onr]"
           " [-apow num] [-fpow num] [-ts] [-tl] [-tc] [-bnum num] [-psiz num] [-msiz num]"
           " [-dfunit num] [-pccap num] [-rcd|-rcld|-rcdd] [-lv] path rnum\n", g_progname);
@@ -100,6 +109,9 @@ static void usage() {
   eprintf("  %s tran [-th num] [-it num] [-hard] [-oat|-oas|-onl|-otl|-onr]"
           " [-apow num] [-fpow num] [-ts] [-tl] [-tc] [-bnum num] [-psiz num] [-msiz num]"
           " [-dfunit num] [-pccap num] [-rcd|-rcld|-rcdd] [-lv] path rnum\n", g_progname);
+  eprintf("  %s crash [-it num] [-hard] [-apow num] [-fpow num] [-ts] [-tl] [-tc] [-bnum num]"
+          " [-psiz num] [-msiz num] [-dfunit num] [-pccap num] [-rcd|-rcld|-rcdd] [-lv]"
+          " path rnum\n", g_progname);
   eprintf("\n");
   std::exit(1);
 }
@@ -232,6 +244,7 @@ static int32_t runorder(int argc, char** argv) {
   int64_t msiz = -1;
   int64_t dfunit = -1;
   int64_t pccap = 0;
+  int64_t cmbud = 0;
   kc::Comparator* rcomp = NULL;
   bool lv = false;
   for (int32_t i = 2; i < argc; i++) {
@@ -292,6 +305,9 @@ static int32_t runorder(int argc, char** argv) {
       } else if (!std::strcmp(argv[i], "-pccap")) {
         if (++i >= argc) usage();
         pccap = kc::atoix(argv[i]);
+      } else if (!std::strcmp(argv[i], "-cm")) {
+        if (++i >= argc) usage();
+        cmbud = kc::atoix(argv[i]);
       } else if (!std::strcmp(argv[i], "-rcd")) {
         rcomp = kc::DECIMALCOMP;
       } else if (!std::strcmp(argv[i], "-rcld")) {
@@ -317,7 +333,7 @@ static int32_t runorder(int argc, char** argv) {
   if (rnum < 1 || thnum < 1) usage();
   if (thnum > THREADMAX) thnum = THREADMAX;
   int32_t rv = procorder(path, rnum, thnum, rnd, mode, tran, oflags,
-                         apow, fpow, opts, bnum, psiz, msiz, dfunit, pccap, rcomp, lv);
+                         apow, fpow, opts, bnum, psiz, msiz, dfunit, pccap, cmbud, rcomp, lv);
   return rv;
 }
 
@@ -420,6 +436,88 @@ static int32_t runqueue(int argc, char** argv) {
 }
 
 
+// parse arguments of crash command
+static int32_t runcrash(int argc, char** argv) {
+  bool argbrk = false;
+  const char* path = NULL;
+  const char* rstr = NULL;
+  int32_t itnum = 1;
+  bool hard = false;
+  int32_t apow = -1;
+  int32_t fpow = -1;
+  int32_t opts = 0;
+  int64_t bnum = -1;
+  int64_t psiz = -1;
+  int64_t msiz = -1;
+  int64_t dfunit = -1;
+  int64_t pccap = 0;
+  kc::Comparator* rcomp = NULL;
+  bool lv = false;
+  for (int32_t i = 2; i < argc; i++) {
+    if (!argbrk && argv[i][0] == '-') {
+      if (!std::strcmp(argv[i], "--")) {
+        argbrk = true;
+      } else if (!std::strcmp(argv[i], "-it")) {
+        if (++i >= argc) usage();
+        itnum = kc::atoix(argv[i]);
+      } else if (!std::strcmp(argv[i], "-hard")) {
+        hard = true;
+      } else if (!std::strcmp(argv[i], "-apow")) {
+        if (++i >= argc) usage();
+        apow = kc::atoix(argv[i]);
+      } else if (!std::strcmp(argv[i], "-fpow")) {
+        if (++i >= argc) usage();
+        fpow = kc::atoix(argv[i]);
+      } else if (!std::strcmp(argv[i], "-ts")) {
+        opts |= kc::TreeDB::TSMALL;
+      } else if (!std::strcmp(argv[i], "-tl")) {
+        opts |= kc::TreeDB::TLINEAR;
+      } else if (!std::strcmp(argv[i], "-tc")) {
+        opts |= kc::TreeDB::TCOMPRESS;
+      } else if (!std::strcmp(argv[i], "-bnum")) {
+        if (++i >= argc) usage();
+        bnum = kc::atoix(argv[i]);
+      } else if (!std::strcmp(argv[i], "-psiz")) {
+        if (++i >= argc) usage();
+        psiz = kc::atoix(argv[i]);
+      } else if (!std::strcmp(argv[i], "-msiz")) {
+        if (++i >= argc) usage();
+        msiz = kc::atoix(argv[i]);
+      } else if (!std::strcmp(argv[i], "-dfunit")) {
+        if (++i >= argc) usage();
+        dfunit = kc::atoix(argv[i]);
+      } else if (!std::strcmp(argv[i], "-pccap")) {
+        if (++i >= argc) usage();
+        pccap = kc::atoix(argv[i]);
+      } else if (!std::strcmp(argv[i], "-rcd")) {
+        rcomp = kc::DECIMALCOMP;
+      } else if (!std::strcmp(argv[i], "-rcld")) {
+        rcomp = kc::LEXICALDESCCOMP;
+      } else if (!std::strcmp(argv[i], "-rcdd")) {
+        rcomp = kc::DECIMALDESCCOMP;
+      } else if (!std::strcmp(argv[i], "-lv")) {
+        lv = true;
+      } else {
+        usage();
+      }
+    } else if (!path) {
+      argbrk = true;
+      path = argv[i];
+    } else if (!rstr) {
+      rstr = argv[i];
+    } else {
+      usage();
+    }
+  }
+  if (!path || !rstr) usage();
+  int64_t rnum = kc::atoix(rstr);
+  if (rnum < 1 || itnum < 1) usage();
+  int32_t rv = proccrash(path, rnum, itnum, hard, apow, fpow, opts, bnum, psiz, msiz, dfunit,
+                         pccap, rcomp, lv);
+  return rv;
+}
+
+
 // parse arguments of wicked command
 static int32_t runwicked(int argc, char** argv) {
   bool argbrk = false;
@@ -617,14 +715,17 @@ static int32_t runtran(int argc, char** argv) {
 static int32_t procorder(const char* path, int64_t rnum, int32_t thnum, bool rnd, int32_t mode,
                          bool tran, int32_t oflags, int32_t apow, int32_t fpow,
                          int32_t opts, int64_t bnum, int32_t psiz, int64_t msiz,
-                         int64_t dfunit, int64_t pccap, kc::Comparator* rcomp, bool lv) {
+                         int64_t dfunit, int64_t pccap, int64_t cmbud, kc::Comparator* rcomp,
+                         bool lv) {
   oprintf("<In-order Test>\n  seed=%u  path=%s  rnum=%lld  thnum=%d  rnd=%d  mode=%d  tran=%d"
           "  oflags=%d  apow=%d  fpow=%d  opts=%d  bnum=%lld  psiz=%d  msiz=%lld"
-          "  dfunit=%lld  pccap=%lld  rcomp=%p  lv=%d\n\n",
+          "  dfunit=%lld  pccap=%lld  cmbud=%lld  rcomp=%p  lv=%d\n\n",
           g_randseed, path, (long long)rnum, thnum, rnd, mode, tran, oflags, apow, fpow, opts,
           (long long)bnum, psiz, (long long)msiz, (long long)dfunit, (long long)pccap,
-          rcomp, lv);
+          (long long)cmbud, rcomp, lv);
   bool err = false;
+  kc::BasicDB::CacheManager cmgr(cmbud);
+  kc::TreeDB cdb;
   kc::TreeDB db;
   oprintf("opening the database:\n");
   double stime = kc::time();
@@ -638,6 +739,7 @@ static int32_t procorder(const char* path, int64_t rnum, int32_t thnum, bool rnd
   if (msiz >= 0) db.tune_map(msiz);
   if (dfunit > 0) db.tune_defrag(dfunit);
   if (pccap > 0) db.tune_page_cache(pccap);
+  if (cmbud > 0) db.tune_cache_manager(&cmgr);
   if (rcomp) db.tune_comparator(rcomp);
   uint32_t omode = kc::TreeDB::OWRITER | kc::TreeDB::OCREATE | kc::TreeDB::OTRUNCATE;
   if (mode == 'r') {
@@ -649,6 +751,22 @@ static int32_t procorder(const char* path, int64_t rnum, int32_t thnum, bool rnd
     dberrprint(&db, __LINE__, "DB::open");
     err = true;
   }
+  std::string cpath = std::string(path) + ".cm";
+  if (cmbud > 0) {
+    cdb.tune_cache_manager(&cmgr);
+    if (!cdb.open(cpath, kc::TreeDB::OWRITER | kc::TreeDB::OCREATE | kc::TreeDB::OTRUNCATE)) {
+      dberrprint(&cdb, __LINE__, "DB::open");
+      err = true;
+    }
+    for (int64_t i = 1; !err && i <= rnum / 8; i++) {
+      char kbuf[RECBUFSIZ];
+      size_t ksiz = std::sprintf(kbuf, "%08lld", (long long)i);
+      if (!cdb.set(kbuf, ksiz, kbuf, ksiz)) {
+        dberrprint(&cdb, __LINE__, "DB::set");
+        err = true;
+      }
+    }
+  }
   double etime = kc::time();
   dbmetaprint(&db, false);
   oprintf("time: %.3f\n", etime - stime);
@@ -1638,6 +1756,32 @@ static int32_t procorder(const char* path, int64_t rnum, int32_t thnum, bool rnd
     dbmetaprint(&db, mode == 'r' || mode == 'e');
     oprintf("time: %.3f\n", etime - stime);
   }
+  if (cmbud > 0) {
+    oprintf("checking the cache manager:\n");
+    cmgr.rebalance();
+    std::map<std::string, std::string> status;
+    cmgr.status(&status);
+    int64_t slotnum = kc::atoi(status["cm_slots"].c_str());
+    int64_t qsum = 0;
+    for (int64_t i = 0; i < slotnum; i++) {
+      std::string prefix = kc::strprintf("cm_%lld_", (long long)i);
+      int64_t quota = kc::atoi(status[prefix + "quota"].c_str());
+      oprintf("%s: quota=%lld usage=%s hits=%s misses=%s\n",
+              status[prefix + "name"].c_str(), (long long)quota,
+              status[prefix + "usage"].c_str(), status[prefix + "hits"].c_str(),
+              status[prefix + "misses"].c_str());
+      qsum += quota;
+    }
+    if (slotnum != 2 || qsum != cmgr.budget()) {
+      dberrprint(&db, __LINE__, "CacheManager::status");
+      err = true;
+    }
+    if (!cdb.close()) {
+      dberrprint(&cdb, __LINE__, "DB::close");
+      err = true;
+    }
+    kc::File::remove(cpath);
+  }
   oprintf("closing the database:\n");
   stime = kc::time();
   if (!db.close()) {
@@ -2397,6 +2541,17 @@ static int32_t proctran(const char* path, int64_t rnum, int32_t thnum, int32_t i
           if (tran && myrand(100) == 0) {
             if (db_->end_transaction(commit)) {
               yield();
+              if (thnum_ < 2) {
+                for (int32_t j = myrand(10); !err_ && j > 0; j--) {
+                  ksiz = std::sprintf(kbuf, "%lld", (long long)(myrand(range) + 1));
+                  if (!db_->set(kbuf, ksiz, kbuf, ksiz)) {
+                    dberrprint(db_, __LINE__, "DB::set");
+                    err_ = true;
+                  }
+                  paradb_->set(kbuf, ksiz, kbuf, ksiz);
+                }
+              }
+              commit = myrand(10) > 0;
               if (!db_->begin_transaction(hard_)) {
                 dberrprint(db_, __LINE__, "DB::begin_transaction");
                 tran = false;
@@ -2508,5 +2663,199 @@ static int32_t proctran(const char* path, int64_t rnum, int32_t thnum, int32_t i
 }
 
 
+// perform crash command
+static int32_t proccrash(const char* path, int64_t rnum, int32_t itnum, bool hard,
+                         int32_t apow, int32_t fpow, int32_t opts, int64_t bnum,
+                         int32_t psiz, int64_t msiz, int64_t dfunit, int64_t pccap,
+                         kc::Comparator* rcomp, bool lv) {
+  oprintf("<Crash Recovery Test>\n  seed=%u  path=%s  rnum=%lld  itnum=%d  hard=%d"
+          "  apow=%d  fpow=%d  opts=%d  bnum=%lld  psiz=%d  msiz=%lld  dfunit=%lld"
+          "  pccap=%lld  rcomp=%p  lv=%d\n\n",
+          g_randseed, path, (long long)rnum, itnum, hard, apow, fpow, opts, (long long)bnum,
+          psiz, (long long)msiz, (long long)dfunit, (long long)pccap, rcomp, lv);
+  bool err = false;
+  kc::TreeDB db;
+  kc::TreeDB crashdb;
+  kc::TreeDB* dbs[] = { &db, &crashdb };
+  for (size_t i = 0; i < sizeof(dbs) / sizeof(*dbs); i++) {
+    dbs[i]->tune_logger(stdlogger(g_progname, &std::cout), lv ? kc::UINT32MAX :
+                        kc::BasicDB::Logger::WARN | kc::BasicDB::Logger::ERROR);
+    if (apow >= 0) dbs[i]->tune_alignment(apow);
+    if (fpow >= 0) dbs[i]->tune_fbp(fpow);
+    if (opts > 0) dbs[i]->tune_options(opts);
+    if (bnum > 0) dbs[i]->tune_buckets(bnum);
+    if (psiz > 0) dbs[i]->tune_page(psiz);
+    if (msiz >= 0) dbs[i]->tune_map(msiz);
+    if (dfunit > 0) dbs[i]->tune_defrag(dfunit);
+    if (pccap > 0) dbs[i]->tune_page_cache(pccap);
+    if (rcomp) dbs[i]->tune_comparator(rcomp);
+  }
+  oprintf("opening the database:\n");
+  double stime = kc::time();
+  if (!db.open(path, kc::TreeDB::OWRITER | kc::TreeDB::OCREATE | kc::TreeDB::OTRUNCATE)) {
+    dberrprint(&db, __LINE__, "DB::open");
+    err = true;
+  }
+  oprintf("time: %.3f\n", kc::time() - stime);
+  char lbuf[RECBUFSIZL];
+  std::memset(lbuf, '*', sizeof(lbuf));
+  std::map<std::string, std::string> recs;
+  std::string cpath = db.path() + "-crash";
+  for (int32_t itcnt = 1; !err && itcnt <= itnum; itcnt++) {
+    oprintf("iteration %d updating:\n", itcnt);
+    stime = kc::time();
+    std::map<std::string, std::string> snap;
+    std::map<std::string, std::string> trecs;
+    for (int32_t phase = 0; !err && phase < 2; phase++) {
+      if (phase > 0) {
+        snap = recs;
+        trecs = recs;
+        if (!db.begin_transaction(hard)) {
+          dberrprint(&db, __LINE__, "DB::begin_transaction");
+          err = true;
+        }
+      }
+      std::map<std::string, std::string>* mrecs = phase > 0 ? &trecs : &recs;
+      for (int64_t i = 1; !err && i <= rnum; i++) {
+        char kbuf[RECBUFSIZ];
+        size_t ksiz = std::sprintf(kbuf, "%lld", (long long)(myrand(rnum * 2) + 1));
+        std::string key(kbuf, ksiz);
+        const char* vbuf = kbuf;
+        size_t vsiz = ksiz;
+        if (myrand(10) == 0) {
+          vbuf = lbuf;
+          vsiz = myrand(RECBUFSIZL) / (myrand(5) + 1);
+        }
+        if (myrand(4) == 0) {
+          if (!db.remove(kbuf, ksiz) && db.error() != kc::BasicDB::Error::NOREC) {
+            dberrprint(&db, __LINE__, "DB::remove");
+            err = true;
+          }
+          mrecs->erase(key);
+        } else {
+          if (!db.set(kbuf, ksiz, vbuf, vsiz)) {
+            dberrprint(&db, __LINE__, "DB::set");
+            err = true;
+          }
+          (*mrecs)[key] = std::string(vbuf, vsiz);
+        }
+      }
+    }
+    oprintf("time: %.3f\n", kc::time() - stime);
+    oprintf("copying the image of the crashed database:\n");
+    stime = kc::time();
+    std::string img;
+    if (!err && readimage(db.path(), &img)) {
+      if (!kc::File::write_file(cpath, img.data(), img.size())) {
+        eprintf("%s: %s: writing failed\n", g_progname, cpath.c_str());
+        err = true;
+      }
+    } else {
+      err = true;
+    }
+    const char* exts[] = { ".wal", ".jnl", ".idx", ".blob" };
+    for (size_t i = 0; !err && i < sizeof(exts) / sizeof(*exts); i++) {
+      std::string dpath = cpath + exts[i];
+      if (kc::File::status(db.path() + exts[i])) {
+        if (!readimage(db.path() + exts[i], &img) ||
+            !kc::File::write_file(dpath, img.data(), img.size())) {
+          eprintf("%s: %s: writing failed\n", g_progname, dpath.c_str());
+          err = true;
+        }
+      } else if (kc::File::status(dpath) && !kc::File::remove(dpath)) {
+        eprintf("%s: %s: removing failed\n", g_progname, dpath.c_str());
+        err = true;
+      }
+    }
+    oprintf("time: %.3f\n", kc::time() - stime);
+    oprintf("checking the restoration point:\n");
+    stime = kc::time();
+    if (!err && !crashdb.open(cpath, kc::TreeDB::OWRITER)) {
+      dberrprint(&crashdb, __LINE__, "DB::open");
+      err = true;
+    }
+    if (!err) {
+      if (crashdb.count() != (int64_t)snap.size()) {
+        dberrprint(&crashdb, __LINE__, "DB::count");
+        err = true;
+      }
+      std::map<std::string, std::string>::const_iterator it = snap.begin();
+      std::map<std::string, std::string>::const_iterator itend = snap.end();
+      while (!err && it != itend) {
+        std::string value;
+        if (!crashdb.get(it->first, &value) || value != it->second) {
+          dberrprint(&crashdb, __LINE__, "DB::get");
+          err = true;
+        }
+        ++it;
+      }
+      int64_t cnt = 0;
+      kc::DB::Cursor* cur = crashdb.cursor();
+      if (!cur->jump() && crashdb.error() != kc::BasicDB::Error::NOREC) {
+        dberrprint(&crashdb, __LINE__, "Cursor::jump");
+        err = true;
+      }
+      std::string key, value;
+      while (!err && cur->get(&key, &value, true)) {
+        std::map<std::string, std::string>::const_iterator rit = snap.find(key);
+        if (rit == snap.end() || rit->second != value) {
+          dberrprint(&crashdb, __LINE__, "Cursor::get");
+          err = true;
+        }
+        cnt++;
+      }
+      delete cur;
+      if (cnt != (int64_t)snap.size()) {
+        dberrprint(&crashdb, __LINE__, "Cursor::get");
+        err = true;
+      }
+      oprintf("checked: %lld\n", (long long)cnt);
+      if (!crashdb.close()) {
+        dberrprint(&crashdb, __LINE__, "DB::close");
+        err = true;
+      }
+    }
+    oprintf("time: %.3f\n", kc::time() - stime);
+    bool commit = myrand(2) == 0;
+    oprintf("%s the transaction:\n", commit ? "committing" : "aborting");
+    stime = kc::time();
+    if (!err) {
+      if (db.end_transaction(commit)) {
+        if (commit) recs = trecs;
+      } else {
+        dberrprint(&db, __LINE__, "DB::end_transaction");
+        err = true;
+      }
+    }
+    if (!err && db.count() != (int64_t)recs.size()) {
+      dberrprint(&db, __LINE__, "DB::count");
+      err = true;
+    }
+    oprintf("time: %.3f\n", kc::time() - stime);
+  }
+  dbmetaprint(&db, true);
+  if (!db.close()) {
+    dberrprint(&db, __LINE__, "DB::close");
+    err = true;
+  }
+  oprintf("%s\n\n", err ? "error" : "ok");
+  return err ? 1 : 0;
+}
+
+
+// read the whole image of a file
+static bool readimage(const std::string& path, std::string* img) {
+  int64_t size;
+  char* buf = kc::File::read_file(path, &size);
+  if (!buf) {
+    eprintf("%s: %s: reading failed\n", g_progname, path.c_str());
+    return false;
+  }
+  img->assign(buf, size);
+  delete[] buf;
+  return true;
+}
+
+
 
 // END OF FILE
@@ -2116,6 +2116,44 @@ static int32_t procmisc(int64_t rnum) {
     errprint(__LINE__, "_dummytest");
     err = true;
   }
+  struct {
+    const char* regex;
+    uint32_t opts;
+    const char* prefix;
+    const char* infix;
+  } litcases[] = {
+    { "^abc", 0, "abc", "abc" },
+    { "abc$", 0, "", "abc" },
+    { "^abc$", 0, "abc", "abc" },
+    { "^ab.cde", 0, "ab", "cde" },
+    { "^a\\.b\\*c", 0, "a.b*c", "a.b*c" },
+    { "^a\\dbc", 0, "a", "bc" },
+    { "^\\x41bc", 0, "", "bc" },
+    { "^ab[cd]ef", 0, "ab", "ab" },
+    { "^[a]bcd", 0, "", "bcd" },
+    { "^a[\\]]bcd", 0, "", "" },
+    { "^abc?def", 0, "ab", "def" },
+    { "^abc*def", 0, "ab", "def" },
+    { "^abc{0,3}def", 0, "ab", "def" },
+    { "^abc+de", 0, "abc", "abc" },
+    { "^ab(cd)?efg", 0, "ab", "efg" },
+    { "^ab(c|d)efg", 0, "ab", "efg" },
+    { "^abc|def", 0, "", "" },
+    { "(abc|def)", 0, "", "" },
+    { "^abc", kc::Regex::IGNCASE, "", "" },
+    { "abcd", kc::Regex::IGNCASE, "", "" },
+  };
+  for (size_t i = 0; i < sizeof(litcases) / sizeof(*litcases); i++) {
+    if (kc::Regex::literal_prefix(litcases[i].regex, litcases[i].opts) != litcases[i].prefix) {
+      errprint(__LINE__, "Regex::literal_prefix: %s", litcases[i].regex);
+      err = true;
+    }
+    if (kc::Regex::literal_substring(litcases[i].regex, litcases[i].opts) !=
+        litcases[i].infix) {
+      errprint(__LINE__, "Regex::literal_substring: %s", litcases[i].regex);
+      err = true;
+    }
+  }
   double stime = kc::time();
   for (int64_t i = 1; !err && i <= rnum; i++) {
     uint16_t num16 = (1ULL << myrand(sizeof(num16) * 8)) - 5 + myrand(10);
@@ -2255,6 +2293,14 @@ static int32_t procmisc(int64_t rnum) {
     delete[] obuf;
     delete[] ebuf;
     ebuf = kc::memdup((char*)ubuf, usiz);
+    size_t psiz = usiz > 0 ? myrand(usiz + 1) : 0;
+    int32_t cmp = kc::LEXICALCOMP->compare((char*)ubuf, usiz, ebuf, psiz);
+    if (psiz < usiz ? cmp <= 0 : cmp != 0) {
+      errprint(__LINE__, "LexicalComparator::compare: %d:%d", (int)psiz, (int)usiz);
+      err = true;
+    }
+    delete[] ebuf;
+    ebuf = kc::memdup((char*)ubuf, usiz);
     ebuf[usiz] = '\0';
     obuf = kc::strdup(ebuf);
     switch (myrand(16)) {